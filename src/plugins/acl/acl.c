@@ -18,7 +18,7 @@
 #include <vnet/vnet.h>
 #include <vnet/plugin/plugin.h>
 #include <acl/acl.h>
-#include <acl/l2sess.h>
+#include <acl/hash_lookup.h>
 
 #include <vnet/l2/l2_classify.h>
 #include <vnet/classify/input_acl.h>
@@ -161,6 +161,53 @@ vl_api_acl_plugin_get_version_t_handler (vl_api_acl_plugin_get_version_t * mp)
 }
 
 
+/*
+ * Sessions are only created by permit+reflect rules, so the session
+ * feature arcs only run on interfaces whose ACLs have such a rule.
+ * Call whenever an interface's ACLs, or their rules, change.
+ */
+static void
+acl_interface_fa_update (acl_main_t * am, u32 sw_if_index, int is_input,
+			 int enable_disable)
+{
+  u32 **acl_vecs = is_input ? am->input_acl_vec_by_sw_if_index :
+    am->output_acl_vec_by_sw_if_index;
+  int has_reflect = 0;
+  acl_list_t *a;
+  u32 *acl_index;
+  int i;
+
+  if (enable_disable && sw_if_index < vec_len (acl_vecs))
+    vec_foreach (acl_index, acl_vecs[sw_if_index])
+    {
+      a = pool_elt_at_index (am->acls, *acl_index);
+      for (i = 0; i < a->count && !has_reflect; i++)
+	has_reflect = (a->rules[i].is_permit == 2);
+    }
+
+  acl_fa_enable_disable (sw_if_index, is_input, has_reflect);
+}
+
+/* Update the session arcs of every interface using the ACL */
+static void
+acl_fa_update_interfaces_using_acl (acl_main_t * am, u32 acl_list_index)
+{
+  u32 sw_if_index;
+
+  for (sw_if_index = 0;
+       sw_if_index < vec_len (am->input_acl_vec_by_sw_if_index);
+       sw_if_index++)
+    if (vec_search (am->input_acl_vec_by_sw_if_index[sw_if_index],
+		    acl_list_index) != ~0)
+      acl_interface_fa_update (am, sw_if_index, 1, 1);
+  for (sw_if_index = 0;
+       sw_if_index < vec_len (am->output_acl_vec_by_sw_if_index);
+       sw_if_index++)
+    if (vec_search (am->output_acl_vec_by_sw_if_index[sw_if_index],
+		    acl_list_index) != ~0)
+      acl_interface_fa_update (am, sw_if_index, 0, 1);
+}
+
 static int
 acl_add_list (u32 count, vl_api_acl_rule_t rules[],
 	      u32 * acl_list_index, u8 * tag)
@@ -227,12 +274,17 @@ acl_add_list (u32 count, vl_api_acl_rule_t rules[],
   else
     {
       a = am->acls + *acl_list_index;
+      /* The compiled lookup refers to the old rules, remove it first */
+      acl_hash_acl_del (am, *acl_list_index);
       /* Get rid of the old rules */
       clib_mem_free (a->rules);
     }
   a->rules = acl_new_rules;
   a->count = count;
   memcpy (a->tag, tag, sizeof (a->tag));
+  acl_hash_acl_add (am, *acl_list_index);
+  /* A replaced ACL may have gained or lost its permit+reflect rules */
+  acl_fa_update_interfaces_using_acl (am, *acl_list_index);
 
   return 0;
 }
@@ -242,7 +294,7 @@ acl_del_list (u32 acl_list_index)
 {
   acl_main_t *am = &acl_main;
   acl_list_t *a;
-  int i, ii;
+  int i, ii, found;
   if (pool_is_free_index (am->acls, acl_list_index))
     {
       return -1;
@@ -251,36 +303,45 @@ acl_del_list (u32 acl_list_index)
   /* delete any references to the ACL */
   for (i = 0; i < vec_len (am->output_acl_vec_by_sw_if_index); i++)
     {
+      found = 0;
       for (ii = 0; ii < vec_len (am->output_acl_vec_by_sw_if_index[i]);
 	   /* see body */ )
 	{
 	  if (acl_list_index == am->output_acl_vec_by_sw_if_index[i][ii])
 	    {
 	      vec_del1 (am->output_acl_vec_by_sw_if_index[i], ii);
+	      found = 1;
 	    }
 	  else
 	    {
 	      ii++;
 	    }
 	}
+      if (found)
+	acl_interface_fa_update (am, i, 0, 1);
     }
   for (i = 0; i < vec_len (am->input_acl_vec_by_sw_if_index); i++)
     {
+      found = 0;
       for (ii = 0; ii < vec_len (am->input_acl_vec_by_sw_if_index[i]);
 	   /* see body */ )
 	{
 	  if (acl_list_index == am->input_acl_vec_by_sw_if_index[i][ii])
 	    {
 	      vec_del1 (am->input_acl_vec_by_sw_if_index[i], ii);
+	      found = 1;
 	    }
 	  else
 	    {
 	      ii++;
 	    }
 	}
+      if (found)
+	acl_interface_fa_update (am, i, 1, 1);
     }
 
   /* now we can delete the ACL itself */
+  acl_hash_acl_del (am, acl_list_index);
   a = &am->acls[acl_list_index];
   if (a->rules)
     {
@@ -618,6 +679,8 @@ acl_interface_in_enable_disable (acl_main_t * am, u32 sw_if_index,
 			  sw_if_index))
     return VNET_API_ERROR_INVALID_SW_IF_INDEX;
 
+  acl_interface_fa_update (am, sw_if_index, 1, enable_disable);
+
   if (enable_disable)
     {
       rv = acl_hook_l2_input_classify (am, sw_if_index);
@@ -641,6 +704,8 @@ acl_interface_out_enable_disable (acl_main_t * am, u32 sw_if_index,
 			  sw_if_index))
     return VNET_API_ERROR_INVALID_SW_IF_INDEX;
 
+  acl_interface_fa_update (am, sw_if_index, 0, enable_disable);
+
   if (enable_disable)
     {
       rv = acl_hook_l2_output_classify (am, sw_if_index);
@@ -699,6 +764,8 @@ acl_interface_del_inout_acl (u32 sw_if_index, u8 is_input, u32 acl_list_index)
 	{
 	  acl_interface_in_enable_disable (am, sw_if_index, 0);
 	}
+      else
+	acl_interface_fa_update (am, sw_if_index, 1, 1);
     }
   else
     {
@@ -718,6 +785,8 @@ acl_interface_del_inout_acl (u32 sw_if_index, u8 is_input, u32 acl_list_index)
 	{
 	  acl_interface_out_enable_disable (am, sw_if_index, 0);
 	}
+      else
+	acl_interface_fa_update (am, sw_if_index, 0, 1);
     }
   return rv;
 }
@@ -767,19 +836,19 @@ get_ptr_to_offset (vlib_buffer_t * b0, int offset)
 }
 
 static u8
-acl_get_l4_proto (vlib_buffer_t * b0, int node_is_ip6)
+acl_get_l4_proto (vlib_buffer_t * b0, int l3_offset, int node_is_ip6)
 {
   u8 proto;
   int proto_offset;
   if (node_is_ip6)
     {
-      proto_offset = 20;
+      proto_offset = 6;
     }
   else
     {
-      proto_offset = 23;
+      proto_offset = 9;
     }
-  proto = *((u8 *) vlib_buffer_get_current (b0) + proto_offset);
+  proto = *((u8 *) vlib_buffer_get_current (b0) + l3_offset + proto_offset);
   return proto;
 }
 
@@ -801,10 +870,10 @@ acl_match_addr (ip46_address_t * addr1, ip46_address_t * addr2, int prefixlen,
 	}
       if (prefixlen % 8)
 	{
-	  u8 b1 = *((u8 *) addr1 + 1 + prefixlen / 8);
-	  u8 b2 = *((u8 *) addr2 + 1 + prefixlen / 8);
+	  u8 b1 = *((u8 *) addr1 + prefixlen / 8);
+	  u8 b2 = *((u8 *) addr2 + prefixlen / 8);
 	  u8 mask0 = (0xff - ((1 << (8 - (prefixlen % 8))) - 1));
-	  return (b1 & mask0) == b2;
+	  return (b1 & mask0) == (b2 & mask0);
 	}
       else
 	{
@@ -816,8 +885,8 @@ acl_match_addr (ip46_address_t * addr1, ip46_address_t * addr2, int prefixlen,
     {
       uint32_t a1 = ntohl (addr1->ip4.as_u32);
       uint32_t a2 = ntohl (addr2->ip4.as_u32);
-      uint32_t mask0 = 0xffffffff - ((1 << (32 - prefixlen)) - 1);
-      return (a1 & mask0) == a2;
+      uint32_t mask0 = 0xffffffff - ((1ULL << (32 - prefixlen)) - 1);
+      return (a1 & mask0) == (a2 & mask0);
     }
 }
 
@@ -827,86 +896,106 @@ acl_match_port (u16 port, u16 port_first, u16 port_last, int is_ip6)
   return ((port >= port_first) && (port <= port_last));
 }
 
-static int
-acl_packet_match (acl_main_t * am, u32 acl_index, vlib_buffer_t * b0,
-		  u8 * r_action, int *r_is_ip6, u32 * r_acl_match_p,
-		  u32 * r_rule_match_p, u32 * trace_bitmap)
+/*
+ * Extract the 5-tuple used for matching from the IP header found
+ * l3_offset bytes into the buffer. Always succeeds, returns 1.
+ */
+int
+acl_fill_5tuple (vlib_buffer_t * b0, int l3_offset, int is_ip6,
+		 acl_5tuple_t * pkt_5tuple, u32 * trace_bitmap)
 {
-  ethernet_header_t *h0;
-  u16 type0;
-
-  ip46_address_t src, dst;
-  int is_ip6;
-  int is_ip4;
-  u8 proto;
-  u16 src_port = 0;
-  u16 dst_port = 0;
-  u8 tcp_flags = 0;
-  int i;
-  acl_list_t *a;
-  acl_rule_t *r;
-
-  h0 = vlib_buffer_get_current (b0);
-  type0 = clib_net_to_host_u16 (h0->type);
-  is_ip4 = (type0 == ETHERNET_TYPE_IP4);
-  is_ip6 = (type0 == ETHERNET_TYPE_IP6);
-
-  if (!(is_ip4 || is_ip6))
-    {
-      return 0;
-    }
+  memset (pkt_5tuple, 0, sizeof (*pkt_5tuple));
+  pkt_5tuple->is_ip6 = is_ip6;
   /* The bunch of hardcoded offsets here is intentional to get rid of them
      ASAP, when getting to a faster matching code */
-  if (is_ip4)
-    {
-      clib_memcpy (&src.ip4, get_ptr_to_offset (b0, 26), 4);
-      clib_memcpy (&dst.ip4, get_ptr_to_offset (b0, 30), 4);
-      proto = acl_get_l4_proto (b0, 0);
-      if (1 == proto)
+  if (!is_ip6)
+    {
+      clib_memcpy (&pkt_5tuple->addr[0].ip4,
+		   get_ptr_to_offset (b0, l3_offset + 12), 4);
+      clib_memcpy (&pkt_5tuple->addr[1].ip4,
+		   get_ptr_to_offset (b0, l3_offset + 16), 4);
+      pkt_5tuple->proto = acl_get_l4_proto (b0, l3_offset, 0);
+      if (1 == pkt_5tuple->proto)
 	{
 	  *trace_bitmap |= 0x00000001;
 	  /* type */
-	  src_port = ((u16) (*(u8 *) get_ptr_to_offset (b0, 34)));
+	  pkt_5tuple->port[0] =
+	    ((u16) (*(u8 *) get_ptr_to_offset (b0, l3_offset + 20)));
 	  /* code */
-	  dst_port = ((u16) (*(u8 *) get_ptr_to_offset (b0, 35)));
+	  pkt_5tuple->port[1] =
+	    ((u16) (*(u8 *) get_ptr_to_offset (b0, l3_offset + 21)));
 	} else {
 	  /* assume TCP/UDP */
-	  src_port = ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, 34)));
-	  dst_port = ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, 36)));
+	  pkt_5tuple->port[0] =
+	    ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, l3_offset + 20)));
+	  pkt_5tuple->port[1] =
+	    ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, l3_offset + 22)));
 	  /* UDP gets ability to check on an oddball data byte as a bonus */
-	  tcp_flags = *(u8 *) get_ptr_to_offset (b0, 14 + 20 + 13);
+	  pkt_5tuple->tcp_flags =
+	    *(u8 *) get_ptr_to_offset (b0, l3_offset + 20 + 13);
 	}
     }
   else /* is_ipv6 implicitly */
     {
-      clib_memcpy (&src, get_ptr_to_offset (b0, 22), 16);
-      clib_memcpy (&dst, get_ptr_to_offset (b0, 38), 16);
-      proto = acl_get_l4_proto (b0, 1);
-      if (58 == proto)
+      clib_memcpy (&pkt_5tuple->addr[0],
+		   get_ptr_to_offset (b0, l3_offset + 8), 16);
+      clib_memcpy (&pkt_5tuple->addr[1],
+		   get_ptr_to_offset (b0, l3_offset + 24), 16);
+      pkt_5tuple->proto = acl_get_l4_proto (b0, l3_offset, 1);
+      if (58 == pkt_5tuple->proto)
 	{
 	  *trace_bitmap |= 0x00000002;
 	  /* type */
-	  src_port = (u16) (*(u8 *) get_ptr_to_offset (b0, 54));
+	  pkt_5tuple->port[0] =
+	    (u16) (*(u8 *) get_ptr_to_offset (b0, l3_offset + 40));
 	  /* code */
-	  dst_port = (u16) (*(u8 *) get_ptr_to_offset (b0, 55));
+	  pkt_5tuple->port[1] =
+	    (u16) (*(u8 *) get_ptr_to_offset (b0, l3_offset + 41));
 	}
       else
 	{
 	  /* assume TCP/UDP */
-	  src_port = ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, 54)));
-	  dst_port = ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, 56)));
-	  tcp_flags = *(u8 *) get_ptr_to_offset (b0, 14 + 40 + 13);
+	  pkt_5tuple->port[0] =
+	    ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, l3_offset + 40)));
+	  pkt_5tuple->port[1] =
+	    ntohs ((u16) (*(u16 *) get_ptr_to_offset (b0, l3_offset + 42)));
+	  pkt_5tuple->tcp_flags =
+	    *(u8 *) get_ptr_to_offset (b0, l3_offset + 40 + 13);
 	}
     }
-  if (pool_is_free_index (am->acls, acl_index))
-    {
-      if (r_acl_match_p)
-	*r_acl_match_p = acl_index;
-      if (r_rule_match_p)
-	*r_rule_match_p = -1;
-      /* the ACL does not exist but is used for policy. Block traffic. */
-      return 0;
-    }
+  return 1;
+}
+
+/*
+ * Same for an ethernet frame on the L2 path.
+ * Returns 0 if the packet is neither IPv4 nor IPv6.
+ */
+static int
+acl_fill_5tuple_l2 (vlib_buffer_t * b0, acl_5tuple_t * pkt_5tuple,
+		    u32 * trace_bitmap)
+{
+  ethernet_header_t *h0;
+  u16 type0;
+
+  h0 = vlib_buffer_get_current (b0);
+  type0 = clib_net_to_host_u16 (h0->type);
+
+  if (type0 == ETHERNET_TYPE_IP4)
+    return acl_fill_5tuple (b0, sizeof (*h0), 0, pkt_5tuple, trace_bitmap);
+  if (type0 == ETHERNET_TYPE_IP6)
+    return acl_fill_5tuple (b0, sizeof (*h0), 1, pkt_5tuple, trace_bitmap);
+  return 0;
+}
+
+static int
+acl_linear_match_5tuple (acl_main_t * am, u32 acl_index,
+			 acl_5tuple_t * pkt_5tuple, u32 * r_rule_index)
+{
+  int is_ip6 = pkt_5tuple->is_ip6;
+  int i;
+  acl_list_t *a;
+  acl_rule_t *r;
+
   a = am->acls + acl_index;
   for (i = 0; i < a->count; i++)
     {
@@ -915,107 +1004,153 @@ acl_packet_match (acl_main_t * am, u32 acl_index, vlib_buffer_t * b0,
 	{
 	  continue;
 	}
-      if (!acl_match_addr (&dst, &r->dst, r->dst_prefixlen, is_ip6))
+      if (!acl_match_addr
+	  (&pkt_5tuple->addr[1], &r->dst, r->dst_prefixlen, is_ip6))
 	continue;
-      if (!acl_match_addr (&src, &r->src, r->src_prefixlen, is_ip6))
+      if (!acl_match_addr
+	  (&pkt_5tuple->addr[0], &r->src, r->src_prefixlen, is_ip6))
 	continue;
       if (r->proto)
 	{
-	  if (proto != r->proto)
+	  if (pkt_5tuple->proto != r->proto)
 	    continue;
 	  if (!acl_match_port
-	      (src_port, r->src_port_or_type_first, r->src_port_or_type_last,
-	       is_ip6))
+	      (pkt_5tuple->port[0], r->src_port_or_type_first,
+	       r->src_port_or_type_last, is_ip6))
 	    continue;
 	  if (!acl_match_port
-	      (dst_port, r->dst_port_or_code_first, r->dst_port_or_code_last,
-	       is_ip6))
+	      (pkt_5tuple->port[1], r->dst_port_or_code_first,
+	       r->dst_port_or_code_last, is_ip6))
 	    continue;
 	  /* No need for check of proto == TCP, since in other rules both fields should be zero, so this match will succeed */
-	  if ((tcp_flags & r->tcp_flags_mask) != r->tcp_flags_value)
+	  if ((pkt_5tuple->tcp_flags & r->tcp_flags_mask) !=
+	      r->tcp_flags_value)
 	    continue;
 	}
       /* everything matches! */
-      *r_action = r->is_permit;
-      *r_is_ip6 = is_ip6;
+      *r_rule_index = i;
+      return 1;
+    }
+  return 0;
+}
+
+static int
+acl_packet_match (acl_main_t * am, u32 acl_index, acl_5tuple_t * pkt_5tuple,
+		  u8 * r_action, u32 * r_acl_match_p, u32 * r_rule_match_p)
+{
+  u32 rule_index;
+  int matched;
+
+  if (pool_is_free_index (am->acls, acl_index))
+    {
       if (r_acl_match_p)
 	*r_acl_match_p = acl_index;
       if (r_rule_match_p)
-	*r_rule_match_p = i;
-      return 1;
+	*r_rule_match_p = -1;
+      /* the ACL does not exist but is used for policy. Block traffic. */
+      return 0;
     }
-  return 0;
+  if (am->use_hash_acl_matching)
+    matched = acl_hash_match_5tuple (am, acl_index, pkt_5tuple,
+				     os_get_cpu_number (), &rule_index);
+  else
+    matched = acl_linear_match_5tuple (am, acl_index, pkt_5tuple,
+				       &rule_index);
+  if (!matched)
+    return 0;
+
+  *r_action = am->acls[acl_index].rules[rule_index].is_permit;
+  if (r_acl_match_p)
+    *r_acl_match_p = acl_index;
+  if (r_rule_match_p)
+    *r_rule_match_p = rule_index;
+  return 1;
 }
 
-void
-input_acl_packet_match (u32 sw_if_index, vlib_buffer_t * b0, u32 * nextp,
-			u32 * acl_match_p, u32 * rule_match_p,
-			u32 * trace_bitmap)
+/*
+ * First match across the ACLs applied in order.
+ * Returns 1 and sets the action if any rule matched, 0 otherwise.
+ */
+int
+acl_match_5tuple (acl_main_t * am, u32 * acl_vec, acl_5tuple_t * pkt_5tuple,
+		  u8 * r_action, u32 * r_acl_match_p, u32 * r_rule_match_p)
 {
-  acl_main_t *am = &acl_main;
-  uint8_t action = 0;
-  int is_ip6 = 0;
   int i;
-  vec_validate (am->input_acl_vec_by_sw_if_index, sw_if_index);
-  for (i = 0; i < vec_len (am->input_acl_vec_by_sw_if_index[sw_if_index]);
-       i++)
+
+  for (i = 0; i < vec_len (acl_vec); i++)
+    {
+      if (acl_packet_match (am, acl_vec[i], pkt_5tuple, r_action,
+			    r_acl_match_p, r_rule_match_p))
+	return 1;
+    }
+  return 0;
+}
+
+static void
+acl_packet_match_acl_vec (acl_main_t * am, u32 thread_index, u64 now,
+			  u32 sw_if_index, int is_input, u32 * acl_vec,
+			  vlib_buffer_t * b0, u32 * next_by_action_ip4,
+			  u32 * next_by_action_ip6, u32 * nextp,
+			  u32 * acl_match_p, u32 * rule_match_p,
+			  u32 * trace_bitmap)
+{
+  acl_5tuple_t pkt_5tuple;
+  acl_fa_session_result_t session_result;
+  u8 action;
+
+  if (vec_len (acl_vec) == 0)
+    return;
+
+  if (acl_fill_5tuple_l2 (b0, &pkt_5tuple, trace_bitmap))
     {
-      if (acl_packet_match
-	  (am, am->input_acl_vec_by_sw_if_index[sw_if_index][i], b0, &action,
-	   &is_ip6, acl_match_p, rule_match_p, trace_bitmap))
+      action = acl_fa_match (am, thread_index, now, sw_if_index, is_input,
+			     acl_vec, &pkt_5tuple, acl_match_p,
+			     rule_match_p, &session_result);
+      if (action)
 	{
-	  if (is_ip6)
+	  if (pkt_5tuple.is_ip6)
 	    {
-	      *nextp = am->acl_in_ip6_match_next[action];
+	      *nextp = next_by_action_ip6[action];
 	    }
 	  else
 	    {
-	      *nextp = am->acl_in_ip4_match_next[action];
+	      *nextp = next_by_action_ip4[action];
 	    }
 	  return;
 	}
     }
-  if (vec_len (am->input_acl_vec_by_sw_if_index[sw_if_index]) > 0)
-    {
-      /* If there are ACLs and none matched, deny by default */
-      *nextp = 0;
-    }
+  /* If there are ACLs and none matched, deny by default */
+  *nextp = 0;
+}
 
+void
+input_acl_packet_match (u32 thread_index, u64 now, u32 sw_if_index,
+			vlib_buffer_t * b0, u32 * nextp, u32 * acl_match_p,
+			u32 * rule_match_p, u32 * trace_bitmap)
+{
+  acl_main_t *am = &acl_main;
+  vec_validate (am->input_acl_vec_by_sw_if_index, sw_if_index);
+  acl_packet_match_acl_vec (am, thread_index, now, sw_if_index,
+			    1 /* is_input */ ,
+			    am->input_acl_vec_by_sw_if_index[sw_if_index],
+			    b0, am->acl_in_ip4_match_next,
+			    am->acl_in_ip6_match_next, nextp, acl_match_p,
+			    rule_match_p, trace_bitmap);
 }
 
 void
-output_acl_packet_match (u32 sw_if_index, vlib_buffer_t * b0, u32 * nextp,
-			 u32 * acl_match_p, u32 * rule_match_p,
-			 u32 * trace_bitmap)
+output_acl_packet_match (u32 thread_index, u64 now, u32 sw_if_index,
+			 vlib_buffer_t * b0, u32 * nextp, u32 * acl_match_p,
+			 u32 * rule_match_p, u32 * trace_bitmap)
 {
   acl_main_t *am = &acl_main;
-  uint8_t action = 0;
-  int is_ip6 = 0;
-  int i;
   vec_validate (am->output_acl_vec_by_sw_if_index, sw_if_index);
-  for (i = 0; i < vec_len (am->output_acl_vec_by_sw_if_index[sw_if_index]);
-       i++)
-    {
-      if (acl_packet_match
-	  (am, am->output_acl_vec_by_sw_if_index[sw_if_index][i], b0, &action,
-	   &is_ip6, acl_match_p, rule_match_p, trace_bitmap))
-	{
-	  if (is_ip6)
-	    {
-	      *nextp = am->acl_out_ip6_match_next[action];
-	    }
-	  else
-	    {
-	      *nextp = am->acl_out_ip4_match_next[action];
-	    }
-	  return;
-	}
-    }
-  if (vec_len (am->output_acl_vec_by_sw_if_index[sw_if_index]) > 0)
-    {
-      /* If there are ACLs and none matched, deny by default */
-      *nextp = 0;
-    }
+  acl_packet_match_acl_vec (am, thread_index, now, sw_if_index,
+			    0 /* is_input */ ,
+			    am->output_acl_vec_by_sw_if_index[sw_if_index],
+			    b0, am->acl_out_ip4_match_next,
+			    am->acl_out_ip6_match_next, nextp, acl_match_p,
+			    rule_match_p, trace_bitmap);
 }
 
 typedef struct
@@ -1899,10 +2034,100 @@ acl_setup_nodes (void)
 
   register_match_action_nexts (0, 0, 0, 0);	/* drop */
   register_match_action_nexts (~0, ~0, ~0, ~0);	/* permit */
-  register_match_action_nexts (ACL_IN_L2S_INPUT_IP4_ADD, ACL_IN_L2S_INPUT_IP6_ADD, ACL_OUT_L2S_OUTPUT_IP4_ADD, ACL_OUT_L2S_OUTPUT_IP6_ADD);	/* permit + create session */
+  register_match_action_nexts (~0, ~0, ~0, ~0);	/* permit + create session */
+}
+
+
+static clib_error_t *
+acl_set_aclplugin_fn (vlib_main_t * vm,
+		      unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  acl_main_t *am = &acl_main;
+  u32 timeout_type;
+  u64 timeout;
+
+  if (unformat (input, "lookup hash"))
+    am->use_hash_acl_matching = 1;
+  else if (unformat (input, "lookup linear"))
+    am->use_hash_acl_matching = 0;
+  else if (unformat (input, "session timeout %U %lld",
+		     unformat_acl_fa_timeout, &timeout_type, &timeout))
+    {
+      if (timeout == 0)
+	return clib_error_return (0, "timeout must be non-zero");
+      am->session_timeout_sec[timeout_type] = timeout;
+    }
+  else
+    return clib_error_return (0, "unknown input '%U'",
+			      format_unformat_error, input);
+  return 0;
+}
+
+static clib_error_t *
+acl_show_aclplugin_tables_fn (vlib_main_t * vm,
+			      unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
+{
+  acl_main_t *am = &acl_main;
+  acl_list_t *a;
+
+  vlib_cli_output (vm, "ACL lookup: %s",
+		   am->use_hash_acl_matching ? "hash" : "linear");
+  acl_hash_show_mask_types (vm, am);
+  /* *INDENT-OFF* */
+  pool_foreach (a, am->acls,
+  ({
+    acl_hash_show_acl (vm, am, a - am->acls);
+  }));
+  /* *INDENT-ON* */
+  if (am->acl_lookup_hash_initialized)
+    vlib_cli_output (vm, "%U", format_bihash_48_8, &am->acl_lookup_hash,
+		     0 /* verbose */ );
+  return 0;
 }
 
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (aclplugin_set_command, static) = {
+    .path = "set acl-plugin",
+    .short_help = "set acl-plugin lookup {hash|linear} | session timeout "
+                  "{udp idle|tcp idle|tcp transient} <sec>",
+    .function = acl_set_aclplugin_fn,
+};
+
+VLIB_CLI_COMMAND (aclplugin_show_tables_command, static) = {
+    .path = "show acl-plugin tables",
+    .short_help = "show acl-plugin tables",
+    .function = acl_show_aclplugin_tables_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+acl_plugin_config (vlib_main_t * vm, unformat_input_t * input)
+{
+  acl_main_t *am = &acl_main;
+  u32 conn_table_hash_buckets;
+  u32 conn_table_hash_memory_size;
+  u32 conn_table_max_entries;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat
+	  (input, "connection hash buckets %d", &conn_table_hash_buckets))
+	am->fa_conn_table_hash_num_buckets = conn_table_hash_buckets;
+      else if (unformat (input, "connection hash memory %d",
+			 &conn_table_hash_memory_size))
+	am->fa_conn_table_hash_memory_size = conn_table_hash_memory_size;
+      else if (unformat (input, "connection count max %d",
+			 &conn_table_max_entries))
+	am->fa_conn_table_max_entries = conn_table_max_entries;
+      else
+	return clib_error_return (0, "unknown input '%U'",
+				  format_unformat_error, input);
+    }
+  return 0;
+}
 
+VLIB_CONFIG_FUNCTION (acl_plugin_config, "acl-plugin");
 
 static clib_error_t *
 acl_init (vlib_main_t * vm)
@@ -1912,6 +2137,21 @@ acl_init (vlib_main_t * vm)
   memset (am, 0, sizeof (*am));
   am->vlib_main = vm;
   am->vnet_main = vnet_get_main ();
+  am->use_hash_acl_matching = 1;
+  am->hash_lookup_hash_buckets = ACL_PLUGIN_HASH_LOOKUP_HASH_BUCKETS;
+  am->hash_lookup_hash_memory = ACL_PLUGIN_HASH_LOOKUP_HASH_MEMORY;
+
+  am->fa_conn_table_hash_num_buckets =
+    ACL_FA_CONN_TABLE_DEFAULT_HASH_NUM_BUCKETS;
+  am->fa_conn_table_hash_memory_size =
+    ACL_FA_CONN_TABLE_DEFAULT_HASH_MEMORY_SIZE;
+  am->fa_conn_table_max_entries = ACL_FA_CONN_TABLE_DEFAULT_MAX_ENTRIES;
+  am->session_timeout_sec[ACL_TIMEOUT_TCP_TRANSIENT] =
+    TCP_SESSION_TRANSIENT_TIMEOUT_SEC;
+  am->session_timeout_sec[ACL_TIMEOUT_TCP_IDLE] =
+    TCP_SESSION_IDLE_TIMEOUT_SEC;
+  am->session_timeout_sec[ACL_TIMEOUT_UDP_IDLE] =
+    UDP_SESSION_IDLE_TIMEOUT_SEC;
 
   u8 *name = format (0, "acl_%08x%c", api_version, 0);
 
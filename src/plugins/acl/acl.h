@@ -24,14 +24,20 @@
 #include <vppinfra/error.h>
 #include <vppinfra/elog.h>
 
+#include <acl/hash_lookup_types.h>
+#include <acl/fa_node.h>
+
 #define  ACL_PLUGIN_VERSION_MAJOR 1
 #define  ACL_PLUGIN_VERSION_MINOR 1
 
+#define ACL_PLUGIN_HASH_LOOKUP_HASH_BUCKETS 65536
+#define ACL_PLUGIN_HASH_LOOKUP_HASH_MEMORY (2 << 25)
+
 extern vlib_node_registration_t acl_in_node;
 extern vlib_node_registration_t acl_out_node;
 
-void input_acl_packet_match(u32 sw_if_index, vlib_buffer_t * b0, u32 *nextp, u32 *acl_match_p, u32 *rule_match_p, u32 *trace_bitmap);
-void output_acl_packet_match(u32 sw_if_index, vlib_buffer_t * b0, u32 *nextp, u32 *acl_match_p, u32 *rule_match_p, u32 *trace_bitmap);
+void input_acl_packet_match(u32 thread_index, u64 now, u32 sw_if_index, vlib_buffer_t * b0, u32 *nextp, u32 *acl_match_p, u32 *rule_match_p, u32 *trace_bitmap);
+void output_acl_packet_match(u32 thread_index, u64 now, u32 sw_if_index, vlib_buffer_t * b0, u32 *nextp, u32 *acl_match_p, u32 *rule_match_p, u32 *trace_bitmap);
 
 enum address_e { IP4, IP6 };
 typedef struct
@@ -114,6 +120,36 @@ typedef struct {
   u32 *acl_ip4_output_classify_table_by_sw_if_index;
   u32 *acl_ip6_output_classify_table_by_sw_if_index;
 
+  /* Compiled tuple-space lookup state, see hash_lookup.c */
+  int use_hash_acl_matching;
+  clib_bihash_48_8_t acl_lookup_hash;
+  u32 hash_lookup_hash_buckets;
+  u32 hash_lookup_hash_memory;
+  int acl_lookup_hash_initialized;
+  acl_hash_acl_t *hash_acl_infos;	/* by ACL index */
+  acl_hash_mask_type_t *hash_mask_type_pool;
+  /* per-thread vectors of per-mask-type hit counters */
+  u64 **hash_mask_type_hits_by_thread;
+
+  /* Flow-aware sessions, see fa_node.c */
+  acl_fa_per_worker_data_t *per_worker_data;
+  /*
+   * forward and reverse keys of every worker's sessions: one table
+   * shared by all workers, writers serialize on the bucket locks
+   */
+  clib_bihash_48_8_t fa_session_hash;
+  f64 fa_cpu_clocks_per_second;
+  int fa_sessions_initialized;
+  u32 fa_timer_client_index;
+  u32 fa_conn_table_hash_num_buckets;
+  uword fa_conn_table_hash_memory_size;
+  /* total, split evenly across the threads' session pools */
+  u64 fa_conn_table_max_entries;
+  u64 session_timeout_sec[ACL_N_TIMEOUTS];
+  /* interfaces with the IP feature arc nodes enabled */
+  uword *fa_in_acl_on_sw_if_index;
+  uword *fa_out_acl_on_sw_if_index;
+
   /* MACIP (input) ACLs associated with the interfaces */
   u32 *macip_acl_by_sw_if_index;
 
@@ -141,5 +177,21 @@ typedef struct {
 
 extern acl_main_t acl_main;
 
+int acl_fill_5tuple (vlib_buffer_t * b0, int l3_offset, int is_ip6,
+		     acl_5tuple_t * pkt_5tuple, u32 * trace_bitmap);
+int acl_match_5tuple (acl_main_t * am, u32 * acl_vec,
+		      acl_5tuple_t * pkt_5tuple, u8 * r_action,
+		      u32 * r_acl_match_p, u32 * r_rule_match_p);
+
+u8 acl_fa_match (acl_main_t * am, u32 thread_index, u64 now,
+		 u32 sw_if_index, int is_input, u32 * acl_vec,
+		 acl_5tuple_t * pkt_5tuple, u32 * acl_match_p,
+		 u32 * rule_match_p, acl_fa_session_result_t * r_session);
+void acl_fa_enable_disable (u32 sw_if_index, int is_input,
+			    int enable_disable);
+void acl_fa_sessions_flush_sw_if_index (acl_main_t * am, u32 sw_if_index);
+format_function_t format_acl_fa_timeout;
+unformat_function_t unformat_acl_fa_timeout;
+
 
 #endif
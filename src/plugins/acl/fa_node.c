@@ -0,0 +1,823 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stddef.h>
+#include <vlib/vlib.h>
+#include <vnet/vnet.h>
+#include <vnet/pg/pg.h>
+#include <vnet/feature/feature.h>
+#include <vnet/tcp/tcp_packet.h>
+#include <vppinfra/error.h>
+#include <acl/acl.h>
+
+
+static_always_inline acl_fa_per_worker_data_t *
+acl_fa_get_per_worker_data (acl_main_t * am, u32 thread_index)
+{
+  return vec_elt_at_index (am->per_worker_data, thread_index);
+}
+
+static_always_inline void
+acl_fa_make_session_key (acl_5tuple_t * pkt_5tuple, u32 sw_if_index,
+			 int is_reverse, acl_fa_session_key_t * key)
+{
+  key->addr[0] = pkt_5tuple->addr[is_reverse];
+  key->addr[1] = pkt_5tuple->addr[!is_reverse];
+  /* ICMP flows are tracked per address pair, type/code do not mirror */
+  if (pkt_5tuple->proto == IP_PROTOCOL_ICMP
+      || pkt_5tuple->proto == IP_PROTOCOL_ICMP6)
+    {
+      key->port[0] = key->port[1] = 0;
+    }
+  else
+    {
+      key->port[0] = pkt_5tuple->port[is_reverse];
+      key->port[1] = pkt_5tuple->port[!is_reverse];
+    }
+  key->proto = pkt_5tuple->proto;
+  key->is_ip6 = pkt_5tuple->is_ip6;
+  key->pad0 = 0;
+  key->sw_if_index = sw_if_index;
+  key->pad1 = 0;
+}
+
+static_always_inline acl_timeout_e
+acl_fa_session_timeout_type (acl_fa_session_t * sess)
+{
+  u8 flags_both;
+
+  if (sess->key.proto != IP_PROTOCOL_TCP)
+    return ACL_TIMEOUT_UDP_IDLE;
+
+  flags_both = sess->tcp_flags_seen[0] & sess->tcp_flags_seen[1];
+  /* SYN seen both ways and no FIN/RST anywhere: established */
+  if ((flags_both & TCP_FLAG_SYN)
+      && !((sess->tcp_flags_seen[0] | sess->tcp_flags_seen[1])
+	   & (TCP_FLAG_FIN | TCP_FLAG_RST)))
+    return ACL_TIMEOUT_TCP_IDLE;
+  return ACL_TIMEOUT_TCP_TRANSIENT;
+}
+
+static_always_inline u64
+acl_fa_session_timeout (acl_main_t * am, acl_fa_session_t * sess)
+{
+  return am->session_timeout_sec[acl_fa_session_timeout_type (sess)];
+}
+
+/*
+ * A FIN or RST seen by another worker moves an established session to
+ * the transient timeout without touching the timer, so look at an
+ * established session at least that often.
+ */
+static_always_inline f64
+acl_fa_session_timer_delay (acl_main_t * am, acl_fa_session_t * sess,
+			    f64 remaining)
+{
+  if (acl_fa_session_timeout_type (sess) == ACL_TIMEOUT_TCP_IDLE)
+    return clib_min (remaining,
+		     am->session_timeout_sec[ACL_TIMEOUT_TCP_TRANSIENT]);
+  return remaining;
+}
+
+static void
+acl_fa_session_hash_add_del (acl_main_t * am, acl_fa_per_worker_data_t * pw,
+			     acl_fa_session_t * sess, int is_add)
+{
+  clib_bihash_kv_48_8_t kv, result;
+  acl_fa_session_key_t *key = (acl_fa_session_key_t *) & kv.key;
+  acl_fa_session_id_t id;
+  int is_reverse;
+
+  id.session_index = sess - pw->sessions;
+  id.thread_index = pw - am->per_worker_data;
+  id.pad0 = 0;
+  clib_memcpy (key, &sess->key, sizeof (*key));
+
+  for (is_reverse = 0; is_reverse < 2; is_reverse++)
+    {
+      if (is_reverse)
+	{
+	  /* the reverse key is the forward one with the ends swapped */
+	  key->addr[0] = sess->key.addr[1];
+	  key->addr[1] = sess->key.addr[0];
+	  key->port[0] = sess->key.port[1];
+	  key->port[1] = sess->key.port[0];
+	}
+      id.is_reverse = is_reverse;
+      kv.value = id.as_u64;
+      /*
+       * Two workers racing to create the same flow both add it, and the
+       * last one wins the keys: the loser must not delete them.
+       */
+      if (!is_add
+	  && (clib_bihash_search_48_8 (&am->fa_session_hash, &kv, &result)
+	      || result.value != kv.value))
+	continue;
+      clib_bihash_add_del_48_8 (&am->fa_session_hash, &kv, is_add);
+    }
+}
+
+static void
+acl_fa_session_del (acl_main_t * am, acl_fa_per_worker_data_t * pw,
+		    acl_fa_session_t * sess)
+{
+  acl_fa_session_hash_add_del (am, pw, sess, 0 /* is_add */ );
+  pool_put (pw->sessions, sess);
+  pw->n_sessions_deleted++;
+}
+
+static_always_inline f64
+acl_fa_session_idle_time (acl_main_t * am, acl_fa_session_t * sess, u64 now)
+{
+  u64 last_active_time = sess->last_active_time;
+
+  /* other workers' clocks may be slightly ahead of ours */
+  if (last_active_time >= now)
+    return 0;
+  return (now - last_active_time) / am->fa_cpu_clocks_per_second;
+}
+
+static void
+acl_fa_session_timers_expired (vlib_main_t * vm, u32 * session_indices)
+{
+  acl_main_t *am = &acl_main;
+  acl_fa_per_worker_data_t *pw =
+    acl_fa_get_per_worker_data (am, vm->cpu_index);
+  acl_fa_session_t *sess;
+  u64 now = clib_cpu_time_now ();
+  f64 idle, timeout;
+  int i;
+
+  for (i = 0; i < vec_len (session_indices); i++)
+    {
+      sess = pool_elt_at_index (pw->sessions, session_indices[i]);
+      sess->timer_handle = ~0;
+
+      idle = acl_fa_session_idle_time (am, sess, now);
+      timeout = acl_fa_session_timeout (am, sess);
+      if (idle >= timeout)
+	{
+	  acl_fa_session_del (am, pw, sess);
+	  continue;
+	}
+      /* Active since the timer was started, wait for the remainder */
+      sess->timer_handle =
+	vlib_timer_start (vm, am->fa_timer_client_index, session_indices[i],
+			  acl_fa_session_timer_delay (am, sess,
+						      timeout - idle));
+    }
+}
+
+static int
+acl_fa_session_find (acl_main_t * am, acl_5tuple_t * pkt_5tuple,
+		     u32 sw_if_index, clib_bihash_kv_48_8_t * result)
+{
+  clib_bihash_kv_48_8_t kv;
+
+  acl_fa_make_session_key (pkt_5tuple, sw_if_index, 0,
+			   (acl_fa_session_key_t *) & kv.key);
+  return (clib_bihash_search_inline_2_48_8 (&am->fa_session_hash, &kv,
+					    result) == 0);
+}
+
+static void
+acl_fa_session_track (acl_fa_session_t * sess, acl_5tuple_t * pkt_5tuple,
+		      int is_reverse, u64 now)
+{
+  u8 flags;
+
+  sess->last_active_time = now;
+  if (sess->key.proto != IP_PROTOCOL_TCP)
+    return;
+  /* Any worker may add flags; a new flag is rare, test before locking */
+  flags = pkt_5tuple->tcp_flags;
+  if (PREDICT_FALSE ((sess->tcp_flags_seen[is_reverse] & flags) != flags))
+    __sync_fetch_and_or (&sess->tcp_flags_seen[is_reverse], flags);
+}
+
+static acl_fa_session_result_t
+acl_fa_session_add (acl_main_t * am, acl_fa_per_worker_data_t * pw,
+		    acl_5tuple_t * pkt_5tuple, u32 sw_if_index, int is_input,
+		    u64 now)
+{
+  acl_fa_session_t *sess;
+  u32 session_index;
+
+  /* the pool was preallocated for this many, it must not grow */
+  if (pool_elts (pw->sessions) >= pw->max_sessions)
+    {
+      pw->n_sessions_add_failed++;
+      return ACL_FA_SESSION_TABLE_FULL;
+    }
+
+  pool_get_aligned (pw->sessions, sess, CLIB_CACHE_LINE_BYTES);
+  memset (sess, 0, sizeof (*sess));
+  session_index = sess - pw->sessions;
+  acl_fa_make_session_key (pkt_5tuple, sw_if_index, 0, &sess->key);
+  sess->is_input = is_input;
+  acl_fa_session_track (sess, pkt_5tuple, 0, now);
+  acl_fa_session_hash_add_del (am, pw, sess, 1 /* is_add */ );
+  sess->timer_handle =
+    vlib_timer_start (vlib_get_main (), am->fa_timer_client_index,
+		      session_index,
+		      acl_fa_session_timer_delay (am, sess,
+						  acl_fa_session_timeout (am,
+									  sess)));
+  pw->n_sessions_added++;
+  return ACL_FA_SESSION_NEW;
+}
+
+/*
+ * Another worker's session may be freed, and its slot reused, at any
+ * time; the pool itself never moves. Check that the slot still holds
+ * the flow the hash pointed us at.
+ */
+static_always_inline int
+acl_fa_session_key_matches (acl_fa_session_t * sess,
+			    acl_5tuple_t * pkt_5tuple, u32 sw_if_index,
+			    int is_reverse)
+{
+  acl_fa_session_key_t key;
+
+  acl_fa_make_session_key (pkt_5tuple, sw_if_index, is_reverse, &key);
+  return !memcmp (&key, &sess->key, sizeof (key));
+}
+
+u8
+acl_fa_match (acl_main_t * am, u32 thread_index, u64 now, u32 sw_if_index,
+	      int is_input, u32 * acl_vec, acl_5tuple_t * pkt_5tuple,
+	      u32 * acl_match_p, u32 * rule_match_p,
+	      acl_fa_session_result_t * r_session)
+{
+  clib_bihash_kv_48_8_t result;
+  acl_fa_per_worker_data_t *owner;
+  acl_fa_session_id_t id;
+  acl_fa_session_t *sess;
+  u8 action = 0;
+
+  *r_session = ACL_FA_SESSION_NONE;
+  if (am->fa_sessions_initialized
+      && acl_fa_session_find (am, pkt_5tuple, sw_if_index, &result))
+    {
+      id.as_u64 = result.value;
+      owner = acl_fa_get_per_worker_data (am, id.thread_index);
+      sess = owner->sessions + id.session_index;
+      if (PREDICT_TRUE (id.thread_index == thread_index)
+	  || acl_fa_session_key_matches (sess, pkt_5tuple, sw_if_index,
+					 id.is_reverse))
+	{
+	  acl_fa_session_track (sess, pkt_5tuple, id.is_reverse, now);
+	  if (id.thread_index != thread_index)
+	    acl_fa_get_per_worker_data (am,
+					thread_index)->n_foreign_session_hits++;
+	  *r_session = ACL_FA_SESSION_EXISTING;
+	  return 1;
+	}
+    }
+
+  if (!acl_match_5tuple (am, acl_vec, pkt_5tuple, &action, acl_match_p,
+			 rule_match_p))
+    action = 0;
+
+  if (PREDICT_FALSE (action == 2))
+    {
+      /* permit+reflect */
+      if (am->fa_sessions_initialized)
+	*r_session =
+	  acl_fa_session_add (am, acl_fa_get_per_worker_data (am,
+							      thread_index),
+			      pkt_5tuple, sw_if_index, is_input, now);
+      action = 1;
+    }
+  return action;
+}
+
+static void
+acl_fa_init_per_worker_data (acl_main_t * am)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  acl_fa_per_worker_data_t *pw;
+  u32 n_threads = tm->n_vlib_mains;
+
+  if (am->fa_sessions_initialized)
+    return;
+
+  am->fa_timer_client_index =
+    vlib_timer_client_register ("acl-plugin-fa-sessions",
+				acl_fa_session_timers_expired);
+
+  am->fa_cpu_clocks_per_second =
+    vlib_get_main ()->clib_time.clocks_per_second;
+  clib_bihash_init_48_8 (&am->fa_session_hash, "ACL plugin FA sessions",
+			 am->fa_conn_table_hash_num_buckets,
+			 am->fa_conn_table_hash_memory_size);
+
+  /*
+   * The session limit is split evenly between the threads. Other workers
+   * refresh sessions in place, so each pool is preallocated to its share
+   * and must not move.
+   */
+  vec_validate (am->per_worker_data, n_threads - 1);
+  vec_foreach (pw, am->per_worker_data)
+  {
+    pw->max_sessions =
+      (am->fa_conn_table_max_entries + n_threads - 1) / n_threads;
+    pool_alloc_aligned (pw->sessions, pw->max_sessions,
+			CLIB_CACHE_LINE_BYTES);
+  }
+  am->fa_sessions_initialized = 1;
+}
+
+void
+acl_fa_enable_disable (u32 sw_if_index, int is_input, int enable_disable)
+{
+  acl_main_t *am = &acl_main;
+  uword **bitmap = is_input ? &am->fa_in_acl_on_sw_if_index :
+    &am->fa_out_acl_on_sw_if_index;
+
+  if (clib_bitmap_get (*bitmap, sw_if_index) == (enable_disable != 0))
+    return;
+  *bitmap = clib_bitmap_set (*bitmap, sw_if_index, enable_disable != 0);
+
+  if (enable_disable)
+    acl_fa_init_per_worker_data (am);
+
+  if (is_input)
+    {
+      vnet_feature_enable_disable ("ip4-unicast", "acl-plugin-in-ip4-fa",
+				   sw_if_index, enable_disable, 0, 0);
+      vnet_feature_enable_disable ("ip6-unicast", "acl-plugin-in-ip6-fa",
+				   sw_if_index, enable_disable, 0, 0);
+    }
+  else
+    {
+      vnet_feature_enable_disable ("ip4-output", "acl-plugin-out-ip4-fa",
+				   sw_if_index, enable_disable, 0, 0);
+      vnet_feature_enable_disable ("ip6-output", "acl-plugin-out-ip6-fa",
+				   sw_if_index, enable_disable, 0, 0);
+    }
+
+  if (!enable_disable)
+    acl_fa_sessions_flush_sw_if_index (am, sw_if_index);
+}
+
+/*
+ * Called with the workers stopped at the barrier, so it is safe to
+ * modify their tables from the main thread.
+ */
+void
+acl_fa_sessions_flush_sw_if_index (acl_main_t * am, u32 sw_if_index)
+{
+  acl_fa_per_worker_data_t *pw;
+  acl_fa_session_t *sess;
+  vlib_main_t *wvm;
+  u32 *to_delete = 0;
+  u32 *si;
+
+  if (!am->fa_sessions_initialized)
+    return;
+
+  vec_foreach (pw, am->per_worker_data)
+  {
+    /* timers live on the session owner's thread */
+    wvm = vec_len (vlib_mains) ?
+      vlib_mains[pw - am->per_worker_data] : vlib_get_main ();
+    vec_reset_length (to_delete);
+    /* *INDENT-OFF* */
+    pool_foreach (sess, pw->sessions,
+    ({
+      if (sess->key.sw_if_index == sw_if_index)
+        vec_add1 (to_delete, sess - pw->sessions);
+    }));
+    /* *INDENT-ON* */
+    vec_foreach (si, to_delete)
+    {
+      sess = pool_elt_at_index (pw->sessions, *si);
+      if (sess->timer_handle != ~0)
+	vlib_timer_stop (wvm, sess->timer_handle);
+      acl_fa_session_del (am, pw, sess);
+    }
+  }
+  vec_free (to_delete);
+}
+
+typedef struct
+{
+  u32 next_index;
+  u32 sw_if_index;
+  u32 match_acl_index;
+  u32 match_rule_index;
+  u32 trace_bitmap;
+  u8 session_result;
+} acl_fa_trace_t;
+
+static u8 *
+format_acl_fa_trace (u8 * s, va_list * args)
+{
+  CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
+  CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
+  acl_fa_trace_t *t = va_arg (*args, acl_fa_trace_t *);
+
+  s =
+    format (s,
+	    "acl-plugin: sw_if_index %d, next index %d, session %d, "
+	    "match: acl %d rule %d trace_bits %08x",
+	    t->sw_if_index, t->next_index, t->session_result,
+	    t->match_acl_index, t->match_rule_index, t->trace_bitmap);
+  return s;
+}
+
+#define foreach_acl_fa_error \
+_(ACL_DROP, "ACL deny packets")  \
+_(ACL_PERMIT, "ACL permit packets")  \
+_(ACL_NEW_SESSION, "new sessions added") \
+_(ACL_EXIST_SESSION, "existing session packets") \
+_(ACL_TOO_MANY_SESSIONS, "number of sessions reached maximum")
+
+typedef enum
+{
+#define _(sym,str) ACL_FA_ERROR_##sym,
+  foreach_acl_fa_error
+#undef _
+    ACL_FA_N_ERROR,
+} acl_fa_error_t;
+
+static char *acl_fa_error_strings[] = {
+#define _(sym,string) string,
+  foreach_acl_fa_error
+#undef _
+};
+
+typedef enum
+{
+  ACL_FA_ERROR_DROP,
+  ACL_FA_N_NEXT,
+} acl_fa_next_t;
+
+always_inline uword
+acl_fa_node_fn (vlib_main_t * vm,
+		vlib_node_runtime_t * node, vlib_frame_t * frame, int is_ip6,
+		int is_input)
+{
+  u32 n_left_from, *from, *to_next;
+  acl_fa_next_t next_index;
+  acl_main_t *am = &acl_main;
+  u32 **acl_vec_by_sw_if_index = is_input ?
+    am->input_acl_vec_by_sw_if_index : am->output_acl_vec_by_sw_if_index;
+  u32 pkts_acl_permit = 0;
+  u32 pkts_new_session = 0;
+  u32 pkts_exist_session = 0;
+  u32 pkts_too_many_sessions = 0;
+  u64 now = clib_cpu_time_now ();
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+  next_index = node->cached_next_index;
+
+  while (n_left_from > 0)
+    {
+      u32 n_left_to_next;
+
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      while (n_left_from > 0 && n_left_to_next > 0)
+	{
+	  u32 bi0;
+	  vlib_buffer_t *b0;
+	  u32 next0 = 0;
+	  u8 action = 0;
+	  u32 sw_if_index0;
+	  int l3_offset;
+	  acl_5tuple_t pkt_5tuple;
+	  acl_fa_session_result_t session_result;
+	  u32 match_acl_index = ~0;
+	  u32 match_rule_index = ~0;
+	  u32 trace_bitmap = 0;
+
+	  /* speculatively enqueue b0 to the current next frame */
+	  bi0 = from[0];
+	  to_next[0] = bi0;
+	  from += 1;
+	  to_next += 1;
+	  n_left_from -= 1;
+	  n_left_to_next -= 1;
+
+	  b0 = vlib_get_buffer (vm, bi0);
+
+	  if (is_input)
+	    {
+	      sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_RX];
+	      l3_offset = 0;
+	    }
+	  else
+	    {
+	      sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_TX];
+	      l3_offset = vnet_buffer (b0)->ip.save_rewrite_length;
+	    }
+
+	  acl_fill_5tuple (b0, l3_offset, is_ip6, &pkt_5tuple, &trace_bitmap);
+	  action = acl_fa_match (am, vm->cpu_index, now, sw_if_index0,
+				 is_input,
+				 vec_elt (acl_vec_by_sw_if_index,
+					  sw_if_index0), &pkt_5tuple,
+				 &match_acl_index, &match_rule_index,
+				 &session_result);
+
+	  pkts_new_session += (session_result == ACL_FA_SESSION_NEW);
+	  pkts_exist_session += (session_result == ACL_FA_SESSION_EXISTING);
+	  pkts_too_many_sessions +=
+	    (session_result == ACL_FA_SESSION_TABLE_FULL);
+
+	  if (action)
+	    {
+	      pkts_acl_permit += 1;
+	      vnet_feature_next (sw_if_index0, &next0, b0);
+	    }
+	  else
+	    {
+	      b0->error = node->errors[ACL_FA_ERROR_ACL_DROP];
+	    }
+
+	  if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
+			     && (b0->flags & VLIB_BUFFER_IS_TRACED)))
+	    {
+	      acl_fa_trace_t *t = vlib_add_trace (vm, node, b0, sizeof (*t));
+	      t->sw_if_index = sw_if_index0;
+	      t->next_index = next0;
+	      t->match_acl_index = match_acl_index;
+	      t->match_rule_index = match_rule_index;
+	      t->trace_bitmap = trace_bitmap;
+	      t->session_result = session_result;
+	    }
+
+	  /* verify speculative enqueue, maybe switch current next frame */
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index,
+					   to_next, n_left_to_next,
+					   bi0, next0);
+	}
+
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+
+  vlib_node_increment_counter (vm, node->node_index,
+			       ACL_FA_ERROR_ACL_PERMIT, pkts_acl_permit);
+  vlib_node_increment_counter (vm, node->node_index,
+			       ACL_FA_ERROR_ACL_NEW_SESSION,
+			       pkts_new_session);
+  vlib_node_increment_counter (vm, node->node_index,
+			       ACL_FA_ERROR_ACL_EXIST_SESSION,
+			       pkts_exist_session);
+  vlib_node_increment_counter (vm, node->node_index,
+			       ACL_FA_ERROR_ACL_TOO_MANY_SESSIONS,
+			       pkts_too_many_sessions);
+  return frame->n_vectors;
+}
+
+static uword
+acl_in_ip4_fa_node_fn (vlib_main_t * vm,
+		       vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return acl_fa_node_fn (vm, node, frame, 0 /* is_ip6 */ , 1 /* is_input */ );
+}
+
+static uword
+acl_in_ip6_fa_node_fn (vlib_main_t * vm,
+		       vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return acl_fa_node_fn (vm, node, frame, 1 /* is_ip6 */ , 1 /* is_input */ );
+}
+
+static uword
+acl_out_ip4_fa_node_fn (vlib_main_t * vm,
+			vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return acl_fa_node_fn (vm, node, frame, 0 /* is_ip6 */ , 0 /* is_input */ );
+}
+
+static uword
+acl_out_ip6_fa_node_fn (vlib_main_t * vm,
+			vlib_node_runtime_t * node, vlib_frame_t * frame)
+{
+  return acl_fa_node_fn (vm, node, frame, 1 /* is_ip6 */ , 0 /* is_input */ );
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (acl_in_ip4_fa_node, static) = {
+  .function = acl_in_ip4_fa_node_fn,
+  .name = "acl-plugin-in-ip4-fa",
+  .vector_size = sizeof (u32),
+  .format_trace = format_acl_fa_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (acl_fa_error_strings),
+  .error_strings = acl_fa_error_strings,
+  .n_next_nodes = ACL_FA_N_NEXT,
+  .next_nodes = {
+    [ACL_FA_ERROR_DROP] = "error-drop",
+  }
+};
+
+VNET_FEATURE_INIT (acl_in_ip4_fa_feature, static) = {
+  .arc_name = "ip4-unicast",
+  .node_name = "acl-plugin-in-ip4-fa",
+  .runs_before = VNET_FEATURES ("ip4-flow-classify"),
+};
+
+VLIB_REGISTER_NODE (acl_in_ip6_fa_node, static) = {
+  .function = acl_in_ip6_fa_node_fn,
+  .name = "acl-plugin-in-ip6-fa",
+  .vector_size = sizeof (u32),
+  .format_trace = format_acl_fa_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (acl_fa_error_strings),
+  .error_strings = acl_fa_error_strings,
+  .n_next_nodes = ACL_FA_N_NEXT,
+  .next_nodes = {
+    [ACL_FA_ERROR_DROP] = "error-drop",
+  }
+};
+
+VNET_FEATURE_INIT (acl_in_ip6_fa_feature, static) = {
+  .arc_name = "ip6-unicast",
+  .node_name = "acl-plugin-in-ip6-fa",
+  .runs_before = VNET_FEATURES ("ip6-flow-classify"),
+};
+
+VLIB_REGISTER_NODE (acl_out_ip4_fa_node, static) = {
+  .function = acl_out_ip4_fa_node_fn,
+  .name = "acl-plugin-out-ip4-fa",
+  .vector_size = sizeof (u32),
+  .format_trace = format_acl_fa_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (acl_fa_error_strings),
+  .error_strings = acl_fa_error_strings,
+  .n_next_nodes = ACL_FA_N_NEXT,
+  .next_nodes = {
+    [ACL_FA_ERROR_DROP] = "error-drop",
+  }
+};
+
+VNET_FEATURE_INIT (acl_out_ip4_fa_feature, static) = {
+  .arc_name = "ip4-output",
+  .node_name = "acl-plugin-out-ip4-fa",
+  .runs_before = VNET_FEATURES ("interface-output"),
+};
+
+VLIB_REGISTER_NODE (acl_out_ip6_fa_node, static) = {
+  .function = acl_out_ip6_fa_node_fn,
+  .name = "acl-plugin-out-ip6-fa",
+  .vector_size = sizeof (u32),
+  .format_trace = format_acl_fa_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (acl_fa_error_strings),
+  .error_strings = acl_fa_error_strings,
+  .n_next_nodes = ACL_FA_N_NEXT,
+  .next_nodes = {
+    [ACL_FA_ERROR_DROP] = "error-drop",
+  }
+};
+
+VNET_FEATURE_INIT (acl_out_ip6_fa_feature, static) = {
+  .arc_name = "ip6-output",
+  .node_name = "acl-plugin-out-ip6-fa",
+  .runs_before = VNET_FEATURES ("interface-output"),
+};
+/* *INDENT-ON* */
+
+static u8 *
+format_acl_fa_sw_if_index_list (u8 * s, va_list * args)
+{
+  uword *bitmap = va_arg (*args, uword *);
+  u32 sw_if_index;
+
+  /* *INDENT-OFF* */
+  clib_bitmap_foreach (sw_if_index, bitmap,
+  ({
+    s = format (s, " %d", sw_if_index);
+  }));
+  /* *INDENT-ON* */
+  return s;
+}
+
+static clib_error_t *
+acl_show_aclplugin_sessions_fn (vlib_main_t * vm,
+				unformat_input_t * input,
+				vlib_cli_command_t * cmd)
+{
+  acl_main_t *am = &acl_main;
+  acl_fa_per_worker_data_t *pw;
+  acl_fa_session_t *sess;
+  u64 now = clib_cpu_time_now ();
+  int verbose = 0;
+  int i;
+
+  if (unformat (input, "verbose"))
+    verbose = 1;
+
+  for (i = 0; i < ACL_N_TIMEOUTS; i++)
+    vlib_cli_output (vm, "timeout %U: %lld sec", format_acl_fa_timeout, i,
+		     am->session_timeout_sec[i]);
+  vlib_cli_output (vm, "session arcs on sw_if_index: in%U, out%U",
+		   format_acl_fa_sw_if_index_list,
+		   am->fa_in_acl_on_sw_if_index,
+		   format_acl_fa_sw_if_index_list,
+		   am->fa_out_acl_on_sw_if_index);
+  if (!am->fa_sessions_initialized)
+    {
+      vlib_cli_output (vm, "no session tables");
+      return 0;
+    }
+
+  vec_foreach (pw, am->per_worker_data)
+  {
+    vlib_cli_output (vm, "thread %d: %d sessions, added %lld deleted %lld "
+		     "add failed %lld other threads' session hits %lld "
+		     "limit %d",
+		     pw - am->per_worker_data, pool_elts (pw->sessions),
+		     pw->n_sessions_added, pw->n_sessions_deleted,
+		     pw->n_sessions_add_failed, pw->n_foreign_session_hits,
+		     pw->max_sessions);
+    if (!verbose)
+      continue;
+    /* *INDENT-OFF* */
+    pool_foreach (sess, pw->sessions,
+    ({
+      vlib_cli_output (vm, "  [%d] %U sw_if_index %d %s proto %d "
+                       "ports %d %d tcp flags %02x/%02x idle %.2f sec "
+                       "timeout %U",
+                       sess - pw->sessions,
+                       format_ip46_address, &sess->key.addr[0], IP46_TYPE_ANY,
+                       sess->key.sw_if_index,
+                       sess->is_input ? "in" : "out",
+                       sess->key.proto, sess->key.port[0], sess->key.port[1],
+                       sess->tcp_flags_seen[0], sess->tcp_flags_seen[1],
+                       acl_fa_session_idle_time (am, sess, now),
+                       format_acl_fa_timeout,
+                       acl_fa_session_timeout_type (sess));
+      vlib_cli_output (vm, "      peer %U", format_ip46_address,
+                       &sess->key.addr[1], IP46_TYPE_ANY);
+    }));
+    /* *INDENT-ON* */
+  }
+  if (verbose)
+    vlib_cli_output (vm, "%U", format_bihash_48_8, &am->fa_session_hash,
+		     0 /* verbose */ );
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (aclplugin_show_sessions_command, static) = {
+    .path = "show acl-plugin sessions",
+    .short_help = "show acl-plugin sessions [verbose]",
+    .function = acl_show_aclplugin_sessions_fn,
+};
+/* *INDENT-ON* */
+
+u8 *
+format_acl_fa_timeout (u8 * s, va_list * args)
+{
+  int i = va_arg (*args, int);
+  char *strings[] = {
+#define _(sym,str) str,
+    foreach_acl_fa_timeout
+#undef _
+  };
+
+  if (i < ARRAY_LEN (strings))
+    return format (s, "%s", strings[i]);
+  return format (s, "unknown %d", i);
+}
+
+uword
+unformat_acl_fa_timeout (unformat_input_t * input, va_list * args)
+{
+  u32 *result = va_arg (*args, u32 *);
+
+#define _(sym,str)                              \
+  if (unformat (input, str))                    \
+    {                                           \
+      *result = ACL_TIMEOUT_##sym;              \
+      return 1;                                 \
+    }
+  foreach_acl_fa_timeout
+#undef _
+    return 0;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef included_acl_fa_node_h
+#define included_acl_fa_node_h
+
+#include <vppinfra/bihash_48_8.h>
+
+/*
+ * Flow-aware ("fa") stateful ACL processing.
+ *
+ * A packet matching a "permit+reflect" rule creates a session owned by
+ * the worker that saw it. The session is entered twice, under the
+ * forward and the reverse 5-tuple, so packets of an established flow in
+ * either direction on the same interface are permitted with a single
+ * hash probe, without consulting the ACLs.
+ *
+ * All workers share one session hash, whose value names the owning
+ * worker, so a flow whose packets land on several workers is found with
+ * the same single probe, and a packet matching no session costs one
+ * probe whatever the number of workers. Sessions are created and freed
+ * by their owner only, but any worker seeing a packet of the flow
+ * refreshes the activity time and TCP flags in place: the session pools
+ * are allocated up front so they never move, and activity is recorded
+ * in cpu clocks, which are comparable across threads.
+ *
+ * The idle timeout is enforced by a vlib timer on the owning thread: the
+ * timer is not touched per packet; on expiry the session is either freed
+ * or the timer restarted for the remainder of the idle time. A FIN or RST
+ * moves an established TCP session to the much shorter transient
+ * timeout, and may be seen by a worker which cannot touch the owner's
+ * timers, so the timer of an established session is never armed for
+ * longer than the transient timeout: the session is then freed at the
+ * transient timeout after its last packet, whoever saw the FIN or RST.
+ */
+
+#define ACL_FA_CONN_TABLE_DEFAULT_HASH_NUM_BUCKETS (64 * 1024)
+#define ACL_FA_CONN_TABLE_DEFAULT_HASH_MEMORY_SIZE (1<<30)
+#define ACL_FA_CONN_TABLE_DEFAULT_MAX_ENTRIES 1000000
+
+#define TCP_SESSION_TRANSIENT_TIMEOUT_SEC 120
+#define TCP_SESSION_IDLE_TIMEOUT_SEC (3600*24)
+#define UDP_SESSION_IDLE_TIMEOUT_SEC 600
+
+#define foreach_acl_fa_timeout                          \
+  _(UDP_IDLE, "udp idle")                               \
+  _(TCP_IDLE, "tcp idle")                               \
+  _(TCP_TRANSIENT, "tcp transient")
+
+typedef enum
+{
+#define _(sym,str) ACL_TIMEOUT_##sym,
+  foreach_acl_fa_timeout
+#undef _
+    ACL_N_TIMEOUTS,
+} acl_timeout_e;
+
+typedef union
+{
+  u64 as_u64[6];
+  struct
+  {
+    ip46_address_t addr[2];
+    u16 port[2];
+    u8 proto;
+    u8 is_ip6;
+    u16 pad0;
+    u32 sw_if_index;
+    u32 pad1;
+  };
+} acl_fa_session_key_t;
+
+typedef struct
+{
+  /* the key in the direction of the packet which created the session */
+  acl_fa_session_key_t key;
+  /* cpu clock of the last packet, written by any worker */
+  volatile u64 last_active_time;
+  u32 timer_handle;
+  /* [0] - seen in the forward direction, [1] - in the reverse one */
+  volatile u8 tcp_flags_seen[2];
+  u8 is_input;
+  u8 pad0;
+} acl_fa_session_t;
+
+/* session hash value */
+typedef union
+{
+  u64 as_u64;
+  struct
+  {
+    u32 session_index;
+    u16 thread_index;
+    /* the hash key is the reverse of the session key */
+    u8 is_reverse;
+    u8 pad0;
+  };
+} acl_fa_session_id_t;
+
+typedef struct
+{
+  /* pool of sessions owned by this worker, preallocated, never moves */
+  acl_fa_session_t *sessions;
+  /* this worker's share of the session limit, the pool's size */
+  u32 max_sessions;
+  u64 n_sessions_added;
+  u64 n_sessions_deleted;
+  u64 n_sessions_add_failed;
+  /* packets of sessions owned by other workers */
+  u64 n_foreign_session_hits;
+} acl_fa_per_worker_data_t;
+
+typedef enum
+{
+  ACL_FA_SESSION_NONE,
+  ACL_FA_SESSION_EXISTING,
+  ACL_FA_SESSION_NEW,
+  ACL_FA_SESSION_TABLE_FULL,
+} acl_fa_session_result_t;
+
+#endif
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stddef.h>
+
+#include <vnet/vnet.h>
+#include <vnet/ip/ip.h>
+#include <acl/acl.h>
+#include <acl/hash_lookup.h>
+
+static void
+acl_hash_ip_mask_from_prefixlen (ip46_address_t * mask, u8 prefixlen,
+				 int is_ip6)
+{
+  memset (mask, 0, sizeof (*mask));
+  if (is_ip6)
+    {
+      ip6_address_mask_from_width (&mask->ip6, clib_min (prefixlen, 128));
+    }
+  else
+    {
+      prefixlen = clib_min (prefixlen, 32);
+      mask->ip4.as_u32 = prefixlen ?
+	clib_host_to_net_u32 (~0 << (32 - prefixlen)) : 0;
+    }
+}
+
+/*
+ * Aligned power-of-two port ranges (including the single port and the
+ * whole 0-65535 range) are expressible as a mask. Anything else is
+ * wildcarded and verified after the hash hit.
+ */
+static u16
+acl_hash_port_mask_from_range (u16 first, u16 last, u8 * needs_range_check)
+{
+  u32 size = (u32) last - (u32) first + 1;
+
+  if ((first <= last) && is_pow2 (size) && ((first & (size - 1)) == 0))
+    return (u16) ~ (size - 1);
+
+  *needs_range_check = 1;
+  return 0;
+}
+
+static void
+acl_hash_make_rule_mask_and_key (acl_rule_t * r, acl_5tuple_t * mask,
+				 acl_5tuple_t * key, u8 * needs_range_check)
+{
+  int i;
+
+  memset (mask, 0, sizeof (*mask));
+  memset (key, 0, sizeof (*key));
+  *needs_range_check = 0;
+
+  acl_hash_ip_mask_from_prefixlen (&mask->addr[0], r->src_prefixlen,
+				   r->is_ipv6);
+  acl_hash_ip_mask_from_prefixlen (&mask->addr[1], r->dst_prefixlen,
+				   r->is_ipv6);
+  mask->is_ip6 = ~0;
+  if (r->proto)
+    {
+      mask->proto = ~0;
+      mask->port[0] =
+	acl_hash_port_mask_from_range (r->src_port_or_type_first,
+				       r->src_port_or_type_last,
+				       needs_range_check);
+      mask->port[1] =
+	acl_hash_port_mask_from_range (r->dst_port_or_code_first,
+				       r->dst_port_or_code_last,
+				       needs_range_check);
+      mask->tcp_flags = r->tcp_flags_mask;
+    }
+
+  key->addr[0] = r->src;
+  key->addr[1] = r->dst;
+  key->is_ip6 = r->is_ipv6;
+  if (r->proto)
+    {
+      key->proto = r->proto;
+      key->port[0] = r->src_port_or_type_first;
+      key->port[1] = r->dst_port_or_code_first;
+    }
+  for (i = 0; i < ARRAY_LEN (key->as_u64); i++)
+    key->as_u64[i] &= mask->as_u64[i];
+
+  /*
+   * Not masked on purpose: a value with bits outside of the mask
+   * never matches, same as in the linear matching.
+   */
+  if (r->proto)
+    key->tcp_flags = r->tcp_flags_value;
+}
+
+static u32
+acl_hash_mask_type_lock (acl_main_t * am, acl_5tuple_t * mask)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  acl_hash_mask_type_t *mt;
+  u32 mask_type_index;
+  int i;
+
+  /* *INDENT-OFF* */
+  pool_foreach (mt, am->hash_mask_type_pool,
+  ({
+    if (0 == memcmp (&mt->mask, mask, sizeof (*mask)))
+      {
+        mt->refcount++;
+        return mt - am->hash_mask_type_pool;
+      }
+  }));
+  /* *INDENT-ON* */
+
+  pool_get_aligned (am->hash_mask_type_pool, mt, CLIB_CACHE_LINE_BYTES);
+  memset (mt, 0, sizeof (*mt));
+  mt->mask = *mask;
+  mt->refcount = 1;
+  mask_type_index = mt - am->hash_mask_type_pool;
+
+  vec_validate (am->hash_mask_type_hits_by_thread, tm->n_vlib_mains - 1);
+  for (i = 0; i < vec_len (am->hash_mask_type_hits_by_thread); i++)
+    {
+      vec_validate (am->hash_mask_type_hits_by_thread[i], mask_type_index);
+      am->hash_mask_type_hits_by_thread[i][mask_type_index] = 0;
+    }
+  return mask_type_index;
+}
+
+static void
+acl_hash_mask_type_unlock (acl_main_t * am, u32 mask_type_index)
+{
+  acl_hash_mask_type_t *mt;
+
+  mt = pool_elt_at_index (am->hash_mask_type_pool, mask_type_index);
+  ASSERT (mt->refcount > 0);
+  if (--mt->refcount == 0)
+    pool_put (am->hash_mask_type_pool, mt);
+}
+
+static void
+acl_hash_lookup_hash_init (acl_main_t * am)
+{
+  if (am->acl_lookup_hash_initialized)
+    return;
+
+  clib_bihash_init_48_8 (&am->acl_lookup_hash, "ACL plugin rule lookup",
+			 am->hash_lookup_hash_buckets,
+			 am->hash_lookup_hash_memory);
+  am->acl_lookup_hash_initialized = 1;
+}
+
+void
+acl_hash_acl_add (acl_main_t * am, u32 acl_index)
+{
+  clib_bihash_kv_48_8_t kv, result;
+  acl_5tuple_t *key = (acl_5tuple_t *) & kv.key;
+  acl_5tuple_t mask;
+  acl_hash_acl_t *ha;
+  acl_hash_acl_mask_t *hm;
+  acl_hash_rule_t *hr;
+  acl_list_t *a;
+  u32 i, ri;
+
+  acl_hash_lookup_hash_init (am);
+
+  a = pool_elt_at_index (am->acls, acl_index);
+  vec_validate (am->hash_acl_infos, acl_index);
+  ha = vec_elt_at_index (am->hash_acl_infos, acl_index);
+  /* a replaced ACL must have been removed with acl_hash_acl_del first */
+  ASSERT (vec_len (ha->rules) == 0);
+  vec_validate (ha->rules, a->count ? a->count - 1 : 0);
+  _vec_len (ha->rules) = a->count;
+
+  for (i = 0; i < a->count; i++)
+    {
+      hr = vec_elt_at_index (ha->rules, i);
+      hr->next_colliding_rule = ~0;
+      acl_hash_make_rule_mask_and_key (&a->rules[i], &mask, key,
+				       &hr->needs_range_check);
+      hr->mask_type_index = acl_hash_mask_type_lock (am, &mask);
+      key->acl_index = acl_index;
+      key->mask_type_index = hr->mask_type_index;
+
+      /*
+       * Rules are added in order, so the first rule with a given masked
+       * key heads the chain and the chain stays sorted by rule index.
+       */
+      if (clib_bihash_search_48_8 (&am->acl_lookup_hash, &kv, &result) == 0)
+	{
+	  ri = result.value;
+	  while (ha->rules[ri].next_colliding_rule != ~0)
+	    ri = ha->rules[ri].next_colliding_rule;
+	  ha->rules[ri].next_colliding_rule = i;
+	}
+      else
+	{
+	  kv.value = i;
+	  clib_bihash_add_del_48_8 (&am->acl_lookup_hash, &kv, 1 /* is_add */ );
+	}
+
+      vec_foreach (hm, ha->mask_types)
+      {
+	if (hm->mask_type_index == hr->mask_type_index)
+	  break;
+      }
+      if (hm == vec_end (ha->mask_types))
+	{
+	  vec_add2 (ha->mask_types, hm, 1);
+	  hm->mask_type_index = hr->mask_type_index;
+	  hm->first_rule_index = i;
+	}
+    }
+}
+
+void
+acl_hash_acl_del (acl_main_t * am, u32 acl_index)
+{
+  clib_bihash_kv_48_8_t kv;
+  acl_5tuple_t *key = (acl_5tuple_t *) & kv.key;
+  acl_5tuple_t mask;
+  acl_hash_acl_t *ha;
+  acl_hash_rule_t *hr;
+  acl_list_t *a;
+  u8 needs_range_check;
+  u32 i;
+
+  if (acl_index >= vec_len (am->hash_acl_infos))
+    return;
+  ha = vec_elt_at_index (am->hash_acl_infos, acl_index);
+  if (vec_len (ha->rules) == 0)
+    {
+      vec_free (ha->rules);
+      vec_free (ha->mask_types);
+      return;
+    }
+
+  /* The rules still hold the values the entries were compiled from */
+  a = pool_elt_at_index (am->acls, acl_index);
+  ASSERT (a->count == vec_len (ha->rules));
+  for (i = 0; i < vec_len (ha->rules); i++)
+    {
+      hr = vec_elt_at_index (ha->rules, i);
+      acl_hash_make_rule_mask_and_key (&a->rules[i], &mask, key,
+				       &needs_range_check);
+      key->acl_index = acl_index;
+      key->mask_type_index = hr->mask_type_index;
+      /* only the chain heads are in the hash, the rest fail harmlessly */
+      clib_bihash_add_del_48_8 (&am->acl_lookup_hash, &kv, 0 /* is_add */ );
+      acl_hash_mask_type_unlock (am, hr->mask_type_index);
+    }
+  vec_free (ha->rules);
+  vec_free (ha->mask_types);
+}
+
+static_always_inline int
+acl_hash_rule_ports_match (acl_rule_t * r, acl_5tuple_t * pkt_5tuple)
+{
+  return ((pkt_5tuple->port[0] >= r->src_port_or_type_first) &&
+	  (pkt_5tuple->port[0] <= r->src_port_or_type_last) &&
+	  (pkt_5tuple->port[1] >= r->dst_port_or_code_first) &&
+	  (pkt_5tuple->port[1] <= r->dst_port_or_code_last));
+}
+
+int
+acl_hash_match_5tuple (acl_main_t * am, u32 acl_index,
+		       acl_5tuple_t * pkt_5tuple, u32 thread_index,
+		       u32 * r_rule_index)
+{
+  clib_bihash_kv_48_8_t kv, result;
+  acl_5tuple_t *key = (acl_5tuple_t *) & kv.key;
+  u32 best_rule_index = ~0;
+  u32 best_mask_type_index = ~0;
+  acl_hash_mask_type_t *mt;
+  acl_hash_acl_mask_t *hm;
+  acl_hash_acl_t *ha;
+  acl_rule_t *rules;
+  u32 ri;
+  int i;
+
+  if (PREDICT_FALSE (acl_index >= vec_len (am->hash_acl_infos)))
+    return 0;
+  ha = vec_elt_at_index (am->hash_acl_infos, acl_index);
+  rules = am->acls[acl_index].rules;
+
+  vec_foreach (hm, ha->mask_types)
+  {
+    /* the remaining mask types can not produce an earlier match */
+    if (hm->first_rule_index >= best_rule_index)
+      break;
+
+    mt = pool_elt_at_index (am->hash_mask_type_pool, hm->mask_type_index);
+    for (i = 0; i < ARRAY_LEN (kv.key); i++)
+      kv.key[i] = pkt_5tuple->as_u64[i] & mt->mask.as_u64[i];
+    key->acl_index = acl_index;
+    key->mask_type_index = hm->mask_type_index;
+
+    if (clib_bihash_search_inline_2_48_8 (&am->acl_lookup_hash, &kv,
+					  &result))
+      continue;
+
+    for (ri = result.value; ri < best_rule_index;
+	 ri = ha->rules[ri].next_colliding_rule)
+      {
+	if (!ha->rules[ri].needs_range_check
+	    || acl_hash_rule_ports_match (&rules[ri], pkt_5tuple))
+	  {
+	    best_rule_index = ri;
+	    best_mask_type_index = hm->mask_type_index;
+	    break;
+	  }
+      }
+  }
+
+  if (best_rule_index == ~0)
+    return 0;
+
+  am->hash_mask_type_hits_by_thread[thread_index][best_mask_type_index]++;
+  *r_rule_index = best_rule_index;
+  return 1;
+}
+
+u8 *
+format_acl_5tuple_mask (u8 * s, va_list * args)
+{
+  acl_5tuple_t *m = va_arg (*args, acl_5tuple_t *);
+
+  if (m->is_ip6)
+    s = format (s, "ip6 src %U dst %U",
+		format_ip6_address, &m->addr[0].ip6,
+		format_ip6_address, &m->addr[1].ip6);
+  else
+    s = format (s, "ip4 src %U dst %U",
+		format_ip4_address, &m->addr[0].ip4,
+		format_ip4_address, &m->addr[1].ip4);
+  s = format (s, " proto 0x%02x sport 0x%04x dport 0x%04x tcp_flags 0x%02x",
+	      m->proto, m->port[0], m->port[1], m->tcp_flags);
+  return s;
+}
+
+void
+acl_hash_show_mask_types (vlib_main_t * vm, acl_main_t * am)
+{
+  acl_hash_mask_type_t *mt;
+  u32 mask_type_index;
+  u64 hits;
+  int i;
+
+  vlib_cli_output (vm, "%d mask types:", pool_elts (am->hash_mask_type_pool));
+  /* *INDENT-OFF* */
+  pool_foreach (mt, am->hash_mask_type_pool,
+  ({
+    mask_type_index = mt - am->hash_mask_type_pool;
+    hits = 0;
+    for (i = 0; i < vec_len (am->hash_mask_type_hits_by_thread); i++)
+      hits += am->hash_mask_type_hits_by_thread[i][mask_type_index];
+    vlib_cli_output (vm, "  [%d] %U", mask_type_index,
+                     format_acl_5tuple_mask, &mt->mask);
+    vlib_cli_output (vm, "      refcount %d hits %lld", mt->refcount, hits);
+  }));
+  /* *INDENT-ON* */
+}
+
+void
+acl_hash_show_acl (vlib_main_t * vm, acl_main_t * am, u32 acl_index)
+{
+  acl_hash_acl_t *ha;
+  acl_hash_acl_mask_t *hm;
+  u32 n_range_checked = 0;
+  int i;
+
+  if (acl_index >= vec_len (am->hash_acl_infos))
+    return;
+  ha = vec_elt_at_index (am->hash_acl_infos, acl_index);
+  for (i = 0; i < vec_len (ha->rules); i++)
+    n_range_checked += ha->rules[i].needs_range_check;
+
+  vlib_cli_output (vm, "acl-index %d: %d rules, %d with range check, "
+		   "%d mask types", acl_index, vec_len (ha->rules),
+		   n_range_checked, vec_len (ha->mask_types));
+  vec_foreach (hm, ha->mask_types)
+  {
+    vlib_cli_output (vm, "  mask type %d first rule %d",
+		     hm->mask_type_index, hm->first_rule_index);
+  }
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
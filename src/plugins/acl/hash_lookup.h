@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef included_acl_hash_lookup_h
+#define included_acl_hash_lookup_h
+
+#include <acl/acl.h>
+
+/*
+ * Compile the ACL into the lookup tables. When replacing the rules,
+ * acl_hash_acl_del must be called while the old rules are still in place.
+ */
+void acl_hash_acl_add (acl_main_t * am, u32 acl_index);
+/* Remove the ACL from the lookup tables */
+void acl_hash_acl_del (acl_main_t * am, u32 acl_index);
+
+/*
+ * First-match lookup of the packet 5-tuple within a single ACL.
+ * Returns 1 and the matching rule index on match, 0 otherwise.
+ */
+int acl_hash_match_5tuple (acl_main_t * am, u32 acl_index,
+			   acl_5tuple_t * pkt_5tuple, u32 thread_index,
+			   u32 * r_rule_index);
+
+void acl_hash_show_mask_types (vlib_main_t * vm, acl_main_t * am);
+void acl_hash_show_acl (vlib_main_t * vm, acl_main_t * am, u32 acl_index);
+format_function_t format_acl_5tuple_mask;
+
+#endif
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef included_acl_hash_lookup_types_h
+#define included_acl_hash_lookup_types_h
+
+#include <vppinfra/bihash_48_8.h>
+
+/*
+ * The tuple-space search ("hash") ACL matching.
+ *
+ * Every rule is converted into a mask over the packet 5-tuple plus the
+ * rule values under that mask. The rules sharing the same mask form a
+ * "mask type"; each (acl, mask type, masked values) is a single entry
+ * in a clib_bihash_48_8, so the per-packet cost is one hash probe per
+ * distinct mask type used by the ACL rather than one compare per rule.
+ *
+ * Port ranges which are not expressible as a prefix are wildcarded in the
+ * mask and checked after the hash hit, walking the short chain of rules
+ * that share the same masked key.
+ */
+
+typedef union
+{
+  u64 as_u64[6];
+  struct
+  {
+    ip46_address_t addr[2];	/* src, dst */
+    u16 port[2];		/* src port or icmp type, dst port or code */
+    u8 proto;
+    u8 tcp_flags;
+    u8 is_ip6;
+    u8 pad0;
+    /* never masked, filled in after applying the mask */
+    u32 acl_index;
+    u32 mask_type_index;
+  };
+} acl_5tuple_t;
+
+typedef struct
+{
+  acl_5tuple_t mask;
+  /* number of rules across all ACLs referring to this mask type */
+  u32 refcount;
+} acl_hash_mask_type_t;
+
+typedef struct
+{
+  u32 mask_type_index;
+  /* lowest rule index using this mask type within the ACL */
+  u32 first_rule_index;
+} acl_hash_acl_mask_t;
+
+typedef struct
+{
+  /* the next rule in the same ACL with the same masked key, or ~0 */
+  u32 next_colliding_rule;
+  u32 mask_type_index;
+  /* the port ranges are not expressible in the mask, check them on a hit */
+  u8 needs_range_check;
+} acl_hash_rule_t;
+
+typedef struct
+{
+  /* mask types used by the ACL, sorted by first_rule_index */
+  acl_hash_acl_mask_t *mask_types;
+  /* per-rule compiled state, parallel to acl_list_t.rules */
+  acl_hash_rule_t *rules;
+} acl_hash_acl_t;
+
+#endif
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -74,6 +74,7 @@ acl_in_node_fn (vlib_main_t * vm,
   u32 trace_bitmap = 0;
   u32 *input_feat_next_node_index =
     acl_main.acl_in_node_feat_next_node_index;
+  u64 now = clib_cpu_time_now ();
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -109,8 +110,9 @@ acl_in_node_fn (vlib_main_t * vm,
 	  sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_RX];
 	  feature_bitmap0 = vnet_buffer (b0)->l2.feature_bitmap;
 
-	  input_acl_packet_match (sw_if_index0, b0, &next, &match_acl_index,
-				  &match_rule_index, &trace_bitmap);
+	  input_acl_packet_match (vm->cpu_index, now, sw_if_index0, b0, &next,
+				  &match_acl_index, &match_rule_index,
+				  &trace_bitmap);
 	  if (next != ~0)
 	    {
 	      next0 = next;
@@ -162,7 +164,5 @@ VLIB_REGISTER_NODE (acl_in_node) =
     .next_nodes =
   {
   [ACL_IN_ERROR_DROP] = "error-drop",
-      [ACL_IN_ETHERNET_INPUT] = "ethernet-input",
-      [ACL_IN_L2S_INPUT_IP4_ADD] = "aclp-l2s-input-ip4-add",
-      [ACL_IN_L2S_INPUT_IP6_ADD] = "aclp-l2s-input-ip6-add",}
+      [ACL_IN_ETHERNET_INPUT] = "ethernet-input",}
 ,};
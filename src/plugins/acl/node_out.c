@@ -70,6 +70,7 @@ acl_out_node_fn (vlib_main_t * vm,
   acl_main_t *am = &acl_main;
   u32 *output_feat_next_node_index =
     am->acl_out_node_feat_next_node_index;
+  u64 now = clib_cpu_time_now ();
   u32 n_left_from, *from, *to_next;
   acl_out_next_t next_index;
   u32 pkts_acl_checked = 0;
@@ -110,8 +111,9 @@ acl_out_node_fn (vlib_main_t * vm,
 	  sw_if_index0 = vnet_buffer (b0)->sw_if_index[VLIB_TX];
 	  feature_bitmap0 = vnet_buffer (b0)->l2.feature_bitmap;
 
-	  output_acl_packet_match (sw_if_index0, b0, &next, &match_acl_index,
-				   &match_rule_index, &trace_bitmap);
+	  output_acl_packet_match (vm->cpu_index, now, sw_if_index0, b0, &next,
+				   &match_acl_index, &match_rule_index,
+				   &trace_bitmap);
 	  if (next != ~0)
 	    {
 	      next0 = next;
@@ -163,7 +165,5 @@ VLIB_REGISTER_NODE (acl_out_node) =
     .next_nodes =
   {
   [ACL_OUT_ERROR_DROP] = "error-drop",
-      [ACL_OUT_INTERFACE_OUTPUT] = "interface-output",
-      [ACL_OUT_L2S_OUTPUT_IP4_ADD] = "aclp-l2s-output-ip4-add",
-      [ACL_OUT_L2S_OUTPUT_IP6_ADD] = "aclp-l2s-output-ip6-add",}
+      [ACL_OUT_INTERFACE_OUTPUT] = "interface-output",}
 ,};
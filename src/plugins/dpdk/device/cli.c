@@ -720,6 +720,8 @@ set_dpdk_if_placement (vlib_main_t * vm, unformat_input_t * input,
                 vlib_node_set_state (vlib_mains[cpu], dpdk_input_node.index,
 		                     VLIB_NODE_STATE_POLLING);
 
+              dpdk_device_update_rss_placement (dm, xd);
+
               goto done;
             }
         }
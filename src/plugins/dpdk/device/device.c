@@ -19,6 +19,8 @@
 #include <assert.h>
 
 #include <vnet/ethernet/ethernet.h>
+#include <vnet/ip/ip.h>
+#include <vnet/tcp/tcp_packet.h>
 #include <dpdk/device/dpdk.h>
 
 #include <dpdk/device/dpdk_priv.h>
@@ -151,6 +153,40 @@ dpdk_tx_trace_buffer (dpdk_main_t * dm,
 	       sizeof (t0->buffer.pre_data));
 }
 
+/*
+ * Ask the device to segment a super-segment. Only set for devices
+ * advertising VNET_HW_INTERFACE_FLAG_SUPPORTS_GSO, the gso node segments
+ * for everyone else.
+ */
+static_always_inline void
+dpdk_buffer_tx_tso (vlib_buffer_t * b, struct rte_mbuf *mb)
+{
+  vnet_buffer_opaque2_t *o2 = vnet_buffer2 (b);
+  tcp_header_t *th = (tcp_header_t *) (b->data + o2->gso.l4_hdr_offset);
+
+  mb->l2_len = o2->gso.l3_hdr_offset - b->current_data;
+  mb->l3_len = o2->gso.l4_hdr_offset - o2->gso.l3_hdr_offset;
+  mb->l4_len = o2->gso.l4_hdr_sz;
+  mb->tso_segsz = o2->gso.gso_size;
+
+  /* Devices want the pseudo header sum, without length, in th */
+  if (o2->gso.is_ip4)
+    {
+      ip4_header_t *ip4 = (ip4_header_t *) (b->data + o2->gso.l3_hdr_offset);
+      mb->ol_flags |= PKT_TX_TCP_SEG | PKT_TX_IPV4 | PKT_TX_IP_CKSUM;
+      ip4->checksum = 0;
+      th->checksum = rte_ipv4_phdr_cksum ((struct ipv4_hdr *) ip4,
+					  mb->ol_flags);
+    }
+  else
+    {
+      ip6_header_t *ip6 = (ip6_header_t *) (b->data + o2->gso.l3_hdr_offset);
+      mb->ol_flags |= PKT_TX_TCP_SEG | PKT_TX_IPV6;
+      th->checksum = rte_ipv6_phdr_cksum ((struct ipv6_hdr *) ip6,
+					  mb->ol_flags);
+    }
+}
+
 static_always_inline void
 dpdk_validate_rte_mbuf (vlib_main_t * vm, vlib_buffer_t * b,
 			int maybe_multiseg)
@@ -179,6 +215,9 @@ dpdk_validate_rte_mbuf (vlib_main_t * vm, vlib_buffer_t * b,
     b->current_length;
   mb->data_off = VLIB_BUFFER_PRE_DATA_SIZE + b->current_data;
 
+  if (PREDICT_FALSE (b->flags & VNET_BUFFER_GSO))
+    dpdk_buffer_tx_tso (b, first_mb);
+
   while (maybe_multiseg && (b->flags & VLIB_BUFFER_NEXT_PRESENT))
     {
       b = vlib_get_buffer (vm, b->next_buffer);
@@ -44,6 +44,7 @@
 #include <rte_ring.h>
 #include <rte_mempool.h>
 #include <rte_mbuf.h>
+#include <rte_ip.h>
 #include <rte_virtio_net.h>
 #include <rte_version.h>
 #include <rte_eth_bond.h>
@@ -178,6 +179,7 @@ typedef struct
 #define DPDK_DEVICE_FLAG_MAYBE_MULTISEG     (1 << 4)
 #define DPDK_DEVICE_FLAG_HAVE_SUBIF         (1 << 5)
 #define DPDK_DEVICE_FLAG_HQOS               (1 << 6)
+#define DPDK_DEVICE_FLAG_TX_TSO             (1 << 7)
 
   u16 nb_tx_desc;
     CLIB_CACHE_LINE_ALIGN_MARK (cacheline1);
@@ -302,6 +304,7 @@ typedef struct
   u8 *uio_driver_name;
   u8 no_multi_seg;
   u8 enable_tcp_udp_checksum;
+  u8 enable_tso;
   u8 cryptodev;
 
   /* Required config parameters */
@@ -430,6 +433,8 @@ clib_error_t *dpdk_set_mc_filter (vnet_hw_interface_t * hi,
 void dpdk_thread_input (dpdk_main_t * dm, dpdk_device_t * xd);
 
 clib_error_t *dpdk_port_setup (dpdk_main_t * dm, dpdk_device_t * xd);
+void dpdk_device_update_rss_placement (dpdk_main_t * dm,
+				       dpdk_device_t * xd);
 
 u32 dpdk_interface_tx_vector (vlib_main_t * vm, u32 dev_instance);
 
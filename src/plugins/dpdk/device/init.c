@@ -393,6 +393,78 @@ dpdk_port_setup (dpdk_main_t * dm, dpdk_device_t * xd)
   return 0;
 }
 
+/*
+ * Publish the rss key and, per rss indirection table entry, the thread
+ * polling the entry's queue, so transports can predict where flows land.
+ * Left empty when the device can't report them.
+ */
+void
+dpdk_device_update_rss_placement (dpdk_main_t * dm, dpdk_device_t * xd)
+{
+  vnet_hw_interface_t *hi;
+  struct rte_eth_dev_info dev_info;
+  struct rte_eth_rss_conf rss_conf;
+  struct rte_eth_rss_reta_entry64 *reta = 0;
+  dpdk_device_and_queue_t *dq;
+  u32 *thread_by_queue = 0;
+  u32 i, cpu, q;
+
+  hi = vnet_get_hw_interface (dm->vnet_main, xd->vlib_hw_if_index);
+  vec_reset_length (hi->rss_key);
+  vec_reset_length (hi->rss_thread_index_by_reta);
+
+  if (xd->rx_q_used < 2)
+    return;
+
+  rte_eth_dev_info_get (xd->device_index, &dev_info);
+  if (dev_info.reta_size == 0 || !is_pow2 (dev_info.reta_size)
+      || dev_info.reta_size % RTE_RETA_GROUP_SIZE)
+    return;
+
+  /* Thread polling each rx queue */
+  vec_validate_init_empty (thread_by_queue, xd->rx_q_used - 1, ~0);
+  for (cpu = 0; cpu < vec_len (dm->devices_by_cpu); cpu++)
+    vec_foreach (dq, dm->devices_by_cpu[cpu])
+    {
+      if (dq->device == xd->device_index && dq->queue_id < xd->rx_q_used)
+	thread_by_queue[dq->queue_id] = cpu;
+    }
+
+  vec_validate (hi->rss_key, (dev_info.hash_key_size ?
+			      dev_info.hash_key_size : 40) - 1);
+  memset (&rss_conf, 0, sizeof (rss_conf));
+  rss_conf.rss_key = hi->rss_key;
+  rss_conf.rss_key_len = vec_len (hi->rss_key);
+  if (rte_eth_dev_rss_hash_conf_get (xd->device_index, &rss_conf))
+    goto fail;
+
+  vec_validate (reta, dev_info.reta_size / RTE_RETA_GROUP_SIZE - 1);
+  for (i = 0; i < vec_len (reta); i++)
+    reta[i].mask = ~0ULL;
+  if (rte_eth_dev_rss_reta_query (xd->device_index, reta,
+				  dev_info.reta_size))
+    goto fail;
+
+  vec_validate (hi->rss_thread_index_by_reta, dev_info.reta_size - 1);
+  for (i = 0; i < dev_info.reta_size; i++)
+    {
+      q = reta[i / RTE_RETA_GROUP_SIZE].reta[i % RTE_RETA_GROUP_SIZE];
+      if (q >= vec_len (thread_by_queue) || thread_by_queue[q] == ~0)
+	goto fail;
+      hi->rss_thread_index_by_reta[i] = thread_by_queue[q];
+    }
+
+  vec_free (reta);
+  vec_free (thread_by_queue);
+  return;
+
+fail:
+  vec_reset_length (hi->rss_key);
+  vec_reset_length (hi->rss_thread_index_by_reta);
+  vec_free (reta);
+  vec_free (thread_by_queue);
+}
+
 static u32
 dpdk_flag_change (vnet_main_t * vnm, vnet_hw_interface_t * hi, u32 flags)
 {
@@ -662,6 +734,15 @@ dpdk_lib_init (dpdk_main_t * dm)
 	  xd->flags |= DPDK_DEVICE_FLAG_MAYBE_MULTISEG;
 	}
 
+      /* TSO takes super-segment chains, so needs multi-seg */
+      if (dm->conf->enable_tso && !dm->conf->no_multi_seg
+	  && (dev_info.tx_offload_capa & DEV_TX_OFFLOAD_TCP_TSO))
+	{
+	  xd->tx_conf.txq_flags &= ~(ETH_TXQ_FLAGS_NOOFFLOADS |
+				     ETH_TXQ_FLAGS_NOXSUMTCP);
+	  xd->flags |= DPDK_DEVICE_FLAG_TX_TSO;
+	}
+
       clib_memcpy (&xd->port_conf, &port_conf_template,
 		   sizeof (struct rte_eth_conf));
 
@@ -1062,6 +1143,11 @@ dpdk_lib_init (dpdk_main_t * dm)
       xd->vlib_sw_if_index = sw->sw_if_index;
       hi = vnet_get_hw_interface (dm->vnet_main, xd->vlib_hw_if_index);
 
+      if (xd->flags & DPDK_DEVICE_FLAG_TX_TSO)
+	hi->flags |= VNET_HW_INTERFACE_FLAG_SUPPORTS_GSO;
+
+      dpdk_device_update_rss_placement (dm, xd);
+
       /*
        * DAW-FIXME: The Cisco VIC firmware does not provide an api for a
        *            driver to dynamically change the mtu.  If/when the
@@ -1315,6 +1401,9 @@ dpdk_config (vlib_main_t * vm, unformat_input_t * input)
       else if (unformat (input, "enable-tcp-udp-checksum"))
 	conf->enable_tcp_udp_checksum = 1;
 
+      else if (unformat (input, "enable-tso"))
+	conf->enable_tso = 1;
+
       else if (unformat (input, "decimal-interface-names"))
 	conf->interface_name_format_decimal = 1;
 
@@ -2026,8 +2115,6 @@ dpdk_init (vlib_main_t * vm)
   STATIC_ASSERT (offsetof (dpdk_device_t, cacheline1) ==
 		 CLIB_CACHE_LINE_BYTES,
 		 "Data in cache line 0 is bigger than cache line size");
-  STATIC_ASSERT (offsetof (frame_queue_trace_t, cacheline0) == 0,
-		 "Cache line marker must be 1st element in frame_queue_trace_t");
 
   u8 *name;
   name = format (0, "dpdk_%08x%c", api_version, 0);
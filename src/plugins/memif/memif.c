@@ -86,10 +86,30 @@ memif_connect (vlib_main_t * vm, memif_if_t * mif)
 			       VNET_HW_INTERFACE_FLAG_LINK_UP);
 }
 
+/* Worker thread polling the given interface, see memif_input_fn */
+static u32
+memif_input_cpu_index (memif_if_t * mif)
+{
+  memif_main_t *mm = &memif_main;
+  return mm->input_cpu_first_index + (mif->if_index % mm->input_cpu_count);
+}
+
+/* Let interrupts from the peer wake the worker polling this interface */
+static void
+memif_interrupt_line_wakeup_add (memif_if_t * mif)
+{
+  clib_error_t *error;
+
+  if ((error = vlib_worker_thread_wakeup_fd_add (memif_input_cpu_index (mif),
+						 mif->interrupt_line.fd)))
+    clib_error_report (error);
+}
+
 static void
 memif_disconnect (vlib_main_t * vm, memif_if_t * mif)
 {
   vnet_main_t *vnm = vnet_get_main ();
+  clib_error_t *error;
 
   mif->flags &= ~(MEMIF_IF_FLAG_CONNECTED | MEMIF_IF_FLAG_CONNECTING);
   if (mif->hw_if_index != ~0)
@@ -97,6 +117,9 @@ memif_disconnect (vlib_main_t * vm, memif_if_t * mif)
 
   if (mif->interrupt_line.index != ~0)
     {
+      if ((error = vlib_worker_thread_wakeup_fd_del
+	   (memif_input_cpu_index (mif), mif->interrupt_line.fd)))
+	clib_error_report (error);
       unix_file_del (&unix_main,
 		     unix_main.file_pool + mif->interrupt_line.index);
       mif->interrupt_line.index = ~0;
@@ -237,6 +260,7 @@ memif_process_connect_req (memif_pending_conn_t * pending_conn,
   template.file_descriptor = int_fd;
   template.private_data = mif->if_index;
   mif->interrupt_line.index = unix_file_add (&unix_main, &template);
+  memif_interrupt_line_wakeup_add (mif);
 
   /* change context for future messages */
   uf = vec_elt_at_index (unix_main.file_pool,
@@ -550,6 +574,7 @@ memif_connect_master (vlib_main_t * vm, memif_if_t * mif)
   template.file_descriptor = mif->interrupt_line.fd;
   template.private_data = mif->if_index;
   mif->interrupt_line.index = unix_file_add (&unix_main, &template);
+  memif_interrupt_line_wakeup_add (mif);
 
   memset (&ctl, 0, sizeof (ctl));
   mh.msg_control = ctl;
@@ -736,12 +761,18 @@ memif_close_if (memif_main_t * mm, memif_if_t * mif)
 int
 memif_worker_thread_enable ()
 {
-  /* if worker threads are enabled, switch to polling mode */
+  /*
+   * If worker threads are enabled, switch them to polling mode. The main
+   * thread polls no interfaces then, and stays in interrupt mode so it
+   * can still sleep in epoll.
+   */
   foreach_vlib_main ((
 		       {
-		       vlib_node_set_state (this_vlib_main,
-					    memif_input_node.index,
-					    VLIB_NODE_STATE_POLLING);
+		       if (this_vlib_main->cpu_index >=
+			   memif_main.input_cpu_first_index)
+			 vlib_node_set_state (this_vlib_main,
+					      memif_input_node.index,
+					      VLIB_NODE_STATE_POLLING);
 		       }));
 
   return 0;
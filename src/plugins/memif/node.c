@@ -366,6 +366,7 @@ VLIB_REGISTER_NODE (memif_input_node) = {
   .format_trace = format_memif_input_trace,
   .type = VLIB_NODE_TYPE_INPUT,
   .state = VLIB_NODE_STATE_INTERRUPT,
+  .flags = VLIB_NODE_FLAG_ADAPTIVE_MODE,
   .n_errors = MEMIF_INPUT_N_ERROR,
   .error_strings = memif_input_error_strings,
 };
@@ -95,7 +95,8 @@ _(IN2OUT_PACKETS, "Good in2out packets processed")      \
 _(OUT_OF_PORTS, "Out of ports")                         \
 _(BAD_OUTSIDE_FIB, "Outside VRF ID not found")          \
 _(BAD_ICMP_TYPE, "icmp type not echo-request")          \
-_(NO_TRANSLATION, "No translation")
+_(NO_TRANSLATION, "No translation")                     \
+_(CONGESTION_DROP, "Handoff congestion drop")
   
 typedef enum {
 #define _(sym,str) SNAT_IN2OUT_ERROR_##sym,
@@ -305,6 +306,14 @@ static u32 slow_path (snat_main_t *sm, vlib_buffer_t *b0,
       kv0.key = s->out2in.as_u64;
       if (clib_bihash_add_del_8_8 (&sm->out2in, &kv0, 0 /* is_add */))
           clib_warning ("out2in key delete failed");
+      if (!sm->port_per_thread)
+        {
+          worker_by_out_key.addr = s->out2in.addr;
+          worker_by_out_key.port = s->out2in.port;
+          worker_by_out_key.fib_index = s->out2in.fib_index;
+          kv0.key = worker_by_out_key.as_u64;
+          clib_bihash_add_del_8_8 (&sm->worker_by_out, &kv0, 0);
+        }
 
       /* log NAT event */
       snat_ipfix_logging_nat44_ses_delete(s->in2out.addr.as_u32,
@@ -318,8 +327,8 @@ static u32 slow_path (snat_main_t *sm, vlib_buffer_t *b0,
         (sm, &s->out2in, s->outside_address_index);
       s->outside_address_index = ~0;
 
-      if (snat_alloc_outside_address_and_port (sm, rx_fib_index0, &key1,
-                                               &address_index))
+      if (snat_alloc_outside_address_and_port (sm, rx_fib_index0, cpu_index,
+                                               &key1, &address_index))
         {
           ASSERT(0);
 
@@ -337,7 +346,8 @@ static u32 slow_path (snat_main_t *sm, vlib_buffer_t *b0,
         {
           static_mapping = 0;
           /* Try to create dynamic translation */
-          if (snat_alloc_outside_address_and_port (sm, rx_fib_index0, &key1,
+          if (snat_alloc_outside_address_and_port (sm, rx_fib_index0,
+                                                   cpu_index, &key1,
                                                    &address_index))
             {
               b0->error = node->errors[SNAT_IN2OUT_ERROR_OUT_OF_PORTS];
@@ -350,6 +360,7 @@ static u32 slow_path (snat_main_t *sm, vlib_buffer_t *b0,
       memset (s, 0, sizeof (*s));
       
       s->outside_address_index = address_index;
+      s->timer_handle = ~0;
 
       if (static_mapping)
         {
@@ -384,8 +395,12 @@ static u32 slow_path (snat_main_t *sm, vlib_buffer_t *b0,
   s->out2in = key1;
   s->out2in.protocol = key0->protocol;
   s->out2in.fib_index = outside_fib_index;
+  s->state = SNAT_SESSION_UNKNOWN;
   *sessionp = s;
 
+  /* Recycled sessions restart their idle timer too */
+  snat_session_timer_update (sm, &sm->per_thread_data[cpu_index], s);
+
   /* Add to translation hashes */
   kv0.key = s->in2out.as_u64;
   kv0.value = s - sm->per_thread_data[cpu_index].sessions;
@@ -398,13 +413,17 @@ static u32 slow_path (snat_main_t *sm, vlib_buffer_t *b0,
   if (clib_bihash_add_del_8_8 (&sm->out2in, &kv0, 1 /* is_add */))
       clib_warning ("out2in key add failed");
 
-  /* Add to translated packets worker lookup */
-  worker_by_out_key.addr = s->out2in.addr;
-  worker_by_out_key.port = s->out2in.port;
-  worker_by_out_key.fib_index = s->out2in.fib_index;
-  kv0.key = worker_by_out_key.as_u64;
-  kv0.value = cpu_index;
-  clib_bihash_add_del_8_8 (&sm->worker_by_out, &kv0, 1);
+  /* Add to translated packets worker lookup, partitioned ports name
+     their worker already */
+  if (!sm->port_per_thread || snat_is_session_static (s))
+    {
+      worker_by_out_key.addr = s->out2in.addr;
+      worker_by_out_key.port = s->out2in.port;
+      worker_by_out_key.fib_index = s->out2in.fib_index;
+      kv0.key = worker_by_out_key.as_u64;
+      kv0.value = cpu_index;
+      clib_bihash_add_del_8_8 (&sm->worker_by_out, &kv0, 1);
+    }
 
   /* log NAT event */
   snat_ipfix_logging_nat44_ses_create(s->in2out.addr.as_u32,
@@ -792,10 +811,13 @@ snat_hairpinning (snat_main_t *sm,
           k0.port = udp0->dst_port;
           k0.fib_index = sm->outside_fib_index;
           kv0.key = k0.as_u64;
-          if (clib_bihash_search_8_8 (&sm->worker_by_out, &kv0, &value0))
-            ASSERT(0);
-          else
+          if (!clib_bihash_search_8_8 (&sm->worker_by_out, &kv0, &value0))
             ti = value0.value;
+          else if (sm->port_per_thread)
+            ti = snat_worker_by_out_port (sm,
+                                          clib_net_to_host_u16 (k0.port));
+          else
+            ASSERT(0);
         }
       else
         ti = sm->num_workers;
@@ -885,6 +907,10 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
   f64 now = vlib_time_now (vm);
   u32 stats_node_index;
   u32 cpu_index = os_get_cpu_number ();
+  clib_bihash_kv_8_8_t kvs[VLIB_FRAME_SIZE];
+  u8 hits[VLIB_FRAME_SIZE];
+  u32 packet_index = 0, pi0, pi1;
+  u8 tables_dirty = 0;
 
   stats_node_index = is_slow_path ? snat_in2out_slowpath_node.index :
     snat_in2out_node.index;
@@ -893,6 +919,9 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
   n_left_from = frame->n_vectors;
   next_index = node->cached_next_index;
 
+  snat_lookup_frame (vm, sm, &sm->in2out, from, n_left_from,
+                     1 /* is_in2out */, kvs, hits);
+
   while (n_left_from > 0)
     {
       u32 n_left_to_next;
@@ -940,6 +969,9 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 	  to_next += 2;
 	  n_left_from -= 2;
 	  n_left_to_next -= 2;
+          pi0 = packet_index;
+          pi1 = packet_index + 1;
+          packet_index += 2;
           
 	  b0 = vlib_get_buffer (vm, bi0);
 	  b1 = vlib_get_buffer (vm, bi1);
@@ -975,6 +1007,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
               
               if (PREDICT_FALSE (proto0 == SNAT_PROTOCOL_ICMP))
                 {
+                  tables_dirty = 1;
                   next0 = icmp_in2out_slow_path 
                     (sm, b0, ip0, icmp0, sw_if_index0, rx_fib_index0, 
                      node, next0, now, cpu_index, &s0);
@@ -997,7 +1030,8 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
           
           kv0.key = key0.as_u64;
 
-          if (PREDICT_FALSE (clib_bihash_search_8_8 (&sm->in2out, &kv0, &value0) != 0))
+          if (PREDICT_FALSE (snat_frame_search (&sm->in2out, &kv0, &value0, kvs,
+                                                 hits, pi0, tables_dirty)))
             {
               if (is_slow_path)
                 {
@@ -1005,6 +1039,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
                       proto0, rx_fib_index0)))
                     goto trace00;
 
+                  tables_dirty = 1;
                   next0 = slow_path (sm, b0, ip0, rx_fib_index0, &key0,
                                      &s0, node, next0, cpu_index);
                   if (PREDICT_FALSE (next0 == SNAT_IN2OUT_NEXT_DROP))
@@ -1058,6 +1093,10 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 
           /* Accounting */
           s0->last_heard = now;
+          if (PREDICT_TRUE (proto0 == SNAT_PROTOCOL_TCP) &&
+              PREDICT_FALSE (snat_session_tcp_update (sm, s0, tcp0, 1)))
+            snat_session_timer_update (sm, &sm->per_thread_data[cpu_index],
+                                       s0);
           s0->total_pkts++;
           s0->total_bytes += vlib_buffer_length_in_chain (vm, b0);
           /* Per-user LRU list maintenance for dynamic translation */
@@ -1115,6 +1154,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
               
               if (PREDICT_FALSE (proto1 == SNAT_PROTOCOL_ICMP))
                 {
+                  tables_dirty = 1;
                   next1 = icmp_in2out_slow_path 
                     (sm, b1, ip1, icmp1, sw_if_index1, rx_fib_index1, node,
                      next1, now, cpu_index, &s1);
@@ -1137,7 +1177,8 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
           
           kv1.key = key1.as_u64;
 
-            if (PREDICT_FALSE(clib_bihash_search_8_8 (&sm->in2out, &kv1, &value1) != 0))
+            if (PREDICT_FALSE (snat_frame_search (&sm->in2out, &kv1, &value1, kvs,
+                                                 hits, pi1, tables_dirty)))
             {
               if (is_slow_path)
                 {
@@ -1145,6 +1186,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
                       proto1, rx_fib_index1)))
                     goto trace01;
 
+                  tables_dirty = 1;
                   next1 = slow_path (sm, b1, ip1, rx_fib_index1, &key1,
                                      &s1, node, next1, cpu_index);
                   if (PREDICT_FALSE (next1 == SNAT_IN2OUT_NEXT_DROP))
@@ -1198,6 +1240,10 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 
           /* Accounting */
           s1->last_heard = now;
+          if (PREDICT_TRUE (proto1 == SNAT_PROTOCOL_TCP) &&
+              PREDICT_FALSE (snat_session_tcp_update (sm, s1, tcp1, 1)))
+            snat_session_timer_update (sm, &sm->per_thread_data[cpu_index],
+                                       s1);
           s1->total_pkts++;
           s1->total_bytes += vlib_buffer_length_in_chain (vm, b1);
           /* Per-user LRU list maintenance for dynamic translation */
@@ -1257,6 +1303,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 	  to_next += 1;
 	  n_left_from -= 1;
 	  n_left_to_next -= 1;
+          pi0 = packet_index++;
 
 	  b0 = vlib_get_buffer (vm, bi0);
           next0 = SNAT_IN2OUT_NEXT_LOOKUP;
@@ -1290,6 +1337,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
               
               if (PREDICT_FALSE (proto0 == SNAT_PROTOCOL_ICMP))
                 {
+                  tables_dirty = 1;
                   next0 = icmp_in2out_slow_path 
                     (sm, b0, ip0, icmp0, sw_if_index0, rx_fib_index0, node,
                      next0, now, cpu_index, &s0);
@@ -1312,7 +1360,8 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
           
           kv0.key = key0.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->in2out, &kv0, &value0))
+          if (snat_frame_search (&sm->in2out, &kv0, &value0, kvs, hits,
+                                 pi0, tables_dirty))
             {
               if (is_slow_path)
                 {
@@ -1320,6 +1369,7 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
                       proto0, rx_fib_index0)))
                     goto trace0;
 
+                  tables_dirty = 1;
                   next0 = slow_path (sm, b0, ip0, rx_fib_index0, &key0,
                                      &s0, node, next0, cpu_index);
 
@@ -1374,6 +1424,10 @@ snat_in2out_node_fn_inline (vlib_main_t * vm,
 
           /* Accounting */
           s0->last_heard = now;
+          if (PREDICT_TRUE (proto0 == SNAT_PROTOCOL_TCP) &&
+              PREDICT_FALSE (snat_session_tcp_update (sm, s0, tcp0, 1)))
+            snat_session_timer_update (sm, &sm->per_thread_data[cpu_index],
+                                       s0);
           s0->total_pkts++;
           s0->total_bytes += vlib_buffer_length_in_chain (vm, b0);
           /* Per-user LRU list maintenance for dynamic translation */
@@ -2001,27 +2055,17 @@ snat_in2out_worker_handoff_fn (vlib_main_t * vm,
   snat_main_t *sm = &snat_main;
   vlib_thread_main_t *tm = vlib_get_thread_main ();
   u32 n_left_from, *from, *to_next = 0;
-  static __thread vlib_frame_queue_elt_t **handoff_queue_elt_by_worker_index;
-  static __thread vlib_frame_queue_t **congested_handoff_queue_by_worker_index
-    = 0;
-  vlib_frame_queue_elt_t *hf = 0;
+  static __thread u32 **buffers_by_worker_index;
+  u32 *buffers, n_enq, n_drop = 0;
   vlib_frame_t *f = 0;
   int i;
-  u32 n_left_to_next_worker = 0, *to_next_worker = 0;
   u32 next_worker_index = 0;
-  u32 current_worker_index = ~0;
   u32 cpu_index = os_get_cpu_number ();
 
   ASSERT (vec_len (sm->workers));
 
-  if (PREDICT_FALSE (handoff_queue_elt_by_worker_index == 0))
-    {
-      vec_validate (handoff_queue_elt_by_worker_index, tm->n_vlib_mains - 1);
-
-      vec_validate_init_empty (congested_handoff_queue_by_worker_index,
-			       sm->first_worker_index + sm->num_workers - 1,
-			       (vlib_frame_queue_t *) (~0));
-    }
+  if (PREDICT_FALSE (buffers_by_worker_index == 0))
+    vec_validate (buffers_by_worker_index, tm->n_vlib_mains - 1);
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -2052,33 +2096,8 @@ snat_in2out_worker_handoff_fn (vlib_main_t * vm,
         {
           do_handoff = 1;
 
-          if (next_worker_index != current_worker_index)
-            {
-              if (hf)
-                hf->n_vectors = VLIB_FRAME_SIZE - n_left_to_next_worker;
-
-              hf = vlib_get_worker_handoff_queue_elt (sm->fq_in2out_index,
-                                                      next_worker_index,
-                                                      handoff_queue_elt_by_worker_index);
-
-              n_left_to_next_worker = VLIB_FRAME_SIZE - hf->n_vectors;
-              to_next_worker = &hf->buffer_index[hf->n_vectors];
-              current_worker_index = next_worker_index;
-            }
-
-          /* enqueue to correct worker thread */
-          to_next_worker[0] = bi0;
-          to_next_worker++;
-          n_left_to_next_worker--;
-
-          if (n_left_to_next_worker == 0)
-            {
-              hf->n_vectors = VLIB_FRAME_SIZE;
-              vlib_put_frame_queue_elt (hf);
-              current_worker_index = ~0;
-              handoff_queue_elt_by_worker_index[next_worker_index] = 0;
-              hf = 0;
-            }
+          /* Batch per destination worker, enqueued below in one go */
+          vec_add1 (buffers_by_worker_index[next_worker_index], bi0);
         }
       else
         {
@@ -2108,32 +2127,27 @@ snat_in2out_worker_handoff_fn (vlib_main_t * vm,
   if (f)
     vlib_put_frame_to_node (vm, sm->in2out_node_index, f);
 
-  if (hf)
-    hf->n_vectors = VLIB_FRAME_SIZE - n_left_to_next_worker;
-
-  /* Ship frames to the worker nodes */
-  for (i = 0; i < vec_len (handoff_queue_elt_by_worker_index); i++)
+  /* Ship the buffers to the worker threads, drop what doesn't fit */
+  for (i = 0; i < vec_len (buffers_by_worker_index); i++)
     {
-      if (handoff_queue_elt_by_worker_index[i])
-	{
-	  hf = handoff_queue_elt_by_worker_index[i];
-	  /*
-	   * It works better to let the handoff node
-	   * rate-adapt, always ship the handoff queue element.
-	   */
-	  if (1 || hf->n_vectors == hf->last_n_vectors)
-	    {
-	      vlib_put_frame_queue_elt (hf);
-	      handoff_queue_elt_by_worker_index[i] = 0;
-	    }
-	  else
-	    hf->last_n_vectors = hf->n_vectors;
-	}
-      congested_handoff_queue_by_worker_index[i] =
-	(vlib_frame_queue_t *) (~0);
+      buffers = buffers_by_worker_index[i];
+      if (vec_len (buffers) == 0)
+        continue;
+
+      n_enq = vlib_frame_queue_enqueue (vm, sm->fq_in2out_index, i,
+                                        buffers, vec_len (buffers));
+      if (PREDICT_FALSE (n_enq < vec_len (buffers)))
+        {
+          vlib_buffer_free (vm, buffers + n_enq, vec_len (buffers) - n_enq);
+          n_drop += vec_len (buffers) - n_enq;
+        }
+      _vec_len (buffers) = 0;
     }
-  hf = 0;
-  current_worker_index = ~0;
+
+  if (PREDICT_FALSE (n_drop))
+    vlib_node_increment_counter (vm, node->node_index,
+                                 SNAT_IN2OUT_ERROR_CONGESTION_DROP, n_drop);
+
   return frame->n_vectors;
 }
 
@@ -2143,6 +2157,9 @@ VLIB_REGISTER_NODE (snat_in2out_worker_handoff_node) = {
   .vector_size = sizeof (u32),
   .format_trace = format_snat_in2out_worker_handoff_trace,
   .type = VLIB_NODE_TYPE_INTERNAL,
+
+  .n_errors = ARRAY_LEN(snat_in2out_error_strings),
+  .error_strings = snat_in2out_error_strings,
   
   .n_next_nodes = 1,
 
@@ -87,7 +87,8 @@ vlib_node_registration_t snat_det_out2in_node;
 _(UNSUPPORTED_PROTOCOL, "Unsupported protocol")         \
 _(OUT2IN_PACKETS, "Good out2in packets processed")      \
 _(BAD_ICMP_TYPE, "icmp type not echo-reply")            \
-_(NO_TRANSLATION, "No translation")
+_(NO_TRANSLATION, "No translation")                     \
+_(CONGESTION_DROP, "Handoff congestion drop")
   
 typedef enum {
 #define _(sym,str) SNAT_OUT2IN_ERROR_##sym,
@@ -203,6 +204,8 @@ create_session_for_static_mapping (snat_main_t *sm,
   s->in2out = in2out;
   s->out2in = out2in;
   s->in2out.protocol = out2in.protocol;
+  snat_session_timer_start (&sm->per_thread_data[cpu_index], s,
+                            snat_session_timeout (sm, s));
 
   /* Add to translation hashes */
   kv0.key = s->in2out.as_u64;
@@ -625,11 +628,18 @@ snat_out2in_node_fn (vlib_main_t * vm,
   snat_main_t * sm = &snat_main;
   f64 now = vlib_time_now (vm);
   u32 cpu_index = os_get_cpu_number ();
+  clib_bihash_kv_8_8_t kvs[VLIB_FRAME_SIZE];
+  u8 hits[VLIB_FRAME_SIZE];
+  u32 packet_index = 0, pi0, pi1;
+  u8 tables_dirty = 0;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
   next_index = node->cached_next_index;
 
+  snat_lookup_frame (vm, sm, &sm->out2in, from, n_left_from,
+                     0 /* is_in2out */, kvs, hits);
+
   while (n_left_from > 0)
     {
       u32 n_left_to_next;
@@ -680,6 +690,9 @@ snat_out2in_node_fn (vlib_main_t * vm,
 	  to_next += 2;
 	  n_left_from -= 2;
 	  n_left_to_next -= 2;
+          pi0 = packet_index;
+          pi1 = packet_index + 1;
+          packet_index += 2;
 
 	  b0 = vlib_get_buffer (vm, bi0);
 	  b1 = vlib_get_buffer (vm, bi1);
@@ -710,6 +723,7 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           if (PREDICT_FALSE (proto0 == SNAT_PROTOCOL_ICMP))
             {
+              tables_dirty = 1;
               next0 = icmp_out2in_slow_path 
                 (sm, b0, ip0, icmp0, sw_if_index0, rx_fib_index0, node, 
                  next0, now, cpu_index, &s0);
@@ -723,7 +737,8 @@ snat_out2in_node_fn (vlib_main_t * vm,
           
           kv0.key = key0.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->out2in, &kv0, &value0))
+          if (snat_frame_search (&sm->out2in, &kv0, &value0, kvs, hits,
+                                 pi0, tables_dirty))
             {
               /* Try to match static mapping by external address and port,
                  destination address and port in packet */
@@ -742,6 +757,7 @@ snat_out2in_node_fn (vlib_main_t * vm,
                 }
 
               /* Create session initiated by host from external network */
+              tables_dirty = 1;
               s0 = create_session_for_static_mapping(sm, b0, sm0, key0, node,
                                                      cpu_index);
               if (!s0)
@@ -791,6 +807,10 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           /* Accounting */
           s0->last_heard = now;
+          if (PREDICT_TRUE (proto0 == SNAT_PROTOCOL_TCP) &&
+              PREDICT_FALSE (snat_session_tcp_update (sm, s0, tcp0, 0)))
+            snat_session_timer_update (sm, &sm->per_thread_data[cpu_index],
+                                       s0);
           s0->total_pkts++;
           s0->total_bytes += vlib_buffer_length_in_chain (vm, b0);
           /* Per-user LRU list maintenance for dynamic translation */
@@ -845,6 +865,7 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           if (PREDICT_FALSE (proto1 == SNAT_PROTOCOL_ICMP))
             {
+              tables_dirty = 1;
               next1 = icmp_out2in_slow_path 
                 (sm, b1, ip1, icmp1, sw_if_index1, rx_fib_index1, node, 
                  next1, now, cpu_index, &s1);
@@ -858,7 +879,8 @@ snat_out2in_node_fn (vlib_main_t * vm,
           
           kv1.key = key1.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->out2in, &kv1, &value1))
+          if (snat_frame_search (&sm->out2in, &kv1, &value1, kvs, hits,
+                                 pi1, tables_dirty))
             {
               /* Try to match static mapping by external address and port,
                  destination address and port in packet */
@@ -877,6 +899,7 @@ snat_out2in_node_fn (vlib_main_t * vm,
                 }
 
               /* Create session initiated by host from external network */
+              tables_dirty = 1;
               s1 = create_session_for_static_mapping(sm, b1, sm1, key1, node,
                                                      cpu_index);
               if (!s1)
@@ -926,6 +949,10 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           /* Accounting */
           s1->last_heard = now;
+          if (PREDICT_TRUE (proto1 == SNAT_PROTOCOL_TCP) &&
+              PREDICT_FALSE (snat_session_tcp_update (sm, s1, tcp1, 0)))
+            snat_session_timer_update (sm, &sm->per_thread_data[cpu_index],
+                                       s1);
           s1->total_pkts++;
           s1->total_bytes += vlib_buffer_length_in_chain (vm, b1);
           /* Per-user LRU list maintenance for dynamic translation */
@@ -985,6 +1012,7 @@ snat_out2in_node_fn (vlib_main_t * vm,
 	  to_next += 1;
 	  n_left_from -= 1;
 	  n_left_to_next -= 1;
+          pi0 = packet_index++;
 
 	  b0 = vlib_get_buffer (vm, bi0);
 
@@ -1014,6 +1042,7 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           if (PREDICT_FALSE (proto0 == SNAT_PROTOCOL_ICMP))
             {
+              tables_dirty = 1;
               next0 = icmp_out2in_slow_path 
                 (sm, b0, ip0, icmp0, sw_if_index0, rx_fib_index0, node, 
                  next0, now, cpu_index, &s0);
@@ -1027,7 +1056,8 @@ snat_out2in_node_fn (vlib_main_t * vm,
           
           kv0.key = key0.as_u64;
 
-          if (clib_bihash_search_8_8 (&sm->out2in, &kv0, &value0))
+          if (snat_frame_search (&sm->out2in, &kv0, &value0, kvs, hits,
+                                 pi0, tables_dirty))
             {
               /* Try to match static mapping by external address and port,
                  destination address and port in packet */
@@ -1047,6 +1077,7 @@ snat_out2in_node_fn (vlib_main_t * vm,
                 }
 
               /* Create session initiated by host from external network */
+              tables_dirty = 1;
               s0 = create_session_for_static_mapping(sm, b0, sm0, key0, node,
                                                      cpu_index);
               if (!s0)
@@ -1096,6 +1127,10 @@ snat_out2in_node_fn (vlib_main_t * vm,
 
           /* Accounting */
           s0->last_heard = now;
+          if (PREDICT_TRUE (proto0 == SNAT_PROTOCOL_TCP) &&
+              PREDICT_FALSE (snat_session_tcp_update (sm, s0, tcp0, 0)))
+            snat_session_timer_update (sm, &sm->per_thread_data[cpu_index],
+                                       s0);
           s0->total_pkts++;
           s0->total_bytes += vlib_buffer_length_in_chain (vm, b0);
           /* Per-user LRU list maintenance for dynamic translation */
@@ -1590,27 +1625,17 @@ snat_out2in_worker_handoff_fn (vlib_main_t * vm,
   snat_main_t *sm = &snat_main;
   vlib_thread_main_t *tm = vlib_get_thread_main ();
   u32 n_left_from, *from, *to_next = 0;
-  static __thread vlib_frame_queue_elt_t **handoff_queue_elt_by_worker_index;
-  static __thread vlib_frame_queue_t **congested_handoff_queue_by_worker_index
-    = 0;
-  vlib_frame_queue_elt_t *hf = 0;
+  static __thread u32 **buffers_by_worker_index;
+  u32 *buffers, n_enq, n_drop = 0;
   vlib_frame_t *f = 0;
   int i;
-  u32 n_left_to_next_worker = 0, *to_next_worker = 0;
   u32 next_worker_index = 0;
-  u32 current_worker_index = ~0;
   u32 cpu_index = os_get_cpu_number ();
 
   ASSERT (vec_len (sm->workers));
 
-  if (PREDICT_FALSE (handoff_queue_elt_by_worker_index == 0))
-    {
-      vec_validate (handoff_queue_elt_by_worker_index, tm->n_vlib_mains - 1);
-
-      vec_validate_init_empty (congested_handoff_queue_by_worker_index,
-			       sm->first_worker_index + sm->num_workers - 1,
-			       (vlib_frame_queue_t *) (~0));
-    }
+  if (PREDICT_FALSE (buffers_by_worker_index == 0))
+    vec_validate (buffers_by_worker_index, tm->n_vlib_mains - 1);
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -1641,33 +1666,8 @@ snat_out2in_worker_handoff_fn (vlib_main_t * vm,
         {
           do_handoff = 1;
 
-          if (next_worker_index != current_worker_index)
-            {
-              if (hf)
-                hf->n_vectors = VLIB_FRAME_SIZE - n_left_to_next_worker;
-
-              hf = vlib_get_worker_handoff_queue_elt (sm->fq_out2in_index,
-                                                      next_worker_index,
-                                                      handoff_queue_elt_by_worker_index);
-
-              n_left_to_next_worker = VLIB_FRAME_SIZE - hf->n_vectors;
-              to_next_worker = &hf->buffer_index[hf->n_vectors];
-              current_worker_index = next_worker_index;
-            }
-
-          /* enqueue to correct worker thread */
-          to_next_worker[0] = bi0;
-          to_next_worker++;
-          n_left_to_next_worker--;
-
-          if (n_left_to_next_worker == 0)
-            {
-              hf->n_vectors = VLIB_FRAME_SIZE;
-              vlib_put_frame_queue_elt (hf);
-              current_worker_index = ~0;
-              handoff_queue_elt_by_worker_index[next_worker_index] = 0;
-              hf = 0;
-            }
+          /* Batch per destination worker, enqueued below in one go */
+          vec_add1 (buffers_by_worker_index[next_worker_index], bi0);
         }
       else
         {
@@ -1697,32 +1697,27 @@ snat_out2in_worker_handoff_fn (vlib_main_t * vm,
   if (f)
     vlib_put_frame_to_node (vm, sm->out2in_node_index, f);
 
-  if (hf)
-    hf->n_vectors = VLIB_FRAME_SIZE - n_left_to_next_worker;
-
-  /* Ship frames to the worker nodes */
-  for (i = 0; i < vec_len (handoff_queue_elt_by_worker_index); i++)
+  /* Ship the buffers to the worker threads, drop what doesn't fit */
+  for (i = 0; i < vec_len (buffers_by_worker_index); i++)
     {
-      if (handoff_queue_elt_by_worker_index[i])
-	{
-	  hf = handoff_queue_elt_by_worker_index[i];
-	  /*
-	   * It works better to let the handoff node
-	   * rate-adapt, always ship the handoff queue element.
-	   */
-	  if (1 || hf->n_vectors == hf->last_n_vectors)
-	    {
-	      vlib_put_frame_queue_elt (hf);
-	      handoff_queue_elt_by_worker_index[i] = 0;
-	    }
-	  else
-	    hf->last_n_vectors = hf->n_vectors;
-	}
-      congested_handoff_queue_by_worker_index[i] =
-	(vlib_frame_queue_t *) (~0);
+      buffers = buffers_by_worker_index[i];
+      if (vec_len (buffers) == 0)
+        continue;
+
+      n_enq = vlib_frame_queue_enqueue (vm, sm->fq_out2in_index, i,
+                                        buffers, vec_len (buffers));
+      if (PREDICT_FALSE (n_enq < vec_len (buffers)))
+        {
+          vlib_buffer_free (vm, buffers + n_enq, vec_len (buffers) - n_enq);
+          n_drop += vec_len (buffers) - n_enq;
+        }
+      _vec_len (buffers) = 0;
     }
-  hf = 0;
-  current_worker_index = ~0;
+
+  if (PREDICT_FALSE (n_drop))
+    vlib_node_increment_counter (vm, node->node_index,
+                                 SNAT_OUT2IN_ERROR_CONGESTION_DROP, n_drop);
+
   return frame->n_vectors;
 }
 
@@ -1732,6 +1727,9 @@ VLIB_REGISTER_NODE (snat_out2in_worker_handoff_node) = {
   .vector_size = sizeof (u32),
   .format_trace = format_snat_out2in_worker_handoff_trace,
   .type = VLIB_NODE_TYPE_INTERNAL,
+
+  .n_errors = ARRAY_LEN(snat_out2in_error_strings),
+  .error_strings = snat_out2in_error_strings,
   
   .n_next_nodes = 1,
 
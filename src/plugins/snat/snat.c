@@ -258,6 +258,7 @@ void snat_add_address (snat_main_t *sm, ip4_address_t *addr, u32 vrf_id)
 {
   snat_address_t * ap;
   snat_interface_t *i;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
 
   if (vrf_id != ~0)
     sm->vrf_mode = 1;
@@ -273,7 +274,8 @@ void snat_add_address (snat_main_t *sm, ip4_address_t *addr, u32 vrf_id)
   ap->addr = *addr;
   ap->fib_index = ip4_fib_index_from_table_id(vrf_id);
 #define _(N, i, n, s) \
-  clib_bitmap_alloc (ap->busy_##n##_port_bitmap, 65535);
+  clib_bitmap_alloc (ap->busy_##n##_port_bitmap, 65535); \
+  vec_validate (ap->busy_##n##_ports_per_thread, tm->n_vlib_mains - 1);
   foreach_snat_protocol
 #undef _
 
@@ -431,8 +433,14 @@ int snat_add_static_mapping(ip4_address_t l_addr, ip4_address_t e_addr,
                       if (clib_bitmap_get_no_check (a->busy_##n##_port_bitmap, e_port)) \
                         return VNET_API_ERROR_INVALID_VALUE; \
                       clib_bitmap_set_no_check (a->busy_##n##_port_bitmap, e_port, 1); \
-                      if (e_port > 1024) \
-                        a->busy_##n##_ports++; \
+                      if (e_port >= 1024) \
+                        { \
+                          __sync_fetch_and_add (&a->busy_##n##_ports, 1); \
+                          if (sm->port_per_thread) \
+                            __sync_fetch_and_add \
+                              (&a->busy_##n##_ports_per_thread \
+                               [snat_worker_by_out_port (sm, e_port)], 1); \
+                        } \
                       break;
                       foreach_snat_protocol
 #undef _
@@ -524,8 +532,14 @@ int snat_add_static_mapping(ip4_address_t l_addr, ip4_address_t e_addr,
 #define _(N, j, n, s) \
                     case SNAT_PROTOCOL_##N: \
                       clib_bitmap_set_no_check (a->busy_##n##_port_bitmap, e_port, 0); \
-                      if (e_port > 1024) \
-                        a->busy_##n##_ports--; \
+                      if (e_port >= 1024) \
+                        { \
+                          __sync_fetch_and_sub (&a->busy_##n##_ports, 1); \
+                          if (sm->port_per_thread) \
+                            __sync_fetch_and_sub \
+                              (&a->busy_##n##_ports_per_thread \
+                               [snat_worker_by_out_port (sm, e_port)], 1); \
+                        } \
                       break;
                       foreach_snat_protocol
 #undef _
@@ -609,6 +623,7 @@ int snat_add_static_mapping(ip4_address_t l_addr, ip4_address_t e_addr,
                       clib_bihash_add_del_8_8 (&sm->in2out, &value, 0);
                       value.key = s->out2in.as_u64;
                       clib_bihash_add_del_8_8 (&sm->out2in, &value, 0);
+                      snat_session_timer_stop (tsm, s);
                       pool_put (tsm->sessions, s);
 
                       clib_dlist_remove (tsm->list_pool, del_elt_index);
@@ -713,6 +728,7 @@ int snat_del_address (snat_main_t *sm, ip4_address_t addr, u8 delete_sm)
                 clib_bihash_add_del_8_8 (&sm->in2out, &kv, 0);
                 kv.key = ses->out2in.as_u64;
                 clib_bihash_add_del_8_8 (&sm->out2in, &kv, 0);
+                snat_session_timer_stop (tsm, ses);
                 clib_dlist_remove (tsm->list_pool, ses->per_user_index);
                 user_key.addr = ses->in2out.addr;
                 user_key.fib_index = ses->in2out.fib_index;
@@ -732,6 +748,11 @@ int snat_del_address (snat_main_t *sm, ip4_address_t addr, u8 delete_sm)
        }
     }
 
+#define _(N, j, n, s) \
+  clib_bitmap_free (a->busy_##n##_port_bitmap); \
+  vec_free (a->busy_##n##_ports_per_thread);
+  foreach_snat_protocol
+#undef _
   vec_del1 (sm->addresses, i);
 
   /* Delete external address from FIB */
@@ -821,9 +842,59 @@ fib:
   return 0;
 }
 
+/**
+ * \brief Split the outside port space between SNAT workers.
+ *
+ * Each worker allocates ports from its own slice only, so the worker a
+ * translated packet belongs to follows from its destination port. Slices
+ * are whole bitmap words, workers never write the same word of a busy
+ * port bitmap.
+ */
+static void
+snat_set_port_ranges (snat_main_t * sm)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  snat_address_t *a;
+  u32 i, port, n_workers = vec_len (sm->workers);
+
+  sm->port_per_thread = 0;
+  vec_free (sm->port_slice_by_thread);
+
+  if (!sm->port_partitioning || n_workers == 0)
+    return;
+
+  sm->port_per_thread = ((65536 - 1024) / n_workers) & ~(BITS (uword) - 1);
+  if (sm->port_per_thread == 0)
+    {
+      clib_warning ("too many workers to partition ports");
+      return;
+    }
+
+  vec_validate_init_empty (sm->port_slice_by_thread, tm->n_vlib_mains - 1,
+                           ~0);
+  for (i = 0; i < n_workers; i++)
+    sm->port_slice_by_thread[sm->first_worker_index + sm->workers[i]] = i;
+
+  /* Recount busy ports by owner */
+  vec_foreach (a, sm->addresses)
+    {
+#define _(N, j, n, s) \
+      vec_zero (a->busy_##n##_ports_per_thread); \
+      clib_bitmap_foreach (port, a->busy_##n##_port_bitmap, \
+        ({ \
+          if (port >= 1024) \
+            a->busy_##n##_ports_per_thread \
+              [snat_worker_by_out_port (sm, port)]++; \
+        }));
+      foreach_snat_protocol
+#undef _
+    }
+}
+
 static int snat_set_workers (uword * bitmap)
 {
   snat_main_t *sm = &snat_main;
+  snat_main_per_thread_data_t *tsm;
   int i;
 
   if (sm->num_workers < 2)
@@ -832,12 +903,21 @@ static int snat_set_workers (uword * bitmap)
   if (clib_bitmap_last_set (bitmap) >= sm->num_workers)
     return VNET_API_ERROR_INVALID_WORKER;
 
+  /* Repartitioning would strand the outside ports of live sessions in
+     another worker's slice */
+  if (sm->port_partitioning)
+    vec_foreach (tsm, sm->per_thread_data)
+      if (pool_elts (tsm->sessions))
+        return VNET_API_ERROR_ADDRESS_IN_USE;
+
   vec_free (sm->workers);
   clib_bitmap_foreach (i, bitmap,
     ({
       vec_add1(sm->workers, i);
     }));
 
+  snat_set_port_ranges (sm);
+
   return 0;
 }
 
@@ -1825,6 +1905,9 @@ snat_ip4_add_del_interface_address_cb (ip4_main_t * im,
                                        u32 if_address_index,
                                        u32 is_delete);
 
+static void snat_session_timers_expired (vlib_main_t * vm,
+                                         u32 * session_indices);
+
 static clib_error_t * snat_init (vlib_main_t * vm)
 {
   snat_main_t * sm = &snat_main;
@@ -1891,6 +1974,11 @@ static clib_error_t * snat_init (vlib_main_t * vm)
 
   vec_add1 (im->add_del_interface_address_callbacks, cb4);
 
+  /* Session idle timers run on the per-thread vlib timer wheels */
+  sm->session_timer_client_index =
+    vlib_timer_client_register ("snat-sessions",
+                                snat_session_timers_expired);
+
   /* Init IPFIX logging */
   snat_ipfix_logging_init(vm);
 
@@ -1899,6 +1987,85 @@ static clib_error_t * snat_init (vlib_main_t * vm)
 
 VLIB_INIT_FUNCTION (snat_init);
 
+/**
+ * \brief Delete a SNAT session, its translation table entries, per-user
+ * list element and outside port. Users left without sessions go too.
+ *
+ * @param sm           SNAT main
+ * @param thread_index thread owning the session
+ * @param s            SNAT session
+ */
+void snat_session_delete (snat_main_t * sm, u32 thread_index,
+                          snat_session_t * s)
+{
+  snat_main_per_thread_data_t *tsm;
+  clib_bihash_kv_8_8_t kv, value;
+  snat_user_key_t u_key;
+  snat_worker_key_t w_key;
+  snat_session_key_t out2in_key;
+  snat_user_t *u;
+
+  tsm = vec_elt_at_index (sm->per_thread_data, thread_index);
+
+  snat_session_timer_stop (tsm, s);
+
+  /* log NAT event */
+  snat_ipfix_logging_nat44_ses_delete (s->in2out.addr.as_u32,
+                                       s->out2in.addr.as_u32,
+                                       s->in2out.protocol,
+                                       s->in2out.port,
+                                       s->out2in.port,
+                                       s->in2out.fib_index);
+
+  kv.key = s->in2out.as_u64;
+  if (clib_bihash_add_del_8_8 (&sm->in2out, &kv, 0))
+    clib_warning ("in2out key delete failed");
+  kv.key = s->out2in.as_u64;
+  if (clib_bihash_add_del_8_8 (&sm->out2in, &kv, 0))
+    clib_warning ("out2in key delete failed");
+
+  clib_dlist_remove (tsm->list_pool, s->per_user_index);
+  pool_put_index (tsm->list_pool, s->per_user_index);
+
+  u_key.addr = s->in2out.addr;
+  u_key.fib_index = s->in2out.fib_index;
+  kv.key = u_key.as_u64;
+  if (!clib_bihash_search_8_8 (&sm->user_hash, &kv, &value))
+    {
+      u = pool_elt_at_index (tsm->users, value.value);
+      if (snat_is_session_static (s))
+        u->nstaticsessions--;
+      else
+        u->nsessions--;
+
+      if (!u->nsessions && !u->nstaticsessions)
+        {
+          pool_put_index (tsm->list_pool,
+                          u->sessions_per_user_list_head_index);
+          pool_put (tsm->users, u);
+          clib_bihash_add_del_8_8 (&sm->user_hash, &kv, 0);
+        }
+    }
+
+  if (!snat_is_session_static (s))
+    {
+      /* Static mappings own the worker lookup entries of their sessions */
+      if (!sm->port_per_thread)
+        {
+          w_key.addr = s->out2in.addr;
+          w_key.port = s->out2in.port;
+          w_key.fib_index = s->out2in.fib_index;
+          kv.key = w_key.as_u64;
+          clib_bihash_add_del_8_8 (&sm->worker_by_out, &kv, 0);
+        }
+      out2in_key = s->out2in;
+      snat_free_outside_address_and_port (sm, &out2in_key,
+                                          s->outside_address_index);
+    }
+
+  pool_put (tsm->sessions, s);
+}
+
 void snat_free_outside_address_and_port (snat_main_t * sm, 
                                          snat_session_key_t * k, 
                                          u32 address_index)
@@ -1918,7 +2085,10 @@ void snat_free_outside_address_and_port (snat_main_t * sm,
         port_host_byte_order) == 1); \
       clib_bitmap_set_no_check (a->busy_##n##_port_bitmap, \
         port_host_byte_order, 0); \
-      a->busy_##n##_ports--; \
+      __sync_fetch_and_sub (&a->busy_##n##_ports, 1); \
+      if (sm->port_per_thread) \
+        __sync_fetch_and_sub (&a->busy_##n##_ports_per_thread \
+          [snat_worker_by_out_port (sm, port_host_byte_order)], 1); \
       break;
       foreach_snat_protocol
 #undef _
@@ -1991,14 +2161,66 @@ int snat_static_mapping_match (snat_main_t * sm,
   return 0;
 }
 
+#define SNAT_PORT_RANDOM_PROBES 16
+
+/*
+ * Pick a free port in [first_port, first_port + n_ports). A few random
+ * probes find one quickly while the range is sparse, the sweep after them
+ * bounds the search when the busy counters claim room the bitmap lacks.
+ */
+static int
+snat_find_free_port (uword * bitmap, u32 * seed, u32 first_port,
+                     u32 n_ports, u32 * portp)
+{
+  u32 i, start, portnum;
+
+  for (i = 0; i < SNAT_PORT_RANDOM_PROBES; i++)
+    {
+      portnum = first_port + random_u32 (seed) % n_ports;
+      if (!clib_bitmap_get_no_check (bitmap, portnum))
+        goto found;
+    }
+
+  start = random_u32 (seed) % n_ports;
+  for (i = 0; i < n_ports; i++)
+    {
+      portnum = first_port + (start + i) % n_ports;
+      if (!clib_bitmap_get_no_check (bitmap, portnum))
+        goto found;
+    }
+
+  return 1;
+
+found:
+  *portp = portnum;
+  return 0;
+}
+
 int snat_alloc_outside_address_and_port (snat_main_t * sm, 
                                          u32 fib_index,
+                                         u32 thread_index,
                                          snat_session_key_t * k,
                                          u32 * address_indexp)
 {
   int i;
   snat_address_t *a;
-  u32 portnum;
+  snat_main_per_thread_data_t *tsm;
+  u32 portnum, slice = ~0, first_port = 1024, n_ports = 65535 - 1024;
+  u32 *busy_ports;
+
+  tsm = vec_elt_at_index (sm->per_thread_data, thread_index);
+
+  /* With partitioned ports only our slice, nothing shared is written but
+     the address busy counters. A thread without a slice must not take
+     ports, return traffic would be steered to the slice owner */
+  if (sm->port_per_thread)
+    {
+      slice = vec_elt (sm->port_slice_by_thread, thread_index);
+      if (slice == ~0)
+        return 1;
+      first_port = 1024 + slice * sm->port_per_thread;
+      n_ports = sm->port_per_thread;
+    }
 
   for (i = 0; i < vec_len (sm->addresses); i++)
     {
@@ -2009,23 +2231,23 @@ int snat_alloc_outside_address_and_port (snat_main_t * sm,
         {
 #define _(N, j, n, s) \
         case SNAT_PROTOCOL_##N: \
-          if (a->busy_##n##_ports < (65535-1024)) \
+          busy_ports = slice != ~0 ? \
+            &a->busy_##n##_ports_per_thread[thread_index] : \
+            &a->busy_##n##_ports; \
+          if (*busy_ports < n_ports && \
+              !snat_find_free_port (a->busy_##n##_port_bitmap, \
+                                    &tsm->random_seed, first_port, \
+                                    n_ports, &portnum)) \
             { \
-              while (1) \
-                { \
-                  portnum = random_u32 (&sm->random_seed); \
-                  portnum &= 0xFFFF; \
-                  if (portnum < 1024) \
-                    continue; \
-                  if (clib_bitmap_get_no_check (a->busy_##n##_port_bitmap, portnum)) \
-                    continue; \
-                  clib_bitmap_set_no_check (a->busy_##n##_port_bitmap, portnum, 1); \
-                  a->busy_##n##_ports++; \
-                  k->addr = a->addr; \
-                  k->port = clib_host_to_net_u16(portnum); \
-                  *address_indexp = i; \
-                  return 0; \
-                } \
+              clib_bitmap_set_no_check (a->busy_##n##_port_bitmap, portnum, 1); \
+              if (sm->port_per_thread) \
+                __sync_fetch_and_add (&a->busy_##n##_ports_per_thread \
+                  [snat_worker_by_out_port (sm, portnum)], 1); \
+              __sync_fetch_and_add (&a->busy_##n##_ports, 1); \
+              k->addr = a->addr; \
+              k->port = clib_host_to_net_u16(portnum); \
+              *address_indexp = i; \
+              return 0; \
             } \
           break;
           foreach_snat_protocol
@@ -2401,6 +2623,10 @@ set_workers_command_fn (vlib_main_t * vm,
       error = clib_error_return (0,
         "Supported only if 2 or more workes available.");
       goto done;
+    case VNET_API_ERROR_ADDRESS_IN_USE:
+      error = clib_error_return (0,
+        "Outside ports partitioned between workers are in use.");
+      goto done;
     default:
       break;
     }
@@ -2486,6 +2712,62 @@ VLIB_CLI_COMMAND (snat_ipfix_logging_enable_disable_command, static) = {
   .short_help = "snat ipfix logging [domain <domain-id>] [src-port <port>] [disable]",
 };
 
+static clib_error_t *
+show_snat_ipfix_logging_command_fn (vlib_main_t * vm,
+                                    unformat_input_t * input,
+                                    vlib_cli_command_t * cmd)
+{
+  snat_ipfix_logging_main_t *silm = &snat_ipfix_logging_main;
+  snat_ipfix_logging_per_thread_data_t *ptd;
+  u64 n_records = 0, n_data_sets = 0;
+  f64 rate, total_rate = 0;
+  u32 i;
+
+  vlib_cli_output (vm, "SNAT IPFIX logging %s",
+                   silm->enabled ? "enabled" : "disabled");
+
+  for (i = 0; i < vec_len (silm->per_thread_data); i++)
+    {
+      ptd = vec_elt_at_index (silm->per_thread_data, i);
+      if (ptd->n_records == 0)
+        continue;
+
+      /* Rate over the span between the first and the last record */
+      rate = 0;
+      if (ptd->last_record_milisecond > ptd->first_record_milisecond)
+        rate = ptd->n_records * 1e3 /
+          (ptd->last_record_milisecond - ptd->first_record_milisecond);
+
+      vlib_cli_output (vm, "  thread %d (%s): %lld events in %lld data sets, "
+                       "%.0f events/s", i, vlib_worker_threads[i].name,
+                       ptd->n_records, ptd->n_data_sets, rate);
+      n_records += ptd->n_records;
+      n_data_sets += ptd->n_data_sets;
+      total_rate += rate;
+    }
+
+  vlib_cli_output (vm, "  total: %lld events in %lld data sets, "
+                   "%.0f events/s", n_records, n_data_sets, total_rate);
+
+  return 0;
+}
+
+/*?
+ * @cliexpar
+ * @cliexstart{show snat ipfix logging}
+ * Show NAT44 session events logged by each thread. The rate covers the
+ * span between a thread's first and last event. Under a pg stream that
+ * creates sessions it is bounded by the stream rate, not only by the
+ * logging:
+ *  vpp# show snat ipfix logging
+ * @cliexend
+?*/
+VLIB_CLI_COMMAND (show_snat_ipfix_logging_command, static) = {
+  .path = "show snat ipfix logging",
+  .short_help = "show snat ipfix logging",
+  .function = show_snat_ipfix_logging_command_fn,
+};
+
 static u32
 snat_get_worker_in2out_cb (ip4_header_t * ip0, u32 rx_fib_index0)
 {
@@ -2576,6 +2858,84 @@ snat_get_worker_out2in_cb (ip4_header_t * ip0, u32 rx_fib_index0)
   return next_worker_index;
 }
 
+/*
+ * Translated packets worker when the port space is partitioned: dynamic
+ * translations live on the worker owning the destination port slice.
+ * Only static mappings, which pick their own workers, need a lookup.
+ */
+static u32
+snat_get_worker_out2in_by_port_cb (ip4_header_t * ip0, u32 rx_fib_index0)
+{
+  snat_main_t *sm = &snat_main;
+  snat_worker_key_t key0;
+  clib_bihash_kv_8_8_t kv0, value0;
+  udp_header_t * udp0;
+  u16 port0;
+
+  udp0 = ip4_next_header (ip0);
+  port0 = udp0->dst_port;
+
+  if (PREDICT_FALSE(ip0->protocol == IP_PROTOCOL_ICMP))
+    {
+      icmp46_header_t * icmp0 = (icmp46_header_t *) udp0;
+      icmp_echo_header_t *echo0 = (icmp_echo_header_t *)(icmp0+1);
+      port0 = echo0->identifier;
+    }
+
+  if (PREDICT_FALSE (pool_elts (sm->static_mappings)))
+    {
+      key0.addr = ip0->dst_address;
+      key0.port = port0;
+      key0.fib_index = rx_fib_index0;
+      kv0.key = key0.as_u64;
+      if (!clib_bihash_search_8_8 (&sm->worker_by_out, &kv0, &value0))
+        return value0.value;
+
+      /* Static mapping without port */
+      key0.port = 0;
+      kv0.key = key0.as_u64;
+      if (!clib_bihash_search_8_8 (&sm->worker_by_out, &kv0, &value0))
+        return value0.value;
+    }
+
+  return snat_worker_by_out_port (sm, clib_net_to_host_u16 (port0));
+}
+
+/*
+ * Idle timers of a thread's sessions popped, on the vlib timer wheel of
+ * the thread owning them. Sessions heard from since their timer was
+ * armed get it rearmed for what's left of the timeout, the rest are
+ * deleted along with their outside ports.
+ */
+static void
+snat_session_timers_expired (vlib_main_t * vm, u32 * session_indices)
+{
+  snat_main_t *sm = &snat_main;
+  snat_main_per_thread_data_t *tsm;
+  snat_session_t *s;
+  u32 i, idle, timeout;
+  f64 now;
+
+  tsm = vec_elt_at_index (sm->per_thread_data, vm->cpu_index);
+  now = vlib_time_now (vm);
+
+  for (i = 0; i < vec_len (session_indices); i++)
+    {
+      s = pool_elt_at_index (tsm->sessions, session_indices[i]);
+      s->timer_handle = ~0;
+
+      timeout = snat_session_timeout (sm, s);
+      idle = now - s->last_heard;
+      if (idle < timeout)
+        {
+          snat_session_timer_start (tsm, s, timeout - idle);
+          continue;
+        }
+
+      snat_session_delete (sm, vm->cpu_index, s);
+    }
+}
+
 static clib_error_t *
 snat_config (vlib_main_t * vm, unformat_input_t * input)
 {
@@ -2589,9 +2949,15 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
   u32 inside_vrf_id = 0;
   u32 static_mapping_buckets = 1024;
   u32 static_mapping_memory_size = 64<<20;
+  u32 udp_timeout = SNAT_UDP_TIMEOUT;
+  u32 tcp_established_timeout = SNAT_TCP_ESTABLISHED_TIMEOUT;
+  u32 tcp_transitory_timeout = SNAT_TCP_TRANSITORY_TIMEOUT;
+  u32 icmp_timeout = SNAT_ICMP_TIMEOUT;
   u8 static_mapping_only = 0;
   u8 static_mapping_connection_tracking = 0;
   vlib_thread_main_t *tm = vlib_get_thread_main ();
+  snat_main_per_thread_data_t *tsm;
+  u32 i;
 
   sm->deterministic = 0;
 
@@ -2623,6 +2989,18 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
         }
       else if (unformat (input, "deterministic"))
         sm->deterministic = 1;
+      else if (unformat (input, "port partitioning"))
+        sm->port_partitioning = 1;
+      else if (unformat (input, "udp timeout %d", &udp_timeout))
+        ;
+      else if (unformat (input, "tcp established timeout %d",
+                         &tcp_established_timeout))
+        ;
+      else if (unformat (input, "tcp transitory timeout %d",
+                         &tcp_transitory_timeout))
+        ;
+      else if (unformat (input, "icmp timeout %d", &icmp_timeout))
+        ;
       else
 	return clib_error_return (0, "unknown input '%U'",
 				  format_unformat_error, input);
@@ -2642,6 +3020,14 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
                                                             inside_vrf_id);
   sm->static_mapping_only = static_mapping_only;
   sm->static_mapping_connection_tracking = static_mapping_connection_tracking;
+  sm->udp_timeout = udp_timeout;
+  sm->tcp_established_timeout = tcp_established_timeout;
+  sm->tcp_transitory_timeout = tcp_transitory_timeout;
+  sm->icmp_timeout = icmp_timeout;
+
+  if (sm->port_partitioning && (sm->deterministic || static_mapping_only))
+    return clib_error_return (0, "port partitioning needs dynamic "
+                              "translations");
 
   if (sm->deterministic)
     {
@@ -2651,7 +3037,8 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
   else
     {
       sm->worker_in2out_cb = snat_get_worker_in2out_cb;
-      sm->worker_out2in_cb = snat_get_worker_out2in_cb;
+      sm->worker_out2in_cb = sm->port_partitioning ?
+        snat_get_worker_out2in_by_port_cb : snat_get_worker_out2in_cb;
       sm->in2out_node_index = snat_in2out_node.index;
       sm->out2in_node_index = snat_out2in_node.index;
       if (!static_mapping_only ||
@@ -2667,6 +3054,12 @@ snat_config (vlib_main_t * vm, unformat_input_t * input)
                                 user_memory_size);
 
           vec_validate (sm->per_thread_data, tm->n_vlib_mains - 1);
+          for (i = 0; i < vec_len (sm->per_thread_data); i++)
+            {
+              tsm = vec_elt_at_index (sm->per_thread_data, i);
+              tsm->random_seed = i;
+            }
+          snat_set_port_ranges (sm);
 
           clib_bihash_init_8_8 (&sm->in2out, "in2out", translation_buckets,
                                 translation_memory_size);
@@ -2742,6 +3135,9 @@ u8 * format_snat_session (u8 * s, va_list * args)
   s = format (s, "       last heard %.2f\n", sess->last_heard);
   s = format (s, "       total pkts %d, total bytes %lld\n",
               sess->total_pkts, sess->total_bytes);
+  if (sess->in2out.protocol == SNAT_PROTOCOL_TCP)
+    s = format (s, "       state %U\n", format_snat_session_state,
+                sess->state);
   if (snat_is_session_static (sess))
     s = format (s, "       static translation\n");
   else
@@ -2901,6 +3297,13 @@ show_snat_command_fn (vlib_main_t * vm,
       vlib_cli_output (vm, "SNAT mode: dynamic translations enabled");
     }
 
+  if (!sm->deterministic && (!sm->static_mapping_only ||
+                             sm->static_mapping_connection_tracking))
+    vlib_cli_output (vm, "timeouts: udp %us, tcp established %us, "
+                     "tcp transitory %us, icmp %us", sm->udp_timeout,
+                     sm->tcp_established_timeout, sm->tcp_transitory_timeout,
+                     sm->icmp_timeout);
+
   if (verbose > 0)
     {
       pool_foreach (i, sm->interfaces,
@@ -2938,6 +3341,9 @@ show_snat_command_fn (vlib_main_t * vm,
   if (sm->num_workers > 1)
     {
       vlib_cli_output (vm, "%d workers", vec_len (sm->workers));
+      if (sm->port_per_thread)
+        vlib_cli_output (vm, "%d outside ports per worker",
+                         sm->port_per_thread);
       if (verbose > 0)
         {
           vec_foreach (worker, sm->workers)
@@ -32,6 +32,7 @@
 #define SNAT_UDP_TIMEOUT 300
 #define SNAT_TCP_TRANSITORY_TIMEOUT 240
 #define SNAT_TCP_ESTABLISHED_TIMEOUT 7440
+#define SNAT_ICMP_TIMEOUT 60
 
 /* Key */
 typedef struct {
@@ -106,7 +107,8 @@ typedef enum {
   _(3, TCP_ESTABLISHED, "tcp-established") \
   _(4, TCP_FIN_WAIT, "tcp-fin-wait")       \
   _(5, TCP_CLOSE_WAIT, "tcp-close-wait")   \
-  _(6, TCP_LAST_ACK, "tcp-last-ack")
+  _(6, TCP_LAST_ACK, "tcp-last-ack")       \
+  _(7, TCP_CLOSED, "tcp-closed")
 
 typedef enum {
 #define _(v, N, s) SNAT_SESSION_##N = v,
@@ -139,6 +141,12 @@ typedef CLIB_PACKED(struct {
   /* Outside address */
   u32 outside_address_index;    /* 64-67 */
 
+  /* Idle timer */
+  u32 timer_handle;             /* 68-71 */
+
+  /* TCP state, snat_session_state_t */
+  u8 state;                     /* 72 */
+
 }) snat_session_t;
 
 
@@ -155,6 +163,7 @@ typedef struct {
   u32 fib_index;
 #define _(N, i, n, s) \
   u32 busy_##n##_ports; \
+  u32 * busy_##n##_ports_per_thread; \
   uword * busy_##n##_port_bitmap;
   foreach_snat_protocol
 #undef _
@@ -215,6 +224,9 @@ typedef struct {
 
   /* Pool of doubly-linked list elements */
   dlist_elt_t * list_pool;
+
+  /* Randomize port allocation order */
+  u32 random_seed;
 } snat_main_per_thread_data_t;
 
 struct snat_main_s;
@@ -254,6 +266,13 @@ typedef struct snat_main_s {
   snat_get_worker_function_t * worker_in2out_cb;
   snat_get_worker_function_t * worker_out2in_cb;
 
+  /* Outside ports per worker when the port space is partitioned, 0 if
+     workers share all of it */
+  u16 port_per_thread;
+
+  /* Port slice owned by each thread, ~0 if none */
+  u32 * port_slice_by_thread;
+
   /* Per thread data */
   snat_main_per_thread_data_t * per_thread_data;
 
@@ -278,9 +297,6 @@ typedef struct snat_main_s {
   /* vector of interface address static mappings to resolve. */
   snat_static_map_resolve_t *to_resolve;
 
-  /* Randomize port allocation order */
-  u32 random_seed;
-
   /* Worker handoff index */
   u32 fq_in2out_index;
   u32 fq_out2in_index;
@@ -296,6 +312,7 @@ typedef struct snat_main_s {
   u8 static_mapping_only;
   u8 static_mapping_connection_tracking;
   u8 deterministic;
+  u8 port_partitioning;
   u32 translation_buckets;
   u32 translation_memory_size;
   u32 user_buckets;
@@ -305,6 +322,13 @@ typedef struct snat_main_s {
   u32 outside_fib_index;
   u32 inside_vrf_id;
   u32 inside_fib_index;
+  u32 udp_timeout;
+  u32 tcp_established_timeout;
+  u32 tcp_transitory_timeout;
+  u32 icmp_timeout;
+
+  /* vlib timer client of the session idle timers */
+  u32 session_timer_client_index;
 
   /* tenant VRF aware address pool activation flag */
   u8 vrf_mode;
@@ -336,6 +360,7 @@ void snat_free_outside_address_and_port (snat_main_t * sm,
 
 int snat_alloc_outside_address_and_port (snat_main_t * sm, 
                                          u32 fib_index,
+                                         u32 thread_index,
                                          snat_session_key_t * k,
                                          u32 * address_indexp);
 
@@ -344,6 +369,9 @@ int snat_static_mapping_match (snat_main_t * sm,
                                snat_session_key_t * mapping,
                                u8 by_external);
 
+void snat_session_delete (snat_main_t * sm, u32 thread_index,
+                          snat_session_t * s);
+
 void snat_add_del_addr_to_fib (ip4_address_t * addr,
                                u8 p_len,
                                u32 sw_if_index,
@@ -362,6 +390,157 @@ typedef struct {
 */
 #define snat_is_session_static(s) s->flags & SNAT_SESSION_FLAG_STATIC_MAPPING
 
+/** \brief Worker owning an outside port when ports are partitioned.
+    Ports below the first slice belong to the first worker and those past
+    the last slice to the last one.
+    @param sm SNAT main
+    @param port outside port in host byte order
+    @return thread index of the worker
+*/
+always_inline u32
+snat_worker_by_out_port (snat_main_t * sm, u16 port)
+{
+  u32 slice = 0;
+
+  ASSERT (sm->port_per_thread);
+
+  if (PREDICT_TRUE (port >= 1024))
+    slice = (port - 1024) / sm->port_per_thread;
+  slice = clib_min (slice, vec_len (sm->workers) - 1);
+
+  return sm->first_worker_index + sm->workers[slice];
+}
+
+/** \brief Idle timeout of a SNAT session in seconds.
+    @param sm SNAT main
+    @param s SNAT session
+*/
+always_inline u32
+snat_session_timeout (snat_main_t * sm, snat_session_t * s)
+{
+  switch (s->in2out.protocol)
+    {
+    case SNAT_PROTOCOL_ICMP:
+      return sm->icmp_timeout;
+    case SNAT_PROTOCOL_TCP:
+      if (s->state == SNAT_SESSION_TCP_ESTABLISHED)
+        return sm->tcp_established_timeout;
+      return sm->tcp_transitory_timeout;
+    default:
+      return sm->udp_timeout;
+    }
+}
+
+/** \brief vlib main of the thread owning some per thread data.
+    Session timers run on the owning thread's vlib timer wheel.
+    @param tsm per thread data
+*/
+always_inline vlib_main_t *
+snat_per_thread_vlib_main (snat_main_per_thread_data_t * tsm)
+{
+  u32 thread_index = tsm - snat_main.per_thread_data;
+
+  return vec_len (vlib_mains) ? vlib_mains[thread_index] : vlib_get_main ();
+}
+
+/** \brief Start the idle timer of a new SNAT session.
+    @param tsm per thread data of the thread owning the session
+    @param s SNAT session
+    @param timeout seconds
+*/
+always_inline void
+snat_session_timer_start (snat_main_per_thread_data_t * tsm,
+                          snat_session_t * s, u32 timeout)
+{
+  /* Timeouts beyond the wheel's range are rearmed on expiry */
+  s->timer_handle =
+    vlib_timer_start (snat_per_thread_vlib_main (tsm),
+                      snat_main.session_timer_client_index,
+                      s - tsm->sessions, clib_max (timeout, 1));
+}
+
+/** \brief Stop the idle timer of a SNAT session about to be freed.
+    @param tsm per thread data of the thread owning the session
+    @param s SNAT session
+*/
+always_inline void
+snat_session_timer_stop (snat_main_per_thread_data_t * tsm,
+                         snat_session_t * s)
+{
+  if (s->timer_handle != ~0)
+    vlib_timer_stop (snat_per_thread_vlib_main (tsm), s->timer_handle);
+  s->timer_handle = ~0;
+}
+
+/** \brief Track the TCP state of a SNAT session from packet flags.
+    Only what picks the idle timeout: connections are established once a
+    SYN is answered or mid-stream traffic shows up, and transitory again
+    once a FIN or RST goes by.
+    @param sm SNAT main
+    @param s SNAT session
+    @param tcp TCP header
+    @param is_in2out 1 if the packet comes from the inside
+    @return 1 if the idle timeout got shorter and the timer must be rearmed
+*/
+always_inline int
+snat_session_tcp_update (snat_main_t * sm, snat_session_t * s,
+                         tcp_header_t * tcp, u8 is_in2out)
+{
+  u8 flags = tcp->flags;
+  u32 timeout;
+
+  if (PREDICT_TRUE (s->state == SNAT_SESSION_TCP_ESTABLISHED &&
+                    !(flags & (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST))))
+    return 0;
+
+  timeout = snat_session_timeout (sm, s);
+
+  if (flags & TCP_FLAG_RST)
+    s->state = SNAT_SESSION_TCP_CLOSED;
+  else if (flags & TCP_FLAG_SYN)
+    {
+      if (s->state == SNAT_SESSION_UNKNOWN ||
+          s->state == SNAT_SESSION_TCP_CLOSED)
+        s->state = SNAT_SESSION_TCP_SYN_SENT;
+    }
+  else if (flags & TCP_FLAG_FIN)
+    {
+      if (s->state == SNAT_SESSION_TCP_FIN_WAIT && !is_in2out)
+        s->state = SNAT_SESSION_TCP_LAST_ACK;
+      else if (s->state == SNAT_SESSION_TCP_CLOSE_WAIT && is_in2out)
+        s->state = SNAT_SESSION_TCP_LAST_ACK;
+      else if (s->state != SNAT_SESSION_TCP_LAST_ACK &&
+               s->state != SNAT_SESSION_TCP_CLOSED)
+        s->state = is_in2out ?
+          SNAT_SESSION_TCP_FIN_WAIT : SNAT_SESSION_TCP_CLOSE_WAIT;
+    }
+  else if (flags & TCP_FLAG_ACK)
+    {
+      if (s->state == SNAT_SESSION_UNKNOWN ||
+          s->state == SNAT_SESSION_TCP_SYN_SENT)
+        s->state = SNAT_SESSION_TCP_ESTABLISHED;
+      else if (s->state == SNAT_SESSION_TCP_LAST_ACK)
+        s->state = SNAT_SESSION_TCP_CLOSED;
+    }
+
+  return snat_session_timeout (sm, s) < timeout;
+}
+
+/** \brief Rearm the idle timer of a SNAT session after its timeout got
+    shorter.
+    @param sm SNAT main
+    @param tsm per thread data of the thread owning the session
+    @param s SNAT session
+*/
+always_inline void
+snat_session_timer_update (snat_main_t * sm,
+                           snat_main_per_thread_data_t * tsm,
+                           snat_session_t * s)
+{
+  snat_session_timer_stop (tsm, s);
+  snat_session_timer_start (tsm, s, snat_session_timeout (sm, s));
+}
+
 /* 
  * Why is this here? Because we don't need to touch this layer to
  * simply reply to an icmp. We need to change id to a unique
@@ -438,4 +617,67 @@ icmp_is_error_message (icmp46_header_t * icmp)
   return 0;
 }
 
+/*
+ * Batched session lookup for a whole frame. Builds the in2out (source)
+ * or out2in (destination) session key of every buffer and runs them
+ * through one prefetch-pipelined bihash search. Keys of packets which
+ * turn out not to be TCP/UDP are harmless and simply ignored later.
+ */
+always_inline void
+snat_lookup_frame (vlib_main_t * vm, snat_main_t * sm, clib_bihash_8_8_t * h,
+                   u32 * from, u32 n_buffers, int is_in2out,
+                   clib_bihash_kv_8_8_t * kvs, u8 * hits)
+{
+  vlib_buffer_t * b0;
+  ip4_header_t * ip0;
+  udp_header_t * udp0;
+  snat_session_key_t key0;
+  u32 i;
+
+  for (i = 0; i < n_buffers; i++)
+    {
+      if (i + 4 < n_buffers)
+        {
+          vlib_buffer_t * p4 = vlib_get_buffer (vm, from[i + 4]);
+          vlib_prefetch_buffer_header (p4, LOAD);
+          CLIB_PREFETCH (p4->data, CLIB_CACHE_LINE_BYTES, STORE);
+        }
+
+      b0 = vlib_get_buffer (vm, from[i]);
+      ip0 = vlib_buffer_get_current (b0);
+      udp0 = ip4_next_header (ip0);
+
+      key0.addr = is_in2out ? ip0->src_address : ip0->dst_address;
+      key0.port = is_in2out ? udp0->src_port : udp0->dst_port;
+      key0.protocol = ip_proto_to_snat_proto (ip0->protocol);
+      key0.fib_index =
+        vec_elt (sm->ip4_main->fib_index_by_sw_if_index,
+                 vnet_buffer (b0)->sw_if_index[VLIB_RX]);
+      kvs[i].key = key0.as_u64;
+    }
+
+  clib_bihash_search_batch_8_8 (h, kvs, hits, n_buffers);
+}
+
+/*
+ * Per-packet replacement for clib_bihash_search_8_8 using the result
+ * of snat_lookup_frame. Once the node has created or deleted sessions
+ * (tables_dirty) the batched results may be stale, so fall back to a
+ * fresh search.
+ */
+always_inline int
+snat_frame_search (clib_bihash_8_8_t * h, clib_bihash_kv_8_8_t * kv,
+                   clib_bihash_kv_8_8_t * value, clib_bihash_kv_8_8_t * kvs,
+                   u8 * hits, u32 packet_index, u8 tables_dirty)
+{
+  if (PREDICT_FALSE (tables_dirty || kvs[packet_index].key != kv->key))
+    return clib_bihash_search_8_8 (h, kv, value);
+
+  if (!hits[packet_index])
+    return -1;
+
+  *value = kvs[packet_index];
+  return 0;
+}
+
 #endif /* __included_snat_h__ */
@@ -28,16 +28,6 @@ snat_ipfix_logging_main_t snat_ipfix_logging_main;
 #define NAT44_SESSION_CREATE_FIELD_COUNT 8
 #define NAT_ADDRESSES_EXHAUTED_FIELD_COUNT 3
 
-typedef struct {
-  u8 nat_event;
-  u32 src_ip;
-  u32 nat_src_ip;
-  snat_protocol_t snat_proto;
-  u16 src_port;
-  u16 nat_src_port;
-  u32 vrf_id;
-} snat_ipfix_logging_nat44_ses_args_t;
-
 typedef struct {
   u32 pool_id;
 } snat_ipfix_logging_addr_exhausted_args_t;
@@ -191,7 +181,8 @@ snat_template_rewrite_nat44_session (flow_report_main_t * frm,
 static inline void
 snat_ipfix_header_create (flow_report_main_t * frm,
                           vlib_buffer_t * b0,
-                          u32 * offset)
+                          u32 * offset,
+                          u64 now)
 {
   snat_ipfix_logging_main_t *silm = &snat_ipfix_logging_main;
   flow_report_stream_t *stream;
@@ -225,17 +216,19 @@ snat_ipfix_header_create (flow_report_main_t * frm,
   udp->dst_port = clib_host_to_net_u16 (UDP_DST_PORT_ipfix);
   udp->checksum = 0;
 
-  h->export_time = clib_host_to_net_u32 (
-    (u32) (((f64)frm->unix_time_0) + (vlib_time_now(frm->vlib_main) -
-    frm->vlib_time_0)));
-  h->sequence_number = clib_host_to_net_u32 (stream->sequence_number++);
+  /* Workers build messages too, derive export time from the caller's
+     millisecond clock and share the stream sequence number atomically */
+  h->export_time = clib_host_to_net_u32 ((u32) (now / 1000));
+  h->sequence_number =
+    clib_host_to_net_u32 (__sync_fetch_and_add (&stream->sequence_number, 1));
   h->domain_id = clib_host_to_net_u32 (stream->domain_id);
 
   *offset = (u32) (((u8 *)(s+1)) - (u8 *)tp);
 }
 
 static inline void
-snat_ipfix_send (flow_report_main_t * frm,
+snat_ipfix_send (vlib_main_t * vm,
+                 flow_report_main_t * frm,
                  vlib_frame_t * f,
                  vlib_buffer_t * b0,
                  u16 template_id)
@@ -245,7 +238,6 @@ snat_ipfix_send (flow_report_main_t * frm,
   ipfix_set_header_t * s = 0;
   ip4_header_t * ip;
   udp_header_t * udp;
-  vlib_main_t * vm = frm->vlib_main;
 
   tp = vlib_buffer_get_current (b0);
   ip = (ip4_header_t *) & tp->ip4;
@@ -276,31 +268,47 @@ snat_ipfix_send (flow_report_main_t * frm,
   vlib_put_frame_to_node (vm, ip4_lookup_node.index, f);
 }
 
+/**
+ * @brief Add a NAT44 session record to the calling thread's data set
+ *
+ * Each thread builds its own data set and sends it to ip4-lookup itself,
+ * when the next record would not fit into the path MTU or when asked to
+ * flush by the flow report process.
+ */
 static void
 snat_ipfix_logging_nat44_ses (u8 nat_event, u32 src_ip, u32 nat_src_ip,
                               snat_protocol_t snat_proto, u16 src_port,
                               u16 nat_src_port, u32 vrf_id, int do_flush)
 {
   snat_ipfix_logging_main_t *silm = &snat_ipfix_logging_main;
+  snat_ipfix_logging_per_thread_data_t *ptd;
   flow_report_main_t *frm = &flow_report_main;
   vlib_frame_t *f;
   vlib_buffer_t *b0 = 0;
   u32 bi0 = ~0;
   u32 offset;
-  vlib_main_t * vm = frm->vlib_main;
+  vlib_main_t * vm = vlib_get_main ();
   u64 now;
   vlib_buffer_free_list_t *fl;
   u8 proto = ~0;
 
-  if (!silm->enabled)
+  ptd = vec_elt_at_index (silm->per_thread_data, vm->cpu_index);
+
+  /* Records already queued are sent even if logging got disabled since */
+  if (!silm->enabled && !do_flush)
     return;
 
   proto = snat_proto_to_ip_proto (snat_proto);
 
-  now = (u64) ((vlib_time_now (vm) - silm->vlib_time_0) * 1e3);
-  now += silm->milisecond_time_0;
+  if (PREDICT_FALSE (ptd->vlib_time_0 == 0))
+    {
+      ptd->vlib_time_0 = vlib_time_now (vm);
+      ptd->milisecond_time_0 = unix_time_now_nsec () * 1e-6;
+    }
+  now = (u64) ((vlib_time_now (vm) - ptd->vlib_time_0) * 1e3);
+  now += ptd->milisecond_time_0;
 
-  b0 = silm->nat44_session_buffer;
+  b0 = ptd->nat44_session_buffer;
 
   if (PREDICT_FALSE (b0 == 0))
     {
@@ -313,8 +321,14 @@ snat_ipfix_logging_nat44_ses (u8 nat_event, u32 src_ip, u32 nat_src_ip,
           return;
         }
 
-      b0 = silm->nat44_session_buffer =
+      b0 = ptd->nat44_session_buffer =
         vlib_get_buffer (vm, bi0);
+
+      /* Send the data set within a flow report interval, full or not */
+      if (ptd->flush_timer_handle == ~0)
+        ptd->flush_timer_handle =
+          vlib_timer_start (vm, silm->flush_timer_client_index, 0,
+                            SNAT_IPFIX_LOGGING_FLUSH_INTERVAL);
       fl = vlib_buffer_get_free_list (vm, VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX);
       vlib_buffer_init_for_free_list (b0, fl);
       VLIB_BUFFER_TRACE_TRAJECTORY_INIT (b0);
@@ -323,22 +337,22 @@ snat_ipfix_logging_nat44_ses (u8 nat_event, u32 src_ip, u32 nat_src_ip,
   else
     {
       bi0 = vlib_get_buffer_index (vm, b0);
-      offset = silm->nat44_session_next_record_offset;
+      offset = ptd->nat44_session_next_record_offset;
     }
 
-  f = silm->nat44_session_frame;
+  f = ptd->nat44_session_frame;
   if (PREDICT_FALSE (f == 0))
     {
       u32 * to_next;
       f = vlib_get_frame_to_node (vm, ip4_lookup_node.index);
-      silm->nat44_session_frame = f;
+      ptd->nat44_session_frame = f;
       to_next = vlib_frame_vector_args (f);
       to_next[0] = bi0;
       f->n_vectors = 1;
     }
 
   if (PREDICT_FALSE (offset == 0))
-    snat_ipfix_header_create (frm, b0, &offset);
+    snat_ipfix_header_create (frm, b0, &offset, now);
 
   if (PREDICT_TRUE (do_flush == 0))
     {
@@ -368,16 +382,22 @@ snat_ipfix_logging_nat44_ses (u8 nat_event, u32 src_ip, u32 nat_src_ip,
       offset += sizeof (vrf_id);
 
       b0->current_length += NAT44_SESSION_CREATE_LEN;
+
+      if (PREDICT_FALSE (ptd->n_records == 0))
+        ptd->first_record_milisecond = now;
+      ptd->last_record_milisecond = now;
+      ptd->n_records++;
     }
 
   if (PREDICT_FALSE (do_flush || (offset + NAT44_SESSION_CREATE_LEN) > frm->path_mtu))
     {
-      snat_ipfix_send (frm, f, b0, silm->nat44_session_template_id);
-      silm->nat44_session_frame = 0;
-      silm->nat44_session_buffer = 0;
+      snat_ipfix_send (vm, frm, f, b0, silm->nat44_session_template_id);
+      ptd->n_data_sets++;
+      ptd->nat44_session_frame = 0;
+      ptd->nat44_session_buffer = 0;
       offset = 0;
     }
-  silm->nat44_session_next_record_offset = offset;
+  ptd->nat44_session_next_record_offset = offset;
  }
 
 static void
@@ -438,7 +458,7 @@ snat_ipfix_logging_addr_exhausted (u32 pool_id, int do_flush)
     }
 
   if (PREDICT_FALSE (offset == 0))
-    snat_ipfix_header_create (frm, b0, &offset);
+    snat_ipfix_header_create (frm, b0, &offset, now);
 
   if (PREDICT_TRUE (do_flush == 0))
     {
@@ -457,7 +477,7 @@ snat_ipfix_logging_addr_exhausted (u32 pool_id, int do_flush)
 
   if (PREDICT_FALSE (do_flush || (offset + NAT_ADDRESSES_EXHAUTED_LEN) > frm->path_mtu))
     {
-      snat_ipfix_send (frm, f, b0, silm->addr_exhausted_template_id);
+      snat_ipfix_send (vm, frm, f, b0, silm->addr_exhausted_template_id);
       silm->addr_exhausted_frame = 0;
       silm->addr_exhausted_buffer = 0;
       offset = 0;
@@ -465,14 +485,6 @@ snat_ipfix_logging_addr_exhausted (u32 pool_id, int do_flush)
   silm->addr_exhausted_next_record_offset = offset;
  }
 
-static void
-snat_ipfix_logging_nat44_ses_rpc_cb (snat_ipfix_logging_nat44_ses_args_t *a)
-{
-  snat_ipfix_logging_nat44_ses(a->nat_event, a->src_ip, a->nat_src_ip,
-                               a->snat_proto, a->src_port, a->nat_src_port,
-                               a->vrf_id, 0);
-}
-
 /**
  * @brief Generate NAT44 session create event
  *
@@ -491,18 +503,8 @@ snat_ipfix_logging_nat44_ses_create (u32 src_ip,
                                      u16 nat_src_port,
                                      u32 vrf_id)
 {
-  snat_ipfix_logging_nat44_ses_args_t a;
-
-  a.nat_event = NAT44_SESSION_CREATE;
-  a.src_ip = src_ip;
-  a.nat_src_ip = nat_src_ip;
-  a.snat_proto = snat_proto;
-  a.src_port = src_port;
-  a.nat_src_port = nat_src_port;
-  a.vrf_id = vrf_id;
-
-  vl_api_rpc_call_main_thread (snat_ipfix_logging_nat44_ses_rpc_cb, (u8 *) &a,
-                               sizeof (a));
+  snat_ipfix_logging_nat44_ses (NAT44_SESSION_CREATE, src_ip, nat_src_ip,
+                                snat_proto, src_port, nat_src_port, vrf_id, 0);
 }
 
 /**
@@ -523,18 +525,8 @@ snat_ipfix_logging_nat44_ses_delete (u32 src_ip,
                                      u16 nat_src_port,
                                      u32 vrf_id)
 {
-  snat_ipfix_logging_nat44_ses_args_t a;
-
-  a.nat_event = NAT44_SESSION_DELETE;
-  a.src_ip = src_ip;
-  a.nat_src_ip = nat_src_ip;
-  a.snat_proto = snat_proto;
-  a.src_port = src_port;
-  a.nat_src_port = nat_src_port;
-  a.vrf_id = vrf_id;
-
-  vl_api_rpc_call_main_thread (snat_ipfix_logging_nat44_ses_rpc_cb, (u8 *) &a,
-                               sizeof (a));
+  snat_ipfix_logging_nat44_ses (NAT44_SESSION_DELETE, src_ip, nat_src_ip,
+                                snat_proto, src_port, nat_src_port, vrf_id, 0);
 }
 
 vlib_frame_t *
@@ -544,10 +536,31 @@ snat_data_callback_nat44_session (flow_report_main_t * frm,
                                   u32 * to_next,
                                   u32 node_index)
 {
+  /* Flush our own data set, workers flush theirs when their timer pops */
   snat_ipfix_logging_nat44_ses(0, 0, 0, 0, 0, 0, 0, 1);
   return f;
 }
 
+/**
+ * @brief Flush the NAT44 session data set of the calling thread
+ *
+ * Flush timer callback, the timer is started on the thread when it
+ * queues the first record of a data set.
+ *
+ * @param vm vlib main of the calling thread
+ * @param opaques unused
+ */
+static void
+snat_ipfix_logging_flush_timer_expired (vlib_main_t * vm, u32 * opaques)
+{
+  snat_ipfix_logging_main_t *silm = &snat_ipfix_logging_main;
+  snat_ipfix_logging_per_thread_data_t *ptd;
+
+  ptd = vec_elt_at_index (silm->per_thread_data, vm->cpu_index);
+  ptd->flush_timer_handle = ~0;
+  snat_ipfix_logging_nat44_ses(0, 0, 0, 0, 0, 0, 0, 1);
+}
+
 static void
 snat_ipfix_logging_addr_exhausted_rpc_cb
  (snat_ipfix_logging_addr_exhausted_args_t * a)
@@ -596,6 +609,7 @@ int
 snat_ipfix_logging_enable_disable (int enable, u32 domain_id, u16 src_port)
 {
   snat_ipfix_logging_main_t *silm = &snat_ipfix_logging_main;
+  snat_ipfix_logging_per_thread_data_t *ptd;
   flow_report_main_t *frm = &flow_report_main;
   vnet_flow_report_add_del_args_t a;
   int rv;
@@ -604,8 +618,21 @@ snat_ipfix_logging_enable_disable (int enable, u32 domain_id, u16 src_port)
   if (silm->enabled == e)
     return 0;
 
+  /* Nothing logs while disabled, start the counters afresh */
+  if (enable)
+    vec_foreach (ptd, silm->per_thread_data)
+      {
+        ptd->n_records = 0;
+        ptd->n_data_sets = 0;
+      }
+
   silm->enabled = e;
 
+  /* Don't leave records queued behind once the flow reports are gone,
+     workers' flush timers send theirs */
+  if (!enable)
+    snat_ipfix_logging_nat44_ses(0, 0, 0, 0, 0, 0, 0, 1);
+
   memset (&a, 0, sizeof (a));
   a.rewrite_callback = snat_template_rewrite_nat44_session;
   a.flow_data_callback = snat_data_callback_nat44_session;
@@ -642,8 +669,18 @@ void
 snat_ipfix_logging_init (vlib_main_t * vm)
 {
   snat_ipfix_logging_main_t *silm = &snat_ipfix_logging_main;
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+
+  snat_ipfix_logging_per_thread_data_t *ptd;
 
   silm->enabled = 0;
+  vec_validate (silm->per_thread_data, tm->n_vlib_mains - 1);
+  vec_foreach (ptd, silm->per_thread_data)
+    ptd->flush_timer_handle = ~0;
+
+  silm->flush_timer_client_index =
+    vlib_timer_client_register ("snat-ipfix-flush",
+                                snat_ipfix_logging_flush_timer_expired);
 
   /* Set up time reference pair */
   silm->vlib_time_0 = vlib_time_now (vm);
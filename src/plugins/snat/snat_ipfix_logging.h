@@ -17,6 +17,10 @@
 #ifndef __included_snat_ipfix_logging_h__
 #define __included_snat_ipfix_logging_h__
 
+/** Seconds a thread's NAT44 session data set may wait to be sent, the
+    flow report process interval */
+#define SNAT_IPFIX_LOGGING_FLUSH_INTERVAL 5.0
+
 typedef enum {
   NAT_ADDRESSES_EXHAUTED = 3,
   NAT44_SESSION_CREATE = 4,
@@ -24,20 +28,49 @@ typedef enum {
   NAT_PORTS_EXHAUSTED = 12,
 } nat_event_t;
 
+typedef struct {
+  /** NAT44 session ipfix buffer under construction */
+  vlib_buffer_t *nat44_session_buffer;
+
+  /** frame containing the NAT44 session ipfix buffer */
+  vlib_frame_t *nat44_session_frame;
+
+  /** next record offset */
+  u32 nat44_session_next_record_offset;
+
+  /** timer sending the data set under construction, ~0 if none */
+  u32 flush_timer_handle;
+
+  /** Time reference pair, worker clocks do not share the main thread epoch */
+  u64 milisecond_time_0;
+  f64 vlib_time_0;
+
+  /** records logged and data sets sent since logging was enabled */
+  u64 n_records;
+  u64 n_data_sets;
+
+  /** timestamps of the first and the last record, in milliseconds */
+  u64 first_record_milisecond;
+  u64 last_record_milisecond;
+} snat_ipfix_logging_per_thread_data_t;
+
 typedef struct {
   /** S-NAT IPFIX logging enabled */
   u8 enabled;
 
+  /** per thread NAT44 session data sets, indexed by cpu index */
+  snat_ipfix_logging_per_thread_data_t *per_thread_data;
+
+  /** vlib timer client flushing per thread data sets */
+  u32 flush_timer_client_index;
+
   /** ipfix buffers under construction */
-  vlib_buffer_t *nat44_session_buffer;
   vlib_buffer_t *addr_exhausted_buffer;
 
   /** frames containing ipfix buffers */
-  vlib_frame_t *nat44_session_frame;
   vlib_frame_t *addr_exhausted_frame;
 
   /** next record offset */
-  u32 nat44_session_next_record_offset;
   u32 addr_exhausted_next_record_offset;
 
   /** Time reference pair */
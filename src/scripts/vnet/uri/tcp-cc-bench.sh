@@ -0,0 +1,81 @@
+#!/usr/bin/env bash
+
+# Compare vpp TCP congestion control algorithms over a lossy, long path.
+#
+# Topology, same as tcp-setup.sh: vpp host-vpp1 6.0.1.1 <-> veth_vpp1
+# 6.0.1.2 in namespace vppns1. netem on vpp1 delays and drops the data
+# vpp sends, netem on veth_vpp1 delays the acks, for an rtt of 2 * delay.
+#
+# 1. sudo ./tcp-cc-bench.sh setup [delay-ms] [loss-%]
+# 2. start vpp and load afp_setup.cli
+# 3. vpp as sender, linux as receiver, goodput reported by uri_tcp_test:
+#      sudo ./tcp-cc-bench.sh run <path to uri_tcp_test> [bytes]
+#    vpp as sender, echoing what linux sends it, goodput reported by nc:
+#      vpp# test server cc-algo bbr
+#      sudo ip netns exec vppns1 bash -c \
+#        "time (dd if=/dev/zero bs=1M count=64 | nc -q 1 6.0.1.1 1234 >/dev/null)"
+# 4. sudo ./tcp-cc-bench.sh clean
+
+DELAY_MS=${2:-25}
+LOSS=${3:-0.5}
+
+function topo_setup
+{
+  ip netns add vppns1
+  ip link add veth_vpp1 type veth peer name vpp1
+  ip link set dev vpp1 up
+  ip link set dev veth_vpp1 up netns vppns1
+
+  ip netns exec vppns1                          \
+  bash -c "
+    ip link set dev lo up
+    ip addr add 6.0.1.2/24 dev veth_vpp1
+  "
+
+  ethtool --offload  vpp1 rx off tx off
+  ip netns exec vppns1 ethtool --offload veth_vpp1 rx off tx off
+
+  tc qdisc add dev vpp1 root netem delay ${DELAY_MS}ms loss ${LOSS}%
+  ip netns exec vppns1 tc qdisc add dev veth_vpp1 root netem \
+    delay ${DELAY_MS}ms
+}
+
+function topo_clean
+{
+  ip link del dev veth_vpp1 &> /dev/null
+  ip link del dev vpp1 &> /dev/null
+  ip netns del vppns1 &> /dev/null
+}
+
+function run_bench
+{
+  local uri_tcp_test=$1
+  local bytes=${2:-64M}
+
+  for algo in newreno cubic bbr; do
+    ip netns exec vppns1 nc -l -p 1234 > /dev/null &
+    local nc_pid=$!
+    sleep 1
+    echo -n "$algo: "
+    $uri_tcp_test slave uri tcp://6.0.1.2/1234 bytes $bytes cc-algo $algo \
+      | grep goodput
+    kill $nc_pid &> /dev/null
+    wait $nc_pid &> /dev/null
+  done
+}
+
+case "$1" in
+  setup)
+    topo_setup
+    ;;
+  clean)
+    topo_clean
+    ;;
+  run)
+    run_bench $2 $3
+    ;;
+  *)
+    echo "usage: $0 setup [delay-ms] [loss-%] | run <uri_tcp_test> [bytes] | clean"
+    exit 1
+    ;;
+esac
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <svm/svm_event_ring.h>
+
+/**
+ * Allocate an event ring on the current heap. Push the shared-memory heap
+ * first if the consumer lives in another process.
+ *
+ * @param n_elts number of events, rounded up to a power of 2
+ * @param elt_size bytes per event
+ * @param flags SVM_EVENT_RING_F_*
+ */
+svm_event_ring_t *
+svm_event_ring_alloc (u32 n_elts, u32 elt_size, u32 flags)
+{
+  svm_event_ring_t *r;
+  uword n_bytes;
+
+  ASSERT (n_elts && elt_size);
+  n_elts = 1 << max_log2 (n_elts);
+  n_bytes = sizeof (*r) + (uword) n_elts * elt_size;
+
+  r = clib_mem_alloc_aligned_or_null (n_bytes, CLIB_CACHE_LINE_BYTES);
+  if (r == 0)
+    return 0;
+
+  memset (r, 0, sizeof (*r));
+  r->n_elts = n_elts;
+  r->elt_size = elt_size;
+  r->flags = flags;
+  return r;
+}
+
+void
+svm_event_ring_free (svm_event_ring_t * r)
+{
+  clib_mem_free (r);
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
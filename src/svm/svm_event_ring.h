@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __included_svm_event_ring_h__
+#define __included_svm_event_ring_h__
+
+#include <vppinfra/clib.h>
+#include <vppinfra/cache.h>
+#include <vppinfra/mem.h>
+#include <vppinfra/error.h>
+#include <vppinfra/string.h>
+#include <unistd.h>
+
+/**
+ * Lock-free single-producer, single-consumer event ring.
+ *
+ * Lives in shared memory and replaces the mutex/condvar protected
+ * unix_shared_memory_queue_t where exactly one thread produces and one
+ * consumes. Producer and consumer indices are free running and sit on
+ * separate cache lines.
+ *
+ * Wakeups are optional. A consumer that wants to block arms the ring and
+ * re-checks it before sleeping on its eventfd; the producer writes the
+ * eventfd only if it finds the ring armed after publishing events, so a
+ * burst of events costs at most one syscall.
+ */
+
+/** Consumer sleeps on an eventfd instead of busy polling */
+#define SVM_EVENT_RING_F_EVENTFD (1 << 0)
+
+typedef struct
+{
+  u32 n_elts;			/**< Ring size, power of 2 */
+  u32 elt_size;			/**< Bytes per event */
+  u32 flags;			/**< SVM_EVENT_RING_F_* */
+
+    CLIB_CACHE_LINE_ALIGN_MARK (producer);
+  volatile u32 tail;
+  u8 notify_pending;		/**< Producer private, notify scheduled */
+
+    CLIB_CACHE_LINE_ALIGN_MARK (consumer);
+  volatile u32 head;
+  volatile u32 armed;		/**< Consumer about to sleep on eventfd */
+
+    CLIB_CACHE_LINE_ALIGN_MARK (data);
+} svm_event_ring_t;
+
+svm_event_ring_t *svm_event_ring_alloc (u32 n_elts, u32 elt_size,
+					u32 flags);
+void svm_event_ring_free (svm_event_ring_t * r);
+
+always_inline u8 *
+svm_event_ring_elt (svm_event_ring_t * r, u32 index)
+{
+  return (u8 *) (r + 1) + (index & (r->n_elts - 1)) * r->elt_size;
+}
+
+always_inline u32
+svm_event_ring_n_events (svm_event_ring_t * r)
+{
+  return r->tail - r->head;
+}
+
+always_inline u8
+svm_event_ring_is_full (svm_event_ring_t * r)
+{
+  return svm_event_ring_n_events (r) >= r->n_elts;
+}
+
+/**
+ * Producer: add event.
+ *
+ * @return 0 on success, -1 if the ring is full.
+ */
+always_inline int
+svm_event_ring_enqueue (svm_event_ring_t * r, void *elt)
+{
+  u32 tail = r->tail;
+
+  if (PREDICT_FALSE (tail - r->head >= r->n_elts))
+    return -1;
+
+  clib_memcpy (svm_event_ring_elt (r, tail), elt, r->elt_size);
+  CLIB_MEMORY_STORE_BARRIER ();
+  r->tail = tail + 1;
+  return 0;
+}
+
+/**
+ * Producer: done with a batch of events. Wakes up the consumer if it is
+ * sleeping on the ring's eventfd.
+ *
+ * @param fd producer's end of the consumer eventfd, or -1
+ */
+always_inline void
+svm_event_ring_notify (svm_event_ring_t * r, int fd)
+{
+  u64 one = 1;
+
+  r->notify_pending = 0;
+  if (!(r->flags & SVM_EVENT_RING_F_EVENTFD) || fd < 0)
+    return;
+
+  /* Pairs with the barrier in svm_event_ring_arm */
+  CLIB_MEMORY_BARRIER ();
+  if (r->armed && __sync_bool_compare_and_swap (&r->armed, 1, 0))
+    {
+      if (write (fd, &one, sizeof (one)) != sizeof (one))
+	clib_unix_warning ("eventfd write");
+    }
+}
+
+/**
+ * Consumer: remove up to n_elts events.
+ *
+ * @return number of events copied to elts
+ */
+always_inline u32
+svm_event_ring_dequeue (svm_event_ring_t * r, void *elts, u32 n_elts)
+{
+  u32 head = r->head, n, i;
+  u8 *dst = elts;
+
+  n = clib_min (r->tail - head, n_elts);
+  if (n == 0)
+    return 0;
+
+  /* Load tail before the events it covers */
+  CLIB_MEMORY_BARRIER ();
+  for (i = 0; i < n; i++)
+    {
+      clib_memcpy (dst, svm_event_ring_elt (r, head + i), r->elt_size);
+      dst += r->elt_size;
+    }
+
+  CLIB_MEMORY_BARRIER ();
+  r->head = head + n;
+  return n;
+}
+
+/**
+ * Consumer: ask for an eventfd wakeup on the next event.
+ *
+ * @return 1 if the ring is still empty and the consumer can sleep, 0 if
+ *         events raced in and should be consumed first.
+ */
+always_inline int
+svm_event_ring_arm (svm_event_ring_t * r)
+{
+  r->armed = 1;
+  CLIB_MEMORY_BARRIER ();
+  if (PREDICT_TRUE (r->tail == r->head))
+    return 1;
+  r->armed = 0;
+  return 0;
+}
+
+#endif /* __included_svm_event_ring_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
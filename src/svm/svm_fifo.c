@@ -55,6 +55,33 @@ svm_fifo_create (u32 data_size_in_bytes)
   return (f);
 }
 
+/**
+ * Switch an empty fifo to zero-copy mode. The data area becomes a ring of
+ * n_descs svm_fifo_zc_desc_t that reference payload owned by the producer,
+ * which must be mapped by the consumer. nitems remains the byte budget so
+ * cursize based flow control is unchanged. Consumers read the descriptors
+ * in place and hand the bytes back with svm_fifo_zc_release.
+ *
+ * n_descs is rounded up to a power of two, so the free running ring
+ * indices can be masked and stay contiguous when they wrap. The rounded
+ * up ring must still fit in the data area.
+ *
+ * Producer and consumer of a zero-copy fifo run on the same thread.
+ */
+void
+svm_fifo_set_zero_copy (svm_fifo_t * f, u32 n_descs)
+{
+  ASSERT (f->cursize == 0);
+  ASSERT (n_descs > 0);
+
+  n_descs = max_pow2 (n_descs);
+  ASSERT (n_descs * sizeof (svm_fifo_zc_desc_t) <= f->nitems);
+
+  f->flags |= SVM_FIFO_F_ZERO_COPY;
+  f->zc_n_descs = n_descs;
+  f->zc_head = f->zc_tail = 0;
+}
+
 always_inline ooo_segment_t *
 ooo_segment_new (svm_fifo_t * f, u32 start, u32 length)
 {
@@ -95,6 +122,28 @@ ooo_segment_del (svm_fifo_t * f, u32 index)
   pool_put (f->ooo_segments, cur);
 }
 
+/**
+ * Return a fifo to its just-created state so it can be recycled. The data
+ * area and the out-of-order segment pool are kept for the next user.
+ */
+void
+svm_fifo_reset (svm_fifo_t * f)
+{
+  while (f->ooos_list_head != OOO_SEGMENT_INVALID_INDEX)
+    ooo_segment_del (f, f->ooos_list_head);
+  f->ooos_newest = 0;
+
+  f->owner_pid = 0;
+  f->tag = SVM_FIFO_TAG_NOT_HELD;
+  f->cursize = 0;
+  f->head = f->tail = 0;
+  f->server_session_index = f->client_session_index = 0;
+  f->server_thread_index = f->client_thread_index = 0;
+  f->flags = 0;
+  f->has_event = 0;
+  f->zc_n_descs = f->zc_head = f->zc_tail = 0;
+}
+
 /**
  * Add segment to fifo's out-of-order segment list. Takes care of merging
  * adjacent segments and removing overlapping ones.
@@ -362,6 +411,47 @@ svm_fifo_enqueue_nowait (svm_fifo_t * f,
   return svm_fifo_enqueue_internal (f, pid, max_bytes, copy_from_here);
 }
 
+/**
+ * Enqueue n_segs segments as one unit: either all of them are copied or,
+ * if they don't fit, none. The consumer never sees part of the unit, which
+ * lets datagram transports keep record boundaries.
+ *
+ * Returns total bytes enqueued or -1 if there isn't enough space.
+ */
+int
+svm_fifo_enqueue_segments (svm_fifo_t * f, int pid,
+			   svm_fifo_iovec_t * segs, u32 n_segs)
+{
+  u32 total_bytes = 0, nitems = f->nitems, tail, first, i;
+
+  for (i = 0; i < n_segs; i++)
+    total_bytes += segs[i].len;
+
+  if (PREDICT_FALSE (svm_fifo_is_zero_copy (f)
+		     || total_bytes > nitems - f->cursize))
+    return -1;
+
+  tail = f->tail;
+  for (i = 0; i < n_segs; i++)
+    {
+      first = clib_min (nitems - tail, segs[i].len);
+      clib_memcpy (&f->data[tail], segs[i].data, first);
+      if (segs[i].len > first)
+	clib_memcpy (&f->data[0], segs[i].data + first, segs[i].len - first);
+      tail = (tail + segs[i].len) % nitems;
+    }
+  f->tail = tail;
+
+  /* Any out-of-order segments to collect? */
+  if (PREDICT_FALSE (f->ooos_list_head != OOO_SEGMENT_INVALID_INDEX))
+    total_bytes += ooo_segment_try_collect (f, total_bytes);
+
+  /* Publish the whole unit at once */
+  __sync_fetch_and_add (&f->cursize, total_bytes);
+
+  return total_bytes;
+}
+
 /** Enqueue a future segment.
  * Two choices: either copies the entire segment, or copies nothing
  * Returns 0 of the entire segment was copied
@@ -381,6 +471,10 @@ svm_fifo_enqueue_with_offset_internal2 (svm_fifo_t * f,
 
   ASSERT (offset > 0);
 
+  /* Zero-copy fifos only take in-order data */
+  if (PREDICT_FALSE (svm_fifo_is_zero_copy (f)))
+    return -1;
+
   /* read cursize, which can only decrease while we're working */
   cursize = f->cursize;
   nitems = f->nitems;
@@ -492,7 +586,7 @@ svm_fifo_peek (svm_fifo_t * f, int pid, u32 offset, u32 max_bytes,
 	       u8 * copy_here)
 {
   u32 total_copy_bytes, first_copy_bytes, second_copy_bytes;
-  u32 cursize, nitems;
+  u32 cursize, nitems, start;
 
   if (PREDICT_FALSE (f->cursize == 0))
     return -2;			/* nothing in the fifo */
@@ -501,16 +595,20 @@ svm_fifo_peek (svm_fifo_t * f, int pid, u32 offset, u32 max_bytes,
   cursize = f->cursize;
   nitems = f->nitems;
 
+  if (PREDICT_FALSE (offset >= cursize))
+    return 0;
+
   /* Number of bytes we're going to copy */
-  total_copy_bytes = (cursize < max_bytes) ? cursize : max_bytes;
+  total_copy_bytes = (cursize - offset < max_bytes) ?
+    cursize - offset : max_bytes;
+  start = (f->head + offset) % nitems;
 
   if (PREDICT_TRUE (copy_here != 0))
     {
       /* Number of bytes in first copy segment */
-      first_copy_bytes =
-	((nitems - f->head + offset) < total_copy_bytes) ?
-	(nitems - f->head + offset) : total_copy_bytes;
-      clib_memcpy (copy_here, &f->data[f->head + offset], first_copy_bytes);
+      first_copy_bytes = ((nitems - start) < total_copy_bytes) ?
+	(nitems - start) : total_copy_bytes;
+      clib_memcpy (copy_here, &f->data[start], first_copy_bytes);
 
       /* Number of bytes in second copy segment, if any */
       second_copy_bytes = total_copy_bytes - first_copy_bytes;
@@ -559,6 +657,117 @@ svm_fifo_dequeue_drop (svm_fifo_t * f, int pid, u32 max_bytes)
   return total_drop_bytes;
 }
 
+/**
+ * Enqueue a reference to length bytes of payload at data. The fifo does
+ * not copy nor own the payload, buffer_index is returned to the producer
+ * by svm_fifo_zc_release once the consumer has read all of it. is_copy
+ * tells payload the producer copied from payload it pinned.
+ *
+ * Returns length or -1 if the payload doesn't fit, either in bytes or in
+ * descriptors.
+ */
+int
+svm_fifo_enqueue_zc (svm_fifo_t * f, int pid, u8 * data, u16 length,
+		     u32 buffer_index, u8 is_copy)
+{
+  svm_fifo_zc_desc_t *d;
+
+  ASSERT (svm_fifo_is_zero_copy (f));
+
+  if (PREDICT_FALSE (length > f->nitems - f->cursize
+		     || f->zc_tail - f->zc_head == f->zc_n_descs))
+    return -1;
+
+  d = svm_fifo_zc_desc (f, f->zc_tail);
+  d->data = data;
+  d->length = length;
+  d->is_copy = is_copy;
+  d->pad = 0;
+  d->buffer_index = buffer_index;
+
+  /* Descriptor must be visible before the consumer can see it */
+  CLIB_MEMORY_BARRIER ();
+  f->zc_tail += 1;
+
+  __sync_fetch_and_add (&f->cursize, length);
+
+  return length;
+}
+
+/**
+ * Append length bytes the producer copied to data to the newest
+ * descriptor, if that is a copy into buffer_index ending right at data.
+ * Saves a descriptor, and a buffer reference, per small payload.
+ *
+ * Returns length, 0 if the payload needs a descriptor of its own or -1 if
+ * it doesn't fit.
+ */
+int
+svm_fifo_zc_extend_copy (svm_fifo_t * f, u8 * data, u16 length,
+			 u32 buffer_index)
+{
+  svm_fifo_zc_desc_t *d;
+
+  ASSERT (svm_fifo_is_zero_copy (f));
+
+  if (PREDICT_FALSE (length > f->nitems - f->cursize))
+    return -1;
+  if (f->zc_tail == f->zc_head)
+    return 0;
+
+  d = svm_fifo_zc_desc (f, f->zc_tail - 1);
+  if (!d->is_copy || d->buffer_index != buffer_index
+      || d->data + d->length != data
+      || (u32) d->length + length > (u16) ~ 0)
+    return 0;
+
+  d->length += length;
+  __sync_fetch_and_add (&f->cursize, length);
+
+  return length;
+}
+
+/**
+ * Consume up to max_bytes of zero-copy payload. Buffer handles of fully
+ * read descriptors are appended to released, which the producer must
+ * free, and n_pinned counts those that weren't copies. A partially read
+ * descriptor is advanced in place.
+ *
+ * Returns the number of bytes consumed.
+ */
+int
+svm_fifo_zc_release (svm_fifo_t * f, int pid, u32 max_bytes,
+		     u32 ** released, u32 * n_pinned)
+{
+  svm_fifo_zc_desc_t *d;
+  u32 n_bytes = 0, len;
+
+  ASSERT (svm_fifo_is_zero_copy (f));
+
+  while (n_bytes < max_bytes && f->zc_head != f->zc_tail)
+    {
+      d = svm_fifo_zc_desc (f, f->zc_head);
+      len = clib_min (d->length, max_bytes - n_bytes);
+      n_bytes += len;
+
+      if (len < d->length)
+	{
+	  d->data += len;
+	  d->length -= len;
+	  break;
+	}
+
+      vec_add1 (*released, d->buffer_index);
+      *n_pinned += !d->is_copy;
+      f->zc_head += 1;
+    }
+
+  if (n_bytes)
+    __sync_fetch_and_sub (&f->cursize, n_bytes);
+
+  return n_bytes;
+}
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
@@ -42,7 +42,27 @@ typedef struct
 
 #define OOO_SEGMENT_INVALID_INDEX ((u32)~0)
 
+/** Fifo data area holds references to payload, see svm_fifo_set_zero_copy */
+#define SVM_FIFO_F_ZERO_COPY (1 << 0)
+
+/** Zero-copy fifo element, references payload owned by the producer */
+typedef struct
+{
+  u8 *data;		/**< Start of unread payload */
+  u16 length;		/**< Unread payload bytes */
+  u8 is_copy;		/**< Payload copied by the producer, not pinned */
+  u8 pad;
+  u32 buffer_index;	/**< Producer handle, returned once fully read */
+} svm_fifo_zc_desc_t;
+
+/** Scatter element for svm_fifo_enqueue_segments */
 typedef struct
+{
+  u8 *data;
+  u32 len;
+} svm_fifo_iovec_t;
+
+typedef struct _svm_fifo
 {
   pthread_mutex_t mutex;	/* 8 bytes */
   pthread_cond_t condvar;	/* 8 bytes */
@@ -56,17 +76,27 @@ typedef struct
   u32 client_session_index;
   u8 server_thread_index;
   u8 client_thread_index;
+  u8 flags;			/**< SVM_FIFO_F_* */
+  volatile u8 has_event;	/**< Rx event pending, see svm_fifo_set_event */
+  u32 zc_n_descs;		/**< Zero-copy ring size, a power of 2 */
     CLIB_CACHE_LINE_ALIGN_MARK (end_shared);
   u32 head;
+  u32 zc_head;			/**< Free running zero-copy ring head */
     CLIB_CACHE_LINE_ALIGN_MARK (end_consumer);
 
   /* producer */
   u32 tail;
+  u32 zc_tail;			/**< Free running zero-copy ring tail */
 
   ooo_segment_t *ooo_segments;	/**< Pool of ooo segments */
   u32 ooos_list_head;		/**< Head of out-of-order linked-list */
   u32 ooos_newest;		/**< Last segment to have been updated */
 
+  /* fifo segment bookkeeping */
+  struct _svm_fifo *next;	/**< Segment freelist link */
+  u32 segment_fifo_index;	/**< Index in the segment's fifo table */
+  u8 segment_freelist_index;	/**< Size class of the data area, ~0 if none */
+
     CLIB_CACHE_LINE_ALIGN_MARK (data);
 } svm_fifo_t;
 
@@ -112,11 +142,65 @@ svm_fifo_has_ooo_data (svm_fifo_t * f)
   return f->ooos_list_head != OOO_SEGMENT_INVALID_INDEX;
 }
 
+/**
+ * Mark fifo as having an event in flight to its consumer.
+ *
+ * @return 1 if the caller should generate the event, 0 if one is already
+ *         pending and this notification can be coalesced into it.
+ */
+always_inline u8
+svm_fifo_set_event (svm_fifo_t * f)
+{
+  return __sync_lock_test_and_set (&f->has_event, 1) == 0;
+}
+
+/** Consumer picked up the event. Must precede reading the fifo. */
+always_inline void
+svm_fifo_unset_event (svm_fifo_t * f)
+{
+  __sync_lock_release (&f->has_event);
+  CLIB_MEMORY_BARRIER ();
+}
+
+static inline u8
+svm_fifo_is_zero_copy (svm_fifo_t * f)
+{
+  return (f->flags & SVM_FIFO_F_ZERO_COPY) != 0;
+}
+
+/** Number of zero-copy descriptors holding unread payload */
+always_inline u32
+svm_fifo_zc_n_segments (svm_fifo_t * f)
+{
+  return f->zc_tail - f->zc_head;
+}
+
+/** Zero-copy descriptor at a free running ring index */
+always_inline svm_fifo_zc_desc_t *
+svm_fifo_zc_desc (svm_fifo_t * f, u32 index)
+{
+  svm_fifo_zc_desc_t *descs = (svm_fifo_zc_desc_t *) f->data;
+  return &descs[index & (f->zc_n_descs - 1)];
+}
+
+/** Unread zero-copy descriptor, i positions after the head */
+always_inline svm_fifo_zc_desc_t *
+svm_fifo_zc_segment (svm_fifo_t * f, u32 i)
+{
+  ASSERT (i < svm_fifo_zc_n_segments (f));
+  return svm_fifo_zc_desc (f, f->zc_head + i);
+}
+
 svm_fifo_t *svm_fifo_create (u32 data_size_in_bytes);
+void svm_fifo_reset (svm_fifo_t * f);
+void svm_fifo_set_zero_copy (svm_fifo_t * f, u32 n_descs);
 
 int svm_fifo_enqueue_nowait (svm_fifo_t * f, int pid, u32 max_bytes,
 			     u8 * copy_from_here);
 
+int svm_fifo_enqueue_segments (svm_fifo_t * f, int pid,
+			       svm_fifo_iovec_t * segs, u32 n_segs);
+
 int svm_fifo_enqueue_with_offset (svm_fifo_t * f, int pid,
 				  u32 offset, u32 required_bytes,
 				  u8 * copy_from_here);
@@ -128,6 +212,13 @@ int svm_fifo_peek (svm_fifo_t * f, int pid, u32 offset, u32 max_bytes,
 		   u8 * copy_here);
 int svm_fifo_dequeue_drop (svm_fifo_t * f, int pid, u32 max_bytes);
 
+int svm_fifo_enqueue_zc (svm_fifo_t * f, int pid, u8 * data, u16 length,
+			 u32 buffer_index, u8 is_copy);
+int svm_fifo_zc_extend_copy (svm_fifo_t * f, u8 * data, u16 length,
+			     u32 buffer_index);
+int svm_fifo_zc_release (svm_fifo_t * f, int pid, u32 max_bytes,
+			 u32 ** released, u32 * n_pinned);
+
 always_inline ooo_segment_t *
 svm_fifo_newest_ooo_segment (svm_fifo_t * f)
 {
@@ -14,6 +14,7 @@
  */
 
 #include <svm/svm_fifo_segment.h>
+#include <vppinfra/mheap_bootstrap.h>
 
 svm_fifo_segment_main_t svm_fifo_segment_main;
 
@@ -115,6 +116,30 @@ svm_fifo_segment_delete (svm_fifo_segment_private_t * s)
   pool_put (sm->segments, s);
 }
 
+/**
+ * Freelist index for fifos of data_size bytes. data_size is rounded up to
+ * the storage size of its class. -1 if larger than the largest class, such
+ * fifos are not recycled.
+ */
+static inline int
+fifo_segment_freelist_index (u32 * data_size)
+{
+  u32 log2_size = max_log2 (*data_size);
+
+  if (log2_size < FIFO_SEGMENT_MIN_LOG2_FIFO_SIZE)
+    log2_size = FIFO_SEGMENT_MIN_LOG2_FIFO_SIZE;
+  if (log2_size - FIFO_SEGMENT_MIN_LOG2_FIFO_SIZE >= FIFO_SEGMENT_N_FREELISTS)
+    return -1;
+
+  *data_size = 1 << log2_size;
+  return log2_size - FIFO_SEGMENT_MIN_LOG2_FIFO_SIZE;
+}
+
+/**
+ * Allocate a fifo of data_size_in_bytes. Its data area has the size of
+ * the size class, so freed fifos of the same class are recycled. Only if
+ * there are none is the fifo carved out of the segment's heap.
+ */
 svm_fifo_t *
 svm_fifo_segment_alloc_fifo (svm_fifo_segment_private_t * s,
 			     u32 data_size_in_bytes)
@@ -123,19 +148,43 @@ svm_fifo_segment_alloc_fifo (svm_fifo_segment_private_t * s,
   svm_fifo_segment_header_t *fsh;
   svm_fifo_t *f;
   void *oldheap;
+  u32 class_size;
+  int fl_index;
 
   sh = s->ssvm.sh;
   fsh = (svm_fifo_segment_header_t *) sh->opaque[0];
   oldheap = ssvm_push_heap (sh);
 
-  /* Note: this can fail, in which case: create another segment */
-  f = svm_fifo_create (data_size_in_bytes);
-  if (f == 0)
+  class_size = data_size_in_bytes;
+  fl_index = fifo_segment_freelist_index (&class_size);
+  if (fl_index >= 0 && fsh->free_fifos[fl_index])
     {
-      ssvm_pop_heap (oldheap);
-      return (0);
+      f = fsh->free_fifos[fl_index];
+      fsh->free_fifos[fl_index] = f->next;
+      f->next = 0;
+    }
+  else
+    {
+      /* If the rounded up size doesn't fit, settle for a fifo that's
+       * not recycled. Note: this can fail, in which case: create another
+       * segment */
+      f = svm_fifo_create (class_size);
+      if (f == 0 && class_size != data_size_in_bytes)
+	{
+	  f = svm_fifo_create (data_size_in_bytes);
+	  fl_index = -1;
+	}
+      if (f == 0)
+	{
+	  ssvm_pop_heap (oldheap);
+	  return (0);
+	}
     }
 
+  /* The class only sizes the data area, the fifo holds what was asked */
+  f->nitems = data_size_in_bytes;
+  f->segment_freelist_index = fl_index;
+  f->segment_fifo_index = vec_len (fsh->fifos);
   vec_add1 (fsh->fifos, f);
 
   ssvm_pop_heap (oldheap);
@@ -147,26 +196,90 @@ svm_fifo_segment_free_fifo (svm_fifo_segment_private_t * s, svm_fifo_t * f)
 {
   ssvm_shared_header_t *sh;
   svm_fifo_segment_header_t *fsh;
+  svm_fifo_t *last;
   void *oldheap;
-  int i;
+  u32 i, fl_index;
 
   sh = s->ssvm.sh;
   fsh = (svm_fifo_segment_header_t *) sh->opaque[0];
   oldheap = ssvm_push_heap (sh);
 
-  for (i = 0; i < vec_len (fsh->fifos); i++)
+  /* Fill the hole with the last fifo, the table is not ordered */
+  i = f->segment_fifo_index;
+  if (PREDICT_TRUE (i < vec_len (fsh->fifos) && fsh->fifos[i] == f))
+    {
+      last = (svm_fifo_t *) fsh->fifos[vec_len (fsh->fifos) - 1];
+      fsh->fifos[i] = last;
+      last->segment_fifo_index = i;
+      _vec_len (fsh->fifos) -= 1;
+    }
+  else
+    clib_warning ("fifo 0x%llx not found in fifo table...", f);
+
+  fl_index = f->segment_freelist_index;
+  if (fl_index < FIFO_SEGMENT_N_FREELISTS)
     {
-      if (fsh->fifos[i] == f)
+      svm_fifo_reset (f);
+      f->next = fsh->free_fifos[fl_index];
+      fsh->free_fifos[fl_index] = f;
+    }
+  else
+    clib_mem_free (f);
+
+  ssvm_pop_heap (oldheap);
+}
+
+/**
+ * Put n_fifo_pairs rx and tx fifos on the freelists, e.g., when an app
+ * attaches, so creating its sessions doesn't touch the segment's heap.
+ *
+ * @param n_fifo_pairs in: pairs wanted, out: pairs that didn't fit
+ * @return 0 if all pairs were allocated
+ */
+int
+svm_fifo_segment_preallocate_fifo_pairs (svm_fifo_segment_private_t * s,
+					 u32 rx_fifo_size, u32 tx_fifo_size,
+					 u32 * n_fifo_pairs)
+{
+  ssvm_shared_header_t *sh;
+  svm_fifo_segment_header_t *fsh;
+  svm_fifo_t *rx_fifo, *tx_fifo;
+  int rx_fl_index, tx_fl_index;
+  void *oldheap;
+
+  rx_fl_index = fifo_segment_freelist_index (&rx_fifo_size);
+  tx_fl_index = fifo_segment_freelist_index (&tx_fifo_size);
+  if (rx_fl_index < 0 || tx_fl_index < 0)
+    return SSVM_FIFO_SEGMENT_API_ERROR_OUT_OF_SPACE;
+
+  sh = s->ssvm.sh;
+  fsh = (svm_fifo_segment_header_t *) sh->opaque[0];
+  oldheap = ssvm_push_heap (sh);
+
+  while (*n_fifo_pairs)
+    {
+      rx_fifo = svm_fifo_create (rx_fifo_size);
+      tx_fifo = svm_fifo_create (tx_fifo_size);
+      if (rx_fifo == 0 || tx_fifo == 0)
 	{
-	  vec_delete (fsh->fifos, 1, i);
-	  goto found;
+	  if (rx_fifo)
+	    clib_mem_free (rx_fifo);
+	  if (tx_fifo)
+	    clib_mem_free (tx_fifo);
+	  break;
 	}
+
+      rx_fifo->segment_freelist_index = rx_fl_index;
+      tx_fifo->segment_freelist_index = tx_fl_index;
+      rx_fifo->next = fsh->free_fifos[rx_fl_index];
+      fsh->free_fifos[rx_fl_index] = rx_fifo;
+      tx_fifo->next = fsh->free_fifos[tx_fl_index];
+      fsh->free_fifos[tx_fl_index] = tx_fifo;
+      *n_fifo_pairs -= 1;
     }
-  clib_warning ("fifo 0x%llx not found in fifo table...", f);
 
-found:
-  clib_mem_free (f);
   ssvm_pop_heap (oldheap);
+  return *n_fifo_pairs ? SSVM_FIFO_SEGMENT_API_ERROR_OUT_OF_SPACE : 0;
 }
 
 void
@@ -184,6 +297,64 @@ svm_fifo_segment_index (svm_fifo_segment_private_t * s)
   return s - svm_fifo_segment_main.segments;
 }
 
+/**
+ * Segment usage. Fragmentation is the share of free heap space that's not
+ * in the largest free chunk, i.e., that can't hold the largest fifo the
+ * heap could otherwise fit. Walks the heap, call with the workers stopped.
+ */
+u8 *
+format_svm_fifo_segment (u8 * s, va_list * args)
+{
+  svm_fifo_segment_private_t *sp
+    = va_arg (*args, svm_fifo_segment_private_t *);
+  int verbose = va_arg (*args, int);
+  svm_fifo_segment_header_t *fsh = sp->h;
+  uword heap_free, largest_free, free_fifo_bytes = 0;
+  u32 n_free_fifos[FIFO_SEGMENT_N_FREELISTS], n_free = 0;
+  void *heap = sp->ssvm.sh->heap;
+  clib_mem_usage_t usage;
+  mheap_elt_t *e;
+  svm_fifo_t *f;
+  int i;
+
+  mheap_usage (heap, &usage);
+
+  /* Space the heap hasn't grown into yet is free and contiguous */
+  largest_free = usage.bytes_max - usage.bytes_total;
+  heap_free = usage.bytes_free + largest_free;
+  if (vec_len (heap) > 0)
+    for (e = heap; e->n_user_data != MHEAP_N_USER_DATA_INVALID;
+	 e = mheap_next_elt (e))
+      if (e->is_free)
+	largest_free = clib_max (largest_free, mheap_elt_data_bytes (e));
+
+  for (i = 0; i < FIFO_SEGMENT_N_FREELISTS; i++)
+    {
+      n_free_fifos[i] = 0;
+      for (f = fsh->free_fifos[i]; f; f = f->next)
+	n_free_fifos[i]++;
+      n_free += n_free_fifos[i];
+      free_fifo_bytes += (uword) n_free_fifos[i]
+	<< (i + FIFO_SEGMENT_MIN_LOG2_FIFO_SIZE);
+    }
+
+  s = format (s, "%-30s %8d %8d %8U %8U %8U %7d%%", fsh->segment_name,
+	      vec_len (fsh->fifos), n_free, format_memory_size,
+	      free_fifo_bytes, format_memory_size, usage.bytes_max,
+	      format_memory_size, heap_free,
+	      heap_free ? (int) (100 - largest_free * 100 / heap_free) : 0);
+
+  if (!verbose)
+    return s;
+
+  for (i = 0; i < FIFO_SEGMENT_N_FREELISTS; i++)
+    if (n_free_fifos[i])
+      s = format (s, "\n    %U fifos: %d free", format_memory_size,
+		  (uword) 1 << (i + FIFO_SEGMENT_MIN_LOG2_FIFO_SIZE),
+		  n_free_fifos[i]);
+  return s;
+}
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
@@ -18,10 +18,19 @@
 #include "svm_fifo.h"
 #include "ssvm.h"
 
+/** Fifo data areas are allocated in size classes, powers of 2 from 4kB,
+ * so freed fifos can be handed out again for any size in their class.
+ * A fifo's nitems stays the size asked for, the rest of the area is unused */
+#define FIFO_SEGMENT_MIN_LOG2_FIFO_SIZE 12
+#define FIFO_SEGMENT_N_FREELISTS 20
+
 typedef struct
 {
-  volatile svm_fifo_t **fifos;
+  volatile svm_fifo_t **fifos;	/**< Fifos in use */
   u8 *segment_name;
+
+  /** Freed fifos by size class, ready to be reused */
+  svm_fifo_t *free_fifos[FIFO_SEGMENT_N_FREELISTS];
 } svm_fifo_segment_header_t;
 
 typedef struct
@@ -73,11 +82,17 @@ svm_fifo_t *svm_fifo_segment_alloc_fifo (svm_fifo_segment_private_t * s,
 					 u32 data_size_in_bytes);
 void svm_fifo_segment_free_fifo (svm_fifo_segment_private_t * s,
 				 svm_fifo_t * f);
+int svm_fifo_segment_preallocate_fifo_pairs (svm_fifo_segment_private_t * s,
+					     u32 rx_fifo_size,
+					     u32 tx_fifo_size,
+					     u32 * n_fifo_pairs);
 
 void svm_fifo_segment_init (u64 baseva, u32 timeout_in_seconds);
 
 u32 svm_fifo_segment_index (svm_fifo_segment_private_t * s);
 
+format_function_t format_svm_fifo_segment;
+
 #endif /* __included_ssvm_fifo_segment_h__ */
 
 /*
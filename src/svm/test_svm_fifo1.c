@@ -226,6 +226,62 @@ offset (int verbose)
   return clib_error_return (0, "offset test OK");
 }
 
+clib_error_t *
+recycle (int verbose)
+{
+  svm_fifo_segment_create_args_t _a, *a = &_a;
+  svm_fifo_segment_private_t *sp;
+  svm_fifo_t *f, *f2;
+  u32 n_pairs = 4;
+  u8 *test_data;
+  int rv;
+  int pid = getpid ();
+
+  memset (a, 0, sizeof (*a));
+
+  a->segment_name = "fifo-test1";
+  a->segment_size = 256 << 10;
+
+  rv = svm_fifo_segment_create (a);
+
+  if (rv)
+    return clib_error_return (0, "svm_fifo_segment_create returned %d", rv);
+
+  sp = svm_fifo_get_segment (a->new_segment_index);
+
+  /* Storage comes from the size class, the fifo keeps the size asked */
+  f = svm_fifo_segment_alloc_fifo (sp, 3000);
+  if (f == 0 || f->nitems != 3000 || svm_fifo_max_enqueue (f) != 3000)
+    return clib_error_return (0, "fifo size not kept");
+
+  test_data = format (0, "Hello world%c", 0);
+  svm_fifo_enqueue_nowait (f, pid, vec_len (test_data), test_data);
+  svm_fifo_enqueue_with_offset (f, pid, 100, vec_len (test_data), test_data);
+  svm_fifo_segment_free_fifo (sp, f);
+
+  if (vec_len (sp->h->fifos) != 0)
+    return clib_error_return (0, "freed fifo still in use");
+
+  /* Same class, same fifo, emptied */
+  f2 = svm_fifo_segment_alloc_fifo (sp, 4096);
+  if (f2 != f)
+    return clib_error_return (0, "fifo not recycled");
+  if (f2->nitems != 4096)
+    return clib_error_return (0, "recycled fifo size not updated");
+  if (svm_fifo_max_dequeue (f2) || svm_fifo_has_ooo_data (f2))
+    return clib_error_return (0, "recycled fifo not empty");
+  svm_fifo_segment_free_fifo (sp, f2);
+
+  if (svm_fifo_segment_preallocate_fifo_pairs (sp, 8 << 10, 8 << 10,
+					       &n_pairs))
+    return clib_error_return (0, "preallocation failed, %d left", n_pairs);
+
+  if (verbose)
+    fformat (stdout, "%U\n", format_svm_fifo_segment, sp, 1 /* verbose */ );
+
+  return clib_error_return (0, "recycle test OK");
+}
+
 clib_error_t *
 slave (int verbose)
 {
@@ -296,6 +352,8 @@ test_ssvm_fifo1 (unformat_input_t * input)
 	test_id = 3;
       else if (unformat (input, "offset"))
 	test_id = 4;
+      else if (unformat (input, "recycle"))
+	test_id = 5;
       else
 	{
 	  error = clib_error_create ("unknown input `%U'\n",
@@ -326,6 +384,10 @@ test_ssvm_fifo1 (unformat_input_t * input)
       error = offset (verbose);
       break;
 
+    case 5:
+      error = recycle (verbose);
+      break;
+
     default:
       error = clib_error_return (0, "test id %d unknown", test_id);
       break;
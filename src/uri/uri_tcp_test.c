@@ -15,12 +15,16 @@
 
 #include <stdio.h>
 #include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <vlib/vlib.h>
 #include <vnet/vnet.h>
 #include <svm/svm_fifo_segment.h>
 #include <vlibmemory/api.h>
 #include <vpp/api/vpe_msg_enum.h>
 #include <vnet/session/application_interface.h>
+#include <vnet/tcp/tcp.h>
 
 #define vl_typedefs		/* define message structures */
 #include <vpp/api/vpe_all_api_h.h>
@@ -92,6 +96,17 @@ typedef struct
   /* Our event queue */
   unix_shared_memory_queue_t *our_event_queue;
 
+  /* Or, with SESSION_OPTIONS_FLAGS_EVT_RING, per vpp thread event rings */
+  svm_event_ring_t **our_event_rings;
+  session_fifo_event_t *ring_events;
+  u32 ring_events_index;
+  u8 use_event_rings;
+
+  /* Sleep on eventfds instead of polling the rings */
+  u8 use_eventfd;
+  int evt_socket_fd;
+  int epoll_fd;
+
   /* $$$ single thread only for the moment */
   unix_shared_memory_queue_t *vpp_event_queue;
 
@@ -114,9 +129,15 @@ typedef struct
 
   u8 *connect_test_data;
   pthread_t client_rx_thread_handle;
-  u32 client_bytes_received;
+  u64 client_bytes_received;
   u8 test_return_packets;
 
+  /* Bytes the client sends, as many copies of connect_test_data */
+  u64 bytes_to_send;
+
+  /* Congestion control algorithm, see SESSION_OPTIONS_CC_ALGO */
+  u8 cc_algo;
+
   /* convenience */
   svm_fifo_segment_main_t *segment_main;
 } uri_tcp_test_main_t;
@@ -304,6 +325,172 @@ vl_api_reset_session_t_handler (vl_api_reset_session_t * mp)
   vl_msg_api_send_shmem (utm->vl_input_queue, (u8 *) & rmp);
 }
 
+static u64
+event_ring_flags (uri_tcp_test_main_t * utm)
+{
+  u64 flags = 0;
+
+  if (utm->use_event_rings)
+    flags |= SESSION_OPTIONS_FLAGS_EVT_RING;
+  if (utm->use_eventfd)
+    flags |= SESSION_OPTIONS_FLAGS_EVT_EVENTFD;
+  return flags;
+}
+
+/* Bind the socket vpp sends our eventfds to, before bind/connect */
+static int
+event_socket_open (uri_tcp_test_main_t * utm)
+{
+  struct sockaddr_un sun;
+  int len;
+
+  utm->evt_socket_fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (utm->evt_socket_fd < 0)
+    {
+      clib_unix_warning ("socket");
+      return -1;
+    }
+
+  memset (&sun, 0, sizeof (sun));
+  sun.sun_family = AF_UNIX;
+  len = snprintf (sun.sun_path + 1, sizeof (sun.sun_path) - 1,
+		  SESSION_EVT_SOCKET_FMT, getpid ());
+  if (bind (utm->evt_socket_fd, (struct sockaddr *) &sun,
+	    offsetof (struct sockaddr_un, sun_path) + 1 + len) < 0)
+    {
+      clib_unix_warning ("bind");
+      return -1;
+    }
+  return 0;
+}
+
+/* Pick up the eventfds vpp sent ahead of the bind/connect reply */
+static int
+event_fds_receive (uri_tcp_test_main_t * utm)
+{
+  struct epoll_event ev;
+  struct cmsghdr *cmsg;
+  struct msghdr mh;
+  struct iovec iov;
+  union
+  {
+    struct cmsghdr align;
+    u8 buf[CMSG_SPACE (256 * sizeof (int))];
+  } ctl;
+  u32 n_fds;
+  int *fds, i;
+
+  iov.iov_base = &n_fds;
+  iov.iov_len = sizeof (n_fds);
+  memset (&mh, 0, sizeof (mh));
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+  mh.msg_control = ctl.buf;
+  mh.msg_controllen = sizeof (ctl.buf);
+
+  if (recvmsg (utm->evt_socket_fd, &mh, MSG_DONTWAIT) != sizeof (n_fds))
+    {
+      clib_unix_warning ("no eventfds from vpp");
+      return -1;
+    }
+
+  cmsg = CMSG_FIRSTHDR (&mh);
+  if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS
+      || n_fds != vec_len (utm->our_event_rings))
+    {
+      clib_warning ("bad eventfd message");
+      return -1;
+    }
+
+  utm->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+  fds = (int *) CMSG_DATA (cmsg);
+  for (i = 0; i < n_fds; i++)
+    {
+      memset (&ev, 0, sizeof (ev));
+      ev.events = EPOLLIN;
+      ev.data.fd = fds[i];
+      if (epoll_ctl (utm->epoll_fd, EPOLL_CTL_ADD, fds[i], &ev) < 0)
+	clib_unix_warning ("epoll_ctl");
+    }
+  return 0;
+}
+
+static void
+event_rings_save (uri_tcp_test_main_t * utm, u64 address)
+{
+  if (!utm->use_event_rings)
+    return;
+
+  /* vpp shares one set of rings, and eventfds, across our binds/connects */
+  if (utm->our_event_rings == (svm_event_ring_t **) address)
+    return;
+
+  utm->our_event_rings = (svm_event_ring_t **) address;
+  if (utm->use_eventfd && event_fds_receive (utm))
+    utm->use_eventfd = 0;
+}
+
+/* Drain all rings, or sleep on the eventfds if they are all empty */
+static void
+event_rings_refill (uri_tcp_test_main_t * utm)
+{
+  struct epoll_event evs[16];
+  svm_event_ring_t *r;
+  u32 n = 0, i, n_sleep = 0, n_events;
+  int n_ready;
+  u64 count;
+
+  vec_reset_length (utm->ring_events);
+  utm->ring_events_index = 0;
+
+  for (i = 0; i < vec_len (utm->our_event_rings); i++)
+    {
+      r = utm->our_event_rings[i];
+      n_events = svm_event_ring_n_events (r);
+      vec_validate (utm->ring_events, n + n_events);
+      n += svm_event_ring_dequeue (r, utm->ring_events + n, n_events);
+    }
+  _vec_len (utm->ring_events) = n;
+
+  if (n || !utm->use_eventfd)
+    return;
+
+  for (i = 0; i < vec_len (utm->our_event_rings); i++)
+    n_sleep += svm_event_ring_arm (utm->our_event_rings[i]);
+  if (n_sleep != vec_len (utm->our_event_rings))
+    return;
+
+  n_ready = epoll_wait (utm->epoll_fd, evs, ARRAY_LEN (evs), 100 /* ms */ );
+  for (i = 0; i < n_ready; i++)
+    if (read (evs[i].data.fd, &count, sizeof (count)) < 0)
+      clib_unix_warning ("eventfd read");
+}
+
+/* Next rx event, 0 if none */
+static session_fifo_event_t *
+next_event (uri_tcp_test_main_t * utm, session_fifo_event_t * e)
+{
+  if (!utm->use_event_rings)
+    {
+      unix_shared_memory_queue_sub (utm->our_event_queue, (u8 *) e,
+				    0 /* nowait */ );
+      return e;
+    }
+
+  if (utm->ring_events_index >= vec_len (utm->ring_events))
+    {
+      event_rings_refill (utm);
+      if (!vec_len (utm->ring_events))
+	return 0;
+    }
+
+  *e = utm->ring_events[utm->ring_events_index++];
+
+  /* vpp sends no more events for the fifo until we ack this one */
+  svm_fifo_unset_event (e->fifo);
+  return e;
+}
+
 void
 client_handle_fifo_event_rx (uri_tcp_test_main_t * utm,
 			     session_fifo_event_t * e)
@@ -343,8 +530,8 @@ client_handle_event_queue (uri_tcp_test_main_t * utm)
 {
   session_fifo_event_t _e, *e = &_e;;
 
-  unix_shared_memory_queue_sub (utm->our_event_queue, (u8 *) e,
-				0 /* nowait */ );
+  if (!next_event (utm, e))
+    return;
   switch (e->event_type)
     {
     case FIFO_EVENT_SERVER_RX:
@@ -369,8 +556,8 @@ client_rx_thread_fn (void *arg)
   utm->client_bytes_received = 0;
   while (1)
     {
-      unix_shared_memory_queue_sub (utm->our_event_queue, (u8 *) e,
-				    0 /* nowait */ );
+      if (!next_event (utm, e))
+	goto check_stop;
       switch (e->event_type)
 	{
 	case FIFO_EVENT_SERVER_RX:
@@ -384,6 +571,7 @@ client_rx_thread_fn (void *arg)
 	  break;
 	}
 
+    check_stop:
       if (PREDICT_FALSE (utm->time_to_stop == 1))
 	break;
     }
@@ -440,6 +628,7 @@ vl_api_connect_uri_reply_t_handler (vl_api_connect_uri_reply_t * mp)
 
   utm->our_event_queue = (unix_shared_memory_queue_t *)
     mp->client_event_queue_address;
+  event_rings_save (utm, mp->client_event_rings_address);
 
   utm->vpp_event_queue = (unix_shared_memory_queue_t *)
     mp->vpp_event_queue_address;
@@ -479,6 +668,22 @@ vl_api_connect_uri_reply_t_handler (vl_api_connect_uri_reply_t * mp)
     }
 }
 
+static uword
+unformat_cc_algo (unformat_input_t * input, va_list * args)
+{
+  u8 *result = va_arg (*args, u8 *);
+
+#define _(sym, str)				\
+  if (unformat (input, str))			\
+    {						\
+      *result = TCP_CC_##sym + 1;		\
+      return 1;					\
+    }
+  foreach_tcp_cc_algorithm
+#undef _
+  return 0;
+}
+
 void
 client_send_data (uri_tcp_test_main_t * utm)
 {
@@ -491,17 +696,19 @@ client_send_data (uri_tcp_test_main_t * utm)
   int buffer_offset, bytes_to_send = 0;
   session_fifo_event_t evt;
   static int serial_number = 0;
-  int i;
   u32 max_chunk = 64 << 10, write;
+  f64 start, delta;
 
   session = pool_elt_at_index (utm->sessions, utm->connected_session_index);
   tx_fifo = session->server_tx_fifo;
 
   vec_validate (utm->rx_buf, vec_len (test_data) - 1);
 
-  for (i = 0; i < 1; i++)
+  start = clib_time_now (&utm->clib_time);
+  while (bytes_sent < utm->bytes_to_send && !utm->time_to_stop)
     {
-      bytes_to_send = vec_len (test_data);
+      bytes_to_send = clib_min (vec_len (test_data),
+				utm->bytes_to_send - bytes_sent);
       buffer_offset = 0;
       while (bytes_to_send > 0)
 	{
@@ -529,12 +736,20 @@ client_send_data (uri_tcp_test_main_t * utm)
 	}
     }
 
+  /* vpp drops data from the tx fifo once the peer acks it */
+  while (svm_fifo_max_dequeue (tx_fifo) && !utm->time_to_stop)
+    ;
+
+  delta = clib_time_now (&utm->clib_time) - start;
+  fformat (stdout, "%lld bytes in %.2f seconds, %.3f Mbit/s goodput\n",
+	   bytes_sent, delta, delta > 0 ? bytes_sent * 8 / delta / 1e6 : 0.0);
+
   if (utm->test_return_packets)
     {
       f64 timeout = clib_time_now (&utm->clib_time) + 2;
 
       /* Wait for the outstanding packets */
-      while (utm->client_bytes_received < vec_len (test_data))
+      while (utm->client_bytes_received < bytes_sent)
 	{
 	  if (clib_time_now (&utm->clib_time) > timeout)
 	    {
@@ -557,6 +772,8 @@ client_connect (uri_tcp_test_main_t * utm)
   cmp->_vl_msg_id = ntohs (VL_API_CONNECT_URI);
   cmp->client_index = utm->my_client_index;
   cmp->context = ntohl (0xfeedface);
+  cmp->options[SESSION_OPTIONS_CC_ALGO] = utm->cc_algo;
+  cmp->options[SESSION_OPTIONS_FLAGS] = event_ring_flags (utm);
   memcpy (cmp->uri, utm->connect_uri, vec_len (utm->connect_uri));
   vl_msg_api_send_shmem (utm->vl_input_queue, (u8 *) & cmp);
 }
@@ -637,6 +854,7 @@ vl_api_bind_uri_reply_t_handler (vl_api_bind_uri_reply_t * mp)
 
   utm->our_event_queue =
     (unix_shared_memory_queue_t *) mp->server_event_queue_address;
+  event_rings_save (utm, mp->server_event_rings_address);
 
   utm->state = STATE_READY;
 }
@@ -761,8 +979,8 @@ server_handle_event_queue (uri_tcp_test_main_t * utm)
 
   while (1)
     {
-      unix_shared_memory_queue_sub (utm->our_event_queue, (u8 *) e,
-				    0 /* nowait */ );
+      if (!next_event (utm, e))
+	goto check_stop;
       switch (e->event_type)
 	{
 	case FIFO_EVENT_SERVER_RX:
@@ -776,6 +994,7 @@ server_handle_event_queue (uri_tcp_test_main_t * utm)
 	  clib_warning ("unknown event type %d", e->event_type);
 	  break;
 	}
+    check_stop:
       if (PREDICT_FALSE (utm->time_to_stop == 1))
 	break;
       if (PREDICT_FALSE (utm->time_to_print_stats == 1))
@@ -799,10 +1018,12 @@ server_bind (uri_tcp_test_main_t * utm)
   bmp->context = ntohl (0xfeedface);
   bmp->initial_segment_size = 256 << 20;	/* size of initial segment */
   bmp->options[SESSION_OPTIONS_FLAGS] =
-    SESSION_OPTIONS_FLAGS_USE_FIFO | SESSION_OPTIONS_FLAGS_ADD_SEGMENT;
+    SESSION_OPTIONS_FLAGS_USE_FIFO | SESSION_OPTIONS_FLAGS_ADD_SEGMENT
+    | event_ring_flags (utm);
   bmp->options[SESSION_OPTIONS_RX_FIFO_SIZE] = fifo_size;
   bmp->options[SESSION_OPTIONS_TX_FIFO_SIZE] = fifo_size;
   bmp->options[SESSION_OPTIONS_ADD_SEGMENT_SIZE] = 128 << 20;
+  bmp->options[SESSION_OPTIONS_CC_ALGO] = utm->cc_algo;
   memcpy (bmp->uri, utm->uri, vec_len (utm->uri));
   vl_msg_api_send_shmem (utm->vl_input_queue, (u8 *) & bmp);
 }
@@ -908,6 +1129,7 @@ main (int argc, char **argv)
 
   utm->my_pid = getpid ();
   utm->configured_segment_size = 1 << 20;
+  utm->bytes_to_send = 64 << 10;
 
   clib_time_init (&utm->clib_time);
   init_error_string_table (utm);
@@ -934,9 +1156,23 @@ main (int argc, char **argv)
 	drop_packets = 1;
       else if (unformat (a, "test"))
 	test_return_packets = 1;
+      else if (unformat (a, "bytes %dM", &tmp))
+	utm->bytes_to_send = (u64) tmp << 20;
+      else if (unformat (a, "bytes %dG", &tmp))
+	utm->bytes_to_send = (u64) tmp << 30;
+      else if (unformat (a, "bytes %d", &tmp))
+	utm->bytes_to_send = tmp;
+      else if (unformat (a, "cc-algo %U", unformat_cc_algo, &utm->cc_algo))
+	;
+      else if (unformat (a, "evt-ring eventfd"))
+	utm->use_event_rings = utm->use_eventfd = 1;
+      else if (unformat (a, "evt-ring"))
+	utm->use_event_rings = 1;
       else
 	{
-	  fformat (stderr, "%s: usage [master|slave]\n");
+	  fformat (stderr, "%s: usage [master|slave] [bytes <nn>[M|G]] "
+		   "[cc-algo newreno|cubic|bbr] [evt-ring [eventfd]]\n",
+		   argv[0]);
 	  exit (1);
 	}
     }
@@ -960,6 +1196,9 @@ main (int argc, char **argv)
   setup_signal_handlers ();
   uri_api_hookup (utm);
 
+  if (utm->use_eventfd && event_socket_open (utm))
+    exit (1);
+
   if (connect_to_vpp (i_am_master ? "uri_tcp_server" : "uri_tcp_client") < 0)
     {
       svm_region_exit ();
@@ -718,32 +718,32 @@ server_handle_fifo_event_rx (uri_udp_test_main_t * utm,
 			     session_fifo_event_t * e)
 {
   svm_fifo_t *rx_fifo, *tx_fifo;
-  int nbytes;
+  transport_dgram_hdr_t hdr;
+  int nbytes, n_echoed = 0;
 
   session_fifo_event_t evt;
   unix_shared_memory_queue_t *q;
-  int rv;
 
   rx_fifo = e->fifo;
   tx_fifo = utm->sessions[rx_fifo->client_session_index].server_tx_fifo;
 
-  do
-    {
-      nbytes = svm_fifo_dequeue_nowait (rx_fifo, 0,
-					vec_len (utm->rx_buf), utm->rx_buf);
-    }
-  while (nbytes <= 0);
-  do
+  /* One event may cover several datagrams, echo them all */
+  while ((nbytes = app_recv_dgram_raw (rx_fifo, &hdr, utm->rx_buf,
+				       vec_len (utm->rx_buf))) >= 0)
     {
-      rv = svm_fifo_enqueue_nowait (tx_fifo, 0, nbytes, utm->rx_buf);
+      while (app_send_dgram_raw (tx_fifo, &hdr, utm->rx_buf, nbytes) < 0)
+	;
+      n_echoed += sizeof (hdr) + nbytes;
     }
-  while (rv == -2);
+
+  if (n_echoed == 0)
+    return;
 
   /* Fabricate TX event, send to vpp */
   evt.fifo = tx_fifo;
   evt.event_type = FIFO_EVENT_SERVER_TX;
   /* $$$$ for event logging */
-  evt.enqueue_length = nbytes;
+  evt.enqueue_length = n_echoed;
   evt.event_id = e->event_id;
   q = utm->vpp_event_queue;
   unix_shared_memory_queue_add (q, (u8 *) & evt, 0 /* do wait for mutex */ );
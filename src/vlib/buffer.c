@@ -573,11 +573,153 @@ fill_free_list (vlib_main_t * vm,
   return n_alloc;
 }
 
+static vlib_buffer_global_pool_t *
+vlib_buffer_global_pool_create (u32 n_batches)
+{
+  vlib_buffer_global_pool_t *gp;
+  u32 i;
+
+  ASSERT (is_pow2 (n_batches));
+  gp = clib_mem_alloc_aligned (sizeof (*gp), CLIB_CACHE_LINE_BYTES);
+  memset (gp, 0, sizeof (*gp));
+  gp->n_batches = n_batches;
+  gp->batches = clib_mem_alloc_aligned (gp->n_batches *
+					sizeof (gp->batches[0]),
+					CLIB_CACHE_LINE_BYTES);
+  for (i = 0; i < gp->n_batches; i++)
+    gp->batches[i].sequence = i;
+
+  return gp;
+}
+
+static void
+vlib_buffer_global_pool_free (vlib_buffer_global_pool_t * gp)
+{
+  clib_mem_free (gp->batches);
+  clib_mem_free (gp);
+}
+
+/*
+ * Each ring slot carries a sequence number telling whether it is ready
+ * to be filled (== pos) or emptied (== pos + 1) by whoever claims
+ * position pos, so producers and consumers only contend on their own
+ * position counter.
+ */
+static int
+vlib_buffer_global_pool_put (vlib_buffer_global_pool_t * gp, u32 * buffers)
+{
+  vlib_buffer_batch_t *b;
+  u64 pos, mask = gp->n_batches - 1;
+  i64 dif;
+
+  pos = gp->enqueue_pos;
+  while (1)
+    {
+      b = gp->batches + (pos & mask);
+      dif = (i64) b->sequence - (i64) pos;
+      if (dif == 0)
+	{
+	  if (__sync_bool_compare_and_swap (&gp->enqueue_pos, pos, pos + 1))
+	    break;
+	  pos = gp->enqueue_pos;
+	}
+      else if (dif < 0)
+	return 0;		/* full */
+      else
+	pos = gp->enqueue_pos;
+    }
+
+  clib_memcpy (b->buffers, buffers, sizeof (b->buffers));
+  CLIB_MEMORY_BARRIER ();
+  b->sequence = pos + 1;
+  return 1;
+}
+
+static int
+vlib_buffer_global_pool_get (vlib_buffer_global_pool_t * gp, u32 * buffers)
+{
+  vlib_buffer_batch_t *b;
+  u64 pos, mask = gp->n_batches - 1;
+  i64 dif;
+
+  pos = gp->dequeue_pos;
+  while (1)
+    {
+      b = gp->batches + (pos & mask);
+      dif = (i64) b->sequence - (i64) (pos + 1);
+      if (dif == 0)
+	{
+	  if (__sync_bool_compare_and_swap (&gp->dequeue_pos, pos, pos + 1))
+	    break;
+	  pos = gp->dequeue_pos;
+	}
+      else if (dif < 0)
+	return 0;		/* empty */
+      else
+	pos = gp->dequeue_pos;
+    }
+
+  clib_memcpy (buffers, b->buffers, sizeof (b->buffers));
+  CLIB_MEMORY_BARRIER ();
+  b->sequence = pos + mask + 1;
+  return 1;
+}
+
+/* Top up the thread's cache from the global pool, up to the low watermark */
+static void
+vlib_buffer_cache_refill (vlib_main_t * vm, vlib_buffer_free_list_t * fl,
+			  uword min_free_buffers)
+{
+  vlib_buffer_main_t *bm = vm->buffer_main;
+  uword target = clib_max (min_free_buffers, VLIB_BUFFER_CACHE_LOW_WATERMARK);
+  u32 *dst;
+
+  while (vec_len (fl->buffers) < target)
+    {
+      vec_add2_aligned (fl->buffers, dst, VLIB_BUFFER_CACHE_BATCH,
+			CLIB_CACHE_LINE_BYTES);
+      if (!vlib_buffer_global_pool_get (bm->global_pool, dst))
+	{
+	  _vec_len (fl->buffers) -= VLIB_BUFFER_CACHE_BATCH;
+	  break;
+	}
+      bm->cache_stats.refills++;
+    }
+}
+
+/*
+ * Return batches of the oldest, least likely cached, buffers to the
+ * global pool until the cache is half way between the watermarks.
+ */
+static void
+vlib_buffer_cache_trim (vlib_main_t * vm, vlib_buffer_free_list_t * fl)
+{
+  vlib_buffer_main_t *bm = vm->buffer_main;
+  uword target = (VLIB_BUFFER_CACHE_LOW_WATERMARK +
+		  VLIB_BUFFER_CACHE_HIGH_WATERMARK) / 2;
+  uword n = 0;
+
+  while (vec_len (fl->buffers) - n >= target + VLIB_BUFFER_CACHE_BATCH)
+    {
+      if (!vlib_buffer_global_pool_put (bm->global_pool, fl->buffers + n))
+	{
+	  bm->cache_stats.overflows++;
+	  break;
+	}
+      bm->cache_stats.returns++;
+      n += VLIB_BUFFER_CACHE_BATCH;
+    }
+
+  if (n)
+    vec_delete (fl->buffers, n, 0);
+}
+
 static u32
 alloc_from_free_list (vlib_main_t * vm,
 		      vlib_buffer_free_list_t * free_list,
 		      u32 * alloc_buffers, u32 n_alloc_buffers)
 {
+  vlib_buffer_main_t *bm = vm->buffer_main;
   u32 *dst, *src;
   uword len;
   uword n_filled;
@@ -589,6 +731,15 @@ alloc_from_free_list (vlib_main_t * vm,
   if (PREDICT_FALSE (vm->os_physmem_alloc_aligned == 0))
     unix_physmem_init (vm, 0 /* fail_if_physical_memory_not_present */ );
 
+  if (PREDICT_TRUE (vec_len (free_list->buffers) >= n_alloc_buffers))
+    bm->cache_stats.hits++;
+  else
+    {
+      bm->cache_stats.misses++;
+      if (free_list->index == VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX)
+	vlib_buffer_cache_refill (vm, free_list, n_alloc_buffers);
+    }
+
   n_filled = fill_free_list (vm, free_list, n_alloc_buffers);
   if (n_filled == 0)
     return 0;
@@ -727,6 +878,13 @@ vlib_buffer_free_inline (vlib_main_t * vm,
 	}
       _vec_len (bm->announce_list) = 0;
     }
+
+  /* Hand surplus to threads allocating more than they free */
+  fl = pool_elt_at_index (bm->buffer_free_list_pool,
+			  VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX);
+  if (PREDICT_FALSE (vec_len (fl->buffers) > VLIB_BUFFER_CACHE_HIGH_WATERMARK
+		     && vec_len (vlib_mains) > 1))
+    vlib_buffer_cache_trim (vm, fl);
 }
 
 static void
@@ -996,6 +1154,28 @@ show_buffers (vlib_main_t * vm,
     }
   while (vm_index < vec_len (vlib_mains));
 
+  bm = vm->buffer_main;
+  if (bm->extern_buffer_mgmt || !bm->global_pool)
+    return 0;
+
+  vlib_cli_output (vm, "\n%=7s%=14s%=14s%=12s%=12s%=12s%=12s", "Thread",
+		   "Cache hits", "Misses", "Hit rate", "Refills",
+		   "Returns", "Overflows");
+  for (vm_index = 0; vm_index < vec_len (vlib_mains); vm_index++)
+    {
+      vlib_buffer_cache_stats_t *cs =
+	&vlib_mains[vm_index]->buffer_main->cache_stats;
+      u64 n = cs->hits + cs->misses;
+
+      vlib_cli_output (vm, "%7d%14lld%14lld%11.2f%%%12lld%12lld%12lld",
+		       vm_index, cs->hits, cs->misses,
+		       n ? 100.0 * cs->hits / n : 0.0,
+		       cs->refills, cs->returns, cs->overflows);
+    }
+  vlib_cli_output (vm, "Global pool: %lld batches of %d buffers",
+		   bm->global_pool->enqueue_pos -
+		   bm->global_pool->dequeue_pos, VLIB_BUFFER_CACHE_BATCH);
+
   return 0;
 }
 
@@ -1007,6 +1187,220 @@ VLIB_CLI_COMMAND (show_buffers_command, static) = {
 };
 /* *INDENT-ON* */
 
+#define BUFFER_TEST_I(_cond, _comment, _args...)		\
+({								\
+  int _evald = (_cond);						\
+  if (!(_evald)) {						\
+    fformat(stderr, "FAIL:%d: " _comment "\n",			\
+	    __LINE__, ##_args);					\
+  } else {							\
+    fformat(stderr, "PASS:%d: " _comment "\n",			\
+	    __LINE__, ##_args);					\
+  }								\
+  _evald;							\
+})
+
+#define BUFFER_TEST(_cond, _comment, _args...)			\
+{								\
+  if (!BUFFER_TEST_I(_cond, _comment, ##_args)) {		\
+    return 1;							\
+  }								\
+}
+
+typedef struct
+{
+  vlib_buffer_global_pool_t *gp;
+
+  /* Producers put batches [first_batch, first_batch + n_batches) */
+  u32 first_batch;
+  u32 n_batches;
+
+  /* Consumers count how many times they got each batch */
+  u32 *n_seen;
+  volatile u32 *n_got;
+  volatile u32 *n_torn;
+  u32 n_total;
+} vlib_buffer_pool_test_thread_t;
+
+static void *
+vlib_buffer_pool_test_put (void *arg)
+{
+  vlib_buffer_pool_test_thread_t *t = arg;
+  u32 batch[VLIB_BUFFER_CACHE_BATCH];
+  u32 i, j;
+
+  for (i = t->first_batch; i < t->first_batch + t->n_batches; i++)
+    {
+      for (j = 0; j < VLIB_BUFFER_CACHE_BATCH; j++)
+	batch[j] = i * VLIB_BUFFER_CACHE_BATCH + j;
+      while (!vlib_buffer_global_pool_put (t->gp, batch))
+	os_sched_yield ();
+    }
+  return 0;
+}
+
+static void *
+vlib_buffer_pool_test_get (void *arg)
+{
+  vlib_buffer_pool_test_thread_t *t = arg;
+  u32 batch[VLIB_BUFFER_CACHE_BATCH];
+  u32 j, id;
+
+  while (*t->n_got < t->n_total)
+    {
+      if (!vlib_buffer_global_pool_get (t->gp, batch))
+	{
+	  os_sched_yield ();
+	  continue;
+	}
+      id = batch[0] / VLIB_BUFFER_CACHE_BATCH;
+      for (j = 0; j < VLIB_BUFFER_CACHE_BATCH; j++)
+	if (batch[j] != id * VLIB_BUFFER_CACHE_BATCH + j)
+	  break;
+      if (j < VLIB_BUFFER_CACHE_BATCH || id >= vec_len (t->n_seen))
+	__sync_fetch_and_add (t->n_torn, 1);
+      else
+	__sync_fetch_and_add (&t->n_seen[id], 1);
+      __sync_fetch_and_add (t->n_got, 1);
+    }
+  return 0;
+}
+
+static int
+vlib_buffer_test_global_pool (vlib_main_t * vm)
+{
+  vlib_buffer_pool_test_thread_t threads[4], *t;
+  vlib_buffer_global_pool_t *gp;
+  u32 batch[VLIB_BUFFER_CACHE_BATCH];
+  u32 i, j, n_batches = 64, n_per_producer = 50000;
+  u32 *n_seen = 0, n_bad = 0;
+  volatile u32 n_got = 0, n_torn = 0;
+  pthread_t tids[ARRAY_LEN (threads)];
+
+  gp = vlib_buffer_global_pool_create (n_batches);
+
+  /* Single threaded: fill, overflow, drain in order, underflow */
+  for (i = 0; i < n_batches; i++)
+    {
+      for (j = 0; j < VLIB_BUFFER_CACHE_BATCH; j++)
+	batch[j] = i * VLIB_BUFFER_CACHE_BATCH + j;
+      if (!vlib_buffer_global_pool_put (gp, batch))
+	break;
+    }
+  BUFFER_TEST (i == n_batches, "put %d of %d batches into empty pool", i,
+	       n_batches);
+  BUFFER_TEST (!vlib_buffer_global_pool_put (gp, batch),
+	       "put into full pool fails");
+  for (i = 0; i < n_batches; i++)
+    {
+      if (!vlib_buffer_global_pool_get (gp, batch)
+	  || batch[0] != i * VLIB_BUFFER_CACHE_BATCH
+	  || batch[VLIB_BUFFER_CACHE_BATCH - 1] !=
+	  (i + 1) * VLIB_BUFFER_CACHE_BATCH - 1)
+	break;
+    }
+  BUFFER_TEST (i == n_batches, "got %d of %d batches back in order", i,
+	       n_batches);
+  BUFFER_TEST (!vlib_buffer_global_pool_get (gp, batch),
+	       "get from empty pool fails");
+
+  /* Two producers and two consumers contending on a small ring */
+  vec_validate (n_seen, 2 * n_per_producer - 1);
+  for (i = 0; i < ARRAY_LEN (threads); i++)
+    {
+      t = threads + i;
+      memset (t, 0, sizeof (*t));
+      t->gp = gp;
+      t->first_batch = (i / 2) * n_per_producer;
+      t->n_batches = n_per_producer;
+      t->n_seen = n_seen;
+      t->n_got = &n_got;
+      t->n_torn = &n_torn;
+      t->n_total = 2 * n_per_producer;
+      if (pthread_create (tids + i, 0, (i & 1) ? vlib_buffer_pool_test_get :
+			  vlib_buffer_pool_test_put, t))
+	clib_panic ("pthread_create");
+    }
+  for (i = 0; i < ARRAY_LEN (threads); i++)
+    pthread_join (tids[i], 0);
+
+  for (i = 0; i < vec_len (n_seen); i++)
+    n_bad += n_seen[i] != 1;
+  BUFFER_TEST (n_got == 2 * n_per_producer && n_bad == 0 && n_torn == 0,
+	       "concurrent: got %d of %d batches, %d lost or duplicated, "
+	       "%d torn", n_got, 2 * n_per_producer, n_bad, n_torn);
+  BUFFER_TEST (!vlib_buffer_global_pool_get (gp, batch),
+	       "concurrent: pool empty afterwards");
+
+  vec_free (n_seen);
+  vlib_buffer_global_pool_free (gp);
+  return 0;
+}
+
+static int
+vlib_buffer_test_cache (vlib_main_t * vm)
+{
+  vlib_buffer_main_t *bm = vm->buffer_main;
+  vlib_buffer_free_list_t *fl;
+  vlib_buffer_cache_stats_t cs;
+  u32 *buffers = 0, n;
+
+  if (bm->extern_buffer_mgmt || vec_len (vlib_mains) < 2)
+    {
+      fformat (stderr, "PASS:%d: cache: skipped, needs native buffers and "
+	       "worker threads\n", __LINE__);
+      return 0;
+    }
+
+  fl = pool_elt_at_index (bm->buffer_free_list_pool,
+			  VLIB_BUFFER_DEFAULT_FREE_LIST_INDEX);
+
+  /* Freeing past the high watermark returns the surplus to the pool */
+  n = VLIB_BUFFER_CACHE_HIGH_WATERMARK + 8 * VLIB_BUFFER_CACHE_BATCH;
+  vec_validate (buffers, n - 1);
+  BUFFER_TEST (vlib_buffer_alloc (vm, buffers, n) == n,
+	       "cache: allocated %d buffers", n);
+  cs = bm->cache_stats;
+  vlib_buffer_free (vm, buffers, n);
+  BUFFER_TEST (vec_len (fl->buffers) <= VLIB_BUFFER_CACHE_HIGH_WATERMARK,
+	       "cache: %d buffers left after freeing %d",
+	       vec_len (fl->buffers), n);
+  BUFFER_TEST (bm->cache_stats.returns > cs.returns,
+	       "cache: %lld batches returned to the pool",
+	       bm->cache_stats.returns - cs.returns);
+
+  /* Allocating more than is cached refills from the pool */
+  n = vec_len (fl->buffers) + 1;
+  cs = bm->cache_stats;
+  BUFFER_TEST (vlib_buffer_alloc (vm, buffers, n) == n,
+	       "cache: allocated %d buffers", n);
+  BUFFER_TEST (bm->cache_stats.misses == cs.misses + 1
+	       && bm->cache_stats.refills > cs.refills,
+	       "cache: miss refilled %lld batches from the pool",
+	       bm->cache_stats.refills - cs.refills);
+  vlib_buffer_free (vm, buffers, n);
+
+  vec_free (buffers);
+  return 0;
+}
+
+static clib_error_t *
+test_buffer_command_fn (vlib_main_t * vm,
+			unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  if (vlib_buffer_test_global_pool (vm) || vlib_buffer_test_cache (vm))
+    return clib_error_return (0, "buffer unit test failed");
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_buffer_command, static) = {
+  .path = "test buffer",
+  .short_help = "test buffer",
+  .function = test_buffer_command_fn,
+};
+/* *INDENT-ON* */
+
 void
 vlib_buffer_cb_init (struct vlib_main_t *vm)
 {
@@ -1019,6 +1413,8 @@ vlib_buffer_cb_init (struct vlib_main_t *vm)
   bm->cb.vlib_buffer_delete_free_list_cb =
     &vlib_buffer_delete_free_list_internal;
   bm->extern_buffer_mgmt = 0;
+  bm->global_pool =
+    vlib_buffer_global_pool_create (VLIB_BUFFER_GLOBAL_POOL_N_BATCHES);
 }
 
 int
@@ -376,6 +376,52 @@ typedef struct
 					   u32 free_list_index);
 } vlib_buffer_callbacks_t;
 
+/*
+ * Each thread keeps free buffers of the default free list in its own
+ * vector and only exchanges them with other threads through a global
+ * pool, in batches. A thread whose cache grows past the high watermark,
+ * e.g. because it transmits what other threads receive, returns batches
+ * to the pool; one that runs dry refills from the pool before asking
+ * physmem for more.
+ */
+#define VLIB_BUFFER_CACHE_BATCH 32
+#define VLIB_BUFFER_CACHE_LOW_WATERMARK 256
+#define VLIB_BUFFER_CACHE_HIGH_WATERMARK 1024
+#define VLIB_BUFFER_GLOBAL_POOL_N_BATCHES 1024
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u64 sequence;
+  u32 buffers[VLIB_BUFFER_CACHE_BATCH];
+} vlib_buffer_batch_t;
+
+/* Bounded multi-producer, multi-consumer ring of batches, lock free */
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u64 enqueue_pos;
+    CLIB_CACHE_LINE_ALIGN_MARK (cacheline1);
+  volatile u64 dequeue_pos;
+    CLIB_CACHE_LINE_ALIGN_MARK (cacheline2);
+  u32 n_batches;
+  vlib_buffer_batch_t *batches;
+} vlib_buffer_global_pool_t;
+
+typedef struct
+{
+  /* Allocations served from the thread's cache, or not */
+  u64 hits;
+  u64 misses;
+
+  /* Batches taken from and returned to the global pool */
+  u64 refills;
+  u64 returns;
+
+  /* Batches kept because the global pool was full */
+  u64 overflows;
+} vlib_buffer_cache_stats_t;
+
 typedef struct
 {
   /* Buffer free callback, for subversive activities */
@@ -406,6 +452,12 @@ typedef struct
   /* Callbacks */
   vlib_buffer_callbacks_t cb;
   int extern_buffer_mgmt;
+
+  /* Shared by all threads */
+  vlib_buffer_global_pool_t *global_pool;
+
+  /* Per thread */
+  vlib_buffer_cache_stats_t cache_stats;
 } vlib_buffer_main_t;
 
 void vlib_buffer_cb_init (struct vlib_main_t *vm);
@@ -603,6 +603,7 @@ show_memory_usage (vlib_main_t * vm,
   int verbose = 0;
   clib_error_t *error;
   u32 index = 0;
+  void *heap, *main_heap = clib_per_cpu_mheaps[0];
 
   while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
@@ -619,8 +620,14 @@ show_memory_usage (vlib_main_t * vm,
   /* *INDENT-OFF* */
   foreach_vlib_main (
   ({
+      heap = clib_per_cpu_home_mheaps[index];
+      if (!heap)
+        heap = clib_per_cpu_mheaps[index];
       vlib_cli_output (vm, "Thread %d %v\n", index, vlib_worker_threads[index].name);
-      vlib_cli_output (vm, "%U\n", format_mheap, clib_per_cpu_mheaps[index], verbose);
+      if (index > 0 && heap == main_heap)
+        vlib_cli_output (vm, "  shares the main heap\n");
+      else
+        vlib_cli_output (vm, "%U\n", format_mheap, heap, verbose);
       index++;
   }));
   /* *INDENT-ON* */
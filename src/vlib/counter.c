@@ -42,80 +42,129 @@
 void
 vlib_clear_simple_counters (vlib_simple_counter_main_t * cm)
 {
+  counter_t *my_counters;
   uword i, j;
-  u16 *my_minis;
 
-  for (i = 0; i < vec_len (cm->minis); i++)
+  for (i = 0; i < vec_len (cm->counters); i++)
     {
-      my_minis = cm->minis[i];
+      my_counters = cm->counters[i];
 
-      for (j = 0; j < vec_len (my_minis); j++)
-	{
-	  cm->maxi[j] += my_minis[j];
-	  my_minis[j] = 0;
-	}
+      for (j = 0; j < vec_len (my_counters); j++)
+	my_counters[j] = 0;
     }
-
-  j = vec_len (cm->maxi);
-  if (j > 0)
-    vec_validate (cm->value_at_last_clear, j - 1);
-  for (i = 0; i < j; i++)
-    cm->value_at_last_clear[i] = cm->maxi[i];
 }
 
 void
 vlib_clear_combined_counters (vlib_combined_counter_main_t * cm)
 {
+  vlib_counter_t *my_counters;
   uword i, j;
-  vlib_mini_counter_t *my_minis;
 
-  for (i = 0; i < vec_len (cm->minis); i++)
+  for (i = 0; i < vec_len (cm->counters); i++)
     {
-      my_minis = cm->minis[i];
+      my_counters = cm->counters[i];
 
-      for (j = 0; j < vec_len (my_minis); j++)
+      for (j = 0; j < vec_len (my_counters); j++)
 	{
-	  cm->maxi[j].packets += my_minis[j].packets;
-	  cm->maxi[j].bytes += my_minis[j].bytes;
-	  my_minis[j].packets = 0;
-	  my_minis[j].bytes = 0;
+	  my_counters[j].packets = 0;
+	  my_counters[j].bytes = 0;
 	}
     }
+}
 
-  j = vec_len (cm->maxi);
-  if (j > 0)
-    vec_validate (cm->value_at_last_clear, j - 1);
+void *vlib_stats_push_heap (void) __attribute__ ((weak));
+void *
+vlib_stats_push_heap (void)
+{
+  return 0;
+}
 
-  for (i = 0; i < j; i++)
-    {
-      vlib_counter_t *c = vec_elt_at_index (cm->value_at_last_clear, i);
+void vlib_stats_pop_heap (void *, void *, stat_directory_type_t)
+  __attribute__ ((weak));
+void
+vlib_stats_pop_heap (void *cm, void *oldheap, stat_directory_type_t type)
+{
+}
 
-      c[0] = cm->maxi[i];
-    }
+void vlib_stats_pop_heap2 (u64 *, u32, void *) __attribute__ ((weak));
+void
+vlib_stats_pop_heap2 (u64 * error_vector, u32 thread_index, void *oldheap)
+{
+}
+
+void vlib_stats_register_error_index (u8 *, u64) __attribute__ ((weak));
+void
+vlib_stats_register_error_index (u8 * name, u64 index)
+{
 }
 
 void
 vlib_validate_simple_counter (vlib_simple_counter_main_t * cm, u32 index)
 {
   vlib_thread_main_t *tm = vlib_get_thread_main ();
+  void *oldheap = 0;
   int i;
 
-  vec_validate (cm->minis, tm->n_vlib_mains - 1);
+  if (cm->stat_segment_name)
+    oldheap = vlib_stats_push_heap ();
+
+  vec_validate (cm->counters, tm->n_vlib_mains - 1);
   for (i = 0; i < tm->n_vlib_mains; i++)
-    vec_validate_aligned (cm->minis[i], index, CLIB_CACHE_LINE_BYTES);
-  vec_validate_aligned (cm->maxi, index, CLIB_CACHE_LINE_BYTES);
+    vec_validate_aligned (cm->counters[i], index, CLIB_CACHE_LINE_BYTES);
+
+  if (cm->stat_segment_name)
+    vlib_stats_pop_heap (cm, oldheap, STAT_DIR_TYPE_COUNTER_VECTOR_SIMPLE);
 }
 
 void
 vlib_validate_combined_counter (vlib_combined_counter_main_t * cm, u32 index)
 {
   vlib_thread_main_t *tm = vlib_get_thread_main ();
+  void *oldheap = 0;
   int i;
 
-  vec_validate (cm->minis, tm->n_vlib_mains - 1);
+  if (cm->stat_segment_name)
+    oldheap = vlib_stats_push_heap ();
+
+  vec_validate (cm->counters, tm->n_vlib_mains - 1);
   for (i = 0; i < tm->n_vlib_mains; i++)
-    vec_validate_aligned (cm->minis[i], index, CLIB_CACHE_LINE_BYTES);
-  vec_validate_aligned (cm->maxi, index, CLIB_CACHE_LINE_BYTES);
+    vec_validate_aligned (cm->counters[i], index, CLIB_CACHE_LINE_BYTES);
+
+  if (cm->stat_segment_name)
+    vlib_stats_pop_heap (cm, oldheap, STAT_DIR_TYPE_COUNTER_VECTOR_COMBINED);
+}
+
+int
+vlib_validate_combined_counter_will_expand (vlib_combined_counter_main_t *
+					    cm, u32 index)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  void *oldheap = 0;
+  int i, will_expand;
+
+  if (cm->stat_segment_name)
+    oldheap = vlib_stats_push_heap ();
+
+  will_expand = vec_len (cm->counters) < tm->n_vlib_mains;
+
+  for (i = 0; !will_expand && i < tm->n_vlib_mains; i++)
+    {
+      /* Trivially OK */
+      if (index < vec_len (cm->counters[i]))
+	continue;
+
+      will_expand = _vec_resize_will_expand
+	(cm->counters[i],
+	 /* length_increment */ index + 1 - vec_len (cm->counters[i]),
+	 /* new size */ (index + 1) * sizeof (cm->counters[i][0]),
+	 /* header_bytes */ 0,
+	 /* align */ CLIB_CACHE_LINE_BYTES);
+    }
+
+  if (cm->stat_segment_name)
+    vlib_stats_pop_heap (cm, oldheap, STAT_DIR_TYPE_COUNTER_VECTOR_COMBINED);
+
+  return will_expand;
 }
 
 void
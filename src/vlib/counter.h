@@ -42,30 +42,44 @@
 
 /** \file
 
-    Optimized thread-safe counters.
+    Lock-free per-thread counters.
 
-    Each vlib_[simple|combined]_counter_main_t consists of a single
-    vector of thread-safe / atomically-updated u64 counters [the
-    "maxi" vector], and a (u16 **) per-thread vector [the "minis"
-    vector] of narrow, per-thread counters.
+    Each vlib_[simple|combined]_counter_main_t consists of a per-thread
+    vector of u64 counters [the "counters" vector]. A thread only ever
+    writes its own vector, so increments need no atomic operations and
+    readers simply add up the per-thread values.
 
-    The idea is to drastically reduce the number of atomic operations.
-    In the case of packet counts, we divide the number of atomic ops
-    by 2**16, etc.
+    A counter collection with a stat_segment_name has its vectors
+    allocated in the shared-memory stats segment, where external
+    clients read them without involving the data plane.
 */
 
+/** 64bit counters */
+typedef u64 counter_t;
+
+/** Obtain the number of simple or combined counters allocated.
+    A macro which reduces to to vec_len(cm->counters[0]), the answer in
+    either case.
+
+    @param cm - (vlib_simple_counter_main_t) or
+    (vlib_combined_counter_main_t) the counter collection to interrogate
+    @returns vec_len(cm->counters[0])
+*/
+#define vlib_counter_len(cm) \
+  (vec_len ((cm)->counters) ? vec_len ((cm)->counters[0]) : 0)
+
 /** A collection of simple counters */
 
 typedef struct
 {
-  u16 **minis;	 /**< Per-thread u16 non-atomic counters */
-  u64 *maxi;	 /**< Shared wide counters */
-  u64 *value_at_last_clear; /**< Counter values as of last clear. */
-  u64 *value_at_last_serialize;	/**< Values as of last serialize. */
+  counter_t **counters;	 /**< Per-thread u64 non-atomic counters */
+  counter_t *value_at_last_serialize;	/**< Values as of last serialize. */
   u32 last_incremental_serialize_index;	/**< Last counter index
                                            serialized incrementally. */
 
   char *name;			/**< The counter collection's name. */
+  char *stat_segment_name;	/**< Name in the stats segment, if any.
+				   Must be set before the first validate */
 } vlib_simple_counter_main_t;
 
 /** Increment a simple counter
@@ -78,25 +92,14 @@ always_inline void
 vlib_increment_simple_counter (vlib_simple_counter_main_t * cm,
 			       u32 cpu_index, u32 index, u32 increment)
 {
-  u16 *my_minis;
-  u16 *mini;
-  u32 old, new;
-
-  my_minis = cm->minis[cpu_index];
-  mini = vec_elt_at_index (my_minis, index);
-  old = mini[0];
-  new = old + increment;
-  mini[0] = new;
+  counter_t *my_counters;
 
-  if (PREDICT_FALSE (mini[0] != new))
-    {
-      __sync_fetch_and_add (&cm->maxi[index], new);
-      my_minis[index] = 0;
-    }
+  my_counters = cm->counters[cpu_index];
+  my_counters[index] += increment;
 }
 
 /** Get the value of a simple counter
-    Scrapes the entire set of mini counters. Innacurate unless
+    Scrapes the entire set of per-thread counters. Innacurate unless
     worker threads which might increment the counter are
     barrier-synchronized
 
@@ -104,37 +107,28 @@ vlib_increment_simple_counter (vlib_simple_counter_main_t * cm,
     @param index - (u32) index of the counter to fetch
     @returns - (u64) current counter value
 */
-always_inline u64
+always_inline counter_t
 vlib_get_simple_counter (vlib_simple_counter_main_t * cm, u32 index)
 {
-  u16 *my_minis, *mini;
-  u64 v;
+  counter_t *my_counters;
+  counter_t v;
   int i;
 
-  ASSERT (index < vec_len (cm->maxi));
+  ASSERT (index < vlib_counter_len (cm));
 
   v = 0;
 
-  for (i = 0; i < vec_len (cm->minis); i++)
+  for (i = 0; i < vec_len (cm->counters); i++)
     {
-      my_minis = cm->minis[i];
-      mini = vec_elt_at_index (my_minis, index);
-      v += mini[0];
-    }
-
-  v += cm->maxi[index];
-
-  if (index < vec_len (cm->value_at_last_clear))
-    {
-      ASSERT (v >= cm->value_at_last_clear[index]);
-      v -= cm->value_at_last_clear[index];
+      my_counters = cm->counters[i];
+      v += my_counters[index];
     }
 
   return v;
 }
 
 /** Clear a simple counter
-    Clears the set of per-thread u16 counters, and the u64 counter
+    Clears the set of per-thread counters.
 
     @param cm - (vlib_simple_counter_main_t *) simple counter main pointer
     @param index - (u32) index of the counter to clear
@@ -142,21 +136,16 @@ vlib_get_simple_counter (vlib_simple_counter_main_t * cm, u32 index)
 always_inline void
 vlib_zero_simple_counter (vlib_simple_counter_main_t * cm, u32 index)
 {
-  u16 *my_minis;
+  counter_t *my_counters;
   int i;
 
-  ASSERT (index < vec_len (cm->maxi));
+  ASSERT (index < vlib_counter_len (cm));
 
-  for (i = 0; i < vec_len (cm->minis); i++)
+  for (i = 0; i < vec_len (cm->counters); i++)
     {
-      my_minis = cm->minis[i];
-      my_minis[index] = 0;
+      my_counters = cm->counters[i];
+      my_counters[index] = 0;
     }
-
-  cm->maxi[index] = 0;
-
-  if (index < vec_len (cm->value_at_last_clear))
-    cm->value_at_last_clear[index] = 0;
 }
 
 /** Combined counter to hold both packets and byte differences.
@@ -201,22 +190,15 @@ vlib_counter_zero (vlib_counter_t * a)
   a->packets = a->bytes = 0;
 }
 
-/** Mini combined counter */
-typedef struct
-{
-  u16 packets;			/**< Packet count */
-  i16 bytes;			/**< Byte count */
-} vlib_mini_counter_t;
-
 /** A collection of combined counters */
 typedef struct
 {
-  vlib_mini_counter_t **minis;	/**< Per-thread u16 non-atomic counter pairs */
-  vlib_counter_t *maxi;		/**< Shared wide counter pairs */
-  vlib_counter_t *value_at_last_clear;	/**< Counter values as of last clear. */
+  vlib_counter_t **counters;	/**< Per-thread u64 non-atomic counter pairs */
   vlib_counter_t *value_at_last_serialize; /**< Counter values as of last serialize. */
   u32 last_incremental_serialize_index;	/**< Last counter index serialized incrementally. */
   char *name; /**< The counter collection's name. */
+  char *stat_segment_name;	/**< Name in the stats segment, if any.
+				   Must be set before the first validate */
 } vlib_combined_counter_main_t;
 
 /** Clear a collection of simple counters
@@ -243,52 +225,31 @@ vlib_increment_combined_counter (vlib_combined_counter_main_t * cm,
 				 u32 index,
 				 u32 packet_increment, u32 byte_increment)
 {
-  vlib_mini_counter_t *my_minis, *mini;
-  u32 old_packets, new_packets;
-  i32 old_bytes, new_bytes;
-
-  /* Use this CPU's mini counter array */
-  my_minis = cm->minis[cpu_index];
-
-  mini = vec_elt_at_index (my_minis, index);
-  old_packets = mini->packets;
-  old_bytes = mini->bytes;
-
-  new_packets = old_packets + packet_increment;
-  new_bytes = old_bytes + byte_increment;
-
-  mini->packets = new_packets;
-  mini->bytes = new_bytes;
+  vlib_counter_t *my_counters;
 
-  /* Bytes always overflow before packets.. */
-  if (PREDICT_FALSE (mini->bytes != new_bytes))
-    {
-      vlib_counter_t *maxi = vec_elt_at_index (cm->maxi, index);
-
-      __sync_fetch_and_add (&maxi->packets, new_packets);
-      __sync_fetch_and_add (&maxi->bytes, new_bytes);
+  /* Use this CPU's counter array */
+  my_counters = cm->counters[cpu_index];
 
-      mini->packets = 0;
-      mini->bytes = 0;
-    }
+  my_counters[index].packets += packet_increment;
+  my_counters[index].bytes += byte_increment;
 }
 
 #define vlib_prefetch_combined_counter(_cm, _cpu_index, _index)  \
 {                                                                \
-    vlib_mini_counter_t *_cpu_minis;                             \
+    vlib_counter_t *_cpu_counters;                               \
                                                                  \
     /*                                                           \
-     * This CPU's mini index is assumed to already be in cache   \
+     * This CPU's index is assumed to already be in cache        \
      */                                                          \
-    _cpu_minis = (_cm)->minis[(_cpu_index)];                     \
-    CLIB_PREFETCH(_cpu_minis + (_index),                         \
-                  sizeof(*_cpu_minis),                           \
+    _cpu_counters = (_cm)->counters[(_cpu_index)];               \
+    CLIB_PREFETCH(_cpu_counters + (_index),                      \
+                  sizeof(*_cpu_counters),                        \
                   STORE);                                        \
 }
 
 
 /** Get the value of a combined counter, never called in the speed path
-    Scrapes the entire set of mini counters. Innacurate unless
+    Scrapes the entire set of per-thread counters. Innacurate unless
     worker threads which might increment the counter are
     barrier-synchronized
 
@@ -301,28 +262,20 @@ static inline void
 vlib_get_combined_counter (vlib_combined_counter_main_t * cm,
 			   u32 index, vlib_counter_t * result)
 {
-  vlib_mini_counter_t *my_minis, *mini;
-  vlib_counter_t *maxi;
+  vlib_counter_t *my_counters, *counter;
   int i;
 
   result->packets = 0;
   result->bytes = 0;
 
-  for (i = 0; i < vec_len (cm->minis); i++)
+  for (i = 0; i < vec_len (cm->counters); i++)
     {
-      my_minis = cm->minis[i];
+      my_counters = cm->counters[i];
 
-      mini = vec_elt_at_index (my_minis, index);
-      result->packets += mini->packets;
-      result->bytes += mini->bytes;
+      counter = vec_elt_at_index (my_counters, index);
+      result->packets += counter->packets;
+      result->bytes += counter->bytes;
     }
-
-  maxi = vec_elt_at_index (cm->maxi, index);
-  result->packets += maxi->packets;
-  result->bytes += maxi->bytes;
-
-  if (index < vec_len (cm->value_at_last_clear))
-    vlib_counter_sub (result, &cm->value_at_last_clear[index]);
 }
 
 /** Clear a combined counter
@@ -334,21 +287,17 @@ vlib_get_combined_counter (vlib_combined_counter_main_t * cm,
 always_inline void
 vlib_zero_combined_counter (vlib_combined_counter_main_t * cm, u32 index)
 {
-  vlib_mini_counter_t *mini, *my_minis;
+  vlib_counter_t *my_counters, *counter;
   int i;
 
-  for (i = 0; i < vec_len (cm->minis); i++)
+  for (i = 0; i < vec_len (cm->counters); i++)
     {
-      my_minis = cm->minis[i];
+      my_counters = cm->counters[i];
 
-      mini = vec_elt_at_index (my_minis, index);
-      mini->packets = 0;
-      mini->bytes = 0;
+      counter = vec_elt_at_index (my_counters, index);
+      counter->packets = 0;
+      counter->bytes = 0;
     }
-
-  vlib_counter_zero (&cm->maxi[index]);
-  if (index < vec_len (cm->value_at_last_clear))
-    vlib_counter_zero (&cm->value_at_last_clear[index]);
 }
 
 /** validate a simple counter
@@ -367,15 +316,45 @@ void vlib_validate_simple_counter (vlib_simple_counter_main_t * cm,
 void vlib_validate_combined_counter (vlib_combined_counter_main_t * cm,
 				     u32 index);
 
-/** Obtain the number of simple or combined counters allocated.
-    A macro which reduces to to vec_len(cm->maxi), the answer in either
-    case.
-
-    @param cm - (vlib_simple_counter_main_t) or
-    (vlib_combined_counter_main_t) the counter collection to interrogate
-    @returns vec_len(cm->maxi)
+/** Would validating a combined counter reallocate any per-thread vector?
+    @param cm - (vlib_combined_counter_main_t *) pointer to the counter
+    collection
+    @param index - (u32) index of the counter to validate
+    @returns 1 if vlib_validate_combined_counter would move the counters
 */
-#define vlib_counter_len(cm) vec_len((cm)->maxi)
+
+int vlib_validate_combined_counter_will_expand
+  (vlib_combined_counter_main_t * cm, u32 index);
+
+/** Stats segment directory entry types */
+typedef enum
+{
+  STAT_DIR_TYPE_ILLEGAL = 0,
+  STAT_DIR_TYPE_COUNTER_VECTOR_SIMPLE,
+  STAT_DIR_TYPE_COUNTER_VECTOR_COMBINED,
+  STAT_DIR_TYPE_ERROR_INDEX,
+  STAT_DIR_TYPE_NODE_INDEX,
+} stat_directory_type_t;
+
+/*
+ * Stats segment hooks. vlib provides weak no-op versions; an application
+ * with a shared-memory stats segment overrides them so that counter
+ * vectors are allocated in, and published through, the segment.
+ */
+
+/** Switch to the stats segment heap, returns the previous heap */
+void *vlib_stats_push_heap (void);
+
+/** Publish a (re)allocated counter collection, restore the heap */
+void vlib_stats_pop_heap (void *cm, void *oldheap,
+			  stat_directory_type_t type);
+
+/** Publish a thread's (re)allocated error counters, restore the heap */
+void vlib_stats_pop_heap2 (u64 * error_vector, u32 thread_index,
+			   void *oldheap);
+
+/** Publish the name of an error counter */
+void vlib_stats_register_error_index (u8 * name, u64 index);
 
 serialize_function_t serialize_vlib_simple_counter_main,
   unserialize_vlib_simple_counter_main;
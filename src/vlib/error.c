@@ -148,6 +148,7 @@ vlib_register_errors (vlib_main_t * vm,
   vlib_error_main_t *em = &vm->error_main;
   vlib_node_t *n = vlib_get_node (vm, node_index);
   uword l;
+  void *oldheap;
 
   ASSERT (os_get_cpu_number () == 0);
 
@@ -170,7 +171,9 @@ vlib_register_errors (vlib_main_t * vm,
 	       error_strings, n_errors * sizeof (error_strings[0]));
 
   /* Allocate a counter/elog type for each error. */
+  oldheap = vlib_stats_push_heap ();
   vec_validate (em->counters, l - 1);
+  vlib_stats_pop_heap2 (em->counters, vm->cpu_index, oldheap);
   vec_validate (vm->error_elog_event_types, l - 1);
 
   /* Zero counters for re-registrations of errors. */
@@ -194,6 +197,19 @@ vlib_register_errors (vlib_main_t * vm,
 	vm->error_elog_event_types[n->error_heap_index + i] = t;
       }
   }
+
+  {
+    u8 *error_name;
+    uword i;
+
+    for (i = 0; i < n_errors; i++)
+      {
+	error_name = format (0, "/err/%v/%s%c", n->name, error_strings[i], 0);
+	vlib_stats_register_error_index (error_name,
+					 n->error_heap_index + i);
+	vec_free (error_name);
+      }
+  }
 }
 
 static clib_error_t *
@@ -1256,6 +1256,39 @@ vlib_process_resume (vlib_process_t * p)
   return r;
 }
 
+/* Arm the shared timer service for a process suspended on the clock */
+static void
+vlib_process_start_resume_timer (vlib_main_t * vm, vlib_process_t * p,
+				 u32 runtime_index)
+{
+  vlib_node_main_t *nm = &vm->node_main;
+  i64 dt_cpu = p->resume_cpu_time - clib_cpu_time_now ();
+
+  p->resume_timer_handle =
+    vlib_timer_start (vm, nm->process_timer_client_index,
+		      vlib_process_timer_data_set_suspended_process
+		      (runtime_index),
+		      clib_max (dt_cpu, 0) * vm->clib_time.seconds_per_clock);
+}
+
+/* Queue expired suspends and timed events for the main loop */
+static void
+vlib_process_timers_expired (vlib_main_t * vm, u32 * opaques)
+{
+  vlib_node_main_t *nm = &vm->node_main;
+  vlib_process_t *p;
+  u32 *d;
+
+  vec_foreach (d, opaques)
+  {
+    if (vlib_process_timer_data_is_timed_event (d[0]))
+      continue;
+    p = vec_elt (nm->processes, vlib_process_timer_data_get_index (d[0]));
+    p->resume_timer_handle = ~0;
+  }
+  vec_add (nm->data_from_process_timers, opaques, vec_len (opaques));
+}
+
 static u64
 dispatch_process (vlib_main_t * vm,
 		  vlib_process_t * p, vlib_frame_t * f, u64 last_time_stamp)
@@ -1300,9 +1333,7 @@ dispatch_process (vlib_main_t * vm,
       p->suspended_process_frame_index = pf - nm->suspended_process_frames;
 
       if (p->flags & VLIB_PROCESS_IS_SUSPENDED_WAITING_FOR_CLOCK)
-	timing_wheel_insert (&nm->timing_wheel, p->resume_cpu_time,
-			     vlib_timing_wheel_data_set_suspended_process
-			     (node->runtime_index));
+	vlib_process_start_resume_timer (vm, p, node->runtime_index);
     }
   else
     p->flags &= ~VLIB_PROCESS_IS_RUNNING;
@@ -1375,9 +1406,7 @@ dispatch_suspended_process (vlib_main_t * vm,
       n_vectors = 0;
       p->n_suspends += 1;
       if (p->flags & VLIB_PROCESS_IS_SUSPENDED_WAITING_FOR_CLOCK)
-	timing_wheel_insert (&nm->timing_wheel, p->resume_cpu_time,
-			     vlib_timing_wheel_data_set_suspended_process
-			     (node->runtime_index));
+	vlib_process_start_resume_timer (vm, p, node->runtime_index);
     }
   else
     {
@@ -1398,13 +1427,32 @@ dispatch_suspended_process (vlib_main_t * vm,
   return t;
 }
 
+/*
+ * A worker may only sleep if every input node it polls can wake it up.
+ */
+static int
+vlib_worker_can_sleep (vlib_main_t * vm)
+{
+  vlib_node_main_t *nm = &vm->node_main;
+  vlib_node_runtime_t *n;
+
+  vec_foreach (n, nm->nodes_by_type[VLIB_NODE_TYPE_INPUT])
+  {
+    if (n->state == VLIB_NODE_STATE_POLLING
+	&& !(n->flags & VLIB_NODE_FLAG_ADAPTIVE_MODE))
+      return 0;
+  }
+  return 1;
+}
+
 static_always_inline void
 vlib_main_or_worker_loop (vlib_main_t * vm, int is_main)
 {
   vlib_node_main_t *nm = &vm->node_main;
   vlib_thread_main_t *tm = vlib_get_thread_main ();
   uword i;
-  u64 cpu_time_now;
+  u64 cpu_time_now, cpu_time_loop_start, cpu_time_last_work;
+  u64 idle_sleep_clocks = 0;
   vlib_frame_queue_main_t *fqm;
 
   /* Initialize pending node vector. */
@@ -1423,15 +1471,18 @@ vlib_main_or_worker_loop (vlib_main_t * vm, int is_main)
   else
     cpu_time_now = clib_cpu_time_now ();
 
-  /* Arrange for first level of timing wheel to cover times we care
-     most about. */
+  cpu_time_loop_start = cpu_time_last_work = cpu_time_now;
+  if (!is_main && vm->epoll_fd >= 0)
+    idle_sleep_clocks = tm->idle_sleep_usec * 1e-6 *
+      vm->clib_time.clocks_per_second;
+
+  /* Process suspends and timed events run on the shared timer service */
   if (is_main)
     {
-      nm->timing_wheel.min_sched_time = 10e-6;
-      nm->timing_wheel.max_sched_time = 10e-3;
-      timing_wheel_init (&nm->timing_wheel,
-			 cpu_time_now, vm->clib_time.clocks_per_second);
-      vec_alloc (nm->data_from_advancing_timing_wheel, 32);
+      nm->process_timer_client_index =
+	vlib_timer_client_register ("vlib-process",
+				    vlib_process_timers_expired);
+      vec_alloc (nm->data_from_process_timers, 32);
     }
 
   /* Pre-allocate expired nodes. */
@@ -1463,9 +1514,12 @@ vlib_main_or_worker_loop (vlib_main_t * vm, int is_main)
       if (!is_main)
 	{
 	  vlib_worker_thread_barrier_check ();
+	  vlib_worker_thread_epoch_quiesce (vm);
 	  vec_foreach (fqm, tm->frame_queue_mains)
 	    vlib_frame_queue_dequeue (vm, fqm);
 	}
+      else if (PREDICT_FALSE (vec_len (tm->epoch_deferred) != 0))
+	vlib_worker_thread_epoch_reclaim (vm);
 
       /* Process pre-input nodes. */
       if (is_main)
@@ -1511,26 +1565,20 @@ vlib_main_or_worker_loop (vlib_main_t * vm, int is_main)
 
       if (is_main)
 	{
-	  /* Check if process nodes have expired from timing wheel. */
-	  nm->data_from_advancing_timing_wheel
-	    = timing_wheel_advance (&nm->timing_wheel, cpu_time_now,
-				    nm->data_from_advancing_timing_wheel,
-				    &nm->cpu_time_next_process_ready);
-
-	  ASSERT (nm->data_from_advancing_timing_wheel != 0);
+	  /* Run processes whose timers expired or which were signalled */
 	  if (PREDICT_FALSE
-	      (_vec_len (nm->data_from_advancing_timing_wheel) > 0))
+	      (_vec_len (nm->data_from_process_timers) > 0))
 	    {
 	      uword i;
 
-	    processes_timing_wheel_data:
-	      for (i = 0; i < _vec_len (nm->data_from_advancing_timing_wheel);
+	    processes_timer_data:
+	      for (i = 0; i < _vec_len (nm->data_from_process_timers);
 		   i++)
 		{
-		  u32 d = nm->data_from_advancing_timing_wheel[i];
-		  u32 di = vlib_timing_wheel_data_get_index (d);
+		  u32 d = nm->data_from_process_timers[i];
+		  u32 di = vlib_process_timer_data_get_index (d);
 
-		  if (vlib_timing_wheel_data_is_timed_event (d))
+		  if (vlib_process_timer_data_is_timed_event (d))
 		    {
 		      vlib_signal_timed_event_data_t *te =
 			pool_elt_at_index (nm->signal_timed_event_data_pool,
@@ -1565,7 +1613,7 @@ vlib_main_or_worker_loop (vlib_main_t * vm, int is_main)
 		}
 
 	      /* Reset vector. */
-	      _vec_len (nm->data_from_advancing_timing_wheel) = 0;
+	      _vec_len (nm->data_from_process_timers) = 0;
 	    }
 	}
 
@@ -1579,14 +1627,39 @@ vlib_main_or_worker_loop (vlib_main_t * vm, int is_main)
       _vec_len (nm->pending_frames) = 0;
 
       /* Pending internal nodes may resume processes. */
-      if (is_main && _vec_len (nm->data_from_advancing_timing_wheel) > 0)
-	goto processes_timing_wheel_data;
+      if (is_main && _vec_len (nm->data_from_process_timers) > 0)
+	goto processes_timer_data;
 
-      vlib_increment_main_loop_counter (vm);
+      /* Expire this thread's shared-service timers */
+      vlib_timer_maybe_expire (vm, cpu_time_now);
 
       /* Record time stamp in case there are no enabled nodes and above
          calls do not update time stamp. */
       cpu_time_now = clib_cpu_time_now ();
+
+      if (!is_main)
+	{
+	  if (vm->main_loop_vectors_processed)
+	    {
+	      vm->cpu_time_working += cpu_time_now - cpu_time_loop_start;
+	      cpu_time_last_work = cpu_time_now;
+	    }
+	  else
+	    {
+	      vm->cpu_time_polling += cpu_time_now - cpu_time_loop_start;
+	      if (idle_sleep_clocks
+		  && cpu_time_now - cpu_time_last_work > idle_sleep_clocks)
+		{
+		  /* Not eligible: look again one idle interval later */
+		  if (vlib_worker_can_sleep (vm))
+		    vlib_worker_thread_sleep (vm);
+		  cpu_time_now = cpu_time_last_work = clib_cpu_time_now ();
+		}
+	    }
+	  cpu_time_loop_start = cpu_time_now;
+	}
+
+      vlib_increment_main_loop_counter (vm);
     }
 }
 
@@ -158,6 +158,21 @@ typedef struct vlib_main_t
   /* to compare with node runtime */
   u32 cpu_index;
 
+  /* Global epoch last seen at a quiescent point (workers only) */
+  volatile u64 epoch;
+
+  /* Adaptive polling (workers only): set while parked in epoll_wait */
+  volatile u32 sleeping;
+  int epoll_fd;
+  /* eventfd written by other threads to end the sleep */
+  int wakeup_fd;
+
+  /* Main loop time spent sleeping, polling without input and working */
+  u64 cpu_time_sleeping;
+  u64 cpu_time_polling;
+  u64 cpu_time_working;
+  u64 n_sleeps;
+
   void **mbuf_alloc_list;
 
   /* List of init functions to call, setup by constructors */
@@ -383,6 +383,7 @@ register_node (vlib_main_t * vm, vlib_node_registration_t * r)
 
 	memset (p, 0, sizeof (p[0]));
 	p->log2_n_stack_bytes = log2_n_stack_bytes;
+	p->resume_timer_handle = ~0;
 
 	/* Process node's runtime index is really index into process
 	   pointer vector. */
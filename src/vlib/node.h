@@ -42,7 +42,6 @@
 
 #include <vppinfra/cpu.h>
 #include <vppinfra/longjmp.h>
-#include <vppinfra/timing_wheel.h>
 #include <vlib/trace.h>		/* for vlib_trace_filter_t */
 
 /* Forward declaration. */
@@ -261,6 +260,10 @@ typedef struct vlib_node_t
 #define VLIB_NODE_FLAG_SWITCH_FROM_INTERRUPT_TO_POLLING_MODE (1 << 6)
 #define VLIB_NODE_FLAG_SWITCH_FROM_POLLING_TO_INTERRUPT_MODE (1 << 7)
 
+  /* Input node registers wakeup fds for the queues it polls on workers,
+     see vlib_worker_thread_wakeup_fd_add, so idle workers may sleep. */
+#define VLIB_NODE_FLAG_ADAPTIVE_MODE (1 << 8)
+
   /* State for input nodes. */
   u8 state;
 
@@ -537,6 +540,9 @@ typedef struct
   /* When suspending saves cpu cycle counter when process is to be resumed. */
   u64 resume_cpu_time;
 
+  /* vlib timer running while suspended waiting for the clock, else ~0. */
+  u32 resume_timer_handle;
+
   /* Default output function and its argument for any CLI outputs
      within the process. */
   vlib_cli_output_function_t *output_function;
@@ -601,25 +607,25 @@ typedef struct
 vlib_signal_timed_event_data_t;
 
 always_inline uword
-vlib_timing_wheel_data_is_timed_event (u32 d)
+vlib_process_timer_data_is_timed_event (u32 d)
 {
   return d & 1;
 }
 
 always_inline u32
-vlib_timing_wheel_data_set_suspended_process (u32 i)
+vlib_process_timer_data_set_suspended_process (u32 i)
 {
   return 0 + 2 * i;
 }
 
 always_inline u32
-vlib_timing_wheel_data_set_timed_event (u32 i)
+vlib_process_timer_data_set_timed_event (u32 i)
 {
   return 1 + 2 * i;
 }
 
 always_inline uword
-vlib_timing_wheel_data_get_index (u32 d)
+vlib_process_timer_data_get_index (u32 d)
 {
   return d / 2;
 }
@@ -654,16 +660,14 @@ typedef struct
   /* Vector of internal node's frames waiting to be called. */
   vlib_pending_frame_t *pending_frames;
 
-  /* Timing wheel for scheduling time-based node dispatch. */
-  timing_wheel_t timing_wheel;
+  /* vlib timer client for process suspends and timed events. */
+  u32 process_timer_client_index;
 
   vlib_signal_timed_event_data_t *signal_timed_event_data_pool;
 
-  /* Opaque data vector added via timing_wheel_advance. */
-  u32 *data_from_advancing_timing_wheel;
-
-  /* CPU time of next process to be ready on timing wheel. */
-  u64 cpu_time_next_process_ready;
+  /* Opaques of expired process timers and signalled processes, see
+     vlib_process_timer_data_*. */
+  u32 *data_from_process_timers;
 
   /* Vector of process nodes.
      One for each node of type VLIB_NODE_TYPE_PROCESS. */
@@ -695,25 +699,6 @@ typedef struct
 } vlib_node_main_t;
 
 
-#define FRAME_QUEUE_MAX_NELTS 32
-typedef struct
-{
-  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
-  u64 head;
-  u64 head_hint;
-  u64 tail;
-  u32 n_in_use;
-  u32 nelts;
-  u32 written;
-  u32 threshold;
-  i32 n_vectors[FRAME_QUEUE_MAX_NELTS];
-} frame_queue_trace_t;
-
-typedef struct
-{
-  u64 count[FRAME_QUEUE_MAX_NELTS];
-} frame_queue_nelt_counter_t;
-
 #endif /* included_vlib_node_h */
 
 /*
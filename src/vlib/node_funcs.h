@@ -757,7 +757,7 @@ vlib_process_signal_event_helper (vlib_node_main_t * nm,
 				  uword t,
 				  uword n_data_elts, uword n_data_elt_bytes)
 {
-  uword p_flags, add_to_pending, delete_from_wheel;
+  uword p_flags, add_to_pending, stop_resume_timer;
   void *data_to_be_written_by_caller;
 
   ASSERT (!pool_is_free_index (p->event_type_pool, t));
@@ -796,12 +796,12 @@ vlib_process_signal_event_helper (vlib_node_main_t * nm,
   add_to_pending = (p_flags & VLIB_PROCESS_RESUME_PENDING) == 0;
 
   /* Process will resume when suspend time elapses? */
-  delete_from_wheel = 0;
+  stop_resume_timer = 0;
   if (p_flags & VLIB_PROCESS_IS_SUSPENDED_WAITING_FOR_CLOCK)
     {
       /* Waiting for both event and clock? */
       if (p_flags & VLIB_PROCESS_IS_SUSPENDED_WAITING_FOR_EVENT)
-	delete_from_wheel = 1;
+	stop_resume_timer = 1;
       else
 	/* Waiting only for clock.  Event will be queue and may be
 	   handled when timer expires. */
@@ -814,11 +814,15 @@ vlib_process_signal_event_helper (vlib_node_main_t * nm,
 
   if (add_to_pending)
     {
-      u32 x = vlib_timing_wheel_data_set_suspended_process (n->runtime_index);
+      u32 x = vlib_process_timer_data_set_suspended_process (n->runtime_index);
       p->flags = p_flags | VLIB_PROCESS_RESUME_PENDING;
-      vec_add1 (nm->data_from_advancing_timing_wheel, x);
-      if (delete_from_wheel)
-	timing_wheel_delete (&nm->timing_wheel, x);
+      vec_add1 (nm->data_from_process_timers, x);
+      if (stop_resume_timer && p->resume_timer_handle != ~0)
+	{
+	  /* Processes run on the main thread only */
+	  vlib_timer_stop (&vlib_global_main, p->resume_timer_handle);
+	  p->resume_timer_handle = ~0;
+	}
     }
 
   return data_to_be_written_by_caller;
@@ -879,7 +883,6 @@ vlib_process_signal_event_at_time (vlib_main_t * vm,
   else
     {
       vlib_signal_timed_event_data_t *te;
-      u64 dt_cpu = dt * vm->clib_time.clocks_per_second;
 
       pool_get_aligned (nm->signal_timed_event_data_pool, te, sizeof (te[0]));
 
@@ -895,10 +898,9 @@ vlib_process_signal_event_at_time (vlib_main_t * vm,
       te->process_node_index = n->runtime_index;
       te->event_type_index = t;
 
-      timing_wheel_insert (&nm->timing_wheel, clib_cpu_time_now () + dt_cpu,
-			   vlib_timing_wheel_data_set_timed_event (te -
-								   nm->
-								   signal_timed_event_data_pool));
+      vlib_timer_start (vm, nm->process_timer_client_index,
+			vlib_process_timer_data_set_timed_event
+			(te - nm->signal_timed_event_data_pool), dt);
 
       /* Inline data big enough to hold event? */
       if (te->n_data_bytes < sizeof (te->inline_event_data))
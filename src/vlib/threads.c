@@ -16,6 +16,8 @@
 
 #include <signal.h>
 #include <math.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <vppinfra/format.h>
 #include <vlib/vlib.h>
 
@@ -293,32 +295,22 @@ vlib_alloc_thread (vlib_main_t * vm)
 vlib_frame_queue_t *
 vlib_frame_queue_alloc (int nelts)
 {
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
   vlib_frame_queue_t *fq;
 
+  if (nelts & (nelts - 1))
+    {
+      fformat (stderr, "FATAL: nelts MUST be a power of 2\n");
+      abort ();
+    }
+
   fq = clib_mem_alloc_aligned (sizeof (*fq), CLIB_CACHE_LINE_BYTES);
   memset (fq, 0, sizeof (*fq));
   fq->nelts = nelts;
-  fq->vector_threshold = 128;	// packets
-  vec_validate_aligned (fq->elts, nelts - 1, CLIB_CACHE_LINE_BYTES);
-
-  if (1)
-    {
-      if (((uword) & fq->tail) & (CLIB_CACHE_LINE_BYTES - 1))
-	fformat (stderr, "WARNING: fq->tail unaligned\n");
-      if (((uword) & fq->head) & (CLIB_CACHE_LINE_BYTES - 1))
-	fformat (stderr, "WARNING: fq->head unaligned\n");
-      if (((uword) fq->elts) & (CLIB_CACHE_LINE_BYTES - 1))
-	fformat (stderr, "WARNING: fq->elts unaligned\n");
-
-      if (sizeof (fq->elts[0]) % CLIB_CACHE_LINE_BYTES)
-	fformat (stderr, "WARNING: fq->elts[0] size %d\n",
-		 sizeof (fq->elts[0]));
-      if (nelts & (nelts - 1))
-	{
-	  fformat (stderr, "FATAL: nelts MUST be a power of 2\n");
-	  abort ();
-	}
-    }
+  fq->vector_threshold = 2 * VLIB_FRAME_SIZE;	// packets
+  vec_validate_aligned (fq->buffer_index, nelts - 1, CLIB_CACHE_LINE_BYTES);
+  vec_validate_aligned (fq->producers, tm->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
 
   return (fq);
 }
@@ -329,127 +321,6 @@ vl_msg_api_handler_no_free (void *v)
 {
 }
 
-/* Turned off, save as reference material... */
-#if 0
-static inline int
-vlib_frame_queue_dequeue_internal (int thread_id,
-				   vlib_main_t * vm, vlib_node_main_t * nm)
-{
-  vlib_frame_queue_t *fq = vlib_frame_queues[thread_id];
-  vlib_frame_queue_elt_t *elt;
-  vlib_frame_t *f;
-  vlib_pending_frame_t *p;
-  vlib_node_runtime_t *r;
-  u32 node_runtime_index;
-  int msg_type;
-  u64 before;
-  int processed = 0;
-
-  ASSERT (vm == vlib_mains[thread_id]);
-
-  while (1)
-    {
-      if (fq->head == fq->tail)
-	return processed;
-
-      elt = fq->elts + ((fq->head + 1) & (fq->nelts - 1));
-
-      if (!elt->valid)
-	return processed;
-
-      before = clib_cpu_time_now ();
-
-      f = elt->frame;
-      node_runtime_index = elt->node_runtime_index;
-      msg_type = elt->msg_type;
-
-      switch (msg_type)
-	{
-	case VLIB_FRAME_QUEUE_ELT_FREE_BUFFERS:
-	  vlib_buffer_free (vm, vlib_frame_vector_args (f), f->n_vectors);
-	  /* note fallthrough... */
-	case VLIB_FRAME_QUEUE_ELT_FREE_FRAME:
-	  r = vec_elt_at_index (nm->nodes_by_type[VLIB_NODE_TYPE_INTERNAL],
-				node_runtime_index);
-	  vlib_frame_free (vm, r, f);
-	  break;
-	case VLIB_FRAME_QUEUE_ELT_DISPATCH_FRAME:
-	  vec_add2 (vm->node_main.pending_frames, p, 1);
-	  f->flags |= (VLIB_FRAME_PENDING | VLIB_FRAME_FREE_AFTER_DISPATCH);
-	  p->node_runtime_index = elt->node_runtime_index;
-	  p->frame_index = vlib_frame_index (vm, f);
-	  p->next_frame_index = VLIB_PENDING_FRAME_NO_NEXT_FRAME;
-	  fq->dequeue_vectors += (u64) f->n_vectors;
-	  break;
-	case VLIB_FRAME_QUEUE_ELT_API_MSG:
-	  vl_msg_api_handler_no_free (f);
-	  break;
-	default:
-	  clib_warning ("bogus frame queue message, type %d", msg_type);
-	  break;
-	}
-      elt->valid = 0;
-      fq->dequeues++;
-      fq->dequeue_ticks += clib_cpu_time_now () - before;
-      CLIB_MEMORY_BARRIER ();
-      fq->head++;
-      processed++;
-    }
-  ASSERT (0);
-  return processed;
-}
-
-int
-vlib_frame_queue_dequeue (int thread_id,
-			  vlib_main_t * vm, vlib_node_main_t * nm)
-{
-  return vlib_frame_queue_dequeue_internal (thread_id, vm, nm);
-}
-
-int
-vlib_frame_queue_enqueue (vlib_main_t * vm, u32 node_runtime_index,
-			  u32 frame_queue_index, vlib_frame_t * frame,
-			  vlib_frame_queue_msg_type_t type)
-{
-  vlib_frame_queue_t *fq = vlib_frame_queues[frame_queue_index];
-  vlib_frame_queue_elt_t *elt;
-  u32 save_count;
-  u64 new_tail;
-  u64 before = clib_cpu_time_now ();
-
-  ASSERT (fq);
-
-  new_tail = __sync_add_and_fetch (&fq->tail, 1);
-
-  /* Wait until a ring slot is available */
-  while (new_tail >= fq->head + fq->nelts)
-    {
-      f64 b4 = vlib_time_now_ticks (vm, before);
-      vlib_worker_thread_barrier_check (vm, b4);
-      /* Bad idea. Dequeue -> enqueue -> dequeue -> trouble */
-      // vlib_frame_queue_dequeue (vm->cpu_index, vm, nm);
-    }
-
-  elt = fq->elts + (new_tail & (fq->nelts - 1));
-
-  /* this would be very bad... */
-  while (elt->valid)
-    {
-    }
-
-  /* Once we enqueue the frame, frame->n_vectors is owned elsewhere... */
-  save_count = frame->n_vectors;
-
-  elt->frame = frame;
-  elt->node_runtime_index = node_runtime_index;
-  elt->msg_type = type;
-  CLIB_MEMORY_BARRIER ();
-  elt->valid = 1;
-
-  return save_count;
-}
-#endif /* 0 */
-
 /* To be called by vlib worker threads upon startup */
 void
 vlib_worker_thread_init (vlib_worker_thread_t * w)
@@ -530,6 +401,35 @@ vlib_launch_thread_int (void *fp, vlib_worker_thread_t * w, unsigned lcore_id)
     }
 }
 
+static clib_error_t *
+vlib_worker_thread_sleep_init (vlib_main_t * vm)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  struct epoll_event e;
+
+  vm->sleeping = 0;
+  vm->epoll_fd = vm->wakeup_fd = -1;
+  vm->cpu_time_sleeping = vm->cpu_time_polling = vm->cpu_time_working = 0;
+  vm->n_sleeps = 0;
+
+  if (tm->idle_sleep_usec == 0)
+    return 0;
+
+  if ((vm->epoll_fd = epoll_create (1)) < 0)
+    return clib_error_return_unix (0, "epoll_create");
+
+  if ((vm->wakeup_fd = eventfd (0, EFD_NONBLOCK)) < 0)
+    return clib_error_return_unix (0, "eventfd");
+
+  memset (&e, 0, sizeof (e));
+  e.events = EPOLLIN;
+  e.data.fd = vm->wakeup_fd;
+  if (epoll_ctl (vm->epoll_fd, EPOLL_CTL_ADD, vm->wakeup_fd, &e) < 0)
+    return clib_error_return_unix (0, "epoll_ctl");
+
+  return 0;
+}
+
 static clib_error_t *
 start_workers (vlib_main_t * vm)
 {
@@ -538,15 +438,22 @@ start_workers (vlib_main_t * vm)
   vlib_main_t *vm_clone;
   void *oldheap;
   vlib_thread_main_t *tm = &vlib_thread_main;
-  vlib_thread_registration_t *tr;
+  vlib_thread_registration_t *tr, *workers_tr = 0;
   vlib_node_runtime_t *rt;
   u32 n_vlib_mains = tm->n_vlib_mains;
   u32 worker_thread_index;
   u8 *main_heap = clib_mem_get_per_cpu_heap ();
   mheap_t *main_heap_header = mheap_header (main_heap);
+  clib_error_t *err;
+  uword *p;
 
   vec_reset_length (vlib_worker_threads);
 
+  /* Only vlib workers get a private heap, see cpu_config */
+  p = hash_get_mem (tm->thread_registrations_by_name, "workers");
+  if (p)
+    workers_tr = (vlib_thread_registration_t *) p[0];
+
   /* Set up the main thread */
   vec_add2_aligned (vlib_worker_threads, w, 1, CLIB_CACHE_LINE_BYTES);
   w->elog_track.name = "main thread";
@@ -608,6 +515,17 @@ start_workers (vlib_main_t * vm)
 	      if (tr->mheap_size)
 		w->thread_mheap =
 		  mheap_alloc (0 /* use VM */ , tr->mheap_size);
+	      else if (tm->worker_heap_size && tr == workers_tr)
+		{
+		  w->thread_mheap = clib_mem_thread_arena_create
+		    (w - vlib_worker_threads, tm->worker_heap_size);
+		  if (!w->thread_mheap)
+		    return clib_error_return (0, "failed to allocate %U "
+					      "heap for worker %d",
+					      format_memory_size,
+					      tm->worker_heap_size,
+					      w - vlib_worker_threads);
+		}
 	      else
 		w->thread_mheap = main_heap;
 	      w->thread_stack = vlib_thread_stacks[w - vlib_worker_threads];
@@ -691,14 +609,20 @@ start_workers (vlib_main_t * vm)
 	      clib_mem_set_heap (oldheap);
 	      vec_add1_aligned (vlib_mains, vm_clone, CLIB_CACHE_LINE_BYTES);
 
+	      oldheap = vlib_stats_push_heap ();
 	      vm_clone->error_main.counters =
 		vec_dup (vlib_mains[0]->error_main.counters);
+	      vlib_stats_pop_heap2 (vm_clone->error_main.counters,
+				    vm_clone->cpu_index, oldheap);
 	      vm_clone->error_main.counters_last_clear =
 		vec_dup (vlib_mains[0]->error_main.counters_last_clear);
 
 	      /* Fork the vlib_buffer_main_t free lists, etc. */
-	      bm_clone = vec_dup (vm_clone->buffer_main);
+	      bm_clone = vec_new (vlib_buffer_main_t, 1);
+	      clib_memcpy (bm_clone, vm_clone->buffer_main, sizeof (*bm_clone));
 	      vm_clone->buffer_main = bm_clone;
+	      memset (&bm_clone->cache_stats, 0,
+		      sizeof (bm_clone->cache_stats));
 
 	      orig_freelist_pool = bm_clone->buffer_free_list_pool;
 	      bm_clone->buffer_free_list_pool = 0;
@@ -717,6 +641,9 @@ start_workers (vlib_main_t * vm)
                           }));
 /* *INDENT-ON* */
 
+	      if ((err = vlib_worker_thread_sleep_init (vm_clone)))
+		return err;
+
 	      worker_thread_index++;
 	    }
 	}
@@ -753,7 +680,6 @@ start_workers (vlib_main_t * vm)
 
   for (i = 0; i < vec_len (tm->registrations); i++)
     {
-      clib_error_t *err;
       int j;
 
       tr = tm->registrations[i];
@@ -859,7 +785,11 @@ vlib_worker_thread_node_runtime_update (void)
       clib_memcpy (&vm_clone->error_main, &vm->error_main,
 		   sizeof (vm->error_main));
       j = vec_len (vm->error_main.counters) - 1;
-      vec_validate_aligned (old_counters, j, CLIB_CACHE_LINE_BYTES);
+      {
+	void *oldheap2 = vlib_stats_push_heap ();
+	vec_validate_aligned (old_counters, j, CLIB_CACHE_LINE_BYTES);
+	vlib_stats_pop_heap2 (old_counters, i, oldheap2);
+      }
       vec_validate_aligned (old_counters_all_clear, j, CLIB_CACHE_LINE_BYTES);
       vm_clone->error_main.counters = old_counters;
       vm_clone->error_main.counters_last_clear = old_counters_all_clear;
@@ -1048,6 +978,11 @@ cpu_config (vlib_main_t * vm, unformat_input_t * input)
 	;
       else if (unformat (input, "scheduler-priority %u", &tm->sched_priority))
 	;
+      else if (unformat (input, "idle-sleep-usec %u", &tm->idle_sleep_usec))
+	;
+      else if (unformat (input, "worker-heap-size %U", unformat_memory_size,
+			 &tm->worker_heap_size))
+	;
       else if (unformat (input, "%s %u", &name, &count))
 	{
 	  p = hash_get_mem (tm->thread_registrations_by_name, name);
@@ -1151,6 +1086,7 @@ vlib_worker_thread_barrier_sync (vlib_main_t * vm)
 {
   f64 deadline;
   u32 count;
+  int i;
 
   if (vec_len (vlib_mains) < 2)
     return;
@@ -1165,9 +1101,13 @@ vlib_worker_thread_barrier_sync (vlib_main_t * vm)
 
   ASSERT (os_get_cpu_number () == 0);
 
-  deadline = vlib_time_now (vm) + BARRIER_SYNC_TIMEOUT;
+  vlib_worker_threads[0].barrier_sync_time = vlib_time_now (vm);
+  deadline = vlib_worker_threads[0].barrier_sync_time + BARRIER_SYNC_TIMEOUT;
 
   *vlib_worker_threads->wait_at_barrier = 1;
+  for (i = 1; i < vec_len (vlib_mains); i++)
+    vlib_worker_thread_wakeup (vlib_mains[i]);
+
   while (*vlib_worker_threads->workers_at_barrier != count)
     {
       if (vlib_time_now (vm) > deadline)
@@ -1182,6 +1122,7 @@ void
 vlib_worker_thread_barrier_release (vlib_main_t * vm)
 {
   f64 deadline;
+  f64 hold_time;
 
   if (vec_len (vlib_mains) < 2)
     return;
@@ -1201,6 +1142,222 @@ vlib_worker_thread_barrier_release (vlib_main_t * vm)
 	  os_panic ();
 	}
     }
+
+  hold_time = vlib_time_now (vm) - vlib_worker_threads[0].barrier_sync_time;
+  vlib_worker_threads[0].barrier_hold_time_total += hold_time;
+  if (hold_time > vlib_worker_threads[0].barrier_hold_time_max)
+    vlib_worker_threads[0].barrier_hold_time_max = hold_time;
+}
+
+/*
+ * Oldest epoch any worker may still be in. While the main thread holds
+ * the barrier all workers are parked, hence quiescent.
+ */
+static u64
+vlib_worker_thread_epoch_min (void)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  u64 min_epoch = tm->epoch;
+  int i;
+
+  if (vlib_worker_threads[0].recursion_level > 0)
+    return min_epoch;
+
+  /* Sleeping workers are at ~0 */
+  for (i = 1; i < vec_len (vlib_mains); i++)
+    min_epoch = clib_min (min_epoch, vlib_mains[i]->epoch);
+
+  return min_epoch;
+}
+
+/**
+ * Reclaim an object once no worker can hold a reference to it. The caller
+ * must already have made the object unreachable from the data plane.
+ * Without workers, or with the barrier held, the object is reclaimed
+ * immediately. Main thread only.
+ */
+void
+vlib_worker_thread_epoch_defer (vlib_epoch_reclaim_function_t * fn,
+				uword opaque0, uword opaque1)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  vlib_epoch_deferred_t *d;
+
+  ASSERT (os_get_cpu_number () == 0);
+
+  if (vec_len (vlib_mains) < 2 || vlib_worker_threads[0].recursion_level > 0)
+    {
+      fn (opaque0, opaque1);
+      return;
+    }
+
+  /* Order the unlink before the new epoch */
+  CLIB_MEMORY_BARRIER ();
+  tm->epoch++;
+
+  vec_add2 (tm->epoch_deferred, d, 1);
+  d->function = fn;
+  d->opaque[0] = opaque0;
+  d->opaque[1] = opaque1;
+  d->epoch = tm->epoch;
+  tm->epoch_n_deferred++;
+}
+
+/** Run the reclaim functions of objects all workers are done with. */
+void
+vlib_worker_thread_epoch_reclaim (vlib_main_t * vm)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  vlib_epoch_deferred_t *ready = 0, *d;
+  u64 min_epoch;
+  int i;
+
+  min_epoch = vlib_worker_thread_epoch_min ();
+
+  for (i = 0; i < vec_len (tm->epoch_deferred); i++)
+    if (tm->epoch_deferred[i].epoch > min_epoch)
+      break;
+
+  if (i == 0)
+    return;
+
+  /* Reclaim functions may defer more objects */
+  vec_add (ready, tm->epoch_deferred, i);
+  vec_delete (tm->epoch_deferred, i, 0);
+
+  vec_foreach (d, ready) d->function (d->opaque[0], d->opaque[1]);
+
+  tm->epoch_n_reclaimed += vec_len (ready);
+  vec_free (ready);
+}
+
+/** Wait for all workers to pass the current epoch and reclaim everything. */
+void
+vlib_worker_thread_epoch_flush (vlib_main_t * vm)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  f64 deadline;
+
+  ASSERT (os_get_cpu_number () == 0);
+
+  deadline = vlib_time_now (vm) + BARRIER_SYNC_TIMEOUT;
+
+  while (vec_len (tm->epoch_deferred))
+    {
+      vlib_worker_thread_epoch_reclaim (vm);
+
+      if (vlib_time_now (vm) > deadline)
+	{
+	  fformat (stderr, "%s: worker thread deadlock\n", __FUNCTION__);
+	  os_panic ();
+	}
+    }
+}
+
+/*
+ * Have traffic on fd wake the worker polling it. Edge triggered, so the
+ * input node need not drain the fd and the main thread may still be
+ * watching it too. A no-op unless workers are allowed to sleep.
+ */
+clib_error_t *
+vlib_worker_thread_wakeup_fd_add (u32 cpu_index, int fd)
+{
+  vlib_main_t *vm;
+  struct epoll_event e;
+
+  if (cpu_index == 0 || cpu_index >= vec_len (vlib_mains))
+    return 0;
+
+  vm = vlib_mains[cpu_index];
+  if (vm->epoll_fd < 0)
+    return 0;
+
+  memset (&e, 0, sizeof (e));
+  e.events = EPOLLIN | EPOLLET;
+  e.data.fd = fd;
+  if (epoll_ctl (vm->epoll_fd, EPOLL_CTL_ADD, fd, &e) < 0)
+    return clib_error_return_unix (0, "epoll_ctl add fd %d", fd);
+
+  return 0;
+}
+
+clib_error_t *
+vlib_worker_thread_wakeup_fd_del (u32 cpu_index, int fd)
+{
+  vlib_main_t *vm;
+
+  if (cpu_index == 0 || cpu_index >= vec_len (vlib_mains))
+    return 0;
+
+  vm = vlib_mains[cpu_index];
+  if (vm->epoll_fd < 0)
+    return 0;
+
+  if (epoll_ctl (vm->epoll_fd, EPOLL_CTL_DEL, fd, 0) < 0)
+    return clib_error_return_unix (0, "epoll_ctl del fd %d", fd);
+
+  return 0;
+}
+
+void
+vlib_worker_thread_kick (vlib_main_t * vm)
+{
+  u64 one = 1;
+
+  if (write (vm->wakeup_fd, &one, sizeof (one)) < 0 && errno != EAGAIN)
+    clib_unix_warning ("write");
+}
+
+/*
+ * Park the calling worker until one of its wakeup fds fires, someone
+ * kicks it or VLIB_WORKER_SLEEP_MAX_MSEC elapses.
+ */
+void
+vlib_worker_thread_sleep (vlib_main_t * vm)
+{
+  vlib_thread_main_t *tm = vlib_get_thread_main ();
+  vlib_frame_queue_main_t *fqm;
+  vlib_frame_queue_t *fq;
+  struct epoll_event events[16];
+  u64 t, count;
+  int i, n_ready;
+
+  ASSERT (vm->cpu_index != 0 && vm->epoll_fd >= 0);
+
+  /* Out of the epoch while asleep, we hold no references */
+  vm->epoch = ~0ULL;
+  vm->sleeping = 1;
+  CLIB_MEMORY_BARRIER ();
+
+  /* Work published before the flag was visible gets no kick */
+  if (*vlib_worker_threads->wait_at_barrier)
+    goto done;
+
+  vec_foreach (fqm, tm->frame_queue_mains)
+  {
+    fq = fqm->vlib_frame_queues[vm->cpu_index];
+    if (fq->tail_commit != fq->head)
+      goto done;
+  }
+
+  t = clib_cpu_time_now ();
+  /* Running timers need the wheel turned at least every millisecond */
+  n_ready = epoll_wait (vm->epoll_fd, events, ARRAY_LEN (events),
+			vlib_timer_n_active (vm) ? 1 :
+			VLIB_WORKER_SLEEP_MAX_MSEC);
+  vm->cpu_time_sleeping += clib_cpu_time_now () - t;
+  vm->n_sleeps++;
+
+  for (i = 0; i < n_ready; i++)
+    if (events[i].data.fd == vm->wakeup_fd)
+      {
+	CLIB_UNUSED (ssize_t r) = read (vm->wakeup_fd, &count,
+					sizeof (count));
+      }
+
+done:
+  vm->sleeping = 0;
+  vlib_worker_thread_epoch_quiesce (vm);
 }
 
 /*
@@ -1213,127 +1370,67 @@ vlib_frame_queue_dequeue (vlib_main_t * vm, vlib_frame_queue_main_t * fqm)
 {
   u32 thread_id = vm->cpu_index;
   vlib_frame_queue_t *fq = fqm->vlib_frame_queues[thread_id];
-  vlib_frame_queue_elt_t *elt;
   u32 *from, *to;
   vlib_frame_t *f;
-  int msg_type;
-  int processed = 0;
-  u32 n_left_to_node;
-  u32 vectors = 0;
+  u64 head, n_in_use, before;
+  u32 n_left, n_vectors, n_first, slot;
 
   ASSERT (fq);
   ASSERT (vm == vlib_mains[thread_id]);
 
   if (PREDICT_FALSE (fqm->node_index == ~0))
     return 0;
-  /*
-   * Gather trace data for frame queues
-   */
-  if (PREDICT_FALSE (fq->trace))
-    {
-      frame_queue_trace_t *fqt;
-      frame_queue_nelt_counter_t *fqh;
-      u32 elix;
-
-      fqt = &fqm->frame_queue_traces[thread_id];
-
-      fqt->nelts = fq->nelts;
-      fqt->head = fq->head;
-      fqt->head_hint = fq->head_hint;
-      fqt->tail = fq->tail;
-      fqt->threshold = fq->vector_threshold;
-      fqt->n_in_use = fqt->tail - fqt->head;
-      if (fqt->n_in_use >= fqt->nelts)
-	{
-	  // if beyond max then use max
-	  fqt->n_in_use = fqt->nelts - 1;
-	}
 
-      /* Record the number of elements in use in the histogram */
-      fqh = &fqm->frame_queue_histogram[thread_id];
-      fqh->count[fqt->n_in_use]++;
+  head = fq->head;
+  n_in_use = fq->tail_commit - head;
 
-      /* Record a snapshot of the elements in use */
-      for (elix = 0; elix < fqt->nelts; elix++)
-	{
-	  elt = fq->elts + ((fq->head + 1 + elix) & (fq->nelts - 1));
-	  if (1 || elt->valid)
-	    {
-	      fqt->n_vectors[elix] = elt->n_vectors;
-	    }
-	}
-      fqt->written = 1;
-    }
+  if (n_in_use == 0)
+    return 0;
 
-  while (1)
-    {
-      if (fq->head == fq->tail)
-	{
-	  fq->head_hint = fq->head;
-	  return processed;
-	}
+  /* Read the buffer indices only after seeing them published */
+  CLIB_MEMORY_BARRIER ();
 
-      elt = fq->elts + ((fq->head + 1) & (fq->nelts - 1));
+  before = clib_cpu_time_now ();
+  fq->occupancy[vlib_frame_queue_occupancy_bucket (fq, n_in_use)]++;
 
-      if (!elt->valid)
-	{
-	  fq->head_hint = fq->head;
-	  return processed;
-	}
-
-      from = elt->buffer_index;
-      msg_type = elt->msg_type;
+  /*
+   * Limit the number of packets pushed into the graph
+   */
+  n_left = clib_min (n_in_use, fq->vector_threshold);
+  n_vectors = n_left;
 
-      ASSERT (msg_type == VLIB_FRAME_QUEUE_ELT_DISPATCH_FRAME);
-      ASSERT (elt->n_vectors <= VLIB_FRAME_SIZE);
+  /* Everything published so far, from all producers, in full frames */
+  while (n_left > 0)
+    {
+      u32 n_this_frame = clib_min (n_left, VLIB_FRAME_SIZE);
 
       f = vlib_get_frame_to_node (vm, fqm->node_index);
-
       to = vlib_frame_vector_args (f);
 
-      n_left_to_node = elt->n_vectors;
+      slot = head & (fq->nelts - 1);
+      from = fq->buffer_index + slot;
+      n_first = clib_min (n_this_frame, fq->nelts - slot);
+      clib_memcpy (to, from, n_first * sizeof (u32));
+      if (n_this_frame > n_first)
+	clib_memcpy (to + n_first, fq->buffer_index,
+		     (n_this_frame - n_first) * sizeof (u32));
 
-      while (n_left_to_node >= 4)
-	{
-	  to[0] = from[0];
-	  to[1] = from[1];
-	  to[2] = from[2];
-	  to[3] = from[3];
-	  to += 4;
-	  from += 4;
-	  n_left_to_node -= 4;
-	}
-
-      while (n_left_to_node > 0)
-	{
-	  to[0] = from[0];
-	  to++;
-	  from++;
-	  n_left_to_node--;
-	}
-
-      vectors += elt->n_vectors;
-      f->n_vectors = elt->n_vectors;
+      f->n_vectors = n_this_frame;
       vlib_put_frame_to_node (vm, fqm->node_index, f);
 
-      elt->valid = 0;
-      elt->n_vectors = 0;
-      elt->msg_type = 0xfefefefe;
-      CLIB_MEMORY_BARRIER ();
-      fq->head++;
-      processed++;
-
-      /*
-       * Limit the number of packets pushed into the graph
-       */
-      if (vectors >= fq->vector_threshold)
-	{
-	  fq->head_hint = fq->head;
-	  return processed;
-	}
+      head += n_this_frame;
+      n_left -= n_this_frame;
     }
-  ASSERT (0);
-  return processed;
+
+  /* Hand the slots back to the producers */
+  CLIB_MEMORY_BARRIER ();
+  fq->head = head;
+
+  fq->dequeues++;
+  fq->dequeue_vectors += n_vectors;
+  fq->dequeue_ticks += clib_cpu_time_now () - before;
+
+  return n_vectors;
 }
 
 void
@@ -1375,6 +1472,9 @@ vlib_frame_queue_main_init (u32 node_index, u32 frame_queue_nelts)
   if (frame_queue_nelts == 0)
     frame_queue_nelts = FRAME_QUEUE_NELTS;
 
+  /* Sized in frames, the ring holds buffer indices */
+  frame_queue_nelts *= VLIB_FRAME_SIZE;
+
   vec_add2 (tm->frame_queue_mains, fqm, 1);
 
   fqm->node_index = node_index;
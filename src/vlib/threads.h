@@ -65,24 +65,6 @@ typedef struct vlib_thread_registration_
 #define VLIB_LOG2_THREAD_STACK_SIZE (20)
 #define VLIB_THREAD_STACK_SIZE (1<<VLIB_LOG2_THREAD_STACK_SIZE)
 
-typedef enum
-{
-  VLIB_FRAME_QUEUE_ELT_DISPATCH_FRAME,
-} vlib_frame_queue_msg_type_t;
-
-typedef struct
-{
-  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
-  volatile u32 valid;
-  u32 msg_type;
-  u32 n_vectors;
-  u32 last_n_vectors;
-
-  /* 256 * 4 = 1024 bytes, even mult of cache line size */
-  u32 buffer_index[VLIB_FRAME_SIZE];
-}
-vlib_frame_queue_elt_t;
-
 typedef struct
 {
   /* First cache line */
@@ -102,6 +84,9 @@ typedef struct
   vlib_thread_registration_t *registration;
   u8 *name;
   u64 barrier_sync_count;
+  f64 barrier_sync_time;
+  f64 barrier_hold_time_total;
+  f64 barrier_hold_time_max;
 
   long lwp;
   int lcore_id;
@@ -110,15 +95,39 @@ typedef struct
 
 extern vlib_worker_thread_t *vlib_worker_threads;
 
+/* Queue occupancy histograms count in eighths of the ring */
+#define VLIB_FRAME_QUEUE_N_HISTOGRAM_BUCKETS 8
+
+/* One producer thread's view of a frame queue, written by that thread only */
 typedef struct
 {
-  /* enqueue side */
   CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
-  volatile u64 tail;
+  /* last head seen, so the consumer's cache line is only read when full */
+  u64 head_cache;
   u64 enqueues;
   u64 enqueue_ticks;
   u64 enqueue_vectors;
-  u32 enqueue_full_events;
+  u64 drops;
+  u64 occupancy[VLIB_FRAME_QUEUE_N_HISTOGRAM_BUCKETS];
+}
+vlib_frame_queue_producer_t;
+
+/*
+ * Multi-producer, single consumer ring of buffer indices.
+ *
+ * A producer reserves as many slots as it has buffers for the consumer
+ * by advancing tail, copies the buffer indices and then publishes them
+ * by advancing tail_commit, in reservation order. Batches from several
+ * producers are thus packed back to back and the consumer takes
+ * everything up to tail_commit in one go. A full ring does not block the
+ * producer: what does not fit is handed back to be dropped.
+ */
+typedef struct
+{
+  /* enqueue side, shared by the producers */
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+  volatile u64 tail;
+  volatile u64 tail_commit;
 
   /* dequeue side */
     CLIB_CACHE_LINE_ALIGN_MARK (cacheline1);
@@ -126,17 +135,16 @@ typedef struct
   u64 dequeues;
   u64 dequeue_ticks;
   u64 dequeue_vectors;
-  u64 trace;
   u64 vector_threshold;
-
-  /* dequeue hint to enqueue side */
-    CLIB_CACHE_LINE_ALIGN_MARK (cacheline2);
-  volatile u64 head_hint;
+  u64 occupancy[VLIB_FRAME_QUEUE_N_HISTOGRAM_BUCKETS];
 
   /* read-only, constant, shared */
-    CLIB_CACHE_LINE_ALIGN_MARK (cacheline3);
-  vlib_frame_queue_elt_t *elts;
+    CLIB_CACHE_LINE_ALIGN_MARK (cacheline2);
+  u32 *buffer_index;
   u32 nelts;
+
+  /* per producer thread statistics, indexed by cpu index */
+  vlib_frame_queue_producer_t *producers;
 }
 vlib_frame_queue_t;
 
@@ -144,10 +152,6 @@ typedef struct
 {
   u32 node_index;
   vlib_frame_queue_t **vlib_frame_queues;
-
-  /* for frame queue tracing */
-  frame_queue_trace_t *frame_queue_traces;
-  frame_queue_nelt_counter_t *frame_queue_histogram;
 } vlib_frame_queue_main_t;
 
 /* Called early, in thread 0's context */
@@ -155,10 +159,6 @@ clib_error_t *vlib_thread_init (vlib_main_t * vm);
 
 vlib_worker_thread_t *vlib_alloc_thread (vlib_main_t * vm);
 
-int vlib_frame_queue_enqueue (vlib_main_t * vm, u32 node_runtime_index,
-			      u32 frame_queue_index, vlib_frame_t * frame,
-			      vlib_frame_queue_msg_type_t type);
-
 int
 vlib_frame_queue_dequeue (vlib_main_t * vm, vlib_frame_queue_main_t * fqm);
 
@@ -192,6 +192,26 @@ u32 vlib_frame_queue_main_init (u32 node_index, u32 frame_queue_nelts);
 void vlib_worker_thread_barrier_sync (vlib_main_t * vm);
 void vlib_worker_thread_barrier_release (vlib_main_t * vm);
 
+/*
+ * Allocate an element from a pool that the workers index without a lock.
+ * The barrier is taken only when the allocation would move the pool.
+ */
+#define vlib_worker_thread_pool_get_aligned(P,E,A)                      \
+do {                                                                    \
+  vlib_main_t * _vm = vlib_get_main ();                                 \
+  int _need_barrier_sync;                                               \
+                                                                        \
+  pool_get_aligned_will_expand (P, _need_barrier_sync, A);              \
+  if (_need_barrier_sync)                                               \
+    vlib_worker_thread_barrier_sync (_vm);                              \
+  pool_get_aligned (P, E, A);                                           \
+  if (_need_barrier_sync)                                               \
+    vlib_worker_thread_barrier_release (_vm);                           \
+} while (0)
+
+#define vlib_worker_thread_pool_get(P,E) \
+  vlib_worker_thread_pool_get_aligned(P,E,0)
+
 always_inline void
 vlib_smp_unsafe_warning (void)
 {
@@ -258,6 +278,28 @@ typedef enum
     SCHED_POLICY_N,
 } sched_policy_t;
 
+/*
+ * Epoch based deferred reclamation.
+ *
+ * Workers announce a quiescent state once per main loop iteration, by
+ * copying the global epoch into their vlib_main_t: at that point they hold
+ * no pointers or indices into shared data structures. A writer unlinks an
+ * object so that no new reader can find it, then hands it to
+ * vlib_worker_thread_epoch_defer(), which advances the global epoch. The
+ * reclaim function runs on the main thread once every worker has seen
+ * the new epoch, i.e. once no worker can still be looking at the object.
+ */
+typedef void (vlib_epoch_reclaim_function_t) (uword opaque0, uword opaque1);
+
+typedef struct
+{
+  vlib_epoch_reclaim_function_t *function;
+  uword opaque[2];
+
+  /* Safe to reclaim once every worker has seen this epoch */
+  u64 epoch;
+} vlib_epoch_deferred_t;
+
 typedef struct
 {
   clib_error_t *(*vlib_launch_thread_cb) (void *fp, vlib_worker_thread_t * w,
@@ -325,10 +367,64 @@ typedef struct
   /* callbacks */
   vlib_thread_callbacks_t cb;
   int extern_thread_mgmt;
+
+  /* Epoch based reclamation, advanced by the main thread only */
+  volatile u64 epoch;
+
+  /* Objects waiting for the workers to pass an epoch, in epoch order */
+  vlib_epoch_deferred_t *epoch_deferred;
+  u64 epoch_n_deferred;
+  u64 epoch_n_reclaimed;
+
+  /* Workers sleep after this long without input, 0 to always poll */
+  u32 idle_sleep_usec;
+
+  /* Size of each "workers" thread's private heap, 0 to share the
+     main heap */
+  uword worker_heap_size;
 } vlib_thread_main_t;
 
 extern vlib_thread_main_t vlib_thread_main;
 
+void vlib_worker_thread_epoch_defer (vlib_epoch_reclaim_function_t * fn,
+				     uword opaque0, uword opaque1);
+void vlib_worker_thread_epoch_reclaim (vlib_main_t * vm);
+void vlib_worker_thread_epoch_flush (vlib_main_t * vm);
+
+/*
+ * Called by each worker between node dispatch rounds, when it holds
+ * no references to shared objects.
+ */
+static inline void
+vlib_worker_thread_epoch_quiesce (vlib_main_t * vm)
+{
+  CLIB_MEMORY_BARRIER ();
+  vm->epoch = vlib_thread_main.epoch;
+}
+
+/*
+ * Adaptive polling. A worker whose polling input nodes all carry
+ * VLIB_NODE_FLAG_ADAPTIVE_MODE parks in epoll_wait once it has seen no
+ * work for idle-sleep-usec. Devices register the file descriptors which
+ * signal traffic on the queues a worker polls; threads handing other work
+ * to a worker (frame queues, the barrier) kick its eventfd.
+ */
+#define VLIB_WORKER_SLEEP_MAX_MSEC 10
+
+clib_error_t *vlib_worker_thread_wakeup_fd_add (u32 cpu_index, int fd);
+clib_error_t *vlib_worker_thread_wakeup_fd_del (u32 cpu_index, int fd);
+void vlib_worker_thread_sleep (vlib_main_t * vm);
+void vlib_worker_thread_kick (vlib_main_t * vm);
+
+static inline void
+vlib_worker_thread_wakeup (vlib_main_t * vm)
+{
+  /* Order the work we just published before looking at the flag */
+  CLIB_MEMORY_BARRIER ();
+  if (PREDICT_FALSE (vm->sleeping))
+    vlib_worker_thread_kick (vm);
+}
+
 #define VLIB_REGISTER_THREAD(x,...)                     \
   __VA_ARGS__ vlib_thread_registration_t x;             \
 static void __vlib_add_thread_registration_##x (void)   \
@@ -376,92 +472,79 @@ vlib_get_worker_vlib_main (u32 worker_index)
   return vm;
 }
 
-static inline void
-vlib_put_frame_queue_elt (vlib_frame_queue_elt_t * hf)
+always_inline u32
+vlib_frame_queue_occupancy_bucket (vlib_frame_queue_t * fq, u64 n_in_use)
 {
-  CLIB_MEMORY_BARRIER ();
-  hf->valid = 1;
+  u64 i = (n_in_use * VLIB_FRAME_QUEUE_N_HISTOGRAM_BUCKETS) / fq->nelts;
+  return clib_min (i, VLIB_FRAME_QUEUE_N_HISTOGRAM_BUCKETS - 1);
 }
 
-static inline vlib_frame_queue_elt_t *
-vlib_get_frame_queue_elt (u32 frame_queue_index, u32 index)
+/**
+ * Hand buffers over to another thread's frame queue.
+ *
+ * @return the number of buffers enqueued. The remaining buffers did not
+ * fit in the ring and stay with the caller, who normally drops them.
+ */
+always_inline u32
+vlib_frame_queue_enqueue (vlib_main_t * vm, u32 frame_queue_index,
+			  u32 thread_index, u32 * buffers, u32 n_buffers)
 {
-  vlib_frame_queue_t *fq;
-  vlib_frame_queue_elt_t *elt;
   vlib_thread_main_t *tm = &vlib_thread_main;
   vlib_frame_queue_main_t *fqm =
     vec_elt_at_index (tm->frame_queue_mains, frame_queue_index);
-  u64 new_tail;
-
-  fq = fqm->vlib_frame_queues[index];
-  ASSERT (fq);
-
-  new_tail = __sync_add_and_fetch (&fq->tail, 1);
-
-  /* Wait until a ring slot is available */
-  while (new_tail >= fq->head_hint + fq->nelts)
-    vlib_worker_thread_barrier_check ();
-
-  elt = fq->elts + (new_tail & (fq->nelts - 1));
-
-  /* this would be very bad... */
-  while (elt->valid)
-    ;
-
-  elt->msg_type = VLIB_FRAME_QUEUE_ELT_DISPATCH_FRAME;
-  elt->last_n_vectors = elt->n_vectors = 0;
-
-  return elt;
-}
-
-static inline vlib_frame_queue_t *
-is_vlib_frame_queue_congested (u32 frame_queue_index,
-			       u32 index,
-			       u32 queue_hi_thresh,
-			       vlib_frame_queue_t **
-			       handoff_queue_by_worker_index)
-{
   vlib_frame_queue_t *fq;
-  vlib_thread_main_t *tm = &vlib_thread_main;
-  vlib_frame_queue_main_t *fqm =
-    vec_elt_at_index (tm->frame_queue_mains, frame_queue_index);
+  vlib_frame_queue_producer_t *fqp;
+  u64 tail, n_in_use, before;
+  u32 n, n_first, slot;
 
-  fq = handoff_queue_by_worker_index[index];
-  if (fq != (vlib_frame_queue_t *) (~0))
-    return fq;
-
-  fq = fqm->vlib_frame_queues[index];
+  fq = fqm->vlib_frame_queues[thread_index];
   ASSERT (fq);
+  fqp = vec_elt_at_index (fq->producers, vm->cpu_index);
+  before = clib_cpu_time_now ();
 
-  if (PREDICT_FALSE (fq->tail >= (fq->head_hint + queue_hi_thresh)))
+  /* Reserve slots */
+  do
     {
-      /* a valid entry in the array will indicate the queue has reached
-       * the specified threshold and is congested
-       */
-      handoff_queue_by_worker_index[index] = fq;
-      fq->enqueue_full_events++;
-      return fq;
+      tail = fq->tail;
+      n_in_use = tail - fqp->head_cache;
+      if (n_in_use + n_buffers > fq->nelts)
+	{
+	  fqp->head_cache = fq->head;
+	  n_in_use = tail - fqp->head_cache;
+	}
+      n = clib_min (n_buffers, fq->nelts - n_in_use);
+      if (PREDICT_FALSE (n == 0))
+	break;
     }
+  while (!__sync_bool_compare_and_swap (&fq->tail, tail, tail + n));
 
-  return NULL;
-}
+  fqp->occupancy[vlib_frame_queue_occupancy_bucket (fq, n_in_use)]++;
+  fqp->drops += n_buffers - n;
 
-static inline vlib_frame_queue_elt_t *
-vlib_get_worker_handoff_queue_elt (u32 frame_queue_index,
-				   u32 vlib_worker_index,
-				   vlib_frame_queue_elt_t **
-				   handoff_queue_elt_by_worker_index)
-{
-  vlib_frame_queue_elt_t *elt;
+  if (PREDICT_FALSE (n == 0))
+    return 0;
+
+  slot = tail & (fq->nelts - 1);
+  n_first = clib_min (n, fq->nelts - slot);
+  clib_memcpy (fq->buffer_index + slot, buffers, n_first * sizeof (u32));
+  if (n > n_first)
+    clib_memcpy (fq->buffer_index, buffers + n_first,
+		 (n - n_first) * sizeof (u32));
 
-  if (handoff_queue_elt_by_worker_index[vlib_worker_index])
-    return handoff_queue_elt_by_worker_index[vlib_worker_index];
+  /* Producers that reserved before us publish first */
+  while (fq->tail_commit != tail)
+    ;
+
+  CLIB_MEMORY_BARRIER ();
+  fq->tail_commit = tail + n;
 
-  elt = vlib_get_frame_queue_elt (frame_queue_index, vlib_worker_index);
+  vlib_worker_thread_wakeup (vlib_mains[thread_index]);
 
-  handoff_queue_elt_by_worker_index[vlib_worker_index] = elt;
+  fqp->enqueues++;
+  fqp->enqueue_vectors += n;
+  fqp->enqueue_ticks += clib_cpu_time_now () - before;
 
-  return elt;
+  return n;
 }
 
 int vlib_thread_cb_register (struct vlib_main_t *vm,
@@ -121,6 +121,50 @@ show_threads_fn (vlib_main_t * vm,
     }
 #endif
 
+  if (vec_len (vlib_worker_threads))
+    {
+      vlib_thread_main_t *tm = vlib_get_thread_main ();
+
+      w = vlib_worker_threads;
+      vlib_cli_output (vm, "\nBarrier syncs %lld, hold time %.6f sec total, "
+		       "%.2f us avg, %.2f us max", w->barrier_sync_count,
+		       w->barrier_hold_time_total,
+		       w->barrier_sync_count ?
+		       w->barrier_hold_time_total * 1e6 /
+		       w->barrier_sync_count : 0.0,
+		       w->barrier_hold_time_max * 1e6);
+      vlib_cli_output (vm, "Epoch %lld, %lld objects deferred, %lld reclaimed, "
+		       "%d pending", tm->epoch, tm->epoch_n_deferred,
+		       tm->epoch_n_reclaimed, vec_len (tm->epoch_deferred));
+
+      if (vec_len (vlib_mains) > 1)
+	{
+	  vlib_cli_output (vm, "\nWorker main loop time, idle sleep %s:",
+			   tm->idle_sleep_usec ? "on" : "off");
+	  vlib_cli_output (vm, "%-7s%12s%18s%18s%18s", "ID", "Sleeps",
+			   "Sleeping", "Polling", "Working");
+	  for (i = 1; i < vec_len (vlib_mains); i++)
+	    {
+	      vlib_main_t *wvm = vlib_mains[i];
+	      f64 spc = wvm->clib_time.seconds_per_clock;
+	      f64 total = wvm->cpu_time_sleeping + wvm->cpu_time_polling
+		+ wvm->cpu_time_working;
+
+	      if (total == 0)
+		total = 1;
+
+	      vlib_cli_output (vm, "%-7d%12lld%11.3fs %4.1f%%%11.3fs %4.1f%%"
+			       "%11.3fs %4.1f%%", i, wvm->n_sleeps,
+			       wvm->cpu_time_sleeping * spc,
+			       wvm->cpu_time_sleeping * 100 / total,
+			       wvm->cpu_time_polling * spc,
+			       wvm->cpu_time_polling * 100 / total,
+			       wvm->cpu_time_working * spc,
+			       wvm->cpu_time_working * 100 / total);
+	    }
+	}
+    }
+
   return 0;
 }
 
@@ -133,293 +177,170 @@ VLIB_CLI_COMMAND (show_threads_command, static) = {
 };
 /* *INDENT-ON* */
 
-/*
- * Trigger threads to grab frame queue trace data
- */
-static clib_error_t *
-trace_frame_queue (vlib_main_t * vm, unformat_input_t * input,
-		   vlib_cli_command_t * cmd)
+static u8 *
+format_frame_queue_occupancy (u8 * s, va_list * args)
 {
-  unformat_input_t _line_input, *line_input = &_line_input;
-  clib_error_t *error = NULL;
-  frame_queue_trace_t *fqt;
-  frame_queue_nelt_counter_t *fqh;
-  vlib_thread_main_t *tm = vlib_get_thread_main ();
-  vlib_frame_queue_main_t *fqm;
-  u32 num_fq;
-  u32 fqix;
-  u32 enable = 2;
-  u32 index = ~(u32) 0;
-
-  if (!unformat_user (input, unformat_line_input, line_input))
-    return 0;
-
-  while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
-    {
-      if (unformat (line_input, "on"))
-	enable = 1;
-      else if (unformat (line_input, "off"))
-	enable = 0;
-      else if (unformat (line_input, "index %u", &index))
-	;
-      else
-	{
-	  error = clib_error_return (0, "parse error: '%U'",
-				     format_unformat_error, line_input);
-	  goto done;
-	}
-    }
-
-  if (enable > 1)
-    {
-      error = clib_error_return (0, "expecting on or off");
-      goto done;
-    }
-
-  if (vec_len (tm->frame_queue_mains) == 0)
-    {
-      error = clib_error_return (0, "no worker handoffs exist");
-      goto done;
-    }
-
-  if (index > vec_len (tm->frame_queue_mains) - 1)
-    {
-      error = clib_error_return (0,
-				 "expecting valid worker handoff queue index");
-      goto done;
-    }
-
-  fqm = vec_elt_at_index (tm->frame_queue_mains, index);
-
-  num_fq = vec_len (fqm->vlib_frame_queues);
-  if (num_fq == 0)
-    {
-      vlib_cli_output (vm, "No frame queues exist\n");
-      goto done;
-    }
-
-  // Allocate storage for trace if necessary
-  vec_validate_aligned (fqm->frame_queue_traces, num_fq - 1,
-			CLIB_CACHE_LINE_BYTES);
-  vec_validate_aligned (fqm->frame_queue_histogram, num_fq - 1,
-			CLIB_CACHE_LINE_BYTES);
-
-  for (fqix = 0; fqix < num_fq; fqix++)
-    {
-      fqt = &fqm->frame_queue_traces[fqix];
-      fqh = &fqm->frame_queue_histogram[fqix];
-
-      memset (fqt->n_vectors, 0xff, sizeof (fqt->n_vectors));
-      fqt->written = 0;
-      memset (fqh, 0, sizeof (*fqh));
-      fqm->vlib_frame_queues[fqix]->trace = enable;
-    }
-
-done:
-  unformat_free (line_input);
-
-  return error;
-}
+  u64 *occupancy = va_arg (*args, u64 *);
+  u64 total = 0;
+  int i;
 
-/* *INDENT-OFF* */
-VLIB_CLI_COMMAND (cmd_trace_frame_queue,static) = {
-    .path = "trace frame-queue",
-    .short_help = "trace frame-queue (on|off)",
-    .function = trace_frame_queue,
-    .is_mp_safe = 1,
-};
-/* *INDENT-ON* */
+  for (i = 0; i < VLIB_FRAME_QUEUE_N_HISTOGRAM_BUCKETS; i++)
+    total += occupancy[i];
 
+  /* Round up, so any non-zero count shows as at least one percent */
+  for (i = 0; i < VLIB_FRAME_QUEUE_N_HISTOGRAM_BUCKETS; i++)
+    s = format (s, "%5d%%", total ?
+		(u32) ((occupancy[i] * 100 + total - 1) / total) : 0);
 
-/*
- * Adding two counters and compute percent of total
- * Round up, e.g. 0.000001 => 1%
- */
-static u32
-compute_percent (u64 * two_counters, u64 total)
-{
-  if (total == 0)
-    {
-      return 0;
-    }
-  else
-    {
-      return (((two_counters[0] + two_counters[1]) * 100) +
-	      (total - 1)) / total;
-    }
+  return s;
 }
 
 /*
- * Display frame queue trace data gathered by threads.
+ * Display frame queue statistics, per consumer and per producer thread.
  */
-static clib_error_t *
+static void
 show_frame_queue_internal (vlib_main_t * vm,
 			   vlib_frame_queue_main_t * fqm, u32 histogram)
 {
-  clib_error_t *error = NULL;
-  frame_queue_trace_t *fqt;
-  frame_queue_nelt_counter_t *fqh;
-  u32 num_fq;
-  u32 fqix;
+  vlib_frame_queue_producer_t *fqp;
+  vlib_frame_queue_t *fq;
+  u32 fqix, pix;
 
-  num_fq = vec_len (fqm->frame_queue_traces);
-  if (num_fq == 0)
+  for (fqix = 0; fqix < vec_len (fqm->vlib_frame_queues); fqix++)
     {
-      vlib_cli_output (vm, "No trace data for frame queues\n");
-      return error;
-    }
+      fq = fqm->vlib_frame_queues[fqix];
 
-  if (histogram)
-    {
-      vlib_cli_output (vm, "0-1   2-3   4-5   6-7   8-9   10-11 12-13 14-15 "
-		       "16-17 18-19 20-21 22-23 24-25 26-27 28-29 30-31\n");
-    }
+      if (fq->tail == 0)
+	continue;
 
-  for (fqix = 0; fqix < num_fq; fqix++)
-    {
-      fqt = &(fqm->frame_queue_traces[fqix]);
-
-      vlib_cli_output (vm, "Thread %d %v\n", fqix,
-		       vlib_worker_threads[fqix].name);
-
-      if (fqt->written == 0)
-	{
-	  vlib_cli_output (vm, "  no trace data\n");
-	  continue;
-	}
+      vlib_cli_output (vm, "  Thread %d %v: ring size %d, in use %lld, "
+		       "vector-threshold %lld", fqix,
+		       vlib_worker_threads[fqix].name, fq->nelts,
+		       fq->tail - fq->head, fq->vector_threshold);
 
       if (histogram)
 	{
-	  fqh = &(fqm->frame_queue_histogram[fqix]);
-	  u32 nelt;
-	  u64 total = 0;
-
-	  for (nelt = 0; nelt < FRAME_QUEUE_MAX_NELTS; nelt++)
-	    {
-	      total += fqh->count[nelt];
-	    }
-
-	  /*
-	   * Print in pairs to condense the output.
-	   * Allow entries with 0 counts to be clearly identified, by rounding up.
-	   * Any non-zero value will be displayed as at least one percent. This
-	   * also means the sum of percentages can be > 100, but that is fine. The
-	   * histogram is counted from the last time "trace frame on" was issued.
-	   */
-	  vlib_cli_output (vm,
-			   "%3d%%  %3d%%  %3d%%  %3d%%  %3d%%  %3d%%  %3d%%  %3d%%  "
-			   "%3d%%  %3d%%  %3d%%  %3d%%  %3d%%  %3d%%  %3d%%  %3d%%\n",
-			   compute_percent (&fqh->count[0], total),
-			   compute_percent (&fqh->count[2], total),
-			   compute_percent (&fqh->count[4], total),
-			   compute_percent (&fqh->count[6], total),
-			   compute_percent (&fqh->count[8], total),
-			   compute_percent (&fqh->count[10], total),
-			   compute_percent (&fqh->count[12], total),
-			   compute_percent (&fqh->count[14], total),
-			   compute_percent (&fqh->count[16], total),
-			   compute_percent (&fqh->count[18], total),
-			   compute_percent (&fqh->count[20], total),
-			   compute_percent (&fqh->count[22], total),
-			   compute_percent (&fqh->count[24], total),
-			   compute_percent (&fqh->count[26], total),
-			   compute_percent (&fqh->count[28], total),
-			   compute_percent (&fqh->count[30], total));
+	  vlib_cli_output (vm, "    %-16s%U", "consumer",
+			   format_frame_queue_occupancy, fq->occupancy);
 	}
       else
 	{
-	  vlib_cli_output (vm,
-			   "  vector-threshold %d  ring size %d  in use %d\n",
-			   fqt->threshold, fqt->nelts, fqt->n_in_use);
-	  vlib_cli_output (vm, "  head %12d  head_hint %12d  tail %12d\n",
-			   fqt->head, fqt->head_hint, fqt->tail);
-	  vlib_cli_output (vm,
-			   "  %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d\n",
-			   fqt->n_vectors[0], fqt->n_vectors[1],
-			   fqt->n_vectors[2], fqt->n_vectors[3],
-			   fqt->n_vectors[4], fqt->n_vectors[5],
-			   fqt->n_vectors[6], fqt->n_vectors[7],
-			   fqt->n_vectors[8], fqt->n_vectors[9],
-			   fqt->n_vectors[10], fqt->n_vectors[11],
-			   fqt->n_vectors[12], fqt->n_vectors[13],
-			   fqt->n_vectors[14], fqt->n_vectors[15]);
-
-	  if (fqt->nelts > 16)
-	    {
-	      vlib_cli_output (vm,
-			       "  %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d %3d\n",
-			       fqt->n_vectors[16], fqt->n_vectors[17],
-			       fqt->n_vectors[18], fqt->n_vectors[19],
-			       fqt->n_vectors[20], fqt->n_vectors[21],
-			       fqt->n_vectors[22], fqt->n_vectors[23],
-			       fqt->n_vectors[24], fqt->n_vectors[25],
-			       fqt->n_vectors[26], fqt->n_vectors[27],
-			       fqt->n_vectors[28], fqt->n_vectors[29],
-			       fqt->n_vectors[30], fqt->n_vectors[31]);
-	    }
+	  vlib_cli_output (vm, "    %-16s%12s%12s%12s%12s%12s",
+			   "", "calls", "vectors", "drops", "vec/call",
+			   "clks/vec");
+	  vlib_cli_output (vm, "    %-16s%12lld%12lld%12s%12.2f%12.2f",
+			   "consumer", fq->dequeues, fq->dequeue_vectors, "",
+			   fq->dequeues ?
+			   (f64) fq->dequeue_vectors / fq->dequeues : 0.0,
+			   fq->dequeue_vectors ?
+			   (f64) fq->dequeue_ticks / fq->dequeue_vectors :
+			   0.0);
 	}
 
+      vec_foreach_index (pix, fq->producers)
+      {
+	fqp = vec_elt_at_index (fq->producers, pix);
+
+	if (fqp->enqueues == 0 && fqp->drops == 0)
+	  continue;
+
+	if (histogram)
+	  vlib_cli_output (vm, "    producer %-7d%U", pix,
+			   format_frame_queue_occupancy, fqp->occupancy);
+	else
+	  vlib_cli_output (vm, "    producer %-7d%12lld%12lld%12lld%12.2f%12.2f",
+			   pix, fqp->enqueues, fqp->enqueue_vectors,
+			   fqp->drops, fqp->enqueues ?
+			   (f64) fqp->enqueue_vectors / fqp->enqueues : 0.0,
+			   fqp->enqueue_vectors ?
+			   (f64) fqp->enqueue_ticks / fqp->enqueue_vectors :
+			   0.0);
+      }
     }
-  return error;
 }
 
 static clib_error_t *
-show_frame_queue_trace (vlib_main_t * vm, unformat_input_t * input,
-			vlib_cli_command_t * cmd)
+show_frame_queue_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			     vlib_cli_command_t * cmd)
 {
   vlib_thread_main_t *tm = vlib_get_thread_main ();
   vlib_frame_queue_main_t *fqm;
-  clib_error_t *error;
+  u32 histogram = 0;
+
+  if (unformat (input, "histogram"))
+    histogram = 1;
+
+  if (vec_len (tm->frame_queue_mains) == 0)
+    {
+      vlib_cli_output (vm, "No worker handoff queues exist");
+      return 0;
+    }
 
   vec_foreach (fqm, tm->frame_queue_mains)
   {
     vlib_cli_output (vm, "Worker handoff queue index %u (next node '%U'):",
 		     fqm - tm->frame_queue_mains,
 		     format_vlib_node_name, vm, fqm->node_index);
-    error = show_frame_queue_internal (vm, fqm, 0);
-    if (error)
-      return error;
+    if (histogram)
+      vlib_cli_output (vm, "    %-16s%6s%6s%6s%6s%6s%6s%6s%6s",
+		       "occupancy", "0-", "1/8-", "2/8-", "3/8-",
+		       "4/8-", "5/8-", "6/8-", "7/8-");
+    show_frame_queue_internal (vm, fqm, histogram);
   }
   return 0;
 }
 
+/*?
+ * Display the worker handoff queues: per consumer thread, the ring size
+ * and use, and per producer thread the number of enqueue calls, buffers
+ * handed off and buffers dropped because the ring was full. With
+ * <em>histogram</em>, show how full each ring was seen by its consumer
+ * and producers, in eighths of the ring size.
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (cmd_show_frame_queue,static) = {
+    .path = "show frame-queue",
+    .short_help = "show frame-queue [histogram]",
+    .function = show_frame_queue_command_fn,
+};
+/* *INDENT-ON* */
+
 static clib_error_t *
-show_frame_queue_histogram (vlib_main_t * vm, unformat_input_t * input,
-			    vlib_cli_command_t * cmd)
+clear_frame_queue_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
 {
   vlib_thread_main_t *tm = vlib_get_thread_main ();
+  vlib_frame_queue_producer_t *fqp;
   vlib_frame_queue_main_t *fqm;
-  clib_error_t *error;
+  vlib_frame_queue_t *fq;
+  u32 fqix;
 
   vec_foreach (fqm, tm->frame_queue_mains)
   {
-    vlib_cli_output (vm, "Worker handoff queue index %u (next node '%U'):",
-		     fqm - tm->frame_queue_mains,
-		     format_vlib_node_name, vm, fqm->node_index);
-    error = show_frame_queue_internal (vm, fqm, 1);
-    if (error)
-      return error;
+    for (fqix = 0; fqix < vec_len (fqm->vlib_frame_queues); fqix++)
+      {
+	fq = fqm->vlib_frame_queues[fqix];
+	fq->dequeues = fq->dequeue_vectors = fq->dequeue_ticks = 0;
+	memset (fq->occupancy, 0, sizeof (fq->occupancy));
+	vec_foreach (fqp, fq->producers)
+	{
+	  fqp->enqueues = fqp->enqueue_vectors = fqp->enqueue_ticks = 0;
+	  fqp->drops = 0;
+	  memset (fqp->occupancy, 0, sizeof (fqp->occupancy));
+	}
+      }
   }
   return 0;
 }
 
 /* *INDENT-OFF* */
-VLIB_CLI_COMMAND (cmd_show_frame_queue_trace,static) = {
-    .path = "show frame-queue",
-    .short_help = "show frame-queue trace",
-    .function = show_frame_queue_trace,
+VLIB_CLI_COMMAND (cmd_clear_frame_queue,static) = {
+    .path = "clear frame-queue",
+    .short_help = "clear frame-queue",
+    .function = clear_frame_queue_command_fn,
 };
 /* *INDENT-ON* */
 
-/* *INDENT-OFF* */
-VLIB_CLI_COMMAND (cmd_show_frame_queue_histogram,static) = {
-    .path = "show frame-queue histogram",
-    .short_help = "show frame-queue histogram",
-    .function = show_frame_queue_histogram,
-};
-/* *INDENT-ON* */
-
-
 /*
  * Modify the number of elements on the frame_queues
  */
@@ -477,7 +398,16 @@ test_frame_queue_nelts (vlib_main_t * vm, unformat_input_t * input,
 
   for (fqix = 0; fqix < num_fq; fqix++)
     {
-      fqm->vlib_frame_queues[fqix]->nelts = nelts;
+      vlib_frame_queue_t *fq = fqm->vlib_frame_queues[fqix];
+
+      if (nelts * VLIB_FRAME_SIZE > vec_len (fq->buffer_index))
+	{
+	  error = clib_error_return (0, "ring allocated for %d frames only",
+				     vec_len (fq->buffer_index) /
+				     VLIB_FRAME_SIZE);
+	  goto done;
+	}
+      fq->nelts = nelts * VLIB_FRAME_SIZE;
     }
 
 done:
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vlib/vlib.h>
+
+vlib_timer_main_t vlib_timer_main;
+
+/* Called by the wheel, once per tick with expirations */
+static void
+vlib_timer_wheel_expired (u32 * tw_handles)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+  vlib_main_t *vm = vlib_get_main ();
+  vlib_timer_per_thread_t *pt = vec_elt_at_index (tm->per_thread,
+						  vm->cpu_index);
+  vlib_timer_t *t;
+  u32 i, index;
+
+  for (i = 0; i < vec_len (tw_handles); i++)
+    {
+      /* One timer per object, the handle is the pool index */
+      index = tw_handles[i] & ((1 << (32 - 2)) - 1);
+      t = pool_elt_at_index (pt->timers, index);
+      vec_validate (pt->expired_by_client, t->client_index);
+      vec_add1 (pt->expired_by_client[t->client_index], t->opaque);
+      pool_put (pt->timers, t);
+    }
+}
+
+/**
+ * @brief Register a timer client
+ * @param name client name
+ * @param function called with the opaques of expired timers
+ * @returns client index, for vlib_timer_start
+ */
+u32
+vlib_timer_client_register (char *name,
+			    vlib_timer_expired_function_t * function)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+  vlib_timer_client_t *c;
+
+  vec_add2 (tm->clients, c, 1);
+  c->name = format (0, "%s%c", name, 0);
+  c->function = function;
+  return c - tm->clients;
+}
+
+/**
+ * @brief Start a timer on the calling thread
+ * @param vm vlib main of the calling thread
+ * @param client_index from vlib_timer_client_register
+ * @param opaque handed back to the client on expiry
+ * @param delay seconds from now, clamped to the wheel's range
+ * @returns handle for vlib_timer_stop. The handle is recycled once the
+ *   timer expires and must not be stopped after that.
+ */
+u32
+vlib_timer_start (vlib_main_t * vm, u32 client_index, u32 opaque, f64 delay)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+  vlib_timer_per_thread_t *pt = vec_elt_at_index (tm->per_thread,
+						  vm->cpu_index);
+  vlib_timer_t *t;
+  u64 ticks;
+
+  ASSERT (client_index < vec_len (tm->clients));
+
+  /* Idle wheel: skip the ticks nobody was waiting for */
+  if (pool_elts (pt->timers) == 0)
+    {
+      f64 now = vlib_time_now (vm);
+      pt->wheel.last_run_time = now;
+      pt->wheel.next_run_time = now + pt->wheel.timer_interval;
+      pt->next_run_clocks = clib_cpu_time_now () + tm->tick_clocks;
+    }
+
+  ticks = delay * pt->wheel.ticks_per_second;
+  ticks = clib_max (ticks, 1);
+  ticks = clib_min (ticks, VLIB_TIMER_MAX_TICKS);
+
+  pool_get (pt->timers, t);
+  t->client_index = client_index;
+  t->opaque = opaque;
+  t->tw_handle = tw_timer_start_4t_3w_512sl (&pt->wheel, t - pt->timers,
+					     0 /* timer id */ , ticks);
+  pt->n_started++;
+  return t - pt->timers;
+}
+
+/**
+ * @brief Stop a running timer
+ * @param vm vlib main of the thread which started it
+ * @param handle from vlib_timer_start
+ */
+void
+vlib_timer_stop (vlib_main_t * vm, u32 handle)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+  vlib_timer_per_thread_t *pt = vec_elt_at_index (tm->per_thread,
+						  vm->cpu_index);
+  vlib_timer_t *t = pool_elt_at_index (pt->timers, handle);
+
+  tw_timer_stop_4t_3w_512sl (&pt->wheel, t->tw_handle);
+  pool_put (pt->timers, t);
+}
+
+/**
+ * @brief Advance the calling thread's wheel and run client callbacks
+ * @param vm vlib main of the calling thread
+ * @param cpu_time_now current cpu clock
+ */
+void
+vlib_timer_expire (vlib_main_t * vm, u64 cpu_time_now)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+  vlib_timer_per_thread_t *pt = vec_elt_at_index (tm->per_thread,
+						  vm->cpu_index);
+  vlib_timer_client_t *c;
+  u32 i, n;
+
+  if (pool_elts (pt->timers) == 0)
+    {
+      pt->next_run_clocks = ~0ULL;
+      return;
+    }
+
+  pt->next_run_clocks = cpu_time_now + tm->tick_clocks;
+  if (tw_timer_expire_timers_4t_3w_512sl (&pt->wheel,
+					  vlib_time_now (vm)) == 0)
+    return;
+
+  /* One call per client, timers may be restarted from the callback */
+  for (i = 0; i < vec_len (pt->expired_by_client); i++)
+    {
+      n = vec_len (pt->expired_by_client[i]);
+      if (n == 0)
+	continue;
+      c = vec_elt_at_index (tm->clients, i);
+      c->function (vm, pt->expired_by_client[i]);
+      vec_reset_length (pt->expired_by_client[i]);
+      pt->n_expired += n;
+    }
+}
+
+static clib_error_t *
+show_timers_command_fn (vlib_main_t * vm,
+			unformat_input_t * input, vlib_cli_command_t * cmd)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+  vlib_timer_per_thread_t *pt;
+  vlib_timer_client_t *c;
+
+  vlib_cli_output (vm, "tick %.1fus, %d clients:", tm->tick_seconds * 1e6,
+		   vec_len (tm->clients));
+  vec_foreach (c, tm->clients) vlib_cli_output (vm, "  %s", c->name);
+
+  vlib_cli_output (vm, "%=8s%=12s%=16s%=16s", "Thread", "Running",
+		   "Started", "Expired");
+  vec_foreach (pt, tm->per_thread)
+  {
+    vlib_cli_output (vm, "%=8d%=12d%=16lld%=16lld", pt - tm->per_thread,
+		     pool_elts (pt->timers), pt->n_started, pt->n_expired);
+  }
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_timers_command, static) = {
+  .path = "show timers",
+  .short_help = "show timers",
+  .function = show_timers_command_fn,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+vlib_timer_init (vlib_main_t * vm)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+  vlib_thread_main_t *vtm = vlib_get_thread_main ();
+  vlib_timer_per_thread_t *pt;
+
+  tm->tick_seconds = 100e-6;
+  tm->tick_clocks = tm->tick_seconds * vm->clib_time.clocks_per_second;
+
+  vec_validate_aligned (tm->per_thread, vtm->n_vlib_mains - 1,
+			CLIB_CACHE_LINE_BYTES);
+  vec_foreach (pt, tm->per_thread)
+  {
+    tw_timer_wheel_init_4t_3w_512sl (&pt->wheel, vlib_timer_wheel_expired,
+				     tm->tick_seconds,
+				     ~0 /* max expirations */ );
+    pt->next_run_clocks = ~0ULL;
+  }
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (vlib_timer_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
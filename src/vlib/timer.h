@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_vlib_timer_h
+#define included_vlib_timer_h
+
+#include <vppinfra/tw_timer_4t_3w_512sl.h>
+
+/** \file
+
+    Shared per-thread timer service.
+
+    Each vlib main (main thread and workers) owns a private three-level
+    timer wheel with a 100us tick, covering delays from 100us to about
+    3.7 hours. Subsystems register once as a client and then start and
+    stop timers on the thread they run on; no locks are taken.
+
+    The wheel is advanced from the main / worker loop. Expired timers
+    are grouped by client, so each client is called at most once per
+    loop iteration with a vector of the opaque values it passed to
+    vlib_timer_start. A thread with no running timers pays one
+    compare per loop iteration.
+*/
+
+/** Expired timer callback, gets the opaques of all expired timers */
+typedef void (vlib_timer_expired_function_t) (vlib_main_t * vm,
+					      u32 * opaques);
+
+typedef struct
+{
+  /** client name, for show commands */
+  u8 *name;
+
+  /** expiry callback */
+  vlib_timer_expired_function_t *function;
+} vlib_timer_client_t;
+
+typedef struct
+{
+  /** owning client */
+  u32 client_index;
+
+  /** client's cookie, handed back on expiry */
+  u32 opaque;
+
+  /** tw timer handle */
+  u32 tw_handle;
+} vlib_timer_t;
+
+typedef struct
+{
+  CLIB_CACHE_LINE_ALIGN_MARK (cacheline0);
+
+  /** Advance the wheel when the cpu clock reaches this, ~0 if idle */
+  u64 next_run_clocks;
+
+  /** the wheel */
+  tw_timer_wheel_4t_3w_512sl_t wheel;
+
+  /** running timers, indexed by vlib timer handle */
+  vlib_timer_t *timers;
+
+  /** opaques of expired timers, per client */
+  u32 **expired_by_client;
+
+  /** statistics */
+  u64 n_started;
+  u64 n_expired;
+} vlib_timer_per_thread_t;
+
+typedef struct
+{
+  /** registered clients */
+  vlib_timer_client_t *clients;
+
+  /** one timer wheel per vlib main */
+  vlib_timer_per_thread_t *per_thread;
+
+  /** wheel granularity */
+  f64 tick_seconds;
+  u64 tick_clocks;
+} vlib_timer_main_t;
+
+extern vlib_timer_main_t vlib_timer_main;
+
+/** Longest delay a single timer can have, in ticks: three 512-slot
+    rings, less one glacier slot for the carry */
+#define VLIB_TIMER_MAX_TICKS ((1 << 27) - (1 << 18) - 1)
+
+u32 vlib_timer_client_register (char *name,
+				vlib_timer_expired_function_t * function);
+u32 vlib_timer_start (vlib_main_t * vm, u32 client_index, u32 opaque,
+		      f64 delay);
+void vlib_timer_stop (vlib_main_t * vm, u32 handle);
+void vlib_timer_expire (vlib_main_t * vm, u64 cpu_time_now);
+
+/** Number of timers running on the calling thread */
+always_inline uword
+vlib_timer_n_active (vlib_main_t * vm)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+
+  if (PREDICT_FALSE (vm->cpu_index >= vec_len (tm->per_thread)))
+    return 0;
+  return pool_elts (tm->per_thread[vm->cpu_index].timers);
+}
+
+/** Called once per main loop iteration */
+always_inline void
+vlib_timer_maybe_expire (vlib_main_t * vm, u64 cpu_time_now)
+{
+  vlib_timer_main_t *tm = &vlib_timer_main;
+
+  if (PREDICT_FALSE (vm->cpu_index >= vec_len (tm->per_thread)))
+    return;
+  if (PREDICT_FALSE
+      (cpu_time_now >= tm->per_thread[vm->cpu_index].next_run_clocks))
+    vlib_timer_expire (vm, cpu_time_now);
+}
+
+#endif /* included_vlib_timer_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
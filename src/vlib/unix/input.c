@@ -113,38 +113,15 @@ linux_epoll_input (vlib_main_t * vm,
 
   {
     vlib_node_main_t *nm = &vm->node_main;
-    u64 t = nm->cpu_time_next_process_ready;
-    f64 timeout;
     int timeout_ms, max_timeout_ms = 10;
     f64 vector_rate = vlib_last_vectors_per_main_loop (vm);
 
-    if (t == ~0ULL)
-      {
-	timeout = 10e-3;
-	timeout_ms = max_timeout_ms;
-      }
-    else
-      {
-	timeout =
-	  (((i64) t - (i64) clib_cpu_time_now ())
-	   * vm->clib_time.seconds_per_clock)
-	  /* subtract off some slop time */  - 50e-6;
-
-	if (timeout < 1e3)
-	  {
-	    /* We have event happenning in less than 1 ms so
-	       don't allow epoll to wait */
-	    timeout_ms = 0;
-	  }
-	else
-	  {
-	    timeout_ms = timeout * 1e3;
-
-	    /* Must be between 1 and 10 ms. */
-	    timeout_ms = clib_max (1, timeout_ms);
-	    timeout_ms = clib_min (max_timeout_ms, timeout_ms);
-	  }
-      }
+    /* Don't oversleep running timers */
+    if (vlib_timer_n_active (vm))
+      max_timeout_ms = 1;
+
+    /* Suspended processes wake on the timer service, no need to poll */
+    timeout_ms = max_timeout_ms;
 
     /* If we still have input nodes polling (e.g. vnet packet generator)
        don't sleep. */
@@ -53,17 +53,39 @@ adj_poison (ip_adjacency_t * adj)
 ip_adjacency_t *
 adj_alloc (fib_protocol_t proto)
 {
+    vlib_main_t *vm = vlib_get_main();
     ip_adjacency_t *adj;
+    int need_barrier_sync;
+
+    /*
+     * the workers index the pool and the counters, don't realloc either
+     * from under them.
+     */
+    pool_get_will_expand(adj_pool, need_barrier_sync);
+    if (need_barrier_sync)
+        vlib_worker_thread_barrier_sync(vm);
 
     pool_get(adj_pool, adj);
 
     adj_poison(adj);
 
+    if (!need_barrier_sync)
+    {
+        need_barrier_sync =
+            vlib_validate_combined_counter_will_expand(&adjacency_counters,
+                                                       adj_get_index(adj));
+        if (need_barrier_sync)
+            vlib_worker_thread_barrier_sync(vm);
+    }
+
     /* Make sure certain fields are always initialized. */
     /* Validate adjacency counters. */
     vlib_validate_combined_counter(&adjacency_counters,
                                    adj_get_index(adj));
 
+    if (need_barrier_sync)
+        vlib_worker_thread_barrier_release(vm);
+
     adj->rewrite_header.sw_if_index = ~0;
     adj->n_adj = 1;
     adj->lookup_next_index = 0;
@@ -152,26 +174,44 @@ format_ip_adjacency (u8 * s, va_list * args)
     return s;
 }
 
+/*
+ * adj_free
+ *
+ * Return the adj to the pool, once packets in flight are done with it.
+ */
+static void
+adj_free (uword opaque0,
+          uword opaque1)
+{
+    ip_adjacency_t *adj;
+
+    adj = adj_get(opaque0);
+
+    if (IP_LOOKUP_NEXT_MIDCHAIN == adj->lookup_next_index)
+    {
+        dpo_reset(&adj->sub_type.midchain.next_dpo);
+    }
+
+    fib_node_deinit(&adj->ia_node);
+    pool_put(adj_pool, adj);
+}
+
 /*
  * adj_last_lock_gone
  *
  * last lock/reference to the adj has gone, we no longer need it.
+ * Remove it from the DBs now, so the control plane can no longer find it,
+ * and free it when the workers have passed an epoch.
  */
 static void
 adj_last_lock_gone (ip_adjacency_t *adj)
 {
-    vlib_main_t * vm = vlib_get_main();
-
     ASSERT(0 == fib_node_list_get_size(adj->ia_node.fn_children));
     ADJ_DBG(adj, "last-lock-gone");
 
-    vlib_worker_thread_barrier_sync (vm);
-
     switch (adj->lookup_next_index)
     {
     case IP_LOOKUP_NEXT_MIDCHAIN:
-        dpo_reset(&adj->sub_type.midchain.next_dpo);
-        /* FALL THROUGH */
     case IP_LOOKUP_NEXT_ARP:
     case IP_LOOKUP_NEXT_REWRITE:
 	/*
@@ -198,10 +238,7 @@ adj_last_lock_gone (ip_adjacency_t *adj)
 	break;
     }
 
-    vlib_worker_thread_barrier_release(vm);
-
-    fib_node_deinit(&adj->ia_node);
-    pool_put(adj_pool, adj);
+    vlib_worker_thread_epoch_defer(adj_free, adj_get_index(adj), 0);
 }
 
 void
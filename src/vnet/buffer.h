@@ -61,6 +61,10 @@
 #define ETH_BUFFER_VLAN_BITS (ETH_BUFFER_VLAN_1_DEEP | \
                               ETH_BUFFER_VLAN_2_DEEP)
 
+/* TCP super-segment, vnet_buffer2 (b)->gso describes how to segment it */
+#define LOG2_VNET_BUFFER_GSO LOG2_VLIB_BUFFER_FLAG_USER(5)
+#define VNET_BUFFER_GSO (1 << LOG2_VNET_BUFFER_GSO)
+
 #define LOG2_BUFFER_HANDOFF_NEXT_VALID LOG2_VLIB_BUFFER_FLAG_USER(6)
 #define BUFFER_HANDOFF_NEXT_VALID (1 << LOG2_BUFFER_HANDOFF_NEXT_VALID)
 
@@ -296,9 +300,28 @@ typedef struct
 {
   union
   {
+    /*
+     * Generic segmentation offload. Header offsets are relative to
+     * b->data, so they survive l2 rewrites in front of the l3 header.
+     */
+    struct
+    {
+      i16 l3_hdr_offset;
+      i16 l4_hdr_offset;
+      u16 gso_size;		/**< Payload bytes per segment (MSS) */
+      u8 l4_hdr_sz;
+      u8 is_ip4;
+    } gso;
   };
 } vnet_buffer_opaque2_t;
 
+STATIC_ASSERT (sizeof (vnet_buffer_opaque2_t) <=
+	       STRUCT_SIZE_OF (vlib_buffer_t, opaque2),
+	       "VNET buffer opaque2 meta-data too large for vlib_buffer");
+
+#define vnet_buffer2(b) \
+  ((vnet_buffer_opaque2_t *) vlib_get_buffer_opaque2 (b))
+
 
 
 #endif /* included_vnet_buffer_h */
@@ -528,6 +528,12 @@ classify_api_hookup (vlib_main_t * vm)
   foreach_vpe_api_msg;
 #undef _
 
+  /*
+   * Replaced session pages are reclaimed per epoch, so readers never
+   * see them reused; no need to stop the workers.
+   */
+  am->is_mp_safe[VL_API_CLASSIFY_ADD_DEL_SESSION] = 1;
+
   /*
    * Set up the (msg_name, crc, message-id) table
    */
@@ -150,6 +150,9 @@ void vnet_classify_delete_table_index (vnet_classify_main_t *cm,
   if (pool_is_free_index (cm->tables, table_index))
     return;
 
+  /* Pages waiting for the workers to pass an epoch live in the table heap */
+  vlib_worker_thread_epoch_flush (vlib_get_main ());
+
   t = pool_elt_at_index (cm->tables, table_index);
   if (del_chain && t->next_table_index != ~0)
     /* Recursively delete the entire chain */
@@ -240,6 +243,27 @@ vnet_classify_entry_free (vnet_classify_table_t * t,
     t->freelists[free_list_index] = v;
 }
 
+/*
+ * Put a bucket's replaced pages back on the free list, once no worker
+ * can still be searching them.
+ */
+static void
+vnet_classify_entry_free_deferred (uword table_index, uword offset)
+{
+  vnet_classify_main_t * cm = &vnet_classify_main;
+  vnet_classify_table_t * t;
+
+  t = pool_elt_at_index (cm->tables, table_index);
+
+  while (__sync_lock_test_and_set (t->writer_lock, 1))
+    ;
+
+  vnet_classify_entry_free (t, vnet_classify_get_entry (t, offset));
+
+  CLIB_MEMORY_BARRIER();
+  t->writer_lock[0] = 0;
+}
+
 static inline void make_working_copy
 (vnet_classify_table_t * t, vnet_classify_bucket_t * b)
 {
@@ -389,6 +413,7 @@ int vnet_classify_add_del (vnet_classify_table_t * t,
   u32 new_log2_pages;
   u32 cpu_number = os_get_cpu_number();
   u8 * key_minus_skip;
+  u64 deferred_offset = 0;
 
   ASSERT ((add_v->flags & VNET_CLASSIFY_ENTRY_FREE) == 0);
 
@@ -540,13 +565,28 @@ int vnet_classify_add_del (vnet_classify_table_t * t,
   CLIB_MEMORY_BARRIER();
   b->as_u64 = tmp_b.as_u64;
   t->active_elements ++;
-  v = vnet_classify_get_entry (t, t->saved_bucket.offset);
-  vnet_classify_entry_free (t, v);
+
+  /*
+   * Readers may still be searching the old pages. Sessions added by
+   * the flow-classify workers do not wait for them.
+   */
+  if (cpu_number == 0)
+    deferred_offset = t->saved_bucket.offset;
+  else
+    {
+      v = vnet_classify_get_entry (t, t->saved_bucket.offset);
+      vnet_classify_entry_free (t, v);
+    }
 
  unlock:
   CLIB_MEMORY_BARRIER();
   t->writer_lock[0] = 0;
 
+  if (deferred_offset)
+    vlib_worker_thread_epoch_defer (vnet_classify_entry_free_deferred,
+                                    t - vnet_classify_main.tables,
+                                    deferred_offset);
+
   return rv;
 }
 
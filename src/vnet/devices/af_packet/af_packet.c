@@ -174,16 +174,29 @@ error:
 static void
 af_packet_worker_thread_enable ()
 {
-  /* If worker threads are enabled, switch to polling mode */
+  /*
+   * If worker threads are enabled, switch them to polling mode. The main
+   * thread polls no interfaces then, and stays in interrupt mode so it
+   * can still sleep in epoll.
+   */
   foreach_vlib_main ((
 		       {
-		       vlib_node_set_state (this_vlib_main,
-					    af_packet_input_node.index,
-					    VLIB_NODE_STATE_POLLING);
+		       if (this_vlib_main->cpu_index >=
+			   af_packet_main.input_cpu_first_index)
+			 vlib_node_set_state (this_vlib_main,
+					      af_packet_input_node.index,
+					      VLIB_NODE_STATE_POLLING);
 		       }));
 
 }
 
+/* Worker thread polling the given interface, see af_packet_input_fn */
+static u32
+af_packet_input_cpu_index (af_packet_main_t * apm, uword if_index)
+{
+  return apm->input_cpu_first_index + (if_index % apm->input_cpu_count);
+}
+
 static void
 af_packet_worker_thread_disable ()
 {
@@ -268,6 +281,11 @@ af_packet_create_if (vlib_main_t * vm, u8 * host_if_name, u8 * hw_addr_set,
     apif->unix_file_index = unix_file_add (&unix_main, &template);
   }
 
+  /* Let traffic wake the worker polling this interface */
+  if ((error = vlib_worker_thread_wakeup_fd_add
+       (af_packet_input_cpu_index (apm, if_index), fd)))
+    clib_error_report (error);
+
   /*use configured or generate random MAC address */
   if (hw_addr_set)
     clib_memcpy (hw_addr, hw_addr_set, 6);
@@ -326,6 +344,7 @@ af_packet_delete_if (vlib_main_t * vm, u8 * host_if_name)
   vlib_thread_main_t *tm = vlib_get_thread_main ();
   af_packet_main_t *apm = &af_packet_main;
   af_packet_if_t *apif;
+  clib_error_t *error;
   uword *p;
   uword if_index;
   u32 ring_sz;
@@ -343,6 +362,10 @@ af_packet_delete_if (vlib_main_t * vm, u8 * host_if_name)
   vnet_hw_interface_set_flags (vnm, apif->hw_if_index, 0);
 
   /* clean up */
+  if ((error = vlib_worker_thread_wakeup_fd_del
+       (af_packet_input_cpu_index (apm, if_index), apif->fd)))
+    clib_error_report (error);
+
   if (apif->unix_file_index != ~0)
     {
       unix_file_del (&unix_main, unix_main.file_pool + apif->unix_file_index);
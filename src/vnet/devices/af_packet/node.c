@@ -275,6 +275,7 @@ VLIB_REGISTER_NODE (af_packet_input_node) = {
    * default state is INTERRUPT mode, switch to POLLING if worker threads are enabled
    */
   .state = VLIB_NODE_STATE_INTERRUPT,
+  .flags = VLIB_NODE_FLAG_ADAPTIVE_MODE,
   .n_errors = AF_PACKET_INPUT_N_ERROR,
   .error_strings = af_packet_input_error_strings,
 };
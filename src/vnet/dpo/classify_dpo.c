@@ -27,7 +27,8 @@ classify_dpo_alloc (void)
 {
     classify_dpo_t *cd;
 
-    pool_get_aligned(classify_dpo_pool, cd, CLIB_CACHE_LINE_BYTES);
+    vlib_worker_thread_pool_get_aligned(classify_dpo_pool, cd,
+                                        CLIB_CACHE_LINE_BYTES);
     memset(cd, 0, sizeof(*cd));
 
     return (cd);
@@ -82,17 +82,46 @@ load_balance_get_buckets (load_balance_t *lb)
 static load_balance_t *
 load_balance_alloc_i (void)
 {
+    vlib_main_t *vm = vlib_get_main();
     load_balance_t *lb;
+    int need_barrier_sync;
+
+    /*
+     * the workers index the pool and the counters, so a realloc of either
+     * must not pull the memory from under them. Growing them is rare, so
+     * take the barrier then.
+     */
+    pool_get_aligned_will_expand(load_balance_pool, need_barrier_sync,
+                                 CLIB_CACHE_LINE_BYTES);
+    if (need_barrier_sync)
+        vlib_worker_thread_barrier_sync(vm);
 
     pool_get_aligned(load_balance_pool, lb, CLIB_CACHE_LINE_BYTES);
     memset(lb, 0, sizeof(*lb));
 
     lb->lb_map = INDEX_INVALID;
     lb->lb_urpf = INDEX_INVALID;
+
+    if (!need_barrier_sync)
+    {
+        need_barrier_sync =
+            (vlib_validate_combined_counter_will_expand(
+                 &(load_balance_main.lbm_to_counters),
+                 load_balance_get_index(lb)) ||
+             vlib_validate_combined_counter_will_expand(
+                 &(load_balance_main.lbm_via_counters),
+                 load_balance_get_index(lb)));
+        if (need_barrier_sync)
+            vlib_worker_thread_barrier_sync(vm);
+    }
     vlib_validate_combined_counter(&(load_balance_main.lbm_to_counters),
                                    load_balance_get_index(lb));
     vlib_validate_combined_counter(&(load_balance_main.lbm_via_counters),
                                    load_balance_get_index(lb));
+
+    if (need_barrier_sync)
+        vlib_worker_thread_barrier_release(vm);
+
     vlib_zero_combined_counter(&(load_balance_main.lbm_to_counters),
                                load_balance_get_index(lb));
     vlib_zero_combined_counter(&(load_balance_main.lbm_via_counters),
@@ -445,6 +474,24 @@ load_balance_multipath_next_hop_fixup (const load_balance_path_t *nhs,
  * Fill in adjacencies in block based on corresponding
  * next hop adjacencies.
  */
+/*
+ * Release a bucket array once no packet in flight can be reading it.
+ */
+static void
+load_balance_buckets_free (uword opaque0,
+                           uword opaque1)
+{
+    dpo_id_t *buckets, *tmp_dpo;
+
+    buckets = uword_to_pointer(opaque0, dpo_id_t *);
+
+    vec_foreach(tmp_dpo, buckets)
+    {
+        dpo_reset(tmp_dpo);
+    }
+    vec_free(buckets);
+}
+
 static void
 load_balance_fill_buckets (load_balance_t *lb,
                            load_balance_path_t *nhs,
@@ -487,7 +534,6 @@ load_balance_multipath_update (const dpo_id_t *dpo,
     u32 sum_of_weights, n_buckets, ii;
     index_t lbmi, old_lbmi;
     load_balance_t *lb;
-    dpo_id_t *tmp_dpo;
 
     nhs = NULL;
 
@@ -609,7 +655,7 @@ load_balance_multipath_update (const dpo_id_t *dpo,
                      * we are not crossing the threshold. We need a new bucket array to
                      * hold the increased number of choices.
                      */
-                    dpo_id_t *new_buckets, *old_buckets, *tmp_dpo;
+                    dpo_id_t *new_buckets, *old_buckets;
 
                     new_buckets = NULL;
                     old_buckets = load_balance_get_buckets(lb);
@@ -624,11 +670,9 @@ load_balance_multipath_update (const dpo_id_t *dpo,
                     CLIB_MEMORY_BARRIER();
                     load_balance_set_n_buckets(lb, n_buckets);
 
-                    vec_foreach(tmp_dpo, old_buckets)
-                    {
-                        dpo_reset(tmp_dpo);
-                    }
-                    vec_free(old_buckets);
+                    vlib_worker_thread_epoch_defer(load_balance_buckets_free,
+                                                   pointer_to_uword(old_buckets),
+                                                   0);
                 }
             }
 
@@ -658,7 +702,8 @@ load_balance_multipath_update (const dpo_id_t *dpo,
                  *   1 - Fill the inline buckets,
                  *   2 - fixup the number (and this point the inline buckets are
                  *       used).
-                 *   3 - free the outline buckets
+                 *   3 - free the outline buckets, once packets inflight
+                 *       are done with them.
                  */
                 load_balance_fill_buckets(lb, nhs,
                                           lb->lb_buckets_inline,
@@ -667,11 +712,10 @@ load_balance_multipath_update (const dpo_id_t *dpo,
                 load_balance_set_n_buckets(lb, n_buckets);
                 CLIB_MEMORY_BARRIER();
 
-                vec_foreach(tmp_dpo, lb->lb_buckets)
-                {
-                    dpo_reset(tmp_dpo);
-                }
-                vec_free(lb->lb_buckets);
+                vlib_worker_thread_epoch_defer(load_balance_buckets_free,
+                                               pointer_to_uword(lb->lb_buckets),
+                                               0);
+                lb->lb_buckets = NULL;
             }
             else
             {
@@ -722,12 +766,20 @@ load_balance_lock (dpo_id_t *dpo)
     lb->lb_locks++;
 }
 
+/*
+ * The last lock is gone, so nothing in the FIB refers to the load-balance
+ * any more, but packets in flight may still. Destroy it, and allow its
+ * index to be reused, only once the workers have moved on.
+ */
 static void
-load_balance_destroy (load_balance_t *lb)
+load_balance_destroy (uword opaque0,
+                      uword opaque1)
 {
     dpo_id_t *buckets;
+    load_balance_t *lb;
     int i;
 
+    lb = load_balance_get(opaque0);
     buckets = load_balance_get_buckets(lb);
 
     for (i = 0; i < lb->lb_n_buckets; i++)
@@ -758,7 +810,8 @@ load_balance_unlock (dpo_id_t *dpo)
 
     if (0 == lb->lb_locks)
     {
-        load_balance_destroy(lb);
+        vlib_worker_thread_epoch_defer(load_balance_destroy,
+                                       dpo->dpoi_index, 0);
     }
 }
 
@@ -386,7 +386,8 @@ load_balance_map_alloc (const load_balance_path_t *paths)
     load_balance_map_t *lbm;
     u32 ii;
 
-    pool_get_aligned(load_balance_map_pool, lbm, CLIB_CACHE_LINE_BYTES);
+    vlib_worker_thread_pool_get_aligned(load_balance_map_pool, lbm,
+                                        CLIB_CACHE_LINE_BYTES);
     memset(lbm, 0, sizeof(*lbm));
 
     vec_validate(lbm->lbm_paths, vec_len(paths)-1);
@@ -30,7 +30,8 @@ receive_dpo_alloc (void)
 {
     receive_dpo_t *rd;
 
-    pool_get_aligned(receive_dpo_pool, rd, CLIB_CACHE_LINE_BYTES);
+    vlib_worker_thread_pool_get_aligned(receive_dpo_pool, rd,
+                                        CLIB_CACHE_LINE_BYTES);
     memset(rd, 0, sizeof(*rd));
 
     return (rd);
@@ -517,7 +517,8 @@ fib_entry_alloc (u32 fib_index,
     fib_entry_t *fib_entry;
     fib_prefix_t *fep;
 
-    pool_get(fib_entry_pool, fib_entry);
+    /* arp-input on the workers reads entries */
+    vlib_worker_thread_pool_get(fib_entry_pool, fib_entry);
     memset(fib_entry, 0, sizeof(*fib_entry));
 
     fib_node_init(&fib_entry->fe_node,
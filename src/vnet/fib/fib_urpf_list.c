@@ -56,7 +56,7 @@ fib_urpf_list_alloc_and_lock (void)
 {
     fib_urpf_list_t *urpf;
 
-    pool_get(fib_urpf_list_pool, urpf);
+    vlib_worker_thread_pool_get(fib_urpf_list_pool, urpf);
     memset(urpf, 0, sizeof(*urpf));
 
     urpf->furpf_locks++;
@@ -64,6 +64,21 @@ fib_urpf_list_alloc_and_lock (void)
     return (urpf - fib_urpf_list_pool);
 }
 
+/*
+ * The source check in the data-plane may still be reading a list the
+ * load-balance has just dropped; release it after an epoch.
+ */
+static void
+fib_urpf_list_free (uword ui, uword unused)
+{
+    fib_urpf_list_t *urpf;
+
+    urpf = fib_urpf_list_get(ui);
+
+    vec_free(urpf->furpf_itfs);
+    pool_put(fib_urpf_list_pool, urpf);
+}
+
 void
 fib_urpf_list_unlock (index_t ui)
 {
@@ -78,8 +93,7 @@ fib_urpf_list_unlock (index_t ui)
 
     if (0 == urpf->furpf_locks)
     {
-	vec_free(urpf->furpf_itfs);
-	pool_put(fib_urpf_list_pool, urpf);
+	vlib_worker_thread_epoch_defer(fib_urpf_list_free, ui, 0);
     }
 }
 
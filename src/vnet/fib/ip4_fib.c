@@ -105,7 +105,9 @@ ip4_create_fib_with_table_id (u32 table_id)
 {
     fib_table_t *fib_table;
 
-    pool_get_aligned(ip4_main.fibs, fib_table, CLIB_CACHE_LINE_BYTES);
+    /* the workers index the table pool in ip4-lookup */
+    vlib_worker_thread_pool_get_aligned(ip4_main.fibs, fib_table,
+                                        CLIB_CACHE_LINE_BYTES);
     memset(fib_table, 0, sizeof(*fib_table));
 
     fib_table->ft_proto = FIB_PROTOCOL_IP4;
@@ -184,6 +186,9 @@ ip4_fib_table_destroy (ip4_fib_t *fib)
     {
 	hash_unset (ip4_main.fib_index_by_table_id, fib_table->ft_table_id);
     }
+    /* return the plies of earlier deletes before the pool goes */
+    vlib_worker_thread_epoch_flush(vlib_get_main());
+    ip4_mtrie_free(&fib_table->v4.mtrie);
     pool_put(ip4_main.fibs, fib_table);
 }
 
@@ -321,12 +326,26 @@ ip4_fib_table_entry_insert (ip4_fib_t *fib,
 	/*
 	 * adding a new entry
 	 */
+	vlib_main_t *vm = vlib_get_main();
+	int need_barrier_sync;
+
 	if (NULL == hash) {
 	    hash = hash_create (32 /* elts */, sizeof (uword));
 	    hash_set_flags (hash, HASH_FLAG_NO_AUTO_SHRINK);
 	}
+	/*
+	 * arp-input on the workers does exact-match lookups in these
+	 * hashes; don't resize one under them. This is hash_set's own
+	 * grow-at-3/4 test, taken after the new element is counted.
+	 */
+	need_barrier_sync =
+	    (4 * (hash_elts(hash) + 2) > 3 * vec_len(hash));
+	if (need_barrier_sync)
+	    vlib_worker_thread_barrier_sync(vm);
 	hash = hash_set(hash, key, fib_entry_index);
 	fib->fib_entry_by_dst_address[len] = hash;
+	if (need_barrier_sync)
+	    vlib_worker_thread_barrier_release(vm);
     }
     else
     {
@@ -56,7 +56,9 @@ create_fib_with_table_id (u32 table_id)
 {
     fib_table_t *fib_table;
 
-    pool_get_aligned(ip6_main.fibs, fib_table, CLIB_CACHE_LINE_BYTES);
+    /* the workers index the table pool in ip6-lookup */
+    vlib_worker_thread_pool_get_aligned(ip6_main.fibs, fib_table,
+                                        CLIB_CACHE_LINE_BYTES);
     memset(fib_table, 0, sizeof(*fib_table));
 
     fib_table->ft_proto = FIB_PROTOCOL_IP6;
@@ -73,6 +75,8 @@ create_fib_with_table_id (u32 table_id)
 	fib_table->v6.flow_hash_config =
 	    IP_FLOW_HASH_DEFAULT;
 
+    ip6_fib_mtrie_init(&fib_table->v6.mtrie);
+
     vnet_ip6_fib_init(fib_table->ft_index);
     fib_table_lock(fib_table->ft_index, FIB_PROTOCOL_IP6);
 
@@ -188,6 +192,9 @@ ip6_fib_table_destroy (u32 fib_index)
     {
 	hash_unset (ip6_main.fib_index_by_table_id, fib_table->ft_table_id);
     }
+    /* return the plies of earlier deletes before the pool goes */
+    vlib_worker_thread_epoch_flush(vlib_get_main());
+    ip6_fib_mtrie_free(&fib_table->v6.mtrie);
     pool_put(ip6_main.fibs, fib_table);
 }
 
@@ -337,10 +344,16 @@ ip6_fib_table_entry_insert (u32 fib_index,
     compute_prefix_lengths_in_search_order (table);
 }
 
-u32 
-ip6_fib_table_fwding_lookup (ip6_main_t * im,
-                             u32 fib_index,
-                             const ip6_address_t * dst)
+/**
+ * @brief Longest prefix match in the forwarding hash, considering only
+ * prefixes shorter than max_len. Returns the load-balance index and the
+ * length of the matching prefix, or ~0 if there is no match.
+ */
+static u32
+ip6_fib_table_fwding_hash_lookup (u32 fib_index,
+                                  const ip6_address_t * dst,
+                                  u32 max_len,
+                                  u32 * match_len)
 {
     const ip6_fib_table_instance_t *table;
     int i, len;
@@ -361,6 +374,9 @@ ip6_fib_table_fwding_lookup (ip6_main_t * im,
 	ip6_address_t * mask = &ip6_main.fib_masks[dst_address_length];
       
 	ASSERT(dst_address_length >= 0 && dst_address_length <= 128);
+	if (dst_address_length >= max_len)
+	    continue;
+
 	//As lengths are decreasing, masks are increasingly specific.
 	kv.key[0] &= mask->as_u64[0];
 	kv.key[1] &= mask->as_u64[1];
@@ -368,12 +384,27 @@ ip6_fib_table_fwding_lookup (ip6_main_t * im,
       
 	rv = BV(clib_bihash_search_inline_2)(&table->ip6_hash, &kv, &value);
 	if (rv == 0)
+	{
+	    *match_len = dst_address_length;
 	    return value.value;
+	}
     }
 
+    return (~0);
+}
+
+u32 
+ip6_fib_table_fwding_lookup_hash (ip6_main_t * im,
+                                  u32 fib_index,
+                                  const ip6_address_t * dst)
+{
+    u32 lbi, len;
+
+    lbi = ip6_fib_table_fwding_hash_lookup(fib_index, dst, 129, &len);
+
     /* default route is always present */
-    ASSERT(0);
-    return 0;
+    ASSERT(~0 != lbi);
+    return (lbi);
 }
 
 u32 ip6_fib_table_fwding_lookup_with_if_index (ip6_main_t * im,
@@ -432,6 +463,9 @@ ip6_fib_table_fwding_dpo_update (u32 fib_index,
         clib_bitmap_set (table->non_empty_dst_address_length_bitmap, 
 			 128 - len, 1);
     compute_prefix_lengths_in_search_order (table);
+
+    ip6_fib_mtrie_add_del_route(fib_index, addr, len, dpo->dpoi_index,
+                                0 /* is_del */, 0, 0);
 }
 
 void
@@ -443,6 +477,7 @@ ip6_fib_table_fwding_dpo_remove (u32 fib_index,
     ip6_fib_table_instance_t *table;
     BVT(clib_bihash_kv) kv;
     ip6_address_t *mask;
+    u32 cover_lbi, cover_len;
     u64 fib;
 
     table = &ip6_main.ip6_table[IP6_FIB_TABLE_FWDING];
@@ -465,6 +500,22 @@ ip6_fib_table_fwding_dpo_remove (u32 fib_index,
                              128 - len, 0);
 	compute_prefix_lengths_in_search_order (table);
     }
+
+    /*
+     * the mtrie re-populates the removed prefix's slots with its
+     * next less specific prefix, taken from the forwarding hash.
+     */
+    cover_len = 0;
+    cover_lbi = 0;
+    if (len > 0)
+    {
+	cover_lbi = ip6_fib_table_fwding_hash_lookup(fib_index, addr,
+                                                     len, &cover_len);
+	if (~0 == cover_lbi)
+	    cover_len = 0;
+    }
+    ip6_fib_mtrie_add_del_route(fib_index, addr, len, dpo->dpoi_index,
+                                1 /* is_del */, cover_len, cover_lbi);
 }
 
 /**
@@ -588,13 +639,14 @@ ip6_show_fib (vlib_main_t * vm,
     ip6_main_t * im6 = &ip6_main;
     fib_table_t *fib_table;
     ip6_fib_t * fib;
-    int verbose, matching;
+    int verbose, matching, mtrie;
     ip6_address_t matching_address;
     u32 mask_len  = 128;
     int table_id = -1, fib_index = ~0;
 
     verbose = 1;
     matching = 0;
+    mtrie = 0;
 
     while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
@@ -614,6 +666,8 @@ ip6_show_fib (vlib_main_t * vm,
 	    ;
 	else if (unformat (input, "index %d", &fib_index))
 	    ;
+	else if (unformat (input, "mtrie"))
+	    mtrie = 1;
 	else
 	    break;
     }
@@ -630,6 +684,9 @@ ip6_show_fib (vlib_main_t * vm,
 			 fib_table->ft_desc, fib->index,
 			 format_ip_flow_hash_config, fib->flow_hash_config);
 
+	if (mtrie)
+	    vlib_cli_output (vm, "%U", format_ip6_fib_mtrie, &fib->mtrie);
+
 	/* Show summary? */
 	if (! verbose)
 	{
@@ -763,7 +820,7 @@ ip6_show_fib (vlib_main_t * vm,
 /* *INDENT-OFF* */
 VLIB_CLI_COMMAND (ip6_show_fib_command, static) = {
     .path = "show ip6 fib",
-    .short_help = "show ip6 fib [summary] [table <table-id>] [index <fib-id>] [<ip6-addr>[/<width>]]",
+    .short_help = "show ip6 fib [summary] [table <table-id>] [index <fib-id>] [<ip6-addr>[/<width>]] [mtrie]",
     .function = ip6_show_fib,
 };
 /* *INDENT-ON* */
@@ -53,9 +53,13 @@ extern void ip6_fib_table_fwding_dpo_remove(u32 fib_index,
 u32 ip6_fib_table_fwding_lookup_with_if_index(ip6_main_t * im,
 					      u32 sw_if_index,
 					      const ip6_address_t * dst);
-u32 ip6_fib_table_fwding_lookup(ip6_main_t * im,
-				u32 fib_index,
-				const ip6_address_t * dst);
+/**
+ * @brief Forwarding lookup using the per-prefix-length hash probes.
+ * The reference the mtrie lookup is validated and benchmarked against.
+ */
+u32 ip6_fib_table_fwding_lookup_hash(ip6_main_t * im,
+				     u32 fib_index,
+				     const ip6_address_t * dst);
 
 /**
  * @brief Walk all entries in a FIB table
@@ -131,6 +135,17 @@ u32 ip6_fib_index_from_table_id (u32 table_id)
   return p[0];
 }
 
+/**
+ * @brief Forwarding lookup; returns the load-balance index.
+ */
+always_inline u32
+ip6_fib_table_fwding_lookup (ip6_main_t * im,
+			     u32 fib_index,
+			     const ip6_address_t * dst)
+{
+    return (ip6_fib_mtrie_lookup(&ip6_fib_get(fib_index)->mtrie, dst));
+}
+
 extern u32 ip6_fib_table_get_index_for_sw_if_index(u32 sw_if_index);
 
 extern flow_hash_config_t ip6_fib_table_get_flow_hash_config(u32 fib_index);
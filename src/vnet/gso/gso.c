@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vnet/gso/gso.h>
+#include <vnet/ip/ip.h>
+#include <vnet/tcp/tcp_packet.h>
+#include <vnet/feature/feature.h>
+
+gso_main_t gso_main;
+
+/* Flags segments inherit from the super-segment */
+#define GSO_SEG_FLAGS_COPY (VNET_BUFFER_LOCALLY_ORIGINATED | ETH_BUFFER_VLAN_BITS)
+
+#define foreach_gso_error					\
+_(SEGMENTED, "super-segments segmented")			\
+_(SEGMENTS, "segments built")					\
+_(NO_BUFFERS, "no buffers to segment super-segment")
+
+typedef enum
+{
+#define _(sym,str) GSO_ERROR_##sym,
+  foreach_gso_error
+#undef _
+    GSO_N_ERROR,
+} gso_error_t;
+
+static char *gso_error_strings[] = {
+#define _(sym,string) string,
+  foreach_gso_error
+#undef _
+};
+
+typedef enum
+{
+  GSO_NEXT_DROP,
+  GSO_N_NEXT,
+} gso_next_t;
+
+typedef struct
+{
+  u32 flags;
+  u16 gso_size;
+  u16 n_segs;
+} gso_trace_t;
+
+static u8 *
+format_gso_trace (u8 * s, va_list * args)
+{
+  CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
+  CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
+  gso_trace_t *t = va_arg (*args, gso_trace_t *);
+
+  if (!(t->flags & VNET_BUFFER_GSO))
+    return format (s, "gso: not a super-segment");
+  if (t->n_segs == 0)
+    return format (s, "gso: super-segment, gso_size %u, to device",
+		   t->gso_size);
+  return format (s, "gso: super-segment, gso_size %u, %u segments",
+		 t->gso_size, t->n_segs);
+}
+
+/**
+ * Cut a super-segment into gso_size segments.
+ *
+ * Headers, l2 rewrite included, are copied from the super-segment and
+ * fixed up. TCP checksums start from a sum of the pseudo and tcp headers
+ * taken once per super-segment plus the payload sum computed while
+ * copying. Once folded into a checksum, it's updated for the fields that
+ * differ per segment.
+ *
+ * Returns the number of segments appended to segs, 0 if out of buffers.
+ */
+u32
+gso_segment_buffer (vlib_main_t * vm, gso_main_t * gm, vlib_buffer_t * b0,
+		    u32 ** segs)
+{
+  vnet_buffer_opaque2_t *o2 = vnet_buffer2 (b0);
+  u32 thread_index = vm->cpu_index;
+  u32 hdr_sz, l3_sz, l4_sz, l3_off, gso_size, n_bytes, n_segs, n_bufs;
+  u32 src_left, seg_len, n_left, n_copy, seq0, bi, i, *bufs;
+  u8 *hdr, *src, *dst, tcp_flags, seg_flags;
+  ip_csum_t hdr_sum, sum, csum;
+  tcp_header_t *th0, *th;
+  vlib_buffer_t *sb, *nb;
+  u16 ip_id0 = 0;
+
+  hdr = vlib_buffer_get_current (b0);
+  l3_off = o2->gso.l3_hdr_offset - b0->current_data;
+  l3_sz = o2->gso.l4_hdr_offset - o2->gso.l3_hdr_offset;
+  l4_sz = o2->gso.l4_hdr_sz;
+  hdr_sz = l3_off + l3_sz + l4_sz;
+  gso_size = o2->gso.gso_size;
+  n_bytes = vlib_buffer_length_in_chain (vm, b0) - hdr_sz;
+  n_segs = (n_bytes + gso_size - 1) / gso_size;
+
+  ASSERT (hdr_sz <= b0->current_length);
+  ASSERT (hdr_sz <= VNET_GSO_MAX_HDR_BYTES);
+  ASSERT (hdr_sz + gso_size <= VLIB_BUFFER_DATA_SIZE);
+
+  /* Grab buffers for all segments up front */
+  bufs = gm->seg_buffers[thread_index];
+  n_bufs = vec_len (bufs);
+  if (PREDICT_FALSE (n_bufs < n_segs))
+    {
+      vec_validate (bufs, n_segs + VLIB_FRAME_SIZE - 1);
+      n_bufs += vlib_buffer_alloc (vm, &bufs[n_bufs],
+				   n_segs + VLIB_FRAME_SIZE - n_bufs);
+      _vec_len (bufs) = n_bufs;
+      gm->seg_buffers[thread_index] = bufs;
+      if (n_bufs < n_segs)
+	return 0;
+    }
+
+  /* Template header, FIN and PSH only go out with the last segment */
+  th0 = (tcp_header_t *) (hdr + hdr_sz - l4_sz);
+  tcp_flags = th0->flags;
+  seg_flags = tcp_flags & ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+  seq0 = th0->seq_number;
+  th0->flags = seg_flags;
+  th0->checksum = 0;
+
+  if (o2->gso.is_ip4)
+    {
+      ip4_header_t *ip4 = (ip4_header_t *) (hdr + l3_off);
+      ip_id0 = clib_net_to_host_u16 (ip4->fragment_id);
+      hdr_sum = clib_host_to_net_u16 (ip4->protocol);
+      hdr_sum = ip_csum_with_carry (hdr_sum, ip4->src_address.as_u32);
+      hdr_sum = ip_csum_with_carry (hdr_sum, ip4->dst_address.as_u32);
+    }
+  else
+    {
+      ip6_header_t *ip6 = (ip6_header_t *) (hdr + l3_off);
+      hdr_sum = clib_host_to_net_u16 (ip6->protocol);
+      for (i = 0; i < ARRAY_LEN (ip6->src_address.as_uword); i++)
+	{
+	  hdr_sum = ip_csum_with_carry
+	    (hdr_sum, clib_mem_unaligned (&ip6->src_address.as_uword[i],
+					  uword));
+	  hdr_sum = ip_csum_with_carry
+	    (hdr_sum, clib_mem_unaligned (&ip6->dst_address.as_uword[i],
+					  uword));
+	}
+    }
+  hdr_sum = ip_incremental_checksum (hdr_sum, th0, l4_sz);
+
+  sb = b0;
+  src = hdr + hdr_sz;
+  src_left = b0->current_length - hdr_sz;
+
+  for (i = 0; i < n_segs; i++)
+    {
+      bi = bufs[--n_bufs];
+      nb = vlib_get_buffer (vm, bi);
+      seg_len = clib_min (gso_size, n_bytes);
+      n_bytes -= seg_len;
+
+      nb->current_data = 0;
+      nb->current_length = hdr_sz + seg_len;
+      nb->total_length_not_including_first_buffer = 0;
+      nb->flags = VLIB_BUFFER_TOTAL_LENGTH_VALID
+	| (b0->flags & GSO_SEG_FLAGS_COPY);
+      nb->error = b0->error;
+      nb->feature_arc_index = b0->feature_arc_index;
+      nb->current_config_index = b0->current_config_index;
+      clib_memcpy (nb->opaque, b0->opaque, sizeof (b0->opaque));
+
+      dst = nb->data;
+      clib_memcpy (dst, hdr, hdr_sz);
+      dst += hdr_sz;
+
+      /* Payload, checksummed as it's copied */
+      sum = 0;
+      n_left = seg_len;
+      while (n_left)
+	{
+	  if (src_left == 0)
+	    {
+	      ASSERT (sb->flags & VLIB_BUFFER_NEXT_PRESENT);
+	      sb = vlib_get_buffer (vm, sb->next_buffer);
+	      src = vlib_buffer_get_current (sb);
+	      src_left = sb->current_length;
+	      continue;
+	    }
+	  n_copy = clib_min (n_left, src_left);
+	  sum = ip_csum_and_memcpy (sum, dst, src, n_copy);
+	  dst += n_copy;
+	  src += n_copy;
+	  src_left -= n_copy;
+	  n_left -= n_copy;
+	}
+
+      if (o2->gso.is_ip4)
+	{
+	  ip4_header_t *ip4 = (ip4_header_t *) (nb->data + l3_off);
+	  ip4->length = clib_host_to_net_u16 (l3_sz + l4_sz + seg_len);
+	  ip4->fragment_id = clib_host_to_net_u16 (ip_id0 + i);
+	  ip4->checksum = ip4_header_checksum (ip4);
+	}
+      else
+	{
+	  ip6_header_t *ip6 = (ip6_header_t *) (nb->data + l3_off);
+	  ip6->payload_length = clib_host_to_net_u16 (l4_sz + seg_len);
+	}
+
+      th = (tcp_header_t *) (nb->data + hdr_sz - l4_sz);
+      th->seq_number = clib_host_to_net_u32 (clib_net_to_host_u32 (seq0)
+					     + i * gso_size);
+      sum = ip_csum_with_carry (sum, hdr_sum);
+      sum = ip_csum_with_carry (sum, clib_host_to_net_u16 (l4_sz + seg_len));
+
+      /* ip_csum_update works on a checksum, not on the raw sum */
+      csum = (u16) ~ ip_csum_fold (sum);
+      csum = ip_csum_update (csum, seq0, th->seq_number, tcp_header_t,
+			     seq_number);
+      if (n_bytes == 0 && tcp_flags != seg_flags)
+	{
+	  th->flags = tcp_flags;
+	  csum = ip_csum_update (csum, seg_flags, tcp_flags, tcp_header_t,
+				 flags);
+	}
+      th->checksum = ip_csum_fold (csum);
+
+      vec_add1 (*segs, bi);
+    }
+
+  _vec_len (bufs) = n_bufs;
+  return n_segs;
+}
+
+static uword
+gso_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
+	     vlib_frame_t * frame)
+{
+  gso_main_t *gm = &gso_main;
+  vnet_main_t *vnm = gm->vnet_main;
+  u32 n_left_from, *from, *to_next, next_index, n_left_to_next;
+  u32 n_segmented = 0, n_segments = 0;
+  u32 *segs = 0;
+
+  from = vlib_frame_vector_args (frame);
+  n_left_from = frame->n_vectors;
+  next_index = node->cached_next_index;
+
+  while (n_left_from > 0)
+    {
+      vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+
+      while (n_left_from > 0 && n_left_to_next > 0)
+	{
+	  u32 bi0, next0, n_segs0 = 0, i;
+	  vlib_buffer_t *b0;
+	  vnet_hw_interface_t *hi0;
+
+	  bi0 = from[0];
+	  from += 1;
+	  n_left_from -= 1;
+
+	  b0 = vlib_get_buffer (vm, bi0);
+	  vnet_feature_next (vnet_buffer (b0)->sw_if_index[VLIB_TX], &next0,
+			     b0);
+
+	  if (PREDICT_TRUE (!(b0->flags & VNET_BUFFER_GSO)))
+	    goto pass;
+
+	  hi0 = vnet_get_sup_hw_interface (vnm,
+					   vnet_buffer (b0)->sw_if_index
+					   [VLIB_TX]);
+	  if (hi0->flags & VNET_HW_INTERFACE_FLAG_SUPPORTS_GSO)
+	    goto pass;
+
+	  vec_reset_length (segs);
+	  n_segs0 = gso_segment_buffer (vm, gm, b0, &segs);
+
+	  if (PREDICT_FALSE (b0->flags & VLIB_BUFFER_IS_TRACED))
+	    {
+	      gso_trace_t *t = vlib_add_trace (vm, node, b0, sizeof (*t));
+	      t->flags = b0->flags;
+	      t->gso_size = vnet_buffer2 (b0)->gso.gso_size;
+	      t->n_segs = n_segs0;
+	    }
+
+	  if (PREDICT_FALSE (n_segs0 == 0))
+	    {
+	      b0->error = node->errors[GSO_ERROR_NO_BUFFERS];
+	      next0 = GSO_NEXT_DROP;
+	      goto enqueue;
+	    }
+
+	  /* Super-segment done with, send segments on their way */
+	  vlib_buffer_free (vm, &bi0, 1);
+	  n_segmented += 1;
+	  n_segments += n_segs0;
+	  for (i = 0; i < n_segs0; i++)
+	    {
+	      if (PREDICT_FALSE (n_left_to_next == 0))
+		{
+		  vlib_put_next_frame (vm, node, next_index, 0);
+		  vlib_get_next_frame (vm, node, next_index, to_next,
+				       n_left_to_next);
+		}
+	      to_next[0] = segs[i];
+	      to_next += 1;
+	      n_left_to_next -= 1;
+	      vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+					       n_left_to_next, segs[i], next0);
+	    }
+	  continue;
+
+	pass:
+	  if (PREDICT_FALSE (b0->flags & VLIB_BUFFER_IS_TRACED))
+	    {
+	      gso_trace_t *t = vlib_add_trace (vm, node, b0, sizeof (*t));
+	      t->flags = b0->flags;
+	      t->gso_size = vnet_buffer2 (b0)->gso.gso_size;
+	      t->n_segs = 0;
+	    }
+
+	enqueue:
+	  to_next[0] = bi0;
+	  to_next += 1;
+	  n_left_to_next -= 1;
+	  vlib_validate_buffer_enqueue_x1 (vm, node, next_index, to_next,
+					   n_left_to_next, bi0, next0);
+	}
+
+      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+    }
+
+  vec_free (segs);
+  vlib_node_increment_counter (vm, node->node_index, GSO_ERROR_SEGMENTED,
+			       n_segmented);
+  vlib_node_increment_counter (vm, node->node_index, GSO_ERROR_SEGMENTS,
+			       n_segments);
+  return frame->n_vectors;
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (gso_node) = {
+  .function = gso_node_fn,
+  .name = "gso",
+  .vector_size = sizeof (u32),
+  .format_trace = format_gso_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = GSO_N_ERROR,
+  .error_strings = gso_error_strings,
+  .n_next_nodes = GSO_N_NEXT,
+  .next_nodes = {
+    [GSO_NEXT_DROP] = "error-drop",
+  },
+};
+
+VLIB_NODE_FUNCTION_MULTIARCH (gso_node, gso_node_fn);
+
+VNET_FEATURE_INIT (gso_tx, static) = {
+  .arc_name = "interface-output",
+  .node_name = "gso",
+  .runs_before = VNET_FEATURES ("span-output", "interface-tx"),
+};
+/* *INDENT-ON* */
+
+/**
+ * Enable or disable segmentation of super-segments on all interfaces.
+ *
+ * Interfaces created while enabled get the feature when they're added.
+ */
+clib_error_t *
+vnet_gso_enable_disable (vlib_main_t * vm, u8 is_enable)
+{
+  gso_main_t *gm = &gso_main;
+  vnet_interface_main_t *im = &gm->vnet_main->interface_main;
+  vnet_sw_interface_t *si;
+
+  is_enable = is_enable != 0;
+  if (gm->is_enabled == is_enable)
+    return 0;
+
+  gm->is_enabled = is_enable;
+
+  /* *INDENT-OFF* */
+  pool_foreach (si, im->sw_interfaces, ({
+    vnet_feature_enable_disable ("interface-output", "gso", si->sw_if_index,
+				 is_enable, 0, 0);
+  }));
+  /* *INDENT-ON* */
+
+  return 0;
+}
+
+static clib_error_t *
+gso_sw_interface_add_del (vnet_main_t * vnm, u32 sw_if_index, u32 is_add)
+{
+  gso_main_t *gm = &gso_main;
+
+  if (gm->is_enabled)
+    vnet_feature_enable_disable ("interface-output", "gso", sw_if_index,
+				 is_add, 0, 0);
+  return 0;
+}
+
+VNET_SW_INTERFACE_ADD_DEL_FUNCTION (gso_sw_interface_add_del);
+
+static clib_error_t *
+gso_init (vlib_main_t * vm)
+{
+  gso_main_t *gm = &gso_main;
+  vlib_thread_main_t *vtm = vlib_get_thread_main ();
+
+  gm->vlib_main = vm;
+  gm->vnet_main = vnet_get_main ();
+  vec_validate (gm->seg_buffers, vtm->n_vlib_mains - 1);
+
+  return 0;
+}
+
+VLIB_INIT_FUNCTION (gso_init);
+
+static clib_error_t *
+gso_enable_disable_command_fn (vlib_main_t * vm, unformat_input_t * input,
+			       vlib_cli_command_t * cmd)
+{
+  u8 is_enable = 1;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "enable"))
+	is_enable = 1;
+      else if (unformat (input, "disable"))
+	is_enable = 0;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  return vnet_gso_enable_disable (vm, is_enable);
+}
+
+/*?
+ * Segment TCP super-segments in software on interfaces whose devices
+ * can't do it themselves. Needed for tcp large-send.
+ *
+ * @cliexpar
+ * @cliexcmd{set gso enable}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (gso_enable_disable_command, static) = {
+  .path = "set gso",
+  .short_help = "set gso [enable|disable]",
+  .function = gso_enable_disable_command_fn,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
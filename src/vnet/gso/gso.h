@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_vnet_gso_h
+#define included_vnet_gso_h
+
+#include <vnet/vnet.h>
+
+/**
+ * Generic segmentation offload.
+ *
+ * Locally originated TCP super-segments, flagged VNET_BUFFER_GSO, travel
+ * the ip stack as a single buffer chain. The gso node, a feature on the
+ * interface-output arc, cuts them into gso_size segments unless the
+ * output device advertises VNET_HW_INTERFACE_FLAG_SUPPORTS_GSO, in which
+ * case the super-segment is handed to the device as is.
+ */
+
+/** Room for l2, l3 and l4 headers a segment must leave in its buffer */
+#define VNET_GSO_MAX_HDR_BYTES 128
+
+typedef struct
+{
+  /** Feature enabled on all interfaces */
+  u8 is_enabled;
+
+  /** Per-thread cache of buffers for segments */
+  u32 **seg_buffers;
+
+  vlib_main_t *vlib_main;
+  vnet_main_t *vnet_main;
+} gso_main_t;
+
+extern gso_main_t gso_main;
+extern vlib_node_registration_t gso_node;
+
+clib_error_t *vnet_gso_enable_disable (vlib_main_t * vm, u8 is_enable);
+u32 gso_segment_buffer (vlib_main_t * vm, gso_main_t * gm,
+			vlib_buffer_t * b0, u32 ** segs);
+
+always_inline u8
+vnet_gso_is_enabled (void)
+{
+  return gso_main.is_enabled;
+}
+
+/**
+ * Bytes, l3 header included, of the largest packet the buffer turns into
+ * on the wire. Used instead of the chain length for mtu checks.
+ */
+always_inline u32
+vnet_gso_l3_packet_bytes (vlib_main_t * vm, vlib_buffer_t * b)
+{
+  vnet_buffer_opaque2_t *o2;
+
+  if (PREDICT_TRUE (!(b->flags & VNET_BUFFER_GSO)))
+    return vlib_buffer_length_in_chain (vm, b);
+
+  o2 = vnet_buffer2 (b);
+  return o2->gso.l4_hdr_offset - o2->gso.l3_hdr_offset + o2->gso.l4_hdr_sz
+    + o2->gso.gso_size;
+}
+
+#endif /* included_vnet_gso_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
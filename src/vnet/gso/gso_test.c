@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vnet/gso/gso.h>
+#include <vnet/ip/ip.h>
+#include <vnet/tcp/tcp_packet.h>
+#include <vnet/tcp/tcp.h>
+
+#define GSO_TEST_I(_cond, _comment, _args...)			\
+({								\
+  int _evald = (_cond);						\
+  if (!(_evald)) {						\
+    fformat(stderr, "FAIL:%d: " _comment "\n",			\
+	    __LINE__, ##_args);					\
+  } else {							\
+    fformat(stderr, "PASS:%d: " _comment "\n",			\
+	    __LINE__, ##_args);					\
+  }								\
+  _evald;							\
+})
+
+#define GSO_TEST(_cond, _comment, _args...)			\
+{								\
+  if (!GSO_TEST_I(_cond, _comment, ##_args)) {			\
+    return 1;							\
+  }								\
+}
+
+#define GSO_TEST_SEQ0 0xfffff800	/* segments wrap the sequence space */
+#define GSO_TEST_IP_ID0 0xfffe
+
+static u8
+gso_test_payload_byte (u32 offset)
+{
+  return (offset * 7 + 3) & 0xff;
+}
+
+/**
+ * Build a super-segment of n_bytes payload as a buffer chain, chunk
+ * payload bytes per buffer, so segments straddle buffer boundaries.
+ */
+static int
+gso_test_super_segment (vlib_main_t * vm, u8 is_ip4, u8 tcp_flags,
+			u32 n_bytes, u32 chunk, u16 gso_size, u32 * bi0)
+{
+  u32 bufs[16], n_bufs, hdr_sz, l3_sz, i, j, offset = 0;
+  vnet_buffer_opaque2_t *o2;
+  vlib_buffer_t *b, *prev = 0, *b0;
+  tcp_header_t *th;
+  u8 *data;
+
+  l3_sz = is_ip4 ? sizeof (ip4_header_t) : sizeof (ip6_header_t);
+  hdr_sz = l3_sz + sizeof (tcp_header_t);
+  n_bufs = (n_bytes + chunk - 1) / chunk;
+  ASSERT (n_bufs <= ARRAY_LEN (bufs));
+  if (vlib_buffer_alloc (vm, bufs, n_bufs) != n_bufs)
+    return 1;
+
+  b0 = vlib_get_buffer (vm, bufs[0]);
+  for (i = 0; i < n_bufs; i++)
+    {
+      b = vlib_get_buffer (vm, bufs[i]);
+      b->current_data = 0;
+      b->current_length = clib_min (chunk, n_bytes - offset);
+      b->flags = 0;
+      data = b->data;
+      if (i == 0)
+	{
+	  b->current_length += hdr_sz;
+	  data += hdr_sz;
+	}
+      for (j = 0; j < clib_min (chunk, n_bytes - offset); j++)
+	data[j] = gso_test_payload_byte (offset + j);
+      offset += j;
+      if (prev)
+	{
+	  prev->flags |= VLIB_BUFFER_NEXT_PRESENT;
+	  prev->next_buffer = bufs[i];
+	}
+      prev = b;
+    }
+  b0->flags |= VNET_BUFFER_GSO | VLIB_BUFFER_TOTAL_LENGTH_VALID;
+  b0->total_length_not_including_first_buffer =
+    vlib_buffer_length_in_chain (vm, b0) - b0->current_length;
+
+  if (is_ip4)
+    {
+      ip4_header_t *ip4 = (ip4_header_t *) b0->data;
+      memset (ip4, 0, sizeof (*ip4));
+      ip4->ip_version_and_header_length = 0x45;
+      ip4->ttl = 64;
+      ip4->protocol = IP_PROTOCOL_TCP;
+      ip4->fragment_id = clib_host_to_net_u16 (GSO_TEST_IP_ID0);
+      ip4->length = clib_host_to_net_u16 (hdr_sz + n_bytes);
+      ip4->src_address.as_u32 = clib_host_to_net_u32 (0x0a000001);
+      ip4->dst_address.as_u32 = clib_host_to_net_u32 (0x0a000002);
+      ip4->checksum = ip4_header_checksum (ip4);
+    }
+  else
+    {
+      ip6_header_t *ip6 = (ip6_header_t *) b0->data;
+      memset (ip6, 0, sizeof (*ip6));
+      ip6->ip_version_traffic_class_and_flow_label =
+	clib_host_to_net_u32 (0x6 << 28);
+      ip6->hop_limit = 64;
+      ip6->protocol = IP_PROTOCOL_TCP;
+      ip6->payload_length =
+	clib_host_to_net_u16 (sizeof (tcp_header_t) + n_bytes);
+      ip6->src_address.as_u64[0] = clib_host_to_net_u64 (0x20010db8ULL << 32);
+      ip6->src_address.as_u64[1] = clib_host_to_net_u64 (1);
+      ip6->dst_address.as_u64[0] = clib_host_to_net_u64 (0x20010db8ULL << 32);
+      ip6->dst_address.as_u64[1] = clib_host_to_net_u64 (2);
+    }
+
+  th = (tcp_header_t *) (b0->data + l3_sz);
+  memset (th, 0, sizeof (*th));
+  th->src_port = clib_host_to_net_u16 (1234);
+  th->dst_port = clib_host_to_net_u16 (80);
+  th->seq_number = clib_host_to_net_u32 (GSO_TEST_SEQ0);
+  th->ack_number = clib_host_to_net_u32 (0x12345678);
+  th->data_offset_and_reserved = (sizeof (*th) / 4) << 4;
+  th->flags = tcp_flags;
+  th->window = clib_host_to_net_u16 (65535);
+
+  o2 = vnet_buffer2 (b0);
+  o2->gso.l3_hdr_offset = 0;
+  o2->gso.l4_hdr_offset = l3_sz;
+  o2->gso.l4_hdr_sz = sizeof (tcp_header_t);
+  o2->gso.gso_size = gso_size;
+  o2->gso.is_ip4 = is_ip4;
+
+  *bi0 = bufs[0];
+  return 0;
+}
+
+/**
+ * Segment a super-segment and check every segment as a receiver would:
+ * lengths, ip and tcp checksums, sequence numbers, flags and payload.
+ */
+static int
+gso_test_segment (vlib_main_t * vm, u8 is_ip4, u8 tcp_flags, u32 n_bytes,
+		  u32 chunk, u16 gso_size)
+{
+  u32 bi0, i, j, seg_len, n_segs, hdr_sz, l3_sz, offset, *segs = 0;
+  u8 last_flags, seg_flags, *payload;
+  vlib_buffer_t *nb;
+  tcp_header_t *th;
+  u16 csum, want;
+  int bogus = 0;
+
+  l3_sz = is_ip4 ? sizeof (ip4_header_t) : sizeof (ip6_header_t);
+  hdr_sz = l3_sz + sizeof (tcp_header_t);
+  GSO_TEST ((gso_test_super_segment (vm, is_ip4, tcp_flags, n_bytes, chunk,
+				     gso_size, &bi0) == 0),
+	    "%s super-segment of %u bytes built", is_ip4 ? "ip4" : "ip6",
+	    n_bytes);
+
+  n_segs = gso_segment_buffer (vm, &gso_main, vlib_get_buffer (vm, bi0),
+			       &segs);
+  vlib_buffer_free (vm, &bi0, 1);
+  GSO_TEST ((n_segs == (n_bytes + gso_size - 1) / gso_size),
+	    "%u segments of %u bytes", n_segs, gso_size);
+
+  seg_flags = tcp_flags & ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+  for (i = 0; i < n_segs; i++)
+    {
+      nb = vlib_get_buffer (vm, segs[i]);
+      offset = i * gso_size;
+      seg_len = clib_min (gso_size, n_bytes - offset);
+      GSO_TEST ((nb->current_length == hdr_sz + seg_len
+		 && !(nb->flags & VLIB_BUFFER_NEXT_PRESENT)),
+		"segment %u is %u bytes in one buffer", i,
+		nb->current_length);
+
+      th = (tcp_header_t *) (nb->data + l3_sz);
+      if (is_ip4)
+	{
+	  ip4_header_t *ip4 = (ip4_header_t *) nb->data;
+	  GSO_TEST ((ip4_header_checksum_is_valid (ip4)),
+		    "segment %u ip4 checksum 0x%04x valid", i,
+		    clib_net_to_host_u16 (ip4->checksum));
+	  GSO_TEST ((clib_net_to_host_u16 (ip4->length) == hdr_sz + seg_len),
+		    "segment %u ip4 length %u", i,
+		    clib_net_to_host_u16 (ip4->length));
+	  GSO_TEST ((clib_net_to_host_u16 (ip4->fragment_id)
+		     == (u16) (GSO_TEST_IP_ID0 + i)),
+		    "segment %u ip4 id %u", i,
+		    clib_net_to_host_u16 (ip4->fragment_id));
+	  csum = th->checksum;
+	  th->checksum = 0;
+	  want = ip4_tcp_udp_compute_checksum (vm, nb, ip4);
+	  th->checksum = csum;
+	  GSO_TEST ((ip4_tcp_udp_compute_checksum (vm, nb, ip4) == 0),
+		    "segment %u tcp checksum 0x%04x, expected 0x%04x", i,
+		    clib_net_to_host_u16 (csum), clib_net_to_host_u16 (want));
+	}
+      else
+	{
+	  ip6_header_t *ip6 = (ip6_header_t *) nb->data;
+	  GSO_TEST ((clib_net_to_host_u16 (ip6->payload_length)
+		     == sizeof (tcp_header_t) + seg_len),
+		    "segment %u ip6 payload length %u", i,
+		    clib_net_to_host_u16 (ip6->payload_length));
+	  csum = th->checksum;
+	  th->checksum = 0;
+	  want = ip6_tcp_udp_icmp_compute_checksum (vm, nb, ip6, &bogus);
+	  th->checksum = csum;
+	  GSO_TEST ((ip6_tcp_udp_icmp_compute_checksum (vm, nb, ip6, &bogus)
+		     == 0 && !bogus),
+		    "segment %u tcp checksum 0x%04x, expected 0x%04x", i,
+		    clib_net_to_host_u16 (csum), clib_net_to_host_u16 (want));
+	}
+
+      GSO_TEST ((clib_net_to_host_u32 (th->seq_number)
+		 == (u32) (GSO_TEST_SEQ0 + offset)),
+		"segment %u seq %u", i, clib_net_to_host_u32 (th->seq_number));
+      last_flags = i == n_segs - 1 ? tcp_flags : seg_flags;
+      GSO_TEST ((th->flags == last_flags), "segment %u flags 0x%02x", i,
+		th->flags);
+
+      payload = nb->data + hdr_sz;
+      for (j = 0; j < seg_len; j++)
+	if (payload[j] != gso_test_payload_byte (offset + j))
+	  break;
+      GSO_TEST ((j == seg_len), "segment %u payload intact", i);
+    }
+
+  vlib_buffer_free (vm, segs, vec_len (segs));
+  vec_free (segs);
+  return 0;
+}
+
+static int
+gso_test_all (vlib_main_t * vm)
+{
+  u8 flags = TCP_FLAG_ACK | TCP_FLAG_PSH | TCP_FLAG_FIN;
+
+  /* Short last segment carrying PSH and FIN */
+  if (gso_test_segment (vm, 1, flags, 3957, 1500, 1000))
+    return 1;
+  if (gso_test_segment (vm, 0, flags, 3957, 1500, 1000))
+    return 1;
+  /* Full segments only, flags unchanged */
+  if (gso_test_segment (vm, 1, TCP_FLAG_ACK, 8 * 1448, 1900, 1448))
+    return 1;
+  if (gso_test_segment (vm, 0, TCP_FLAG_ACK, 8 * 1448, 1900, 1448))
+    return 1;
+  return 0;
+}
+
+/**
+ * Connections to our own addresses reach ip4-local or ip6-local, where
+ * nothing segments super-segments, so tcp must not build them. Needs tcp
+ * large-send, and lcl configured on an interface, rmt reachable.
+ */
+static int
+gso_test_local_peer (vlib_main_t * vm, ip46_address_t * lcl,
+		     ip46_address_t * rmt, u8 is_ip4)
+{
+  tcp_main_t *tm = vnet_get_tcp_main ();
+  tcp_connection_t _tc, *tc = &_tc;
+
+  GSO_TEST (tm->large_send && vnet_gso_is_enabled (),
+	    "tcp large-send configured");
+
+  memset (tc, 0, sizeof (*tc));
+  tc->c_is_ip4 = is_ip4;
+  tc->snd_mss = 1448;
+
+  tc->c_rmt_ip = *rmt;
+  GSO_TEST (!tcp_connection_rmt_is_local (tc), "peer %U is not local",
+	    format_ip46_address, rmt, IP46_TYPE_ANY);
+  GSO_TEST (tcp_session_send_gso_size (&tc->connection) > tc->snd_mss,
+	    "super-segments to %U", format_ip46_address, rmt, IP46_TYPE_ANY);
+
+  tc->c_rmt_ip = *lcl;
+  GSO_TEST (tcp_connection_rmt_is_local (tc), "peer %U is local",
+	    format_ip46_address, lcl, IP46_TYPE_ANY);
+  tc->flags |= TCP_CONN_RMT_LOCAL;
+  GSO_TEST (tcp_session_send_gso_size (&tc->connection) == 0,
+	    "no super-segments to %U", format_ip46_address, lcl,
+	    IP46_TYPE_ANY);
+  return 0;
+}
+
+static clib_error_t *
+gso_test (vlib_main_t * vm, unformat_input_t * input,
+	  vlib_cli_command_t * cmd_arg)
+{
+  ip46_address_t lcl, rmt;
+
+  memset (&lcl, 0, sizeof (lcl));
+  memset (&rmt, 0, sizeof (rmt));
+
+  if (unformat (input, "local-peer %U %U", unformat_ip4_address, &lcl.ip4,
+		unformat_ip4_address, &rmt.ip4))
+    {
+      if (gso_test_local_peer (vm, &lcl, &rmt, 1 /* is_ip4 */ ))
+	return clib_error_return (0, "GSO local peer test failed");
+      return 0;
+    }
+  if (unformat (input, "local-peer %U %U", unformat_ip6_address, &lcl.ip6,
+		unformat_ip6_address, &rmt.ip6))
+    {
+      if (gso_test_local_peer (vm, &lcl, &rmt, 0 /* is_ip4 */ ))
+	return clib_error_return (0, "GSO local peer test failed");
+      return 0;
+    }
+
+  if (gso_test_all (vm))
+    return clib_error_return (0, "GSO unit test failed");
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (gso_test_command, static) =
+{
+  .path = "test gso",
+  .short_help = "test gso [local-peer <local-addr> <remote-addr>]",
+  .function = gso_test,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
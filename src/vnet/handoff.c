@@ -70,6 +70,23 @@ format_worker_handoff_trace (u8 * s, va_list * args)
 
 vlib_node_registration_t handoff_node;
 
+#define foreach_worker_handoff_error			\
+_(CONGESTION_DROP, "congestion drop")
+
+typedef enum
+{
+#define _(sym,str) WORKER_HANDOFF_ERROR_##sym,
+  foreach_worker_handoff_error
+#undef _
+    WORKER_HANDOFF_N_ERROR,
+} worker_handoff_error_t;
+
+static char *worker_handoff_error_strings[] = {
+#define _(sym,string) string,
+  foreach_worker_handoff_error
+#undef _
+};
+
 static uword
 worker_handoff_node_fn (vlib_main_t * vm,
 			vlib_node_runtime_t * node, vlib_frame_t * frame)
@@ -77,23 +94,13 @@ worker_handoff_node_fn (vlib_main_t * vm,
   handoff_main_t *hm = &handoff_main;
   vlib_thread_main_t *tm = vlib_get_thread_main ();
   u32 n_left_from, *from;
-  static __thread vlib_frame_queue_elt_t **handoff_queue_elt_by_worker_index;
-  static __thread vlib_frame_queue_t **congested_handoff_queue_by_worker_index
-    = 0;
-  vlib_frame_queue_elt_t *hf = 0;
-  int i;
-  u32 n_left_to_next_worker = 0, *to_next_worker = 0;
+  static __thread u32 **buffers_by_worker_index;
+  u32 *buffers, n_enq, n_drop = 0;
   u32 next_worker_index = 0;
-  u32 current_worker_index = ~0;
-
-  if (PREDICT_FALSE (handoff_queue_elt_by_worker_index == 0))
-    {
-      vec_validate (handoff_queue_elt_by_worker_index, tm->n_vlib_mains - 1);
+  int i;
 
-      vec_validate_init_empty (congested_handoff_queue_by_worker_index,
-			       hm->first_worker_index + hm->num_workers - 1,
-			       (vlib_frame_queue_t *) (~0));
-    }
+  if (PREDICT_FALSE (buffers_by_worker_index == 0))
+    vec_validate (buffers_by_worker_index, tm->n_vlib_mains - 1);
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -148,33 +155,8 @@ worker_handoff_node_fn (vlib_main_t * vm,
 
       next_worker_index += ihd0->workers[index0];
 
-      if (next_worker_index != current_worker_index)
-	{
-	  if (hf)
-	    hf->n_vectors = VLIB_FRAME_SIZE - n_left_to_next_worker;
-
-	  hf = vlib_get_worker_handoff_queue_elt (hm->frame_queue_index,
-						  next_worker_index,
-						  handoff_queue_elt_by_worker_index);
-
-	  n_left_to_next_worker = VLIB_FRAME_SIZE - hf->n_vectors;
-	  to_next_worker = &hf->buffer_index[hf->n_vectors];
-	  current_worker_index = next_worker_index;
-	}
-
-      /* enqueue to correct worker thread */
-      to_next_worker[0] = bi0;
-      to_next_worker++;
-      n_left_to_next_worker--;
-
-      if (n_left_to_next_worker == 0)
-	{
-	  hf->n_vectors = VLIB_FRAME_SIZE;
-	  vlib_put_frame_queue_elt (hf);
-	  current_worker_index = ~0;
-	  handoff_queue_elt_by_worker_index[next_worker_index] = 0;
-	  hf = 0;
-	}
+      /* Batch per destination worker, enqueued below in one go */
+      vec_add1 (buffers_by_worker_index[next_worker_index], bi0);
 
       if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
 			 && (b0->flags & VLIB_BUFFER_IS_TRACED)))
@@ -188,32 +170,28 @@ worker_handoff_node_fn (vlib_main_t * vm,
 
     }
 
-  if (hf)
-    hf->n_vectors = VLIB_FRAME_SIZE - n_left_to_next_worker;
-
-  /* Ship frames to the worker nodes */
-  for (i = 0; i < vec_len (handoff_queue_elt_by_worker_index); i++)
+  /* Ship the buffers to the worker threads, drop what doesn't fit */
+  for (i = 0; i < vec_len (buffers_by_worker_index); i++)
     {
-      if (handoff_queue_elt_by_worker_index[i])
+      buffers = buffers_by_worker_index[i];
+      if (vec_len (buffers) == 0)
+	continue;
+
+      n_enq = vlib_frame_queue_enqueue (vm, hm->frame_queue_index, i,
+					buffers, vec_len (buffers));
+      if (PREDICT_FALSE (n_enq < vec_len (buffers)))
 	{
-	  hf = handoff_queue_elt_by_worker_index[i];
-	  /*
-	   * It works better to let the handoff node
-	   * rate-adapt, always ship the handoff queue element.
-	   */
-	  if (1 || hf->n_vectors == hf->last_n_vectors)
-	    {
-	      vlib_put_frame_queue_elt (hf);
-	      handoff_queue_elt_by_worker_index[i] = 0;
-	    }
-	  else
-	    hf->last_n_vectors = hf->n_vectors;
+	  vlib_buffer_free (vm, buffers + n_enq, vec_len (buffers) - n_enq);
+	  n_drop += vec_len (buffers) - n_enq;
 	}
-      congested_handoff_queue_by_worker_index[i] =
-	(vlib_frame_queue_t *) (~0);
+      _vec_len (buffers) = 0;
     }
-  hf = 0;
-  current_worker_index = ~0;
+
+  if (PREDICT_FALSE (n_drop))
+    vlib_node_increment_counter (vm, node->node_index,
+				 WORKER_HANDOFF_ERROR_CONGESTION_DROP,
+				 n_drop);
+
   return frame->n_vectors;
 }
 
@@ -224,6 +202,8 @@ VLIB_REGISTER_NODE (worker_handoff_node) = {
   .vector_size = sizeof (u32),
   .format_trace = format_worker_handoff_trace,
   .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (worker_handoff_error_strings),
+  .error_strings = worker_handoff_error_strings,
 
   .n_next_nodes = 1,
   .next_nodes = {
@@ -919,6 +919,8 @@ vnet_delete_hw_interface (vnet_main_t * vnm, u32 hw_if_index)
 
   hash_unset_mem (im->hw_interface_by_name, hw->name);
   vec_free (hw->name);
+  vec_free (hw->rss_key);
+  vec_free (hw->rss_thread_index_by_reta);
 
   pool_put (im->hw_interfaces, hw);
 }
@@ -1165,18 +1167,38 @@ vnet_interface_init (vlib_main_t * vm)
 
   vec_validate (im->sw_if_counters, VNET_N_SIMPLE_INTERFACE_COUNTER - 1);
   im->sw_if_counters[VNET_INTERFACE_COUNTER_DROP].name = "drops";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_DROP].stat_segment_name =
+    "/if/drops";
   im->sw_if_counters[VNET_INTERFACE_COUNTER_PUNT].name = "punts";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_PUNT].stat_segment_name =
+    "/if/punts";
   im->sw_if_counters[VNET_INTERFACE_COUNTER_IP4].name = "ip4";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_IP4].stat_segment_name =
+    "/if/ip4";
   im->sw_if_counters[VNET_INTERFACE_COUNTER_IP6].name = "ip6";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_IP6].stat_segment_name =
+    "/if/ip6";
   im->sw_if_counters[VNET_INTERFACE_COUNTER_RX_NO_BUF].name = "rx-no-buf";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_RX_NO_BUF].stat_segment_name =
+    "/if/rx-no-buf";
   im->sw_if_counters[VNET_INTERFACE_COUNTER_RX_MISS].name = "rx-miss";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_RX_MISS].stat_segment_name =
+    "/if/rx-miss";
   im->sw_if_counters[VNET_INTERFACE_COUNTER_RX_ERROR].name = "rx-error";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_RX_ERROR].stat_segment_name =
+    "/if/rx-error";
   im->sw_if_counters[VNET_INTERFACE_COUNTER_TX_ERROR].name = "tx-error";
+  im->sw_if_counters[VNET_INTERFACE_COUNTER_TX_ERROR].stat_segment_name =
+    "/if/tx-error";
 
   vec_validate (im->combined_sw_if_counters,
 		VNET_N_COMBINED_INTERFACE_COUNTER - 1);
   im->combined_sw_if_counters[VNET_INTERFACE_COUNTER_RX].name = "rx";
+  im->combined_sw_if_counters[VNET_INTERFACE_COUNTER_RX].stat_segment_name =
+    "/if/rx";
   im->combined_sw_if_counters[VNET_INTERFACE_COUNTER_TX].name = "tx";
+  im->combined_sw_if_counters[VNET_INTERFACE_COUNTER_TX].stat_segment_name =
+    "/if/tx";
 
   im->sw_if_counter_lock[0] = 0;
 
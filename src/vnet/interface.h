@@ -405,6 +405,9 @@ typedef struct vnet_hw_interface_t
 #define VNET_HW_INTERFACE_FLAG_L2OUTPUT_SHIFT	9
 #define VNET_HW_INTERFACE_FLAG_L2OUTPUT_MAPPED	(1 << 9)
 
+  /* device segments VNET_BUFFER_GSO buffers itself (TSO) */
+#define VNET_HW_INTERFACE_FLAG_SUPPORTS_GSO	(1 << 10)
+
   /* Hardware address as vector.  Zero (e.g. zero-length vector) if no
      address for this class (e.g. PPP). */
   u8 *hw_address;
@@ -464,6 +467,13 @@ typedef struct vnet_hw_interface_t
 #define VNET_HW_INTERFACE_BOND_INFO_NONE ((uword *) 0)
 #define VNET_HW_INTERFACE_BOND_INFO_SLAVE ((uword *) ~0)
 
+  /* Receive side scaling, set by drivers that spread rx queues over
+     threads: the Toeplitz key and, per indirection table entry, the
+     index of the thread polling that entry's queue.
+     See vnet_hw_interface_rss_thread_index. */
+  u8 *rss_key;
+  u32 *rss_thread_index_by_reta;
+
 } vnet_hw_interface_t;
 
 extern vnet_device_class_t vnet_local_interface_device_class;
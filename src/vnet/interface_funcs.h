@@ -40,6 +40,8 @@
 #ifndef included_vnet_interface_funcs_h
 #define included_vnet_interface_funcs_h
 
+#include <vppinfra/toeplitz.h>
+
 always_inline vnet_hw_interface_t *
 vnet_get_hw_interface (vnet_main_t * vnm, u32 hw_if_index)
 {
@@ -232,6 +234,24 @@ vnet_hw_interface_is_link_up (vnet_main_t * vnm, u32 hw_if_index)
 	  VNET_HW_INTERFACE_FLAG_LINK_UP) != 0;
 }
 
+/* Index of the thread that receives packets hashing to rss_tuple, in
+   rss input order, i.e. src addr, dst addr, src port, dst port in network
+   byte order. ~0 if the interface doesn't publish its rss placement. */
+always_inline u32
+vnet_hw_interface_rss_thread_index (vnet_hw_interface_t * hw,
+				    u8 * rss_tuple, uword n_bytes)
+{
+  u32 hash, n_entries = vec_len (hw->rss_thread_index_by_reta);
+
+  if (n_entries == 0)
+    return ~0;
+
+  ASSERT (is_pow2 (n_entries));
+  hash = clib_toeplitz_hash (hw->rss_key, vec_len (hw->rss_key), rss_tuple,
+			     n_bytes);
+  return hw->rss_thread_index_by_reta[hash & (n_entries - 1)];
+}
+
 always_inline vlib_frame_t *
 vnet_get_frame_to_sw_interface (vnet_main_t * vnm, u32 sw_if_index)
 {
@@ -180,6 +180,7 @@ ip_incremental_checksum_buffer (vlib_main_t * vm,
 }
 
 void ip_del_all_interface_addresses (vlib_main_t * vm, u32 sw_if_index);
+void *ip_interface_get_first_ip (u32 sw_if_index, u8 is_ip4);
 
 extern vlib_node_registration_t ip4_inacl_node;
 extern vlib_node_registration_t ip6_inacl_node;
@@ -39,9 +39,10 @@
 
 #include <vnet/ip/ip.h>
 #include <vnet/fib/fib_entry.h>
+#include <vnet/fib/ip4_fib.h>
 
 static void
-ply_init (ip4_fib_mtrie_ply_t * p, ip4_fib_mtrie_leaf_t init,
+ply_init (ip4_fib_mtrie_8_ply_t * p, ip4_fib_mtrie_leaf_t init,
 	  uword prefix_len)
 {
   p->n_non_empty_leafs =
@@ -91,34 +92,42 @@ ply_init (ip4_fib_mtrie_ply_t * p, ip4_fib_mtrie_leaf_t init,
 #endif
 }
 
+static void
+root_ply_init (ip4_fib_mtrie_16_ply_t * p)
+{
+  uword i;
+
+  memset (p->dst_address_bits_of_leaves, 0,
+	  sizeof (p->dst_address_bits_of_leaves));
+  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
+    p->leaves[i] = IP4_FIB_MTRIE_LEAF_EMPTY;
+}
+
 static ip4_fib_mtrie_leaf_t
 ply_create (ip4_fib_mtrie_t * m, ip4_fib_mtrie_leaf_t init_leaf,
 	    uword prefix_len)
 {
-  ip4_fib_mtrie_ply_t *p;
+  ip4_fib_mtrie_8_ply_t *p;
 
-  /* Get cache aligned ply. */
-  pool_get_aligned (m->ply_pool, p, sizeof (p[0]));
+  /* Get cache aligned ply. Workers walk the pool, so don't move it
+     under them. */
+  vlib_worker_thread_pool_get_aligned (m->ply_pool, p, sizeof (p[0]));
 
   ply_init (p, init_leaf, prefix_len);
   return ip4_fib_mtrie_leaf_set_next_ply_index (p - m->ply_pool);
 }
 
-always_inline ip4_fib_mtrie_ply_t *
+always_inline ip4_fib_mtrie_8_ply_t *
 get_next_ply_for_leaf (ip4_fib_mtrie_t * m, ip4_fib_mtrie_leaf_t l)
 {
   uword n = ip4_fib_mtrie_leaf_get_next_ply_index (l);
-  /* It better not be the root ply. */
-  ASSERT (n != 0);
   return pool_elt_at_index (m->ply_pool, n);
 }
 
 static void
-ply_free (ip4_fib_mtrie_t * m, ip4_fib_mtrie_ply_t * p)
+ply_free (ip4_fib_mtrie_t * m, ip4_fib_mtrie_8_ply_t * p)
 {
-  uword i, is_root;
-
-  is_root = p - m->ply_pool == 0;
+  uword i;
 
   for (i = 0; i < ARRAY_LEN (p->leaves); i++)
     {
@@ -127,41 +136,46 @@ ply_free (ip4_fib_mtrie_t * m, ip4_fib_mtrie_ply_t * p)
 	ply_free (m, get_next_ply_for_leaf (m, l));
     }
 
-  if (is_root)
-    ply_init (p, IP4_FIB_MTRIE_LEAF_EMPTY, /* prefix_len */ 0);
-  else
-    pool_put (m->ply_pool, p);
+  pool_put (m->ply_pool, p);
+}
+
+/*
+ * A ply emptied by a delete may still be walked by a worker that read
+ * the leaf before it was cleared; it returns to the pool after an epoch.
+ */
+static void
+ply_put (uword fib_index, uword ply_index)
+{
+  ip4_fib_mtrie_t *m = &ip4_fib_get (fib_index)->mtrie;
+
+  pool_put_index (m->ply_pool, ply_index);
 }
 
 void
-ip4_fib_free (ip4_fib_mtrie_t * m)
+ip4_mtrie_free (ip4_fib_mtrie_t * m)
 {
-  ip4_fib_mtrie_ply_t *root_ply = pool_elt_at_index (m->ply_pool, 0);
-  ply_free (m, root_ply);
+  uword i;
+
+  for (i = 0; i < ARRAY_LEN (m->root_ply->leaves); i++)
+    {
+      ip4_fib_mtrie_leaf_t l = m->root_ply->leaves[i];
+      if (ip4_fib_mtrie_leaf_is_next_ply (l))
+	ply_free (m, get_next_ply_for_leaf (m, l));
+    }
+
+  clib_mem_free (m->root_ply);
+  pool_free (m->ply_pool);
+  memset (m, 0, sizeof (m[0]));
 }
 
 u32
 ip4_mtrie_lookup_address (ip4_fib_mtrie_t * m, ip4_address_t dst)
 {
-  ip4_fib_mtrie_ply_t *p = pool_elt_at_index (m->ply_pool, 0);
   ip4_fib_mtrie_leaf_t l;
 
-  l = p->leaves[dst.as_u8[0]];
-  if (ip4_fib_mtrie_leaf_is_terminal (l))
-    return ip4_fib_mtrie_leaf_get_adj_index (l);
-
-  p = get_next_ply_for_leaf (m, l);
-  l = p->leaves[dst.as_u8[1]];
-  if (ip4_fib_mtrie_leaf_is_terminal (l))
-    return ip4_fib_mtrie_leaf_get_adj_index (l);
-
-  p = get_next_ply_for_leaf (m, l);
-  l = p->leaves[dst.as_u8[2]];
-  if (ip4_fib_mtrie_leaf_is_terminal (l))
-    return ip4_fib_mtrie_leaf_get_adj_index (l);
-
-  p = get_next_ply_for_leaf (m, l);
-  l = p->leaves[dst.as_u8[3]];
+  l = ip4_fib_mtrie_lookup_step_one (m, &dst);
+  l = ip4_fib_mtrie_lookup_step (m, l, &dst, 2);
+  l = ip4_fib_mtrie_lookup_step (m, l, &dst, 3);
 
   ASSERT (ip4_fib_mtrie_leaf_is_terminal (l));
   return ip4_fib_mtrie_leaf_get_adj_index (l);
@@ -172,11 +186,12 @@ typedef struct
   ip4_address_t dst_address;
   u32 dst_address_length;
   u32 adj_index;
+  u32 fib_index;
 } ip4_fib_mtrie_set_unset_leaf_args_t;
 
 static void
 set_ply_with_more_specific_leaf (ip4_fib_mtrie_t * m,
-				 ip4_fib_mtrie_ply_t * ply,
+				 ip4_fib_mtrie_8_ply_t * ply,
 				 ip4_fib_mtrie_leaf_t new_leaf,
 				 uword new_leaf_dst_address_bits)
 {
@@ -193,7 +208,7 @@ set_ply_with_more_specific_leaf (ip4_fib_mtrie_t * m,
       /* Recurse into sub plies. */
       if (!ip4_fib_mtrie_leaf_is_terminal (old_leaf))
 	{
-	  ip4_fib_mtrie_ply_t *sub_ply = get_next_ply_for_leaf (m, old_leaf);
+	  ip4_fib_mtrie_8_ply_t *sub_ply = get_next_ply_for_leaf (m, old_leaf);
 	  set_ply_with_more_specific_leaf (m, sub_ply, new_leaf,
 					   new_leaf_dst_address_bits);
 	}
@@ -219,7 +234,8 @@ set_leaf (ip4_fib_mtrie_t * m,
   i32 n_dst_bits_next_plies;
   u8 dst_byte;
 
-  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 32);
+  ASSERT (a->dst_address_length > 16 && a->dst_address_length <= 32);
+  ASSERT (dst_address_byte_index >= 2);
   ASSERT (dst_address_byte_index < ARRAY_LEN (a->dst_address.as_u8));
 
   n_dst_bits_next_plies =
@@ -238,7 +254,7 @@ set_leaf (ip4_fib_mtrie_t * m,
 
       for (i = dst_byte; i < dst_byte + (1 << n_dst_bits_this_ply); i++)
 	{
-	  ip4_fib_mtrie_ply_t *old_ply, *new_ply;
+	  ip4_fib_mtrie_8_ply_t *old_ply, *new_ply;
 
 	  old_ply = pool_elt_at_index (m->ply_pool, old_ply_index);
 
@@ -282,7 +298,7 @@ set_leaf (ip4_fib_mtrie_t * m,
     }
   else
     {
-      ip4_fib_mtrie_ply_t *old_ply, *new_ply;
+      ip4_fib_mtrie_8_ply_t *old_ply, *new_ply;
 
       old_ply = pool_elt_at_index (m->ply_pool, old_ply_index);
       old_leaf = old_ply->leaves[dst_byte];
@@ -315,14 +331,94 @@ set_leaf (ip4_fib_mtrie_t * m,
     }
 }
 
+static void
+set_root_leaf (ip4_fib_mtrie_t * m, ip4_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  ip4_fib_mtrie_16_ply_t *old_ply = m->root_ply;
+  ip4_fib_mtrie_leaf_t old_leaf, new_leaf;
+  i32 n_dst_bits_next_plies;
+  u16 dst_index;
+
+  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 32);
+
+  n_dst_bits_next_plies = a->dst_address_length - BITS (u16);
+
+  dst_index = clib_net_to_host_u16 (a->dst_address.as_u16[0]);
+
+  /* Number of bits next plies <= 0 => insert leaves this ply. */
+  if (n_dst_bits_next_plies <= 0)
+    {
+      uword i, n_dst_bits_this_ply;
+
+      n_dst_bits_this_ply = -n_dst_bits_next_plies;
+      ASSERT ((dst_index & pow2_mask (n_dst_bits_this_ply)) == 0);
+
+      new_leaf = ip4_fib_mtrie_leaf_set_adj_index (a->adj_index);
+
+      for (i = dst_index; i < dst_index + (1 << n_dst_bits_this_ply); i++)
+	{
+	  old_leaf = old_ply->leaves[i];
+
+	  if (!ip4_fib_mtrie_leaf_is_terminal (old_leaf))
+	    {
+	      /* Existing leaf points to another ply.  We need to place
+	         new_leaf into all more specific slots. */
+	      set_ply_with_more_specific_leaf (m,
+					       get_next_ply_for_leaf (m,
+								      old_leaf),
+					       new_leaf,
+					       a->dst_address_length);
+	    }
+	  /* Is leaf to be inserted more specific? */
+	  else if (a->dst_address_length >=
+		   old_ply->dst_address_bits_of_leaves[i])
+	    {
+	      old_ply->dst_address_bits_of_leaves[i] = a->dst_address_length;
+	      __sync_val_compare_and_swap (&old_ply->leaves[i], old_leaf,
+					   new_leaf);
+	      ASSERT (old_ply->leaves[i] == new_leaf);
+	    }
+	}
+    }
+  else
+    {
+      ip4_fib_mtrie_8_ply_t *new_ply;
+
+      old_leaf = old_ply->leaves[dst_index];
+      if (ip4_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  new_leaf =
+	    ply_create (m, old_leaf,
+			old_ply->dst_address_bits_of_leaves[dst_index]);
+	  new_ply = get_next_ply_for_leaf (m, new_leaf);
+
+	  __sync_val_compare_and_swap (&old_ply->leaves[dst_index], old_leaf,
+				       new_leaf);
+	  ASSERT (old_ply->leaves[dst_index] == new_leaf);
+	  old_ply->dst_address_bits_of_leaves[dst_index] = 0;
+	}
+      else
+	new_ply = get_next_ply_for_leaf (m, old_leaf);
+
+      set_leaf (m, a, new_ply - m->ply_pool, 2);
+    }
+}
+
+/*
+ * Empty the leaves of the route being removed. Within the route's range
+ * the route is identified by its prefix length; matching on the adjacency
+ * would also remove more specific routes sharing the same load-balance.
+ * Returns non-zero if the ply is left empty, in which case the caller
+ * unlinks it and then frees it.
+ */
 static uword
 unset_leaf (ip4_fib_mtrie_t * m,
 	    ip4_fib_mtrie_set_unset_leaf_args_t * a,
-	    ip4_fib_mtrie_ply_t * old_ply, u32 dst_address_byte_index)
+	    ip4_fib_mtrie_8_ply_t * old_ply, u32 dst_address_byte_index)
 {
-  ip4_fib_mtrie_leaf_t old_leaf, del_leaf;
+  ip4_fib_mtrie_leaf_t old_leaf;
   i32 n_dst_bits_next_plies;
-  i32 i, n_dst_bits_this_ply, old_leaf_is_terminal;
+  i32 i, n_dst_bits_this_ply;
   u8 dst_byte;
 
   ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 32);
@@ -339,48 +435,99 @@ unset_leaf (ip4_fib_mtrie_t * m,
     n_dst_bits_next_plies <= 0 ? -n_dst_bits_next_plies : 0;
   n_dst_bits_this_ply = clib_min (8, n_dst_bits_this_ply);
 
-  del_leaf = ip4_fib_mtrie_leaf_set_adj_index (a->adj_index);
-
   for (i = dst_byte; i < dst_byte + (1 << n_dst_bits_this_ply); i++)
     {
+      ip4_fib_mtrie_8_ply_t *sub_ply = 0;
+
       old_leaf = old_ply->leaves[i];
-      old_leaf_is_terminal = ip4_fib_mtrie_leaf_is_terminal (old_leaf);
 
-      if (old_leaf == del_leaf
-	  || (!old_leaf_is_terminal
-	      && unset_leaf (m, a, get_next_ply_for_leaf (m, old_leaf),
-			     dst_address_byte_index + 1)))
+      if (ip4_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  if (old_ply->dst_address_bits_of_leaves[i] !=
+	      a->dst_address_length)
+	    continue;
+	}
+      else
 	{
-	  old_ply->leaves[i] = IP4_FIB_MTRIE_LEAF_EMPTY;
-	  old_ply->dst_address_bits_of_leaves[i] = 0;
+	  sub_ply = get_next_ply_for_leaf (m, old_leaf);
+	  if (!unset_leaf (m, a, sub_ply, dst_address_byte_index + 1))
+	    continue;
+	}
 
-	  /* No matter what we just deleted a non-empty leaf. */
-	  ASSERT (!ip4_fib_mtrie_leaf_is_empty (old_leaf));
-	  old_ply->n_non_empty_leafs -= 1;
+      old_ply->leaves[i] = IP4_FIB_MTRIE_LEAF_EMPTY;
+      old_ply->dst_address_bits_of_leaves[i] = 0;
 
-	  ASSERT (old_ply->n_non_empty_leafs >= 0);
-	  if (old_ply->n_non_empty_leafs == 0 && dst_address_byte_index > 0)
-	    {
-	      pool_put (m->ply_pool, old_ply);
-	      /* Old ply was deleted. */
-	      return 1;
-	    }
-	}
+      /* The sub-ply is unreachable now, free it. */
+      if (sub_ply)
+	vlib_worker_thread_epoch_defer (ply_put, a->fib_index,
+					sub_ply - m->ply_pool);
+
+      /* No matter what we just deleted a non-empty leaf. */
+      ASSERT (!ip4_fib_mtrie_leaf_is_empty (old_leaf));
+      old_ply->n_non_empty_leafs -= 1;
+      ASSERT (old_ply->n_non_empty_leafs >= 0);
     }
 
-  /* Old ply was not deleted. */
-  return 0;
+  return (old_ply->n_non_empty_leafs == 0);
+}
+
+static void
+unset_root_leaf (ip4_fib_mtrie_t * m,
+		 ip4_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  ip4_fib_mtrie_16_ply_t *old_ply = m->root_ply;
+  ip4_fib_mtrie_leaf_t old_leaf;
+  i32 n_dst_bits_next_plies;
+  i32 i, n_dst_bits_this_ply;
+  u16 dst_index;
+
+  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 32);
+
+  n_dst_bits_next_plies = a->dst_address_length - BITS (u16);
+
+  dst_index = clib_net_to_host_u16 (a->dst_address.as_u16[0]);
+  if (n_dst_bits_next_plies < 0)
+    dst_index &= ~pow2_mask (-n_dst_bits_next_plies);
+
+  n_dst_bits_this_ply =
+    n_dst_bits_next_plies <= 0 ? -n_dst_bits_next_plies : 0;
+
+  for (i = dst_index; i < dst_index + (1 << n_dst_bits_this_ply); i++)
+    {
+      ip4_fib_mtrie_8_ply_t *sub_ply = 0;
+
+      old_leaf = old_ply->leaves[i];
+
+      if (ip4_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  if (old_ply->dst_address_bits_of_leaves[i] !=
+	      a->dst_address_length)
+	    continue;
+	}
+      else
+	{
+	  sub_ply = get_next_ply_for_leaf (m, old_leaf);
+	  if (!unset_leaf (m, a, sub_ply, 2))
+	    continue;
+	}
+
+      old_ply->leaves[i] = IP4_FIB_MTRIE_LEAF_EMPTY;
+      old_ply->dst_address_bits_of_leaves[i] = 0;
+
+      if (sub_ply)
+	vlib_worker_thread_epoch_defer (ply_put, a->fib_index,
+					sub_ply - m->ply_pool);
+    }
 }
 
 void
 ip4_mtrie_init (ip4_fib_mtrie_t * m)
 {
-  ip4_fib_mtrie_leaf_t root;
   memset (m, 0, sizeof (m[0]));
   m->default_leaf = IP4_FIB_MTRIE_LEAF_EMPTY;
-  root = ply_create (m, IP4_FIB_MTRIE_LEAF_EMPTY,	/* dst_address_bits_of_leaves */
-		     0);
-  ASSERT (ip4_fib_mtrie_leaf_get_next_ply_index (root) == 0);
+  m->root_ply = clib_mem_alloc_aligned (sizeof (m->root_ply[0]),
+					CLIB_CACHE_LINE_BYTES);
+  root_ply_init (m->root_ply);
 }
 
 void
@@ -390,26 +537,24 @@ ip4_fib_mtrie_add_del_route (ip4_fib_t * fib,
 			     u32 adj_index, u32 is_del)
 {
   ip4_fib_mtrie_t *m = &fib->mtrie;
-  ip4_fib_mtrie_ply_t *root_ply;
   ip4_fib_mtrie_set_unset_leaf_args_t a;
   ip4_main_t *im = &ip4_main;
 
-  ASSERT (m->ply_pool != 0);
-
-  root_ply = pool_elt_at_index (m->ply_pool, 0);
+  ASSERT (m->root_ply != 0);
 
   /* Honor dst_address_length. Fib masks are in network byte order */
   dst_address.as_u32 &= im->fib_masks[dst_address_length];
   a.dst_address = dst_address;
   a.dst_address_length = dst_address_length;
   a.adj_index = adj_index;
+  a.fib_index = fib->index;
 
   if (!is_del)
     {
       if (dst_address_length == 0)
 	m->default_leaf = ip4_fib_mtrie_leaf_set_adj_index (adj_index);
       else
-	set_leaf (m, &a, /* ply_index */ 0, /* dst_address_byte_index */ 0);
+	set_root_leaf (m, &a);
     }
   else
     {
@@ -421,7 +566,7 @@ ip4_fib_mtrie_add_del_route (ip4_fib_t * fib,
 	  ip4_main_t *im = &ip4_main;
 	  uword i;
 
-	  unset_leaf (m, &a, root_ply, 0);
+	  unset_root_leaf (m, &a);
 
 	  /* Find next less specific route and insert into mtrie. */
 	  for (i = dst_address_length - 1; i >= 1; i--)
@@ -445,8 +590,7 @@ ip4_fib_mtrie_add_del_route (ip4_fib_t * fib,
 		  a.adj_index = lbi;
 		  a.dst_address_length = i;
 
-		  set_leaf (m, &a, /* ply_index */ 0,
-			    /* dst_address_byte_index */ 0);
+		  set_root_leaf (m, &a);
 		  break;
 		}
 	    }
@@ -455,27 +599,14 @@ ip4_fib_mtrie_add_del_route (ip4_fib_t * fib,
 }
 
 /* Returns number of bytes of memory used by mtrie. */
-static uword
-mtrie_memory_usage (ip4_fib_mtrie_t * m, ip4_fib_mtrie_ply_t * p)
+uword
+ip4_fib_mtrie_memory_usage (ip4_fib_mtrie_t * m)
 {
-  uword bytes, i;
-
-  if (!p)
-    {
-      if (pool_is_free_index (m->ply_pool, 0))
-	return 0;
-      p = pool_elt_at_index (m->ply_pool, 0);
-    }
+  if (!m->root_ply)
+    return 0;
 
-  bytes = sizeof (p[0]);
-  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
-    {
-      ip4_fib_mtrie_leaf_t l = p->leaves[i];
-      if (ip4_fib_mtrie_leaf_is_next_ply (l))
-	bytes += mtrie_memory_usage (m, get_next_ply_for_leaf (m, l));
-    }
-
-  return bytes;
+  return (sizeof (m->root_ply[0]) +
+	  pool_elts (m->ply_pool) * sizeof (m->ply_pool[0]));
 }
 
 static u8 *
@@ -499,7 +630,7 @@ format_ip4_fib_mtrie_ply (u8 * s, va_list * va)
   u32 base_address = va_arg (*va, u32);
   u32 ply_index = va_arg (*va, u32);
   u32 dst_address_byte_index = va_arg (*va, u32);
-  ip4_fib_mtrie_ply_t *p;
+  ip4_fib_mtrie_8_ply_t *p;
   uword i, indent;
 
   p = pool_elt_at_index (m->ply_pool, ply_index);
@@ -539,22 +670,63 @@ format_ip4_fib_mtrie_ply (u8 * s, va_list * va)
   return s;
 }
 
+static u8 *
+format_ip4_fib_mtrie_root_ply (u8 * s, va_list * va)
+{
+  ip4_fib_mtrie_t *m = va_arg (*va, ip4_fib_mtrie_t *);
+  ip4_fib_mtrie_16_ply_t *p = m->root_ply;
+  uword i, indent;
+
+  indent = format_get_indent (s);
+  s = format (s, "root ply");
+  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
+    {
+      ip4_fib_mtrie_leaf_t l = p->leaves[i];
+      u32 a, ia_length;
+      ip4_address_t ia;
+
+      if (ip4_fib_mtrie_leaf_is_empty (l))
+	continue;
+
+      if (ip4_fib_mtrie_leaf_is_terminal (l))
+	{
+	  ia_length = p->dst_address_bits_of_leaves[i];
+
+	  /* A prefix shorter than /16 spans many slots, show it once. */
+	  if (i & pow2_mask (16 - ia_length))
+	    continue;
+	}
+      else
+	ia_length = 16;
+
+      a = i << 16;
+      ia.as_u32 = clib_host_to_net_u32 (a);
+      s = format (s, "\n%U%20U %U",
+		  format_white_space, indent + 2,
+		  format_ip4_address_and_length, &ia, ia_length,
+		  format_ip4_fib_mtrie_leaf, l);
+
+      if (ip4_fib_mtrie_leaf_is_next_ply (l))
+	s = format (s, "\n%U%U",
+		    format_white_space, indent + 2,
+		    format_ip4_fib_mtrie_ply, m, a,
+		    ip4_fib_mtrie_leaf_get_next_ply_index (l), 2);
+    }
+
+  return s;
+}
+
 u8 *
 format_ip4_fib_mtrie (u8 * s, va_list * va)
 {
   ip4_fib_mtrie_t *m = va_arg (*va, ip4_fib_mtrie_t *);
 
   s = format (s, "%d plies, memory usage %U",
-	      pool_elts (m->ply_pool),
-	      format_memory_size, mtrie_memory_usage (m, 0));
+	      pool_elts (m->ply_pool) + 1,
+	      format_memory_size, ip4_fib_mtrie_memory_usage (m));
 
-  if (pool_elts (m->ply_pool) > 0)
-    {
-      ip4_address_t base_address;
-      base_address.as_u32 = 0;
-      s =
-	format (s, "\n  %U", format_ip4_fib_mtrie_ply, m, base_address, 0, 0);
-    }
+  if (m->root_ply)
+    s = format (s, "\n  %U", format_ip4_fib_mtrie_root_ply, m);
 
   return s;
 }
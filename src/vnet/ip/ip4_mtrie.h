@@ -45,14 +45,16 @@
 #include <vnet/ip/lookup.h>
 #include <vnet/ip/ip4_packet.h>	/* for ip4_address_t */
 
-/* ip4 fib leafs: 4 ply 8-8-8-8 mtrie.
+/* ip4 fib leafs: 3 ply 16-8-8 mtrie.
+   The 16 bit root ply is a flat array indexed by the first two bytes
+   of the address, so prefixes up to /16 resolve in one memory access
+   and up to /24 in two.
    1 + 2*adj_index for terminal leaves.
    0 + 2*next_ply_index for non-terminals.
    1 => empty (adjacency index of zero is special miss adjacency). */
 typedef u32 ip4_fib_mtrie_leaf_t;
 
 #define IP4_FIB_MTRIE_LEAF_EMPTY (1 + 2*0)
-#define IP4_FIB_MTRIE_LEAF_ROOT  (0 + 2*0)
 
 always_inline u32
 ip4_fib_mtrie_leaf_is_empty (ip4_fib_mtrie_leaf_t n)
@@ -110,7 +112,7 @@ ip4_fib_mtrie_leaf_set_next_ply_index (u32 i)
   return l;
 }
 
-/* One ply of the 4 ply mtrie fib. */
+/* One 8 bit ply of the mtrie fib. */
 typedef struct
 {
   union
@@ -131,21 +133,35 @@ typedef struct
   /* Pad to cache line boundary. */
   u8 pad[CLIB_CACHE_LINE_BYTES - 1 * sizeof (i32)];
 }
-ip4_fib_mtrie_ply_t;
+ip4_fib_mtrie_8_ply_t;
 
-STATIC_ASSERT (0 == sizeof (ip4_fib_mtrie_ply_t) % CLIB_CACHE_LINE_BYTES,
+STATIC_ASSERT (0 == sizeof (ip4_fib_mtrie_8_ply_t) % CLIB_CACHE_LINE_BYTES,
 	       "IP4 Mtrie ply cache line");
 
+/* The 16 bit root ply of the mtrie fib. */
 typedef struct
 {
-  /* Pool of plies.  Index zero is root ply. */
-  ip4_fib_mtrie_ply_t *ply_pool;
+  ip4_fib_mtrie_leaf_t leaves[1 << 16];
+
+  /* Prefix length for terminal leaves. */
+  u8 dst_address_bits_of_leaves[1 << 16];
+}
+ip4_fib_mtrie_16_ply_t;
+
+typedef struct
+{
+  /* The root ply. Allocated apart from the FIB since it is large. */
+  ip4_fib_mtrie_16_ply_t *root_ply;
+
+  /* Pool of 8 bit plies. */
+  ip4_fib_mtrie_8_ply_t *ply_pool;
 
   /* Special case leaf for default route 0.0.0.0/0. */
   ip4_fib_mtrie_leaf_t default_leaf;
 } ip4_fib_mtrie_t;
 
 void ip4_fib_mtrie_init (ip4_fib_mtrie_t * m);
+void ip4_mtrie_free (ip4_fib_mtrie_t * m);
 
 struct ip4_fib_t;
 
@@ -157,24 +173,34 @@ void ip4_fib_mtrie_add_del_route (struct ip4_fib_t *f,
 /* Returns adjacency index. */
 u32 ip4_mtrie_lookup_address (ip4_fib_mtrie_t * m, ip4_address_t dst);
 
+/* Returns number of bytes of memory used by mtrie. */
+uword ip4_fib_mtrie_memory_usage (ip4_fib_mtrie_t * m);
+
 format_function_t format_ip4_fib_mtrie;
 
-/* Lookup step.  Processes 1 byte of 4 byte ip4 address. */
+/* First lookup step.  Processes the first 2 bytes of the ip4 address. */
+always_inline ip4_fib_mtrie_leaf_t
+ip4_fib_mtrie_lookup_step_one (const ip4_fib_mtrie_t * m,
+			       const ip4_address_t * dst_address)
+{
+  return (m->root_ply->leaves[clib_net_to_host_u16
+			      (dst_address->as_u16[0])]);
+}
+
+/* Lookup step.  Processes byte 2 or 3 of the 4 byte ip4 address. */
 always_inline ip4_fib_mtrie_leaf_t
-ip4_fib_mtrie_lookup_step (ip4_fib_mtrie_t * m,
+ip4_fib_mtrie_lookup_step (const ip4_fib_mtrie_t * m,
 			   ip4_fib_mtrie_leaf_t current_leaf,
 			   const ip4_address_t * dst_address,
 			   u32 dst_address_byte_index)
 {
-  ip4_fib_mtrie_leaf_t next_leaf;
-  ip4_fib_mtrie_ply_t *ply;
-  uword current_is_terminal = ip4_fib_mtrie_leaf_is_terminal (current_leaf);
+  ip4_fib_mtrie_8_ply_t *ply;
 
-  ply = m->ply_pool + (current_is_terminal ? 0 : (current_leaf >> 1));
-  next_leaf = ply->leaves[dst_address->as_u8[dst_address_byte_index]];
-  next_leaf = current_is_terminal ? current_leaf : next_leaf;
+  if (ip4_fib_mtrie_leaf_is_terminal (current_leaf))
+    return (current_leaf);
 
-  return next_leaf;
+  ply = m->ply_pool + (current_leaf >> 1);
+  return (ply->leaves[dst_address->as_u8[dst_address_byte_index]]);
 }
 
 #endif /* included_ip_ip4_fib_h */
@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vnet/ip/ip.h>
+#include <vnet/fib/ip4_fib.h>
+#include <vnet/dpo/drop_dpo.h>
+
+/**
+ * @file
+ * @brief IPv4 16-8-8 mtrie tests.
+ *
+ * First a fixed set of overlapping prefixes, on both sides of the /16
+ * root ply boundary, is added, and its covers are deleted and re-added.
+ * After each step the mtrie must return the expected prefix. Then a
+ * random table with heavy overlap is loaded into a scratch FIB, the
+ * mtrie is checked against the hash based lookup and the lookup rate of
+ * each is reported. Half the routes are deleted and the lookups checked
+ * again. Once every route is deleted the mtrie must be back to the plies
+ * it started with.
+ */
+
+/* Routes to insert/delete in FIB */
+typedef struct
+{
+  ip4_address_t address;
+  u32 mask_width;
+} test_route_t;
+
+#define TEST_NO_ROUTE ((u8) ~0)
+
+/* Fixed routes, in the order they are added */
+static const struct
+{
+  u32 address;
+  u8 mask_width;
+} test_fixed_routes[] =
+{
+  /* 0 */ {0x0a010281, 32},
+  /* 1 */ {0x0a010200, 24},
+  /* 2 */ {0x0a000000, 8},
+  /* 3 */ {0x0a010000, 20},
+  /* 4 */ {0x0a010000, 16},
+  /* 5 */ {0x0a000000, 12},
+  /* 6 */ {0x0a010280, 25},
+};
+
+#define TEST_FIXED_N_STEPS 4
+
+/*
+ * Destinations and the fixed route each must hit:
+ *  0. all routes added
+ *  1. 10.1.0.0/16 and 10.0.0.0/8 deleted
+ *  2. 10.0.0.0/12 deleted
+ *  3. 10.0.0.0/8 re-added
+ */
+static const struct
+{
+  u32 address;
+  u8 route[TEST_FIXED_N_STEPS];
+} test_fixed_dsts[] =
+{
+  {0x0ac80001, {2, TEST_NO_ROUTE, TEST_NO_ROUTE, 2}},
+  {0x0a100000, {2, TEST_NO_ROUTE, TEST_NO_ROUTE, 2}},
+  {0x0a0fffff, {5, 5, TEST_NO_ROUTE, 2}},
+  {0x0a020304, {5, 5, TEST_NO_ROUTE, 2}},
+  {0x0a018001, {4, 5, TEST_NO_ROUTE, 2}},
+  {0x0a010f01, {3, 3, 3, 3}},
+  {0x0a010301, {3, 3, 3, 3}},
+  {0x0a010201, {1, 1, 1, 1}},
+  {0x0a0102c8, {6, 6, 6, 6}},
+  {0x0a010281, {0, 0, 0, 0}},
+  {0x0b000001, {TEST_NO_ROUTE, TEST_NO_ROUTE, TEST_NO_ROUTE,
+		TEST_NO_ROUTE}},
+};
+
+static void
+test_route_to_prefix (const test_route_t * tr, fib_prefix_t * pfx)
+{
+  memset (pfx, 0, sizeof (*pfx));
+  pfx->fp_proto = FIB_PROTOCOL_IP4;
+  pfx->fp_len = tr->mask_width;
+  pfx->fp_addr.ip4 = tr->address;
+}
+
+static void
+test_route_add (u32 fib_index, const test_route_t * tr)
+{
+  fib_prefix_t pfx;
+
+  /* Each entry gets its own load-balance object */
+  test_route_to_prefix (tr, &pfx);
+  fib_table_entry_special_dpo_add (fib_index, &pfx, FIB_SOURCE_API,
+				   FIB_ENTRY_FLAG_EXCLUSIVE,
+				   drop_dpo_get (DPO_PROTO_IP4));
+}
+
+static void
+test_route_del (u32 fib_index, const test_route_t * tr)
+{
+  fib_prefix_t pfx;
+
+  test_route_to_prefix (tr, &pfx);
+  fib_table_entry_special_remove (fib_index, &pfx, FIB_SOURCE_API);
+}
+
+/* Load balance the route forwards with */
+static u32
+test_route_lbi (u32 fib_index, const test_route_t * tr)
+{
+  fib_node_index_t fei;
+  fib_prefix_t pfx;
+
+  test_route_to_prefix (tr, &pfx);
+  fei = fib_table_lookup_exact_match (fib_index, &pfx);
+  if (FIB_NODE_INDEX_INVALID == fei)
+    return (INDEX_INVALID);
+  return (fib_entry_contribute_ip_forwarding (fei)->dpoi_index);
+}
+
+/* A random address covered by the route */
+static void
+test_route_random_address_in (u32 * seed, const test_route_t * tr,
+			      ip4_address_t * a)
+{
+  ip4_main_t *im = &ip4_main;
+
+  a->as_u32 = (tr->address.as_u32 |
+	       (random_u32 (seed) & ~im->fib_masks[tr->mask_width]));
+}
+
+/* Count the destinations for which the mtrie and the hash disagree */
+static u32
+test_ip4_lookup_compare (vlib_main_t * vm, u32 fib_index,
+			 const ip4_address_t * dsts, char *when, int verbose)
+{
+  ip4_fib_t *fib = ip4_fib_get (fib_index);
+  u32 i, lbi_mtrie, lbi_hash, n_mismatches = 0;
+
+  for (i = 0; i < vec_len (dsts); i++)
+    {
+      lbi_mtrie = ip4_fib_forwarding_lookup (fib_index, &dsts[i]);
+      lbi_hash = ip4_fib_table_lookup_lb (fib, &dsts[i]);
+
+      if (lbi_mtrie != lbi_hash)
+	{
+	  if (verbose && n_mismatches < 10)
+	    vlib_cli_output (vm, "FAIL: %U mtrie %d hash %d",
+			     format_ip4_address, &dsts[i],
+			     lbi_mtrie, lbi_hash);
+	  n_mismatches++;
+	}
+    }
+  vlib_cli_output (vm, "%d lookups %s, %d mismatches", vec_len (dsts),
+		   when, n_mismatches);
+  return n_mismatches;
+}
+
+/* Check the fixed destinations against the routes they must hit */
+static u32
+test_ip4_lookup_fixed_check (vlib_main_t * vm, u32 fib_index,
+			     const test_route_t * routes, u32 step,
+			     char *when)
+{
+  ip4_fib_t *fib = ip4_fib_get (fib_index);
+  u32 i, route, lbi, lbi_expected, n_mismatches = 0;
+  ip4_address_t dst;
+
+  for (i = 0; i < ARRAY_LEN (test_fixed_dsts); i++)
+    {
+      dst.as_u32 = clib_host_to_net_u32 (test_fixed_dsts[i].address);
+      route = test_fixed_dsts[i].route[step];
+
+      /* Without a route of ours, whatever covers it in the table */
+      if (TEST_NO_ROUTE == route)
+	lbi_expected = ip4_fib_table_lookup_lb (fib, &dst);
+      else
+	lbi_expected = test_route_lbi (fib_index, &routes[route]);
+
+      lbi = ip4_fib_forwarding_lookup (fib_index, &dst);
+      if (lbi != lbi_expected
+	  || (TEST_NO_ROUTE != route && INDEX_INVALID == lbi_expected))
+	{
+	  vlib_cli_output (vm, "FAIL: %s: %U got %d expected %d", when,
+			   format_ip4_address, &dst, lbi, lbi_expected);
+	  n_mismatches++;
+	}
+    }
+  vlib_cli_output (vm, "%d lookups %s, %d mismatches",
+		   ARRAY_LEN (test_fixed_dsts), when, n_mismatches);
+  return n_mismatches;
+}
+
+static u32
+test_ip4_lookup_fixed (vlib_main_t * vm, u32 fib_index)
+{
+  test_route_t routes[ARRAY_LEN (test_fixed_routes)];
+  u32 i, n_mismatches;
+
+  for (i = 0; i < ARRAY_LEN (test_fixed_routes); i++)
+    {
+      routes[i].address.as_u32 =
+	clib_host_to_net_u32 (test_fixed_routes[i].address);
+      routes[i].mask_width = test_fixed_routes[i].mask_width;
+      test_route_add (fib_index, &routes[i]);
+    }
+  n_mismatches = test_ip4_lookup_fixed_check (vm, fib_index, routes, 0,
+					      "fixed overlapping");
+
+  /* Covers deleted from under the more specifics */
+  test_route_del (fib_index, &routes[4]);
+  test_route_del (fib_index, &routes[2]);
+  n_mismatches += test_ip4_lookup_fixed_check (vm, fib_index, routes, 1,
+					       "fixed covers deleted");
+  test_route_del (fib_index, &routes[5]);
+  n_mismatches += test_ip4_lookup_fixed_check (vm, fib_index, routes, 2,
+					       "fixed /12 deleted");
+
+  /* And a cover re-added under them */
+  test_route_add (fib_index, &routes[2]);
+  n_mismatches += test_ip4_lookup_fixed_check (vm, fib_index, routes, 3,
+					       "fixed cover re-added");
+
+  for (i = 0; i < ARRAY_LEN (test_fixed_routes); i++)
+    if (4 != i && 5 != i)
+      test_route_del (fib_index, &routes[i]);
+
+  return n_mismatches;
+}
+
+/* Number of 8 bit plies in the FIB's mtrie, once deferred frees ran */
+static u32
+test_ip4_mtrie_n_plies (vlib_main_t * vm, u32 fib_index)
+{
+  vlib_worker_thread_epoch_flush (vm);
+  return pool_elts (ip4_fib_get (fib_index)->mtrie.ply_pool);
+}
+
+static clib_error_t *
+test_ip4_lookup (vlib_main_t * vm,
+		 unformat_input_t * main_input, vlib_cli_command_t * cmd_arg)
+{
+  u32 seed = 0xdeaddabe;
+  u32 nroutes = 50000;
+  u32 nlookups = 1000000;
+  u32 table_id = 1000;
+  int verbose = 0;
+  ip4_main_t *im = &ip4_main;
+  test_route_t *routes = 0, *tr;
+  ip4_address_t *dsts = 0, *affected = 0, *dst;
+  uword *route_by_prefix = 0;
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = 0;
+  u32 fib_index, i, n_mismatches, n_plies_empty, n_plies;
+  u64 t0, t1, sum;
+  f64 clocks_per_second, dt;
+
+  if (unformat_user (main_input, unformat_line_input, line_input))
+    {
+      while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+	{
+	  if (unformat (line_input, "seed %d", &seed))
+	    ;
+	  else if (unformat (line_input, "nroutes %d", &nroutes))
+	    ;
+	  else if (unformat (line_input, "nlookups %d", &nlookups))
+	    ;
+	  else if (unformat (line_input, "table %d", &table_id))
+	    ;
+	  else if (unformat (line_input, "verbose"))
+	    verbose = 1;
+	  else
+	    {
+	      error = clib_error_return (0, "unknown input `%U'",
+					 format_unformat_error, line_input);
+	      unformat_free (line_input);
+	      return error;
+	    }
+	}
+      unformat_free (line_input);
+    }
+
+  if (0 == nroutes || 0 == nlookups)
+    return clib_error_return (0, "nroutes and nlookups must be non-zero");
+
+  clocks_per_second = vm->clib_time.clocks_per_second;
+  fib_index = fib_table_find_or_create_and_lock (FIB_PROTOCOL_IP4, table_id);
+  if (fib_table_get_num_entries (fib_index, FIB_PROTOCOL_IP4,
+				 FIB_SOURCE_API))
+    {
+      fib_table_unlock (fib_index, FIB_PROTOCOL_IP4);
+      return clib_error_return (0, "table %d has API routes", table_id);
+    }
+
+  n_plies_empty = test_ip4_mtrie_n_plies (vm, fib_index);
+  vlib_cli_output (vm, "mtrie: %U", format_ip4_fib_mtrie,
+		   &ip4_fib_get (fib_index)->mtrie);
+
+  n_mismatches = test_ip4_lookup_fixed (vm, fib_index);
+  n_plies = test_ip4_mtrie_n_plies (vm, fib_index);
+  vlib_cli_output (vm, "plies: %d before, %d after fixed routes",
+		   n_plies_empty, n_plies);
+  if (n_plies != n_plies_empty)
+    n_mismatches++;
+
+  /*
+   * Pick random, distinct routes in 10.0.0.0/14 with lengths from /8 to
+   * /32, so most of them overlap and cross the /16 root ply boundary.
+   */
+  route_by_prefix = hash_create (0, sizeof (uword));
+  vec_validate (routes, nroutes - 1);
+  for (i = 0; i < nroutes; i++)
+    {
+      tr = vec_elt_at_index (routes, i);
+      do
+	{
+	  tr->mask_width = 8 + random_u32 (&seed) % 25;
+	  tr->address.as_u32 = clib_host_to_net_u32
+	    (0x0a000000 | (random_u32 (&seed) & 0x0003ffff));
+	  tr->address.as_u32 &= im->fib_masks[tr->mask_width];
+	}
+      while (hash_get (route_by_prefix, ((u64) tr->mask_width << 32) |
+		       tr->address.as_u32));
+      hash_set (route_by_prefix, ((u64) tr->mask_width << 32) |
+		tr->address.as_u32, i);
+    }
+
+  t0 = clib_cpu_time_now ();
+  vec_foreach (tr, routes) test_route_add (fib_index, tr);
+  t1 = clib_cpu_time_now ();
+  dt = (t1 - t0) / clocks_per_second;
+  vlib_cli_output (vm, "added %d routes in %.3f sec, %.0f routes/sec",
+		   vec_len (routes), dt, vec_len (routes) / dt);
+  vlib_cli_output (vm, "mtrie: %U", format_ip4_fib_mtrie,
+		   &ip4_fib_get (fib_index)->mtrie);
+
+  /* Half the destinations hit a route, half are anywhere in 10.0.0.0/13 */
+  vec_validate (dsts, nlookups - 1);
+  for (i = 0; i < nlookups; i++)
+    {
+      dsts[i].as_u32 = clib_host_to_net_u32
+	(0x0a000000 | (random_u32 (&seed) & 0x0007ffff));
+      if (i & 1)
+	continue;
+
+      tr = vec_elt_at_index (routes, random_u32 (&seed) % nroutes);
+      test_route_random_address_in (&seed, tr, &dsts[i]);
+    }
+
+  n_mismatches += test_ip4_lookup_compare (vm, fib_index, dsts,
+					   "after adding", verbose);
+
+  /* Time them */
+  sum = 0;
+  t0 = clib_cpu_time_now ();
+  for (i = 0; i < nlookups; i++)
+    sum += ip4_fib_forwarding_lookup (fib_index, &dsts[i]);
+  t1 = clib_cpu_time_now ();
+  dt = (t1 - t0) / clocks_per_second;
+  vlib_cli_output (vm, "mtrie: %.2f Mlookups/sec, %.1f clocks/lookup",
+		   nlookups / dt / 1e6, (f64) (t1 - t0) / nlookups);
+
+  t0 = clib_cpu_time_now ();
+  for (i = 0; i < nlookups; i++)
+    sum -= ip4_fib_table_lookup_lb (ip4_fib_get (fib_index), &dsts[i]);
+  t1 = clib_cpu_time_now ();
+  dt = (t1 - t0) / clocks_per_second;
+  vlib_cli_output (vm, "hash:  %.2f Mlookups/sec, %.1f clocks/lookup",
+		   nlookups / dt / 1e6, (f64) (t1 - t0) / nlookups);
+
+  if (sum != 0)
+    vlib_cli_output (vm, "lookup results differ");
+
+  /* Delete every other route, covers and more specifics alike */
+  for (i = 0; i < nroutes; i += 2)
+    {
+      tr = vec_elt_at_index (routes, i);
+      test_route_del (fib_index, tr);
+      vec_add2 (affected, dst, 2);
+      test_route_random_address_in (&seed, tr, &dst[0]);
+      test_route_random_address_in (&seed, tr, &dst[1]);
+    }
+  n_mismatches += test_ip4_lookup_compare (vm, fib_index, affected,
+					   "after deleting", verbose);
+  n_mismatches += test_ip4_lookup_compare (vm, fib_index, dsts,
+					   "after churn", verbose);
+
+  /* Delete the rest, the last delete in each ply must free it */
+  t0 = clib_cpu_time_now ();
+  for (i = 1; i < nroutes; i += 2)
+    test_route_del (fib_index, vec_elt_at_index (routes, i));
+  t1 = clib_cpu_time_now ();
+  dt = (t1 - t0) / clocks_per_second;
+  vlib_cli_output (vm, "deleted %d routes in %.3f sec, %.0f routes/sec",
+		   nroutes / 2, dt, (nroutes / 2) / dt);
+
+  n_plies = test_ip4_mtrie_n_plies (vm, fib_index);
+  vlib_cli_output (vm, "plies: %d before, %d after deleting all",
+		   n_plies_empty, n_plies);
+  if (n_plies != n_plies_empty)
+    n_mismatches++;
+  vlib_cli_output (vm, "mtrie: %U", format_ip4_fib_mtrie,
+		   &ip4_fib_get (fib_index)->mtrie);
+
+  fib_table_unlock (fib_index, FIB_PROTOCOL_IP4);
+
+  hash_free (route_by_prefix);
+  vec_free (routes);
+  vec_free (dsts);
+  vec_free (affected);
+
+  if (n_mismatches)
+    error = clib_error_return (0, "%d lookup mismatches", n_mismatches);
+
+  return error;
+}
+
+/*?
+ * Check the IPv4 16-8-8 mtrie. A fixed set of overlapping prefixes
+ * either side of /16 is added, then its covers are deleted and one is
+ * re-added, and after each step every probe must hit the expected
+ * prefix. Then a random table of overlapping prefixes is loaded into a
+ * scratch FIB, the forwarding lookup is validated against the hash based
+ * lookup and the lookup rate of each is reported. Half the routes are
+ * deleted and the lookups validated again. After each phase every route
+ * is deleted and the mtrie must hold as many plies as the empty table.
+ *
+ * @cliexpar
+ * Example of how to run:
+ * @cliexcmd{test ip4 lookup nroutes 100000 nlookups 10000000}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_ip4_lookup_command, static) = {
+  .path = "test ip4 lookup",
+  .short_help = "test ip4 lookup [nroutes <n>] [nlookups <n>] [seed <n>] "
+                "[table <table-id>] [verbose]",
+  .function = test_ip4_lookup,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
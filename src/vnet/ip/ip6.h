@@ -44,6 +44,7 @@
 #include <vlib/buffer.h>
 #include <vnet/ethernet/packet.h>
 #include <vnet/ip/ip6_packet.h>
+#include <vnet/ip/ip6_mtrie.h>
 #include <vnet/ip/ip6_hop_by_hop_packet.h>
 #include <vnet/ip/lookup.h>
 #include <stdbool.h>
@@ -74,6 +75,9 @@ typedef struct
 
   /* flow hash configuration */
   flow_hash_config_t flow_hash_config;
+
+  /* Forwarding lookup structure, mirrors the forwarding hash entries */
+  ip6_fib_mtrie_t mtrie;
 } ip6_fib_t;
 
 typedef struct ip6_mfib_t
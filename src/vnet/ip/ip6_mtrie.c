@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vnet/ip/ip.h>
+#include <vnet/fib/ip6_fib.h>
+
+static void
+ply_init (ip6_fib_mtrie_8_ply_t * p, ip6_fib_mtrie_leaf_t init,
+	  uword prefix_len)
+{
+  uword i;
+
+  p->n_non_empty_leafs =
+    ip6_fib_mtrie_leaf_is_empty (init) ? 0 : ARRAY_LEN (p->leaves);
+  memset (p->dst_address_bits_of_leaves, prefix_len,
+	  sizeof (p->dst_address_bits_of_leaves));
+
+  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
+    p->leaves[i] = init;
+}
+
+static ip6_fib_mtrie_leaf_t
+ply_create (ip6_fib_mtrie_t * m, ip6_fib_mtrie_leaf_t init_leaf,
+	    uword prefix_len)
+{
+  ip6_fib_mtrie_8_ply_t *p;
+
+  /* Get cache aligned ply. Workers walk the pool, so don't move it
+     under them. */
+  vlib_worker_thread_pool_get_aligned (m->ply_pool, p, CLIB_CACHE_LINE_BYTES);
+
+  ply_init (p, init_leaf, prefix_len);
+  return ip6_fib_mtrie_leaf_set_next_ply_index (p - m->ply_pool);
+}
+
+always_inline ip6_fib_mtrie_8_ply_t *
+get_next_ply_for_leaf (ip6_fib_mtrie_t * m, ip6_fib_mtrie_leaf_t l)
+{
+  uword n = ip6_fib_mtrie_leaf_get_next_ply_index (l);
+  return pool_elt_at_index (m->ply_pool, n);
+}
+
+static void
+ply_free (ip6_fib_mtrie_t * m, ip6_fib_mtrie_8_ply_t * p)
+{
+  uword i;
+
+  for (i = 0; i < ARRAY_LEN (p->leaves); i++)
+    {
+      ip6_fib_mtrie_leaf_t l = p->leaves[i];
+      if (ip6_fib_mtrie_leaf_is_next_ply (l))
+	ply_free (m, get_next_ply_for_leaf (m, l));
+    }
+
+  pool_put (m->ply_pool, p);
+}
+
+/*
+ * A ply emptied by a delete may still be walked by a worker that read
+ * the leaf before it was cleared; it returns to the pool after an epoch.
+ */
+static void
+ply_put (uword fib_index, uword ply_index)
+{
+  ip6_fib_mtrie_t *m = &ip6_fib_get (fib_index)->mtrie;
+
+  pool_put_index (m->ply_pool, ply_index);
+}
+
+void
+ip6_fib_mtrie_init (ip6_fib_mtrie_t * m)
+{
+  uword i;
+
+  memset (m, 0, sizeof (m[0]));
+  m->default_leaf = IP6_FIB_MTRIE_LEAF_EMPTY;
+  m->root_ply = clib_mem_alloc_aligned (sizeof (m->root_ply[0]),
+					CLIB_CACHE_LINE_BYTES);
+
+  memset (m->root_ply->dst_address_bits_of_leaves, 0,
+	  sizeof (m->root_ply->dst_address_bits_of_leaves));
+  for (i = 0; i < ARRAY_LEN (m->root_ply->leaves); i++)
+    m->root_ply->leaves[i] = IP6_FIB_MTRIE_LEAF_EMPTY;
+}
+
+void
+ip6_fib_mtrie_free (ip6_fib_mtrie_t * m)
+{
+  uword i;
+
+  for (i = 0; i < ARRAY_LEN (m->root_ply->leaves); i++)
+    {
+      ip6_fib_mtrie_leaf_t l = m->root_ply->leaves[i];
+      if (ip6_fib_mtrie_leaf_is_next_ply (l))
+	ply_free (m, get_next_ply_for_leaf (m, l));
+    }
+
+  clib_mem_free (m->root_ply);
+  pool_free (m->ply_pool);
+  memset (m, 0, sizeof (m[0]));
+}
+
+typedef struct
+{
+  ip6_address_t dst_address;
+  u32 dst_address_length;
+  u32 adj_index;
+  u32 fib_index;
+} ip6_fib_mtrie_set_unset_leaf_args_t;
+
+static void
+set_ply_with_more_specific_leaf (ip6_fib_mtrie_t * m,
+				 ip6_fib_mtrie_8_ply_t * ply,
+				 ip6_fib_mtrie_leaf_t new_leaf,
+				 uword new_leaf_dst_address_bits)
+{
+  ip6_fib_mtrie_leaf_t old_leaf;
+  uword i;
+
+  ASSERT (ip6_fib_mtrie_leaf_is_terminal (new_leaf));
+  ASSERT (!ip6_fib_mtrie_leaf_is_empty (new_leaf));
+
+  for (i = 0; i < ARRAY_LEN (ply->leaves); i++)
+    {
+      old_leaf = ply->leaves[i];
+
+      /* Recurse into sub plies. */
+      if (!ip6_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  ip6_fib_mtrie_8_ply_t *sub_ply = get_next_ply_for_leaf (m, old_leaf);
+	  set_ply_with_more_specific_leaf (m, sub_ply, new_leaf,
+					   new_leaf_dst_address_bits);
+	}
+
+      /* Replace less specific terminal leaves with new leaf. */
+      else if (new_leaf_dst_address_bits >=
+	       ply->dst_address_bits_of_leaves[i])
+	{
+	  __sync_val_compare_and_swap (&ply->leaves[i], old_leaf, new_leaf);
+	  ASSERT (ply->leaves[i] == new_leaf);
+	  ply->dst_address_bits_of_leaves[i] = new_leaf_dst_address_bits;
+	  ply->n_non_empty_leafs += ip6_fib_mtrie_leaf_is_empty (old_leaf);
+	}
+    }
+}
+
+static void
+set_leaf (ip6_fib_mtrie_t * m,
+	  ip6_fib_mtrie_set_unset_leaf_args_t * a,
+	  u32 old_ply_index, u32 dst_address_byte_index)
+{
+  ip6_fib_mtrie_leaf_t old_leaf, new_leaf;
+  i32 n_dst_bits_next_plies;
+  u8 dst_byte;
+
+  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 128);
+  ASSERT (dst_address_byte_index >= IP6_FIB_MTRIE_ROOT_PLY_BYTES);
+  ASSERT (dst_address_byte_index < ARRAY_LEN (a->dst_address.as_u8));
+
+  n_dst_bits_next_plies =
+    a->dst_address_length - BITS (u8) * (dst_address_byte_index + 1);
+
+  dst_byte = a->dst_address.as_u8[dst_address_byte_index];
+
+  /* Number of bits next plies <= 0 => insert leaves this ply. */
+  if (n_dst_bits_next_plies <= 0)
+    {
+      uword i, n_dst_bits_this_ply, old_leaf_is_terminal;
+
+      n_dst_bits_this_ply = -n_dst_bits_next_plies;
+      ASSERT ((a->dst_address.as_u8[dst_address_byte_index] &
+	       pow2_mask (n_dst_bits_this_ply)) == 0);
+
+      for (i = dst_byte; i < dst_byte + (1 << n_dst_bits_this_ply); i++)
+	{
+	  ip6_fib_mtrie_8_ply_t *old_ply, *new_ply;
+
+	  old_ply = pool_elt_at_index (m->ply_pool, old_ply_index);
+
+	  old_leaf = old_ply->leaves[i];
+	  old_leaf_is_terminal = ip6_fib_mtrie_leaf_is_terminal (old_leaf);
+
+	  /* Is leaf to be inserted more specific? */
+	  if (a->dst_address_length >= old_ply->dst_address_bits_of_leaves[i])
+	    {
+	      new_leaf = ip6_fib_mtrie_leaf_set_adj_index (a->adj_index);
+
+	      if (old_leaf_is_terminal)
+		{
+		  old_ply->dst_address_bits_of_leaves[i] =
+		    a->dst_address_length;
+		  __sync_val_compare_and_swap (&old_ply->leaves[i], old_leaf,
+					       new_leaf);
+		  ASSERT (old_ply->leaves[i] == new_leaf);
+		  old_ply->n_non_empty_leafs +=
+		    ip6_fib_mtrie_leaf_is_empty (old_leaf);
+		  ASSERT (old_ply->n_non_empty_leafs <=
+			  ARRAY_LEN (old_ply->leaves));
+		}
+	      else
+		{
+		  /* Existing leaf points to another ply.  We need to place
+		     new_leaf into all more specific slots. */
+		  new_ply = get_next_ply_for_leaf (m, old_leaf);
+		  set_ply_with_more_specific_leaf (m, new_ply, new_leaf,
+						   a->dst_address_length);
+		}
+	    }
+
+	  else if (!old_leaf_is_terminal)
+	    {
+	      new_ply = get_next_ply_for_leaf (m, old_leaf);
+	      set_leaf (m, a, new_ply - m->ply_pool,
+			dst_address_byte_index + 1);
+	    }
+	}
+    }
+  else
+    {
+      ip6_fib_mtrie_8_ply_t *old_ply, *new_ply;
+
+      old_ply = pool_elt_at_index (m->ply_pool, old_ply_index);
+      old_leaf = old_ply->leaves[dst_byte];
+      if (ip6_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  new_leaf =
+	    ply_create (m, old_leaf,
+			old_ply->dst_address_bits_of_leaves[dst_byte]);
+	  new_ply = get_next_ply_for_leaf (m, new_leaf);
+
+	  /* Refetch since ply_create may move pool. */
+	  old_ply = pool_elt_at_index (m->ply_pool, old_ply_index);
+
+	  __sync_val_compare_and_swap (&old_ply->leaves[dst_byte], old_leaf,
+				       new_leaf);
+	  ASSERT (old_ply->leaves[dst_byte] == new_leaf);
+	  old_ply->dst_address_bits_of_leaves[dst_byte] = 0;
+
+	  old_ply->n_non_empty_leafs -=
+	    ip6_fib_mtrie_leaf_is_non_empty (old_leaf);
+	  ASSERT (old_ply->n_non_empty_leafs >= 0);
+
+	  /* Account for the ply we just created. */
+	  old_ply->n_non_empty_leafs += 1;
+	}
+      else
+	new_ply = get_next_ply_for_leaf (m, old_leaf);
+
+      set_leaf (m, a, new_ply - m->ply_pool, dst_address_byte_index + 1);
+    }
+}
+
+static void
+set_root_leaf (ip6_fib_mtrie_t * m, ip6_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  ip6_fib_mtrie_16_ply_t *root = m->root_ply;
+  ip6_fib_mtrie_leaf_t old_leaf, new_leaf;
+  i32 n_dst_bits_next_plies;
+  u16 dst_index;
+
+  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 128);
+
+  n_dst_bits_next_plies =
+    a->dst_address_length - BITS (u8) * IP6_FIB_MTRIE_ROOT_PLY_BYTES;
+
+  dst_index = clib_net_to_host_u16 (a->dst_address.as_u16[0]);
+
+  /* Number of bits next plies <= 0 => insert leaves this ply. */
+  if (n_dst_bits_next_plies <= 0)
+    {
+      uword i, n_dst_bits_this_ply;
+
+      n_dst_bits_this_ply = -n_dst_bits_next_plies;
+      ASSERT ((dst_index & pow2_mask (n_dst_bits_this_ply)) == 0);
+
+      new_leaf = ip6_fib_mtrie_leaf_set_adj_index (a->adj_index);
+
+      for (i = dst_index; i < dst_index + (1 << n_dst_bits_this_ply); i++)
+	{
+	  old_leaf = root->leaves[i];
+
+	  if (!ip6_fib_mtrie_leaf_is_terminal (old_leaf))
+	    {
+	      /* Place new_leaf into all more specific slots below. */
+	      set_ply_with_more_specific_leaf (m,
+					       get_next_ply_for_leaf (m,
+								      old_leaf),
+					       new_leaf,
+					       a->dst_address_length);
+	    }
+	  else if (a->dst_address_length >=
+		   root->dst_address_bits_of_leaves[i])
+	    {
+	      root->dst_address_bits_of_leaves[i] = a->dst_address_length;
+	      __sync_val_compare_and_swap (&root->leaves[i], old_leaf,
+					   new_leaf);
+	      ASSERT (root->leaves[i] == new_leaf);
+	    }
+	}
+    }
+  else
+    {
+      ip6_fib_mtrie_8_ply_t *new_ply;
+
+      old_leaf = root->leaves[dst_index];
+      if (ip6_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  new_leaf =
+	    ply_create (m, old_leaf,
+			root->dst_address_bits_of_leaves[dst_index]);
+	  new_ply = get_next_ply_for_leaf (m, new_leaf);
+
+	  __sync_val_compare_and_swap (&root->leaves[dst_index], old_leaf,
+				       new_leaf);
+	  ASSERT (root->leaves[dst_index] == new_leaf);
+	  root->dst_address_bits_of_leaves[dst_index] = 0;
+	}
+      else
+	new_ply = get_next_ply_for_leaf (m, old_leaf);
+
+      set_leaf (m, a, new_ply - m->ply_pool, IP6_FIB_MTRIE_ROOT_PLY_BYTES);
+    }
+}
+
+/*
+ * Empty all leaves belonging to the route. Leaves are matched on their
+ * prefix length, which within the route's range identifies the route
+ * uniquely. Returns non-zero if the ply is left empty, in which case
+ * the caller unlinks it from its parent and frees it.
+ */
+static uword
+unset_leaf (ip6_fib_mtrie_t * m,
+	    ip6_fib_mtrie_set_unset_leaf_args_t * a,
+	    ip6_fib_mtrie_8_ply_t * old_ply, u32 dst_address_byte_index)
+{
+  ip6_fib_mtrie_leaf_t old_leaf;
+  i32 n_dst_bits_next_plies;
+  i32 i, n_dst_bits_this_ply;
+  u8 dst_byte;
+
+  ASSERT (a->dst_address_length > 0 && a->dst_address_length <= 128);
+  ASSERT (dst_address_byte_index < ARRAY_LEN (a->dst_address.as_u8));
+
+  n_dst_bits_next_plies =
+    a->dst_address_length - BITS (u8) * (dst_address_byte_index + 1);
+
+  dst_byte = a->dst_address.as_u8[dst_address_byte_index];
+  if (n_dst_bits_next_plies < 0)
+    dst_byte &= ~pow2_mask (-n_dst_bits_next_plies);
+
+  n_dst_bits_this_ply =
+    n_dst_bits_next_plies <= 0 ? -n_dst_bits_next_plies : 0;
+  n_dst_bits_this_ply = clib_min (8, n_dst_bits_this_ply);
+
+  for (i = dst_byte; i < dst_byte + (1 << n_dst_bits_this_ply); i++)
+    {
+      ip6_fib_mtrie_8_ply_t *sub_ply = 0;
+
+      old_leaf = old_ply->leaves[i];
+
+      if (ip6_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  if (old_ply->dst_address_bits_of_leaves[i] !=
+	      a->dst_address_length)
+	    continue;
+	}
+      else
+	{
+	  sub_ply = get_next_ply_for_leaf (m, old_leaf);
+	  if (!unset_leaf (m, a, sub_ply, dst_address_byte_index + 1))
+	    continue;
+	}
+
+      old_ply->leaves[i] = IP6_FIB_MTRIE_LEAF_EMPTY;
+      old_ply->dst_address_bits_of_leaves[i] = 0;
+
+      /* Free the emptied sub-ply only once it is unreachable. */
+      if (sub_ply)
+	vlib_worker_thread_epoch_defer (ply_put, a->fib_index,
+					sub_ply - m->ply_pool);
+
+      /* No matter what we just deleted a non-empty leaf. */
+      ASSERT (!ip6_fib_mtrie_leaf_is_empty (old_leaf));
+      old_ply->n_non_empty_leafs -= 1;
+      ASSERT (old_ply->n_non_empty_leafs >= 0);
+    }
+
+  return (old_ply->n_non_empty_leafs == 0);
+}
+
+static void
+unset_root_leaf (ip6_fib_mtrie_t * m,
+		 ip6_fib_mtrie_set_unset_leaf_args_t * a)
+{
+  ip6_fib_mtrie_16_ply_t *root = m->root_ply;
+  ip6_fib_mtrie_leaf_t old_leaf;
+  i32 n_dst_bits_next_plies;
+  i32 i, n_dst_bits_this_ply;
+  u16 dst_index;
+
+  n_dst_bits_next_plies =
+    a->dst_address_length - BITS (u8) * IP6_FIB_MTRIE_ROOT_PLY_BYTES;
+
+  dst_index = clib_net_to_host_u16 (a->dst_address.as_u16[0]);
+  n_dst_bits_this_ply =
+    n_dst_bits_next_plies <= 0 ? -n_dst_bits_next_plies : 0;
+
+  for (i = dst_index; i < dst_index + (1 << n_dst_bits_this_ply); i++)
+    {
+      ip6_fib_mtrie_8_ply_t *sub_ply = 0;
+
+      old_leaf = root->leaves[i];
+
+      if (ip6_fib_mtrie_leaf_is_terminal (old_leaf))
+	{
+	  if (root->dst_address_bits_of_leaves[i] != a->dst_address_length)
+	    continue;
+	}
+      else
+	{
+	  sub_ply = get_next_ply_for_leaf (m, old_leaf);
+	  if (!unset_leaf (m, a, sub_ply, IP6_FIB_MTRIE_ROOT_PLY_BYTES))
+	    continue;
+	}
+
+      root->leaves[i] = IP6_FIB_MTRIE_LEAF_EMPTY;
+      root->dst_address_bits_of_leaves[i] = 0;
+
+      if (sub_ply)
+	vlib_worker_thread_epoch_defer (ply_put, a->fib_index,
+					sub_ply - m->ply_pool);
+    }
+}
+
+void
+ip6_fib_mtrie_add_del_route (u32 fib_index,
+			     const ip6_address_t * dst_address,
+			     u32 dst_address_length,
+			     u32 adj_index, u32 is_del,
+			     u32 cover_address_length, u32 cover_adj_index)
+{
+  ip6_fib_mtrie_t *m = &ip6_fib_get (fib_index)->mtrie;
+  ip6_fib_mtrie_set_unset_leaf_args_t a;
+  ip6_main_t *im = &ip6_main;
+
+  ASSERT (m->root_ply != 0);
+
+  /* Honor dst_address_length. Fib masks are in network byte order */
+  a.dst_address.as_u64[0] = (dst_address->as_u64[0] &
+			     im->fib_masks[dst_address_length].as_u64[0]);
+  a.dst_address.as_u64[1] = (dst_address->as_u64[1] &
+			     im->fib_masks[dst_address_length].as_u64[1]);
+  a.dst_address_length = dst_address_length;
+  a.adj_index = adj_index;
+  a.fib_index = fib_index;
+
+  if (!is_del)
+    {
+      if (dst_address_length == 0)
+	m->default_leaf = ip6_fib_mtrie_leaf_set_adj_index (adj_index);
+      else
+	set_root_leaf (m, &a);
+    }
+  else
+    {
+      if (dst_address_length == 0)
+	m->default_leaf = IP6_FIB_MTRIE_LEAF_EMPTY;
+      else
+	{
+	  unset_root_leaf (m, &a);
+
+	  /* Re-insert the next less specific route, if not the default. */
+	  if (cover_address_length > 0)
+	    {
+	      ASSERT (cover_address_length < dst_address_length);
+	      a.dst_address.as_u64[0] &=
+		im->fib_masks[cover_address_length].as_u64[0];
+	      a.dst_address.as_u64[1] &=
+		im->fib_masks[cover_address_length].as_u64[1];
+	      a.dst_address_length = cover_address_length;
+	      a.adj_index = cover_adj_index;
+
+	      set_root_leaf (m, &a);
+	    }
+	}
+    }
+}
+
+uword
+ip6_fib_mtrie_memory_usage (ip6_fib_mtrie_t * m)
+{
+  if (!m->root_ply)
+    return 0;
+
+  return (sizeof (m->root_ply[0]) +
+	  pool_elts (m->ply_pool) * sizeof (m->ply_pool[0]));
+}
+
+u8 *
+format_ip6_fib_mtrie (u8 * s, va_list * va)
+{
+  ip6_fib_mtrie_t *m = va_arg (*va, ip6_fib_mtrie_t *);
+
+  s = format (s, "%d plies, memory usage %U",
+	      pool_elts (m->ply_pool),
+	      format_memory_size, ip6_fib_mtrie_memory_usage (m));
+
+  return s;
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
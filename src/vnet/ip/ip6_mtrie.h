@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_ip_ip6_mtrie_h
+#define included_ip_ip6_mtrie_h
+
+#include <vppinfra/cache.h>
+#include <vppinfra/vector.h>
+#include <vnet/ip/ip6_packet.h>	/* for ip6_address_t */
+
+/**
+ * @file
+ * @brief IPv6 forwarding mtrie.
+ *
+ * A multi-bit trie with a 16 bit first stride followed by up to 14
+ * 8 bit strides, so a lookup costs one dependent memory access per
+ * stride actually present on the path rather than one hash probe per
+ * distinct prefix length in the table. With typical Internet tables,
+ * where prefixes are /48 or shorter, a lookup terminates within 5 plies.
+ *
+ * Leaves use the same encoding as the ip4 mtrie:
+ *  1 + 2*lb_index for terminal leaves.
+ *  0 + 2*next_ply_index for non-terminals.
+ *  1 => empty, the lookup returns the default route.
+ */
+typedef u32 ip6_fib_mtrie_leaf_t;
+
+#define IP6_FIB_MTRIE_LEAF_EMPTY (1 + 2*0)
+
+/** The number of address bytes resolved by the root ply */
+#define IP6_FIB_MTRIE_ROOT_PLY_BYTES 2
+
+always_inline u32
+ip6_fib_mtrie_leaf_is_empty (ip6_fib_mtrie_leaf_t n)
+{
+  return n == IP6_FIB_MTRIE_LEAF_EMPTY;
+}
+
+always_inline u32
+ip6_fib_mtrie_leaf_is_non_empty (ip6_fib_mtrie_leaf_t n)
+{
+  return n != IP6_FIB_MTRIE_LEAF_EMPTY;
+}
+
+always_inline u32
+ip6_fib_mtrie_leaf_is_terminal (ip6_fib_mtrie_leaf_t n)
+{
+  return n & 1;
+}
+
+always_inline u32
+ip6_fib_mtrie_leaf_get_adj_index (ip6_fib_mtrie_leaf_t n)
+{
+  ASSERT (ip6_fib_mtrie_leaf_is_terminal (n));
+  return n >> 1;
+}
+
+always_inline ip6_fib_mtrie_leaf_t
+ip6_fib_mtrie_leaf_set_adj_index (u32 adj_index)
+{
+  ip6_fib_mtrie_leaf_t l;
+  l = 1 + 2 * adj_index;
+  ASSERT (ip6_fib_mtrie_leaf_get_adj_index (l) == adj_index);
+  return l;
+}
+
+always_inline u32
+ip6_fib_mtrie_leaf_is_next_ply (ip6_fib_mtrie_leaf_t n)
+{
+  return (n & 1) == 0;
+}
+
+always_inline u32
+ip6_fib_mtrie_leaf_get_next_ply_index (ip6_fib_mtrie_leaf_t n)
+{
+  ASSERT (ip6_fib_mtrie_leaf_is_next_ply (n));
+  return n >> 1;
+}
+
+always_inline ip6_fib_mtrie_leaf_t
+ip6_fib_mtrie_leaf_set_next_ply_index (u32 i)
+{
+  ip6_fib_mtrie_leaf_t l;
+  l = 0 + 2 * i;
+  ASSERT (ip6_fib_mtrie_leaf_get_next_ply_index (l) == i);
+  return l;
+}
+
+/** One 8 bit ply of the mtrie */
+typedef struct
+{
+  ip6_fib_mtrie_leaf_t leaves[256];
+
+  /* Prefix length for terminal leaves. */
+  u8 dst_address_bits_of_leaves[256];
+
+  /* Number of non-empty leafs (whether terminal or not). */
+  i32 n_non_empty_leafs;
+
+  /* Pad to cache line boundary. */
+  u8 pad[CLIB_CACHE_LINE_BYTES - 1 * sizeof (i32)];
+}
+ip6_fib_mtrie_8_ply_t;
+
+STATIC_ASSERT (0 == sizeof (ip6_fib_mtrie_8_ply_t) % CLIB_CACHE_LINE_BYTES,
+	       "IP6 Mtrie ply cache line");
+
+/** The 16 bit root ply */
+typedef struct
+{
+  ip6_fib_mtrie_leaf_t leaves[1 << 16];
+
+  /* Prefix length for terminal leaves. */
+  u8 dst_address_bits_of_leaves[1 << 16];
+}
+ip6_fib_mtrie_16_ply_t;
+
+typedef struct
+{
+  /* The root ply. Allocated separately since it is large. */
+  ip6_fib_mtrie_16_ply_t *root_ply;
+
+  /* Pool of 8 bit plies. */
+  ip6_fib_mtrie_8_ply_t *ply_pool;
+
+  /* Special case leaf for default route ::/0. */
+  ip6_fib_mtrie_leaf_t default_leaf;
+} ip6_fib_mtrie_t;
+
+void ip6_fib_mtrie_init (ip6_fib_mtrie_t * m);
+void ip6_fib_mtrie_free (ip6_fib_mtrie_t * m);
+
+/**
+ * Add or remove a route in the mtrie of IPv6 FIB fib_index. On removal
+ * the caller provides the next less specific route, which is re-inserted
+ * in place of the removed one; a cover length of zero means the default
+ * route.
+ */
+void ip6_fib_mtrie_add_del_route (u32 fib_index,
+				  const ip6_address_t * dst_address,
+				  u32 dst_address_length,
+				  u32 adj_index, u32 is_del,
+				  u32 cover_address_length,
+				  u32 cover_adj_index);
+
+/** Returns number of bytes of memory used by mtrie. */
+uword ip6_fib_mtrie_memory_usage (ip6_fib_mtrie_t * m);
+
+format_function_t format_ip6_fib_mtrie;
+
+/** Returns the load-balance index for the destination address. */
+always_inline u32
+ip6_fib_mtrie_lookup (const ip6_fib_mtrie_t * m,
+		      const ip6_address_t * dst_address)
+{
+  ip6_fib_mtrie_leaf_t leaf;
+  u32 i;
+
+  leaf =
+    m->root_ply->leaves[clib_net_to_host_u16 (dst_address->as_u16[0])];
+
+  for (i = IP6_FIB_MTRIE_ROOT_PLY_BYTES;
+       !ip6_fib_mtrie_leaf_is_terminal (leaf); i++)
+    {
+      ASSERT (i < ARRAY_LEN (dst_address->as_u8));
+      leaf = m->ply_pool[leaf >> 1].leaves[dst_address->as_u8[i]];
+    }
+
+  leaf = (ip6_fib_mtrie_leaf_is_empty (leaf) ? m->default_leaf : leaf);
+
+  return (ip6_fib_mtrie_leaf_get_adj_index (leaf));
+}
+
+#endif /* included_ip_ip6_mtrie_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
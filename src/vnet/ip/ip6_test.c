@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vnet/ip/ip.h>
+#include <vnet/fib/ip6_fib.h>
+#include <vnet/dpo/drop_dpo.h>
+
+/**
+ * @file
+ * @brief IPv6 FIB lookup microbenchmark.
+ *
+ * Load a synthetic table of random global unicast prefixes, with a
+ * prefix length distribution resembling the IPv6 Internet routing table,
+ * into a scratch FIB. Then make sure the mtrie agrees with the
+ * per-prefix-length hash lookup for a set of random destinations and
+ * report the lookup rate of each. Finally withdraw and cover some of the
+ * routes and check the lookups again where the table changed.
+ */
+
+/* Routes to insert/delete in FIB */
+typedef struct
+{
+  ip6_address_t address;
+  u32 mask_width;
+} test_route_t;
+
+/* Prefix length distribution of the default-free zone, in percent */
+static const struct
+{
+  u8 mask_width;
+  u8 percent;
+} test_route_lengths[] =
+{
+  {48, 40}, {32, 22}, {44, 8}, {40, 6}, {36, 4}, {29, 4}, {47, 3},
+  {46, 3}, {33, 2}, {34, 2}, {35, 1}, {45, 1}, {42, 1}, {64, 1},
+  {56, 1}, {28, 1},
+};
+
+static u32
+test_route_random_mask_width (u32 * seed)
+{
+  u32 i, r;
+
+  r = random_u32 (seed) % 100;
+
+  for (i = 0; i < ARRAY_LEN (test_route_lengths); i++)
+    {
+      if (r < test_route_lengths[i].percent)
+	return (test_route_lengths[i].mask_width);
+      r -= test_route_lengths[i].percent;
+    }
+  return (48);
+}
+
+/* A random address within 2000::/3 */
+static void
+test_route_random_address (u32 * seed, ip6_address_t * a)
+{
+  a->as_u32[0] = random_u32 (seed);
+  a->as_u32[1] = random_u32 (seed);
+  a->as_u32[2] = random_u32 (seed);
+  a->as_u32[3] = random_u32 (seed);
+  a->as_u8[0] = 0x20 | (a->as_u8[0] & 0x1f);
+}
+
+/* A random address covered by the route */
+static void
+test_route_random_address_in (u32 * seed, const test_route_t * tr,
+			      ip6_address_t * a)
+{
+  ip6_main_t *im = &ip6_main;
+
+  test_route_random_address (seed, a);
+  a->as_u64[0] = (tr->address.as_u64[0] |
+		  (a->as_u64[0] & ~im->fib_masks[tr->mask_width].as_u64[0]));
+  a->as_u64[1] = (tr->address.as_u64[1] |
+		  (a->as_u64[1] & ~im->fib_masks[tr->mask_width].as_u64[1]));
+}
+
+static void
+test_route_to_prefix (const test_route_t * tr, fib_prefix_t * pfx)
+{
+  memset (pfx, 0, sizeof (*pfx));
+  pfx->fp_proto = FIB_PROTOCOL_IP6;
+  pfx->fp_len = tr->mask_width;
+  pfx->fp_addr.ip6 = tr->address;
+}
+
+/* Count the destinations for which the mtrie and the hash disagree */
+static u32
+test_ip6_lookup_compare (vlib_main_t * vm, u32 fib_index,
+			 const ip6_address_t * dsts, char *when, int verbose)
+{
+  ip6_main_t *im = &ip6_main;
+  u32 i, lbi_mtrie, lbi_hash, n_mismatches = 0;
+
+  for (i = 0; i < vec_len (dsts); i++)
+    {
+      lbi_mtrie = ip6_fib_table_fwding_lookup (im, fib_index, &dsts[i]);
+      lbi_hash = ip6_fib_table_fwding_lookup_hash (im, fib_index, &dsts[i]);
+
+      if (lbi_mtrie != lbi_hash)
+	{
+	  if (verbose && n_mismatches < 10)
+	    vlib_cli_output (vm, "FAIL: %U mtrie %d hash %d",
+			     format_ip6_address, &dsts[i],
+			     lbi_mtrie, lbi_hash);
+	  n_mismatches++;
+	}
+    }
+  vlib_cli_output (vm, "%d lookups %s, %d mismatches", vec_len (dsts),
+		   when, n_mismatches);
+  return n_mismatches;
+}
+
+static clib_error_t *
+test_ip6_lookup (vlib_main_t * vm,
+		 unformat_input_t * main_input, vlib_cli_command_t * cmd_arg)
+{
+  u32 seed = 0xdeaddabe;
+  u32 nroutes = 50000;
+  u32 nlookups = 1000000;
+  u32 table_id = 1000;
+  int keep = 0, verbose = 0;
+  ip6_main_t *im = &ip6_main;
+  test_route_t *routes = 0, *tr, *covers = 0, *cover;
+  ip6_address_t *dsts = 0, *affected = 0, *dst;
+  uword *route_by_prefix = 0, *cover_by_prefix = 0;
+  unformat_input_t _line_input, *line_input = &_line_input;
+  clib_error_t *error = 0;
+  u32 fib_index, i, n_mismatches, n_covers;
+  u64 t0, t1, sum;
+  f64 clocks_per_second, dt;
+  fib_prefix_t pfx;
+
+  if (unformat_user (main_input, unformat_line_input, line_input))
+    {
+      while (unformat_check_input (line_input) != UNFORMAT_END_OF_INPUT)
+	{
+	  if (unformat (line_input, "seed %d", &seed))
+	    ;
+	  else if (unformat (line_input, "nroutes %d", &nroutes))
+	    ;
+	  else if (unformat (line_input, "nlookups %d", &nlookups))
+	    ;
+	  else if (unformat (line_input, "table %d", &table_id))
+	    ;
+	  else if (unformat (line_input, "keep"))
+	    keep = 1;
+	  else if (unformat (line_input, "verbose"))
+	    verbose = 1;
+	  else
+	    {
+	      error = clib_error_return (0, "unknown input `%U'",
+					 format_unformat_error, line_input);
+	      unformat_free (line_input);
+	      return error;
+	    }
+	}
+      unformat_free (line_input);
+    }
+
+  if (0 == nroutes || 0 == nlookups)
+    return clib_error_return (0, "nroutes and nlookups must be non-zero");
+
+  clocks_per_second = vm->clib_time.clocks_per_second;
+  fib_index = fib_table_find_or_create_and_lock (FIB_PROTOCOL_IP6, table_id);
+
+  /* Pick random, distinct routes */
+  route_by_prefix = hash_create_mem (0, sizeof (test_route_t),
+				     sizeof (uword));
+  vec_validate (routes, nroutes - 1);
+  for (i = 0; i < nroutes; i++)
+    {
+      tr = vec_elt_at_index (routes, i);
+      do
+	{
+	  tr->mask_width = test_route_random_mask_width (&seed);
+	  test_route_random_address (&seed, &tr->address);
+	  ip6_address_mask (&tr->address, &im->fib_masks[tr->mask_width]);
+	}
+      while (hash_get_mem (route_by_prefix, tr));
+      hash_set_mem (route_by_prefix, tr, i);
+    }
+
+  /* Add them; each entry gets its own load-balance object */
+  t0 = clib_cpu_time_now ();
+  vec_foreach (tr, routes)
+  {
+    test_route_to_prefix (tr, &pfx);
+    fib_table_entry_special_dpo_add (fib_index, &pfx, FIB_SOURCE_API,
+				     FIB_ENTRY_FLAG_EXCLUSIVE,
+				     drop_dpo_get (DPO_PROTO_IP6));
+  }
+  t1 = clib_cpu_time_now ();
+  dt = (t1 - t0) / clocks_per_second;
+  vlib_cli_output (vm, "added %d routes in %.3f sec, %.0f routes/sec",
+		   nroutes, dt, nroutes / dt);
+  vlib_cli_output (vm, "mtrie: %U", format_ip6_fib_mtrie,
+		   &ip6_fib_get (fib_index)->mtrie);
+
+  /* Half the destinations hit a route, half are random */
+  vec_validate (dsts, nlookups - 1);
+  for (i = 0; i < nlookups; i++)
+    {
+      test_route_random_address (&seed, &dsts[i]);
+      if (i & 1)
+	continue;
+
+      tr = vec_elt_at_index (routes, random_u32 (&seed) % nroutes);
+      test_route_random_address_in (&seed, tr, &dsts[i]);
+    }
+
+  /* Make sure both lookups agree */
+  n_mismatches = test_ip6_lookup_compare (vm, fib_index, dsts,
+					  "after adding", verbose);
+
+  /* Time them */
+  sum = 0;
+  t0 = clib_cpu_time_now ();
+  for (i = 0; i < nlookups; i++)
+    sum += ip6_fib_table_fwding_lookup (im, fib_index, &dsts[i]);
+  t1 = clib_cpu_time_now ();
+  dt = (t1 - t0) / clocks_per_second;
+  vlib_cli_output (vm, "mtrie: %.2f Mlookups/sec, %.1f clocks/lookup",
+		   nlookups / dt / 1e6, (f64) (t1 - t0) / nlookups);
+
+  t0 = clib_cpu_time_now ();
+  for (i = 0; i < nlookups; i++)
+    sum -= ip6_fib_table_fwding_lookup_hash (im, fib_index, &dsts[i]);
+  t1 = clib_cpu_time_now ();
+  dt = (t1 - t0) / clocks_per_second;
+  vlib_cli_output (vm, "hash:  %.2f Mlookups/sec, %.1f clocks/lookup",
+		   nlookups / dt / 1e6, (f64) (t1 - t0) / nlookups);
+
+  if (sum != 0)
+    vlib_cli_output (vm, "lookup results differ");
+
+  /*
+   * Withdraw every fourth route, so the mtrie has to fall back to
+   * whatever covers it, then cover each with a shorter prefix, put the
+   * withdrawn routes back underneath and finally remove the covers
+   * again. After each step check addresses within the affected prefixes.
+   */
+  n_covers = 0;
+  vec_validate (covers, nroutes / 4);
+  cover_by_prefix = hash_create_mem (0, sizeof (test_route_t),
+				     sizeof (uword));
+  for (i = 0; i < nroutes; i += 4)
+    {
+      tr = vec_elt_at_index (routes, i);
+      test_route_to_prefix (tr, &pfx);
+      fib_table_entry_special_remove (fib_index, &pfx, FIB_SOURCE_API);
+      vec_add2 (affected, dst, 2);
+      test_route_random_address_in (&seed, tr, &dst[0]);
+      test_route_random_address_in (&seed, tr, &dst[1]);
+
+      cover = vec_elt_at_index (covers, n_covers);
+      cover->address = tr->address;
+      cover->mask_width = clib_max (tr->mask_width, 24) - 8;
+      ip6_address_mask (&cover->address, &im->fib_masks[cover->mask_width]);
+      if (hash_get_mem (route_by_prefix, cover)
+	  || hash_get_mem (cover_by_prefix, cover))
+	continue;
+      hash_set_mem (cover_by_prefix, cover, n_covers);
+      n_covers++;
+    }
+  _vec_len (covers) = n_covers;
+  n_mismatches += test_ip6_lookup_compare (vm, fib_index, affected,
+					   "after deleting", verbose);
+
+  vec_foreach (cover, covers)
+  {
+    test_route_to_prefix (cover, &pfx);
+    fib_table_entry_special_dpo_add (fib_index, &pfx, FIB_SOURCE_API,
+				     FIB_ENTRY_FLAG_EXCLUSIVE,
+				     drop_dpo_get (DPO_PROTO_IP6));
+    vec_add2 (affected, dst, 2);
+    test_route_random_address_in (&seed, cover, &dst[0]);
+    test_route_random_address_in (&seed, cover, &dst[1]);
+  }
+  n_mismatches += test_ip6_lookup_compare (vm, fib_index, affected,
+					   "after adding covers", verbose);
+
+  for (i = 0; i < nroutes; i += 4)
+    {
+      tr = vec_elt_at_index (routes, i);
+      test_route_to_prefix (tr, &pfx);
+      fib_table_entry_special_dpo_add (fib_index, &pfx, FIB_SOURCE_API,
+				       FIB_ENTRY_FLAG_EXCLUSIVE,
+				       drop_dpo_get (DPO_PROTO_IP6));
+    }
+  n_mismatches += test_ip6_lookup_compare (vm, fib_index, affected,
+					   "after re-adding", verbose);
+
+  vec_foreach (cover, covers)
+  {
+    test_route_to_prefix (cover, &pfx);
+    fib_table_entry_special_remove (fib_index, &pfx, FIB_SOURCE_API);
+  }
+  n_mismatches += test_ip6_lookup_compare (vm, fib_index, affected,
+					   "after deleting covers", verbose);
+  n_mismatches += test_ip6_lookup_compare (vm, fib_index, dsts,
+					   "after churn", verbose);
+
+  if (!keep)
+    {
+      /* Delete them */
+      t0 = clib_cpu_time_now ();
+      vec_foreach (tr, routes)
+      {
+	test_route_to_prefix (tr, &pfx);
+	fib_table_entry_special_remove (fib_index, &pfx, FIB_SOURCE_API);
+      }
+      t1 = clib_cpu_time_now ();
+      dt = (t1 - t0) / clocks_per_second;
+      vlib_cli_output (vm, "deleted %d routes in %.3f sec, %.0f routes/sec",
+		       nroutes, dt, nroutes / dt);
+      vlib_cli_output (vm, "mtrie: %U", format_ip6_fib_mtrie,
+		       &ip6_fib_get (fib_index)->mtrie);
+
+      fib_table_unlock (fib_index, FIB_PROTOCOL_IP6);
+    }
+
+  hash_free (route_by_prefix);
+  hash_free (cover_by_prefix);
+  vec_free (routes);
+  vec_free (covers);
+  vec_free (dsts);
+  vec_free (affected);
+
+  if (n_mismatches)
+    error = clib_error_return (0, "%d lookup mismatches", n_mismatches);
+
+  return error;
+}
+
+/*?
+ * Load a synthetic IPv6 table of random prefixes into a scratch FIB,
+ * validate the forwarding lookup against the hash based lookup and
+ * report the lookup rate of each. Then delete a quarter of the routes,
+ * cover them with shorter prefixes, re-add them and delete the covers,
+ * validating the lookup for the affected addresses after each step.
+ * The routes are removed again unless
+ * <em>keep</em> is given.
+ *
+ * @cliexpar
+ * Example of how to run:
+ * @cliexcmd{test ip6 lookup nroutes 100000 nlookups 10000000}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_ip6_lookup_command, static) = {
+  .path = "test ip6 lookup",
+  .short_help = "test ip6 lookup [nroutes <n>] [nlookups <n>] [seed <n>] "
+                "[table <table-id>] [keep] [verbose]",
+  .function = test_ip6_lookup,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
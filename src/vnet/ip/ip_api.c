@@ -1657,6 +1657,12 @@ ip_api_hookup (vlib_main_t * vm)
   foreach_ip_api_msg;
 #undef _
 
+  /*
+   * Route add/del runs without the barrier; the FIB takes it only
+   * when a structure the workers read would be reallocated.
+   */
+  am->is_mp_safe[VL_API_IP_ADD_DEL_ROUTE] = 1;
+
   /*
    * Set up the (msg_name, crc, message-id) table
    */
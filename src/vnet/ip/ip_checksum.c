@@ -39,6 +39,227 @@
 
 #include <vnet/ip/ip.h>
 
+#if defined (__x86_64__)
+#include <x86intrin.h>
+#define IP_CSUM_HAVE_BULK 1
+#elif defined (__aarch64__) && defined (__ARM_NEON)
+#include <arm_neon.h>
+#define IP_CSUM_HAVE_BULK 1
+#endif
+
+#ifdef IP_CSUM_HAVE_BULK
+
+/*
+ * Vector kernels for the bulk of long checksums. 16 bit words are summed
+ * into 32 bit lanes, which are widened before they can overflow. The
+ * result is congruent to the scalar ip_csum_t sum modulo 0xffff, as long
+ * as vectors are loaded at the same even offsets the scalar loop uses, so
+ * callers can mix the two.
+ */
+
+/** Kernels take multiples of this many bytes */
+#define IP_CSUM_BULK_ALIGN 32
+
+/** Shorter runs are not worth an indirect call */
+#define IP_CSUM_BULK_MIN_BYTES 128
+
+/** Bytes summed into 32 bit lanes before widening, each 32 byte step adds
+ * at most 2 * 0xffff to a lane */
+#define IP_CSUM_BULK_BLOCK_BYTES (32 << 10)
+
+/* Sum, and copy if dst is not 0, n_bytes from src */
+typedef ip_csum_t (ip_csum_bulk_function_t) (void *dst, void *src,
+					     uword n_bytes);
+
+#if defined (__x86_64__)
+
+static_always_inline __attribute__ ((target ("avx2"))) ip_csum_t
+ip_csum_bulk_avx2_inline (void *dst, void *src, uword n_bytes, int is_copy)
+{
+  __m256i mask = _mm256_set1_epi32 (0xffff);
+  __m256i acc, v;
+  u32 lanes[8] __attribute__ ((aligned (32)));
+  ip_csum_t sum = 0;
+  uword n;
+  int i;
+
+  while (n_bytes)
+    {
+      n = clib_min (n_bytes, IP_CSUM_BULK_BLOCK_BYTES);
+      n_bytes -= n;
+      acc = _mm256_setzero_si256 ();
+
+      for (; n; n -= 32)
+	{
+	  v = _mm256_loadu_si256 ((__m256i *) src);
+	  if (is_copy)
+	    {
+	      _mm256_storeu_si256 ((__m256i *) dst, v);
+	      dst += 32;
+	    }
+	  acc = _mm256_add_epi32 (acc, _mm256_and_si256 (v, mask));
+	  acc = _mm256_add_epi32 (acc, _mm256_srli_epi32 (v, 16));
+	  src += 32;
+	}
+
+      _mm256_store_si256 ((__m256i *) lanes, acc);
+      for (i = 0; i < ARRAY_LEN (lanes); i++)
+	sum += lanes[i];
+    }
+
+  return sum;
+}
+
+static __attribute__ ((target ("avx2"))) ip_csum_t
+ip_csum_bulk_avx2 (void *dst, void *src, uword n_bytes)
+{
+  return ip_csum_bulk_avx2_inline (0, src, n_bytes, 0 /* is_copy */ );
+}
+
+static __attribute__ ((target ("avx2"))) ip_csum_t
+ip_csum_and_memcpy_bulk_avx2 (void *dst, void *src, uword n_bytes)
+{
+  return ip_csum_bulk_avx2_inline (dst, src, n_bytes, 1 /* is_copy */ );
+}
+
+/* SSE2 is part of the x86_64 baseline, use it when avx2 is missing */
+static_always_inline ip_csum_t
+ip_csum_bulk_sse2_inline (void *dst, void *src, uword n_bytes, int is_copy)
+{
+  __m128i mask = _mm_set1_epi32 (0xffff);
+  __m128i acc0, acc1, v0, v1;
+  u32 lanes[4] __attribute__ ((aligned (16)));
+  ip_csum_t sum = 0;
+  uword n;
+  int i;
+
+  while (n_bytes)
+    {
+      n = clib_min (n_bytes, IP_CSUM_BULK_BLOCK_BYTES);
+      n_bytes -= n;
+      acc0 = acc1 = _mm_setzero_si128 ();
+
+      for (; n; n -= 32)
+	{
+	  v0 = _mm_loadu_si128 ((__m128i *) src);
+	  v1 = _mm_loadu_si128 ((__m128i *) (src + 16));
+	  if (is_copy)
+	    {
+	      _mm_storeu_si128 ((__m128i *) dst, v0);
+	      _mm_storeu_si128 ((__m128i *) (dst + 16), v1);
+	      dst += 32;
+	    }
+	  acc0 = _mm_add_epi32 (acc0, _mm_and_si128 (v0, mask));
+	  acc0 = _mm_add_epi32 (acc0, _mm_srli_epi32 (v0, 16));
+	  acc1 = _mm_add_epi32 (acc1, _mm_and_si128 (v1, mask));
+	  acc1 = _mm_add_epi32 (acc1, _mm_srli_epi32 (v1, 16));
+	  src += 32;
+	}
+
+      _mm_store_si128 ((__m128i *) lanes, acc0);
+      for (i = 0; i < ARRAY_LEN (lanes); i++)
+	sum += lanes[i];
+      _mm_store_si128 ((__m128i *) lanes, acc1);
+      for (i = 0; i < ARRAY_LEN (lanes); i++)
+	sum += lanes[i];
+    }
+
+  return sum;
+}
+
+static ip_csum_t
+ip_csum_bulk_sse2 (void *dst, void *src, uword n_bytes)
+{
+  return ip_csum_bulk_sse2_inline (0, src, n_bytes, 0 /* is_copy */ );
+}
+
+static ip_csum_t
+ip_csum_and_memcpy_bulk_sse2 (void *dst, void *src, uword n_bytes)
+{
+  return ip_csum_bulk_sse2_inline (dst, src, n_bytes, 1 /* is_copy */ );
+}
+
+#elif defined (__aarch64__)
+
+static_always_inline ip_csum_t
+ip_csum_bulk_neon_inline (void *dst, void *src, uword n_bytes, int is_copy)
+{
+  uint32x4_t acc0, acc1;
+  uint16x8_t v0, v1;
+  ip_csum_t sum = 0;
+  uword n;
+
+  while (n_bytes)
+    {
+      n = clib_min (n_bytes, IP_CSUM_BULK_BLOCK_BYTES);
+      n_bytes -= n;
+      acc0 = acc1 = vdupq_n_u32 (0);
+
+      for (; n; n -= 32)
+	{
+	  v0 = vld1q_u16 ((u16 *) src);
+	  v1 = vld1q_u16 ((u16 *) (src + 16));
+	  if (is_copy)
+	    {
+	      vst1q_u16 ((u16 *) dst, v0);
+	      vst1q_u16 ((u16 *) (dst + 16), v1);
+	      dst += 32;
+	    }
+	  /* Pairwise add 16 bit words into 32 bit lanes */
+	  acc0 = vpadalq_u16 (acc0, v0);
+	  acc1 = vpadalq_u16 (acc1, v1);
+	  src += 32;
+	}
+
+      sum += vaddlvq_u32 (acc0) + vaddlvq_u32 (acc1);
+    }
+
+  return sum;
+}
+
+static ip_csum_t
+ip_csum_bulk_neon (void *dst, void *src, uword n_bytes)
+{
+  return ip_csum_bulk_neon_inline (0, src, n_bytes, 0 /* is_copy */ );
+}
+
+static ip_csum_t
+ip_csum_and_memcpy_bulk_neon (void *dst, void *src, uword n_bytes)
+{
+  return ip_csum_bulk_neon_inline (dst, src, n_bytes, 1 /* is_copy */ );
+}
+
+#endif
+
+/* Kernels for this cpu, selected at startup */
+static ip_csum_bulk_function_t *ip_csum_bulk;
+static ip_csum_bulk_function_t *ip_csum_and_memcpy_bulk;
+
+/* Force scalar code, e.g., to benchmark the kernels against it */
+static u8 ip_csum_bulk_disabled;
+
+static void __attribute__ ((__constructor__))
+ip_csum_bulk_select (void)
+{
+#if defined (__x86_64__)
+  if (clib_cpu_supports_avx2 ())
+    {
+      ip_csum_bulk = ip_csum_bulk_avx2;
+      ip_csum_and_memcpy_bulk = ip_csum_and_memcpy_bulk_avx2;
+    }
+  else
+    {
+      ip_csum_bulk = ip_csum_bulk_sse2;
+      ip_csum_and_memcpy_bulk = ip_csum_and_memcpy_bulk_sse2;
+    }
+#else
+  ip_csum_bulk = ip_csum_bulk_neon;
+  ip_csum_and_memcpy_bulk = ip_csum_and_memcpy_bulk_neon;
+#endif
+}
+
+#endif /* IP_CSUM_HAVE_BULK */
+
 ip_csum_t
 ip_incremental_checksum (ip_csum_t sum, void *_data, uword n_bytes)
 {
@@ -68,6 +289,19 @@ do {						\
 
 #undef _
 
+#ifdef IP_CSUM_HAVE_BULK
+  if (n_bytes >= IP_CSUM_BULK_MIN_BYTES && !ip_csum_bulk_disabled)
+    {
+      uword n_bulk = n_bytes & ~(IP_CSUM_BULK_ALIGN - 1);
+
+      sum1 = ip_csum_with_carry (sum1, ip_csum_bulk (0, uword_to_pointer
+						       (data, void *),
+						       n_bulk));
+      data += n_bulk;
+      n_bytes -= n_bulk;
+    }
+#endif
+
   {
     ip_csum_t *d = uword_to_pointer (data, ip_csum_t *);
 
@@ -143,6 +377,19 @@ ip_csum_and_memcpy (ip_csum_t sum, void *dst, void *src, uword n_bytes)
       n_left -= sizeof (u16);
     }
 
+#ifdef IP_CSUM_HAVE_BULK
+  if (n_left >= IP_CSUM_BULK_MIN_BYTES && !ip_csum_bulk_disabled)
+    {
+      uword n_bulk = n_left & ~(IP_CSUM_BULK_ALIGN - 1);
+
+      sum0 = ip_csum_with_carry (sum0, ip_csum_and_memcpy_bulk (dst, src,
+								n_bulk));
+      dst += n_bulk;
+      src += n_bulk;
+      n_left -= n_bulk;
+    }
+#endif
+
   sum1 = 0;
   while (n_left >= 2 * sizeof (sum))
     {
@@ -219,6 +466,129 @@ ip_csum_and_memcpy (ip_csum_t sum, void *dst, void *src, uword n_bytes)
   return sum0;
 }
 
+#ifdef IP_CSUM_HAVE_BULK
+
+/* Keeps the compiler from dropping benchmark loops */
+static volatile ip_csum_t ip_csum_bench_result;
+
+/* Cycles per byte of n_iter runs of checksum, or copy and checksum */
+static f64
+ip_csum_bench (u8 * dst, u8 * src, uword n_bytes, u32 n_iter, int is_copy)
+{
+  ip_csum_t sum = 0;
+  u64 t0;
+  u32 i;
+
+  t0 = clib_cpu_time_now ();
+  for (i = 0; i < n_iter; i++)
+    sum += is_copy ? ip_csum_and_memcpy (sum, dst, src, n_bytes) :
+      ip_incremental_checksum (sum, src, n_bytes);
+
+  ip_csum_bench_result = sum;
+
+  return (f64) (clib_cpu_time_now () - t0) / ((f64) n_iter * n_bytes);
+}
+
+static clib_error_t *
+test_ip_checksum_command_fn (vlib_main_t * vm,
+			     unformat_input_t * input,
+			     vlib_cli_command_t * cmd)
+{
+  static u32 sizes[] = { 64, 128, 256, 512, 1024, 1500, 4096, 9216 };
+  u32 n_iter = 100000, seed = 0xdeadbeef, offset, i, j;
+  clib_error_t *error = 0;
+  f64 scalar[2], vector[2];
+  u8 *src = 0, *dst = 0;
+  u16 sum0, sum1;
+  int is_copy;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "iterations %d", &n_iter))
+	;
+      else if (unformat (input, "seed %d", &seed))
+	;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  vec_validate_aligned (src, sizes[ARRAY_LEN (sizes) - 1] + 8,
+			CLIB_CACHE_LINE_BYTES);
+  vec_validate_aligned (dst, sizes[ARRAY_LEN (sizes) - 1] + 8,
+			CLIB_CACHE_LINE_BYTES);
+  for (i = 0; i < vec_len (src); i++)
+    src[i] = random_u32 (&seed);
+
+  /* Kernels must agree with the scalar code at all alignments */
+  for (i = 0; i < ARRAY_LEN (sizes); i++)
+    for (offset = 0; offset < 8; offset++)
+      for (is_copy = 0; is_copy < 2; is_copy++)
+	{
+	  ip_csum_bulk_disabled = 1;
+	  sum0 = ip_csum_fold (is_copy ?
+			       ip_csum_and_memcpy (0, dst + offset,
+						   src + offset, sizes[i]) :
+			       ip_incremental_checksum (0, src + offset,
+							sizes[i]));
+	  ip_csum_bulk_disabled = 0;
+	  sum1 = ip_csum_fold (is_copy ?
+			       ip_csum_and_memcpy (0, dst + offset,
+						   src + offset, sizes[i]) :
+			       ip_incremental_checksum (0, src + offset,
+							sizes[i]));
+	  if (sum0 != sum1 || (is_copy && memcmp (dst + offset, src + offset,
+						  sizes[i])))
+	    {
+	      error = clib_error_return (0, "%s mismatch: %d bytes at offset "
+					 "%d, scalar 0x%x vector 0x%x",
+					 is_copy ? "copy" : "checksum",
+					 sizes[i], offset, sum0, sum1);
+	      goto done;
+	    }
+	}
+
+  vlib_cli_output (vm, "%=8s%=24s%=24s", "", "checksum", "copy+checksum");
+  vlib_cli_output (vm, "%=8s%=12s%=12s%=12s%=12s", "bytes", "scalar",
+		   "vector", "scalar", "vector");
+  for (i = 0; i < ARRAY_LEN (sizes); i++)
+    {
+      for (j = 0; j < 2; j++)
+	{
+	  ip_csum_bulk_disabled = 1;
+	  scalar[j] = ip_csum_bench (dst, src, sizes[i], n_iter, j);
+	  ip_csum_bulk_disabled = 0;
+	  vector[j] = ip_csum_bench (dst, src, sizes[i], n_iter, j);
+	}
+      vlib_cli_output (vm, "%=8d%=12.3f%=12.3f%=12.3f%=12.3f", sizes[i],
+		       scalar[0], vector[0], scalar[1], vector[1]);
+    }
+  vlib_cli_output (vm, "cycles per byte, %d iterations", n_iter);
+
+done:
+  vec_free (src);
+  vec_free (dst);
+  return error;
+}
+
+/*?
+ * Check the vector checksum kernels against the scalar code and compare
+ * their speed, in cycles per byte, for 64 to 9216 byte payloads.
+ *
+ * @cliexpar
+ * @cliexcmd{test ip checksum iterations 100000}
+?*/
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (test_ip_checksum_command, static) =
+{
+  .path = "test ip checksum",
+  .short_help = "test ip checksum [iterations <n>] [seed <n>]",
+  .function = test_ip_checksum_command_fn,
+};
+/* *INDENT-ON* */
+
+#endif /* IP_CSUM_HAVE_BULK */
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
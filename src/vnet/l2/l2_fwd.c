@@ -195,6 +195,38 @@ l2fwd_process (vlib_main_t * vm,
 }
 
 
+/**
+ * Look up the destination MAC of every packet in the frame with one
+ * batched, prefetch-pipelined mac table search. Misses return ~0.
+ */
+static_always_inline void
+l2fwd_lookup_frame (vlib_main_t * vm, l2fwd_main_t * msm,
+		    u32 * from, u32 n_buffers, BVT (clib_bihash_kv) * kvs)
+{
+  vlib_buffer_t *b0;
+  ethernet_header_t *h0;
+  u32 i;
+
+  for (i = 0; i < n_buffers; i++)
+    {
+      if (i + 4 < n_buffers)
+	{
+	  vlib_buffer_t *p4 = vlib_get_buffer (vm, from[i + 4]);
+	  vlib_prefetch_buffer_header (p4, LOAD);
+	  CLIB_PREFETCH (p4->data, CLIB_CACHE_LINE_BYTES, LOAD);
+	}
+
+      b0 = vlib_get_buffer (vm, from[i]);
+      h0 = vlib_buffer_get_current (b0);
+      kvs[i].key = l2fib_make_key (h0->dst_address,
+				   vnet_buffer (b0)->l2.bd_index);
+      kvs[i].value = ~0ULL;
+    }
+
+  BV (clib_bihash_search_batch) (msm->mac_table, kvs, 0 /* hits */ ,
+				 n_buffers);
+}
+
 static_always_inline uword
 l2fwd_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 		   vlib_frame_t * frame, int do_trace)
@@ -205,17 +237,14 @@ l2fwd_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
   vlib_node_t *n = vlib_get_node (vm, l2fwd_node.index);
   CLIB_UNUSED (u32 node_counter_base_index) = n->error_heap_index;
   vlib_error_main_t *em = &vm->error_main;
-  l2fib_entry_key_t cached_key;
-  l2fib_entry_result_t cached_result;
-
-  /* Clear the one-entry cache in case mac table was updated */
-  cached_key.raw = ~0;
-  cached_result.raw = ~0;
+  BVT (clib_bihash_kv) kvs[VLIB_FRAME_SIZE], *kv = kvs;
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;	/* number of packets to process */
   next_index = node->cached_next_index;
 
+  l2fwd_lookup_frame (vm, msm, from, n_left_from, kvs);
+
   while (n_left_from > 0)
     {
       u32 n_left_to_next;
@@ -230,9 +259,7 @@ l2fwd_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	  u32 next0, next1, next2, next3;
 	  u32 sw_if_index0, sw_if_index1, sw_if_index2, sw_if_index3;
 	  ethernet_header_t *h0, *h1, *h2, *h3;
-	  l2fib_entry_key_t key0, key1, key2, key3;
 	  l2fib_entry_result_t result0, result1, result2, result3;
-	  u32 bucket0, bucket1, bucket2, bucket3;
 
 	  /* Prefetch next iteration. */
 	  {
@@ -325,27 +352,12 @@ l2fwd_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 #ifdef COUNTERS
 	  em->counters[node_counter_base_index + L2FWD_ERROR_L2FWD] += 4;
 #endif
-	  /* *INDENT-OFF* */
-	  l2fib_lookup_4 (msm->mac_table, &cached_key, &cached_result,
-			  h0->dst_address, h1->dst_address,
-			  h2->dst_address, h3->dst_address,
-			  vnet_buffer (b0)->l2.bd_index,
-			  vnet_buffer (b1)->l2.bd_index,
-			  vnet_buffer (b2)->l2.bd_index,
-			  vnet_buffer (b3)->l2.bd_index,
-			  &key0,	/* not used */
-			  &key1,	/* not used */
-			  &key2,	/* not used */
-			  &key3,	/* not used */
-			  &bucket0,	/* not used */
-			  &bucket1,	/* not used */
-			  &bucket2,	/* not used */
-			  &bucket3,	/* not used */
-			  &result0,
-			  &result1,
-			  &result2,
-			  &result3);
-	  /* *INDENT-ON* */
+	  result0.raw = kv[0].value;
+	  result1.raw = kv[1].value;
+	  result2.raw = kv[2].value;
+	  result3.raw = kv[3].value;
+	  kv += 4;
+
 	  l2fwd_process (vm, node, msm, em, b0, sw_if_index0, &result0,
 			 &next0);
 	  l2fwd_process (vm, node, msm, em, b1, sw_if_index1, &result1,
@@ -370,9 +382,7 @@ l2fwd_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	  u32 next0;
 	  u32 sw_if_index0;
 	  ethernet_header_t *h0;
-	  l2fib_entry_key_t key0;
 	  l2fib_entry_result_t result0;
-	  u32 bucket0;
 
 	  /* speculatively enqueue b0 to the current next frame */
 	  bi0 = from[0];
@@ -401,9 +411,9 @@ l2fwd_node_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 #ifdef COUNTERS
 	  em->counters[node_counter_base_index + L2FWD_ERROR_L2FWD] += 1;
 #endif
-	  l2fib_lookup_1 (msm->mac_table, &cached_key, &cached_result, h0->dst_address, vnet_buffer (b0)->l2.bd_index, &key0,	/* not used */
-			  &bucket0,	/* not used */
-			  &result0);
+	  result0.raw = kv[0].value;
+	  kv += 1;
+
 	  l2fwd_process (vm, node, msm, em, b0, sw_if_index0, &result0,
 			 &next0);
 
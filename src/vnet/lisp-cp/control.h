@@ -17,6 +17,7 @@
 #define VNET_CONTROL_H_
 
 #include <vnet/vnet.h>
+#include <vppinfra/timing_wheel.h>
 #include <vnet/lisp-cp/gid_dictionary.h>
 #include <vnet/lisp-cp/lisp_types.h>
 
@@ -14,7 +14,11 @@
  */
 
 #include <vnet/session/application.h>
+#include <vnet/session/application_interface.h>
 #include <vnet/session/session.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 /*
  * Pool from which we allocate all applications
@@ -26,6 +30,23 @@ static application_t *app_pool;
  */
 static uword *app_by_api_client_index;
 
+/*
+ * Event rings and eventfds of an api client, shared by all its apps
+ */
+typedef struct
+{
+  svm_event_ring_t **rings;
+  int *fds;
+  u32 api_client_index;
+  /** The client's apps, and the client itself while connected */
+  u32 n_refs;
+} app_event_rings_t;
+
+static app_event_rings_t *app_event_rings_pool;
+static uword *app_event_rings_by_api_client_index;
+
+static void application_event_rings_release (application_t * app);
+
 int
 application_api_queue_is_full (application_t * app)
 {
@@ -87,6 +108,8 @@ application_del (application_t * app)
     unix_shared_memory_queue_free (app->event_queue);
   svm_pop_heap (oldheap);
 
+  application_event_rings_release (app);
+
   application_table_del (app);
 
   pool_put (app_pool, app);
@@ -150,6 +173,7 @@ application_new (application_type_t type, session_type_t sst,
 
   app->mode = type;
   app->index = application_get_index (app);
+  app->event_rings_index = ~0;
   app->session_type = sst;
   app->api_client_index = api_client_index;
   app->flags = flags;
@@ -164,6 +188,228 @@ application_new (application_type_t type, session_type_t sst,
   return app;
 }
 
+/**
+ * Hand the api client its eventfds, one per vpp thread, as SCM_RIGHTS
+ * ancillary data on a datagram sent to the abstract unix socket named
+ * after its pid, see SESSION_EVT_SOCKET_FMT. The datagram body is the
+ * number of fds.
+ */
+static int
+application_send_event_fds (u32 api_client_index, int *fds)
+{
+  unix_shared_memory_queue_t *q;
+  struct sockaddr_un sun;
+  struct cmsghdr *cmsg;
+  struct msghdr mh;
+  struct iovec iov;
+  u32 n_fds = vec_len (fds);
+  u8 *ctl = 0;
+  int fd, len, rv = 0;
+
+  q = vl_api_client_index_to_input_queue (api_client_index);
+  if (!q)
+    return VNET_API_ERROR_INVALID_VALUE_2;
+
+  memset (&sun, 0, sizeof (sun));
+  sun.sun_family = AF_UNIX;
+  len = snprintf (sun.sun_path + 1, sizeof (sun.sun_path) - 1,
+		  SESSION_EVT_SOCKET_FMT, q->consumer_pid);
+
+  vec_validate (ctl, CMSG_SPACE (n_fds * sizeof (int)) - 1);
+  iov.iov_base = &n_fds;
+  iov.iov_len = sizeof (n_fds);
+
+  memset (&mh, 0, sizeof (mh));
+  mh.msg_name = &sun;
+  mh.msg_namelen = offsetof (struct sockaddr_un, sun_path) + 1 + len;
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+  mh.msg_control = ctl;
+  mh.msg_controllen = vec_len (ctl);
+
+  cmsg = CMSG_FIRSTHDR (&mh);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (n_fds * sizeof (int));
+  clib_memcpy (CMSG_DATA (cmsg), fds, n_fds * sizeof (int));
+
+  fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    {
+      rv = VNET_API_ERROR_SYSCALL_ERROR_2;
+      goto done;
+    }
+
+  if (sendmsg (fd, &mh, MSG_DONTWAIT) < 0)
+    {
+      clib_unix_warning ("sending event fds to pid %d", q->consumer_pid);
+      rv = VNET_API_ERROR_SYSCALL_ERROR_3;
+    }
+  close (fd);
+
+done:
+  vec_free (ctl);
+  return rv;
+}
+
+static void
+application_event_rings_free (app_event_rings_t * er)
+{
+  api_main_t *am = &api_main;
+  void *oldheap;
+  int i;
+
+  oldheap = svm_push_data_heap (am->vlib_rp);
+  for (i = 0; i < vec_len (er->rings); i++)
+    svm_event_ring_free (er->rings[i]);
+  vec_free (er->rings);
+  svm_pop_heap (oldheap);
+
+  for (i = 0; i < vec_len (er->fds); i++)
+    close (er->fds[i]);
+  vec_free (er->fds);
+
+  pool_put (app_event_rings_pool, er);
+}
+
+/**
+ * Allocate the api client's lock-free event rings, one per vpp thread, in
+ * the /vpe-api shared-memory segment, and its eventfds if asked for. No-op
+ * unless the app asked for rings with SESSION_OPTIONS_FLAGS_EVT_RING.
+ *
+ * All apps of an api client, e.g., one per connect, share the rings and
+ * eventfds set up for its first app, which also picks the ring size. They
+ * are kept until the client disconnects, so the client receives the
+ * eventfds once.
+ */
+int
+application_event_rings_init (application_t * app, u32 ring_size)
+{
+  vlib_thread_main_t *vtm = vlib_get_thread_main ();
+  api_main_t *am = &api_main;
+  u32 n_threads = 1 + vtm->n_threads, flags = 0;
+  app_event_rings_t *er;
+  svm_event_ring_t *r;
+  void *oldheap;
+  uword *p;
+  int i, fd, rv;
+
+  if (!(app->flags & SESSION_OPTIONS_FLAGS_EVT_RING))
+    return 0;
+
+  if (app->flags & SESSION_OPTIONS_FLAGS_EVT_EVENTFD)
+    flags |= SVM_EVENT_RING_F_EVENTFD;
+
+  p = hash_get (app_event_rings_by_api_client_index, app->api_client_index);
+  if (p)
+    {
+      er = pool_elt_at_index (app_event_rings_pool, p[0]);
+      /* Can't start or stop sleeping on eventfds halfway */
+      if ((er->rings[0]->flags & SVM_EVENT_RING_F_EVENTFD) != flags)
+	return VNET_API_ERROR_INVALID_VALUE;
+      goto done;
+    }
+
+  if (ring_size == 0)
+    ring_size = SESSION_EVT_RING_DEFAULT_SIZE;
+
+  pool_get (app_event_rings_pool, er);
+  memset (er, 0, sizeof (*er));
+  er->api_client_index = app->api_client_index;
+
+  /* The app walks the vector as well as the rings */
+  oldheap = svm_push_data_heap (am->vlib_rp);
+  for (i = 0; i < n_threads; i++)
+    {
+      r = svm_event_ring_alloc (ring_size, sizeof (session_fifo_event_t),
+				flags);
+      if (!r)
+	break;
+      vec_add1 (er->rings, r);
+    }
+  svm_pop_heap (oldheap);
+
+  if (vec_len (er->rings) != n_threads)
+    {
+      application_event_rings_free (er);
+      return VNET_API_ERROR_TABLE_TOO_BIG;
+    }
+
+  if (flags & SVM_EVENT_RING_F_EVENTFD)
+    {
+      for (i = 0; i < n_threads; i++)
+	{
+	  fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+	  if (fd < 0)
+	    {
+	      application_event_rings_free (er);
+	      return VNET_API_ERROR_SYSCALL_ERROR_1;
+	    }
+	  vec_add1 (er->fds, fd);
+	}
+      if ((rv = application_send_event_fds (er->api_client_index, er->fds)))
+	{
+	  application_event_rings_free (er);
+	  return rv;
+	}
+    }
+
+  hash_set (app_event_rings_by_api_client_index, er->api_client_index,
+	    er - app_event_rings_pool);
+  er->n_refs = 1;
+
+done:
+  er->n_refs++;
+  app->event_rings_index = er - app_event_rings_pool;
+  app->event_rings = er->rings;
+  app->event_fds = er->fds;
+  return 0;
+}
+
+static void
+application_event_rings_unref (app_event_rings_t * er)
+{
+  if (--er->n_refs == 0)
+    application_event_rings_free (er);
+}
+
+static void
+application_event_rings_release (application_t * app)
+{
+  app_event_rings_t *er;
+
+  if (app->event_rings_index == ~0)
+    return;
+
+  er = pool_elt_at_index (app_event_rings_pool, app->event_rings_index);
+  app->event_rings_index = ~0;
+  app->event_rings = 0;
+  app->event_fds = 0;
+  application_event_rings_unref (er);
+}
+
+/**
+ * The api client went away. Its rings go with its last app, a new client
+ * reusing the index gets new ones.
+ */
+static clib_error_t *
+application_event_rings_reaper (u32 api_client_index)
+{
+  app_event_rings_t *er;
+  uword *p;
+
+  p = hash_get (app_event_rings_by_api_client_index, api_client_index);
+  if (!p)
+    return 0;
+
+  er = pool_elt_at_index (app_event_rings_pool, p[0]);
+  hash_unset (app_event_rings_by_api_client_index, api_client_index);
+  application_event_rings_unref (er);
+  return 0;
+}
+
+VL_MSG_API_REAPER_FUNCTION (application_event_rings_reaper);
+
 application_t *
 application_get (u32 index)
 {
@@ -188,7 +434,8 @@ application_get_index (application_t * app)
 int
 application_server_init (application_t * server, u32 segment_size,
 			 u32 add_segment_size, u32 rx_fifo_size,
-			 u32 tx_fifo_size, u8 ** segment_name)
+			 u32 tx_fifo_size, u32 prealloc_fifo_pairs,
+			 u8 ** segment_name)
 {
   session_manager_main_t *smm = vnet_get_session_manager_main ();
   session_manager_t *sm;
@@ -208,6 +455,11 @@ application_server_init (application_t * server, u32 segment_size,
   sm->rx_fifo_size = rx_fifo_size;
   sm->tx_fifo_size = tx_fifo_size;
   sm->add_segment = sm->add_segment_size != 0;
+
+  /* Sessions recycle these instead of carving fifos out of the segment.
+   * Best effort, fifos that don't fit are allocated on demand */
+  if (prealloc_fifo_pairs)
+    session_manager_preallocate_fifos (sm, prealloc_fifo_pairs);
   return 0;
 }
 
@@ -18,6 +18,7 @@
 
 #include <vnet/vnet.h>
 #include <vnet/session/session.h>
+#include <svm/svm_event_ring.h>
 
 typedef enum
 {
@@ -69,6 +70,16 @@ typedef struct _application
   /** Application listens for events on this svm queue */
   unix_shared_memory_queue_t *event_queue;
 
+  /** Or, if SESSION_OPTIONS_FLAGS_EVT_RING, on one ring per vpp thread.
+   * Rings and eventfds belong to the api client, shared by all its apps */
+  svm_event_ring_t **event_rings;
+
+  /** Per vpp thread eventfds, if SESSION_OPTIONS_FLAGS_EVT_EVENTFD */
+  int *event_fds;
+
+  /** Index of the api client's shared event rings, ~0 if none */
+  u32 event_rings_index;
+
   /** Stream session type */
   u8 session_type;
 
@@ -90,6 +101,9 @@ typedef struct _application
   /** Session thread index for client connect sessions */
   u32 thread_index;
 
+  /** Transport congestion control algorithm, see SESSION_OPTIONS_CC_ALGO */
+  u8 cc_algo;
+
   /*
    * Callbacks: shoulder-taps for the server/client
    */
@@ -108,8 +122,10 @@ u32 application_get_index (application_t * app);
 int
 application_server_init (application_t * server, u32 segment_size,
 			 u32 add_segment_size, u32 rx_fifo_size,
-			 u32 tx_fifo_size, u8 ** segment_name);
+			 u32 tx_fifo_size, u32 prealloc_fifo_pairs,
+			 u8 ** segment_name);
 int application_api_queue_is_full (application_t * app);
+int application_event_rings_init (application_t * app, u32 ring_size);
 
 #endif /* SRC_VNET_SESSION_APPLICATION_H_ */
 
@@ -78,6 +78,40 @@ api_parse_session_handle (u64 handle, u32 * session_index, u32 * thread_index)
   return 0;
 }
 
+/**
+ * Zero-copy rx fifos reference vpp buffers, which only builtin apps can
+ * access, and are only fed by TCP.
+ */
+static int
+session_options_validate (u32 api_client_index, session_type_t sst,
+			  u64 * options)
+{
+  u64 flags = options[SESSION_OPTIONS_FLAGS];
+
+  /* Builtin apps get rx events through their callback */
+  if ((flags & SESSION_OPTIONS_FLAGS_EVT_RING) && api_client_index == ~0)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  if ((flags & SESSION_OPTIONS_FLAGS_EVT_EVENTFD)
+      && !(flags & SESSION_OPTIONS_FLAGS_EVT_RING))
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  if ((flags & SESSION_OPTIONS_FLAGS_UDP_CONNECTED)
+      && sst != SESSION_TYPE_IP4_UDP && sst != SESSION_TYPE_IP6_UDP)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  if (!(flags & SESSION_OPTIONS_FLAGS_RX_ZERO_COPY))
+    return 0;
+
+  if (api_client_index != ~0)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  if (sst != SESSION_TYPE_IP4_TCP && sst != SESSION_TYPE_IP6_TCP)
+    return VNET_API_ERROR_INVALID_VALUE;
+
+  return 0;
+}
+
 int
 vnet_bind_i (u32 api_client_index, ip46_address_t * ip46, u16 port_host_order,
 	     session_type_t sst, u64 * options, session_cb_vft_t * cb_fns,
@@ -87,6 +121,10 @@ vnet_bind_i (u32 api_client_index, ip46_address_t * ip46, u16 port_host_order,
   application_t *server = 0;
   stream_session_t *listener;
   u8 is_ip4;
+  int rv;
+
+  if ((rv = session_options_validate (api_client_index, sst, options)))
+    return rv;
 
   listener =
     stream_session_lookup_listener (ip46,
@@ -109,11 +147,21 @@ vnet_bind_i (u32 api_client_index, ip46_address_t * ip46, u16 port_host_order,
   /* Allocate and initialize stream server */
   server = application_new (APP_SERVER, sst, api_client_index,
 			    options[SESSION_OPTIONS_FLAGS], cb_fns);
+  server->cc_algo = options[SESSION_OPTIONS_CC_ALGO];
+
+  if ((rv = application_event_rings_init (server,
+					  options
+					  [SESSION_OPTIONS_EVT_RING_SIZE])))
+    {
+      application_del (server);
+      return rv;
+    }
 
   application_server_init (server, options[SESSION_OPTIONS_SEGMENT_SIZE],
 			   options[SESSION_OPTIONS_ADD_SEGMENT_SIZE],
 			   options[SESSION_OPTIONS_RX_FIFO_SIZE],
 			   options[SESSION_OPTIONS_TX_FIFO_SIZE],
+			   options[SESSION_OPTIONS_PREALLOCATED_FIFO_PAIRS],
 			   &segment_name);
 
   /* Setup listen path down to transport */
@@ -157,6 +205,10 @@ vnet_connect_i (u32 api_client_index, u32 api_context, session_type_t sst,
 {
   stream_session_t *listener;
   application_t *server, *app;
+  int rv;
+
+  if ((rv = session_options_validate (api_client_index, sst, options)))
+    return rv;
 
   /*
    * Figure out if connecting to a local server
@@ -182,6 +234,15 @@ vnet_connect_i (u32 api_client_index, u32 api_context, session_type_t sst,
 			 options[SESSION_OPTIONS_FLAGS], cb_fns);
 
   app->api_context = api_context;
+  app->cc_algo = options[SESSION_OPTIONS_CC_ALGO];
+
+  if ((rv = application_event_rings_init (app,
+					  options
+					  [SESSION_OPTIONS_EVT_RING_SIZE])))
+    {
+      application_del (app);
+      return rv;
+    }
 
   /*
    * Not connecting to a local server. Create regular session
@@ -283,6 +344,7 @@ vnet_bind_uri (vnet_bind_args_t * a)
     return rv;
 
   a->server_event_queue_address = (u64) server->event_queue;
+  a->server_event_rings_address = (u64) server->event_rings;
   return 0;
 }
 
@@ -389,6 +451,7 @@ vnet_bind (vnet_bind_args_t * a)
     return rv;
 
   a->server_event_queue_address = (u64) server->event_queue;
+  a->server_event_rings_address = (u64) server->event_rings;
   a->handle = (u64) a->tep.vrf << 32 | (u64) server->session_index;
   return 0;
 }
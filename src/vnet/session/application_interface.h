@@ -50,6 +50,7 @@ typedef struct _vnet_bind_args_t
   char *segment_name;
   u32 segment_name_length;
   u64 server_event_queue_address;
+  u64 server_event_rings_address;
   u64 handle;
 } vnet_bind_args_t;
 
@@ -98,6 +99,9 @@ typedef enum
   SESSION_OPTIONS_RX_FIFO_SIZE,
   SESSION_OPTIONS_TX_FIFO_SIZE,
   SESSION_OPTIONS_ACCEPT_COOKIE,
+  SESSION_OPTIONS_CC_ALGO,
+  SESSION_OPTIONS_EVT_RING_SIZE,
+  SESSION_OPTIONS_PREALLOCATED_FIFO_PAIRS,
   SESSION_OPTIONS_N_OPTIONS
 } session_options_index_t;
 
@@ -107,6 +111,34 @@ typedef enum
 /** Server wants vpp to add segments when out of memory for fifos */
 #define SESSION_OPTIONS_FLAGS_ADD_SEGMENT   (1<<1)
 
+/** Builtin app reads rx payload in place from vpp buffers, see
+ * svm_fifo_zc_segment and stream_session_zc_release. TCP only */
+#define SESSION_OPTIONS_FLAGS_RX_ZERO_COPY  (1<<2)
+
+/** External app takes rx events from lock-free rings, one per vpp thread,
+ * instead of its event queue. It must svm_fifo_unset_event a fifo before
+ * reading it, vpp sends no further events for the fifo until then */
+#define SESSION_OPTIONS_FLAGS_EVT_RING  (1<<3)
+
+/** With EVT_RING, app sleeps on eventfds instead of busy polling the rings.
+ * vpp sends them before the bind/connect reply, see SESSION_EVT_SOCKET_FMT */
+#define SESSION_OPTIONS_FLAGS_EVT_EVENTFD  (1<<4)
+
+/** UDP server gets a session per peer, instead of one unconnected session
+ * per vpp thread that carries datagrams from all peers */
+#define SESSION_OPTIONS_FLAGS_UDP_CONNECTED  (1<<5)
+
+/** Abstract unix datagram socket, bound by the app, vpp sends eventfds to.
+ * Formatted with the pid of the app's api client */
+#define SESSION_EVT_SOCKET_FMT "vpp-session-evt-%d"
+
+/** SESSION_OPTIONS_EVT_RING_SIZE default, events per ring */
+#define SESSION_EVT_RING_DEFAULT_SIZE 8192
+
+/** SESSION_OPTIONS_CC_ALGO value: the transport's congestion control
+ * algorithm id plus one, e.g. TCP_CC_BBR + 1. 0 selects the default */
+#define SESSION_OPTIONS_CC_ALGO_DEFAULT 0
+
 #define VNET_CONNECT_REDIRECTED	123
 
 int vnet_bind_uri (vnet_bind_args_t *);
@@ -123,6 +155,52 @@ int
 api_parse_session_handle (u64 handle, u32 * session_index,
 			  u32 * thread_index);
 
+/**
+ * Enqueue a datagram to the tx fifo of a datagram transport session, as a
+ * record made of hdr and the payload. Records go in whole or not at all.
+ * Unconnected sessions send to hdr's rmt_ip and rmt_port.
+ *
+ * @return payload bytes enqueued or -1 if the fifo has no room
+ */
+always_inline int
+app_send_dgram_raw (svm_fifo_t * f, transport_dgram_hdr_t * hdr, u8 * data,
+		    u32 len)
+{
+  svm_fifo_iovec_t segs[2];
+
+  hdr->data_length = len;
+  segs[0].data = (u8 *) hdr;
+  segs[0].len = sizeof (*hdr);
+  segs[1].data = data;
+  segs[1].len = len;
+  if (svm_fifo_enqueue_segments (f, 0 /* pid */ , segs, 2) < 0)
+    return -1;
+  return len;
+}
+
+/**
+ * Dequeue the next datagram record from a datagram transport session's rx
+ * fifo. Payload that doesn't fit buf is dropped, as with recvfrom.
+ *
+ * @return payload bytes copied to buf or -1 if the fifo holds no datagram
+ */
+always_inline int
+app_recv_dgram_raw (svm_fifo_t * f, transport_dgram_hdr_t * hdr, u8 * buf,
+		    u32 max_len)
+{
+  u32 len;
+
+  if (svm_fifo_max_dequeue (f) < sizeof (*hdr))
+    return -1;
+
+  svm_fifo_peek (f, 0 /* pid */ , 0, sizeof (*hdr), (u8 *) hdr);
+  len = clib_min (hdr->data_length, max_len);
+  if (len)
+    svm_fifo_peek (f, 0, sizeof (*hdr), len, buf);
+  svm_fifo_dequeue_drop (f, 0, sizeof (*hdr) + hdr->data_length);
+  return len;
+}
+
 #endif /* __included_uri_h__ */
 
 /*
@@ -77,6 +77,107 @@ static u32 session_type_to_next[] = {
   SESSION_QUEUE_NEXT_IP6_LOOKUP,
 };
 
+/* Payload bytes that fit the first buffer, after room for headers */
+#define SESSION_TX_FIRST_BUF_BYTES (VLIB_BUFFER_DATA_SIZE - MAX_HDRS_LEN)
+
+/** Buffers needed to carry n_bytes of payload */
+always_inline u32
+session_tx_n_bufs_for (u32 n_bytes)
+{
+  if (n_bytes <= SESSION_TX_FIRST_BUF_BYTES)
+    return 1;
+  n_bytes -= SESSION_TX_FIRST_BUF_BYTES;
+  return 1 + (n_bytes + VLIB_BUFFER_DATA_SIZE - 1) / VLIB_BUFFER_DATA_SIZE;
+}
+
+/**
+ * Peek the remaining n_bytes of a super-segment into buffers chained
+ * to b0. Buffers are only taken from the cache if all reads succeed.
+ */
+always_inline int
+session_tx_fifo_chain_tail (vlib_main_t * vm, session_manager_main_t * smm,
+			    u32 thread_index, stream_session_t * s0,
+			    vlib_buffer_t * b0, u32 n_bytes, u32 * rx_offset)
+{
+  u32 *tx_buffers = smm->tx_buffers[thread_index];
+  u32 n_bufs = vec_len (tx_buffers), offset = *rx_offset, bi, len;
+  vlib_buffer_t *prev = b0, *b;
+  int n_bytes_read;
+
+  while (n_bytes)
+    {
+      ASSERT (n_bufs > 0);
+      bi = tx_buffers[--n_bufs];
+      b = vlib_get_buffer (vm, bi);
+      b->current_data = 0;
+      b->flags = 0;
+
+      len = clib_min (n_bytes, VLIB_BUFFER_DATA_SIZE);
+      n_bytes_read = svm_fifo_peek (s0->server_tx_fifo, s0->pid, offset,
+				    len, vlib_buffer_get_current (b));
+      if (n_bytes_read < 0)
+	return -1;
+
+      b->current_length = len;
+      prev->next_buffer = bi;
+      prev->flags |= VLIB_BUFFER_NEXT_PRESENT;
+      b0->total_length_not_including_first_buffer += len;
+
+      offset += n_bytes_read;
+      n_bytes -= len;
+      prev = b;
+    }
+
+  _vec_len (smm->tx_buffers[thread_index]) = n_bufs;
+  *rx_offset = offset;
+  return 0;
+}
+
+/**
+ * Park a tx event until the transport can send again, instead of
+ * retrying it on every dispatch.
+ */
+static void
+session_tx_postpone (vlib_main_t * vm, session_manager_main_t * smm,
+		     session_fifo_event_t * e0, stream_session_t * s0,
+		     u32 thread_index, f64 wait)
+{
+  session_postponed_event_t *pe;
+
+  pool_get (smm->evts_postponed[thread_index], pe);
+  pe->evt = *e0;
+  pe->session_index = s0->session_index;
+  vlib_timer_start (vm, smm->tx_wait_timer_client_index,
+		    pe - smm->evts_postponed[thread_index], wait);
+}
+
+/**
+ * Requeue postponed events whose wait is over. Runs between node
+ * dispatches, so the thread's event vector is not in use.
+ */
+void
+session_tx_wait_expired (vlib_main_t * vm, u32 * postponed_indices)
+{
+  session_manager_main_t *smm = vnet_get_session_manager_main ();
+  u32 thread_index = vm->cpu_index;
+  session_postponed_event_t *pe;
+  stream_session_t *s;
+  u32 *pi;
+
+  vec_foreach (pi, postponed_indices)
+  {
+    pe = pool_elt_at_index (smm->evts_postponed[thread_index], pi[0]);
+    s = stream_session_get_if_valid (pe->session_index, thread_index);
+
+    /* Session closed, or its slot reused, while the event waited */
+    if (s && s->server_tx_fifo == pe->evt.fifo
+	&& s->session_state != SESSION_STATE_CLOSED)
+      vec_add1 (smm->fifo_events[thread_index], pe->evt);
+
+    pool_put (smm->evts_postponed[thread_index], pe);
+  }
+}
+
 always_inline int
 session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
 				session_manager_main_t * smm,
@@ -86,7 +187,7 @@ session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
 {
   u32 n_trace = vlib_get_trace_count (vm, node);
   u32 left_to_snd0, max_len_to_snd0, len_to_deq0, n_bufs, snd_space0;
-  u32 n_frame_bytes, n_frames_per_evt;
+  u32 n_frame_bytes, n_frames_per_evt, max_seg0, n_bufs_needed0;
   transport_connection_t *tc0;
   transport_proto_vft_t *transport_vft;
   u32 next_index, next0, *to_next, n_left_to_next, bi0;
@@ -109,7 +210,14 @@ session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
   if (snd_space0 == 0 || svm_fifo_max_dequeue (s0->server_tx_fifo) == 0
       || snd_mss0 == 0)
     {
-      vec_add1 (smm->evts_partially_read[thread_index], *e0);
+      f64 wait0;
+
+      /* Rate limited, come back when the transport can send */
+      if (snd_space0 == 0 && transport_vft->send_wait
+	  && (wait0 = transport_vft->send_wait (tc0)) > 0)
+	session_tx_postpone (vm, smm, e0, s0, thread_index, wait0);
+      else
+	vec_add1 (smm->evts_partially_read[thread_index], *e0);
       return 0;
     }
 
@@ -127,7 +235,13 @@ session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
   /* TODO check if transport is willing to send len_to_snd0
    * bytes (Nagle) */
 
-  n_frame_bytes = snd_mss0 * VLIB_FRAME_SIZE;
+  /* Large-send: transport takes buffer chains of up to max_seg0 bytes,
+   * segmentation is left to gso or the device */
+  max_seg0 = snd_mss0;
+  if (peek_data && transport_vft->send_gso_size)
+    max_seg0 = clib_max (max_seg0, transport_vft->send_gso_size (tc0));
+
+  n_frame_bytes = max_seg0 * VLIB_FRAME_SIZE;
   n_frames_per_evt = ceil ((double) max_len_to_snd0 / n_frame_bytes);
 
   n_bufs = vec_len (smm->tx_buffers[thread_index]);
@@ -163,6 +277,38 @@ session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
       vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
       while (left_to_snd0 && n_left_to_next)
 	{
+	  len_to_deq0 = clib_min (left_to_snd0, max_seg0);
+	  n_bufs_needed0 = 1;
+	  if (PREDICT_FALSE (len_to_deq0 > snd_mss0))
+	    {
+	      n_bufs_needed0 = session_tx_n_bufs_for (len_to_deq0);
+	      if (n_bufs < n_bufs_needed0)
+		{
+		  vec_validate (smm->tx_buffers[thread_index],
+				n_bufs + VLIB_FRAME_SIZE - 1);
+		  n_bufs +=
+		    vlib_buffer_alloc (vm,
+				       &smm->tx_buffers[thread_index][n_bufs],
+				       VLIB_FRAME_SIZE);
+		  _vec_len (smm->tx_buffers[thread_index]) = n_bufs;
+		}
+	      /* Short on buffers, send a plain segment */
+	      if (n_bufs < n_bufs_needed0)
+		{
+		  len_to_deq0 = clib_min (left_to_snd0, snd_mss0);
+		  n_bufs_needed0 = 1;
+		}
+	    }
+
+	  /* Super-segments ate the buffers meant for this frame */
+	  if (PREDICT_FALSE (n_bufs == 0))
+	    {
+	      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+	      e0->enqueue_length -= max_len_to_snd0 - left_to_snd0;
+	      vec_add1 (smm->evts_partially_read[thread_index], *e0);
+	      return -1;
+	    }
+
 	  /* Get free buffer */
 	  n_bufs--;
 	  bi0 = smm->tx_buffers[thread_index][n_bufs];
@@ -173,6 +319,7 @@ session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
 	  b0->flags = VLIB_BUFFER_TOTAL_LENGTH_VALID
 	    | VNET_BUFFER_LOCALLY_ORIGINATED;
 	  b0->current_data = 0;
+	  b0->total_length_not_including_first_buffer = 0;
 
 	  /* RX on the local interface. tx in default fib */
 	  vnet_buffer (b0)->sw_if_index[VLIB_RX] = 0;
@@ -195,8 +342,6 @@ session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
 	      t0->server_thread_index = s0->thread_index;
 	    }
 
-	  len_to_deq0 = (left_to_snd0 < snd_mss0) ? left_to_snd0 : snd_mss0;
-
 	  /* *INDENT-OFF* */
 	  SESSION_EVT_DBG(s0, SESSION_EVT_DEQ, ({
 	      ed->data[0] = e0->event_id;
@@ -215,24 +360,37 @@ session_tx_fifo_read_and_snd_i (vlib_main_t * vm, vlib_node_runtime_t * node,
 	  if (peek_data)
 	    {
 	      int n_bytes_read;
+	      u32 len_first0 = len_to_deq0;
+
+	      if (PREDICT_FALSE (n_bufs_needed0 > 1))
+		len_first0 = SESSION_TX_FIRST_BUF_BYTES;
 	      n_bytes_read = svm_fifo_peek (s0->server_tx_fifo, s0->pid,
-					    rx_offset, len_to_deq0, data0);
+					    rx_offset, len_first0, data0);
 	      if (n_bytes_read < 0)
 		goto dequeue_fail;
 
 	      /* Keep track of progress locally, transport is also supposed to
 	       * increment it independently when pushing header */
 	      rx_offset += n_bytes_read;
+	      b0->current_length = len_first0;
+
+	      if (PREDICT_FALSE (n_bufs_needed0 > 1))
+		{
+		  if (session_tx_fifo_chain_tail (vm, smm, thread_index, s0, b0,
+						  len_to_deq0 - len_first0,
+						  &rx_offset))
+		    goto dequeue_fail;
+		  n_bufs = vec_len (smm->tx_buffers[thread_index]);
+		}
 	    }
 	  else
 	    {
 	      if (svm_fifo_dequeue_nowait (s0->server_tx_fifo, s0->pid,
 					   len_to_deq0, data0) < 0)
 		goto dequeue_fail;
+	      b0->current_length = len_to_deq0;
 	    }
 
-	  b0->current_length = len_to_deq0;
-
 	  /* Ask transport to push header */
 	  transport_vft->push_header (tc0, b0);
 
@@ -290,6 +448,132 @@ session_tx_fifo_dequeue_and_snd (vlib_main_t * vm, vlib_node_runtime_t * node,
 					 n_tx_pkts, 0);
 }
 
+/**
+ * Send datagram records. Each tx fifo record, a transport_dgram_hdr_t
+ * followed by the payload, becomes one packet. Apps enqueue records
+ * whole, so a record header in the fifo means the payload is there too.
+ * Drains up to a frame of datagrams per event, whatever the number of
+ * events the app generated for them.
+ */
+int
+session_tx_fifo_dequeue_dgrams_and_snd (vlib_main_t * vm,
+					vlib_node_runtime_t * node,
+					session_manager_main_t * smm,
+					session_fifo_event_t * e0,
+					stream_session_t * s0,
+					u32 thread_index, int *n_tx_pkts)
+{
+  u32 n_trace = vlib_get_trace_count (vm, node);
+  u32 next_index, *to_next, n_left_to_next, bi0, n_bufs, n_bufs_needed0;
+  u32 len_first0, rx_offset;
+  svm_fifo_t *f0 = s0->server_tx_fifo;
+  transport_proto_vft_t *transport_vft;
+  transport_connection_t *tc0;
+  transport_dgram_hdr_t hdr0;
+  vlib_buffer_t *b0;
+  u8 *data0;
+
+  next_index = session_type_to_next[s0->session_type];
+
+  transport_vft = session_get_transport_vft (s0->session_type);
+  tc0 = transport_vft->get_connection (s0->connection_index, thread_index);
+
+  vlib_get_next_frame (vm, node, next_index, to_next, n_left_to_next);
+  while (n_left_to_next
+	 && svm_fifo_max_dequeue (f0) >= sizeof (transport_dgram_hdr_t))
+    {
+      svm_fifo_peek (f0, s0->pid, 0, sizeof (hdr0), (u8 *) & hdr0);
+      ASSERT (svm_fifo_max_dequeue (f0) >= sizeof (hdr0) + hdr0.data_length);
+
+      if (PREDICT_FALSE (hdr0.data_length > SESSION_DGRAM_MAX_BYTES))
+	{
+	  svm_fifo_dequeue_drop (f0, s0->pid,
+				 sizeof (hdr0) + hdr0.data_length);
+	  continue;
+	}
+
+      n_bufs_needed0 = session_tx_n_bufs_for (hdr0.data_length);
+      n_bufs = vec_len (smm->tx_buffers[thread_index]);
+      if (PREDICT_FALSE (n_bufs < n_bufs_needed0))
+	{
+	  vec_validate (smm->tx_buffers[thread_index],
+			n_bufs + VLIB_FRAME_SIZE - 1);
+	  n_bufs += vlib_buffer_alloc (vm,
+				       &smm->tx_buffers[thread_index][n_bufs],
+				       VLIB_FRAME_SIZE);
+	  _vec_len (smm->tx_buffers[thread_index]) = n_bufs;
+
+	  /* Buffer shortage, retry the event later */
+	  if (n_bufs < n_bufs_needed0)
+	    {
+	      vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+	      vec_add1 (smm->evts_partially_read[thread_index], *e0);
+	      return -1;
+	    }
+	}
+
+      /* Get free buffer */
+      n_bufs--;
+      bi0 = smm->tx_buffers[thread_index][n_bufs];
+      _vec_len (smm->tx_buffers[thread_index]) = n_bufs;
+
+      b0 = vlib_get_buffer (vm, bi0);
+      b0->error = 0;
+      b0->flags = VLIB_BUFFER_TOTAL_LENGTH_VALID
+	| VNET_BUFFER_LOCALLY_ORIGINATED;
+      b0->current_data = 0;
+      b0->total_length_not_including_first_buffer = 0;
+
+      /* RX on the local interface. tx in default fib */
+      vnet_buffer (b0)->sw_if_index[VLIB_RX] = 0;
+      vnet_buffer (b0)->sw_if_index[VLIB_TX] = (u32) ~ 0;
+
+      VLIB_BUFFER_TRACE_TRAJECTORY_INIT (b0);
+      if (PREDICT_FALSE (n_trace > 0))
+	{
+	  session_queue_trace_t *t0;
+	  vlib_trace_buffer (vm, node, next_index, b0, 1 /* follow_chain */ );
+	  vlib_set_trace_count (vm, node, --n_trace);
+	  t0 = vlib_add_trace (vm, node, b0, sizeof (*t0));
+	  t0->session_index = s0->session_index;
+	  t0->server_thread_index = s0->thread_index;
+	}
+
+      /* Make room for headers */
+      data0 = vlib_buffer_make_headroom (b0, MAX_HDRS_LEN);
+
+      /* Peek the payload past the record header, then drop the record */
+      rx_offset = sizeof (hdr0);
+      len_first0 = clib_min (hdr0.data_length, SESSION_TX_FIRST_BUF_BYTES);
+      if (len_first0)
+	rx_offset += svm_fifo_peek (f0, s0->pid, rx_offset, len_first0,
+				    data0);
+      b0->current_length = len_first0;
+
+      if (PREDICT_FALSE (n_bufs_needed0 > 1))
+	session_tx_fifo_chain_tail (vm, smm, thread_index, s0, b0,
+				    hdr0.data_length - len_first0,
+				    &rx_offset);
+
+      svm_fifo_dequeue_drop (f0, s0->pid, sizeof (hdr0) + hdr0.data_length);
+
+      /* Ask transport to push headers, with the record's addresses */
+      transport_vft->push_dgram_header (tc0, b0, &hdr0);
+
+      to_next[0] = bi0;
+      to_next += 1;
+      n_left_to_next -= 1;
+      *n_tx_pkts = *n_tx_pkts + 1;
+    }
+  vlib_put_next_frame (vm, node, next_index, n_left_to_next);
+
+  /* Frame is full, come back for the rest */
+  if (svm_fifo_max_dequeue (f0) >= sizeof (transport_dgram_hdr_t))
+    vec_add1 (smm->evts_partially_read[thread_index], *e0);
+
+  return 0;
+}
+
 static uword
 session_queue_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
 		       vlib_frame_t * frame)
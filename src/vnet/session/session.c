@@ -22,6 +22,7 @@
 #include <vnet/dpo/load_balance.h>
 #include <vnet/fib/ip4_fib.h>
 #include <vnet/session/application.h>
+#include <vnet/session/application_interface.h>
 #include <vnet/tcp/tcp.h>
 #include <vnet/session/session_debug.h>
 
@@ -50,13 +51,15 @@ stream_session_table_add_for_tc (u8 sst, transport_connection_t * tc,
     case SESSION_TYPE_IP4_TCP:
       make_v4_ss_kv_from_tc (&kv4, tc);
       kv4.value = value;
-      clib_bihash_add_del_16_8 (&smm->v4_session_hash, &kv4, 1 /* is_add */ );
+      clib_bihash_add_del_16_8 (&smm->v4_session_hash[tc->thread_index],
+				&kv4, 1 /* is_add */ );
       break;
     case SESSION_TYPE_IP6_UDP:
     case SESSION_TYPE_IP6_TCP:
       make_v6_ss_kv_from_tc (&kv6, tc);
       kv6.value = value;
-      clib_bihash_add_del_48_8 (&smm->v6_session_hash, &kv6, 1 /* is_add */ );
+      clib_bihash_add_del_48_8 (&smm->v6_session_hash[tc->thread_index],
+				&kv6, 1 /* is_add */ );
       break;
     default:
       clib_warning ("Session type not supported");
@@ -117,13 +120,15 @@ stream_session_table_del_for_tc (session_manager_main_t * smm, u8 sst,
     case SESSION_TYPE_IP4_UDP:
     case SESSION_TYPE_IP4_TCP:
       make_v4_ss_kv_from_tc (&kv4, tc);
-      return clib_bihash_add_del_16_8 (&smm->v4_session_hash, &kv4,
+      return clib_bihash_add_del_16_8 (&smm->v4_session_hash
+				       [tc->thread_index], &kv4,
 				       0 /* is_add */ );
       break;
     case SESSION_TYPE_IP6_UDP:
     case SESSION_TYPE_IP6_TCP:
       make_v6_ss_kv_from_tc (&kv6, tc);
-      return clib_bihash_add_del_48_8 (&smm->v6_session_hash, &kv6,
+      return clib_bihash_add_del_48_8 (&smm->v6_session_hash
+				       [tc->thread_index], &kv6,
 				       0 /* is_add */ );
       break;
     default:
@@ -171,6 +176,34 @@ stream_session_half_open_table_del (session_manager_main_t * smm, u8 sst,
     }
 }
 
+static void
+stream_session_listener_table_add_del (u8 sst, transport_connection_t * tc,
+				       u64 value, int is_add)
+{
+  session_manager_main_t *smm = &session_manager_main;
+  session_kv4_t kv4;
+  session_kv6_t kv6;
+
+  switch (sst)
+    {
+    case SESSION_TYPE_IP4_UDP:
+    case SESSION_TYPE_IP4_TCP:
+      make_v4_ss_kv_from_tc (&kv4, tc);
+      kv4.value = value;
+      clib_bihash_add_del_16_8 (&smm->v4_listener_hash, &kv4, is_add);
+      break;
+    case SESSION_TYPE_IP6_UDP:
+    case SESSION_TYPE_IP6_TCP:
+      make_v6_ss_kv_from_tc (&kv6, tc);
+      kv6.value = value;
+      clib_bihash_add_del_48_8 (&smm->v6_listener_hash, &kv6, is_add);
+      break;
+    default:
+      clib_warning ("Session type not supported");
+      ASSERT (0);
+    }
+}
+
 stream_session_t *
 stream_session_lookup_listener4 (ip4_address_t * lcl, u16 lcl_port, u8 proto)
 {
@@ -179,13 +212,13 @@ stream_session_lookup_listener4 (ip4_address_t * lcl, u16 lcl_port, u8 proto)
   int rv;
 
   make_v4_listener_kv (&kv4, lcl, lcl_port, proto);
-  rv = clib_bihash_search_inline_16_8 (&smm->v4_session_hash, &kv4);
+  rv = clib_bihash_search_inline_16_8 (&smm->v4_listener_hash, &kv4);
   if (rv == 0)
     return pool_elt_at_index (smm->listen_sessions[proto], (u32) kv4.value);
 
   /* Zero out the lcl ip */
   kv4.key[0] = 0;
-  rv = clib_bihash_search_inline_16_8 (&smm->v4_session_hash, &kv4);
+  rv = clib_bihash_search_inline_16_8 (&smm->v4_listener_hash, &kv4);
   if (rv == 0)
     return pool_elt_at_index (smm->listen_sessions[proto], kv4.value);
 
@@ -209,7 +242,8 @@ stream_session_lookup4 (ip4_address_t * lcl, ip4_address_t * rmt,
 
   /* Lookup session amongst established ones */
   make_v4_ss_kv (&kv4, lcl, rmt, lcl_port, rmt_port, proto);
-  rv = clib_bihash_search_inline_16_8 (&smm->v4_session_hash, &kv4);
+  rv = clib_bihash_search_inline_16_8 (&smm->v4_session_hash
+				       [my_thread_index], &kv4);
   if (rv == 0)
     return stream_session_get_tsi (kv4.value, my_thread_index);
 
@@ -225,13 +259,13 @@ stream_session_lookup_listener6 (ip6_address_t * lcl, u16 lcl_port, u8 proto)
   int rv;
 
   make_v6_listener_kv (&kv6, lcl, lcl_port, proto);
-  rv = clib_bihash_search_inline_48_8 (&smm->v6_session_hash, &kv6);
+  rv = clib_bihash_search_inline_48_8 (&smm->v6_listener_hash, &kv6);
   if (rv == 0)
     return pool_elt_at_index (smm->listen_sessions[proto], kv6.value);
 
   /* Zero out the lcl ip */
   kv6.key[0] = kv6.key[1] = 0;
-  rv = clib_bihash_search_inline_48_8 (&smm->v6_session_hash, &kv6);
+  rv = clib_bihash_search_inline_48_8 (&smm->v6_listener_hash, &kv6);
   if (rv == 0)
     return pool_elt_at_index (smm->listen_sessions[proto], kv6.value);
 
@@ -252,7 +286,8 @@ stream_session_lookup6 (ip6_address_t * lcl, ip6_address_t * rmt,
   int rv;
 
   make_v6_ss_kv (&kv6, lcl, rmt, lcl_port, rmt_port, proto);
-  rv = clib_bihash_search_inline_48_8 (&smm->v6_session_hash, &kv6);
+  rv = clib_bihash_search_inline_48_8 (&smm->v6_session_hash
+				       [my_thread_index], &kv6);
   if (rv == 0)
     return stream_session_get_tsi (kv6.value, my_thread_index);
 
@@ -324,7 +359,8 @@ stream_session_lookup_transport4 (ip4_address_t * lcl, ip4_address_t * rmt,
 
   /* Lookup session amongst established ones */
   make_v4_ss_kv (&kv4, lcl, rmt, lcl_port, rmt_port, proto);
-  rv = clib_bihash_search_inline_16_8 (&smm->v4_session_hash, &kv4);
+  rv = clib_bihash_search_inline_16_8 (&smm->v4_session_hash
+				       [my_thread_index], &kv4);
   if (rv == 0)
     {
       s = stream_session_get_tsi (kv4.value, my_thread_index);
@@ -357,7 +393,8 @@ stream_session_lookup_transport6 (ip6_address_t * lcl, ip6_address_t * rmt,
   int rv;
 
   make_v6_ss_kv (&kv6, lcl, rmt, lcl_port, rmt_port, proto);
-  rv = clib_bihash_search_inline_48_8 (&smm->v6_session_hash, &kv6);
+  rv = clib_bihash_search_inline_48_8 (&smm->v6_session_hash
+				       [my_thread_index], &kv6);
   if (rv == 0)
     {
       s = stream_session_get_tsi (kv6.value, my_thread_index);
@@ -547,6 +584,31 @@ session_manager_del (session_manager_main_t * smm, session_manager_t * sm)
   vec_free (deleted_thread_indices);
 }
 
+/**
+ * Fill the first segment's fifo freelists with n_fifo_pairs session fifo
+ * pairs, so creating sessions doesn't have to carve fifos out of the
+ * segment's heap.
+ */
+int
+session_manager_preallocate_fifos (session_manager_t * sm, u32 n_fifo_pairs)
+{
+  svm_fifo_segment_private_t *fifo_segment;
+  u32 n_left = n_fifo_pairs;
+
+  ASSERT (vec_len (sm->segment_indices));
+  fifo_segment = svm_fifo_get_segment (sm->segment_indices[0]);
+
+  if (svm_fifo_segment_preallocate_fifo_pairs
+      (fifo_segment, session_manager_rx_fifo_size (sm),
+       session_manager_tx_fifo_size (sm), &n_left))
+    {
+      clib_warning ("only %d of %d fifo pairs fit the segment",
+		    n_fifo_pairs - n_left, n_fifo_pairs);
+      return SESSION_ERROR_NO_SPACE;
+    }
+  return 0;
+}
+
 int
 session_manager_allocate_session_fifos (session_manager_main_t * smm,
 					session_manager_t * sm,
@@ -556,7 +618,7 @@ session_manager_allocate_session_fifos (session_manager_main_t * smm,
 					u8 * added_a_segment)
 {
   svm_fifo_segment_private_t *fifo_segment;
-  u32 fifo_size, default_fifo_size = 128 << 10;	/* TODO config */
+  u32 fifo_size;
   int i;
 
   *added_a_segment = 0;
@@ -570,12 +632,10 @@ again:
       *fifo_segment_index = sm->segment_indices[i];
       fifo_segment = svm_fifo_get_segment (*fifo_segment_index);
 
-      fifo_size = sm->rx_fifo_size;
-      fifo_size = (fifo_size == 0) ? default_fifo_size : fifo_size;
+      fifo_size = session_manager_rx_fifo_size (sm);
       *server_rx_fifo = svm_fifo_segment_alloc_fifo (fifo_segment, fifo_size);
 
-      fifo_size = sm->tx_fifo_size;
-      fifo_size = (fifo_size == 0) ? default_fifo_size : fifo_size;
+      fifo_size = session_manager_tx_fifo_size (sm);
       *server_tx_fifo = svm_fifo_segment_alloc_fifo (fifo_segment, fifo_size);
 
       if (*server_rx_fifo == 0)
@@ -681,6 +741,14 @@ stream_session_create_i (session_manager_main_t * smm, application_t * app,
   s->server_rx_fifo = server_rx_fifo;
   s->server_tx_fifo = server_tx_fifo;
 
+  /* Builtin app reads received buffers in place */
+  if (app->flags & SESSION_OPTIONS_FLAGS_RX_ZERO_COPY)
+    {
+      svm_fifo_set_zero_copy (server_rx_fifo, server_rx_fifo->nitems /
+			      SESSION_ZC_BYTES_PER_DESC);
+      s->zc_copy_buffer = ~0;
+    }
+
   /* Initialize state machine, such as it is... */
   s->session_type = app->session_type;
   s->session_state = SESSION_STATE_CONNECTING;
@@ -704,6 +772,25 @@ stream_session_create_i (session_manager_main_t * smm, application_t * app,
   return 0;
 }
 
+/*
+ * Queue RX event on session's fifo. Eventually these will need to be flushed
+ * by calling stream_server_flush_enqueue_events ()
+ */
+always_inline void
+stream_session_queue_enqueue_event (stream_session_t * s)
+{
+  session_manager_main_t *smm = vnet_get_session_manager_main ();
+  u32 thread_index = s->thread_index;
+  u32 my_enqueue_epoch = smm->current_enqueue_epoch[thread_index];
+
+  if (s->enqueue_epoch != my_enqueue_epoch)
+    {
+      s->enqueue_epoch = my_enqueue_epoch;
+      vec_add1 (smm->session_indices_to_enqueue_by_thread[thread_index],
+		s - smm->sessions[thread_index]);
+    }
+}
+
 /*
  * Enqueue data for delivery to session peer. Does not notify peer of enqueue
  * event but on request can queue notification events for later delivery by
@@ -733,24 +820,188 @@ stream_session_enqueue_data (transport_connection_t * tc, u8 * data, u16 len,
   enqueued = svm_fifo_enqueue_nowait (s->server_rx_fifo, s->pid, len, data);
 
   if (queue_event)
+    stream_session_queue_enqueue_event (s);
+
+  return enqueued;
+}
+
+/**
+ * Enqueue a datagram, i.e., hdr followed by the payload in buffer chain b,
+ * to the session's rx fifo. The datagram is enqueued whole or not at all.
+ * Sessions still waiting for the app's accept buffer datagrams without
+ * generating events.
+ *
+ * @return payload bytes enqueued or -1 if the datagram doesn't fit
+ */
+int
+stream_session_enqueue_dgram (transport_connection_t * tc, vlib_buffer_t * b,
+			      transport_dgram_hdr_t * hdr, u8 queue_event)
+{
+  svm_fifo_iovec_t segs[SESSION_DGRAM_MAX_SEGS], *seg = segs;
+  vlib_main_t *vm = vlib_get_main ();
+  stream_session_t *s;
+
+  s = stream_session_get (tc->s_index, tc->thread_index);
+
+  seg->data = (u8 *) hdr;
+  seg->len = sizeof (*hdr);
+  while (1)
+    {
+      if (PREDICT_FALSE (++seg == segs + ARRAY_LEN (segs)))
+	return -1;
+      seg->data = vlib_buffer_get_current (b);
+      seg->len = b->current_length;
+      if (!(b->flags & VLIB_BUFFER_NEXT_PRESENT))
+	break;
+      b = vlib_get_buffer (vm, b->next_buffer);
+    }
+
+  if (svm_fifo_enqueue_segments (s->server_rx_fifo, s->pid, segs,
+				 seg - segs + 1) < 0)
+    return -1;
+
+  if (queue_event && s->session_state == SESSION_STATE_READY)
+    stream_session_queue_enqueue_event (s);
+
+  return hdr->data_length;
+}
+
+/*
+ * Copy small payload to the session's copy buffer, and reference it from
+ * the zero-copy fifo, as part of the newest descriptor if possible. Each
+ * descriptor holds a reference to the copy buffer, the session one more
+ * while it copies to it.
+ */
+static int
+stream_session_zc_enqueue_copy (vlib_main_t * vm, stream_session_t * s,
+				u8 * data, u16 len)
+{
+  svm_fifo_t *f = s->server_rx_fifo;
+  vlib_buffer_t *cb;
+  u8 *dst;
+  int rv;
+
+  if (PREDICT_FALSE (len > svm_fifo_max_enqueue (f)))
+    return -1;
+
+  cb = s->zc_copy_buffer != ~0 ? vlib_get_buffer (vm, s->zc_copy_buffer) : 0;
+  if (!cb || s->zc_copy_offset + len > VLIB_BUFFER_DATA_SIZE
+      || cb->n_add_refs == 255)
     {
-      /* Queue RX event on this fifo. Eventually these will need to be flushed
-       * by calling stream_server_flush_enqueue_events () */
-      session_manager_main_t *smm = vnet_get_session_manager_main ();
-      u32 thread_index = s->thread_index;
-      u32 my_enqueue_epoch = smm->current_enqueue_epoch[thread_index];
+      if (cb)
+	vlib_buffer_free_one (vm, s->zc_copy_buffer);
+      s->zc_copy_buffer = ~0;
+      if (vlib_buffer_alloc (vm, &s->zc_copy_buffer, 1) != 1)
+	return -1;
+      s->zc_copy_offset = 0;
+      cb = vlib_get_buffer (vm, s->zc_copy_buffer);
+    }
+
+  dst = cb->data + s->zc_copy_offset;
+  clib_memcpy (dst, data, len);
+
+  rv = svm_fifo_zc_extend_copy (f, dst, len, s->zc_copy_buffer);
+  if (rv == 0)
+    {
+      rv = svm_fifo_enqueue_zc (f, s->pid, dst, len, s->zc_copy_buffer,
+				1 /* is_copy */ );
+      if (PREDICT_FALSE (rv < 0))
+	return rv;
+      cb->n_add_refs++;
+    }
+  else if (PREDICT_FALSE (rv < 0))
+    return rv;
+
+  s->zc_copy_offset += len;
+  return len;
+}
+
+/*
+ * Enqueue the first len bytes of buffer b for delivery to session peer.
+ * If the session's rx fifo is zero-copy, the fifo references the payload
+ * and a reference is taken on b, otherwise the payload is copied. Zero-copy
+ * fifos copy small payloads too, and everything once the thread's fifos
+ * pin too many buffers, so buffers don't run out for a few bytes each.
+ *
+ * @return Number of bytes enqueued or a negative value if enqueueing failed.
+ */
+int
+stream_session_enqueue_buffer (transport_connection_t * tc, vlib_buffer_t * b,
+			       u16 len, u8 queue_event)
+{
+  session_manager_main_t *smm = vnet_get_session_manager_main ();
+  vlib_main_t *vm = vlib_get_main ();
+  stream_session_t *s;
+  u32 *n_pinned;
+  int enqueued;
+
+  s = stream_session_get (tc->s_index, tc->thread_index);
 
-      if (s->enqueue_epoch != my_enqueue_epoch)
+  if (PREDICT_TRUE (!svm_fifo_is_zero_copy (s->server_rx_fifo)))
+    return stream_session_enqueue_data (tc, vlib_buffer_get_current (b), len,
+					queue_event);
+
+  ASSERT (len <= b->current_length);
+  ASSERT (b->n_add_refs < 255);
+
+  n_pinned = &smm->zc_n_pinned_buffers[s->thread_index];
+  if (len < SESSION_ZC_MIN_PIN_BYTES
+      || *n_pinned >= smm->zc_max_pinned_buffers)
+    {
+      enqueued = stream_session_zc_enqueue_copy (vm, s,
+						 vlib_buffer_get_current (b),
+						 len);
+    }
+  else
+    {
+      enqueued = svm_fifo_enqueue_zc (s->server_rx_fifo, s->pid,
+				      vlib_buffer_get_current (b), len,
+				      vlib_get_buffer_index (vm, b),
+				      0 /* is_copy */ );
+      /* Keep the buffer alive after the transport drops it */
+      if (PREDICT_TRUE (enqueued >= 0))
 	{
-	  s->enqueue_epoch = my_enqueue_epoch;
-	  vec_add1 (smm->session_indices_to_enqueue_by_thread[thread_index],
-		    s - smm->sessions[thread_index]);
+	  b->n_add_refs++;
+	  *n_pinned += 1;
 	}
     }
+  if (PREDICT_FALSE (enqueued < 0))
+    return enqueued;
+
+  if (queue_event)
+    stream_session_queue_enqueue_event (s);
 
   return enqueued;
 }
 
+/**
+ * Release n_bytes of rx payload read in place from a zero-copy fifo.
+ * Buffers whose payload has been fully read are freed.
+ *
+ * @return Number of bytes released.
+ */
+int
+stream_session_zc_release (stream_session_t * s, u32 n_bytes)
+{
+  session_manager_main_t *smm = vnet_get_session_manager_main ();
+  vlib_main_t *vm = vlib_get_main ();
+  u32 **released = &smm->zc_released_buffers[s->thread_index];
+  u32 n_pinned = 0;
+  int rv;
+
+  rv = svm_fifo_zc_release (s->server_rx_fifo, s->pid, n_bytes, released,
+			    &n_pinned);
+  smm->zc_n_pinned_buffers[s->thread_index] -= n_pinned;
+
+  if (vec_len (*released))
+    {
+      vlib_buffer_free (vm, *released, vec_len (*released));
+      _vec_len (*released) = 0;
+    }
+
+  return rv;
+}
+
 /** Check if we have space in rx fifo to push more bytes */
 u8
 stream_session_no_space (transport_connection_t * tc, u32 thread_index,
@@ -782,6 +1033,37 @@ stream_session_dequeue_drop (transport_connection_t * tc, u32 max_bytes)
   return svm_fifo_dequeue_drop (s->server_tx_fifo, s->pid, max_bytes);
 }
 
+/**
+ * Add rx event to the app's event ring for the session's thread.
+ *
+ * Events are coalesced per fifo: while the app has not picked up the last
+ * one, see svm_fifo_unset_event, no new event is generated. The ring is
+ * queued for a single wakeup at the end of the flush.
+ */
+static int
+stream_session_enqueue_notify_ring (session_manager_main_t * smm,
+				    stream_session_t * s, application_t * app,
+				    session_fifo_event_t * evt)
+{
+  svm_event_ring_t *r = app->event_rings[s->thread_index];
+
+  if (!svm_fifo_set_event (s->server_rx_fifo))
+    return 0;
+
+  if (PREDICT_FALSE (svm_event_ring_enqueue (r, evt)))
+    {
+      svm_fifo_unset_event (s->server_rx_fifo);
+      return -1;
+    }
+
+  if (!r->notify_pending)
+    {
+      r->notify_pending = 1;
+      vec_add1 (smm->apps_to_notify_by_thread[s->thread_index], app->index);
+    }
+  return 0;
+}
+
 /**
  * Notify session peer that new data has been enqueued.
  *
@@ -814,6 +1096,11 @@ stream_session_enqueue_notify (stream_session_t * s, u8 block)
   if (app->cb_fns.builtin_server_rx_callback)
     return app->cb_fns.builtin_server_rx_callback (s, &evt);
 
+  /* Lock-free per thread event ring? */
+  if (app->event_rings)
+    return stream_session_enqueue_notify_ring (&session_manager_main, s,
+					       app, &evt);
+
   /* Add event to server's event queue */
   q = app->event_queue;
 
@@ -846,7 +1133,8 @@ int
 session_manager_flush_enqueue_events (u32 thread_index)
 {
   session_manager_main_t *smm = &session_manager_main;
-  u32 *session_indices_to_enqueue;
+  u32 *session_indices_to_enqueue, *apps_to_notify;
+  application_t *app;
   int i, errors = 0;
 
   session_indices_to_enqueue =
@@ -869,6 +1157,20 @@ session_manager_flush_enqueue_events (u32 thread_index)
   smm->session_indices_to_enqueue_by_thread[thread_index] =
     session_indices_to_enqueue;
 
+  /* One wakeup per app ring for the whole batch */
+  apps_to_notify = smm->apps_to_notify_by_thread[thread_index];
+  for (i = 0; i < vec_len (apps_to_notify); i++)
+    {
+      app = application_get_if_valid (apps_to_notify[i]);
+      if (PREDICT_FALSE (!app || !app->event_rings))
+	continue;
+      svm_event_ring_notify (app->event_rings[thread_index],
+			     app->event_fds ? app->event_fds[thread_index] :
+			     -1);
+    }
+  vec_reset_length (apps_to_notify);
+  smm->apps_to_notify_by_thread[thread_index] = apps_to_notify;
+
   /* Increment enqueue epoch for next round */
   smm->current_enqueue_epoch[thread_index]++;
 
@@ -907,11 +1209,13 @@ stream_session_start_listen (u32 server_index, ip46_address_t * ip, u16 port)
   /* Attach transport to session */
   s->connection_index = tci;
   tc = tp_vfts[srv->session_type].get_listener (tci);
+  tc->cc_algo = srv->cc_algo;
 
   srv->session_index = s->session_index;
 
-  /* Add to the main lookup table */
-  stream_session_table_add_for_tc (s->session_type, tc, s->session_index);
+  /* Add to the listener lookup table */
+  stream_session_listener_table_add_del (s->session_type, tc,
+					 s->session_index, 1 /* is_add */ );
 
   return 0;
 }
@@ -929,7 +1233,8 @@ stream_session_stop_listen (u32 server_index)
 				srv->session_index);
 
   tc = tp_vfts[srv->session_type].get_listener (listener->connection_index);
-  stream_session_table_del_for_tc (smm, listener->session_type, tc);
+  stream_session_listener_table_add_del (listener->session_type, tc, 0,
+					 0 /* is_add */ );
 
   tp_vfts[srv->session_type].unbind (listener->connection_index);
   pool_put (smm->listen_sessions[srv->session_type], listener);
@@ -1046,6 +1351,14 @@ stream_session_delete (stream_session_t * s)
   /* Delete from the main lookup table. */
   stream_session_table_del (smm, s);
 
+  /* Return rx buffers the app hasn't consumed */
+  if (svm_fifo_is_zero_copy (s->server_rx_fifo))
+    {
+      stream_session_zc_release (s, svm_fifo_max_dequeue (s->server_rx_fifo));
+      if (s->zc_copy_buffer != ~0)
+	vlib_buffer_free_one (vlib_get_main (), s->zc_copy_buffer);
+    }
+
   /* Cleanup fifo segments */
   fifo_segment = svm_fifo_get_segment (s->server_segment_index);
   svm_fifo_segment_free_fifo (fifo_segment, s->server_rx_fifo);
@@ -1153,17 +1466,66 @@ stream_session_accept (transport_connection_t * tc, u32 listener_index,
   return 0;
 }
 
+/**
+ * The app accepted the session, mark it ready. Data enqueued while the
+ * session waited for the app got no event, e.g., the datagram that made
+ * udp create the session, so notify the app of it now: the peer may send
+ * nothing more. Called with the workers stopped at the barrier.
+ */
+void
+stream_session_accept_ready (stream_session_t * s)
+{
+  s->session_state = SESSION_STATE_READY;
+
+  if (svm_fifo_max_dequeue (s->server_rx_fifo) == 0)
+    return;
+
+  stream_session_queue_enqueue_event (s);
+  session_manager_flush_enqueue_events (s->thread_index);
+}
+
+/**
+ * Connectionless transports open connections on the spot. Create the
+ * session and tell the app it's connected, without half-open state.
+ */
+static int
+stream_session_open_connectionless (u8 sst, transport_connection_t * tc,
+				    u32 app_index)
+{
+  session_manager_main_t *smm = &session_manager_main;
+  application_t *app = application_get (app_index);
+  stream_session_t *s;
+  int rv;
+
+  tc->cc_algo = app->cc_algo;
+  if ((rv = stream_session_create_i (smm, app, tc, &s)))
+    {
+      tp_vfts[sst].cleanup (tc->c_index, tc->thread_index);
+      return rv;
+    }
+
+  app->session_index = stream_session_get_index (s);
+  app->thread_index = s->thread_index;
+
+  /* Allocate vpp event queue for this thread if needed */
+  vpp_session_event_queue_allocate (smm, tc->thread_index);
+
+  app->cb_fns.session_connected_callback (app->api_client_index, s,
+					  0 /* is_fail */ );
+  return 0;
+}
+
 int
 stream_session_open (u8 sst, ip46_address_t * addr, u16 port_host_byte_order,
 		     u32 app_index)
 {
   transport_connection_t *tc;
-  u32 tci;
+  u32 tci, thread_index = os_get_cpu_number ();
   u64 value;
   int rv;
 
   /* Ask transport to open connection */
-  rv = tp_vfts[sst].open (addr, port_host_byte_order);
+  rv = tp_vfts[sst].open (addr, port_host_byte_order, &thread_index);
   if (rv < 0)
     {
       clib_warning ("Transport failed to open connection.");
@@ -1172,8 +1534,23 @@ stream_session_open (u8 sst, ip46_address_t * addr, u16 port_host_byte_order,
 
   tci = rv;
 
+  /* No handshake, the connection is ready to send */
+  if (tp_vfts[sst].get_half_open == 0)
+    {
+      tc = tp_vfts[sst].get_connection (tci, thread_index);
+      if (thread_index == os_get_cpu_number ())
+	return stream_session_open_connectionless (sst, tc, app_index);
+
+      /* The session goes to the thread that receives the replies */
+      vlib_worker_thread_barrier_sync (vlib_get_main ());
+      rv = stream_session_open_connectionless (sst, tc, app_index);
+      vlib_worker_thread_barrier_release (vlib_get_main ());
+      return rv;
+    }
+
   /* Get transport connection */
   tc = tp_vfts[sst].get_half_open (tci);
+  tc->cc_algo = application_get (app_index)->cc_algo;
 
   /* Store api_client_index and transport connection index */
   value = (((u64) app_index) << 32) | (u64) tc->c_index;
@@ -1226,10 +1603,14 @@ session_register_transport (u8 type, const transport_proto_vft_t * vft)
   vec_validate (tp_vfts, type);
   tp_vfts[type] = *vft;
 
-  /* If an offset function is provided, then peek instead of dequeue */
-  smm->session_tx_fns[type] =
-    (vft->tx_fifo_offset) ? session_tx_fifo_peek_and_snd :
-    session_tx_fifo_dequeue_and_snd;
+  /* If an offset function is provided, then peek instead of dequeue.
+   * Datagram transports send record by record */
+  if (vft->push_dgram_header)
+    smm->session_tx_fns[type] = session_tx_fifo_dequeue_dgrams_and_snd;
+  else
+    smm->session_tx_fns[type] =
+      (vft->tx_fifo_offset) ? session_tx_fifo_peek_and_snd :
+      session_tx_fifo_dequeue_and_snd;
 }
 
 transport_proto_vft_t *
@@ -1245,7 +1626,8 @@ session_manager_main_enable (vlib_main_t * vm)
 {
   session_manager_main_t *smm = &session_manager_main;
   vlib_thread_main_t *vtm = vlib_get_thread_main ();
-  u32 num_threads;
+  u32 num_threads, nbuckets;
+  uword memory_size;
   int i;
 
   num_threads = 1 /* main thread */  + vtm->n_threads;
@@ -1260,9 +1642,14 @@ session_manager_main_enable (vlib_main_t * vm)
   /* configure per-thread ** vectors */
   vec_validate (smm->sessions, num_threads - 1);
   vec_validate (smm->session_indices_to_enqueue_by_thread, num_threads - 1);
+  vec_validate (smm->apps_to_notify_by_thread, num_threads - 1);
   vec_validate (smm->tx_buffers, num_threads - 1);
+  vec_validate (smm->zc_released_buffers, num_threads - 1);
+  vec_validate (smm->zc_n_pinned_buffers, num_threads - 1);
+  smm->zc_max_pinned_buffers = SESSION_ZC_DEFAULT_MAX_PINNED_BUFFERS;
   vec_validate (smm->fifo_events, num_threads - 1);
   vec_validate (smm->evts_partially_read, num_threads - 1);
+  vec_validate (smm->evts_postponed, num_threads - 1);
   vec_validate (smm->current_enqueue_epoch, num_threads - 1);
   vec_validate (smm->vpp_event_queues, num_threads - 1);
 
@@ -1277,12 +1664,25 @@ session_manager_main_enable (vlib_main_t * vm)
   for (i = 0; i < 200000; i++)
     pool_put_index (smm->sessions[0], i);
 
-  clib_bihash_init_16_8 (&smm->v4_session_hash, "v4 session table",
-			 200000 /* $$$$ config parameter nbuckets */ ,
-			 (64 << 20) /*$$$ config parameter table size */ );
-  clib_bihash_init_48_8 (&smm->v6_session_hash, "v6 session table",
-			 200000 /* $$$$ config parameter nbuckets */ ,
-			 (64 << 20) /*$$$ config parameter table size */ );
+  /* Per thread session tables share the space of one big table */
+  vec_validate (smm->v4_session_hash, num_threads - 1);
+  vec_validate (smm->v6_session_hash, num_threads - 1);
+  nbuckets = clib_max (200000 /* $$$$ config parameter */  / num_threads,
+		       1024);
+  memory_size = clib_max ((64 << 20) /* $$$$ config parameter */  /
+			  num_threads, 4 << 20);
+  for (i = 0; i < num_threads; i++)
+    {
+      clib_bihash_init_16_8 (&smm->v4_session_hash[i], "v4 session table",
+			     nbuckets, memory_size);
+      clib_bihash_init_48_8 (&smm->v6_session_hash[i], "v6 session table",
+			     nbuckets, memory_size);
+    }
+
+  clib_bihash_init_16_8 (&smm->v4_listener_hash, "v4 listener table",
+			 1024, 4 << 20);
+  clib_bihash_init_48_8 (&smm->v6_listener_hash, "v6 listener table",
+			 1024, 4 << 20);
 
   clib_bihash_init_16_8 (&smm->v4_half_open_hash, "v4 half-open table",
 			 200000 /* $$$$ config parameter nbuckets */ ,
@@ -1333,6 +1733,8 @@ session_manager_main_init (vlib_main_t * vm)
   smm->vlib_main = vm;
   smm->vnet_main = vnet_get_main ();
   smm->is_enabled = 0;
+  smm->tx_wait_timer_client_index =
+    vlib_timer_client_register ("session-tx-wait", session_tx_wait_expired);
 
   return 0;
 }
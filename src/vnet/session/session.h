@@ -27,6 +27,12 @@
 /* TODO decide how much since we have pre-data as well */
 #define MAX_HDRS_LEN    100	/* Max number of bytes for headers */
 
+/** Largest datagram sent, larger tx fifo records are dropped */
+#define SESSION_DGRAM_MAX_BYTES 65507
+
+/** Buffers, plus record header, a received datagram may span */
+#define SESSION_DGRAM_MAX_SEGS 64
+
 typedef enum
 {
   FIFO_EVENT_SERVER_RX,
@@ -134,6 +140,10 @@ typedef struct _stream_session_t
 
   /** svm segment index */
   u32 server_segment_index;
+
+  /** Zero-copy rx: buffer small payloads are copied to, ~0 if none */
+  u32 zc_copy_buffer;
+  u16 zc_copy_offset;
 } stream_session_t;
 
 typedef struct _session_manager
@@ -153,6 +163,31 @@ typedef struct _session_manager
   u8 add_segment;
 } session_manager_t;
 
+/** Fifo size used when the app doesn't configure one */
+#define SESSION_DEFAULT_FIFO_SIZE (128 << 10)
+
+/** Zero-copy rx payloads shorter than this are copied rather than pinned,
+ * so a pinned buffer holds at least half its size of fifo payload */
+#define SESSION_ZC_MIN_PIN_BYTES (VLIB_BUFFER_DATA_SIZE / 2)
+
+/** Zero-copy rx fifo bytes per descriptor */
+#define SESSION_ZC_BYTES_PER_DESC 256
+
+/** Default cap on rx buffers pinned by each worker's zero-copy fifos */
+#define SESSION_ZC_DEFAULT_MAX_PINNED_BUFFERS 4096
+
+always_inline u32
+session_manager_rx_fifo_size (session_manager_t * sm)
+{
+  return sm->rx_fifo_size ? sm->rx_fifo_size : SESSION_DEFAULT_FIFO_SIZE;
+}
+
+always_inline u32
+session_manager_tx_fifo_size (session_manager_t * sm)
+{
+  return sm->tx_fifo_size ? sm->tx_fifo_size : SESSION_DEFAULT_FIFO_SIZE;
+}
+
 /* Forward definition */
 typedef struct _session_manager_main session_manager_main_t;
 
@@ -164,12 +199,25 @@ typedef int
 
 extern session_fifo_rx_fn session_tx_fifo_peek_and_snd;
 extern session_fifo_rx_fn session_tx_fifo_dequeue_and_snd;
+extern session_fifo_rx_fn session_tx_fifo_dequeue_dgrams_and_snd;
+
+typedef struct
+{
+  session_fifo_event_t evt;
+  /** Session the event was for, checked before the event is requeued */
+  u32 session_index;
+} session_postponed_event_t;
 
 struct _session_manager_main
 {
-  /** Lookup tables for established sessions and listeners */
-  clib_bihash_16_8_t v4_session_hash;
-  clib_bihash_48_8_t v6_session_hash;
+  /** Per worker lookup tables for established sessions. Only the owner
+   * thread looks up its sessions, so packets need no handoff */
+  clib_bihash_16_8_t *v4_session_hash;
+  clib_bihash_48_8_t *v6_session_hash;
+
+  /** Lookup tables for listeners, shared by all threads */
+  clib_bihash_16_8_t v4_listener_hash;
+  clib_bihash_48_8_t v6_listener_hash;
 
   /** Lookup tables for half-open sessions */
   clib_bihash_16_8_t v4_half_open_hash;
@@ -190,12 +238,31 @@ struct _session_manager_main
   /** Per-worker thread vector of sessions to enqueue */
   u32 **session_indices_to_enqueue_by_thread;
 
+  /** Per-worker vector of apps whose event rings need a notify */
+  u32 **apps_to_notify_by_thread;
+
   /** per-worker tx buffer free lists */
   u32 **tx_buffers;
 
+  /** per-worker rx buffers released by zero-copy fifos, to be freed */
+  u32 **zc_released_buffers;
+
+  /** per-worker number of rx buffers pinned by zero-copy fifos */
+  u32 *zc_n_pinned_buffers;
+
+  /** Beyond this many pinned buffers per worker, rx payload is copied */
+  u32 zc_max_pinned_buffers;
+
   /** Per worker-thread vector of partially read events */
   session_fifo_event_t **evts_partially_read;
 
+  /** Per worker pool of tx events waiting for the transport, e.g. the
+   * tcp pacer, to allow sending again */
+  session_postponed_event_t **evts_postponed;
+
+  /** vlib timer client that requeues postponed events */
+  u32 tx_wait_timer_client_index;
+
   /** per-worker active event vectors */
   session_fifo_event_t **fifo_events;
 
@@ -223,6 +290,8 @@ struct _session_manager_main
 extern session_manager_main_t session_manager_main;
 extern vlib_node_registration_t session_queue_node;
 
+void session_tx_wait_expired (vlib_main_t * vm, u32 * postponed_indices);
+
 /*
  * Session manager function
  */
@@ -258,6 +327,8 @@ int
 session_manager_add_first_segment (session_manager_main_t * smm,
 				   session_manager_t * sm, u32 segment_size,
 				   u8 ** segment_name);
+int session_manager_preallocate_fifos (session_manager_t * sm,
+				       u32 n_fifo_pairs);
 void
 session_manager_del (session_manager_main_t * smm, session_manager_t * sm);
 void
@@ -339,6 +410,14 @@ stream_session_max_enqueue (transport_connection_t * tc)
   return svm_fifo_max_enqueue (s->server_rx_fifo);
 }
 
+/** Check if the session's rx fifo holds received buffers by reference */
+always_inline u8
+stream_session_rx_is_zero_copy (transport_connection_t * tc)
+{
+  stream_session_t *s = stream_session_get (tc->s_index, tc->thread_index);
+  return svm_fifo_is_zero_copy (s->server_rx_fifo);
+}
+
 always_inline u32
 stream_session_fifo_size (transport_connection_t * tc)
 {
@@ -350,6 +429,13 @@ stream_session_fifo_size (transport_connection_t * tc)
 int
 stream_session_enqueue_data (transport_connection_t * tc, u8 * data, u16 len,
 			     u8 queue_event);
+int
+stream_session_enqueue_buffer (transport_connection_t * tc, vlib_buffer_t * b,
+			       u16 len, u8 queue_event);
+int
+stream_session_enqueue_dgram (transport_connection_t * tc, vlib_buffer_t * b,
+			      transport_dgram_hdr_t * hdr, u8 queue_event);
+int stream_session_zc_release (stream_session_t * s, u32 n_bytes);
 u32
 stream_session_peek_bytes (transport_connection_t * tc, u8 * buffer,
 			   u32 offset, u32 max_bytes);
@@ -366,6 +452,7 @@ void stream_session_reset_notify (transport_connection_t * tc);
 int
 stream_session_accept (transport_connection_t * tc, u32 listener_index,
 		       u8 sst, u8 notify);
+void stream_session_accept_ready (stream_session_t * s);
 int stream_session_open (u8 sst, ip46_address_t * addr,
 			 u16 port_host_byte_order, u32 api_client_index);
 void stream_session_disconnect (stream_session_t * s);
@@ -179,6 +179,7 @@ send_session_connected_uri_callback (u32 api_client_index,
       mp->session_type = s->session_type;
       mp->vpp_event_queue_address = (u64) vpp_queue;
       mp->client_event_queue_address = (u64) app->event_queue;
+      mp->client_event_rings_address = (u64) app->event_rings;
       mp->retval = 0;
 
       session_manager_get_segment_info (s->server_segment_index, &seg_name,
@@ -331,6 +332,7 @@ send_session_connected_callback (u32 api_client_index, stream_session_t * s,
       mp->handle = make_session_handle (s);
       mp->vpp_event_queue_address = (u64) vpp_queue;
       mp->client_event_queue_address = (u64) app->event_queue;
+      mp->client_event_rings_address = (u64) app->event_rings;
 
       session_manager_get_segment_info (s->server_segment_index, &seg_name,
 					&mp->segment_size);
@@ -539,6 +541,7 @@ vl_api_bind_uri_t_handler (vl_api_bind_uri_t * mp)
 	    rmp->segment_name_length = segment_name_length;
 	  }
 	rmp->server_event_queue_address = a->server_event_queue_address;
+	rmp->server_event_rings_address = a->server_event_rings_address;
       }
   }));
   /* *INDENT-ON* */
@@ -662,7 +665,7 @@ vl_api_accept_session_reply_t_handler (vl_api_accept_session_reply_t * mp)
       return;
     }
 
-  s->session_state = SESSION_STATE_READY;
+  stream_session_accept_ready (s);
 }
 
 static void
@@ -717,6 +720,7 @@ vl_api_bind_sock_t_handler (vl_api_bind_sock_t * mp)
 	    rmp->segment_name_length = segment_name_length;
 	  }
 	rmp->server_event_queue_address = a->server_event_queue_address;
+	rmp->server_event_rings_address = a->server_event_rings_address;
       }
   }));
   /* *INDENT-ON* */
@@ -847,7 +851,7 @@ vl_api_accept_sock_reply_t_handler (vl_api_accept_sock_reply_t * mp)
       return;
     }
 
-  s->session_state = SESSION_STATE_READY;
+  stream_session_accept_ready (s);
 }
 
 #define vl_msg_name_crc_list
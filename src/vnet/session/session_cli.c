@@ -68,6 +68,27 @@ format_stream_session (u8 * s, va_list * args)
   return s;
 }
 
+static void
+show_session_fifo_segments (vlib_main_t * vm, int verbose)
+{
+  svm_fifo_segment_main_t *sm = &svm_fifo_segment_main;
+  svm_fifo_segment_private_t *fs;
+
+  if (pool_elts (sm->segments) == 0)
+    return;
+
+  vlib_cli_output (vm, "%-30s %8s %8s %8s %8s %8s %8s", "Fifo segment",
+		   "In use", "Free", "Free mem", "Size", "Heap free",
+		   "Frag");
+
+  /* *INDENT-OFF* */
+  pool_foreach (fs, sm->segments,
+  ({
+    vlib_cli_output (vm, "%U", format_svm_fifo_segment, fs, verbose);
+  }));
+  /* *INDENT-ON* */
+}
+
 static clib_error_t *
 show_session_command_fn (vlib_main_t * vm, unformat_input_t * input,
 			 vlib_cli_command_t * cmd)
@@ -128,6 +149,8 @@ show_session_command_fn (vlib_main_t * vm, unformat_input_t * input,
     }
   vec_free (str);
 
+  show_session_fifo_segments (vm, verbose);
+
   return 0;
 }
 
@@ -60,5 +60,38 @@ transport_endpoint_table_del (transport_endpoint_table_t *ht,
   clib_bihash_add_del_24_8 (ht, &kv, 0);
 }
 
+/**
+ * Thread the interface's rss steers packets from rmt to lcl to. Ports in
+ * host byte order. ~0 if the interface doesn't publish its rss placement.
+ */
+u32
+transport_reply_thread_index (vnet_hw_interface_t * hw, ip46_address_t * lcl,
+			      u16 lcl_port, ip46_address_t * rmt,
+			      u16 rmt_port, u8 is_ip4)
+{
+  u8 tuple[2 * sizeof (ip6_address_t) + 2 * sizeof (u16)], *p = tuple;
+  u16 port;
 
+  if (is_ip4)
+    {
+      clib_memcpy (p, &rmt->ip4, sizeof (ip4_address_t));
+      clib_memcpy (p + sizeof (ip4_address_t), &lcl->ip4,
+		   sizeof (ip4_address_t));
+      p += 2 * sizeof (ip4_address_t);
+    }
+  else
+    {
+      clib_memcpy (p, &rmt->ip6, sizeof (ip6_address_t));
+      clib_memcpy (p + sizeof (ip6_address_t), &lcl->ip6,
+		   sizeof (ip6_address_t));
+      p += 2 * sizeof (ip6_address_t);
+    }
 
+  port = clib_host_to_net_u16 (rmt_port);
+  clib_memcpy (p, &port, sizeof (port));
+  port = clib_host_to_net_u16 (lcl_port);
+  clib_memcpy (p + sizeof (port), &port, sizeof (port));
+  p += 2 * sizeof (port);
+
+  return vnet_hw_interface_rss_thread_index (hw, tuple, p - tuple);
+}
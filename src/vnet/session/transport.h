@@ -36,6 +36,8 @@ typedef struct _transport_connection
   u32 c_index;			/**< Connection index in transport pool */
   u8 is_ip4;			/**< Flag if IP4 connection */
   u32 thread_index;		/**< Worker-thread index */
+  u8 cc_algo;			/**< Congestion control algorithm + 1, 0 for
+				     the transport's default */
 
 #if TRANSPORT_DEBUG
   elog_track_t elog_track;	/**< Debug purposes */
@@ -56,9 +58,28 @@ typedef struct _transport_connection
 #define c_c_index connection.c_index
 #define c_is_ip4 connection.is_ip4
 #define c_thread_index connection.thread_index
+#define c_cc_algo connection.cc_algo
 #define c_elog_track connection.elog_track
 } transport_connection_t;
 
+/**
+ * Datagram record header. Fifos of datagram transports carry one ahead of
+ * every datagram's payload, so message boundaries survive the byte fifo.
+ * On rx it names the datagram's addresses, on tx the peer to send to, for
+ * sessions that are not connected. Ports are in network byte order.
+ */
+/* *INDENT-OFF* */
+typedef CLIB_PACKED (struct
+{
+  u32 data_length;		/**< Payload bytes following the header */
+  ip46_address_t rmt_ip;
+  ip46_address_t lcl_ip;
+  u16 rmt_port;
+  u16 lcl_port;
+  u8 is_ip4;
+}) transport_dgram_hdr_t;
+/* *INDENT-ON* */
+
 /*
  * Transport protocol virtual function table
  */
@@ -69,7 +90,10 @@ typedef struct _transport_proto_vft
    */
   u32 (*bind) (u32, ip46_address_t *, u16);
   u32 (*unbind) (u32);
-  int (*open) (ip46_address_t * addr, u16 port_host_byte_order);
+  /** Returns the connection, or half-open, index. Transports without a
+   *  handshake also return the thread that owns the connection */
+  int (*open) (ip46_address_t * addr, u16 port_host_byte_order,
+	       u32 * thread_index);
   void (*close) (u32 conn_index, u32 thread_index);
   void (*cleanup) (u32 conn_index, u32 thread_index);
 
@@ -77,9 +101,16 @@ typedef struct _transport_proto_vft
    * Transmission
    */
     u32 (*push_header) (transport_connection_t * tconn, vlib_buffer_t * b);
+  /** Datagram transports only, fifos hold transport_dgram_hdr_t records */
+    u32 (*push_dgram_header) (transport_connection_t * tconn,
+			      vlib_buffer_t * b, transport_dgram_hdr_t * hdr);
     u16 (*send_mss) (transport_connection_t * tc);
     u32 (*send_space) (transport_connection_t * tc);
     u32 (*tx_fifo_offset) (transport_connection_t * tc);
+    u32 (*send_gso_size) (transport_connection_t * tc);
+  /** Seconds until send_space opens up by itself, e.g. a pacer refill.
+   *  0 if only the peer can open it. Optional */
+    f64 (*send_wait) (transport_connection_t * tc);
 
   /*
    * Connection retrieval
@@ -250,6 +281,10 @@ void transport_endpoint_table_add (transport_endpoint_table_t * ht,
 				   transport_endpoint_t * te, u32 value);
 void transport_endpoint_table_del (transport_endpoint_table_t * ht,
 				   transport_endpoint_t * te);
+u32 transport_reply_thread_index (vnet_hw_interface_t * hw,
+				  ip46_address_t * lcl, u16 lcl_port,
+				  ip46_address_t * rmt, u16 rmt_port,
+				  u8 is_ip4);
 
 #endif /* VNET_VNET_URI_TRANSPORT_H_ */
 
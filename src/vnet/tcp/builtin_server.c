@@ -17,11 +17,15 @@
 #include <vlibmemory/api.h>
 #include <vnet/session/application.h>
 #include <vnet/session/application_interface.h>
+#include <vnet/tcp/tcp.h>
 
 typedef struct
 {
   u8 *rx_buf;
   unix_shared_memory_queue_t **vpp_queue;
+  u8 cc_algo;			/**< see SESSION_OPTIONS_CC_ALGO */
+  u8 rx_zero_copy;		/**< read rx payload in place */
+  u32 prealloc_fifos;		/**< fifo pairs preallocated at bind */
   vlib_main_t *vlib_main;
 } builtin_server_main_t;
 
@@ -80,6 +84,26 @@ builtin_redirect_connect_callback (u32 client_index, void *mp)
   return -1;
 }
 
+/** Echo up to max_bytes of a zero-copy rx fifo's payload */
+static int
+builtin_server_echo_in_place (stream_session_t * s, u32 max_bytes)
+{
+  svm_fifo_t *rx_fifo = s->server_rx_fifo;
+  svm_fifo_zc_desc_t *d;
+  u32 i, n_segs, len, n_bytes = 0;
+
+  n_segs = svm_fifo_zc_n_segments (rx_fifo);
+  for (i = 0; i < n_segs && n_bytes < max_bytes; i++)
+    {
+      d = svm_fifo_zc_segment (rx_fifo, i);
+      len = clib_min (d->length, max_bytes - n_bytes);
+      svm_fifo_enqueue_nowait (s->server_tx_fifo, 0, len, d->data);
+      n_bytes += len;
+    }
+
+  return stream_session_zc_release (s, n_bytes);
+}
+
 int
 builtin_server_rx_callback (stream_session_t * s, session_fifo_event_t * e)
 {
@@ -109,6 +133,14 @@ builtin_server_rx_callback (stream_session_t * s, session_fifo_event_t * e)
       return 0;
     }
 
+  if (bsm->rx_zero_copy)
+    {
+      /* Echo back straight from the rx buffers */
+      n_written = builtin_server_echo_in_place (s, total_copy_bytes);
+      ASSERT (n_written == total_copy_bytes);
+      goto send_evt;
+    }
+
   vec_validate (bsm->rx_buf, total_copy_bytes - 1);
   _vec_len (bsm->rx_buf) = total_copy_bytes;
 
@@ -123,6 +155,8 @@ builtin_server_rx_callback (stream_session_t * s, session_fifo_event_t * e)
   n_written = svm_fifo_enqueue_nowait (tx_fifo, 0, n_read, bsm->rx_buf);
   ASSERT (n_written == total_copy_bytes);
 
+send_evt:
+
   /* Fabricate TX event, send to vpp */
   evt.fifo = tx_fifo;
   evt.event_type = FIFO_EVENT_SERVER_TX;
@@ -164,9 +198,16 @@ server_create (vlib_main_t * vm)
   a->api_client_index = ~0;
   a->session_cb_vft = &builtin_session_cb_vft;
   a->options = options;
-  a->options[SESSION_OPTIONS_SEGMENT_SIZE] = 256 << 10;
+  /* Room for the preallocated fifos, plus some headroom */
+  a->options[SESSION_OPTIONS_SEGMENT_SIZE] = (256 << 10)
+    + (u64) builtin_server_main.prealloc_fifos * 2 * (65 << 10);
   a->options[SESSION_OPTIONS_RX_FIFO_SIZE] = 64 << 10;
   a->options[SESSION_OPTIONS_TX_FIFO_SIZE] = 64 << 10;
+  a->options[SESSION_OPTIONS_PREALLOCATED_FIFO_PAIRS] =
+    builtin_server_main.prealloc_fifos;
+  a->options[SESSION_OPTIONS_CC_ALGO] = builtin_server_main.cc_algo;
+  if (builtin_server_main.rx_zero_copy)
+    a->options[SESSION_OPTIONS_FLAGS] |= SESSION_OPTIONS_FLAGS_RX_ZERO_COPY;
   a->segment_name = segment_name;
   a->segment_name_length = ARRAY_LEN (segment_name);
 
@@ -177,17 +218,25 @@ static clib_error_t *
 server_create_command_fn (vlib_main_t * vm,
 			  unformat_input_t * input, vlib_cli_command_t * cmd)
 {
+  builtin_server_main_t *bsm = &builtin_server_main;
+  tcp_cc_algorithm_type_e cc_algo;
   int rv;
-#if 0
+
+  bsm->cc_algo = SESSION_OPTIONS_CC_ALGO_DEFAULT;
+  bsm->rx_zero_copy = 0;
+  bsm->prealloc_fifos = 0;
   while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
-      if (unformat (input, "whatever %d", &whatever))
+      if (unformat (input, "cc-algo %U", unformat_tcp_cc_algo, &cc_algo))
+	bsm->cc_algo = cc_algo + 1;
+      else if (unformat (input, "rx-zero-copy"))
+	bsm->rx_zero_copy = 1;
+      else if (unformat (input, "prealloc-fifos %d", &bsm->prealloc_fifos))
 	;
       else
 	return clib_error_return (0, "unknown input `%U'",
 				  format_unformat_error, input);
     }
-#endif
 
   vnet_session_enable_disable (vm, 1 /* turn on TCP, etc. */ );
   rv = server_create (vm);
@@ -205,7 +254,8 @@ server_create_command_fn (vlib_main_t * vm,
 VLIB_CLI_COMMAND (server_create_command, static) =
 {
   .path = "test server",
-  .short_help = "test server",
+  .short_help = "test server [cc-algo newreno|cubic|bbr] [rx-zero-copy]"
+    " [prealloc-fifos <nn>]",
   .function = server_create_command_fn,
 };
 /* *INDENT-ON* */
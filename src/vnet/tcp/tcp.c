@@ -16,6 +16,10 @@
 #include <vnet/tcp/tcp.h>
 #include <vnet/session/session.h>
 #include <vnet/fib/fib.h>
+#include <vnet/fib/ip4_fib.h>
+#include <vnet/fib/ip6_fib.h>
+#include <vnet/dpo/load_balance.h>
+#include <vnet/gso/gso.h>
 #include <math.h>
 
 tcp_main_t tcp_main;
@@ -117,6 +121,9 @@ tcp_connection_cleanup (tcp_connection_t * tc)
   /* Make sure all timers are cleared */
   tcp_connection_timers_reset (tc);
 
+  vec_free (tc->sack_sb.holes);
+  tcp_rack_free (tc);
+
   /* Check if half-open */
   if (tc->state == TCP_STATE_SYN_SENT)
     pool_put (tm->half_open_connections, tc);
@@ -238,21 +245,51 @@ ip_interface_get_first_ip (u32 sw_if_index, u8 is_ip4)
   return 0;
 }
 
+/** Ports tried in search of one whose replies land on the wanted thread */
+#define TCP_RSS_PORT_TRIES 512
+
+/**
+ * Thread that should receive the replies of an active open. Workers keep
+ * the connections they open, the main thread spreads them over the
+ * threads polling the interface, one rss indirection table entry at a
+ * time. ~0 if the interface doesn't publish its rss placement.
+ */
+static u32
+tcp_active_open_thread_index (tcp_main_t * tm, vnet_hw_interface_t * hw)
+{
+  u32 n_entries = vec_len (hw->rss_thread_index_by_reta);
+
+  if (n_entries == 0)
+    return ~0;
+
+  if (os_get_cpu_number () != 0)
+    return os_get_cpu_number ();
+
+  return hw->rss_thread_index_by_reta[tm->active_open_next_reta++ %
+				      n_entries];
+}
+
 #define PORT_MASK ((1 << 16)- 1)
 /**
  * Allocate local port and add if successful add entry to local endpoint
- * table to mark the pair as used.
+ * table to mark the pair as used. If the interface towards rmt publishes
+ * its rss placement, prefer a port whose replies land on the thread
+ * picked by tcp_active_open_thread_index, so the connection's packets
+ * are all handled by one thread.
  */
 u16
-tcp_allocate_local_port (tcp_main_t * tm, ip46_address_t * ip)
+tcp_allocate_local_port (tcp_main_t * tm, ip46_address_t * ip,
+			 ip46_address_t * rmt_ip, u16 rmt_port,
+			 vnet_hw_interface_t * hw, u8 is_ip4)
 {
   transport_endpoint_t *tep;
-  u32 time_now, tei;
+  u32 time_now, tei, thread_index;
   u16 min = 1024, max = 65535;	/* XXX configurable ? */
-  int tries;
+  int tries, rss_tries = 0;
 
   tries = max - min;
   time_now = tcp_time_now ();
+  thread_index = tcp_active_open_thread_index (tm, hw);
 
   /* Start at random point or max */
   pool_get (tm->local_endpoints, tep);
@@ -276,6 +313,15 @@ tcp_allocate_local_port (tcp_main_t * tm, ip46_address_t * ip)
       /* Look it up */
       tei = transport_endpoint_lookup (&tm->local_endpoints_table, &tep->ip,
 				       tep->port);
+      /* Replies would land on another thread, try some more */
+      if (thread_index != ~0 && rss_tries < TCP_RSS_PORT_TRIES
+	  && transport_reply_thread_index (hw, &tep->ip, port, rmt_ip,
+					   rmt_port, is_ip4) != thread_index)
+	{
+	  rss_tries++;
+	  continue;
+	}
+
       /* If not found, we're done */
       if (tei == TRANSPORT_ENDPOINT_INVALID_INDEX)
 	{
@@ -323,13 +369,34 @@ tcp_connection_timers_reset (tcp_connection_t * tc)
  *
  * Should be called after having received a msg from the peer, i.e., a SYN or
  * a SYNACK, such that connection options have already been exchanged. */
+/**
+ * Check if the peer is one of our own addresses, i.e., if the forwarding
+ * lookup for it resolves to a receive dpo. Such connections never reach
+ * interface-output, where super-segments are segmented.
+ */
+u8
+tcp_connection_rmt_is_local (tcp_connection_t * tc)
+{
+  const dpo_id_t *dpo;
+  index_t lbi;
+
+  if (tc->c_is_ip4)
+    lbi = ip4_fib_forwarding_lookup (0, &tc->c_rmt_ip4);
+  else
+    lbi = ip6_fib_table_fwding_lookup (&ip6_main, 0, &tc->c_rmt_ip6);
+
+  dpo = load_balance_get_bucket_i (load_balance_get (lbi), 0);
+  return dpo->dpoi_type == DPO_RECEIVE;
+}
+
 void
 tcp_connection_init_vars (tcp_connection_t * tc)
 {
   tcp_connection_timers_init (tc);
   tcp_set_snd_mss (tc);
-  tc->sack_sb.head = TCP_INVALID_SACK_HOLE_INDEX;
   tcp_cc_init (tc);
+  if (tcp_connection_rmt_is_local (tc))
+    tc->flags |= TCP_CONN_RMT_LOCAL;
 }
 
 int
@@ -377,7 +444,10 @@ tcp_connection_open (ip46_address_t * rmt_addr, u16 rmt_port, u8 is_ip4)
     }
 
   /* Allocate source port */
-  lcl_port = tcp_allocate_local_port (tm, &lcl_addr);
+  lcl_port = tcp_allocate_local_port (tm, &lcl_addr, rmt_addr, rmt_port,
+				      vnet_get_sup_hw_interface (tm->vnet_main,
+								 sw_if_index),
+				      is_ip4);
   if (lcl_port < 1)
     {
       clib_warning ("Failed to allocate src port");
@@ -411,13 +481,13 @@ tcp_connection_open (ip46_address_t * rmt_addr, u16 rmt_port, u8 is_ip4)
 }
 
 int
-tcp_session_open_ip4 (ip46_address_t * addr, u16 port)
+tcp_session_open_ip4 (ip46_address_t * addr, u16 port, u32 * thread_index)
 {
   return tcp_connection_open (addr, port, 1);
 }
 
 int
-tcp_session_open_ip6 (ip46_address_t * addr, u16 port)
+tcp_session_open_ip6 (ip46_address_t * addr, u16 port, u32 * thread_index)
 {
   return tcp_connection_open (addr, port, 0);
 }
@@ -478,6 +548,40 @@ format_tcp_timers (u8 * s, va_list * args)
   return s;
 }
 
+const char *tcp_cc_algos[] = {
+#define _(sym, str) str,
+  foreach_tcp_cc_algorithm
+#undef _
+};
+
+u8 *
+format_tcp_cc_algo (u8 * s, va_list * args)
+{
+  tcp_cc_algorithm_type_e type = va_arg (*args, tcp_cc_algorithm_type_e);
+
+  if (type < TCP_CC_N_ALGOS)
+    s = format (s, "%s", tcp_cc_algos[type]);
+  else
+    s = format (s, "UNKNOWN");
+
+  return s;
+}
+
+uword
+unformat_tcp_cc_algo (unformat_input_t * input, va_list * args)
+{
+  tcp_cc_algorithm_type_e *result = va_arg (*args, tcp_cc_algorithm_type_e *);
+  int i;
+
+  for (i = 0; i < TCP_CC_N_ALGOS; i++)
+    if (unformat (input, tcp_cc_algos[i]))
+      {
+	*result = i;
+	return 1;
+      }
+  return 0;
+}
+
 u8 *
 format_tcp_connection (u8 * s, va_list * args)
 {
@@ -507,6 +611,16 @@ format_tcp_connection_verbose (u8 * s, va_list * args)
   tcp_connection_t *tc = va_arg (*args, tcp_connection_t *);
   s = format (s, "%U %U %U", format_tcp_connection, tc, format_tcp_state,
 	      &tc->state, format_tcp_timers, tc);
+  if (tc->cc_algo)
+    s = format (s, " %U cwnd %u ssthresh %u", format_tcp_cc_algo,
+		tc->cc_algo - tcp_main.cc_algos, tc->cwnd, tc->ssthresh);
+  if (tc->pacer.bytes_per_sec)
+    s = format (s, " pacing %.3f Mbps", tc->pacer.bytes_per_sec * 8 / 1e6);
+  if (tc->sack_sb.sacked_bytes)
+    s = format (s, " sacked %u holes %u", tc->sack_sb.sacked_bytes,
+		scoreboard_n_holes (&tc->sack_sb));
+  if (tcp_rack_n_segs (&tc->rack))
+    s = format (s, " rtx-queue %u", tcp_rack_n_segs (&tc->rack));
   return s;
 }
 
@@ -562,7 +676,21 @@ u32
 tcp_session_send_space (transport_connection_t * trans_conn)
 {
   tcp_connection_t *tc = (tcp_connection_t *) trans_conn;
-  return tcp_available_snd_space (tc);
+  return clib_min (tcp_available_snd_space (tc), tcp_pacer_snd_space (tc));
+}
+
+/**
+ * The pacer, unlike the send window, refills with time. When it is what
+ * holds the connection back, tell the session layer when to retry.
+ */
+f64
+tcp_session_send_wait (transport_connection_t * trans_conn)
+{
+  tcp_connection_t *tc = (tcp_connection_t *) trans_conn;
+
+  if (tcp_available_snd_space (tc) == 0)
+    return 0;
+  return tcp_pacer_wait (tc);
 }
 
 u32
@@ -572,6 +700,32 @@ tcp_session_tx_fifo_offset (transport_connection_t * trans_conn)
   return (tc->snd_nxt - tc->snd_una);
 }
 
+/** Max super-segment payload, ip lengths must fit 16 bits */
+#define TCP_GSO_MAX_BYTES (65535 - MAX_HDRS_LEN)
+
+/**
+ * Payload bytes the session layer may push as one super-segment, 0 if
+ * large-send is off or the peer is local: ip4-local and ip6-local would
+ * get the super-segment whole, with no checksum.
+ */
+u32
+tcp_session_send_gso_size (transport_connection_t * trans_conn)
+{
+  tcp_connection_t *tc = (tcp_connection_t *) trans_conn;
+  tcp_main_t *tm = vnet_get_tcp_main ();
+
+  if (!tm->large_send || !vnet_gso_is_enabled ()
+      || (tc->flags & TCP_CONN_RMT_LOCAL))
+    return 0;
+
+  /* gso builds single buffer segments, jumbo mss gains little anyway */
+  if (tc->snd_mss + VNET_GSO_MAX_HDR_BYTES > VLIB_BUFFER_DATA_SIZE)
+    return 0;
+
+  /* Whole segments only, so only the last one of a burst is short */
+  return (TCP_GSO_MAX_BYTES / tc->snd_mss) * tc->snd_mss;
+}
+
 /* *INDENT-OFF* */
 const static transport_proto_vft_t tcp4_proto = {
   .bind = tcp_session_bind_ip4,
@@ -586,6 +740,8 @@ const static transport_proto_vft_t tcp4_proto = {
   .send_mss = tcp_session_send_mss,
   .send_space = tcp_session_send_space,
   .tx_fifo_offset = tcp_session_tx_fifo_offset,
+  .send_gso_size = tcp_session_send_gso_size,
+  .send_wait = tcp_session_send_wait,
   .format_connection = format_tcp_session,
   .format_listener = format_tcp_listener_session,
   .format_half_open = format_tcp_half_open_session,
@@ -604,6 +760,8 @@ const static transport_proto_vft_t tcp6_proto = {
   .send_mss = tcp_session_send_mss,
   .send_space = tcp_session_send_space,
   .tx_fifo_offset = tcp_session_tx_fifo_offset,
+  .send_gso_size = tcp_session_send_gso_size,
+  .send_wait = tcp_session_send_wait,
   .format_connection = format_tcp_session,
   .format_listener = format_tcp_listener_session,
   .format_half_open = format_tcp_half_open_session,
@@ -679,7 +837,8 @@ static timer_expiration_handler *timer_expiration_handlers[TCP_N_TIMERS] =
     tcp_timer_keep_handler,
     tcp_timer_waitclose_handler,
     tcp_timer_retransmit_syn_handler,
-    tcp_timer_establish_handler
+    tcp_timer_establish_handler,
+    tcp_timer_loss_probe_handler
 };
 /* *INDENT-ON* */
 
@@ -808,6 +967,30 @@ tcp_init (vlib_main_t * vm)
 
 VLIB_INIT_FUNCTION (tcp_init);
 
+static clib_error_t *
+tcp_config_fn (vlib_main_t * vm, unformat_input_t * input)
+{
+  tcp_main_t *tm = vnet_get_tcp_main ();
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "cc-algo %U", unformat_tcp_cc_algo, &tm->cc_algo))
+	;
+      else if (unformat (input, "large-send"))
+	tm->large_send = 1;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  /* Super-segments need segmenting on devices without tso */
+  if (tm->large_send)
+    return vnet_gso_enable_disable (vm, 1);
+  return 0;
+}
+
+VLIB_CONFIG_FUNCTION (tcp_config_fn, "tcp");
+
 /*
  * fd.io coding-style-patch-verification: ON
  *
@@ -66,7 +66,8 @@ format_function_t format_tcp_state;
   _(KEEP, "KEEP")                       \
   _(WAITCLOSE, "WAIT CLOSE")            \
   _(RETRANSMIT_SYN, "RETRANSMIT SYN")   \
-  _(ESTABLISH, "ESTABLISH")
+  _(ESTABLISH, "ESTABLISH")            \
+  _(LOSS_PROBE, "LOSS PROBE")
 
 typedef enum _tcp_timers
 {
@@ -81,6 +82,7 @@ typedef void (timer_expiration_handler) (u32 index);
 extern timer_expiration_handler tcp_timer_delack_handler;
 extern timer_expiration_handler tcp_timer_retransmit_handler;
 extern timer_expiration_handler tcp_timer_retransmit_syn_handler;
+extern timer_expiration_handler tcp_timer_loss_probe_handler;
 
 #define TCP_TIMER_HANDLE_INVALID ((u32) ~0)
 
@@ -108,7 +110,8 @@ void tcp_update_time (f64 now, u32 thread_index);
   _(FINSNT, "FIN sent")				\
   _(SENT_RCV_WND0, "Sent 0 receive window")     \
   _(RECOVERY, "Recovery on")                    \
-  _(FAST_RECOVERY, "Fast Recovery on")
+  _(FAST_RECOVERY, "Fast Recovery on")		\
+  _(RMT_LOCAL, "Peer is a local address")
 
 typedef enum _tcp_connection_flag_bits
 {
@@ -147,28 +150,103 @@ enum
 };
 
 #define TCP_MAX_SACK_BLOCKS 5	/**< Max number of SACK blocks stored */
-#define TCP_INVALID_SACK_HOLE_INDEX ((u32)~0)
+#define TCP_MAX_SACK_HOLES 128	/**< Max number of holes in scoreboard */
 
 typedef struct _sack_scoreboard_hole
 {
-  u32 next;		/**< Index for next entry in linked list */
-  u32 prev;		/**< Index for previous entry in linked list */
   u32 start;		/**< Start sequence number */
   u32 end;		/**< End sequence number */
 } sack_scoreboard_hole_t;
 
+/**
+ * SACK "scoreboard"
+ *
+ * Holes, i.e., ranges not sacked below the highest sacked byte, are kept
+ * sorted in a vector. Holes are found by binary search and those passed
+ * by the cumulative ack are dropped by advancing head, so the work per
+ * ACK is logarithmic in the number of holes plus the holes it changes.
+ * Splitting a hole shifts the ones after it, so the number of holes is
+ * capped at TCP_MAX_SACK_HOLES: once full, blocks that would add a hole
+ * are ignored and their bytes stay outstanding. The scoreboard is empty
+ * when nothing is sacked.
+ */
 typedef struct _sack_scoreboard
 {
-  sack_scoreboard_hole_t *holes;	/**< Pool of holes */
-  u32 head;				/**< Index to first entry */
+  sack_scoreboard_hole_t *holes;	/**< Holes, sorted by sequence number */
+  u32 head;				/**< Index of first hole in holes */
   u32 sacked_bytes;			/**< Number of bytes sacked in sb */
+  u32 high_sacked;			/**< End of highest sacked block */
 } sack_scoreboard_t;
 
+/** Data sent and not yet cumulatively acked, a retransmit queue entry */
+typedef struct _tcp_tx_segment
+{
+  u64 xmit_time;	/**< CPU clocks at last (re)transmission */
+  u32 start;		/**< Start sequence number */
+  u32 end;		/**< End sequence number */
+  u8 flags;		/**< TCP_TX_SEG_F_* */
+} tcp_tx_segment_t;
+
+#define TCP_TX_SEG_F_RETRANSMITTED	(1 << 0)
+#define TCP_TX_SEG_F_SACKED		(1 << 1)
+#define TCP_TX_SEG_F_LOST		(1 << 2)
+
+/** A retransmission, see tcp_rack_t */
+typedef struct _tcp_rack_rxt
+{
+  u64 xmit_time;	/**< CPU clocks when sent */
+  u32 start;		/**< Start sequence number */
+  u32 end;		/**< End sequence number */
+} tcp_rack_rxt_t;
+
+/**
+ * RACK, time based loss detection (RFC8985), and tail loss probes.
+ *
+ * Data is declared lost when data sent after it has been delivered and
+ * an RTT plus a reordering window have passed since it was sent. Unlike
+ * dupack counting this does not mistake reordering for loss and finds
+ * lost retransmissions, so large windows recover in about one RTT.
+ *
+ * Original transmissions, in sequence order, and retransmissions, in
+ * send order, are both sorted by send time. Loss detection walks each
+ * from where it last stopped to the first segment not yet lost, so it
+ * costs a lookup plus the segments it marks. Used only with SACK.
+ */
+typedef struct _tcp_rack
+{
+  tcp_tx_segment_t *segs;	/**< Retransmit queue, by sequence number */
+  u32 head;			/**< Index of oldest segment in segs */
+  tcp_rack_rxt_t *rxts;		/**< Retransmissions, oldest first */
+  u32 rxt_head;			/**< Index of oldest retransmission */
+  u32 scan_seq;			/**< Originals below were checked for loss */
+  u32 rxt_next;			/**< Lost data is resent from here on */
+  u32 end_seq;			/**< End of last sent data delivered */
+  u64 xmit_time;		/**< Send time of that data, 0 if none */
+  u64 rtt;			/**< RTT of that data, in clocks */
+  u64 min_rtt;			/**< Min RTT seen, in clocks */
+  u64 reo_timeout;		/**< When more data can be lost, or 0 */
+  u8 probe_sent;		/**< Tail loss probe not yet answered */
+} tcp_rack_t;
+
+#define foreach_tcp_cc_algorithm		\
+  _(NEWRENO, "newreno")				\
+  _(CUBIC, "cubic")				\
+  _(BBR, "bbr")
+
 typedef enum _tcp_cc_algorithm_type
 {
-  TCP_CC_NEWRENO,
+#define _(sym, str) TCP_CC_##sym,
+  foreach_tcp_cc_algorithm
+#undef _
+  TCP_CC_N_ALGOS
 } tcp_cc_algorithm_type_e;
 
+format_function_t format_tcp_cc_algo;
+unformat_function_t unformat_tcp_cc_algo;
+
+/** Size, in u64s, of per connection congestion control private data */
+#define TCP_CC_DATA_SZ 16
+
 typedef struct _tcp_cc_algorithm tcp_cc_algorithm_t;
 
 typedef enum _tcp_cc_ack_t
@@ -178,6 +256,14 @@ typedef enum _tcp_cc_ack_t
   TCP_CC_PARTIALACK
 } tcp_cc_ack_t;
 
+/** Token bucket used to pace transmissions, inactive when rate is 0 */
+typedef struct _tcp_pacer
+{
+  u64 bytes_per_sec;	/**< Pacing rate */
+  u64 last_update;	/**< CPU clocks at last bucket refill */
+  u32 bucket;		/**< Bytes that can be sent now */
+} tcp_pacer_t;
+
 typedef struct _tcp_connection
 {
   transport_connection_t connection;  /**< Common transport data. First! */
@@ -213,6 +299,7 @@ typedef struct _tcp_connection
 
   sack_block_t *snd_sacks;	/**< Vector of SACKs to send. XXX Fixed size? */
   sack_scoreboard_t sack_sb;	/**< SACK "scoreboard" that tracks holes */
+  tcp_rack_t rack;		/**< Retransmit queue and RACK state */
 
   u8 rcv_dupacks;	/**< Number of DUPACKs received */
   u8 snt_dupacks;	/**< Number of DUPACKs sent in a burst */
@@ -225,6 +312,9 @@ typedef struct _tcp_connection
   u32 rtx_bytes;	/**< Retransmitted bytes */
   u32 tsecr_last_ack;	/**< Timestamp echoed to us in last healthy ACK */
   tcp_cc_algorithm_t *cc_algo;	/**< Congestion control algorithm */
+  u64 delivered;	/**< Bytes delivered to the peer, acked or sacked */
+  tcp_pacer_t pacer;	/**< Transmit pacer, set by cc algorithm */
+  u64 cc_data[TCP_CC_DATA_SZ];	/**< Congestion control algorithm data */
 
   /* RTT and RTO */
   u32 rto;		/**< Retransmission timeout */
@@ -233,6 +323,8 @@ typedef struct _tcp_connection
   u32 rttvar;		/**< Smoothed mean RTT difference. Approximates variance */
   u32 rtt_ts;		/**< Timestamp for tracked ACK */
   u32 rtt_seq;		/**< Sequence number for tracked ACK */
+  u64 rtt_clocks;	/**< CPU clocks when tracked segment was sent */
+  u32 mrtt_us;		/**< RTT sample of the last ACK in us, 0 if none */
 
   u16 snd_mss;		/**< Send MSS */
 } tcp_connection_t;
@@ -246,6 +338,12 @@ struct _tcp_cc_algorithm
   void (*init) (tcp_connection_t * tc);
 };
 
+always_inline void *
+tcp_cc_data (tcp_connection_t * tc)
+{
+  return (void *) tc->cc_data;
+}
+
 #define tcp_fastrecovery_on(tc) (tc)->flags |= TCP_CONN_FAST_RECOVERY
 #define tcp_fastrecovery_off(tc) (tc)->flags &= ~TCP_CONN_FAST_RECOVERY
 #define tcp_in_fastrecovery(tc) ((tc)->flags & TCP_CONN_FAST_RECOVERY)
@@ -305,9 +403,18 @@ typedef struct _tcp_main
   /* Local endpoints lookup table */
   transport_endpoint_table_t local_endpoints_table;
 
+  /* Rss indirection table entry whose thread gets the next active open */
+  u32 active_open_next_reta;
+
   /* Congestion control algorithms registered */
   tcp_cc_algorithm_t *cc_algos;
 
+  /* Congestion control algorithm used unless the app asks otherwise */
+  tcp_cc_algorithm_type_e cc_algo;
+
+  /* Hand the session layer super-segments to be segmented by gso */
+  u8 large_send;
+
   /* Flag that indicates if stack is on or off */
   u8 is_enabled;
 
@@ -376,6 +483,7 @@ void tcp_make_synack (tcp_connection_t * ts, vlib_buffer_t * b);
 void tcp_send_reset (vlib_buffer_t * pkt, u8 is_ip4);
 void tcp_send_syn (tcp_connection_t * tc);
 void tcp_send_fin (tcp_connection_t * tc);
+void tcp_send_ack (tcp_connection_t * tc);
 void tcp_set_snd_mss (tcp_connection_t * tc);
 
 always_inline u32
@@ -439,6 +547,10 @@ tcp_available_snd_space (const tcp_connection_t * tc)
   return available_wnd - flight_size;
 }
 
+void tcp_pacer_set_rate (tcp_connection_t * tc, u64 bytes_per_sec);
+u32 tcp_pacer_snd_space (tcp_connection_t * tc);
+f64 tcp_pacer_wait (tcp_connection_t * tc);
+
 void tcp_retransmit_first_unacked (tcp_connection_t * tc);
 
 void tcp_fast_retransmit (tcp_connection_t * tc);
@@ -453,12 +565,14 @@ u32 tcp_push_header (transport_connection_t * tconn, vlib_buffer_t * b);
 
 u32
 tcp_prepare_retransmit_segment (tcp_connection_t * tc, vlib_buffer_t * b,
-				u32 max_bytes);
+				u32 offset, u32 max_bytes);
 
 void tcp_connection_timers_init (tcp_connection_t * tc);
 void tcp_connection_timers_reset (tcp_connection_t * tc);
 
 void tcp_connection_init_vars (tcp_connection_t * tc);
+u8 tcp_connection_rmt_is_local (tcp_connection_t * tc);
+u32 tcp_session_send_gso_size (transport_connection_t * trans_conn);
 
 always_inline void
 tcp_connection_force_ack (tcp_connection_t * tc, vlib_buffer_t * b)
@@ -512,34 +626,40 @@ tcp_timer_is_active (tcp_connection_t * tc, tcp_timers_e timer)
   return tc->timers[timer] != TCP_TIMER_HANDLE_INVALID;
 }
 
-void
-scoreboard_remove_hole (sack_scoreboard_t * sb,
-			sack_scoreboard_hole_t * hole);
+sack_scoreboard_hole_t *scoreboard_lookup_hole (sack_scoreboard_t * sb,
+					       u32 seq);
+u32 scoreboard_next_unsacked (sack_scoreboard_t * sb, u32 seq, u32 end,
+			      u32 * run_end);
+void tcp_rcv_sacks (tcp_connection_t * tc, u32 ack);
+
+always_inline u32
+scoreboard_n_holes (sack_scoreboard_t * sb)
+{
+  return vec_len (sb->holes) - sb->head;
+}
 
 always_inline sack_scoreboard_hole_t *
 scoreboard_next_hole (sack_scoreboard_t * sb, sack_scoreboard_hole_t * hole)
 {
-  if (hole->next != TCP_INVALID_SACK_HOLE_INDEX)
-    return pool_elt_at_index (sb->holes, hole->next);
+  if (hole + 1 < vec_end (sb->holes))
+    return hole + 1;
   return 0;
 }
 
 always_inline sack_scoreboard_hole_t *
 scoreboard_first_hole (sack_scoreboard_t * sb)
 {
-  if (sb->head != TCP_INVALID_SACK_HOLE_INDEX)
-    return pool_elt_at_index (sb->holes, sb->head);
+  if (sb->head < vec_len (sb->holes))
+    return vec_elt_at_index (sb->holes, sb->head);
   return 0;
 }
 
 always_inline void
 scoreboard_clear (sack_scoreboard_t * sb)
 {
-  sack_scoreboard_hole_t *hole = scoreboard_first_hole (sb);
-  while ((hole = scoreboard_first_hole (sb)))
-    {
-      scoreboard_remove_hole (sb, hole);
-    }
+  vec_reset_length (sb->holes);
+  sb->head = 0;
+  sb->sacked_bytes = 0;
 }
 
 always_inline u32
@@ -548,6 +668,23 @@ scoreboard_hole_bytes (sack_scoreboard_hole_t * hole)
   return hole->end - hole->start;
 }
 
+void tcp_rack_segment_sent (tcp_connection_t * tc, u32 start, u32 end);
+void tcp_rack_rcv_sacked (tcp_connection_t * tc, u32 start, u32 end);
+void tcp_rack_rcv_ack (tcp_connection_t * tc, u32 ack);
+u32 tcp_rack_detect_loss (tcp_connection_t * tc);
+void tcp_rack_mark_first_lost (tcp_connection_t * tc);
+u32 tcp_rack_next_lost (tcp_connection_t * tc, u32 max_bytes, u32 * seq);
+void tcp_rack_clear (tcp_connection_t * tc);
+void tcp_rack_free (tcp_connection_t * tc);
+void tcp_rack_loss_probe_arm (tcp_connection_t * tc);
+void tcp_rack_recover (tcp_connection_t * tc);
+
+always_inline u32
+tcp_rack_n_segs (tcp_rack_t * rack)
+{
+  return vec_len (rack->segs) - rack->head;
+}
+
 always_inline void
 tcp_cc_algo_register (tcp_cc_algorithm_type_e type,
 		      const tcp_cc_algorithm_t * vft)
@@ -567,6 +704,9 @@ tcp_cc_algo_get (tcp_cc_algorithm_type_e type)
 
 void tcp_cc_init (tcp_connection_t * tc);
 
+/** NewReno fast recovery window inflation, shared by other algorithms */
+void newreno_rcv_cong_ack (tcp_connection_t * tc, tcp_cc_ack_t ack_type);
+
 /**
  * Push TCP header to buffer
  *
@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * BBR congestion control, after Cardwell et al., "BBR: Congestion-Based
+ * Congestion Control", ACM Queue 2016.
+ *
+ * The path model is a windowed max of the delivery rate and a windowed
+ * min of the RTT. Unlike the reference implementation, which samples the
+ * delivery rate for every acked segment, we take one sample per round
+ * trip: the bytes delivered since the round started over its duration.
+ * That needs no per segment state and is what the max filter keeps anyway.
+ *
+ * BBR relies on pacing, it sets the connection's pacer rate on every ACK.
+ */
+
+#include <vnet/tcp/tcp.h>
+
+#define BBR_HIGH_GAIN 2.885		/**< 2/ln(2), startup gain */
+#define BBR_CWND_GAIN 2.0		/**< cwnd gain in PROBE_BW */
+#define BBR_BW_FILTER_ROUNDS 10		/**< Window of the bw max filter */
+#define BBR_MIN_RTT_WINDOW 10.0		/**< Window of min rtt filter, s */
+#define BBR_PROBE_RTT_TIME 0.2		/**< Time spent in PROBE_RTT, s */
+#define BBR_MIN_CWND_SEGS 4		/**< cwnd floor, segments */
+#define BBR_FULL_BW_THRESH 1.25		/**< Growth meaning pipe not full */
+#define BBR_FULL_BW_ROUNDS 3		/**< Rounds without growth to exit */
+#define BBR_N_CYCLE_PHASES 8
+
+#define foreach_bbr_mode		\
+  _(STARTUP, "startup")			\
+  _(DRAIN, "drain")			\
+  _(PROBE_BW, "probe-bw")		\
+  _(PROBE_RTT, "probe-rtt")
+
+typedef enum
+{
+#define _(sym, str) BBR_##sym,
+  foreach_bbr_mode
+#undef _
+} bbr_mode_t;
+
+static const f64 bbr_pacing_gain_cycle[BBR_N_CYCLE_PHASES] = {
+  1.25, 0.75, 1, 1, 1, 1, 1, 1
+};
+
+typedef struct
+{
+  /** Windowed max of delivery rate, bytes/s. Best, second and third best
+   * samples with the rounds they were taken in, see bbr_bw_filter_update */
+  u64 bw[3];
+  u32 bw_round[3];
+
+  u32 round_count;	/**< Round trips since connection start */
+  u32 round_end_seq;	/**< Current round ends when this is acked */
+  u64 round_delivered;	/**< tc->delivered at round start */
+  f64 round_stamp;	/**< Time at round start */
+
+  u32 min_rtt_us;	/**< Windowed min rtt */
+  f64 min_rtt_stamp;	/**< When min_rtt_us was last updated */
+
+  u64 full_bw;		/**< Bw at the last significant startup growth */
+  f64 cycle_stamp;	/**< Start of current PROBE_BW phase */
+  f64 probe_rtt_done_stamp;	/**< End of PROBE_RTT, 0 if not started */
+  u32 prior_cwnd;	/**< cwnd before loss recovery or PROBE_RTT */
+
+  u8 mode;		/**< bbr_mode_t */
+  u8 cycle_index;	/**< Phase in bbr_pacing_gain_cycle */
+  u8 full_bw_count;	/**< Rounds without significant bw growth */
+  u8 filled_pipe;	/**< Startup found the bottleneck bandwidth */
+  u8 min_rtt_expired;	/**< min_rtt_us is older than the filter window */
+} bbr_data_t;
+
+STATIC_ASSERT (sizeof (bbr_data_t) <= TCP_CC_DATA_SZ * sizeof (u64),
+	       "bbr data too large");
+
+static inline f64
+bbr_time_now (void)
+{
+  return vlib_time_now (vlib_get_main ());
+}
+
+static inline u64
+bbr_max_bw (bbr_data_t * bd)
+{
+  return bd->bw[0];
+}
+
+/**
+ * Windowed max filter that keeps only three samples, after Kathleen
+ * Nichols' algorithm as used in Linux's lib/win_minmax.c
+ */
+static void
+bbr_bw_filter_update (bbr_data_t * bd, u64 bw, u32 round)
+{
+  u32 dt = round - bd->bw_round[0];
+
+  /* New max or nothing in the window: reset */
+  if (bw >= bd->bw[0] || dt > BBR_BW_FILTER_ROUNDS)
+    {
+      bd->bw[0] = bd->bw[1] = bd->bw[2] = bw;
+      bd->bw_round[0] = bd->bw_round[1] = bd->bw_round[2] = round;
+      return;
+    }
+
+  if (bw >= bd->bw[1])
+    {
+      bd->bw[1] = bd->bw[2] = bw;
+      bd->bw_round[1] = bd->bw_round[2] = round;
+    }
+  else if (bw >= bd->bw[2])
+    {
+      bd->bw[2] = bw;
+      bd->bw_round[2] = round;
+    }
+
+  /* Age out the best sample, promoting the next best ones */
+  if (dt > BBR_BW_FILTER_ROUNDS)
+    {
+      bd->bw[0] = bd->bw[1];
+      bd->bw_round[0] = bd->bw_round[1];
+      bd->bw[1] = bd->bw[2];
+      bd->bw_round[1] = bd->bw_round[2];
+    }
+  else if (bd->bw_round[1] == bd->bw_round[0]
+	   && dt > BBR_BW_FILTER_ROUNDS / 4)
+    {
+      bd->bw[1] = bd->bw[2] = bw;
+      bd->bw_round[1] = bd->bw_round[2] = round;
+    }
+  else if (bd->bw_round[2] == bd->bw_round[1]
+	   && dt > BBR_BW_FILTER_ROUNDS / 2)
+    {
+      bd->bw[2] = bw;
+      bd->bw_round[2] = round;
+    }
+}
+
+/** Bandwidth-delay product scaled by gain, bytes */
+static inline u32
+bbr_inflight (tcp_connection_t * tc, bbr_data_t * bd, f64 gain)
+{
+  f64 bdp = (f64) bbr_max_bw (bd) * bd->min_rtt_us / 1e6;
+
+  /* Allow for delayed and stretched acks */
+  return gain * bdp + 3 * tc->snd_mss;
+}
+
+static f64
+bbr_pacing_gain (bbr_data_t * bd)
+{
+  switch (bd->mode)
+    {
+    case BBR_STARTUP:
+      return BBR_HIGH_GAIN;
+    case BBR_DRAIN:
+      return 1 / BBR_HIGH_GAIN;
+    case BBR_PROBE_BW:
+      return bbr_pacing_gain_cycle[bd->cycle_index];
+    default:
+      return 1;
+    }
+}
+
+static f64
+bbr_cwnd_gain (bbr_data_t * bd)
+{
+  switch (bd->mode)
+    {
+    case BBR_STARTUP:
+    case BBR_DRAIN:
+      return BBR_HIGH_GAIN;
+    case BBR_PROBE_BW:
+      return BBR_CWND_GAIN;
+    default:
+      return 1;
+    }
+}
+
+/** Update the model, returns 1 if a new round trip started */
+static int
+bbr_update_model (tcp_connection_t * tc, bbr_data_t * bd, f64 now)
+{
+  f64 elapsed;
+  u64 bw;
+
+  /* A stale min must give way to the current sample, even a larger one,
+   * or a path whose rtt grew keeps the old floor forever */
+  bd->min_rtt_expired = (bd->min_rtt_us
+			 && now - bd->min_rtt_stamp > BBR_MIN_RTT_WINDOW);
+  if (tc->mrtt_us && (tc->mrtt_us <= bd->min_rtt_us || bd->min_rtt_us == 0
+		      || bd->min_rtt_expired))
+    {
+      bd->min_rtt_us = tc->mrtt_us;
+      bd->min_rtt_stamp = now;
+    }
+
+  if (seq_lt (tc->snd_una, bd->round_end_seq))
+    return 0;
+
+  /* Round over, sample the delivery rate */
+  elapsed = now - bd->round_stamp;
+  if (bd->round_stamp != 0 && elapsed > 0)
+    {
+      bw = (tc->delivered - bd->round_delivered) / elapsed;
+      bbr_bw_filter_update (bd, bw, bd->round_count);
+    }
+
+  bd->round_count++;
+  bd->round_end_seq = tc->snd_una_max;
+  bd->round_delivered = tc->delivered;
+  bd->round_stamp = now;
+  return 1;
+}
+
+static void
+bbr_check_full_pipe (bbr_data_t * bd)
+{
+  if (bd->filled_pipe)
+    return;
+
+  if (bbr_max_bw (bd) >= bd->full_bw * BBR_FULL_BW_THRESH)
+    {
+      bd->full_bw = bbr_max_bw (bd);
+      bd->full_bw_count = 0;
+      return;
+    }
+
+  if (++bd->full_bw_count >= BBR_FULL_BW_ROUNDS)
+    bd->filled_pipe = 1;
+}
+
+static void
+bbr_enter_probe_bw (bbr_data_t * bd, f64 now)
+{
+  bd->mode = BBR_PROBE_BW;
+  bd->cycle_stamp = now;
+
+  /* Start anywhere but in the draining phase, to spread flows out */
+  bd->cycle_index = BBR_N_CYCLE_PHASES - 1 - (bd->round_count % 7);
+  if (bd->cycle_index == 1)
+    bd->cycle_index = 2;
+}
+
+static void
+bbr_update_mode (tcp_connection_t * tc, bbr_data_t * bd, f64 now,
+		 int round_start)
+{
+  u32 flight_size = tcp_flight_size (tc);
+  f64 gain;
+
+  if (round_start)
+    bbr_check_full_pipe (bd);
+
+  switch (bd->mode)
+    {
+    case BBR_STARTUP:
+      if (bd->filled_pipe)
+	bd->mode = BBR_DRAIN;
+      break;
+
+    case BBR_DRAIN:
+      if (flight_size <= bbr_inflight (tc, bd, 1))
+	bbr_enter_probe_bw (bd, now);
+      break;
+
+    case BBR_PROBE_BW:
+      /* Phases last at least a min rtt. Probing up also waits for the
+       * queue to build, draining ends once it is gone */
+      gain = bbr_pacing_gain_cycle[bd->cycle_index];
+      if (now - bd->cycle_stamp < bd->min_rtt_us / 1e6)
+	{
+	  if (gain >= 1 || flight_size > bbr_inflight (tc, bd, 1))
+	    break;
+	}
+      else if (gain > 1 && !tcp_in_recovery (tc)
+	       && flight_size < bbr_inflight (tc, bd, gain))
+	break;
+
+      bd->cycle_index = (bd->cycle_index + 1) % BBR_N_CYCLE_PHASES;
+      bd->cycle_stamp = now;
+      break;
+
+    case BBR_PROBE_RTT:
+      if (bd->probe_rtt_done_stamp == 0)
+	{
+	  if (flight_size <= BBR_MIN_CWND_SEGS * tc->snd_mss)
+	    bd->probe_rtt_done_stamp = now + BBR_PROBE_RTT_TIME;
+	}
+      else if (now > bd->probe_rtt_done_stamp)
+	{
+	  bd->min_rtt_stamp = now;
+	  bd->min_rtt_expired = 0;
+	  tc->cwnd = clib_max (tc->cwnd, bd->prior_cwnd);
+	  if (bd->filled_pipe)
+	    bbr_enter_probe_bw (bd, now);
+	  else
+	    bd->mode = BBR_STARTUP;
+	}
+      break;
+    }
+
+  /* Min rtt not refreshed for a while, drain the queue to measure it */
+  if (bd->mode != BBR_PROBE_RTT && bd->min_rtt_expired)
+    {
+      bd->mode = BBR_PROBE_RTT;
+      bd->prior_cwnd = tc->cwnd;
+      bd->probe_rtt_done_stamp = 0;
+    }
+}
+
+static void
+bbr_set_pacing_rate (tcp_connection_t * tc, bbr_data_t * bd)
+{
+  u64 bw = bbr_max_bw (bd);
+
+  /* No delivery rate sample yet, estimate it from cwnd and rtt */
+  if (bw == 0)
+    {
+      if (bd->min_rtt_us == 0)
+	return;
+      bw = (f64) tc->cwnd * 1e6 / bd->min_rtt_us;
+    }
+
+  tcp_pacer_set_rate (tc, bbr_pacing_gain (bd) * bw);
+}
+
+static void
+bbr_set_cwnd (tcp_connection_t * tc, bbr_data_t * bd)
+{
+  u32 target, min_cwnd = BBR_MIN_CWND_SEGS * tc->snd_mss;
+
+  if (bd->mode == BBR_PROBE_RTT)
+    {
+      tc->cwnd = clib_min (tc->cwnd, min_cwnd);
+      return;
+    }
+
+  /* No model yet, grow as in slow start */
+  if (bbr_max_bw (bd) == 0 || bd->min_rtt_us == 0)
+    {
+      tc->cwnd += tc->bytes_acked;
+      return;
+    }
+
+  target = bbr_inflight (tc, bd, bbr_cwnd_gain (bd));
+  if (bd->filled_pipe)
+    tc->cwnd = clib_min (tc->cwnd + tc->bytes_acked, target);
+  else if (tc->cwnd < target)
+    tc->cwnd += tc->bytes_acked;
+
+  tc->cwnd = clib_max (tc->cwnd, min_cwnd);
+}
+
+static void
+bbr_update (tcp_connection_t * tc)
+{
+  bbr_data_t *bd = tcp_cc_data (tc);
+  f64 now = bbr_time_now ();
+  int round_start;
+
+  round_start = bbr_update_model (tc, bd, now);
+  bbr_update_mode (tc, bd, now, round_start);
+  bbr_set_pacing_rate (tc, bd);
+}
+
+void
+bbr_rcv_ack (tcp_connection_t * tc)
+{
+  bbr_update (tc);
+  bbr_set_cwnd (tc, tcp_cc_data (tc));
+}
+
+/**
+ * In recovery the model is still updated but cwnd follows packet
+ * conservation, as set up by bbr_congestion, instead of the model
+ */
+void
+bbr_rcv_cong_ack (tcp_connection_t * tc, tcp_cc_ack_t ack_type)
+{
+  bbr_update (tc);
+  newreno_rcv_cong_ack (tc, ack_type);
+}
+
+void
+bbr_congestion (tcp_connection_t * tc)
+{
+  bbr_data_t *bd = tcp_cc_data (tc);
+
+  /* Loss is not a congestion signal for BBR. Send no more than what is
+   * being delivered until recovered, then go back to the model's cwnd */
+  bd->prior_cwnd = tc->cwnd;
+  tc->prev_ssthresh = tc->ssthresh;
+  tc->ssthresh = clib_max (tcp_flight_size (tc),
+			   BBR_MIN_CWND_SEGS * tc->snd_mss);
+}
+
+void
+bbr_recovered (tcp_connection_t * tc)
+{
+  bbr_data_t *bd = tcp_cc_data (tc);
+  tc->cwnd = clib_max (tc->cwnd, bd->prior_cwnd);
+}
+
+void
+bbr_conn_init (tcp_connection_t * tc)
+{
+  bbr_data_t *bd = tcp_cc_data (tc);
+
+  tc->ssthresh = tc->snd_wnd;
+  tc->cwnd = tcp_initial_cwnd (tc);
+
+  bd->mode = BBR_STARTUP;
+  bd->round_end_seq = tc->snd_una_max;
+  bd->round_delivered = tc->delivered;
+}
+
+const static tcp_cc_algorithm_t tcp_bbr = {
+  .congestion = bbr_congestion,
+  .recovered = bbr_recovered,
+  .rcv_ack = bbr_rcv_ack,
+  .rcv_cong_ack = bbr_rcv_cong_ack,
+  .init = bbr_conn_init
+};
+
+clib_error_t *
+bbr_init (vlib_main_t * vm)
+{
+  clib_error_t *error = 0;
+
+  tcp_cc_algo_register (TCP_CC_BBR, &tcp_bbr);
+
+  return error;
+}
+
+VLIB_INIT_FUNCTION (bbr_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * CUBIC congestion control as per RFC8312.
+ *
+ * Windows are computed in segments, as in the RFC, and converted to bytes
+ * when applied to the connection's cwnd.
+ */
+
+#include <vnet/tcp/tcp.h>
+#include <math.h>
+
+#define CUBIC_C 0.4		/**< Scaling constant, segments/s^3 */
+#define CUBIC_BETA 0.7		/**< Multiplicative decrease factor */
+
+typedef struct
+{
+  f64 w_max;		/**< Window before the last reduction, segments */
+  f64 k;		/**< Time to grow back to w_max, seconds */
+  f64 t_start;		/**< Start of congestion avoidance epoch, 0 if none */
+  f64 cwnd_acc;		/**< Fractional bytes to add to cwnd */
+} cubic_data_t;
+
+STATIC_ASSERT (sizeof (cubic_data_t) <= TCP_CC_DATA_SZ * sizeof (u64),
+	       "cubic data too large");
+
+static inline f64
+cubic_time_now (void)
+{
+  return vlib_time_now (vlib_get_main ());
+}
+
+/** W_cubic(t), RFC8312 Eq. 1 */
+static inline f64
+cubic_window (cubic_data_t * cd, f64 t)
+{
+  f64 dt = t - cd->k;
+  return CUBIC_C * dt * dt * dt + cd->w_max;
+}
+
+/** W_est(t), RFC8312 Eq. 4, window of an AIMD flow with CUBIC's beta */
+static inline f64
+cubic_reno_window (cubic_data_t * cd, f64 t, f64 rtt)
+{
+  return cd->w_max * CUBIC_BETA
+    + 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * t / rtt;
+}
+
+void
+cubic_congestion (tcp_connection_t * tc)
+{
+  cubic_data_t *cd = tcp_cc_data (tc);
+  f64 w_cur = (f64) tc->cwnd / tc->snd_mss;
+
+  /* Fast convergence: release bandwidth to newer flows */
+  if (w_cur < cd->w_max)
+    cd->w_max = w_cur * (1 + CUBIC_BETA) / 2;
+  else
+    cd->w_max = w_cur;
+
+  cd->k = cbrt (cd->w_max * (1 - CUBIC_BETA) / CUBIC_C);
+  cd->t_start = 0;
+
+  tc->prev_ssthresh = tc->ssthresh;
+  tc->ssthresh = clib_max (tc->cwnd * CUBIC_BETA, 2 * tc->snd_mss);
+}
+
+void
+cubic_recovered (tcp_connection_t * tc)
+{
+  tc->cwnd = tc->ssthresh;
+}
+
+void
+cubic_rcv_ack (tcp_connection_t * tc)
+{
+  cubic_data_t *cd = tcp_cc_data (tc);
+  f64 now, t, rtt, w_cur, w_target, w_est;
+  u32 inc;
+
+  if (tcp_in_slowstart (tc))
+    {
+      tc->cwnd += clib_min (tc->snd_mss, tc->bytes_acked);
+      return;
+    }
+
+  now = cubic_time_now ();
+  w_cur = (f64) tc->cwnd / tc->snd_mss;
+
+  /* First ack of the epoch. If we never had a loss, or grew past the old
+   * maximum, start the curve at the current window */
+  if (cd->t_start == 0)
+    {
+      cd->t_start = now;
+      if (w_cur > cd->w_max)
+	{
+	  cd->w_max = w_cur;
+	  cd->k = 0;
+	}
+    }
+
+  t = now - cd->t_start;
+  rtt = clib_max (tc->srtt, 1) * TCP_TICK;
+  w_target = cubic_window (cd, t + rtt);
+  w_est = cubic_reno_window (cd, t, rtt);
+
+  if (w_target < w_est)
+    {
+      /* TCP friendly region */
+      w_target = w_est;
+    }
+  else
+    {
+      /* Concave and convex regions, RFC8312 Sec. 4.3 and 4.4 */
+      w_target = clib_min (w_target, 1.5 * w_cur);
+    }
+
+  if (w_target <= w_cur)
+    return;
+
+  /* Grow by (target - cwnd) / cwnd segments per acked segment */
+  cd->cwnd_acc += (w_target - w_cur) / w_cur * tc->bytes_acked;
+  inc = cd->cwnd_acc;
+  tc->cwnd += inc;
+  cd->cwnd_acc -= inc;
+}
+
+void
+cubic_conn_init (tcp_connection_t * tc)
+{
+  tc->ssthresh = tc->snd_wnd;
+  tc->cwnd = tcp_initial_cwnd (tc);
+}
+
+const static tcp_cc_algorithm_t tcp_cubic = {
+  .congestion = cubic_congestion,
+  .recovered = cubic_recovered,
+  .rcv_ack = cubic_rcv_ack,
+  .rcv_cong_ack = newreno_rcv_cong_ack,
+  .init = cubic_conn_init
+};
+
+clib_error_t *
+cubic_init (vlib_main_t * vm)
+{
+  clib_error_t *error = 0;
+
+  tcp_cc_algo_register (TCP_CC_CUBIC, &tcp_cubic);
+
+  return error;
+}
+
+VLIB_INIT_FUNCTION (cubic_init);
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -188,8 +188,8 @@ tcp_options_parse (tcp_header_t * th, tcp_options_t * to)
 	  vec_reset_length (to->sacks);
 	  for (j = 0; j < to->n_sack_blocks; j++)
 	    {
-	      b.start = clib_net_to_host_u32 (*(u32 *) (data + 2 + 4 * j));
-	      b.end = clib_net_to_host_u32 (*(u32 *) (data + 6 + 4 * j));
+	      b.start = clib_net_to_host_u32 (*(u32 *) (data + 2 + 8 * j));
+	      b.end = clib_net_to_host_u32 (*(u32 *) (data + 6 + 8 * j));
 	      vec_add1 (to->sacks, b);
 	    }
 	  break;
@@ -351,10 +351,15 @@ tcp_update_rtt (tcp_connection_t * tc, u32 ack)
 
   /* Karn's rule, part 1. Don't use retransmitted segments to estimate
    * RTT because they're ambiguous. */
+  tc->mrtt_us = 0;
+
   if (tc->rtt_seq && seq_gt (ack, tc->rtt_seq) && !tc->rto_boff)
     {
       mrtt = tcp_time_now () - tc->rtt_ts;
+      tc->mrtt_us = (clib_cpu_time_now () - tc->rtt_clocks)
+	* tcp_main.tstamp_ticks_per_clock * TCP_TSTAMP_RESOLUTION * 1e6;
       tc->rtt_seq = 0;
+      tc->rtt_ts = 0;
     }
 
   /* As per RFC7323 TSecr can be used for RTTM only if the segment advances
@@ -364,11 +369,16 @@ tcp_update_rtt (tcp_connection_t * tc, u32 ack)
   else if (tcp_opts_tstamp (&tc->opt) && tc->opt.tsecr && tc->bytes_acked)
     {
       mrtt = tcp_time_now () - tc->opt.tsecr;
+      tc->mrtt_us = mrtt * TCP_TSTAMP_RESOLUTION * 1e6;
     }
 
   /* Ignore dubious measurements */
   if (mrtt == 0 || mrtt > TCP_RTT_MAX)
-    return 0;
+    {
+      if (mrtt > TCP_RTT_MAX)
+	tc->mrtt_us = 0;
+      return 0;
+    }
 
   tcp_estimate_rtt (tc, mrtt);
 
@@ -404,170 +414,236 @@ tcp_ack_is_dupack (tcp_connection_t * tc, vlib_buffer_t * b, u32 new_snd_wnd)
 	  && (new_snd_wnd == tc->snd_wnd));
 }
 
-void
-scoreboard_remove_hole (sack_scoreboard_t * sb, sack_scoreboard_hole_t * hole)
+/**
+ * Find the first hole that ends after a sequence number
+ *
+ * @return the hole or 0 if there's none
+ */
+sack_scoreboard_hole_t *
+scoreboard_lookup_hole (sack_scoreboard_t * sb, u32 seq)
 {
-  sack_scoreboard_hole_t *next, *prev;
+  sack_scoreboard_hole_t *holes = sb->holes;
+  u32 lo = sb->head, hi = vec_len (holes), mid;
 
-  if (hole->next != TCP_INVALID_SACK_HOLE_INDEX)
+  while (lo < hi)
     {
-      next = pool_elt_at_index (sb->holes, hole->next);
-      next->prev = hole->prev;
+      mid = lo + ((hi - lo) >> 1);
+      if (seq_leq (holes[mid].end, seq))
+	lo = mid + 1;
+      else
+	hi = mid;
     }
 
-  if (hole->prev != TCP_INVALID_SACK_HOLE_INDEX)
-    {
-      prev = pool_elt_at_index (sb->holes, hole->prev);
-      prev->next = hole->next;
-    }
-  else
+  return lo < vec_len (holes) ? &holes[lo] : 0;
+}
+
+/**
+ * Find the first byte in [seq, end) that has not been sacked
+ *
+ * @param run_end set to the end of the unsacked range starting at the
+ *        returned sequence number, at most end
+ * @return first unsacked sequence number, end if everything is sacked
+ */
+u32
+scoreboard_next_unsacked (sack_scoreboard_t * sb, u32 seq, u32 end,
+			  u32 * run_end)
+{
+  sack_scoreboard_hole_t *hole;
+
+  *run_end = end;
+  if (sb->sacked_bytes == 0 || seq_geq (seq, sb->high_sacked))
+    return seq;
+
+  hole = scoreboard_lookup_hole (sb, seq);
+  if (hole && seq_lt (hole->start, end))
     {
-      sb->head = hole->next;
+      if (seq_lt (hole->end, end))
+	*run_end = hole->end;
+      return seq_gt (hole->start, seq) ? hole->start : seq;
     }
 
-  pool_put (sb->holes, hole);
+  return seq_gt (end, sb->high_sacked) ? sb->high_sacked : end;
 }
 
-sack_scoreboard_hole_t *
-scoreboard_insert_hole (sack_scoreboard_t * sb, sack_scoreboard_hole_t * prev,
-			u32 start, u32 end)
+/**
+ * Drop the holes and sacked bytes the cumulative ack moves past
+ */
+static void
+scoreboard_update_ack (sack_scoreboard_t * sb, u32 snd_una, u32 ack)
 {
-  sack_scoreboard_hole_t *hole, *next;
-  u32 hole_index;
-
-  pool_get (sb->holes, hole);
-  memset (hole, 0, sizeof (*hole));
+  sack_scoreboard_hole_t *hole;
+  u32 hole_bytes = 0;
 
-  hole->start = start;
-  hole->end = end;
-  hole_index = hole - sb->holes;
+  if (sb->sacked_bytes == 0 || seq_leq (ack, snd_una))
+    return;
 
-  if (prev)
+  if (seq_geq (ack, sb->high_sacked))
     {
-      hole->prev = prev - sb->holes;
-      hole->next = prev->next;
-
-      if ((next = scoreboard_next_hole (sb, hole)))
-	next->prev = hole_index;
+      scoreboard_clear (sb);
+      return;
+    }
 
-      prev->next = hole_index;
+  /* Bytes in [snd_una, ack) that are not in holes were sacked */
+  while ((hole = scoreboard_first_hole (sb)) && seq_leq (hole->end, ack))
+    {
+      hole_bytes += scoreboard_hole_bytes (hole);
+      sb->head++;
     }
-  else
+  if (hole && seq_lt (hole->start, ack))
     {
-      sb->head = hole_index;
-      hole->prev = TCP_INVALID_SACK_HOLE_INDEX;
-      hole->next = TCP_INVALID_SACK_HOLE_INDEX;
+      hole_bytes += ack - hole->start;
+      hole->start = ack;
     }
 
-  return hole;
+  ASSERT (sb->sacked_bytes >= ack - snd_una - hole_bytes);
+  sb->sacked_bytes -= ack - snd_una - hole_bytes;
+
+  /* Reclaim the space of dropped holes once they are the majority */
+  if (sb->head > vec_len (sb->holes) >> 1)
+    {
+      vec_delete (sb->holes, sb->head, 0);
+      sb->head = 0;
+    }
 }
 
-static void
-tcp_rcv_sacks (tcp_connection_t * tc, u32 ack)
+/**
+ * Add a SACK block to the scoreboard
+ *
+ * @param new_sacked set to the smallest range that covers all the bytes
+ *        not sacked before
+ * @return 1 if the block sacked new bytes, 0 otherwise
+ */
+static int
+scoreboard_add_block (sack_scoreboard_t * sb, sack_block_t * blk,
+		      sack_block_t * new_sacked)
 {
-  sack_scoreboard_t *sb = &tc->sack_sb;
-  sack_block_t *blk, tmp;
-  sack_scoreboard_hole_t *hole, *next_hole;
-  u32 blk_index = 0;
-  int i, j;
-
-  if (!tcp_opts_sack (tc) && sb->head == TCP_INVALID_SACK_HOLE_INDEX)
-    return;
-
-  /* Remove invalid blocks */
-  vec_foreach (blk, tc->opt.sacks)
-  {
-    if (seq_lt (blk->start, blk->end)
-	&& seq_gt (blk->start, tc->snd_una)
-	&& seq_gt (blk->start, ack) && seq_lt (blk->end, tc->snd_nxt))
-      continue;
+  sack_scoreboard_hole_t *hole, new_hole;
+  u32 start = blk->start, end = blk->end, is, ie, index, n_del = 0;
+  int is_new = 0;
 
-    vec_del1 (tc->opt.sacks, blk - tc->opt.sacks);
-  }
+  hole = scoreboard_lookup_hole (sb, start);
 
-  /* Add block for cumulative ack */
-  if (seq_gt (ack, tc->snd_una))
+  /* A full scoreboard ignores blocks that would split a hole or open one
+   * above high_sacked. Either touches no other hole */
+  if (PREDICT_FALSE (scoreboard_n_holes (sb) >= TCP_MAX_SACK_HOLES))
     {
-      tmp.start = tc->snd_una;
-      tmp.end = ack;
-      vec_add1 (tc->opt.sacks, tmp);
+      if (hole && seq_gt (start, hole->start) && seq_lt (end, hole->end))
+	return 0;
+      if (seq_gt (start, sb->high_sacked))
+	return 0;
     }
 
-  if (vec_len (tc->opt.sacks) == 0)
-    return;
+  /* Sack the holes the block overlaps. Holes it covers are consecutive
+   * and deleted at once */
+  while (hole && seq_lt (hole->start, end))
+    {
+      is = seq_gt (start, hole->start) ? start : hole->start;
+      ie = seq_lt (end, hole->end) ? end : hole->end;
+      sb->sacked_bytes += ie - is;
+      if (!is_new)
+	new_sacked->start = is;
+      new_sacked->end = ie;
+      is_new = 1;
+
+      if (seq_leq (start, hole->start))
+	{
+	  /* Block covers hole */
+	  if (seq_geq (end, hole->end))
+	    {
+	      n_del++;
+	      hole = scoreboard_next_hole (sb, hole);
+	      continue;
+	    }
+	  /* Block covers the start of the hole */
+	  hole->start = end;
+	  break;
+	}
 
-  /* Make sure blocks are ordered */
-  for (i = 0; i < vec_len (tc->opt.sacks); i++)
-    for (j = i; j < vec_len (tc->opt.sacks); j++)
-      if (seq_lt (tc->opt.sacks[j].start, tc->opt.sacks[i].start))
+      /* Block covers the end of the hole */
+      if (seq_geq (end, hole->end))
 	{
-	  tmp = tc->opt.sacks[i];
-	  tc->opt.sacks[i] = tc->opt.sacks[j];
-	  tc->opt.sacks[j] = tmp;
+	  hole->end = start;
+	  hole = scoreboard_next_hole (sb, hole);
+	  continue;
 	}
 
-  /* If no holes, insert the first that covers all outstanding bytes */
-  if (sb->head == TCP_INVALID_SACK_HOLE_INDEX)
-    {
-      scoreboard_insert_hole (sb, 0, tc->snd_una, tc->snd_una_max);
+      /* Block is inside the hole, split it */
+      index = hole - sb->holes;
+      new_hole.start = end;
+      new_hole.end = hole->end;
+      hole->end = start;
+      vec_insert_elts (sb->holes, &new_hole, 1, index + 1);
+      break;
     }
 
-  /* Walk the holes with the SACK blocks */
-  hole = pool_elt_at_index (sb->holes, sb->head);
-  while (hole && blk_index < vec_len (tc->opt.sacks))
+  if (n_del)
     {
-      blk = &tc->opt.sacks[blk_index];
+      index = (hole ? hole - sb->holes : vec_len (sb->holes)) - n_del;
+      vec_delete (sb->holes, n_del, index);
+    }
 
-      if (seq_leq (blk->start, hole->start))
+  /* Block extends past everything sacked so far */
+  if (seq_gt (end, sb->high_sacked))
+    {
+      if (seq_gt (start, sb->high_sacked))
 	{
-	  /* Block covers hole. Remove hole */
-	  if (seq_geq (blk->end, hole->end))
-	    {
-	      next_hole = scoreboard_next_hole (sb, hole);
-
-	      /* Byte accounting */
-	      if (seq_lt (hole->end, ack))
-		{
-		  /* Bytes lost because snd wnd left edge advances */
-		  if (seq_lt (next_hole->start, ack))
-		    sb->sacked_bytes -= next_hole->start - hole->end;
-		  else
-		    sb->sacked_bytes -= ack - hole->end;
-		}
-	      else
-		{
-		  sb->sacked_bytes += scoreboard_hole_bytes (hole);
-		}
-
-	      scoreboard_remove_hole (sb, hole);
-	      hole = next_hole;
-	    }
-	  /* Partial overlap */
-	  else
-	    {
-	      sb->sacked_bytes += blk->end - hole->start;
-	      hole->start = blk->end;
-	      blk_index++;
-	    }
+	  new_hole.start = sb->high_sacked;
+	  new_hole.end = start;
+	  vec_add1 (sb->holes, new_hole);
 	}
       else
-	{
-	  /* Hole must be split */
-	  if (seq_leq (blk->end, hole->end))
-	    {
-	      sb->sacked_bytes += blk->end - blk->start;
-	      scoreboard_insert_hole (sb, hole, blk->end, hole->end);
-	      hole->end = blk->start - 1;
-	      blk_index++;
-	    }
-	  else
-	    {
-	      sb->sacked_bytes += hole->end - blk->start + 1;
-	      hole->end = blk->start - 1;
-	      hole = scoreboard_next_hole (sb, hole);
-	    }
-	}
+	start = sb->high_sacked;
+
+      sb->sacked_bytes += end - start;
+      if (!is_new)
+	new_sacked->start = start;
+      new_sacked->end = end;
+      is_new = 1;
+      sb->high_sacked = end;
     }
+
+  return is_new;
+}
+
+/**
+ * Update the SACK scoreboard with an ACK's cumulative ack and blocks
+ *
+ * Must be called before snd_una is updated. Newly sacked data is also
+ * reported to RACK.
+ */
+void
+tcp_rcv_sacks (tcp_connection_t * tc, u32 ack)
+{
+  sack_scoreboard_t *sb = &tc->sack_sb;
+  sack_block_t *blk, new_sacked[TCP_MAX_SACK_BLOCKS];
+  u32 n_new = 0, i;
+
+  scoreboard_update_ack (sb, tc->snd_una, ack);
+
+  if (!tcp_opts_sack (&tc->opt))
+    return;
+
+  if (sb->sacked_bytes == 0)
+    {
+      scoreboard_clear (sb);
+      sb->high_sacked = ack;
+    }
+
+  vec_foreach (blk, tc->opt.sacks)
+  {
+    if (PREDICT_FALSE (n_new == TCP_MAX_SACK_BLOCKS))
+      break;
+
+    /* Ignore invalid and D-SACK blocks */
+    if (seq_geq (blk->start, blk->end) || seq_leq (blk->start, ack)
+	|| seq_gt (blk->end, tc->snd_una_max))
+      continue;
+
+    n_new += scoreboard_add_block (sb, blk, &new_sacked[n_new]);
+  }
+
+  for (i = 0; i < n_new; i++)
+    tcp_rack_rcv_sacked (tc, new_sacked[i].start, new_sacked[i].end);
 }
 
 /** Update snd_wnd
@@ -626,8 +702,11 @@ tcp_cc_rcv_ack (tcp_connection_t * tc)
 	  tc->rtx_bytes = 0;
 	  tc->cc_algo->rcv_cong_ack (tc, TCP_CC_PARTIALACK);
 
-	  /* Retransmit first unacked segment */
-	  tcp_retransmit_first_unacked (tc);
+	  /* Retransmit first unacked segment. With SACK, RACK decides what
+	   * is lost, the first unacked segment may be a retransmission
+	   * still in flight */
+	  if (!tcp_opts_sack_permitted (&tc->opt))
+	    tcp_retransmit_first_unacked (tc);
 	}
     }
   else
@@ -639,13 +718,38 @@ tcp_cc_rcv_ack (tcp_connection_t * tc)
   tc->tsecr_last_ack = tc->opt.tsecr;
 }
 
+static void
+tcp_cc_fastrecovery_enter (tcp_connection_t * tc)
+{
+  tcp_fastrecovery_on (tc);
+
+  /* Handle congestion and dupack */
+  tcp_cc_congestion (tc);
+  tc->cc_algo->rcv_cong_ack (tc, TCP_CC_DUPACK);
+
+  /* Without loss found by RACK, the first unacked segment is lost */
+  if (tcp_opts_sack_permitted (&tc->opt))
+    tcp_rack_mark_first_lost (tc);
+
+  tcp_fast_retransmit (tc);
+
+  /* Post retransmit update cwnd to ssthresh and account for the
+   * three segments that have left the network and should've been
+   * buffered at the receiver */
+  tc->cwnd = tc->ssthresh + TCP_DUPACK_THRESHOLD * tc->snd_mss;
+}
+
 static void
 tcp_cc_rcv_dupack (tcp_connection_t * tc, u32 ack)
 {
   ASSERT (tc->snd_una == ack);
 
   tc->rcv_dupacks++;
-  if (tc->rcv_dupacks == TCP_DUPACK_THRESHOLD)
+  if (tcp_in_fastrecovery (tc))
+    {
+      tc->cc_algo->rcv_cong_ack (tc, TCP_CC_DUPACK);
+    }
+  else if (tc->rcv_dupacks == TCP_DUPACK_THRESHOLD && !tcp_in_recovery (tc))
     {
       /* RFC6582 NewReno heuristic to avoid multiple fast retransmits */
       if (tc->opt.tsecr != tc->tsecr_last_ack)
@@ -654,31 +758,50 @@ tcp_cc_rcv_dupack (tcp_connection_t * tc, u32 ack)
 	  return;
 	}
 
-      tcp_fastrecovery_on (tc);
+      tcp_cc_fastrecovery_enter (tc);
+    }
+}
 
-      /* Handle congestion and dupack */
-      tcp_cc_congestion (tc);
-      tc->cc_algo->rcv_cong_ack (tc, TCP_CC_DUPACK);
+/**
+ * Retransmit data RACK finds lost, entering fast recovery if needed
+ *
+ * Called for every ACK, and when the reordering timer expires, on
+ * connections that do SACK.
+ */
+void
+tcp_rack_recover (tcp_connection_t * tc)
+{
+  u32 n_lost;
 
-      tcp_fast_retransmit (tc);
+  if (!tcp_opts_sack_permitted (&tc->opt))
+    return;
 
-      /* Post retransmit update cwnd to ssthresh and account for the
-       * three segments that have left the network and should've been
-       * buffered at the receiver */
-      tc->cwnd = tc->ssthresh + TCP_DUPACK_THRESHOLD * tc->snd_mss;
+  n_lost = tcp_rack_detect_loss (tc);
+  if (!tcp_in_recovery (tc))
+    {
+      if (n_lost)
+	tcp_cc_fastrecovery_enter (tc);
     }
-  else if (tc->rcv_dupacks > TCP_DUPACK_THRESHOLD)
+  else if (tcp_in_fastrecovery (tc))
     {
-      ASSERT (tcp_in_fastrecovery (tc));
-
-      tc->cc_algo->rcv_cong_ack (tc, TCP_CC_DUPACK);
+      tcp_fast_retransmit (tc);
     }
 }
 
 void
 tcp_cc_init (tcp_connection_t * tc)
 {
-  tc->cc_algo = tcp_cc_algo_get (TCP_CC_NEWRENO);
+  tcp_main_t *tm = vnet_get_tcp_main ();
+  tcp_cc_algorithm_type_e type = tm->cc_algo;
+
+  /* Algorithm requested by the application, if any and known */
+  if (tc->c_cc_algo && tc->c_cc_algo <= vec_len (tm->cc_algos)
+      && tm->cc_algos[tc->c_cc_algo - 1].init)
+    type = tc->c_cc_algo - 1;
+
+  memset (tc->cc_data, 0, sizeof (tc->cc_data));
+  memset (&tc->pacer, 0, sizeof (tc->pacer));
+  tc->cc_algo = tcp_cc_algo_get (type);
   tc->cc_algo->init (tc);
 }
 
@@ -686,7 +809,7 @@ static int
 tcp_rcv_ack (tcp_connection_t * tc, vlib_buffer_t * b,
 	     tcp_header_t * th, u32 * next, u32 * error)
 {
-  u32 new_snd_wnd;
+  u32 new_snd_wnd, prev_sacked_bytes;
 
   /* If the ACK acks something not yet sent (SEG.ACK > SND.NXT) then send an
    * ACK, drop the segment, and return  */
@@ -705,14 +828,23 @@ tcp_rcv_ack (tcp_connection_t * tc, vlib_buffer_t * b,
       return -1;
     }
 
+  prev_sacked_bytes = tc->sack_sb.sacked_bytes;
   if (tcp_opts_sack_permitted (&tc->opt))
-    tcp_rcv_sacks (tc, vnet_buffer (b)->tcp.ack_number);
+    {
+      tcp_rcv_sacks (tc, vnet_buffer (b)->tcp.ack_number);
+      tcp_rack_rcv_ack (tc, vnet_buffer (b)->tcp.ack_number);
+    }
+
+  /* Newly sacked bytes count as delivered. Cumulatively acked bytes that
+   * were sacked before shrink the scoreboard and are not counted twice */
+  tc->delivered += (i32) (tc->sack_sb.sacked_bytes - prev_sacked_bytes);
 
   new_snd_wnd = clib_net_to_host_u16 (th->window) << tc->snd_wscale;
 
   if (tcp_ack_is_dupack (tc, b, new_snd_wnd))
     {
       tcp_cc_rcv_dupack (tc, vnet_buffer (b)->tcp.ack_number);
+      tcp_rack_recover (tc);
       *error = TCP_ERROR_ACK_DUP;
       return -1;
     }
@@ -720,6 +852,7 @@ tcp_rcv_ack (tcp_connection_t * tc, vlib_buffer_t * b,
   /* Valid ACK */
   tc->bytes_acked = vnet_buffer (b)->tcp.ack_number - tc->snd_una;
   tc->snd_una = vnet_buffer (b)->tcp.ack_number;
+  tc->delivered += tc->bytes_acked;
 
   /* Dequeue ACKed packet and update RTT */
   tcp_dequeue_acked (tc, vnet_buffer (b)->tcp.ack_number);
@@ -729,15 +862,22 @@ tcp_rcv_ack (tcp_connection_t * tc, vlib_buffer_t * b,
 
   /* Updates congestion control (slow start/congestion avoidance) */
   tcp_cc_rcv_ack (tc);
+  tcp_rack_recover (tc);
 
   TCP_EVT_DBG (TCP_EVT_ACK_RCVD, tc);
 
   /* If everything has been acked, stop retransmit timer
    * otherwise update */
   if (tc->snd_una == tc->snd_una_max)
-    tcp_timer_reset (tc, TCP_TIMER_RETRANSMIT);
+    {
+      tcp_timer_reset (tc, TCP_TIMER_RETRANSMIT);
+      tcp_timer_reset (tc, TCP_TIMER_LOSS_PROBE);
+    }
   else
-    tcp_timer_update (tc, TCP_TIMER_RETRANSMIT, tc->rto);
+    {
+      tcp_timer_update (tc, TCP_TIMER_RETRANSMIT, tc->rto);
+      tcp_rack_loss_probe_arm (tc);
+    }
 
   return 0;
 }
@@ -808,9 +948,8 @@ tcp_session_enqueue_data (tcp_connection_t * tc, vlib_buffer_t * b,
       return TCP_ERROR_PURE_ACK;
     }
 
-  written = stream_session_enqueue_data (&tc->connection,
-					 vlib_buffer_get_current (b),
-					 data_len, 1 /* queue event */ );
+  written = stream_session_enqueue_buffer (&tc->connection, b, data_len,
+					   1 /* queue event */ );
 
   /* Update rcv_nxt */
   if (PREDICT_TRUE (written == data_len))
@@ -834,7 +973,10 @@ tcp_session_enqueue_data (tcp_connection_t * tc, vlib_buffer_t * b,
     }
   else
     {
-      ASSERT (0);
+      /* Zero-copy fifos can run out of descriptors before running out of
+       * space. Drop, the peer will retransmit */
+      ASSERT (written < 0
+	      && stream_session_rx_is_zero_copy (&tc->connection));
       return TCP_ERROR_FIFO_FULL;
     }
 
@@ -949,8 +1091,14 @@ tcp_segment_rcv (tcp_main_t * tm, tcp_connection_t * tc, vlib_buffer_t * b,
        * output */
       if ((tc->flags & TCP_CONN_BURSTACK) == 0)
 	{
-	  *next0 = tcp_next_output (tc->c_is_ip4);
-	  tcp_make_ack (tc, b);
+	  /* Buffer held by a zero-copy rx fifo, can't be turned into ACK */
+	  if (PREDICT_FALSE (b->n_add_refs != 0))
+	    tcp_send_ack (tc);
+	  else
+	    {
+	      *next0 = tcp_next_output (tc->c_is_ip4);
+	      tcp_make_ack (tc, b);
+	    }
 	  error = TCP_ERROR_ENQUEUED;
 
 	  /* TODO: maybe add counter to ensure N acks will be sent/burst */
@@ -1714,8 +1862,13 @@ tcp46_rcv_process_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	    case TCP_STATE_SYN_RCVD:
 	      /* Send FIN-ACK notify app and enter CLOSE-WAIT */
 	      tcp_connection_timers_reset (tc0);
-	      tcp_make_fin (tc0, b0);
-	      next0 = tcp_next_output (tc0->c_is_ip4);
+	      if (PREDICT_FALSE (b0->n_add_refs != 0))
+		tcp_send_fin (tc0);
+	      else
+		{
+		  tcp_make_fin (tc0, b0);
+		  next0 = tcp_next_output (tc0->c_is_ip4);
+		}
 	      stream_session_disconnect_notify (&tc0->connection);
 	      tc0->state = TCP_STATE_CLOSE_WAIT;
 	      break;
@@ -1733,8 +1886,13 @@ tcp46_rcv_process_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 	      /* Got FIN, send ACK! */
 	      tc0->state = TCP_STATE_TIME_WAIT;
 	      tcp_timer_set (tc0, TCP_TIMER_WAITCLOSE, TCP_CLOSEWAIT_TIME);
-	      tcp_make_ack (tc0, b0);
-	      next0 = tcp_next_output (is_ip4);
+	      if (PREDICT_FALSE (b0->n_add_refs != 0))
+		tcp_send_ack (tc0);
+	      else
+		{
+		  tcp_make_ack (tc0, b0);
+		  next0 = tcp_next_output (is_ip4);
+		}
 	      break;
 	    case TCP_STATE_TIME_WAIT:
 	      /* Remain in the TIME-WAIT state. Restart the 2 MSL time-wait
@@ -1926,6 +2084,8 @@ tcp46_listen_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
 			   sizeof (ip6_address_t));
 	    }
 
+	  child0->c_cc_algo = lc0->c_cc_algo;
+
 	  if (stream_session_accept (&child0->connection, lc0->c_s_index, sst,
 				     0 /* notify */ ))
 	    {
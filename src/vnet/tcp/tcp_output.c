@@ -381,6 +381,10 @@ do {                                                                    \
   _vec_len (my_tx_buffers) -= 1;                                        \
 } while (0)
 
+/** Give back the buffer last taken with tcp_get_free_buffer_index */
+#define tcp_return_buffer(tm)						\
+  _vec_len (tm->tx_buffers[tm->vlib_main->cpu_index]) += 1
+
 always_inline void
 tcp_reuse_buffer (vlib_main_t * vm, vlib_buffer_t * b)
 {
@@ -771,6 +775,7 @@ tcp_send_syn (tcp_connection_t * tc)
 
   /* Measure RTT with this */
   tc->rtt_ts = tcp_time_now ();
+  tc->rtt_clocks = clib_cpu_time_now ();
   tc->rtt_seq = tc->snd_nxt;
 
   /* Start retransmit trimer  */
@@ -827,6 +832,25 @@ tcp_send_fin (tcp_connection_t * tc)
   TCP_EVT_DBG (TCP_EVT_FIN_SENT, tc);
 }
 
+/**
+ * Send ACK on a new buffer, for when the received segment's buffer can't
+ * be reused, e.g., because it is held by a zero-copy rx fifo
+ */
+void
+tcp_send_ack (tcp_connection_t * tc)
+{
+  vlib_buffer_t *b;
+  u32 bi;
+  tcp_main_t *tm = vnet_get_tcp_main ();
+  vlib_main_t *vm = tm->vlib_main;
+
+  tcp_get_free_buffer_index (tm, &bi);
+  b = vlib_get_buffer (vm, bi);
+
+  tcp_make_ack (tc, b);
+  tcp_enqueue_to_output (vm, b, bi, tc->c_is_ip4);
+}
+
 always_inline u8
 tcp_make_state_flags (tcp_state_t next_state)
 {
@@ -859,7 +883,7 @@ tcp_push_hdr_i (tcp_connection_t * tc, vlib_buffer_t * b,
   tcp_options_t _snd_opts, *snd_opts = &_snd_opts;
   tcp_header_t *th;
 
-  data_len = b->current_length;
+  data_len = vlib_buffer_length_in_chain (vlib_get_main (), b);
   vnet_buffer (b)->tcp.flags = 0;
 
   /* Make and write options */
@@ -883,10 +907,108 @@ tcp_push_hdr_i (tcp_connection_t * tc, vlib_buffer_t * b,
   /* Tag the buffer with the connection index  */
   vnet_buffer (b)->tcp.connection_index = tc->c_c_index;
 
+  /* More than a segment's worth, leave segmenting to gso */
+  if (PREDICT_FALSE (data_len > tc->snd_mss))
+    {
+      vnet_buffer_opaque2_t *o2 = vnet_buffer2 (b);
+      b->flags |= VNET_BUFFER_GSO;
+      o2->gso.gso_size = tc->snd_mss;
+      o2->gso.l4_hdr_offset = b->current_data;
+      o2->gso.l4_hdr_sz = tcp_hdr_opts_len;
+      o2->gso.is_ip4 = tc->c_is_ip4;
+    }
+  else
+    b->flags &= ~VNET_BUFFER_GSO;
+
+  if (data_len && tcp_opts_sack_permitted (&tc->opt))
+    tcp_rack_segment_sent (tc, tc->snd_nxt, tc->snd_nxt + data_len);
+
   tc->snd_nxt += data_len;
   TCP_EVT_DBG (TCP_EVT_PKTIZE, tc);
 }
 
+/** Max pacer burst, as time worth of bytes at the pacing rate */
+#define TCP_PACER_MAX_BURST 1e-3
+
+/**
+ * Set pacing rate, 0 to stop pacing.
+ *
+ * Only new data pushed by the session layer is paced. Retransmissions and
+ * control segments are sent as soon as possible.
+ */
+void
+tcp_pacer_set_rate (tcp_connection_t * tc, u64 bytes_per_sec)
+{
+  tcp_pacer_t *pacer = &tc->pacer;
+
+  if (pacer->bytes_per_sec == 0)
+    {
+      pacer->last_update = clib_cpu_time_now ();
+      pacer->bucket = 2 * tc->snd_mss;
+    }
+  pacer->bytes_per_sec = bytes_per_sec;
+}
+
+static void
+tcp_pacer_refill (tcp_connection_t * tc)
+{
+  tcp_pacer_t *pacer = &tc->pacer;
+  u64 now = clib_cpu_time_now (), n_bytes, max_burst;
+  f64 seconds;
+
+  seconds = (now - pacer->last_update) * tcp_main.tstamp_ticks_per_clock
+    * TCP_TSTAMP_RESOLUTION;
+  n_bytes = seconds * pacer->bytes_per_sec;
+
+  /* Less than a byte since last refill, wait for it to accumulate */
+  if (n_bytes == 0)
+    return;
+
+  max_burst = clib_max (pacer->bytes_per_sec * TCP_PACER_MAX_BURST,
+			2 * tc->snd_mss);
+  pacer->bucket = clib_min (pacer->bucket + n_bytes, max_burst);
+  pacer->last_update = now;
+}
+
+/**
+ * Bytes of new data the pacer lets us send now, ~0 if not pacing.
+ *
+ * Returns 0 until at least a full segment can be sent, to avoid slicing
+ * the stream into tiny segments.
+ */
+u32
+tcp_pacer_snd_space (tcp_connection_t * tc)
+{
+  if (tc->pacer.bytes_per_sec == 0)
+    return ~0;
+
+  tcp_pacer_refill (tc);
+  if (tc->pacer.bucket < tc->snd_mss)
+    return 0;
+  return tc->pacer.bucket;
+}
+
+/**
+ * Seconds until the pacer lets a full segment go, 0 if it already does
+ * or if not pacing. Call after tcp_pacer_snd_space, which refills.
+ */
+f64
+tcp_pacer_wait (tcp_connection_t * tc)
+{
+  tcp_pacer_t *pacer = &tc->pacer;
+
+  if (pacer->bytes_per_sec == 0 || pacer->bucket >= tc->snd_mss)
+    return 0;
+  return (f64) (tc->snd_mss - pacer->bucket) / pacer->bytes_per_sec;
+}
+
+always_inline void
+tcp_pacer_consume (tcp_connection_t * tc, u32 n_bytes)
+{
+  if (tc->pacer.bytes_per_sec)
+    tc->pacer.bucket -= clib_min (tc->pacer.bucket, n_bytes);
+}
+
 /* Send delayed ACK when timer expires */
 void
 tcp_timer_delack_handler (u32 index)
@@ -915,50 +1037,34 @@ tcp_timer_delack_handler (u32 index)
 
 /** Build a retransmit segment
  *
+ * @param offset offset of the data to resend relative to snd_una
  * @return the number of bytes in the segment or 0 if there's nothing to
  *         retransmit
  * */
 u32
 tcp_prepare_retransmit_segment (tcp_connection_t * tc, vlib_buffer_t * b,
-				u32 max_bytes)
+				u32 offset, u32 max_bytes)
 {
   tcp_main_t *tm = vnet_get_tcp_main ();
   vlib_main_t *vm = tm->vlib_main;
-  u32 n_bytes, offset = 0;
-  sack_scoreboard_hole_t *hole;
-  u32 hole_size;
+  int n_bytes;
 
   tcp_reuse_buffer (vm, b);
 
   ASSERT (tc->state >= TCP_STATE_ESTABLISHED);
   ASSERT (max_bytes != 0);
 
-  if (tcp_opts_sack_permitted (&tc->opt))
-    {
-      /* XXX get first hole not retransmitted yet  */
-      hole = scoreboard_first_hole (&tc->sack_sb);
-      if (!hole)
-	return 0;
-
-      offset = hole->start - tc->snd_una;
-      hole_size = hole->end - hole->start;
-
-      ASSERT (hole_size);
-
-      if (hole_size < max_bytes)
-	max_bytes = hole_size;
-    }
-  else
-    {
-      if (seq_geq (tc->snd_nxt, tc->snd_una_max))
-	return 0;
-    }
+  if (seq_geq (tc->snd_una + offset, tc->snd_una_max))
+    return 0;
 
   n_bytes = stream_session_peek_bytes (&tc->connection,
 				       vlib_buffer_get_current (b), offset,
 				       max_bytes);
-  ASSERT (n_bytes != 0);
+  if (n_bytes <= 0)
+    return 0;
 
+  b->current_length = n_bytes;
+  tc->snd_nxt = tc->snd_una + offset;
   tcp_push_hdr_i (tc, b, tc->state);
 
   return n_bytes;
@@ -1010,14 +1116,23 @@ tcp_timer_retransmit_handler_i (u32 index, u8 is_syn)
       if (max_bytes == 0)
 	{
 	  clib_warning ("no wnd to retransmit");
+	  tcp_return_buffer (tm);
 	  return;
 	}
-      tcp_prepare_retransmit_segment (tc, b, max_bytes);
-
-      tc->rtx_bytes += max_bytes;
 
-      /* No fancy recovery for now! */
+      /* No fancy recovery for now! Everything is resent */
       scoreboard_clear (&tc->sack_sb);
+      tcp_rack_clear (tc);
+
+      max_bytes = tcp_prepare_retransmit_segment (tc, b, 0, max_bytes);
+      if (max_bytes == 0)
+	{
+	  tcp_return_buffer (tm);
+	  tcp_retransmit_timer_set (tc);
+	  return;
+	}
+
+      tc->rtx_bytes += max_bytes;
     }
   else
     {
@@ -1079,58 +1194,125 @@ tcp_retransmit_first_unacked (tcp_connection_t * tc)
   tcp_main_t *tm = vnet_get_tcp_main ();
   u32 snd_nxt = tc->snd_nxt;
   vlib_buffer_t *b;
-  u32 bi;
-
-  tc->snd_nxt = tc->snd_una;
+  u32 bi, n_bytes;
 
   /* Get buffer */
   tcp_get_free_buffer_index (tm, &bi);
   b = vlib_get_buffer (tm->vlib_main, bi);
 
-  tcp_prepare_retransmit_segment (tc, b, tc->snd_mss);
-  tcp_enqueue_to_output (tm->vlib_main, b, bi, tc->c_is_ip4);
-
+  n_bytes = tcp_prepare_retransmit_segment (tc, b, 0, tc->snd_mss);
   tc->snd_nxt = snd_nxt;
-  tc->rtx_bytes += tc->snd_mss;
+  if (n_bytes == 0)
+    {
+      tcp_return_buffer (tm);
+      return;
+    }
+
+  tcp_enqueue_to_output (tm->vlib_main, b, bi, tc->c_is_ip4);
+  tc->rtx_bytes += n_bytes;
 }
 
+/**
+ * Fast retransmit, as much as the congestion window allows
+ *
+ * With SACK, only what RACK found lost and the peer has not sacked is
+ * resent. Otherwise, data is resent from snd_una on.
+ */
 void
 tcp_fast_retransmit (tcp_connection_t * tc)
 {
   tcp_main_t *tm = vnet_get_tcp_main ();
-  u32 snd_space, max_bytes, n_bytes, bi;
+  u32 snd_space, max_bytes, n_bytes, bi, seq = tc->snd_una;
+  u8 is_sack = tcp_opts_sack_permitted (&tc->opt) != 0;
   vlib_buffer_t *b;
 
   ASSERT (tcp_in_fastrecovery (tc));
 
-  clib_warning ("fast retransmit!");
-
-  /* Start resending from first un-acked segment */
-  tc->snd_nxt = tc->snd_una;
-
   snd_space = tcp_available_snd_space (tc);
 
   while (snd_space)
     {
+      max_bytes = clib_min (tc->snd_mss, snd_space);
+      if (is_sack && !(max_bytes = tcp_rack_next_lost (tc, max_bytes, &seq)))
+	break;
+
       tcp_get_free_buffer_index (tm, &bi);
       b = vlib_get_buffer (tm->vlib_main, bi);
 
-      max_bytes = clib_min (tc->snd_mss, snd_space);
-      n_bytes = tcp_prepare_retransmit_segment (tc, b, max_bytes);
+      n_bytes = tcp_prepare_retransmit_segment (tc, b, seq - tc->snd_una,
+						max_bytes);
 
       /* Nothing left to retransmit */
       if (n_bytes == 0)
-	return;
+	{
+	  tcp_return_buffer (tm);
+	  break;
+	}
 
       tcp_enqueue_to_output (tm->vlib_main, b, bi, tc->c_is_ip4);
 
+      tc->rtx_bytes += n_bytes;
       snd_space -= n_bytes;
+      seq += n_bytes;
     }
 
   /* If window allows, send new data */
   tc->snd_nxt = tc->snd_una_max;
 }
 
+/**
+ * Loss probe timer
+ *
+ * Either RACK's reordering window passed and more data may now be lost,
+ * or the tail of a flight got no ACK for two RTTs. In the latter case the
+ * last segment is resent, a tail loss probe, such that the SACK it
+ * elicits triggers recovery instead of waiting for the RTO.
+ */
+void
+tcp_timer_loss_probe_handler (u32 index)
+{
+  tcp_main_t *tm = vnet_get_tcp_main ();
+  u32 thread_index = os_get_cpu_number ();
+  u32 bi, n_bytes, offset, snd_nxt;
+  tcp_connection_t *tc;
+  vlib_buffer_t *b;
+
+  tc = tcp_connection_get (index, thread_index);
+  tc->timers[TCP_TIMER_LOSS_PROBE] = TCP_TIMER_HANDLE_INVALID;
+
+  if (tc->state < TCP_STATE_ESTABLISHED || tc->snd_una == tc->snd_una_max)
+    return;
+
+  if (tc->rack.reo_timeout)
+    {
+      tcp_rack_recover (tc);
+      tcp_rack_loss_probe_arm (tc);
+      return;
+    }
+
+  if (tc->state != TCP_STATE_ESTABLISHED || tcp_in_recovery (tc)
+      || tc->rack.probe_sent)
+    return;
+
+  tcp_get_free_buffer_index (tm, &bi);
+  b = vlib_get_buffer (tm->vlib_main, bi);
+
+  n_bytes = clib_min (tc->snd_mss, tc->snd_una_max - tc->snd_una);
+  offset = tc->snd_una_max - tc->snd_una - n_bytes;
+  snd_nxt = tc->snd_nxt;
+  n_bytes = tcp_prepare_retransmit_segment (tc, b, offset, n_bytes);
+  tc->snd_nxt = snd_nxt;
+  if (n_bytes == 0)
+    {
+      tcp_return_buffer (tm);
+      return;
+    }
+
+  tcp_enqueue_to_output (tm->vlib_main, b, bi, tc->c_is_ip4);
+  tc->rtx_bytes += n_bytes;
+  tc->rack.probe_sent = 1;
+}
+
 always_inline u32
 tcp_session_has_ooo_data (tcp_connection_t * tc)
 {
@@ -1191,7 +1373,8 @@ tcp46_output_inline (vlib_main_t * vm,
 	      ip4_header_t *ih0;
 	      ih0 = vlib_buffer_push_ip4 (vm, b0, &tc0->c_lcl_ip4,
 					  &tc0->c_rmt_ip4, IP_PROTOCOL_TCP);
-	      th0->checksum = ip4_tcp_udp_compute_checksum (vm, b0, ih0);
+	      if (PREDICT_TRUE (!(b0->flags & VNET_BUFFER_GSO)))
+		th0->checksum = ip4_tcp_udp_compute_checksum (vm, b0, ih0);
 	    }
 	  else
 	    {
@@ -1200,9 +1383,20 @@ tcp46_output_inline (vlib_main_t * vm,
 
 	      ih0 = vlib_buffer_push_ip6 (vm, b0, &tc0->c_lcl_ip6,
 					  &tc0->c_rmt_ip6, IP_PROTOCOL_TCP);
-	      th0->checksum = ip6_tcp_udp_icmp_compute_checksum (vm, b0, ih0,
-								 &bogus);
-	      ASSERT (!bogus);
+	      if (PREDICT_TRUE (!(b0->flags & VNET_BUFFER_GSO)))
+		{
+		  th0->checksum =
+		    ip6_tcp_udp_icmp_compute_checksum (vm, b0, ih0, &bogus);
+		  ASSERT (!bogus);
+		}
+	    }
+
+	  /* Super-segments are checksummed per segment, by gso or by the
+	   * device */
+	  if (PREDICT_FALSE (b0->flags & VNET_BUFFER_GSO))
+	    {
+	      vnet_buffer2 (b0)->gso.l3_hdr_offset = b0->current_data;
+	      th0->checksum = 0;
 	    }
 
 	  /* Filter out DUPACKs if there are no OOO segments left */
@@ -1239,6 +1433,7 @@ tcp46_output_inline (vlib_main_t * vm,
 	      if (tc0->rtt_ts == 0)
 		{
 		  tc0->rtt_ts = tcp_time_now ();
+		  tc0->rtt_clocks = clib_cpu_time_now ();
 		  tc0->rtt_seq = tc0->snd_nxt;
 		}
 	    }
@@ -1251,6 +1446,9 @@ tcp46_output_inline (vlib_main_t * vm,
 	      tcp_retransmit_timer_set (tc0);
 	      tc0->rto_boff = 0;
 	    }
+	  if (!tcp_timer_is_active (tc0, TCP_TIMER_LOSS_PROBE)
+	      && tc0->snd_nxt != tc0->snd_una)
+	    tcp_rack_loss_probe_arm (tc0);
 
 	  /* set fib index to default and lookup node */
 	  /* XXX network virtualization (vrf/vni) */
@@ -1338,6 +1536,8 @@ tcp_push_header (transport_connection_t * tconn, vlib_buffer_t * b)
   tcp_connection_t *tc;
 
   tc = (tcp_connection_t *) tconn;
+  tcp_pacer_consume (tc, vlib_buffer_length_in_chain (vlib_get_main (),
+						      b));
   tcp_push_hdr_i (tc, b, TCP_STATE_ESTABLISHED);
   return 0;
 }
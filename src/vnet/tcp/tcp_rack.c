@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Retransmit queue and RACK loss detection, see tcp_rack_t.
+ *
+ * Segments in the queue are the data as sent, merged or split as
+ * retransmissions cover them. What the peer actually has is in the SACK
+ * scoreboard, segments only cache whether they're fully sacked.
+ */
+
+#include <vnet/tcp/tcp.h>
+
+/**
+ * Index of the first segment that ends after seq, vec_len if none
+ */
+static u32
+tcp_rack_seg_index (tcp_rack_t * rack, u32 seq)
+{
+  tcp_tx_segment_t *segs = rack->segs;
+  u32 lo = rack->head, hi = vec_len (segs), mid;
+
+  while (lo < hi)
+    {
+      mid = lo + ((hi - lo) >> 1);
+      if (seq_leq (segs[mid].end, seq))
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  return lo;
+}
+
+/**
+ * Split a segment in two at seq, which must be inside it
+ */
+static void
+tcp_rack_seg_split (tcp_rack_t * rack, u32 index, u32 seq)
+{
+  tcp_tx_segment_t seg = rack->segs[index];
+
+  seg.start = seq;
+  rack->segs[index].end = seq;
+  vec_insert_elts (rack->segs, &seg, 1, index + 1);
+}
+
+always_inline int
+tcp_rack_sent_after (u64 t1, u32 seq1, u64 t2, u32 seq2)
+{
+  return t1 > t2 || (t1 == t2 && seq_gt (seq1, seq2));
+}
+
+static void
+tcp_rack_add_rxt (tcp_rack_t * rack, tcp_tx_segment_t * seg)
+{
+  tcp_rack_rxt_t *rxt;
+
+  vec_add2 (rack->rxts, rxt, 1);
+  rxt->xmit_time = seg->xmit_time;
+  rxt->start = seg->start;
+  rxt->end = seg->end;
+}
+
+/**
+ * Record data sent
+ *
+ * New data is appended to the retransmit queue. Retransmitted data
+ * replaces the segments it covers with one segment that has the new send
+ * time.
+ */
+void
+tcp_rack_segment_sent (tcp_connection_t * tc, u32 start, u32 end)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg, new_seg;
+  u32 first, last, rxt_end;
+
+  new_seg.xmit_time = clib_cpu_time_now ();
+  new_seg.start = start;
+  new_seg.end = end;
+  new_seg.flags = 0;
+
+  if (tcp_rack_n_segs (rack) && seq_lt (start, vec_end (rack->segs)[-1].end))
+    {
+      seg = vec_elt_at_index (rack->segs, rack->head);
+      if (seq_lt (start, seg->start))
+	start = new_seg.start = seg->start;
+
+      rxt_end = vec_end (rack->segs)[-1].end;
+      if (seq_lt (end, rxt_end))
+	rxt_end = end;
+
+      first = tcp_rack_seg_index (rack, start);
+      if (seq_gt (start, rack->segs[first].start))
+	tcp_rack_seg_split (rack, first++, start);
+      last = tcp_rack_seg_index (rack, rxt_end - 1);
+      if (seq_lt (rxt_end, rack->segs[last].end))
+	tcp_rack_seg_split (rack, last, rxt_end);
+
+      new_seg.end = rxt_end;
+      new_seg.flags = TCP_TX_SEG_F_RETRANSMITTED;
+      rack->segs[first] = new_seg;
+      if (last > first)
+	vec_delete (rack->segs, last - first, first + 1);
+      tcp_rack_add_rxt (rack, &new_seg);
+
+      if (seq_geq (rxt_end, end))
+	return;
+      new_seg.start = rxt_end;
+      new_seg.end = end;
+    }
+
+  if (!tcp_rack_n_segs (rack))
+    rack->scan_seq = rack->rxt_next = new_seg.start;
+
+  /* After an RTO data below snd_una_max is resent as if new */
+  if (seq_lt (new_seg.start, tc->snd_una_max))
+    {
+      new_seg.flags = TCP_TX_SEG_F_RETRANSMITTED;
+      tcp_rack_add_rxt (rack, &new_seg);
+    }
+  else
+    new_seg.flags = 0;
+
+  vec_add1 (rack->segs, new_seg);
+}
+
+/**
+ * Update the most recently sent delivered data, RFC8985 Sec. 6.2 step 2
+ */
+static void
+tcp_rack_update (tcp_rack_t * rack, tcp_tx_segment_t * seg, u32 end_seq,
+		 u64 now)
+{
+  u64 rtt = now - seg->xmit_time;
+
+  if (seg->flags & TCP_TX_SEG_F_RETRANSMITTED)
+    {
+      /* Too fast, the original transmission was delivered */
+      if (rtt < rack->min_rtt)
+	return;
+    }
+  else if (rack->min_rtt == 0 || rtt < rack->min_rtt)
+    rack->min_rtt = rtt;
+
+  if (tcp_rack_sent_after (seg->xmit_time, end_seq, rack->xmit_time,
+			   rack->end_seq))
+    {
+      rack->rtt = rtt;
+      rack->xmit_time = seg->xmit_time;
+      rack->end_seq = end_seq;
+    }
+}
+
+always_inline int
+tcp_rack_seg_is_sacked (tcp_connection_t * tc, tcp_tx_segment_t * seg)
+{
+  u32 run_end;
+  return scoreboard_next_unsacked (&tc->sack_sb, seg->start, seg->end,
+				   &run_end) == seg->end;
+}
+
+/**
+ * Account for newly sacked data
+ *
+ * @param start start of the newly sacked bytes
+ * @param end end of the newly sacked bytes. Bytes in between may have
+ *        been sacked before
+ */
+void
+tcp_rack_rcv_sacked (tcp_connection_t * tc, u32 start, u32 end)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg;
+  u64 now;
+  u32 i;
+
+  if (!tcp_rack_n_segs (rack))
+    return;
+
+  now = clib_cpu_time_now ();
+  rack->probe_sent = 0;
+
+  for (i = tcp_rack_seg_index (rack, start); i < vec_len (rack->segs); i++)
+    {
+      seg = vec_elt_at_index (rack->segs, i);
+      if (seq_geq (seg->start, end))
+	break;
+      if (seg->flags & TCP_TX_SEG_F_SACKED)
+	continue;
+
+      tcp_rack_update (rack, seg, seq_lt (seg->end, end) ? seg->end : end,
+		       now);
+
+      /* Segments at the edges may be only partly sacked */
+      if ((seq_geq (seg->start, start) && seq_leq (seg->end, end))
+	  || tcp_rack_seg_is_sacked (tc, seg))
+	seg->flags = (seg->flags & ~TCP_TX_SEG_F_LOST) | TCP_TX_SEG_F_SACKED;
+    }
+}
+
+/**
+ * Account for a cumulative ack and drop the acked segments
+ *
+ * Must be called before snd_una is updated.
+ */
+void
+tcp_rack_rcv_ack (tcp_connection_t * tc, u32 ack)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg;
+  u64 now;
+
+  if (seq_leq (ack, tc->snd_una))
+    return;
+
+  rack->probe_sent = 0;
+  if (seq_lt (rack->scan_seq, ack))
+    rack->scan_seq = ack;
+  if (seq_lt (rack->rxt_next, ack))
+    rack->rxt_next = ack;
+
+  if (!tcp_rack_n_segs (rack))
+    return;
+
+  now = clib_cpu_time_now ();
+  while (rack->head < vec_len (rack->segs))
+    {
+      seg = vec_elt_at_index (rack->segs, rack->head);
+      if (seq_leq (ack, seg->start))
+	break;
+
+      if (!(seg->flags & TCP_TX_SEG_F_SACKED))
+	tcp_rack_update (rack, seg, seq_lt (ack, seg->end) ? ack : seg->end,
+			 now);
+
+      if (seq_lt (ack, seg->end))
+	{
+	  seg->start = ack;
+	  break;
+	}
+      rack->head++;
+    }
+
+  /* Reclaim the space of acked segments once they are the majority */
+  if (rack->head > vec_len (rack->segs) >> 1)
+    {
+      vec_delete (rack->segs, rack->head, 0);
+      rack->head = 0;
+    }
+}
+
+static u32
+tcp_rack_seg_mark_lost (tcp_connection_t * tc, tcp_tx_segment_t * seg)
+{
+  tcp_rack_t *rack = &tc->rack;
+
+  if (tcp_rack_seg_is_sacked (tc, seg))
+    {
+      seg->flags |= TCP_TX_SEG_F_SACKED;
+      return 0;
+    }
+
+  seg->flags |= TCP_TX_SEG_F_LOST;
+  if (seq_lt (seg->start, rack->rxt_next))
+    rack->rxt_next = seg->start;
+  return 1;
+}
+
+/**
+ * Mark lost what is left of a retransmission in the retransmit queue
+ */
+static u32
+tcp_rack_rxt_mark_lost (tcp_connection_t * tc, tcp_rack_rxt_t * rxt)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg;
+  u32 i, n_lost = 0;
+
+  for (i = tcp_rack_seg_index (rack, rxt->start); i < vec_len (rack->segs);
+       i++)
+    {
+      seg = vec_elt_at_index (rack->segs, i);
+      if (seq_geq (seg->start, rxt->end))
+	break;
+
+      /* Acked, sacked, resent or already lost */
+      if (seg->xmit_time != rxt->xmit_time
+	  || (seg->flags & (TCP_TX_SEG_F_SACKED | TCP_TX_SEG_F_LOST)))
+	continue;
+
+      n_lost += tcp_rack_seg_mark_lost (tc, seg);
+    }
+
+  return n_lost;
+}
+
+/**
+ * RACK loss detection, RFC8985 Sec. 6.2 step 5
+ *
+ * Sets reo_timeout if data is not lost yet only because its reordering
+ * window has not passed.
+ *
+ * @return number of segments newly marked lost
+ */
+u32
+tcp_rack_detect_loss (tcp_connection_t * tc)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg;
+  tcp_rack_rxt_t *rxt;
+  u64 now, wait, deadline;
+  u32 i, n_lost = 0;
+
+  rack->reo_timeout = 0;
+  if (!rack->xmit_time || !tcp_rack_n_segs (rack))
+    return 0;
+
+  now = clib_cpu_time_now ();
+  wait = rack->rtt + (rack->min_rtt >> 2);
+
+  /* Retransmissions, oldest first */
+  while (rack->rxt_head < vec_len (rack->rxts))
+    {
+      rxt = vec_elt_at_index (rack->rxts, rack->rxt_head);
+      if (!tcp_rack_sent_after (rack->xmit_time, rack->end_seq,
+				rxt->xmit_time, rxt->start))
+	break;
+
+      deadline = rxt->xmit_time + wait;
+      if (deadline > now)
+	{
+	  rack->reo_timeout = deadline;
+	  break;
+	}
+
+      n_lost += tcp_rack_rxt_mark_lost (tc, rxt);
+      rack->rxt_head++;
+    }
+
+  if (rack->rxt_head == vec_len (rack->rxts))
+    {
+      vec_reset_length (rack->rxts);
+      rack->rxt_head = 0;
+    }
+  else if (rack->rxt_head > vec_len (rack->rxts) >> 1)
+    {
+      vec_delete (rack->rxts, rack->rxt_head, 0);
+      rack->rxt_head = 0;
+    }
+
+  /* Original transmissions, in sequence order */
+  for (i = tcp_rack_seg_index (rack, rack->scan_seq); i < vec_len (rack->segs);
+       i++)
+    {
+      seg = vec_elt_at_index (rack->segs, i);
+      if (!(seg->flags & (TCP_TX_SEG_F_RETRANSMITTED | TCP_TX_SEG_F_SACKED
+			  | TCP_TX_SEG_F_LOST)))
+	{
+	  if (!tcp_rack_sent_after (rack->xmit_time, rack->end_seq,
+				    seg->xmit_time, seg->start))
+	    break;
+
+	  deadline = seg->xmit_time + wait;
+	  if (deadline > now)
+	    {
+	      if (!rack->reo_timeout || deadline < rack->reo_timeout)
+		rack->reo_timeout = deadline;
+	      break;
+	    }
+
+	  n_lost += tcp_rack_seg_mark_lost (tc, seg);
+	}
+      rack->scan_seq = seg->end;
+    }
+
+  return n_lost;
+}
+
+/**
+ * Mark the first unacked segment lost, as dupack counting found it
+ */
+void
+tcp_rack_mark_first_lost (tcp_connection_t * tc)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg;
+
+  if (!tcp_rack_n_segs (rack))
+    return;
+
+  seg = vec_elt_at_index (rack->segs, rack->head);
+  if (!(seg->flags & (TCP_TX_SEG_F_SACKED | TCP_TX_SEG_F_LOST)))
+    tcp_rack_seg_mark_lost (tc, seg);
+}
+
+/**
+ * Find the next lost data to retransmit
+ *
+ * Skips bytes the peer has sacked.
+ *
+ * @param seq set to the first sequence number to retransmit
+ * @return number of bytes to retransmit, at most max_bytes, 0 if none
+ */
+u32
+tcp_rack_next_lost (tcp_connection_t * tc, u32 max_bytes, u32 * seq)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg;
+  u32 i, start, run_end;
+
+  for (i = tcp_rack_seg_index (rack, rack->rxt_next); i < vec_len (rack->segs);
+       i++)
+    {
+      seg = vec_elt_at_index (rack->segs, i);
+      if (!(seg->flags & TCP_TX_SEG_F_LOST))
+	{
+	  rack->rxt_next = seg->end;
+	  continue;
+	}
+
+      start = seq_gt (rack->rxt_next, seg->start) ? rack->rxt_next
+	: seg->start;
+      start = scoreboard_next_unsacked (&tc->sack_sb, start, seg->end,
+					&run_end);
+      if (start == seg->end)
+	{
+	  seg->flags &= ~TCP_TX_SEG_F_LOST;
+	  rack->rxt_next = seg->end;
+	  continue;
+	}
+
+      *seq = start;
+      max_bytes = clib_min (max_bytes, run_end - start);
+      rack->rxt_next = start + max_bytes;
+      return max_bytes;
+    }
+
+  return 0;
+}
+
+/**
+ * Forget all sent data, e.g., on RTO, when everything is resent
+ */
+void
+tcp_rack_clear (tcp_connection_t * tc)
+{
+  tcp_rack_t *rack = &tc->rack;
+
+  vec_reset_length (rack->segs);
+  vec_reset_length (rack->rxts);
+  rack->head = rack->rxt_head = 0;
+  rack->scan_seq = rack->rxt_next = tc->snd_una;
+  rack->xmit_time = rack->reo_timeout = 0;
+  rack->probe_sent = 0;
+}
+
+void
+tcp_rack_free (tcp_connection_t * tc)
+{
+  vec_free (tc->rack.segs);
+  vec_free (tc->rack.rxts);
+}
+
+/**
+ * Arm the loss probe timer
+ *
+ * If RACK waits for data's reordering window to pass, the timer fires
+ * when it does. Otherwise it fires after two RTTs, unless the RTO is
+ * sooner, to send a tail loss probe.
+ */
+void
+tcp_rack_loss_probe_arm (tcp_connection_t * tc)
+{
+  tcp_rack_t *rack = &tc->rack;
+  u64 now;
+  u32 pto;
+
+  if (!tcp_opts_sack_permitted (&tc->opt))
+    return;
+
+  if (rack->reo_timeout)
+    {
+      now = clib_cpu_time_now ();
+      pto = rack->reo_timeout > now ?
+	(rack->reo_timeout - now) * tcp_main.tstamp_ticks_per_clock : 0;
+      pto = clib_max (pto * TCP_TO_TIMER_TICK, 1);
+    }
+  else
+    {
+      /* One probe per tail, none in recovery or before an RTT sample */
+      pto = clib_max (2 * tc->srtt * TCP_TO_TIMER_TICK, 1);
+      if (rack->probe_sent || tcp_in_recovery (tc) || !tc->srtt
+	  || pto >= clib_max (tc->rto * TCP_TO_TIMER_TICK, 1))
+	{
+	  tcp_timer_reset (tc, TCP_TIMER_LOSS_PROBE);
+	  return;
+	}
+    }
+
+  tcp_timer_update (tc, TCP_TIMER_LOSS_PROBE, pto);
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vnet/tcp/tcp.h>
+
+#define TCP_TEST_I(_cond, _comment, _args...)			\
+({								\
+  int _evald = (_cond);						\
+  if (!(_evald)) {						\
+    fformat(stderr, "FAIL:%d: " _comment "\n",			\
+	    __LINE__, ##_args);					\
+  } else {							\
+    fformat(stderr, "PASS:%d: " _comment "\n",			\
+	    __LINE__, ##_args);					\
+  }								\
+  _evald;							\
+})
+
+#define TCP_TEST(_cond, _comment, _args...)			\
+{								\
+  if (!TCP_TEST_I(_cond, _comment, ##_args)) {			\
+    return 1;							\
+  }								\
+}
+
+static void
+tcp_test_conn_init (tcp_connection_t * tc, u32 snd_una_max)
+{
+  memset (tc, 0, sizeof (*tc));
+  tc->opt.flags = TCP_OPTS_FLAG_SACK_PERMITTED;
+  tc->snd_una_max = tc->snd_nxt = snd_una_max;
+  tc->snd_mss = 100;
+}
+
+static void
+tcp_test_conn_free (tcp_connection_t * tc)
+{
+  vec_free (tc->opt.sacks);
+  vec_free (tc->sack_sb.holes);
+  tcp_rack_free (tc);
+}
+
+/** Receive an ACK with up to two SACK blocks, empty if start == end */
+static void
+tcp_test_rcv_ack (tcp_connection_t * tc, u32 ack, u32 start0, u32 end0,
+		  u32 start1, u32 end1)
+{
+  sack_block_t *blk;
+
+  vec_reset_length (tc->opt.sacks);
+  tc->opt.flags &= ~TCP_OPTS_FLAG_SACK;
+  if (start0 != end0)
+    {
+      vec_add2 (tc->opt.sacks, blk, 1);
+      blk->start = start0;
+      blk->end = end0;
+    }
+  if (start1 != end1)
+    {
+      vec_add2 (tc->opt.sacks, blk, 1);
+      blk->start = start1;
+      blk->end = end1;
+    }
+  if (vec_len (tc->opt.sacks))
+    tc->opt.flags |= TCP_OPTS_FLAG_SACK;
+
+  tcp_rcv_sacks (tc, ack);
+  tcp_rack_rcv_ack (tc, ack);
+  tc->snd_una = ack;
+}
+
+static int
+tcp_test_hole (sack_scoreboard_t * sb, u32 index, u32 start, u32 end)
+{
+  sack_scoreboard_hole_t *hole;
+
+  if (index >= scoreboard_n_holes (sb))
+    return 0;
+  hole = vec_elt_at_index (sb->holes, sb->head + index);
+  return hole->start == start && hole->end == end;
+}
+
+static int
+tcp_test_sack (vlib_main_t * vm, unformat_input_t * input)
+{
+  tcp_connection_t _tc, *tc = &_tc;
+  sack_scoreboard_t *sb = &tc->sack_sb;
+  sack_scoreboard_hole_t *hole;
+  u32 i, n_segs = 10000, run_end;
+
+  tcp_test_conn_init (tc, 1000);
+
+  /* Out of order blocks, each leaves a hole before it */
+  tcp_test_rcv_ack (tc, 0, 500, 600, 100, 200);
+  tcp_test_rcv_ack (tc, 0, 300, 400, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == 3, "3 holes: %u",
+	    scoreboard_n_holes (sb));
+  TCP_TEST (tcp_test_hole (sb, 0, 0, 100) && tcp_test_hole (sb, 1, 200, 300)
+	    && tcp_test_hole (sb, 2, 400, 500), "holes are sorted");
+  TCP_TEST (sb->sacked_bytes == 300 && sb->high_sacked == 600,
+	    "sacked %u high %u", sb->sacked_bytes, sb->high_sacked);
+
+  /* Block that fills a hole and one that splits another */
+  tcp_test_rcv_ack (tc, 0, 200, 300, 420, 460);
+  TCP_TEST (scoreboard_n_holes (sb) == 3, "3 holes: %u",
+	    scoreboard_n_holes (sb));
+  TCP_TEST (tcp_test_hole (sb, 0, 0, 100) && tcp_test_hole (sb, 1, 400, 420)
+	    && tcp_test_hole (sb, 2, 460, 500), "hole filled and split");
+  TCP_TEST (sb->sacked_bytes == 440, "sacked %u", sb->sacked_bytes);
+
+  /* Repeated blocks change nothing */
+  tcp_test_rcv_ack (tc, 0, 100, 400, 500, 600);
+  TCP_TEST (scoreboard_n_holes (sb) == 3 && sb->sacked_bytes == 440,
+	    "duplicate blocks ignored");
+
+  /* Block across several holes */
+  tcp_test_rcv_ack (tc, 0, 50, 480, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == 2 && tcp_test_hole (sb, 0, 0, 50)
+	    && tcp_test_hole (sb, 1, 480, 500), "holes covered");
+  TCP_TEST (sb->sacked_bytes == 530, "sacked %u", sb->sacked_bytes);
+
+  /* Lookups */
+  hole = scoreboard_lookup_hole (sb, 50);
+  TCP_TEST (hole && hole->start == 480, "lookup 50 finds hole at 480");
+  TCP_TEST (scoreboard_lookup_hole (sb, 500) == 0, "no hole after 500");
+  TCP_TEST (scoreboard_next_unsacked (sb, 60, 490, &run_end) == 480
+	    && run_end == 490, "unsacked from 60 is [480, 490)");
+  TCP_TEST (scoreboard_next_unsacked (sb, 60, 470, &run_end) == 470,
+	    "[60, 470) is sacked");
+  TCP_TEST (scoreboard_next_unsacked (sb, 550, 700, &run_end) == 600
+	    && run_end == 700, "unsacked above high sacked");
+
+  /* Cumulative ack into a hole and then past everything sacked */
+  tcp_test_rcv_ack (tc, 490, 0, 0, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == 1 && tcp_test_hole (sb, 0, 490, 500)
+	    && sb->sacked_bytes == 100, "ack 490 leaves hole [490, 500)");
+  tcp_test_rcv_ack (tc, 600, 700, 800, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == 1 && tcp_test_hole (sb, 0, 600, 700)
+	    && sb->sacked_bytes == 100, "ack 600 and new block");
+  tcp_test_rcv_ack (tc, 800, 0, 0, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == 0 && sb->sacked_bytes == 0,
+	    "ack 800 empties scoreboard");
+
+  /* Invalid blocks: below ack, inverted, past snd_una_max */
+  tcp_test_rcv_ack (tc, 800, 700, 900, 950, 900);
+  tcp_test_rcv_ack (tc, 800, 900, 1100, 0, 0);
+  TCP_TEST (sb->sacked_bytes == 0, "invalid blocks ignored");
+
+  /* Many holes, every other segment lost. Once the scoreboard is full
+   * blocks that would add a hole are ignored */
+  tcp_test_conn_init (tc, n_segs * 100);
+  for (i = 1; i < n_segs; i += 2)
+    tcp_test_rcv_ack (tc, 0, i * 100, i * 100 + 100, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == TCP_MAX_SACK_HOLES, "%u holes",
+	    scoreboard_n_holes (sb));
+  TCP_TEST (sb->sacked_bytes == TCP_MAX_SACK_HOLES * 100
+	    && sb->high_sacked == TCP_MAX_SACK_HOLES * 200,
+	    "sacked %u high %u", sb->sacked_bytes, sb->high_sacked);
+  tcp_test_rcv_ack (tc, 0, 10050, 10060, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == TCP_MAX_SACK_HOLES
+	    && tcp_test_hole (sb, 50, 10000, 10100), "full, split ignored");
+
+  /* Filling a hole makes room for a new one */
+  tcp_test_rcv_ack (tc, 0, 10000, 10100, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == TCP_MAX_SACK_HOLES - 1,
+	    "hole filled: %u holes", scoreboard_n_holes (sb));
+  tcp_test_rcv_ack (tc, 0, TCP_MAX_SACK_HOLES * 200 + 100,
+		    TCP_MAX_SACK_HOLES * 200 + 200, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == TCP_MAX_SACK_HOLES
+	    && sb->high_sacked == TCP_MAX_SACK_HOLES * 200 + 200,
+	    "new hole above high sacked");
+
+  /* Ack half of the holes */
+  tcp_test_rcv_ack (tc, TCP_MAX_SACK_HOLES * 100, 0, 0, 0, 0);
+  TCP_TEST (scoreboard_n_holes (sb) == TCP_MAX_SACK_HOLES / 2 + 1
+	    && sb->sacked_bytes == (TCP_MAX_SACK_HOLES / 2) * 100 + 100,
+	    "ack half: %u holes, %u sacked", scoreboard_n_holes (sb),
+	    sb->sacked_bytes);
+  hole = scoreboard_first_hole (sb);
+  TCP_TEST (hole->start == TCP_MAX_SACK_HOLES * 100, "first hole at snd_una");
+
+  tcp_test_conn_free (tc);
+  return 0;
+}
+
+/** Pretend everything was sent, and acked, clocks ago */
+static void
+tcp_test_rack_age (tcp_connection_t * tc, u64 clocks)
+{
+  tcp_rack_t *rack = &tc->rack;
+  tcp_tx_segment_t *seg;
+  tcp_rack_rxt_t *rxt;
+
+  vec_foreach (seg, rack->segs) seg->xmit_time -= clocks;
+  vec_foreach (rxt, rack->rxts) rxt->xmit_time -= clocks;
+  if (rack->xmit_time)
+    rack->xmit_time -= clocks;
+}
+
+static void
+tcp_test_send (tcp_connection_t * tc, u32 start, u32 end)
+{
+  tcp_rack_segment_sent (tc, start, end);
+  if (seq_gt (end, tc->snd_una_max))
+    tc->snd_una_max = tc->snd_nxt = end;
+}
+
+static int
+tcp_test_rack (vlib_main_t * vm, unformat_input_t * input)
+{
+  tcp_connection_t _tc, *tc = &_tc;
+  tcp_rack_t *rack = &tc->rack;
+  u64 rtt = 1e6;
+  u32 i, seq = 0, n_bytes;
+
+  /* Ten segments sent back to back, the third is delivered first */
+  tcp_test_conn_init (tc, 0);
+  for (i = 0; i < 10; i++)
+    {
+      tcp_test_send (tc, i * 100, i * 100 + 100);
+      tcp_test_rack_age (tc, 1000);
+    }
+  TCP_TEST (tcp_rack_n_segs (rack) == 10, "10 segments queued");
+  tcp_test_rack_age (tc, rtt);
+  tcp_test_rcv_ack (tc, 0, 200, 300, 0, 0);
+  TCP_TEST (rack->end_seq == 300 && rack->rtt >= rtt,
+	    "rack tracks segment 2");
+
+  /* Reordering, not loss, until an RTT and reordering window pass */
+  TCP_TEST (tcp_rack_detect_loss (tc) == 0 && rack->reo_timeout,
+	    "reordering, no loss yet");
+  TCP_TEST (tcp_rack_next_lost (tc, 1000, &seq) == 0, "nothing to resend");
+  tcp_test_rack_age (tc, 100 * rtt);
+  TCP_TEST (tcp_rack_detect_loss (tc) == 2, "segments 0 and 1 lost");
+  TCP_TEST (tcp_rack_detect_loss (tc) == 0, "no new loss");
+
+  /* Lost data is resent in pieces no larger than asked for */
+  n_bytes = tcp_rack_next_lost (tc, 60, &seq);
+  TCP_TEST (seq == 0 && n_bytes == 60, "resend [%u, %u)", seq,
+	    seq + n_bytes);
+  tcp_test_send (tc, seq, seq + n_bytes);
+  n_bytes = tcp_rack_next_lost (tc, 1000, &seq);
+  TCP_TEST (seq == 60 && n_bytes == 40, "resend [%u, %u)", seq,
+	    seq + n_bytes);
+  tcp_test_send (tc, seq, seq + n_bytes);
+  n_bytes = tcp_rack_next_lost (tc, 1000, &seq);
+  TCP_TEST (seq == 100 && n_bytes == 100, "resend [%u, %u)", seq,
+	    seq + n_bytes);
+  tcp_test_send (tc, seq, seq + n_bytes);
+  TCP_TEST (tcp_rack_next_lost (tc, 1000, &seq) == 0, "all lost resent");
+  TCP_TEST (tcp_rack_n_segs (rack) == 11, "retransmissions split segment");
+
+  /* Segments sent before the retransmissions are delivered. Those can't
+   * tell whether the retransmissions were lost */
+  tcp_test_rcv_ack (tc, 0, 200, 500, 0, 0);
+  tcp_test_rack_age (tc, 100 * rtt);
+  TCP_TEST (tcp_rack_detect_loss (tc) == 0, "no spurious retransmission");
+
+  /* Data sent after the retransmissions is, the last one was lost */
+  tcp_test_rcv_ack (tc, 100, 200, 1000, 0, 0);
+  tcp_test_send (tc, 1000, 1100);
+  tcp_test_rcv_ack (tc, 100, 1000, 1100, 0, 0);
+  tcp_test_rack_age (tc, 100 * rtt);
+  TCP_TEST (tcp_rack_detect_loss (tc) == 1, "lost retransmission found");
+  n_bytes = tcp_rack_next_lost (tc, 1000, &seq);
+  TCP_TEST (seq == 100 && n_bytes == 100, "resend [%u, %u)", seq,
+	    seq + n_bytes);
+
+  /* Cumulative ack drops segments */
+  tcp_test_rcv_ack (tc, 550, 1000, 1100, 0, 0);
+  TCP_TEST (rack->segs[rack->head].start == 550, "queue starts at snd_una");
+  tcp_test_rcv_ack (tc, 1100, 0, 0, 0, 0);
+  TCP_TEST (tcp_rack_n_segs (rack) == 0, "queue empty");
+
+  /* Super-segment partly sacked, what's left before the sacked part is
+   * lost */
+  tcp_test_conn_free (tc);
+  tcp_test_conn_init (tc, 0);
+  tcp_test_send (tc, 0, 3000);
+  tcp_test_rack_age (tc, rtt);
+  tcp_test_rcv_ack (tc, 0, 1000, 2000, 0, 0);
+  tcp_test_rack_age (tc, 100 * rtt);
+  TCP_TEST (tcp_rack_detect_loss (tc) == 1, "super-segment lost");
+  n_bytes = tcp_rack_next_lost (tc, 1500, &seq);
+  TCP_TEST (seq == 0 && n_bytes == 1000, "resend [%u, %u), sacked skipped",
+	    seq, seq + n_bytes);
+
+  tcp_test_conn_free (tc);
+  return 0;
+}
+
+static clib_error_t *
+tcp_test (vlib_main_t * vm, unformat_input_t * input,
+	  vlib_cli_command_t * cmd_arg)
+{
+  int res = 0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "sack"))
+	res += tcp_test_sack (vm, input);
+      else if (unformat (input, "rack"))
+	res += tcp_test_rack (vm, input);
+      else if (unformat (input, "all"))
+	{
+	  res += tcp_test_sack (vm, input);
+	  res += tcp_test_rack (vm, input);
+	}
+      else
+	break;
+    }
+
+  if (res)
+    return clib_error_return (0, "TCP unit test failed");
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (tcp_test_command, static) =
+{
+  .path = "test tcp",
+  .short_help = "test tcp [sack | rack | all]",
+  .function = tcp_test,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
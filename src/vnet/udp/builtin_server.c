@@ -24,9 +24,21 @@
 /** per-worker built-in server copy buffers */
 u8 **copy_buffers;
 
+/** accept sessions only on "builtin uri accept", like an API app would */
+u8 defer_accept;
+
+/** per-worker sessions waiting to be accepted */
+u32 **pending_sessions;
+
 static int
 builtin_session_create_callback (stream_session_t * s)
 {
+  if (defer_accept)
+    {
+      vec_add1 (pending_sessions[s->thread_index], s->session_index);
+      return 0;
+    }
+
   /* Simple version: declare session ready-to-go... */
   s->session_state = SESSION_STATE_READY;
   return 0;
@@ -38,40 +50,44 @@ builtin_session_disconnect_callback (stream_session_t * s)
   stream_session_disconnect (s);
 }
 
+/**
+ * Echo each datagram back to its sender. Records are moved whole, a
+ * datagram that doesn't fit the tx fifo is dropped.
+ */
 static int
 builtin_server_rx_callback (stream_session_t * s, session_fifo_event_t * ep)
 {
   svm_fifo_t *rx_fifo, *tx_fifo;
-  u32 this_transfer;
-  int actual_transfer;
+  transport_dgram_hdr_t hdr;
+  u32 n_echoed = 0;
+  int len;
   u8 *my_copy_buffer;
   session_fifo_event_t evt;
   unix_shared_memory_queue_t *q;
 
   my_copy_buffer = copy_buffers[s->thread_index];
+  vec_validate (my_copy_buffer, SESSION_DGRAM_MAX_BYTES - 1);
   rx_fifo = s->server_rx_fifo;
   tx_fifo = s->server_tx_fifo;
 
-  this_transfer = svm_fifo_max_enqueue (tx_fifo)
-    < svm_fifo_max_dequeue (rx_fifo) ?
-    svm_fifo_max_enqueue (tx_fifo) : svm_fifo_max_dequeue (rx_fifo);
-
-  vec_validate (my_copy_buffer, this_transfer - 1);
-  _vec_len (my_copy_buffer) = this_transfer;
-
-  actual_transfer = svm_fifo_dequeue_nowait (rx_fifo, 0, this_transfer,
-					     my_copy_buffer);
-  ASSERT (actual_transfer == this_transfer);
-  actual_transfer = svm_fifo_enqueue_nowait (tx_fifo, 0, this_transfer,
-					     my_copy_buffer);
+  while ((len = app_recv_dgram_raw (rx_fifo, &hdr, my_copy_buffer,
+				    vec_len (my_copy_buffer))) >= 0)
+    {
+      /* Reply from the address the datagram was sent to */
+      if (app_send_dgram_raw (tx_fifo, &hdr, my_copy_buffer, len) >= 0)
+	n_echoed += sizeof (hdr) + len;
+    }
 
   copy_buffers[s->thread_index] = my_copy_buffer;
 
+  if (n_echoed == 0)
+    return 0;
+
   /* Fabricate TX event, send to ourselves */
   evt.fifo = tx_fifo;
   evt.event_type = FIFO_EVENT_SERVER_TX;
   /* $$$$ for event logging */
-  evt.enqueue_length = actual_transfer;
+  evt.enqueue_length = n_echoed;
   evt.event_id = 0;
   q = session_manager_get_vpp_event_queue (s->thread_index);
   unix_shared_memory_queue_add (q, (u8 *) & evt, 0 /* do wait for mutex */ );
@@ -135,6 +151,7 @@ builtin_server_init (vlib_main_t * vm)
   num_threads = 1 /* main thread */  + vtm->n_threads;
 
   vec_validate (copy_buffers, num_threads - 1);
+  vec_validate (pending_sessions, num_threads - 1);
   return 0;
 }
 
@@ -148,10 +165,13 @@ builtin_uri_bind_command_fn (vlib_main_t * vm,
   u8 *uri = 0;
   int rv;
 
+  defer_accept = 0;
   while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
     {
       if (unformat (input, "uri %s", &uri))
 	;
+      else if (unformat (input, "defer-accept"))
+	defer_accept = 1;
       else
 	break;
     }
@@ -180,11 +200,50 @@ builtin_uri_bind_command_fn (vlib_main_t * vm,
 VLIB_CLI_COMMAND (builtin_uri_bind_command, static) =
 {
   .path = "builtin uri bind",
-  .short_help = "builtin uri bind",
+  .short_help = "builtin uri bind uri <uri> [defer-accept]",
   .function = builtin_uri_bind_command_fn,
 };
 /* *INDENT-ON* */
 
+static clib_error_t *
+builtin_uri_accept_command_fn (vlib_main_t * vm,
+			       unformat_input_t * input,
+			       vlib_cli_command_t * cmd)
+{
+  stream_session_t *s;
+  u32 *si, n_accepted = 0;
+  int i;
+
+  /* As the API accept reply handlers do */
+  vlib_worker_thread_barrier_sync (vm);
+  for (i = 0; i < vec_len (pending_sessions); i++)
+    {
+      vec_foreach (si, pending_sessions[i])
+      {
+	s = stream_session_get_if_valid (*si, i);
+	if (s && s->session_state == SESSION_STATE_CONNECTING)
+	  {
+	    stream_session_accept_ready (s);
+	    n_accepted++;
+	  }
+      }
+      vec_reset_length (pending_sessions[i]);
+    }
+  vlib_worker_thread_barrier_release (vm);
+
+  vlib_cli_output (vm, "%d sessions accepted", n_accepted);
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (builtin_uri_accept_command, static) =
+{
+  .path = "builtin uri accept",
+  .short_help = "builtin uri accept",
+  .function = builtin_uri_accept_command_fn,
+};
+/* *INDENT-ON* */
+
 static clib_error_t *
 builtin_uri_unbind_command_fn (vlib_main_t * vm,
 			       unformat_input_t * input,
@@ -21,64 +21,67 @@
 #include <vnet/session/session.h>
 #include <vnet/dpo/load_balance.h>
 #include <vnet/fib/ip4_fib.h>
+#include <vnet/fib/fib.h>
 
 udp_uri_main_t udp_uri_main;
 
-u32
-udp_session_bind_ip4 (u32 session_index,
-		      ip46_address_t * ip, u16 port_number_host_byte_order)
+static u32
+udp_session_bind (u32 session_index, ip46_address_t * ip,
+		  u16 port_number_host_byte_order, u8 is_ip4)
 {
   udp_uri_main_t *um = vnet_get_udp_main ();
+  vlib_thread_main_t *vtm = vlib_get_thread_main ();
   udp_connection_t *listener;
 
   pool_get (um->udp_listeners, listener);
   memset (listener, 0, sizeof (udp_connection_t));
   listener->c_lcl_port = clib_host_to_net_u16 (port_number_host_byte_order);
-  listener->c_lcl_ip4.as_u32 = ip->ip4.as_u32;
-  listener->c_proto = SESSION_TYPE_IP4_UDP;
+  clib_memcpy (&listener->c_lcl_ip, ip, sizeof (*ip));
+  listener->c_is_ip4 = is_ip4;
+  listener->c_proto = is_ip4 ? SESSION_TYPE_IP4_UDP : SESSION_TYPE_IP6_UDP;
+  listener->c_s_index = session_index;
+  listener->c_c_index = listener - um->udp_listeners;
+
+  /* Unconnected connections are created as datagrams reach the workers */
+  vec_validate_init_empty (listener->bound_by_thread, vtm->n_threads, ~0);
+
   udp_register_dst_port (um->vlib_main, port_number_host_byte_order,
-			 udp4_uri_input_node.index, 1 /* is_ipv4 */ );
-  return 0;
+			 is_ip4 ? udp4_uri_input_node.index :
+			 udp6_uri_input_node.index, is_ip4);
+  return listener->c_c_index;
 }
 
 u32
-udp_session_bind_ip6 (u32 session_index,
+udp_session_bind_ip4 (u32 session_index,
 		      ip46_address_t * ip, u16 port_number_host_byte_order)
 {
-  udp_uri_main_t *um = vnet_get_udp_main ();
-  udp_connection_t *listener;
-
-  pool_get (um->udp_listeners, listener);
-  listener->c_lcl_port = clib_host_to_net_u16 (port_number_host_byte_order);
-  clib_memcpy (&listener->c_lcl_ip6, &ip->ip6, sizeof (ip6_address_t));
-  listener->c_proto = SESSION_TYPE_IP6_UDP;
-  udp_register_dst_port (um->vlib_main, port_number_host_byte_order,
-			 udp4_uri_input_node.index, 0 /* is_ipv4 */ );
-  return 0;
+  return udp_session_bind (session_index, ip, port_number_host_byte_order,
+			   1 /* is_ip4 */ );
 }
 
 u32
-udp_session_unbind_ip4 (u32 listener_index)
+udp_session_bind_ip6 (u32 session_index,
+		      ip46_address_t * ip, u16 port_number_host_byte_order)
 {
-  vlib_main_t *vm = vlib_get_main ();
-  udp_connection_t *listener;
-  listener = udp_listener_get (listener_index);
-
-  /* deregister the udp_local mapping */
-  udp_unregister_dst_port (vm, listener->c_lcl_port, 1 /* is_ipv4 */ );
-  return 0;
+  return udp_session_bind (session_index, ip, port_number_host_byte_order,
+			   0 /* is_ip4 */ );
 }
 
 u32
-udp_session_unbind_ip6 (u32 listener_index)
+udp_session_unbind (u32 listener_index)
 {
+  udp_uri_main_t *um = vnet_get_udp_main ();
   vlib_main_t *vm = vlib_get_main ();
   udp_connection_t *listener;
 
   listener = udp_listener_get (listener_index);
 
   /* deregister the udp_local mapping */
-  udp_unregister_dst_port (vm, listener->c_lcl_port, 0 /* is_ipv4 */ );
+  udp_unregister_dst_port (vm, clib_net_to_host_u16 (listener->c_lcl_port),
+			   listener->c_is_ip4);
+
+  vec_free (listener->bound_by_thread);
+  pool_put (um->udp_listeners, listener);
   return 0;
 }
 
@@ -91,78 +94,70 @@ udp_session_get_listener (u32 listener_index)
   return &us->connection;
 }
 
-u32
-udp_push_header (transport_connection_t * tconn, vlib_buffer_t * b)
+always_inline u32
+udp_push_header_i (vlib_main_t * vm, vlib_buffer_t * b, u8 is_ip4,
+		   ip46_address_t * lcl, u16 lcl_port, ip46_address_t * rmt,
+		   u16 rmt_port)
 {
-  udp_connection_t *us;
-  u8 *data;
   udp_header_t *udp;
 
-  us = (udp_connection_t *) tconn;
+  udp = vlib_buffer_push_uninit (b, sizeof (*udp));
+  udp->src_port = lcl_port;
+  udp->dst_port = rmt_port;
+  udp->length = clib_host_to_net_u16 (vlib_buffer_length_in_chain (vm, b));
+  udp->checksum = 0;
 
-  if (tconn->is_ip4)
+  if (is_ip4)
     {
-      ip4_header_t *ip;
-
-      data = vlib_buffer_get_current (b);
-      udp = (udp_header_t *) (data - sizeof (udp_header_t));
-      ip = (ip4_header_t *) ((u8 *) udp - sizeof (ip4_header_t));
-
-      /* Build packet header, swap rx key src + dst fields */
-      ip->src_address.as_u32 = us->c_lcl_ip4.as_u32;
-      ip->dst_address.as_u32 = us->c_rmt_ip4.as_u32;
-      ip->ip_version_and_header_length = 0x45;
-      ip->ttl = 254;
-      ip->protocol = IP_PROTOCOL_UDP;
-      ip->length = clib_host_to_net_u16 (b->current_length + sizeof (*udp));
-      ip->checksum = ip4_header_checksum (ip);
-
-      udp->src_port = us->c_lcl_port;
-      udp->dst_port = us->c_rmt_port;
-      udp->length = clib_host_to_net_u16 (b->current_length);
-      udp->checksum = 0;
-
-      b->current_length = sizeof (*ip) + sizeof (*udp);
+      vlib_buffer_push_ip4 (vm, b, &lcl->ip4, &rmt->ip4, IP_PROTOCOL_UDP);
       return SESSION_QUEUE_NEXT_IP4_LOOKUP;
     }
   else
     {
-      vlib_main_t *vm = vlib_get_main ();
       ip6_header_t *ip;
-      u16 payload_length;
       int bogus = ~0;
 
-      data = vlib_buffer_get_current (b);
-      udp = (udp_header_t *) (data - sizeof (udp_header_t));
-      ip = (ip6_header_t *) ((u8 *) udp - sizeof (ip6_header_t));
-
-      /* Build packet header, swap rx key src + dst fields */
-      clib_memcpy (&ip->src_address, &us->c_lcl_ip6, sizeof (ip6_address_t));
-      clib_memcpy (&ip->dst_address, &us->c_rmt_ip6, sizeof (ip6_address_t));
-
-      ip->ip_version_traffic_class_and_flow_label =
-	clib_host_to_net_u32 (0x6 << 28);
+      ip = vlib_buffer_push_ip6 (vm, b, &lcl->ip6, &rmt->ip6,
+				 IP_PROTOCOL_UDP);
 
-      ip->hop_limit = 0xff;
-      ip->protocol = IP_PROTOCOL_UDP;
+      /* Mandatory for ipv6, zero means no checksum */
+      udp->checksum = ip6_tcp_udp_icmp_compute_checksum (vm, b, ip, &bogus);
+      ASSERT (!bogus);
+      if (udp->checksum == 0)
+	udp->checksum = 0xffff;
 
-      payload_length = vlib_buffer_length_in_chain (vm, b);
-      payload_length -= sizeof (*ip);
+      return SESSION_QUEUE_NEXT_IP6_LOOKUP;
+    }
+}
 
-      ip->payload_length = clib_host_to_net_u16 (payload_length);
+u32
+udp_push_header (transport_connection_t * tconn, vlib_buffer_t * b)
+{
+  return udp_push_header_i (vlib_get_main (), b, tconn->is_ip4,
+			    &tconn->lcl_ip, tconn->lcl_port, &tconn->rmt_ip,
+			    tconn->rmt_port);
+}
 
-      udp->checksum = ip6_tcp_udp_icmp_compute_checksum (vm, b, ip, &bogus);
-      ASSERT (!bogus);
+/**
+ * Send one datagram record. Unconnected connections take the peer from
+ * the record header, and the source address too if the app set one,
+ * e.g., to reply from the address a wildcard listener was reached on.
+ */
+u32
+udp_push_dgram_header (transport_connection_t * tconn, vlib_buffer_t * b,
+		       transport_dgram_hdr_t * hdr)
+{
+  udp_connection_t *uc = (udp_connection_t *) tconn;
+  ip46_address_t *lcl = &tconn->lcl_ip;
 
-      udp->src_port = us->c_lcl_port;
-      udp->dst_port = us->c_rmt_port;
-      udp->length = clib_host_to_net_u16 (b->current_length);
-      udp->checksum = 0;
+  if (uc->flags & UDP_CONN_F_CONNECTED)
+    return udp_push_header (tconn, b);
 
-      b->current_length = sizeof (*ip) + sizeof (*udp);
+  if (!ip46_address_is_zero (&hdr->lcl_ip))
+    lcl = &hdr->lcl_ip;
 
-      return SESSION_QUEUE_NEXT_IP6_LOOKUP;
-    }
+  return udp_push_header_i (vlib_get_main (), b, tconn->is_ip4, lcl,
+			    tconn->lcl_port, &hdr->rmt_ip, hdr->rmt_port);
 }
 
 transport_connection_t *
@@ -176,11 +171,46 @@ udp_session_get (u32 connection_index, u32 my_thread_index)
   return &us->connection;
 }
 
+/**
+ * Free connection without telling the session layer, e.g., because the
+ * session couldn't be created.
+ */
 void
-udp_session_close (u32 connection_index, u32 my_thread_index)
+udp_session_cleanup (u32 connection_index, u32 my_thread_index)
 {
   udp_uri_main_t *um = vnet_get_udp_main ();
-  pool_put_index (um->udp_sessions[my_thread_index], connection_index);
+  udp_connection_t *uc, *listener;
+
+  uc = udp_connection_get (connection_index, my_thread_index);
+
+  if (uc->flags & UDP_CONN_F_OWNS_PORT)
+    udp_unregister_dst_port (um->vlib_main,
+			     clib_net_to_host_u16 (uc->c_lcl_port),
+			     uc->c_is_ip4);
+
+  if (!(uc->flags & UDP_CONN_F_CONNECTED)
+      && !pool_is_free_index (um->udp_listeners, uc->listener_index))
+    {
+      listener = udp_listener_get (uc->listener_index);
+      if (listener->bound_by_thread[my_thread_index] == connection_index)
+	listener->bound_by_thread[my_thread_index] = ~0;
+    }
+
+  pool_put (um->udp_sessions[my_thread_index], uc);
+}
+
+/**
+ * No handshake to go through, the connection and its session go away
+ * right away.
+ */
+void
+udp_session_close (u32 connection_index, u32 my_thread_index)
+{
+  udp_connection_t *uc;
+
+  uc = udp_connection_get (connection_index, my_thread_index);
+  stream_session_delete_notify (&uc->connection);
+  udp_session_cleanup (connection_index, my_thread_index);
 }
 
 u8 *
@@ -239,8 +269,10 @@ format_udp_listener_session_ip6 (u8 * s, va_list * args)
 u16
 udp_send_mss_uri (transport_connection_t * t)
 {
-  /* TODO figure out MTU of output interface */
-  return 400;
+  /* Datagrams are sent unfragmented on a 1500 byte mtu */
+  if (t->is_ip4)
+    return 1500 - sizeof (ip4_header_t) - sizeof (udp_header_t);
+  return 1500 - sizeof (ip6_header_t) - sizeof (udp_header_t);
 }
 
 u32
@@ -250,22 +282,168 @@ udp_send_space_uri (transport_connection_t * t)
   return ~0;
 }
 
-int
-udp_open_connection (ip46_address_t * addr, u16 port)
+/** Ports tried in search of one whose replies land on the opening worker */
+#define UDP_RSS_PORT_TRIES 512
+
+/**
+ * Allocate an ephemeral port nobody registered with udp_local. A worker
+ * opening a connection prefers ports whose replies the interface's rss
+ * steers back to it, the main thread takes any port and lets the rss
+ * hash pick the connection's thread.
+ */
+static u16
+udp_allocate_local_port (udp_uri_main_t * um, ip46_address_t * lcl,
+			 ip46_address_t * rmt, u16 rmt_port,
+			 vnet_hw_interface_t * hw, u8 is_ip4)
 {
-  clib_warning ("Not implemented");
+  u32 thread_index = os_get_cpu_number (), reply_thread;
+  u16 min = 1024, max = 65535, port;
+  udp_dst_port_info_t *pi;
+  int tries, rss_tries = 0;
+
+  for (tries = max - min; tries >= 0; tries--)
+    {
+      port = min + random_u32 (&um->port_seed) % (max - min);
+      pi = udp_get_dst_port_info (&udp_main, port, is_ip4);
+      if (pi && pi->node_index != ~0)
+	continue;
+
+      if (thread_index != 0 && rss_tries < UDP_RSS_PORT_TRIES)
+	{
+	  reply_thread = transport_reply_thread_index (hw, lcl, port, rmt,
+						       rmt_port, is_ip4);
+	  if (reply_thread != ~0 && reply_thread != thread_index)
+	    {
+	      rss_tries++;
+	      continue;
+	    }
+	}
+
+      return port;
+    }
   return 0;
 }
 
+/**
+ * Connected active open. There's no handshake, the connection is ready
+ * to send once created. Sessions are only looked up in the table of the
+ * thread that receives the packet, so the connection, and its session,
+ * live on the thread the interface's rss steers the replies to. If the
+ * interface doesn't publish its rss placement, that's the opening
+ * thread.
+ *
+ * @return connection index or -1 if there's no route to rmt or no port
+ */
+static int
+udp_open_connection (ip46_address_t * rmt, u16 rmt_port, u8 is_ip4,
+		     u32 * thread_indexp)
+{
+  udp_uri_main_t *um = vnet_get_udp_main ();
+  u32 thread_index = os_get_cpu_number (), my_thread_index = thread_index;
+  vlib_main_t *vm = vlib_get_main ();
+  vnet_hw_interface_t *hw;
+  udp_connection_t *uc;
+  fib_prefix_t prefix;
+  u32 fei, sw_if_index, reply_thread;
+  ip46_address_t lcl;
+  u16 lcl_port;
+
+  memset (&lcl, 0, sizeof (lcl));
+
+  /* Find a FIB path to the destination */
+  clib_memcpy (&prefix.fp_addr, rmt, sizeof (*rmt));
+  prefix.fp_proto = is_ip4 ? FIB_PROTOCOL_IP4 : FIB_PROTOCOL_IP6;
+  prefix.fp_len = is_ip4 ? 32 : 128;
+
+  fei = fib_table_lookup (0, &prefix);
+  if (fei == FIB_NODE_INDEX_INVALID)
+    return -1;
+
+  sw_if_index = fib_entry_get_resolving_interface (fei);
+  if (sw_if_index == (u32) ~ 0)
+    return -1;
+
+  if (is_ip4)
+    {
+      ip4_address_t *ip4;
+      ip4 = ip_interface_get_first_ip (sw_if_index, 1);
+      if (ip4 == 0)
+	return -1;
+      lcl.ip4.as_u32 = ip4->as_u32;
+    }
+  else
+    {
+      ip6_address_t *ip6;
+      ip6 = ip_interface_get_first_ip (sw_if_index, 0);
+      if (ip6 == 0)
+	return -1;
+      clib_memcpy (&lcl.ip6, ip6, sizeof (*ip6));
+    }
+
+  hw = vnet_get_sup_hw_interface (um->vnet_main, sw_if_index);
+  lcl_port = udp_allocate_local_port (um, &lcl, rmt, rmt_port, hw, is_ip4);
+  if (lcl_port < 1)
+    {
+      clib_warning ("Failed to allocate src port");
+      return -1;
+    }
+
+  reply_thread = transport_reply_thread_index (hw, &lcl, lcl_port, rmt,
+					       rmt_port, is_ip4);
+  if (reply_thread != ~0 && reply_thread < vec_len (um->udp_sessions))
+    thread_index = reply_thread;
+
+  /* Another thread's pools, keep it away while we add to them */
+  if (thread_index != my_thread_index)
+    vlib_worker_thread_barrier_sync (vm);
+
+  pool_get (um->udp_sessions[thread_index], uc);
+  memset (uc, 0, sizeof (*uc));
+
+  clib_memcpy (&uc->c_rmt_ip, rmt, sizeof (ip46_address_t));
+  clib_memcpy (&uc->c_lcl_ip, &lcl, sizeof (ip46_address_t));
+  uc->c_rmt_port = clib_host_to_net_u16 (rmt_port);
+  uc->c_lcl_port = clib_host_to_net_u16 (lcl_port);
+  uc->c_is_ip4 = is_ip4;
+  uc->c_proto = is_ip4 ? SESSION_TYPE_IP4_UDP : SESSION_TYPE_IP6_UDP;
+  uc->c_thread_index = thread_index;
+  uc->c_c_index = uc - um->udp_sessions[thread_index];
+  uc->flags = UDP_CONN_F_CONNECTED | UDP_CONN_F_OWNS_PORT;
+
+  if (thread_index != my_thread_index)
+    vlib_worker_thread_barrier_release (vm);
+
+  udp_register_dst_port (um->vlib_main, lcl_port,
+			 is_ip4 ? udp4_uri_input_node.index :
+			 udp6_uri_input_node.index, is_ip4);
+
+  *thread_indexp = thread_index;
+  return uc->c_c_index;
+}
+
+int
+udp_session_open_ip4 (ip46_address_t * addr, u16 port, u32 * thread_index)
+{
+  return udp_open_connection (addr, port, 1, thread_index);
+}
+
+int
+udp_session_open_ip6 (ip46_address_t * addr, u16 port, u32 * thread_index)
+{
+  return udp_open_connection (addr, port, 0, thread_index);
+}
+
 /* *INDENT-OFF* */
 const static transport_proto_vft_t udp4_proto = {
   .bind = udp_session_bind_ip4,
-  .open = udp_open_connection,
-  .unbind = udp_session_unbind_ip4,
+  .open = udp_session_open_ip4,
+  .unbind = udp_session_unbind,
   .push_header = udp_push_header,
+  .push_dgram_header = udp_push_dgram_header,
   .get_connection = udp_session_get,
   .get_listener = udp_session_get_listener,
   .close = udp_session_close,
+  .cleanup = udp_session_cleanup,
   .send_mss = udp_send_mss_uri,
   .send_space = udp_send_space_uri,
   .format_connection = format_udp_session_ip4,
@@ -274,12 +452,14 @@ const static transport_proto_vft_t udp4_proto = {
 
 const static transport_proto_vft_t udp6_proto = {
   .bind = udp_session_bind_ip6,
-  .open = udp_open_connection,
-  .unbind = udp_session_unbind_ip6,
+  .open = udp_session_open_ip6,
+  .unbind = udp_session_unbind,
   .push_header = udp_push_header,
+  .push_dgram_header = udp_push_dgram_header,
   .get_connection = udp_session_get,
   .get_listener = udp_session_get_listener,
   .close = udp_session_close,
+  .cleanup = udp_session_cleanup,
   .send_mss = udp_send_mss_uri,
   .send_space = udp_send_space_uri,
   .format_connection = format_udp_session_ip6,
@@ -329,6 +509,7 @@ udp_init (vlib_main_t * vm)
 
   num_threads = 1 /* main thread */  + tm->n_threads;
   vec_validate (um->udp_sessions, num_threads - 1);
+  um->port_seed = random_default_seed ();
 
   return error;
 }
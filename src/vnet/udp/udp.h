@@ -26,12 +26,26 @@
 #include <vnet/ip/ip.h>
 #include <vnet/session/transport.h>
 
+/** Connection talks to a single peer. Otherwise it's a worker's share of
+ * an unbound listener and each datagram carries its peer */
+#define UDP_CONN_F_CONNECTED	(1 << 0)
+
+/** Active open, the connection registered its local port with udp_local */
+#define UDP_CONN_F_OWNS_PORT	(1 << 1)
+
 typedef struct
 {
   transport_connection_t connection;	      /** must be first */
 
-  /** ersatz MTU to limit fifo pushes to test data size */
-  u32 mtu;
+  /** UDP_CONN_F_* */
+  u8 flags;
+
+  /** Listener: per thread index of the unconnected connection, ~0 until
+   *  the first datagram for the listener reaches the thread */
+  u32 *bound_by_thread;
+
+  /** Unconnected connection: listener it's a share of */
+  u32 listener_index;
 } udp_connection_t;
 
 typedef struct _udp_uri_main
@@ -40,6 +54,9 @@ typedef struct _udp_uri_main
   udp_connection_t **udp_sessions;
   udp_connection_t *udp_listeners;
 
+  /** Seed for local port allocation */
+  u32 port_seed;
+
   /* convenience */
   vlib_main_t *vlib_main;
   vnet_main_t *vnet_main;
@@ -49,6 +66,7 @@ typedef struct _udp_uri_main
 
 extern udp_uri_main_t udp_uri_main;
 extern vlib_node_registration_t udp4_uri_input_node;
+extern vlib_node_registration_t udp6_uri_input_node;
 
 always_inline udp_uri_main_t *
 vnet_get_udp_main ()
@@ -150,6 +168,8 @@ typedef struct
   vlib_main_t *vlib_main;
 } udp_main_t;
 
+extern udp_main_t udp_main;
+
 always_inline udp_dst_port_info_t *
 udp_get_dst_port_info (udp_main_t * um, udp_dst_port_t dst_port, u8 is_ip4)
 {
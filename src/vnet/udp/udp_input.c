@@ -29,54 +29,112 @@
 #include "../session/application_interface.h"
 
 vlib_node_registration_t udp4_uri_input_node;
+vlib_node_registration_t udp6_uri_input_node;
 
 typedef struct
 {
   u32 session;
   u32 disposition;
   u32 thread_index;
-} udp4_uri_input_trace_t;
+} udp_uri_input_trace_t;
 
 /* packet trace format function */
 static u8 *
-format_udp4_uri_input_trace (u8 * s, va_list * args)
+format_udp_uri_input_trace (u8 * s, va_list * args)
 {
   CLIB_UNUSED (vlib_main_t * vm) = va_arg (*args, vlib_main_t *);
   CLIB_UNUSED (vlib_node_t * node) = va_arg (*args, vlib_node_t *);
-  udp4_uri_input_trace_t *t = va_arg (*args, udp4_uri_input_trace_t *);
+  udp_uri_input_trace_t *t = va_arg (*args, udp_uri_input_trace_t *);
 
-  s = format (s, "UDP4_URI_INPUT: session %d, disposition %d, thread %d",
+  s = format (s, "UDP_URI_INPUT: session %d, disposition %d, thread %d",
 	      t->session, t->disposition, t->thread_index);
   return s;
 }
 
 typedef enum
 {
-  UDP4_URI_INPUT_NEXT_DROP,
-  UDP4_URI_INPUT_N_NEXT,
-} udp4_uri_input_next_t;
+  UDP_URI_INPUT_NEXT_DROP,
+  UDP_URI_INPUT_N_NEXT,
+} udp_uri_input_next_t;
 
-static char *udp4_uri_input_error_strings[] = {
+static char *udp_uri_input_error_strings[] = {
 #define _(sym,string) string,
   foreach_session_input_error
 #undef _
 };
 
-static uword
-udp4_uri_input_node_fn (vlib_main_t * vm,
-			vlib_node_runtime_t * node, vlib_frame_t * frame)
+/**
+ * Datagram for a listener. Apps that asked for connected sessions get one
+ * per peer, the others share one unconnected session per thread, created
+ * by the first datagram the thread receives.
+ *
+ * @return session to enqueue to, 0 if it couldn't be created
+ */
+static stream_session_t *
+udp_listener_session (udp_uri_main_t * um, stream_session_t * ls,
+		      transport_dgram_hdr_t * hdr, u32 thread_index,
+		      u32 * error)
+{
+  udp_connection_t *listener, *uc;
+  application_t *app;
+  u8 is_connected;
+  int rv;
+
+  listener = udp_listener_get (ls->connection_index);
+  app = application_get (ls->app_index);
+  is_connected = (app->flags & SESSION_OPTIONS_FLAGS_UDP_CONNECTED) != 0;
+
+  if (!is_connected && listener->bound_by_thread[thread_index] != ~0)
+    {
+      uc = udp_connection_get (listener->bound_by_thread[thread_index],
+			       thread_index);
+      return stream_session_get (uc->c_s_index, thread_index);
+    }
+
+  pool_get (um->udp_sessions[thread_index], uc);
+  memset (uc, 0, sizeof (*uc));
+
+  /* Wildcard listeners reply from the address they were reached on */
+  clib_memcpy (&uc->c_lcl_ip, &hdr->lcl_ip, sizeof (ip46_address_t));
+  uc->c_lcl_port = hdr->lcl_port;
+  uc->c_is_ip4 = hdr->is_ip4;
+  uc->c_proto = ls->session_type;
+  uc->c_thread_index = thread_index;
+  uc->c_c_index = uc - um->udp_sessions[thread_index];
+  uc->listener_index = listener->c_c_index;
+
+  if (is_connected)
+    {
+      clib_memcpy (&uc->c_rmt_ip, &hdr->rmt_ip, sizeof (ip46_address_t));
+      uc->c_rmt_port = hdr->rmt_port;
+      uc->flags = UDP_CONN_F_CONNECTED;
+    }
+  else
+    listener->bound_by_thread[thread_index] = uc->c_c_index;
+
+  rv = stream_session_accept (&uc->connection, ls->session_index,
+			      ls->session_type, 1 /* notify */ );
+  if (rv)
+    {
+      if (!is_connected)
+	listener->bound_by_thread[thread_index] = ~0;
+      pool_put (um->udp_sessions[thread_index], uc);
+      *error = rv;
+      return 0;
+    }
+
+  return stream_session_get (uc->c_s_index, thread_index);
+}
+
+always_inline uword
+udp_uri_input_inline (vlib_main_t * vm, vlib_node_runtime_t * node,
+		      vlib_frame_t * frame, u8 is_ip4)
 {
   u32 n_left_from, *from, *to_next;
-  udp4_uri_input_next_t next_index;
+  udp_uri_input_next_t next_index;
   udp_uri_main_t *um = vnet_get_udp_main ();
   session_manager_main_t *smm = vnet_get_session_manager_main ();
   u32 my_thread_index = vm->cpu_index;
-  u8 my_enqueue_epoch;
-  u32 *session_indices_to_enqueue;
-  static u32 serial_number;
-  int i;
-
-  my_enqueue_epoch = ++smm->current_enqueue_epoch[my_thread_index];
 
   from = vlib_frame_vector_args (frame);
   n_left_from = frame->n_vectors;
@@ -92,13 +150,12 @@ udp4_uri_input_node_fn (vlib_main_t * vm,
 	{
 	  u32 bi0;
 	  vlib_buffer_t *b0;
-	  u32 next0 = UDP4_URI_INPUT_NEXT_DROP;
+	  u32 next0 = UDP_URI_INPUT_NEXT_DROP;
 	  u32 error0 = SESSION_ERROR_ENQUEUED;
+	  transport_dgram_hdr_t hdr0;
 	  udp_header_t *udp0;
-	  ip4_header_t *ip0;
 	  stream_session_t *s0;
-	  svm_fifo_t *f0;
-	  u16 udp_len0;
+	  udp_connection_t *uc0;
 	  u8 *data0;
 
 	  /* speculatively enqueue b0 to the current next frame */
@@ -117,13 +174,39 @@ udp4_uri_input_node_fn (vlib_main_t * vm,
 	  udp0 = (udp_header_t *) (data0 - sizeof (*udp0));
 
 	  /* $$$$ fixme: udp_local doesn't do ip options correctly anyhow */
-	  ip0 = (ip4_header_t *) (((u8 *) udp0) - sizeof (*ip0));
-	  s0 = 0;
-
-	  /* lookup session */
-	  s0 = stream_session_lookup4 (&ip0->dst_address, &ip0->src_address,
-				       udp0->dst_port, udp0->src_port,
-				       SESSION_TYPE_IP4_UDP, my_thread_index);
+	  memset (&hdr0, 0, sizeof (hdr0));
+	  if (is_ip4)
+	    {
+	      ip4_header_t *ip0;
+
+	      ip0 = (ip4_header_t *) (((u8 *) udp0) - sizeof (*ip0));
+	      hdr0.lcl_ip.ip4.as_u32 = ip0->dst_address.as_u32;
+	      hdr0.rmt_ip.ip4.as_u32 = ip0->src_address.as_u32;
+	      s0 = stream_session_lookup4 (&ip0->dst_address,
+					   &ip0->src_address, udp0->dst_port,
+					   udp0->src_port,
+					   SESSION_TYPE_IP4_UDP,
+					   my_thread_index);
+	    }
+	  else
+	    {
+	      ip6_header_t *ip0;
+
+	      ip0 = (ip6_header_t *) (((u8 *) udp0) - sizeof (*ip0));
+	      clib_memcpy (&hdr0.lcl_ip.ip6, &ip0->dst_address,
+			   sizeof (ip6_address_t));
+	      clib_memcpy (&hdr0.rmt_ip.ip6, &ip0->src_address,
+			   sizeof (ip6_address_t));
+	      s0 = stream_session_lookup6 (&ip0->dst_address,
+					   &ip0->src_address, udp0->dst_port,
+					   udp0->src_port,
+					   SESSION_TYPE_IP6_UDP,
+					   my_thread_index);
+	    }
+	  hdr0.lcl_port = udp0->dst_port;
+	  hdr0.rmt_port = udp0->src_port;
+	  hdr0.is_ip4 = is_ip4;
+	  hdr0.data_length = vlib_buffer_length_in_chain (vm, b0);
 
 	  /* no listener */
 	  if (PREDICT_FALSE (s0 == 0))
@@ -132,81 +215,34 @@ udp4_uri_input_node_fn (vlib_main_t * vm,
 	      goto trace0;
 	    }
 
-	  f0 = s0->server_rx_fifo;
-
-	  /* established hit */
-	  if (PREDICT_TRUE (s0->session_state == SESSION_STATE_READY))
+	  /* listener hit, find or create the session */
+	  if (s0->session_state == SESSION_STATE_LISTENING)
 	    {
-	      udp_len0 = clib_net_to_host_u16 (udp0->length);
-
-	      if (PREDICT_FALSE (udp_len0 > svm_fifo_max_enqueue (f0)))
-		{
-		  error0 = SESSION_ERROR_FIFO_FULL;
-		  goto trace0;
-		}
-
-	      svm_fifo_enqueue_nowait (f0, 0 /* pid */ ,
-				       udp_len0 - sizeof (*udp0),
-				       (u8 *) (udp0 + 1));
-
-	      b0->error = node->errors[SESSION_ERROR_ENQUEUED];
-
-	      /* We need to send an RX event on this fifo */
-	      if (s0->enqueue_epoch != my_enqueue_epoch)
-		{
-		  s0->enqueue_epoch = my_enqueue_epoch;
-
-		  vec_add1 (smm->session_indices_to_enqueue_by_thread
-			    [my_thread_index],
-			    s0 - smm->sessions[my_thread_index]);
-		}
+	      s0 = udp_listener_session (um, s0, &hdr0, my_thread_index,
+					 &error0);
+	      if (PREDICT_FALSE (s0 == 0))
+		goto trace0;
 	    }
-	  /* listener hit */
-	  else if (s0->session_state == SESSION_STATE_LISTENING)
-	    {
-	      udp_connection_t *us;
-	      int rv;
 
-	      error0 = SESSION_ERROR_NOT_READY;
-
-	      /*
-	       * create udp transport session
-	       */
-	      pool_get (um->udp_sessions[my_thread_index], us);
-
-	      us->mtu = 1024;	/* $$$$ policy */
-
-	      us->c_lcl_ip4.as_u32 = ip0->dst_address.as_u32;
-	      us->c_rmt_ip4.as_u32 = ip0->src_address.as_u32;
-	      us->c_lcl_port = udp0->dst_port;
-	      us->c_rmt_port = udp0->src_port;
-	      us->c_proto = SESSION_TYPE_IP4_UDP;
-	      us->c_c_index = us - um->udp_sessions[my_thread_index];
-
-	      /*
-	       * create stream session and attach the udp session to it
-	       */
-	      rv = stream_session_accept (&us->connection, s0->session_index,
-					  SESSION_TYPE_IP4_UDP,
-					  1 /*notify */ );
-	      if (rv)
-		error0 = rv;
-
-	    }
-	  else
+	  if (PREDICT_FALSE (s0->session_state == SESSION_STATE_CLOSED))
 	    {
-
 	      error0 = SESSION_ERROR_NOT_READY;
 	      goto trace0;
 	    }
 
+	  /* Queued without an event until the app accepts the session */
+	  uc0 = udp_connection_get (s0->connection_index, my_thread_index);
+	  if (stream_session_enqueue_dgram (&uc0->connection, b0, &hdr0,
+					    1 /* queue event */ ) < 0)
+	    error0 = SESSION_ERROR_FIFO_FULL;
+
 	trace0:
 	  b0->error = node->errors[error0];
 
 	  if (PREDICT_FALSE ((node->flags & VLIB_NODE_FLAG_TRACE)
 			     && (b0->flags & VLIB_BUFFER_IS_TRACED)))
 	    {
-	      udp4_uri_input_trace_t *t =
+	      udp_uri_input_trace_t *t =
 		vlib_add_trace (vm, node, b0, sizeof (*t));
 
 	      t->session = ~0;
@@ -225,85 +261,61 @@ udp4_uri_input_node_fn (vlib_main_t * vm,
       vlib_put_next_frame (vm, node, next_index, n_left_to_next);
     }
 
-  /* Send enqueue events */
-
-  session_indices_to_enqueue =
-    smm->session_indices_to_enqueue_by_thread[my_thread_index];
-
-  for (i = 0; i < vec_len (session_indices_to_enqueue); i++)
-    {
-      session_fifo_event_t evt;
-      unix_shared_memory_queue_t *q;
-      stream_session_t *s0;
-      application_t *server0;
-
-      /* Get session */
-      s0 = pool_elt_at_index (smm->sessions[my_thread_index],
-			      session_indices_to_enqueue[i]);
-
-      /* Get session's server */
-      server0 = application_get (s0->app_index);
-
-      /* Fabricate event */
-      evt.fifo = s0->server_rx_fifo;
-      evt.event_type = FIFO_EVENT_SERVER_RX;
-      evt.event_id = serial_number++;
-      evt.enqueue_length = svm_fifo_max_dequeue (s0->server_rx_fifo);
-
-      /* Built-in server? Deliver the goods... */
-      if (server0->cb_fns.builtin_server_rx_callback)
-	{
-	  server0->cb_fns.builtin_server_rx_callback (s0, &evt);
-	  continue;
-	}
-
-      /* Add event to server's event queue */
-      q = server0->event_queue;
-
-      /* Don't block for lack of space */
-      if (PREDICT_TRUE (q->cursize < q->maxsize))
-	unix_shared_memory_queue_add (server0->event_queue, (u8 *) & evt,
-				      0 /* do wait for mutex */ );
-      else
-	{
-	  vlib_node_increment_counter (vm, udp4_uri_input_node.index,
-				       SESSION_ERROR_FIFO_FULL, 1);
-	}
-      if (1)
-	{
-	  ELOG_TYPE_DECLARE (e) =
-	  {
-	  .format = "evt-enqueue: id %d length %d",.format_args = "i4i4",};
-	  struct
-	  {
-	    u32 data[2];
-	  } *ed;
-	  ed = ELOG_DATA (&vlib_global_main.elog_main, e);
-	  ed->data[0] = evt.event_id;
-	  ed->data[1] = evt.enqueue_length;
-	}
-    }
+  /* One rx event per session, however many datagrams it got */
+  session_manager_flush_enqueue_events (my_thread_index);
 
-  vec_reset_length (session_indices_to_enqueue);
+  return frame->n_vectors;
+}
 
-  smm->session_indices_to_enqueue_by_thread[my_thread_index] =
-    session_indices_to_enqueue;
+static uword
+udp4_uri_input_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
+			vlib_frame_t * frame)
+{
+  return udp_uri_input_inline (vm, node, frame, 1 /* is_ip4 */ );
+}
 
-  return frame->n_vectors;
+static uword
+udp6_uri_input_node_fn (vlib_main_t * vm, vlib_node_runtime_t * node,
+			vlib_frame_t * frame)
+{
+  return udp_uri_input_inline (vm, node, frame, 0 /* is_ip4 */ );
 }
 
+/* *INDENT-OFF* */
 VLIB_REGISTER_NODE (udp4_uri_input_node) =
 {
-  .function = udp4_uri_input_node_fn,.name = "udp4-uri-input",.vector_size =
-    sizeof (u32),.format_trace = format_udp4_uri_input_trace,.type =
-    VLIB_NODE_TYPE_INTERNAL,.n_errors =
-    ARRAY_LEN (udp4_uri_input_error_strings),.error_strings =
-    udp4_uri_input_error_strings,.n_next_nodes = UDP4_URI_INPUT_N_NEXT,
-    /* edit / add dispositions here */
-    .next_nodes =
+  .function = udp4_uri_input_node_fn,
+  .name = "udp4-uri-input",
+  .vector_size = sizeof (u32),
+  .format_trace = format_udp_uri_input_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (udp_uri_input_error_strings),
+  .error_strings = udp_uri_input_error_strings,
+  .n_next_nodes = UDP_URI_INPUT_N_NEXT,
+  /* edit / add dispositions here */
+  .next_nodes =
+  {
+    [UDP_URI_INPUT_NEXT_DROP] = "error-drop",
+  },
+};
+
+VLIB_REGISTER_NODE (udp6_uri_input_node) =
+{
+  .function = udp6_uri_input_node_fn,
+  .name = "udp6-uri-input",
+  .vector_size = sizeof (u32),
+  .format_trace = format_udp_uri_input_trace,
+  .type = VLIB_NODE_TYPE_INTERNAL,
+  .n_errors = ARRAY_LEN (udp_uri_input_error_strings),
+  .error_strings = udp_uri_input_error_strings,
+  .n_next_nodes = UDP_URI_INPUT_N_NEXT,
+  /* edit / add dispositions here */
+  .next_nodes =
   {
-  [UDP4_URI_INPUT_NEXT_DROP] = "error-drop",}
-,};
+    [UDP_URI_INPUT_NEXT_DROP] = "error-drop",
+  },
+};
+/* *INDENT-ON* */
 
 /*
  * fd.io coding-style-patch-verification: ON
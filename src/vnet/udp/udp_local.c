@@ -546,6 +546,7 @@ udp_unregister_dst_port (vlib_main_t * vm, udp_dst_port_t dst_port, u8 is_ip4)
   n = sparse_vec_validate (rt->next_by_dst_port,
 			   clib_host_to_net_u16 (dst_port));
   n[0] = SPARSE_VEC_INVALID_INDEX;
+  pi->node_index = ~0;
 }
 
 void
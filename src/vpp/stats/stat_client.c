@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vpp/stats/stat_client.h>
+
+stat_client_main_t stat_client_main;
+
+/* Give up after this many torn reads in a row */
+#define STAT_CLIENT_MAX_RETRIES 1000
+
+/*
+ * Anything read outside a consistent epoch may be stale, so check that
+ * a vector lies within the segment before touching its contents.
+ */
+static int
+stat_segment_vec_ok (stat_client_main_t * sm, void *v, uword elt_bytes)
+{
+  uword lo = pointer_to_uword (sm->ssvm.sh);
+  uword hi = lo + sm->ssvm.ssvm_size;
+  uword p = pointer_to_uword (v);
+
+  if (v == 0)
+    return 1;
+  if (p < lo + sizeof (vec_header_t) || p >= hi)
+    return 0;
+  return p + vec_len (v) * elt_bytes <= hi;
+}
+
+int
+stat_segment_connect (char *segment_name)
+{
+  stat_client_main_t *sm = &stat_client_main;
+  ssvm_shared_header_t *shared;
+  int rv;
+
+  memset (sm, 0, sizeof (*sm));
+  sm->ssvm.name = format (0, "%s%c", segment_name ? segment_name :
+			  STAT_SEGMENT_DEFAULT_NAME, 0);
+
+  if ((rv = ssvm_slave_init (&sm->ssvm, 2 /* timeout in seconds */ )))
+    {
+      vec_free (sm->ssvm.name);
+      return rv;
+    }
+
+  shared = sm->ssvm.sh;
+  sm->shared_header = shared->opaque[STAT_SEGMENT_OPAQUE_HEADER];
+  if (sm->shared_header->version != STAT_SEGMENT_VERSION)
+    {
+      clib_warning ("stats segment version %lld, expected %d",
+		    sm->shared_header->version, STAT_SEGMENT_VERSION);
+      stat_segment_disconnect ();
+      return -1;
+    }
+  return 0;
+}
+
+void
+stat_segment_disconnect (void)
+{
+  stat_client_main_t *sm = &stat_client_main;
+
+  if (sm->ssvm.sh)
+    munmap (sm->ssvm.sh, sm->ssvm.ssvm_size);
+  vec_free (sm->ssvm.name);
+  memset (sm, 0, sizeof (*sm));
+}
+
+u64
+stat_segment_epoch (void)
+{
+  stat_client_main_t *sm = &stat_client_main;
+
+  return sm->shared_header->epoch;
+}
+
+static int
+stat_segment_name_matches (char *name, u8 ** patterns)
+{
+  int i;
+
+  if (patterns == 0)
+    return 1;
+
+  for (i = 0; i < vec_len (patterns); i++)
+    if (strstr (name, (char *) patterns[i]))
+      return 1;
+  return 0;
+}
+
+u32 *
+stat_segment_ls (u8 ** patterns)
+{
+  stat_client_main_t *sm = &stat_client_main;
+  stat_segment_shared_header_t *shared_header = sm->shared_header;
+  stat_segment_directory_entry_t *dv;
+  u32 *dir = 0;
+  int retries;
+  u64 epoch;
+  u32 i;
+
+  for (retries = 0; retries < STAT_CLIENT_MAX_RETRIES; retries++)
+    {
+      if (stat_segment_access_start (shared_header, &epoch))
+	break;
+      vec_reset_length (dir);
+
+      dv = shared_header->directory_vector;
+      if (!stat_segment_vec_ok (sm, dv, sizeof (dv[0])))
+	continue;
+
+      for (i = 0; i < vec_len (dv); i++)
+	if (stat_segment_name_matches (dv[i].name, patterns))
+	  vec_add1 (dir, i);
+
+      if (stat_segment_access_end (shared_header, epoch))
+	return dir;
+    }
+
+  vec_free (dir);
+  return 0;
+}
+
+/* Copy a per-thread vector of counter vectors out of the segment */
+static void **
+stat_segment_copy_counters (stat_client_main_t * sm, void **counters,
+			    uword elt_bytes)
+{
+  void **copy = 0;
+  u32 i;
+
+  if (!stat_segment_vec_ok (sm, counters, sizeof (counters[0]))
+      || vec_len (counters) == 0)
+    return 0;
+
+  vec_validate (copy, vec_len (counters) - 1);
+  for (i = 0; i < vec_len (counters); i++)
+    {
+      if (!stat_segment_vec_ok (sm, counters[i], elt_bytes))
+	{
+	  vec_free (copy);
+	  return 0;
+	}
+      copy[i] = _vec_resize (0, vec_len (counters[i]),
+			     vec_len (counters[i]) * elt_bytes, 0, 0);
+      clib_memcpy (copy[i], counters[i], vec_len (counters[i]) * elt_bytes);
+    }
+  return copy;
+}
+
+/* Returns 0 if the entry could not be read consistently */
+static int
+stat_segment_copy_entry (stat_client_main_t * sm,
+			 stat_segment_directory_entry_t * ep,
+			 stat_segment_data_t * r)
+{
+  stat_segment_shared_header_t *shared_header = sm->shared_header;
+  stat_segment_node_stats_t *s;
+  u64 **ev;
+  u32 i;
+
+  r->type = ep->type;
+  switch (ep->type)
+    {
+    case STAT_DIR_TYPE_COUNTER_VECTOR_SIMPLE:
+      r->simple_counter_vec = (counter_t **)
+	stat_segment_copy_counters (sm, ep->data, sizeof (counter_t));
+      return r->simple_counter_vec != 0 || ep->data == 0;
+
+    case STAT_DIR_TYPE_COUNTER_VECTOR_COMBINED:
+      r->combined_counter_vec = (vlib_counter_t **)
+	stat_segment_copy_counters (sm, ep->data, sizeof (vlib_counter_t));
+      return r->combined_counter_vec != 0 || ep->data == 0;
+
+    case STAT_DIR_TYPE_ERROR_INDEX:
+      ev = shared_header->error_vector;
+      if (!stat_segment_vec_ok (sm, ev, sizeof (ev[0])))
+	return 0;
+      r->error_value = 0;
+      for (i = 0; i < vec_len (ev); i++)
+	{
+	  if (!stat_segment_vec_ok (sm, ev[i], sizeof (u64)))
+	    return 0;
+	  if (ep->index < vec_len (ev[i]))
+	    r->error_value += ev[i][ep->index];
+	}
+      return 1;
+
+    case STAT_DIR_TYPE_NODE_INDEX:
+      if (!stat_segment_vec_ok (sm, shared_header->node_stats,
+				sizeof (shared_header->node_stats[0])))
+	return 0;
+      memset (&r->node_stats, 0, sizeof (r->node_stats));
+      for (i = 0; i < vec_len (shared_header->node_stats); i++)
+	{
+	  s = shared_header->node_stats[i];
+	  if (!stat_segment_vec_ok (sm, s, sizeof (s[0])))
+	    return 0;
+	  if (ep->index >= vec_len (s))
+	    continue;
+	  r->node_stats.calls += s[ep->index].calls;
+	  r->node_stats.vectors += s[ep->index].vectors;
+	  r->node_stats.clocks += s[ep->index].clocks;
+	  r->node_stats.suspends += s[ep->index].suspends;
+	}
+      return 1;
+
+    default:
+      return 1;
+    }
+}
+
+stat_segment_data_t *
+stat_segment_dump (u32 * counter_vec)
+{
+  stat_client_main_t *sm = &stat_client_main;
+  stat_segment_shared_header_t *shared_header = sm->shared_header;
+  stat_segment_directory_entry_t *dv;
+  stat_segment_data_t *res = 0, *r;
+  int retries, ok;
+  u64 epoch;
+  u32 i;
+
+  for (retries = 0; retries < STAT_CLIENT_MAX_RETRIES; retries++)
+    {
+      if (stat_segment_access_start (shared_header, &epoch))
+	break;
+      stat_segment_data_free (res);
+      res = 0;
+
+      dv = shared_header->directory_vector;
+      ok = stat_segment_vec_ok (sm, dv, sizeof (dv[0]));
+
+      for (i = 0; ok && i < vec_len (counter_vec); i++)
+	{
+	  /* The directory only grows */
+	  if (counter_vec[i] >= vec_len (dv))
+	    continue;
+	  vec_add2 (res, r, 1);
+	  memset (r, 0, sizeof (*r));
+	  r->name = (char *) format (0, "%s%c", dv[counter_vec[i]].name, 0);
+	  ok = stat_segment_copy_entry (sm, &dv[counter_vec[i]], r);
+	}
+
+      if (ok && stat_segment_access_end (shared_header, epoch))
+	return res;
+    }
+
+  stat_segment_data_free (res);
+  return 0;
+}
+
+void
+stat_segment_data_free (stat_segment_data_t * res)
+{
+  stat_segment_data_t *r;
+  u32 i;
+
+  vec_foreach (r, res)
+  {
+    vec_free (r->name);
+    switch (r->type)
+      {
+      case STAT_DIR_TYPE_COUNTER_VECTOR_SIMPLE:
+	for (i = 0; i < vec_len (r->simple_counter_vec); i++)
+	  vec_free (r->simple_counter_vec[i]);
+	vec_free (r->simple_counter_vec);
+	break;
+      case STAT_DIR_TYPE_COUNTER_VECTOR_COMBINED:
+	for (i = 0; i < vec_len (r->combined_counter_vec); i++)
+	  vec_free (r->combined_counter_vec[i]);
+	vec_free (r->combined_counter_vec);
+	break;
+      default:
+	break;
+      }
+  }
+  vec_free (res);
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
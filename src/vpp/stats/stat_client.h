@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __included_stat_client_h__
+#define __included_stat_client_h__
+
+#include <vpp/stats/stat_segment.h>
+
+/** \file
+
+    Stats segment client library. Maps vpp's stats segment and copies
+    named statistics out of it, without talking to vpp.
+
+    Usage:
+
+        stat_segment_connect (0);
+        dir = stat_segment_ls (patterns);
+        while (...)
+          {
+            res = stat_segment_dump (dir);
+            ...
+            stat_segment_data_free (res);
+          }
+        stat_segment_disconnect ();
+
+    The client must have a clib heap, see clib_mem_init.
+*/
+
+typedef struct
+{
+  char *name;
+  stat_directory_type_t type;
+  union
+  {
+    /** [thread][index] */
+    counter_t **simple_counter_vec;
+    vlib_counter_t **combined_counter_vec;
+    /** summed over threads */
+    u64 error_value;
+    stat_segment_node_stats_t node_stats;
+  };
+} stat_segment_data_t;
+
+typedef struct
+{
+  ssvm_private_t ssvm;
+  stat_segment_shared_header_t *shared_header;
+} stat_client_main_t;
+
+extern stat_client_main_t stat_client_main;
+
+/** Map the stats segment, 0 for the default name. Returns 0 or < 0 */
+int stat_segment_connect (char *segment_name);
+
+void stat_segment_disconnect (void);
+
+/** Directory indices of the entries whose name contains any of the
+    patterns, all entries if patterns is 0 */
+u32 *stat_segment_ls (u8 ** patterns);
+
+/** Copy out the given entries. Returns 0 if vpp kept changing the
+    segment for too long, or left it locked */
+stat_segment_data_t *stat_segment_dump (u32 * counter_vec);
+
+void stat_segment_data_free (stat_segment_data_t * res);
+
+/** Current directory epoch, cheap check for a need to stat_segment_ls */
+u64 stat_segment_epoch (void);
+
+#endif /* __included_stat_client_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
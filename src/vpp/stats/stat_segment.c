@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vpp/stats/stat_segment.h>
+
+typedef struct
+{
+  /** the segment, zero heap if disabled */
+  ssvm_private_t ssvm;
+  void *heap;
+  stat_segment_shared_header_t *shared_header;
+
+  /** directory index by name, lives in the segment heap */
+  uword *directory_index_by_name;
+
+  /** recursive writer lock, also bumps the shared epoch */
+  volatile u32 lock;
+  u32 lock_owner;
+  u32 lock_depth;
+
+  /** nodes with a directory entry */
+  u32 n_node_entries;
+
+  /** configuration */
+  u8 *name;
+  uword size;
+  u64 base_va;
+  f64 update_interval;
+  int disabled;
+} stat_segment_main_t;
+
+stat_segment_main_t stat_segment_main;
+
+static void
+stat_segment_lock (stat_segment_main_t * sm)
+{
+  u32 me = os_get_cpu_number () + 1;
+
+  if (sm->lock_owner == me)
+    {
+      sm->lock_depth++;
+      return;
+    }
+
+  while (__sync_lock_test_and_set (&sm->lock, 1))
+    ;
+
+  sm->lock_owner = me;
+  sm->lock_depth = 1;
+
+  /* Odd epoch: clients retry whatever they read from now on */
+  sm->shared_header->epoch++;
+  CLIB_MEMORY_BARRIER ();
+}
+
+static void
+stat_segment_unlock (stat_segment_main_t * sm)
+{
+  if (--sm->lock_depth > 0)
+    return;
+
+  CLIB_MEMORY_BARRIER ();
+  sm->shared_header->epoch++;
+  sm->lock_owner = 0;
+  CLIB_MEMORY_BARRIER ();
+  sm->lock = 0;
+}
+
+/* Find or add a named entry, with the lock held and the segment heap set */
+static stat_segment_directory_entry_t *
+stat_segment_directory_entry (stat_segment_main_t * sm, char *name)
+{
+  stat_segment_shared_header_t *shared_header = sm->shared_header;
+  stat_segment_directory_entry_t *ep;
+  uword *p;
+
+  p = hash_get_mem (sm->directory_index_by_name, name);
+  if (p)
+    return vec_elt_at_index (shared_header->directory_vector, p[0]);
+
+  vec_add2 (shared_header->directory_vector, ep, 1);
+  strncpy (ep->name, name, sizeof (ep->name) - 1);
+  hash_set_mem (sm->directory_index_by_name,
+		format (0, "%s%c", name, 0),
+		ep - shared_header->directory_vector);
+  return ep;
+}
+
+void *
+vlib_stats_push_heap (void)
+{
+  stat_segment_main_t *sm = &stat_segment_main;
+
+  if (sm->heap == 0)
+    return 0;
+
+  stat_segment_lock (sm);
+  return clib_mem_set_heap (sm->heap);
+}
+
+static void
+stat_segment_pop_heap (stat_segment_main_t * sm, void *oldheap)
+{
+  clib_mem_set_heap (oldheap);
+  stat_segment_unlock (sm);
+}
+
+void
+vlib_stats_pop_heap (void *cm_arg, void *oldheap, stat_directory_type_t type)
+{
+  stat_segment_main_t *sm = &stat_segment_main;
+  stat_segment_directory_entry_t *ep;
+  vlib_simple_counter_main_t *scm;
+  vlib_combined_counter_main_t *ccm;
+
+  if (sm->heap == 0)
+    return;
+
+  switch (type)
+    {
+    case STAT_DIR_TYPE_COUNTER_VECTOR_SIMPLE:
+      scm = cm_arg;
+      ep = stat_segment_directory_entry (sm, scm->stat_segment_name);
+      ep->data = scm->counters;
+      break;
+
+    case STAT_DIR_TYPE_COUNTER_VECTOR_COMBINED:
+      ccm = cm_arg;
+      ep = stat_segment_directory_entry (sm, ccm->stat_segment_name);
+      ep->data = ccm->counters;
+      break;
+
+    default:
+      ASSERT (0);
+      stat_segment_pop_heap (sm, oldheap);
+      return;
+    }
+  ep->type = type;
+
+  stat_segment_pop_heap (sm, oldheap);
+}
+
+void
+vlib_stats_pop_heap2 (u64 * error_vector, u32 thread_index, void *oldheap)
+{
+  stat_segment_main_t *sm = &stat_segment_main;
+  stat_segment_shared_header_t *shared_header = sm->shared_header;
+
+  if (sm->heap == 0)
+    return;
+
+  vec_validate (shared_header->error_vector, thread_index);
+  shared_header->error_vector[thread_index] = error_vector;
+
+  stat_segment_pop_heap (sm, oldheap);
+}
+
+void
+vlib_stats_register_error_index (u8 * name, u64 index)
+{
+  stat_segment_main_t *sm = &stat_segment_main;
+  stat_segment_directory_entry_t *ep;
+  void *oldheap;
+
+  if (sm->heap == 0)
+    return;
+
+  oldheap = vlib_stats_push_heap ();
+  ep = stat_segment_directory_entry (sm, (char *) name);
+  ep->type = STAT_DIR_TYPE_ERROR_INDEX;
+  ep->index = index;
+  stat_segment_pop_heap (sm, oldheap);
+}
+
+/*
+ * Node runtime statistics are kept in the per-thread node runtimes and
+ * only folded into the nodes under the barrier. Copy the current sums
+ * into the segment; like the counters themselves, they are read racily.
+ */
+static void
+stat_segment_update_node_stats (vlib_main_t * vm, stat_segment_main_t * sm)
+{
+  stat_segment_shared_header_t *shared_header = sm->shared_header;
+  u32 n_threads = vec_len (vlib_mains) ? vec_len (vlib_mains) : 1;
+  u32 n_nodes = vec_len (vm->node_main.nodes);
+  stat_segment_node_stats_t *s;
+  vlib_node_runtime_t *rt;
+  vlib_main_t *stat_vm;
+  vlib_process_t *p;
+  vlib_node_t *n;
+  u32 i, j;
+
+  if (n_nodes > sm->n_node_entries
+      || vec_len (shared_header->node_stats) < n_threads)
+    {
+      void *oldheap = vlib_stats_push_heap ();
+      stat_segment_directory_entry_t *ep;
+      u8 *name;
+
+      vec_validate (shared_header->node_stats, n_threads - 1);
+      for (j = 0; j < n_threads; j++)
+	vec_validate (shared_header->node_stats[j], n_nodes - 1);
+
+      for (i = sm->n_node_entries; i < n_nodes; i++)
+	{
+	  n = vlib_get_node (vm, i);
+	  name = format (0, "/sys/node/%v%c", n->name, 0);
+	  ep = stat_segment_directory_entry (sm, (char *) name);
+	  ep->type = STAT_DIR_TYPE_NODE_INDEX;
+	  ep->index = i;
+	  vec_free (name);
+	}
+      sm->n_node_entries = n_nodes;
+      stat_segment_pop_heap (sm, oldheap);
+    }
+
+  for (j = 0; j < n_threads; j++)
+    {
+      stat_vm = vec_len (vlib_mains) ? vlib_mains[j] : vm;
+      if (!stat_vm)
+	continue;
+
+      for (i = 0; i < vec_len (stat_vm->node_main.nodes) && i < n_nodes; i++)
+	{
+	  n = stat_vm->node_main.nodes[i];
+	  s = vec_elt_at_index (shared_header->node_stats[j], i);
+
+	  if (n->type == VLIB_NODE_TYPE_PROCESS)
+	    {
+	      /* Processes only run on the main thread */
+	      if (j != 0)
+		continue;
+	      p = vlib_get_process_from_node (stat_vm, n);
+	      rt = &p->node_runtime;
+	      s->suspends = n->stats_total.suspends + p->n_suspends;
+	    }
+	  else
+	    rt = vec_elt_at_index (stat_vm->node_main.nodes_by_type[n->type],
+				   n->runtime_index);
+
+	  s->calls = n->stats_total.calls + rt->calls_since_last_overflow;
+	  s->vectors = n->stats_total.vectors
+	    + rt->vectors_since_last_overflow;
+	  s->clocks = n->stats_total.clocks + rt->clocks_since_last_overflow;
+	}
+    }
+
+  shared_header->node_stats_update_time = vlib_time_now (vm);
+}
+
+static uword
+stat_segment_collector_process (vlib_main_t * vm, vlib_node_runtime_t * rt,
+				vlib_frame_t * f)
+{
+  stat_segment_main_t *sm = &stat_segment_main;
+
+  if (sm->heap == 0)
+    return 0;
+
+  while (1)
+    {
+      stat_segment_update_node_stats (vm, sm);
+      vlib_process_suspend (vm, sm->update_interval);
+    }
+  return 0;			/* not so much */
+}
+
+/* *INDENT-OFF* */
+VLIB_REGISTER_NODE (stat_segment_collector, static) =
+{
+  .function = stat_segment_collector_process,
+  .name = "statseg-collector-process",
+  .type = VLIB_NODE_TYPE_PROCESS,
+};
+/* *INDENT-ON* */
+
+static clib_error_t *
+stat_segment_create (stat_segment_main_t * sm)
+{
+  ssvm_shared_header_t *shared;
+  stat_segment_shared_header_t *shared_header;
+  void *oldheap;
+  int rv;
+
+  sm->ssvm.ssvm_size = sm->size;
+  sm->ssvm.name = sm->name;
+  /* Clients follow vpp's pointers: never let the kernel pick the base */
+  sm->ssvm.requested_va = sm->base_va;
+
+  if ((rv = ssvm_master_init (&sm->ssvm, 0 /* master index */ )))
+    return clib_error_return (0, "stats segment create failed (%d)", rv);
+
+  shared = sm->ssvm.sh;
+  oldheap = ssvm_push_heap (shared);
+
+  shared_header = clib_mem_alloc_aligned (sizeof (*shared_header),
+					  CLIB_CACHE_LINE_BYTES);
+  /* Initialise through the typed header: gcc can't see the size of the
+     block behind clib_mem_alloc_aligned and flags a raw memset */
+  *shared_header = (stat_segment_shared_header_t)
+  {
+    .version = STAT_SEGMENT_VERSION,
+  };
+  sm->directory_index_by_name = hash_create_string (0, sizeof (uword));
+  shared->opaque[STAT_SEGMENT_OPAQUE_HEADER] = shared_header;
+
+  ssvm_pop_heap (oldheap);
+
+  sm->shared_header = shared_header;
+  sm->heap = shared->heap;
+  CLIB_MEMORY_BARRIER ();
+  shared->ready = 1;
+  return 0;
+}
+
+/*
+ * An early config, so that the segment exists before the first counter
+ * is validated: a vector allocated outside the segment can not be moved
+ * into it later.
+ */
+static clib_error_t *
+stat_segment_config (vlib_main_t * vm, unformat_input_t * input)
+{
+  stat_segment_main_t *sm = &stat_segment_main;
+  u8 *name = 0;
+
+  sm->size = STAT_SEGMENT_DEFAULT_SIZE;
+  sm->base_va = STAT_SEGMENT_DEFAULT_BASE_VA;
+  sm->update_interval = 1.0;
+
+  while (unformat_check_input (input) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (input, "size %U", unformat_memory_size, &sm->size))
+	;
+      else if (unformat (input, "name %s", &name))
+	;
+      else if (unformat (input, "base-va %llx", &sm->base_va))
+	;
+      else if (unformat (input, "update-interval %f", &sm->update_interval))
+	;
+      else if (unformat (input, "disable"))
+	sm->disabled = 1;
+      else
+	return clib_error_return (0, "unknown input `%U'",
+				  format_unformat_error, input);
+    }
+
+  if (sm->disabled)
+    return 0;
+
+  if (sm->update_interval <= 0.0)
+    return clib_error_return (0, "update-interval must be positive");
+
+  if (sm->base_va == 0 || (sm->base_va & (MMAP_PAGESIZE - 1)))
+    return clib_error_return (0, "base-va must be a non-zero page address");
+
+  sm->name = format (0, "%s%c", name ? (char *) name :
+		     STAT_SEGMENT_DEFAULT_NAME, 0);
+  vec_free (name);
+
+  return stat_segment_create (sm);
+}
+
+VLIB_EARLY_CONFIG_FUNCTION (stat_segment_config, "statseg");
+
+static clib_error_t *
+show_stat_segment_command_fn (vlib_main_t * vm,
+			      unformat_input_t * input,
+			      vlib_cli_command_t * cmd)
+{
+  stat_segment_main_t *sm = &stat_segment_main;
+  stat_segment_directory_entry_t *ep;
+  int verbose = 0;
+
+  if (sm->heap == 0)
+    {
+      vlib_cli_output (vm, "stats segment disabled");
+      return 0;
+    }
+
+  if (unformat (input, "verbose"))
+    verbose = 1;
+
+  vlib_cli_output (vm, "segment %s at 0x%llx, %U, epoch %lld, %d entries",
+		   sm->name, pointer_to_uword (sm->ssvm.sh),
+		   format_memory_size, sm->size,
+		   sm->shared_header->epoch,
+		   vec_len (sm->shared_header->directory_vector));
+
+  if (verbose)
+    vlib_cli_output (vm, "%U", format_mheap, sm->heap, 0 /* verbose */ );
+
+  vec_foreach (ep, sm->shared_header->directory_vector)
+    vlib_cli_output (vm, "%-60s %d", ep->name, ep->type);
+
+  return 0;
+}
+
+/* *INDENT-OFF* */
+VLIB_CLI_COMMAND (show_stat_segment_command, static) =
+{
+  .path = "show statistics segment",
+  .short_help = "show statistics segment [verbose]",
+  .function = show_stat_segment_command_fn,
+};
+/* *INDENT-ON* */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
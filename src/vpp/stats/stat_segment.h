@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __included_stat_segment_h__
+#define __included_stat_segment_h__
+
+#include <vlib/vlib.h>
+#include <svm/ssvm.h>
+
+/** \file
+
+    Shared-memory stats segment layout, common to vpp and its clients.
+
+    vpp allocates the counter vectors of every counter collection with a
+    stat_segment_name, and the per-thread error counter vectors, in an
+    ssvm segment. Clients map the segment at the same address, so the
+    vectors are read in place: scraping costs the data plane nothing.
+
+    A directory of named entries describes what is in the segment.
+    Allocation and directory changes are bracketed by the epoch in the
+    shared header, a sequence lock: it is odd while vpp is changing
+    things. A client notes the (even) epoch, copies what it wants, and
+    retries if the epoch moved meanwhile. Counter values themselves are
+    single-writer u64s and are read without any synchronization.
+
+    Node runtime statistics live in the per-thread node runtimes, which
+    are not segment memory. vpp's main thread copies them into the
+    segment every update interval.
+
+    Everything in the segment, the directory included, is linked by
+    vpp's pointers, so vpp maps it at a fixed base address, clear of the
+    fifo segments, and clients map it at the same address.
+*/
+
+#define STAT_SEGMENT_DEFAULT_NAME "vpp-stats"
+#define STAT_SEGMENT_DEFAULT_SIZE (32 << 20)
+#define STAT_SEGMENT_DEFAULT_BASE_VA 0x180000000ULL
+#define STAT_SEGMENT_VERSION 1
+
+/** ssvm opaque slot holding the shared header */
+#define STAT_SEGMENT_OPAQUE_HEADER 0
+
+typedef struct
+{
+  stat_directory_type_t type;
+  union
+  {
+    /** error or node index */
+    u64 index;
+    /** counter collection's per-thread vector of counter vectors */
+    void *data;
+  };
+  char name[128];
+} stat_segment_directory_entry_t;
+
+typedef struct
+{
+  u64 calls;
+  u64 vectors;
+  u64 clocks;
+  u64 suspends;
+} stat_segment_node_stats_t;
+
+typedef struct
+{
+  /** layout version, STAT_SEGMENT_VERSION */
+  u64 version;
+
+  /** sequence lock, odd while vpp is changing the segment */
+  volatile u64 epoch;
+
+  /** named entries */
+  stat_segment_directory_entry_t *directory_vector;
+
+  /** per-thread error counter vectors, by error index */
+  u64 **error_vector;
+
+  /** per-thread node runtime statistics, by node index */
+  stat_segment_node_stats_t **node_stats;
+
+  /** vlib time of the last node statistics update */
+  f64 node_stats_update_time;
+} stat_segment_shared_header_t;
+
+/** Longest a client waits for vpp to finish changing the segment */
+#define STAT_SEGMENT_ACCESS_TIMEOUT 1.0
+
+/**
+ * Client side of the sequence lock: sets the epoch to check against.
+ * Returns 0, or -1 if the epoch stayed odd for STAT_SEGMENT_ACCESS_TIMEOUT
+ * seconds, e.g. because vpp died half way through an update.
+ */
+always_inline int
+stat_segment_access_start (stat_segment_shared_header_t * shared_header,
+			   u64 * epochp)
+{
+  f64 deadline = 0, now;
+  u64 epoch;
+
+  while ((epoch = shared_header->epoch) & 1)
+    {
+      now = unix_time_now ();
+      if (deadline == 0)
+	deadline = now + STAT_SEGMENT_ACCESS_TIMEOUT;
+      else if (now > deadline)
+	return -1;
+    }
+  CLIB_MEMORY_BARRIER ();
+  *epochp = epoch;
+  return 0;
+}
+
+/** Returns 1 if everything read since the matching start is consistent */
+always_inline int
+stat_segment_access_end (stat_segment_shared_header_t * shared_header,
+			 u64 epoch)
+{
+  CLIB_MEMORY_BARRIER ();
+  return shared_header->epoch == epoch;
+}
+
+#endif /* __included_stat_segment_h__ */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -145,12 +145,12 @@ do_simple_interface_counters (stats_main_t * sm)
   vec_foreach (cm, im->sw_if_counters)
   {
 
-    for (i = 0; i < vec_len (cm->maxi); i++)
+    for (i = 0; i < vlib_counter_len (cm); i++)
       {
 	if (mp == 0)
 	  {
 	    items_this_message = clib_min (SIMPLE_COUNTER_BATCH_SIZE,
-					   vec_len (cm->maxi) - i);
+					   vlib_counter_len (cm) - i);
 
 	    mp = vl_msg_api_alloc_as_if_client
 	      (sizeof (*mp) + items_this_message * sizeof (v));
@@ -196,12 +196,12 @@ do_combined_interface_counters (stats_main_t * sm)
   vec_foreach (cm, im->combined_sw_if_counters)
   {
 
-    for (i = 0; i < vec_len (cm->maxi); i++)
+    for (i = 0; i < vlib_counter_len (cm); i++)
       {
 	if (mp == 0)
 	  {
 	    items_this_message = clib_min (COMBINED_COUNTER_BATCH_SIZE,
-					   vec_len (cm->maxi) - i);
+					   vlib_counter_len (cm) - i);
 
 	    mp = vl_msg_api_alloc_as_if_client
 	      (sizeof (*mp) + items_this_message * sizeof (v));
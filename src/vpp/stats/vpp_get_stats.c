@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+#include <vpp/stats/stat_client.h>
+
+typedef enum
+{
+  STAT_CLIENT_CMD_LS,
+  STAT_CLIENT_CMD_DUMP,
+  STAT_CLIENT_CMD_POLL,
+} stat_client_cmd_t;
+
+static void
+print_stat_entry (stat_segment_data_t * r)
+{
+  int i, j;
+
+  switch (r->type)
+    {
+    case STAT_DIR_TYPE_COUNTER_VECTOR_SIMPLE:
+      for (i = 0; i < vec_len (r->simple_counter_vec); i++)
+	for (j = 0; j < vec_len (r->simple_counter_vec[i]); j++)
+	  fformat (stdout, "[%d @ %d]: %llu packets %s\n", j, i,
+		   r->simple_counter_vec[i][j], r->name);
+      break;
+
+    case STAT_DIR_TYPE_COUNTER_VECTOR_COMBINED:
+      for (i = 0; i < vec_len (r->combined_counter_vec); i++)
+	for (j = 0; j < vec_len (r->combined_counter_vec[i]); j++)
+	  fformat (stdout, "[%d @ %d]: %llu packets, %llu bytes %s\n", j, i,
+		   r->combined_counter_vec[i][j].packets,
+		   r->combined_counter_vec[i][j].bytes, r->name);
+      break;
+
+    case STAT_DIR_TYPE_ERROR_INDEX:
+      fformat (stdout, "%llu %s\n", r->error_value, r->name);
+      break;
+
+    case STAT_DIR_TYPE_NODE_INDEX:
+      fformat (stdout, "%llu calls, %llu vectors, %llu clocks, "
+	       "%llu suspends %s\n", r->node_stats.calls,
+	       r->node_stats.vectors, r->node_stats.clocks,
+	       r->node_stats.suspends, r->name);
+      break;
+
+    default:
+      fformat (stderr, "unknown stat type %d %s\n", r->type, r->name);
+      break;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  unformat_input_t _argv, *a = &_argv;
+  u8 *stat_segment_name = 0, *pattern = 0, **patterns = 0;
+  stat_client_cmd_t cmd = STAT_CLIENT_CMD_DUMP;
+  stat_segment_data_t *res;
+  u32 *dir = 0;
+  u64 epoch;
+  int i, rv;
+
+  clib_mem_init (0, 64 << 20);
+
+  unformat_init_command_line (a, argv);
+  while (unformat_check_input (a) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (a, "segment-name %s", &stat_segment_name))
+	;
+      else if (unformat (a, "ls"))
+	cmd = STAT_CLIENT_CMD_LS;
+      else if (unformat (a, "dump"))
+	cmd = STAT_CLIENT_CMD_DUMP;
+      else if (unformat (a, "poll"))
+	cmd = STAT_CLIENT_CMD_POLL;
+      else if (unformat (a, "%s", &pattern))
+	{
+	  /* patterns are matched with strstr */
+	  vec_add1 (pattern, 0);
+	  vec_add1 (patterns, pattern);
+	}
+      else
+	{
+	  fformat (stderr, "usage: vpp_get_stats [segment-name <name>] "
+		   "[ls | dump | poll] <patterns> ...\n");
+	  exit (1);
+	}
+    }
+
+  if (stat_segment_name)
+    vec_add1 (stat_segment_name, 0);
+
+  rv = stat_segment_connect ((char *) stat_segment_name);
+  if (rv)
+    {
+      fformat (stderr, "couldn't map stats segment %s, is vpp running?\n",
+	       stat_segment_name ? (char *) stat_segment_name :
+	       STAT_SEGMENT_DEFAULT_NAME);
+      exit (1);
+    }
+
+  dir = stat_segment_ls (patterns);
+  epoch = stat_segment_epoch ();
+
+  switch (cmd)
+    {
+    case STAT_CLIENT_CMD_LS:
+      {
+	stat_segment_directory_entry_t *dv =
+	  stat_client_main.shared_header->directory_vector;
+
+	/* A name change would bump the epoch, good enough for a listing */
+	for (i = 0; i < vec_len (dir); i++)
+	  fformat (stdout, "%s\n", dv[dir[i]].name);
+      }
+      break;
+
+    case STAT_CLIENT_CMD_DUMP:
+      res = stat_segment_dump (dir);
+      for (i = 0; i < vec_len (res); i++)
+	print_stat_entry (&res[i]);
+      stat_segment_data_free (res);
+      break;
+
+    case STAT_CLIENT_CMD_POLL:
+      while (1)
+	{
+	  /* New counters or nodes since the last ls */
+	  if (stat_segment_epoch () != epoch)
+	    {
+	      vec_free (dir);
+	      dir = stat_segment_ls (patterns);
+	      epoch = stat_segment_epoch ();
+	    }
+	  res = stat_segment_dump (dir);
+	  if (res == 0 && vec_len (dir))
+	    {
+	      fformat (stderr, "stats segment busy, retrying\n");
+	      sleep (1);
+	      continue;
+	    }
+	  for (i = 0; i < vec_len (res); i++)
+	    print_stat_entry (&res[i]);
+	  stat_segment_data_free (res);
+	  fformat (stdout, "\n");
+	  sleep (1);
+	}
+      break;
+    }
+
+  vec_free (dir);
+  stat_segment_disconnect ();
+  exit (0);
+}
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
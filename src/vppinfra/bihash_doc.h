@@ -58,8 +58,10 @@ typedef struct clib_bihash_value
     struct
     {
       u32 offset;  /**< backing page offset in the clib memory heap */
-      u8 pad[3];   /**< log2 (size of the packing page block) */
-      u8 log2_pages;
+      u8 linear_search;	/**< bucket has unresolvable collisions */
+      u8 lock;	   /**< writer lock, readers never look at it */
+      u8 spills;   /**< home-page overflows, saturates at 255 */
+      u8 log2_pages; /**< log2 (size of the packing page block) */
     };
     u64 as_u64;
   };
@@ -69,12 +71,13 @@ typedef struct clib_bihash_value
 typedef struct
 {
   clib_bihash_bucket_t *buckets;  /**< Hash bucket vector, power-of-two in size */
-  volatile u32 *writer_lock;  /**< Writer lock, in its own cache line */
+  volatile u32 *alloc_lock;  /**< Page allocator lock, in its own cache line */
     BVT (clib_bihash_value) ** working_copies;
 					    /**< Working copies (various sizes), to avoid locking against readers */
-  clib_bihash_bucket_t saved_bucket; /**< Saved bucket pointer */
   u32 nbuckets;			     /**< Number of hash buckets */
   u32 log2_nbuckets;		     /**< lg(nbuckets) */
+  u32 linear_buckets;		     /**< Number of linear search buckets */
+  u64 spills;			     /**< Total home-page overflows */
   u8 *name;			     /**< hash table name */
     BVT (clib_bihash_value) ** freelists;
 				      /**< power of two freelist vector */
@@ -113,6 +116,8 @@ void clib_bihash_free (clib_bihash * h);
     @returns 0 on success, < 0 on error
     @note This function will replace an existing (key,value) pair if the
     new key matches an existing key
+    @note Writers lock only the target bucket, so threads updating
+    different buckets run in parallel. Readers never lock.
 */
 int clib_bihash_add_del (clib_bihash * h, clib_bihash_kv * add_v, int is_add);
 
@@ -30,8 +30,16 @@ void BV (clib_bihash_init)
 
   oldheap = clib_mem_set_heap (h->mheap);
   vec_validate_aligned (h->buckets, nbuckets - 1, CLIB_CACHE_LINE_BYTES);
-  h->writer_lock = clib_mem_alloc_aligned (CLIB_CACHE_LINE_BYTES,
-					   CLIB_CACHE_LINE_BYTES);
+  h->alloc_lock = clib_mem_alloc_aligned (CLIB_CACHE_LINE_BYTES,
+					  CLIB_CACHE_LINE_BYTES);
+  h->alloc_lock[0] = 0;
+
+  /*
+   * Writers index this without holding any lock, so it must never
+   * be resized once the table is live.
+   */
+  vec_validate_aligned (h->working_copies, CLIB_MAX_MHEAPS - 1,
+			CLIB_CACHE_LINE_BYTES);
 
   clib_mem_set_heap (oldheap);
 }
@@ -42,6 +50,20 @@ void BV (clib_bihash_free) (BVT (clib_bihash) * h)
   memset (h, 0, sizeof (*h));
 }
 
+static inline void
+BV (clib_bihash_alloc_lock) (BVT (clib_bihash) * h)
+{
+  while (__sync_lock_test_and_set (h->alloc_lock, 1))
+    ;
+}
+
+static inline void
+BV (clib_bihash_alloc_unlock) (BVT (clib_bihash) * h)
+{
+  CLIB_MEMORY_BARRIER ();
+  h->alloc_lock[0] = 0;
+}
+
 static
 BVT (clib_bihash_value) *
 BV (value_alloc) (BVT (clib_bihash) * h, u32 log2_pages)
@@ -49,7 +71,7 @@ BV (value_alloc) (BVT (clib_bihash) * h, u32 log2_pages)
   BVT (clib_bihash_value) * rv = 0;
   void *oldheap;
 
-  ASSERT (h->writer_lock[0]);
+  BV (clib_bihash_alloc_lock) (h);
   if (log2_pages >= vec_len (h->freelists) || h->freelists[log2_pages] == 0)
     {
       oldheap = clib_mem_set_heap (h->mheap);
@@ -63,6 +85,7 @@ BV (value_alloc) (BVT (clib_bihash) * h, u32 log2_pages)
   h->freelists[log2_pages] = rv->next_free;
 
 initialize:
+  BV (clib_bihash_alloc_unlock) (h);
   ASSERT (rv);
   ASSERT (vec_len (rv) == (1 << log2_pages));
   /*
@@ -79,18 +102,21 @@ BV (value_free) (BVT (clib_bihash) * h, BVT (clib_bihash_value) * v)
 {
   u32 log2_pages;
 
-  ASSERT (h->writer_lock[0]);
-
   log2_pages = min_log2 (vec_len (v));
 
+  BV (clib_bihash_alloc_lock) (h);
+
   ASSERT (vec_len (h->freelists) > log2_pages);
 
   v->next_free = h->freelists[log2_pages];
   h->freelists[log2_pages] = v;
+
+  BV (clib_bihash_alloc_unlock) (h);
 }
 
 static inline void
-BV (make_working_copy) (BVT (clib_bihash) * h, clib_bihash_bucket_t * b)
+BV (make_working_copy) (BVT (clib_bihash) * h, clib_bihash_bucket_t * b,
+			clib_bihash_bucket_t * saved_bucket)
 {
   BVT (clib_bihash_value) * v;
   clib_bihash_bucket_t working_bucket __attribute__ ((aligned (8)));
@@ -98,12 +124,8 @@ BV (make_working_copy) (BVT (clib_bihash) * h, clib_bihash_bucket_t * b)
   BVT (clib_bihash_value) * working_copy;
   u32 cpu_number = os_get_cpu_number ();
 
-  if (cpu_number >= vec_len (h->working_copies))
-    {
-      oldheap = clib_mem_set_heap (h->mheap);
-      vec_validate (h->working_copies, cpu_number);
-      clib_mem_set_heap (oldheap);
-    }
+  ASSERT (cpu_number < vec_len (h->working_copies));
+  ASSERT (b->lock);
 
   /*
    * working_copies are per-cpu so that near-simultaneous
@@ -112,18 +134,20 @@ BV (make_working_copy) (BVT (clib_bihash) * h, clib_bihash_bucket_t * b)
    */
   working_copy = h->working_copies[cpu_number];
 
-  h->saved_bucket.as_u64 = b->as_u64;
-  oldheap = clib_mem_set_heap (h->mheap);
+  saved_bucket->as_u64 = b->as_u64;
 
   if ((1 << b->log2_pages) > vec_len (working_copy))
     {
+      BV (clib_bihash_alloc_lock) (h);
+      oldheap = clib_mem_set_heap (h->mheap);
       vec_validate_aligned (working_copy, (1 << b->log2_pages) - 1,
 			    sizeof (u64));
+      clib_mem_set_heap (oldheap);
+      BV (clib_bihash_alloc_unlock) (h);
       h->working_copies[cpu_number] = working_copy;
     }
 
   _vec_len (working_copy) = 1 << b->log2_pages;
-  clib_mem_set_heap (oldheap);
 
   v = BV (clib_bihash_get_value) (h, b->offset);
 
@@ -227,7 +251,7 @@ int BV (clib_bihash_add_del)
   (BVT (clib_bihash) * h, BVT (clib_bihash_kv) * add_v, int is_add)
 {
   u32 bucket_index;
-  clib_bihash_bucket_t *b, tmp_b;
+  clib_bihash_bucket_t *b, tmp_b, saved_bucket;
   BVT (clib_bihash_value) * v, *new_v, *save_new_v, *working_copy;
   int rv = 0;
   int i, limit;
@@ -244,8 +268,7 @@ int BV (clib_bihash_add_del)
 
   hash >>= h->log2_nbuckets;
 
-  while (__sync_lock_test_and_set (h->writer_lock, 1))
-    ;
+  clib_bihash_lock_bucket (b);
 
   /* First elt in the bucket? */
   if (b->offset == 0)
@@ -260,14 +283,16 @@ int BV (clib_bihash_add_del)
       *v->kvp = *add_v;
       tmp_b.as_u64 = 0;
       tmp_b.offset = BV (clib_bihash_get_offset) (h, v);
+      tmp_b.lock = 1;
 
+      CLIB_MEMORY_BARRIER ();
       b->as_u64 = tmp_b.as_u64;
       goto unlock;
     }
 
-  BV (make_working_copy) (h, b);
+  BV (make_working_copy) (h, b, &saved_bucket);
 
-  v = BV (clib_bihash_get_value) (h, h->saved_bucket.offset);
+  v = BV (clib_bihash_get_value) (h, saved_bucket.offset);
 
   limit = BIHASH_KVP_PER_PAGE;
   v += (b->linear_search == 0) ? hash & ((1 << b->log2_pages) - 1) : 0;
@@ -287,7 +312,7 @@ int BV (clib_bihash_add_del)
 	      clib_memcpy (&(v->kvp[i]), add_v, sizeof (*add_v));
 	      CLIB_MEMORY_BARRIER ();
 	      /* Restore the previous (k,v) pairs */
-	      b->as_u64 = h->saved_bucket.as_u64;
+	      b->as_u64 = saved_bucket.as_u64;
 	      goto unlock;
 	    }
 	}
@@ -297,7 +322,7 @@ int BV (clib_bihash_add_del)
 	    {
 	      clib_memcpy (&(v->kvp[i]), add_v, sizeof (*add_v));
 	      CLIB_MEMORY_BARRIER ();
-	      b->as_u64 = h->saved_bucket.as_u64;
+	      b->as_u64 = saved_bucket.as_u64;
 	      goto unlock;
 	    }
 	}
@@ -311,16 +336,25 @@ int BV (clib_bihash_add_del)
 	    {
 	      memset (&(v->kvp[i]), 0xff, sizeof (*(add_v)));
 	      CLIB_MEMORY_BARRIER ();
-	      b->as_u64 = h->saved_bucket.as_u64;
+	      b->as_u64 = saved_bucket.as_u64;
 	      goto unlock;
 	    }
 	}
       rv = -3;
-      b->as_u64 = h->saved_bucket.as_u64;
+      b->as_u64 = saved_bucket.as_u64;
       goto unlock;
     }
 
-  new_log2_pages = h->saved_bucket.log2_pages + 1;
+  /*
+   * The home page is full: this add spills the bucket into a split.
+   * Count it against the bucket (saturating) and the table.
+   */
+  tmp_b.as_u64 = saved_bucket.as_u64;
+  if (tmp_b.spills < 0xff)
+    tmp_b.spills++;
+  __sync_fetch_and_add (&h->spills, 1);
+
+  new_log2_pages = saved_bucket.log2_pages + 1;
   mark_bucket_linear = 0;
 
   working_copy = h->working_copies[cpu_number];
@@ -377,19 +411,19 @@ int BV (clib_bihash_add_del)
 expand_ok:
   /* Keep track of the number of linear-scan buckets */
   if (tmp_b.linear_search ^ mark_bucket_linear)
-    h->linear_buckets += (mark_bucket_linear == 1) ? 1 : -1;
+    __sync_fetch_and_add (&h->linear_buckets,
+			  (mark_bucket_linear == 1) ? 1 : -1);
 
   tmp_b.log2_pages = new_log2_pages;
   tmp_b.offset = BV (clib_bihash_get_offset) (h, save_new_v);
   tmp_b.linear_search = mark_bucket_linear;
   CLIB_MEMORY_BARRIER ();
   b->as_u64 = tmp_b.as_u64;
-  v = BV (clib_bihash_get_value) (h, h->saved_bucket.offset);
+  v = BV (clib_bihash_get_value) (h, saved_bucket.offset);
   BV (value_free) (h, v);
 
 unlock:
-  CLIB_MEMORY_BARRIER ();
-  h->writer_lock[0] = 0;
+  clib_bihash_unlock_bucket (b);
   return rv;
 }
 
@@ -440,6 +474,7 @@ u8 *BV (format_bihash) (u8 * s, va_list * args)
   BVT (clib_bihash_value) * v;
   int i, j, k;
   u64 active_elements = 0;
+  u32 spilled_buckets = 0, max_spills = 0;
 
   s = format (s, "Hash table %s\n", h->name ? h->name : (u8 *) "(unnamed)");
 
@@ -453,10 +488,17 @@ u8 *BV (format_bihash) (u8 * s, va_list * args)
 	  continue;
 	}
 
+      if (b->spills)
+	{
+	  spilled_buckets++;
+	  max_spills = clib_max (max_spills, b->spills);
+	}
+
       if (verbose)
 	{
-	  s = format (s, "[%d]: heap offset %d, len %d, linear %d\n", i,
-		      b->offset, (1 << b->log2_pages), b->linear_search);
+	  s = format (s, "[%d]: heap offset %d, len %d, linear %d, "
+		      "spills %d\n", i, b->offset, (1 << b->log2_pages),
+		      b->linear_search, b->spills);
 	}
 
       v = BV (clib_bihash_get_value) (h, b->offset);
@@ -486,6 +528,8 @@ u8 *BV (format_bihash) (u8 * s, va_list * args)
   s = format (s, "    %lld active elements\n", active_elements);
   s = format (s, "    %d free lists\n", vec_len (h->freelists));
   s = format (s, "    %d linear search buckets\n", h->linear_buckets);
+  s = format (s, "    %lld spills, %d buckets spilled, max %d per bucket\n",
+	      h->spills, spilled_buckets, max_spills);
 
   return s;
 }
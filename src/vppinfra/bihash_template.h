@@ -62,26 +62,57 @@ typedef struct
     {
       u32 offset;
       u8 linear_search;
-      u8 pad[2];
+      u8 lock;
+      u8 spills;
       u8 log2_pages;
     };
     u64 as_u64;
   };
 } clib_bihash_bucket_t;
+
+/*
+ * Writers serialize per bucket on the lock byte, which lives in the
+ * same 64-bit word that readers load. Readers ignore it. Every store
+ * of b->as_u64 made while the lock is held must keep lock set.
+ */
+static inline void
+clib_bihash_lock_bucket (clib_bihash_bucket_t * b)
+{
+  clib_bihash_bucket_t unlocked, locked;
+
+  while (1)
+    {
+      unlocked.as_u64 = *(volatile u64 *) &b->as_u64;
+      if (PREDICT_FALSE (unlocked.lock))
+	continue;
+      locked.as_u64 = unlocked.as_u64;
+      locked.lock = 1;
+      if (__sync_bool_compare_and_swap (&b->as_u64, unlocked.as_u64,
+					locked.as_u64))
+	return;
+    }
+}
+
+static inline void
+clib_bihash_unlock_bucket (clib_bihash_bucket_t * b)
+{
+  CLIB_MEMORY_BARRIER ();
+  b->lock = 0;
+}
 #endif /* __defined_clib_bihash_bucket_t__ */
 
 typedef struct
 {
   BVT (clib_bihash_value) * values;
   clib_bihash_bucket_t *buckets;
-  volatile u32 *writer_lock;
+  volatile u32 *alloc_lock;
 
     BVT (clib_bihash_value) ** working_copies;
-  clib_bihash_bucket_t saved_bucket;
 
   u32 nbuckets;
   u32 log2_nbuckets;
   u32 linear_buckets;
+  u64 spills;
   u8 *name;
 
     BVT (clib_bihash_value) ** freelists;
@@ -207,6 +238,96 @@ static inline int BV (clib_bihash_search_inline_2)
   return -1;
 }
 
+/*
+ * Batched search. Keys are hashed, their buckets prefetched, then their
+ * home pages prefetched, then compared, in a software pipeline so that
+ * up to 2 * BIHASH_SEARCH_PREFETCH_DISTANCE misses are in flight at once.
+ *
+ * Like clib_bihash_search_inline, each kvs[i] is a search key on entry
+ * and is overwritten with the matching (key,value) pair on a hit. On a
+ * miss kvs[i] is left alone, so callers can preset a miss value. If
+ * hits is non-zero, hits[i] is set to 1 on a hit and 0 on a miss.
+ * Returns the number of hits.
+ */
+#ifndef BIHASH_SEARCH_PREFETCH_DISTANCE
+#define BIHASH_SEARCH_PREFETCH_DISTANCE 4
+#endif
+#define BIHASH_SEARCH_RING_SIZE (4 * BIHASH_SEARCH_PREFETCH_DISTANCE)
+
+static inline u32 BV (clib_bihash_search_batch)
+  (const BVT (clib_bihash) * h, BVT (clib_bihash_kv) * kvs, u8 * hits,
+   u32 n_keys)
+{
+  const u32 d = BIHASH_SEARCH_PREFETCH_DISTANCE;
+  const u32 mask = BIHASH_SEARCH_RING_SIZE - 1;
+  u64 hash[BIHASH_SEARCH_RING_SIZE];
+  BVT (clib_bihash_value) * values[BIHASH_SEARCH_RING_SIZE];
+  u32 limits[BIHASH_SEARCH_RING_SIZE];
+  BVT (clib_bihash_value) * v;
+  clib_bihash_bucket_t *b;
+  u32 i, j, n_hits = 0;
+  u64 h0;
+  int k, limit;
+
+  for (i = 0; i < n_keys + 2 * d; i++)
+    {
+      /* Stage 1: hash key i and prefetch its bucket */
+      if (i < n_keys)
+	{
+	  h0 = BV (clib_bihash_hash) (&kvs[i]);
+	  hash[i & mask] = h0;
+	  CLIB_PREFETCH (&h->buckets[h0 & (h->nbuckets - 1)],
+			 sizeof (clib_bihash_bucket_t), LOAD);
+	}
+
+      /* Stage 2: read the bucket of key i - d, prefetch its home page */
+      j = i - d;
+      if (i >= d && j < n_keys)
+	{
+	  h0 = hash[j & mask];
+	  b = &h->buckets[h0 & (h->nbuckets - 1)];
+	  v = 0;
+	  if (b->offset)
+	    {
+	      h0 >>= h->log2_nbuckets;
+	      v = BV (clib_bihash_get_value) (h, b->offset);
+	      limit = BIHASH_KVP_PER_PAGE;
+	      v += (b->linear_search == 0) ?
+		h0 & ((1 << b->log2_pages) - 1) : 0;
+	      if (PREDICT_FALSE (b->linear_search))
+		limit <<= b->log2_pages;
+	      limits[j & mask] = limit;
+	      CLIB_PREFETCH (v, sizeof (*v), LOAD);
+	    }
+	  values[j & mask] = v;
+	}
+
+      /* Stage 3: compare key i - 2d against its page */
+      j = i - 2 * d;
+      if (i >= 2 * d)
+	{
+	  v = values[j & mask];
+	  if (hits)
+	    hits[j] = 0;
+	  if (v == 0)
+	    continue;
+	  limit = limits[j & mask];
+	  for (k = 0; k < limit; k++)
+	    {
+	      if (BV (clib_bihash_key_compare) (v->kvp[k].key, kvs[j].key))
+		{
+		  kvs[j] = v->kvp[k];
+		  if (hits)
+		    hits[j] = 1;
+		  n_hits++;
+		  break;
+		}
+	    }
+	}
+    }
+  return n_hits;
+}
+
 
 #endif /* __included_bihash_template_h__ */
 
@@ -51,6 +51,11 @@
 /* Per CPU heaps. */
 extern void *clib_per_cpu_mheaps[CLIB_MAX_MHEAPS];
 
+/* Long-lived home heap of each cpu (main heap, per-thread arenas).
+   Used to find the owner of an object freed by some other cpu. */
+extern void *clib_per_cpu_home_mheaps[CLIB_MAX_MHEAPS];
+extern u32 clib_mem_n_home_mheaps;
+
 always_inline void *
 clib_mem_get_per_cpu_heap (void)
 {
@@ -155,10 +160,30 @@ clib_mem_alloc_aligned_or_null (uword size, uword align)
 /* Alias to stack allocator for naming consistency. */
 #define clib_mem_alloc_stack(bytes) __builtin_alloca(bytes)
 
+/* Heap an object was allocated from: the current heap, or failing that
+   the home heap of whichever cpu contains it. */
+always_inline void *
+clib_mem_get_object_heap (void *p)
+{
+  void *heap = clib_mem_get_per_cpu_heap ();
+  u32 i;
+
+  if (PREDICT_TRUE (!heap || mheap_contains (heap, p)))
+    return heap;
+
+  for (i = 0; i < clib_mem_n_home_mheaps; i++)
+    {
+      void *h = clib_per_cpu_home_mheaps[i];
+      if (h && mheap_contains (h, p))
+	return h;
+    }
+  return heap;
+}
+
 always_inline uword
 clib_mem_is_heap_object (void *p)
 {
-  void *heap = clib_mem_get_per_cpu_heap ();
+  void *heap = clib_mem_get_object_heap (p);
   uword offset = (uword) p - (uword) heap;
   mheap_elt_t *e, *n;
 
@@ -175,7 +200,7 @@ clib_mem_is_heap_object (void *p)
 always_inline void
 clib_mem_free (void *p)
 {
-  u8 *heap = clib_mem_get_per_cpu_heap ();
+  u8 *heap = clib_mem_get_object_heap (p);
 
   /* Make sure object is in the correct heap. */
   ASSERT (clib_mem_is_heap_object (p));
@@ -227,6 +252,8 @@ clib_mem_set_heap (void *heap)
 
 void *clib_mem_init (void *heap, uword size);
 
+void *clib_mem_thread_arena_create (uword cpu, uword size);
+
 void clib_mem_exit (void);
 
 uword clib_mem_get_page_size (void);
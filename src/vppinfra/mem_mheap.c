@@ -44,13 +44,28 @@
 #include <vppinfra/valgrind.h>
 
 void *clib_per_cpu_mheaps[CLIB_MAX_MHEAPS];
+void *clib_per_cpu_home_mheaps[CLIB_MAX_MHEAPS];
+u32 clib_mem_n_home_mheaps;
+
+static void
+clib_mem_set_home_heap (uword cpu, void *heap)
+{
+  ASSERT (cpu < CLIB_MAX_MHEAPS);
+  clib_per_cpu_home_mheaps[cpu] = heap;
+  CLIB_MEMORY_BARRIER ();
+  if (cpu >= clib_mem_n_home_mheaps)
+    clib_mem_n_home_mheaps = cpu + 1;
+}
 
 void
 clib_mem_exit (void)
 {
   u8 *heap = clib_mem_get_per_cpu_heap ();
+  uword cpu = os_get_cpu_number ();
   if (heap)
     mheap_free (heap);
+  if (clib_per_cpu_home_mheaps[cpu] == heap)
+    clib_per_cpu_home_mheaps[cpu] = 0;
   clib_mem_set_per_cpu_heap (0);
 }
 
@@ -91,6 +106,32 @@ clib_mem_init (void *memory, uword memory_size)
     }
 
   clib_mem_set_heap (heap);
+  if (heap)
+    clib_mem_set_home_heap (os_get_cpu_number (), heap);
+
+  return heap;
+}
+
+/*
+ * Create a private heap for the given cpu. Only that cpu allocates from
+ * it, without locking, and gets the small object cache. Objects freed by
+ * other cpus are handed back through the heap's remote free queue.
+ */
+void *
+clib_mem_thread_arena_create (uword cpu, uword size)
+{
+  void *heap;
+  mheap_t *h;
+
+  heap = mheap_alloc_with_flags (0 /* use VM */ , size,
+				 MHEAP_FLAG_REMOTE_FREE
+				 | MHEAP_FLAG_SMALL_OBJECT_CACHE);
+  if (!heap)
+    return 0;
+
+  h = mheap_header (heap);
+  h->home_cpu = cpu;
+  clib_mem_set_home_heap (cpu, heap);
 
   return heap;
 }
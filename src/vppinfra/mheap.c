@@ -63,11 +63,16 @@ mheap_maybe_lock (void *v)
 	  return;
 	}
 
-      while (__sync_lock_test_and_set (&h->lock, 1))
-	;
+      if (PREDICT_FALSE (__sync_lock_test_and_set (&h->lock, 1)))
+	{
+	  while (__sync_lock_test_and_set (&h->lock, 1))
+	    ;
+	  h->stats.n_lock_contended++;
+	}
 
       h->owner_cpu = my_cpu;
       h->recursion_count = 1;
+      h->stats.n_lock_acquires++;
     }
 }
 
@@ -678,6 +683,8 @@ mheap_get_aligned (void *v,
   if (!v)
     v = mheap_alloc (0, 64 << 20);
 
+  mheap_maybe_drain_remote_puts (v);
+
   mheap_maybe_lock (v);
 
   h = mheap_header (v);
@@ -757,8 +764,8 @@ free_last_elt (void *v, mheap_elt_t * e)
     }
 }
 
-void
-mheap_put (void *v, uword uoffset)
+static void
+mheap_put_local (void *v, uword uoffset)
 {
   mheap_t *h;
   uword n_user_data_bytes, bin;
@@ -871,6 +878,66 @@ done:
   h->stats.n_clocks_put += cpu_times[1] - cpu_times[0];
 }
 
+/* Queue an object freed by a foreign cpu for its owner. */
+static void
+mheap_remote_put (void *v, uword uoffset)
+{
+  mheap_t *h = mheap_header (v);
+  uword *p = v + uoffset;
+  uword old;
+
+  do
+    {
+      old = h->remote_puts;
+      p[0] = old;
+    }
+  while (!__sync_bool_compare_and_swap (&h->remote_puts, old,
+					pointer_to_uword (p)));
+
+  __sync_fetch_and_add (&h->stats.n_remote_puts, 1);
+}
+
+/* Owner frees everything foreign cpus queued since the last call. */
+void
+mheap_maybe_drain_remote_puts (void *v)
+{
+  mheap_t *h = mheap_header (v);
+  uword *p, next;
+
+  if (PREDICT_TRUE (!(h->flags & MHEAP_FLAG_REMOTE_FREE)
+		    || h->remote_puts == 0
+		    || os_get_cpu_number () != h->home_cpu))
+    return;
+
+  p = uword_to_pointer (__sync_lock_test_and_set (&h->remote_puts, 0),
+			uword *);
+  while (p)
+    {
+      next = p[0];
+      mheap_put_local (v, (u8 *) p - (u8 *) v);
+      h->stats.n_remote_puts_drained++;
+      p = uword_to_pointer (next, uword *);
+    }
+}
+
+void
+mheap_put (void *v, uword uoffset)
+{
+  mheap_t *h = mheap_header (v);
+
+  if (h->flags & MHEAP_FLAG_REMOTE_FREE)
+    {
+      if (os_get_cpu_number () != h->home_cpu)
+	{
+	  mheap_remote_put (v, uoffset);
+	  return;
+	}
+      mheap_maybe_drain_remote_puts (v);
+    }
+
+  mheap_put_local (v, uoffset);
+}
+
 void *
 mheap_alloc_with_flags (void *memory, uword memory_size, uword flags)
 {
@@ -1161,6 +1228,19 @@ format_mheap_stats (u8 * s, va_list * va)
 	      format_white_space, indent,
 	      st->n_puts, (f64) st->n_clocks_put / (f64) st->n_puts);
 
+  if (h->flags & MHEAP_FLAG_THREAD_SAFE)
+    s = format (s, "\n%Ulock: %Ld acquires, %Ld contended (%.2f%%)",
+		format_white_space, indent,
+		st->n_lock_acquires, st->n_lock_contended,
+		(st->n_lock_acquires != 0 ?
+		 100. * (f64) st->n_lock_contended /
+		 (f64) st->n_lock_acquires : 0.));
+
+  if (h->flags & MHEAP_FLAG_REMOTE_FREE)
+    s = format (s, "\n%Uremote frees: %Ld queued, %Ld drained, owner cpu %d",
+		format_white_space, indent,
+		st->n_remote_puts, st->n_remote_puts_drained, h->home_cpu);
+
   return s;
 }
 
@@ -186,6 +186,14 @@ typedef struct
 
   u64 n_gets, n_puts;
   u64 n_clocks_get, n_clocks_put;
+
+  /* Lock traffic for MHEAP_FLAG_THREAD_SAFE heaps. */
+  u64 n_lock_acquires;
+  u64 n_lock_contended;
+
+  /* Frees from foreign threads deferred for MHEAP_FLAG_REMOTE_FREE heaps. */
+  u64 n_remote_puts;
+  u64 n_remote_puts_drained;
 } mheap_stats_t;
 
 /* Without vector instructions don't bother with small object cache. */
@@ -240,12 +248,22 @@ typedef struct
 #define MHEAP_FLAG_THREAD_SAFE			(1 << 2)
 #define MHEAP_FLAG_SMALL_OBJECT_CACHE		(1 << 3)
 #define MHEAP_FLAG_VALIDATE			(1 << 4)
+  /* Heap belongs to home_cpu and is never locked. Frees from any other
+     cpu are queued on remote_puts and performed by the owner. */
+#define MHEAP_FLAG_REMOTE_FREE			(1 << 5)
 
   /* Lock use when MHEAP_FLAG_THREAD_SAFE is set. */
   volatile u32 lock;
   volatile u32 owner_cpu;
   int recursion_count;
 
+  /* Owner of a MHEAP_FLAG_REMOTE_FREE heap. */
+  u32 home_cpu;
+
+  /* Singly linked list of objects freed by foreign cpus, linked through
+     their first user data word. Zero when empty. */
+  volatile uword remote_puts;
+
   /* Number of allocated objects. */
   u64 n_elts;
 
@@ -278,6 +296,15 @@ mheap_vector (mheap_t * h)
   return vec_aligned_header_end (h, sizeof (mheap_t), 16);
 }
 
+/* Does pointer p lie within the address space reserved for heap v? */
+always_inline uword
+mheap_contains (void *v, void *p)
+{
+  mheap_t *h = mheap_header (v);
+  u8 *base = (u8 *) h - h->vm_alloc_offset_from_header;
+  return (u8 *) p >= base && (u8 *) p < base + h->vm_alloc_size;
+}
+
 always_inline uword
 mheap_elt_uoffset (void *v, mheap_elt_t * e)
 {
@@ -359,6 +386,9 @@ mheap_max_size (void *v)
 /* Free previously allocated offset. */
 void mheap_put (void *v, uword offset);
 
+/* Owner of a MHEAP_FLAG_REMOTE_FREE heap frees objects queued by others. */
+void mheap_maybe_drain_remote_puts (void *v);
+
 /* Allocate object from mheap. */
 void *mheap_get_aligned (void *v, uword size, uword align, uword align_offset,
 			 uword * offset_return);
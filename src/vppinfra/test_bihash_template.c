@@ -21,6 +21,8 @@
 
 #include <vppinfra/bihash_template.c>
 
+#include <pthread.h>
+
 typedef struct
 {
   u64 seed;
@@ -30,6 +32,8 @@ typedef struct
   int careful_delete_tests;
   int verbose;
   int non_random_keys;
+  u32 nthreads;
+  volatile u32 threads_go;
   uword *key_hash;
   u64 *keys;
     BVT (clib_bihash) hash;
@@ -41,25 +45,38 @@ typedef struct
 
 test_main_t test_main;
 
+/*
+ * The bihash keeps per-cpu working copies, so each stress thread
+ * needs its own cpu number. Override the weak libvppinfra default.
+ */
+static __thread uword test_cpu_number;
+
+uword
+os_get_cpu_number (void)
+{
+  return test_cpu_number;
+}
+
+typedef struct
+{
+  test_main_t *tm;
+  pthread_t thread;
+  u32 cpu_number;
+  u32 first_item;
+  u32 last_item;
+} test_thread_t;
+
 uword
 vl (void *v)
 {
   return vec_len (v);
 }
 
-static clib_error_t *
-test_bihash (test_main_t * tm)
+static void
+test_bihash_pick_keys (test_main_t * tm)
 {
-  int i, j;
+  int i;
   uword *p;
-  uword total_searches;
-  f64 before, delta;
-  BVT (clib_bihash) * h;
-  BVT (clib_bihash_kv) kv;
-
-  h = &tm->hash;
-
-  BV (clib_bihash_init) (h, "test", tm->nbuckets, 3ULL << 30);
 
   fformat (stdout, "Pick %lld unique %s keys...\n",
 	   tm->nitems, tm->non_random_keys ? "non-random" : "random");
@@ -84,6 +101,121 @@ test_bihash (test_main_t * tm)
       hash_set (tm->key_hash, rndkey, i + 1);
       vec_add1 (tm->keys, rndkey);
     }
+}
+
+static void *
+test_bihash_thread_fn (void *arg)
+{
+  test_thread_t *t = arg;
+  test_main_t *tm = t->tm;
+  BVT (clib_bihash_kv) kv;
+  u32 i;
+
+  test_cpu_number = t->cpu_number;
+
+  while (tm->threads_go == 0)
+    ;
+
+  for (i = t->first_item; i < t->last_item; i++)
+    {
+      kv.key = tm->keys[i];
+      kv.value = i + 1;
+      BV (clib_bihash_add_del) (&tm->hash, &kv, 1 /* is_add */ );
+    }
+  return 0;
+}
+
+static clib_error_t *
+test_bihash_threads (test_main_t * tm)
+{
+  test_thread_t *threads = 0, *t;
+  BVT (clib_bihash) * h = &tm->hash;
+  BVT (clib_bihash_kv) kv;
+  f64 before, delta, base_rate = 0;
+  u32 n_threads, per_thread, n_errors;
+  int i, rv;
+
+  test_bihash_pick_keys (tm);
+  vec_validate (threads, tm->nthreads - 1);
+
+  for (n_threads = 1; n_threads <= tm->nthreads; n_threads++)
+    {
+      BV (clib_bihash_init) (h, "test", tm->nbuckets, 3ULL << 30);
+
+      tm->threads_go = 0;
+      per_thread = tm->nitems / n_threads;
+
+      for (i = 0; i < n_threads; i++)
+	{
+	  t = threads + i;
+	  t->tm = tm;
+	  t->cpu_number = i + 1;
+	  t->first_item = i * per_thread;
+	  t->last_item = (i == n_threads - 1) ? tm->nitems
+	    : t->first_item + per_thread;
+	  rv = pthread_create (&t->thread, 0, test_bihash_thread_fn, t);
+	  if (rv)
+	    return clib_error_return_code (0, rv, 0,
+					   "pthread_create failed");
+	}
+
+      before = clib_time_now (&tm->clib_time);
+      CLIB_MEMORY_BARRIER ();
+      tm->threads_go = 1;
+
+      for (i = 0; i < n_threads; i++)
+	pthread_join (threads[i].thread, 0);
+
+      delta = clib_time_now (&tm->clib_time) - before;
+
+      n_errors = 0;
+      for (i = 0; i < tm->nitems; i++)
+	{
+	  kv.key = tm->keys[i];
+	  if (BV (clib_bihash_search) (h, &kv, &kv) < 0
+	      || kv.value != (u64) (i + 1))
+	    n_errors++;
+	}
+
+      if (n_threads == 1 && delta > 0)
+	base_rate = tm->nitems / delta;
+
+      fformat (stdout, "%2d threads: %.f inserts per second, "
+	       "%.2fx, %d lookup errors\n", n_threads,
+	       delta > 0 ? tm->nitems / delta : 0,
+	       (delta > 0 && base_rate > 0) ?
+	       (tm->nitems / delta) / base_rate : 0, n_errors);
+
+      if (tm->verbose)
+	fformat (stdout, "%U", BV (format_bihash), h, 0 /* verbose */ );
+
+      BV (clib_bihash_free) (h);
+
+      if (n_errors)
+	return clib_error_return (0, "%d keys missing after %d threads",
+				  n_errors, n_threads);
+    }
+
+  vec_free (threads);
+  return 0;
+}
+
+static clib_error_t *
+test_bihash (test_main_t * tm)
+{
+  int i, j;
+  uword *p;
+  uword total_searches;
+  f64 before, delta;
+  BVT (clib_bihash) * h;
+  BVT (clib_bihash_kv) kv, *kvs = 0;
+  u8 *hits = 0;
+
+  h = &tm->hash;
+
+  BV (clib_bihash_init) (h, "test", tm->nbuckets, 3ULL << 30);
+
+  test_bihash_pick_keys (tm);
 
   fformat (stdout, "Add items...\n");
   for (i = 0; i < tm->nitems; i++)
@@ -134,6 +266,37 @@ test_bihash (test_main_t * tm)
 
   fformat (stdout, "%lld searches in %.6f seconds\n", total_searches, delta);
 
+  fformat (stdout, "Batch search for items %d times...\n", tm->search_iter);
+
+  vec_validate (kvs, tm->nitems - 1);
+  vec_validate (hits, tm->nitems - 1);
+  before = clib_time_now (&tm->clib_time);
+
+  for (j = 0; j < tm->search_iter; j++)
+    {
+      for (i = 0; i < tm->nitems; i++)
+	kvs[i].key = tm->keys[i];
+      if (BV (clib_bihash_search_batch) (h, kvs, hits, tm->nitems)
+	  != tm->nitems)
+	clib_warning ("batch search missed keys unexpectedly");
+    }
+
+  delta = clib_time_now (&tm->clib_time) - before;
+
+  for (i = 0; i < tm->nitems; i++)
+    if (hits[i] == 0 || kvs[i].value != (u64) (i + 1))
+      clib_warning ("[%d] batch search for key %lld returned %lld, not %lld",
+		    i, tm->keys[i], kvs[i].value, (u64) (i + 1));
+
+  if (delta > 0)
+    fformat (stdout, "%.f searches per second\n",
+	     ((f64) total_searches) / delta);
+
+  fformat (stdout, "%lld searches in %.6f seconds\n", total_searches, delta);
+
+  vec_free (kvs);
+  vec_free (hits);
+
   fformat (stdout, "Standard E-hash search for items %d times...\n",
 	   tm->search_iter);
 
@@ -222,6 +385,8 @@ test_bihash_main (test_main_t * tm)
 	;
       else if (unformat (i, "search %d", &tm->search_iter))
 	;
+      else if (unformat (i, "threads %d", &tm->nthreads))
+	;
       else if (unformat (i, "verbose"))
 	tm->verbose = 1;
       else
@@ -229,7 +394,10 @@ test_bihash_main (test_main_t * tm)
 				  format_unformat_error, i);
     }
 
-  error = test_bihash (tm);
+  if (tm->nthreads)
+    error = test_bihash_threads (tm);
+  else
+    error = test_bihash (tm);
 
   return error;
 }
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vppinfra/mem.h>
+#include <vppinfra/mheap.h>
+#include <vppinfra/vec.h>
+#include <vppinfra/random.h>
+#include <vppinfra/format.h>
+#include <vppinfra/error.h>
+
+#include <pthread.h>
+
+/*
+ * A worker thread allocates from its private arena and hands objects
+ * to the main thread, which frees them (and grows and frees a vector the
+ * worker built) while the worker keeps allocating. Every foreign free
+ * must be queued on the arena and later performed by the worker.
+ */
+
+typedef struct
+{
+  u32 n_objects;
+  u32 seed;
+  int verbose;
+
+  void *arena;
+
+  /* Objects published by the worker, freed by the main thread */
+  u32 **objects;
+  volatile u32 n_published;
+  volatile u32 n_freed;
+
+  u32 *vector;
+  volatile u32 vector_ready;
+} test_main_t;
+
+test_main_t test_main;
+
+/* Each thread plays a different cpu. Override the weak libvppinfra default. */
+static __thread uword test_cpu_number;
+
+uword
+os_get_cpu_number (void)
+{
+  return test_cpu_number;
+}
+
+#define TEST_WORKER_CPU 1
+
+static void *
+test_worker_fn (void *arg)
+{
+  test_main_t *tm = arg;
+  u32 i, j, n_words, seed = tm->seed;
+  u32 *o;
+
+  test_cpu_number = TEST_WORKER_CPU;
+  tm->arena = clib_mem_thread_arena_create (TEST_WORKER_CPU, 64 << 20);
+  if (!tm->arena)
+    return (void *) 1;
+  clib_mem_set_heap (tm->arena);
+
+  for (i = 0; i < 100; i++)
+    vec_add1 (tm->vector, i);
+  CLIB_MEMORY_BARRIER ();
+  tm->vector_ready = 1;
+
+  for (i = 0; i < tm->n_objects; i++)
+    {
+      n_words = 1 + (random_u32 (&seed) % 64);
+      o = clib_mem_alloc (n_words * sizeof (o[0]));
+      o[0] = n_words;
+      for (j = 1; j < n_words; j++)
+	o[j] = i + j;
+      tm->objects[i] = o;
+      CLIB_MEMORY_BARRIER ();
+      tm->n_published = i + 1;
+    }
+
+  /* Perform the frees queued since our last allocation */
+  while (tm->n_freed < tm->n_objects || !tm->vector_ready)
+    ;
+  clib_mem_free (clib_mem_alloc (16));
+
+  return 0;
+}
+
+static clib_error_t *
+test_mheap_remote (test_main_t * tm)
+{
+  mheap_t *h;
+  pthread_t thread;
+  void *rv;
+  u32 i, j, *o, n_bad = 0;
+  u64 n_expected;
+
+  tm->objects = clib_mem_alloc (tm->n_objects * sizeof (tm->objects[0]));
+
+  if (pthread_create (&thread, 0, test_worker_fn, tm))
+    return clib_error_return (0, "pthread_create failed");
+
+  /* Free the worker's objects as it allocates more */
+  for (i = 0; i < tm->n_objects; i++)
+    {
+      while (tm->n_published <= i)
+	;
+      o = tm->objects[i];
+      for (j = 1; j < o[0]; j++)
+	n_bad += o[j] != i + j;
+      if (!clib_mem_is_heap_object (o))
+	n_bad++;
+      clib_mem_free (o);
+      tm->n_freed = i + 1;
+
+      if (i == tm->n_objects / 2)
+	{
+	  /* Grow a worker's vector here: copied into our heap, old one
+	     queued back to the arena */
+	  while (!tm->vector_ready)
+	    ;
+	  for (j = 0; j < 1000; j++)
+	    vec_add1 (tm->vector, 100 + j);
+	  for (j = 0; j < vec_len (tm->vector); j++)
+	    n_bad += tm->vector[j] != j;
+	  vec_free (tm->vector);
+	}
+    }
+
+  pthread_join (thread, &rv);
+  if (rv)
+    return clib_error_return (0, "failed to create worker arena");
+
+  h = mheap_header (tm->arena);
+  n_expected = tm->n_objects + 1;
+
+  if (tm->verbose)
+    fformat (stdout, "%U\n", format_mheap, tm->arena, 1);
+
+  if (n_bad)
+    return clib_error_return (0, "%d objects corrupted", n_bad);
+  if (h->stats.n_remote_puts != n_expected)
+    return clib_error_return (0, "%Ld frees queued, expected %Ld",
+			      h->stats.n_remote_puts, n_expected);
+  if (h->stats.n_remote_puts_drained != n_expected)
+    return clib_error_return (0, "%Ld frees drained, expected %Ld",
+			      h->stats.n_remote_puts_drained, n_expected);
+  if (h->remote_puts != 0)
+    return clib_error_return (0, "remote free queue not empty");
+
+  clib_mem_free (tm->objects);
+  fformat (stdout, "%d objects freed by a foreign thread\n", tm->n_objects);
+  return 0;
+}
+
+int
+test_mheap_remote_main (unformat_input_t * i)
+{
+  test_main_t *tm = &test_main;
+  clib_error_t *error;
+
+  tm->n_objects = 100000;
+  tm->seed = 0xdeadbeef;
+
+  while (unformat_check_input (i) != UNFORMAT_END_OF_INPUT)
+    {
+      if (unformat (i, "objects %d", &tm->n_objects))
+	;
+      else if (unformat (i, "seed %d", &tm->seed))
+	;
+      else if (unformat (i, "verbose"))
+	tm->verbose = 1;
+      else
+	{
+	  clib_warning ("unknown input '%U'", format_unformat_error, i);
+	  return 1;
+	}
+    }
+
+  error = test_mheap_remote (tm);
+  if (error)
+    {
+      clib_error_report (error);
+      return 1;
+    }
+  return 0;
+}
+
+#ifdef CLIB_UNIX
+int
+main (int argc, char *argv[])
+{
+  unformat_input_t i;
+  int ret;
+
+  clib_mem_init (0, 64 << 20);
+
+  unformat_init_command_line (&i, argv);
+  ret = test_mheap_remote_main (&i);
+  unformat_free (&i);
+
+  return ret;
+}
+#endif /* CLIB_UNIX */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
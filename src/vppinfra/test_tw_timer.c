@@ -3,6 +3,7 @@
 #include <vppinfra/error.h>
 #include <vppinfra/tw_timer_2t_1w_2048sl.h>
 #include <vppinfra/tw_timer_16t_2w_512sl.h>
+#include <vppinfra/tw_timer_4t_3w_512sl.h>
 
 typedef struct
 {
@@ -24,6 +25,9 @@ typedef struct
   /** The double-wheel */
   tw_timer_wheel_16t_2w_512sl_t double_wheel;
 
+  /** The triple-wheel */
+  tw_timer_wheel_4t_3w_512sl_t triple_wheel;
+
   /** random number seed */
   u32 seed;
 
@@ -68,6 +72,19 @@ run_double_wheel (tw_timer_wheel_16t_2w_512sl_t * tw, u32 n_ticks)
     }
 }
 
+static void
+run_triple_wheel (tw_timer_wheel_4t_3w_512sl_t * tw, u32 n_ticks)
+{
+  u32 i;
+  f64 now = tw->last_run_time + 1.01;
+
+  for (i = 0; i < n_ticks; i++)
+    {
+      tw_timer_expire_timers_4t_3w_512sl (tw, now);
+      now += 1.01;
+    }
+}
+
 static void
 expired_timer_single_callback (u32 * expired_timers)
 {
@@ -138,7 +155,8 @@ test2_single (tw_timer_test_main_t * tm)
 
   tw_timer_wheel_init_2t_1w_2048sl (&tm->single_wheel,
 				    expired_timer_single_callback,
-				    1.0 /* timer interval */ );
+				    1.0 /* timer interval */ ,
+				    ~0 /* max expirations */ );
 
   /* Prime offset */
   initial_wheel_offset = 757;
@@ -250,6 +268,33 @@ test2_single (tw_timer_test_main_t * tm)
   return 0;
 }
 
+static void
+expired_timer_triple_callback (u32 * expired_timers)
+{
+  int i;
+  u32 pool_index, timer_id;
+  tw_timer_test_elt_t *e;
+  tw_timer_test_main_t *tm = &tw_timer_test_main;
+
+  for (i = 0; i < vec_len (expired_timers); i++)
+    {
+      pool_index = expired_timers[i] & 0x3FFFFFFF;
+      timer_id = expired_timers[i] >> 30;
+
+      ASSERT (timer_id == 3);
+
+      e = pool_elt_at_index (tm->test_elts, pool_index);
+
+      if (e->expected_to_expire != tm->triple_wheel.current_tick)
+	{
+	  fformat (stdout, "[%d] expired at %d not %d\n",
+		   e - tm->test_elts, tm->triple_wheel.current_tick,
+		   e->expected_to_expire);
+	}
+      pool_put (tm->test_elts, e);
+    }
+}
+
 static clib_error_t *
 test2_double (tw_timer_test_main_t * tm)
 {
@@ -266,7 +311,8 @@ test2_double (tw_timer_test_main_t * tm)
 
   tw_timer_wheel_init_16t_2w_512sl (&tm->double_wheel,
 				    expired_timer_double_callback,
-				    1.0 /* timer interval */ );
+				    1.0 /* timer interval */ ,
+				    ~0 /* max expirations */ );
 
   /* Prime offset */
   initial_wheel_offset = 757;
@@ -387,7 +433,8 @@ test1_single (tw_timer_test_main_t * tm)
 
   tw_timer_wheel_init_2t_1w_2048sl (&tm->single_wheel,
 				    expired_timer_single_callback,
-				    1.0 /* timer interval */ );
+				    1.0 /* timer interval */ ,
+				    ~0 /* max expirations */ );
 
   /*
    * Prime offset, to make sure that the wheel starts in a
@@ -454,7 +501,8 @@ test1_double (tw_timer_test_main_t * tm)
 
   tw_timer_wheel_init_16t_2w_512sl (&tm->double_wheel,
 				    expired_timer_double_callback,
-				    1.0 /* timer interval */ );
+				    1.0 /* timer interval */ ,
+				    ~0 /* max expirations */ );
 
   /*
    * Prime offset, to make sure that the wheel starts in a
@@ -503,6 +551,199 @@ test1_double (tw_timer_test_main_t * tm)
   return 0;
 }
 
+static clib_error_t *
+test1_triple (tw_timer_test_main_t * tm)
+{
+  u32 i;
+  tw_timer_test_elt_t *e;
+  u32 offset;
+
+  tw_timer_wheel_init_4t_3w_512sl (&tm->triple_wheel,
+				   expired_timer_triple_callback,
+				   1.0 /* timer interval */ ,
+				   ~0 /* max expirations */ );
+
+  /*
+   * Prime offset, to make sure that the wheel starts in a
+   * non-trivial position, across a slow ring wrap
+   */
+  offset = (512 * 512) - 1237;
+
+  run_triple_wheel (&tm->triple_wheel, offset);
+
+  fformat (stdout, "initial wheel time %d, fast index %d, slow index %d\n",
+	   tm->triple_wheel.current_tick,
+	   tm->triple_wheel.current_index[TW_TIMER_RING_FAST],
+	   tm->triple_wheel.current_index[TW_TIMER_RING_SLOW]);
+
+  for (i = 0; i < tm->ntimers; i++)
+    {
+      pool_get (tm->test_elts, e);
+      memset (e, 0, sizeof (*e));
+
+      /* Spread the intervals over all three rings */
+      e->expected_to_expire = (i * 97) + 1 +
+	tm->triple_wheel.current_tick;
+      e->stop_timer_handle = tw_timer_start_4t_3w_512sl
+	(&tm->triple_wheel, e - tm->test_elts, 3 /* timer id */ ,
+	 (i * 97) + 1);
+    }
+  run_triple_wheel (&tm->triple_wheel, (tm->ntimers * 97) + 3);
+
+  if (pool_elts (tm->test_elts))
+    fformat (stdout, "Note: %d elements remain in pool\n",
+	     pool_elts (tm->test_elts));
+
+  /* *INDENT-OFF* */
+  pool_foreach (e, tm->test_elts,
+  ({
+    fformat(stdout, "[%d] expected to expire %d\n",
+                     e - tm->test_elts,
+                     e->expected_to_expire);
+  }));
+  /* *INDENT-ON* */
+
+  fformat (stdout,
+	   "final wheel time %d, fast index %d, glacier index %d\n",
+	   tm->triple_wheel.current_tick,
+	   tm->triple_wheel.current_index[TW_TIMER_RING_FAST],
+	   tm->triple_wheel.current_index[TW_TIMER_RING_GLACIER]);
+
+  pool_free (tm->test_elts);
+  tw_timer_wheel_free_4t_3w_512sl (&tm->triple_wheel);
+  return 0;
+}
+
+static clib_error_t *
+test2_triple (tw_timer_test_main_t * tm)
+{
+  u32 i, j;
+  tw_timer_test_elt_t *e;
+  u32 initial_wheel_offset;
+  u32 expiration_time;
+  u32 max_expiration_time = 0;
+  u32 *deleted_indices = 0;
+  u32 adds = 0, deletes = 0;
+  f64 before, after;
+
+  clib_time_init (&tm->clib_time);
+
+  tw_timer_wheel_init_4t_3w_512sl (&tm->triple_wheel,
+				   expired_timer_triple_callback,
+				   1.0 /* timer interval */ ,
+				   ~0 /* max expirations */ );
+
+  /* Prime offset */
+  initial_wheel_offset = 757;
+
+  run_triple_wheel (&tm->triple_wheel, initial_wheel_offset);
+
+  fformat (stdout, "test %d timers, %d iter, %d ticks per iter, 0x%x seed\n",
+	   tm->ntimers, tm->niter, tm->ticks_per_iter, tm->seed);
+
+  before = clib_time_now (&tm->clib_time);
+
+  /* Prime the pump */
+  for (i = 0; i < tm->ntimers; i++)
+    {
+      pool_get (tm->test_elts, e);
+      memset (e, 0, sizeof (*e));
+
+      do
+	{
+	  expiration_time = random_u32 (&tm->seed) & ((1 << 22) - 1);
+	}
+      while (expiration_time == 0);
+
+      if (expiration_time > max_expiration_time)
+	max_expiration_time = expiration_time;
+
+      e->expected_to_expire = expiration_time +
+	tm->triple_wheel.current_tick;
+      e->stop_timer_handle =
+	tw_timer_start_4t_3w_512sl (&tm->triple_wheel, e - tm->test_elts,
+				    3 /* timer id */ ,
+				    expiration_time);
+    }
+
+  adds += i;
+
+  for (i = 0; i < tm->niter; i++)
+    {
+      run_triple_wheel (&tm->triple_wheel, tm->ticks_per_iter);
+
+      j = 0;
+      vec_reset_length (deleted_indices);
+      /* *INDENT-OFF* */
+      pool_foreach (e, tm->test_elts,
+      ({
+        tw_timer_stop_4t_3w_512sl (&tm->triple_wheel, e->stop_timer_handle);
+        vec_add1 (deleted_indices, e - tm->test_elts);
+        if (++j >= tm->ntimers / 4)
+          goto del_and_re_add;
+      }));
+      /* *INDENT-ON* */
+
+    del_and_re_add:
+      for (j = 0; j < vec_len (deleted_indices); j++)
+	pool_put_index (tm->test_elts, deleted_indices[j]);
+
+      deletes += j;
+
+      for (j = 0; j < tm->ntimers / 4; j++)
+	{
+	  pool_get (tm->test_elts, e);
+	  memset (e, 0, sizeof (*e));
+
+	  do
+	    {
+	      expiration_time = random_u32 (&tm->seed) & ((1 << 22) - 1);
+	    }
+	  while (expiration_time == 0);
+
+	  if (expiration_time > max_expiration_time)
+	    max_expiration_time = expiration_time;
+
+	  e->expected_to_expire = expiration_time +
+	    tm->triple_wheel.current_tick;
+	  e->stop_timer_handle = tw_timer_start_4t_3w_512sl
+	    (&tm->triple_wheel, e - tm->test_elts, 3 /* timer id */ ,
+	     expiration_time);
+	}
+      adds += j;
+    }
+
+  vec_free (deleted_indices);
+
+  run_triple_wheel (&tm->triple_wheel, max_expiration_time + 1);
+
+  after = clib_time_now (&tm->clib_time);
+
+  fformat (stdout, "%d adds, %d deletes, %d ticks\n", adds, deletes,
+	   tm->triple_wheel.current_tick);
+  fformat (stdout, "test ran %.2f seconds, %.2f ops/second\n",
+	   (after - before),
+	   ((f64) adds + (f64) deletes +
+	    (f64) tm->triple_wheel.current_tick) / (after - before));
+
+  if (pool_elts (tm->test_elts))
+    fformat (stdout, "Note: %d elements remain in pool\n",
+	     pool_elts (tm->test_elts));
+
+  /* *INDENT-OFF* */
+  pool_foreach (e, tm->test_elts,
+  ({
+    fformat (stdout, "[%d] expected to expire %d\n",
+             e - tm->test_elts,
+             e->expected_to_expire);
+  }));
+  /* *INDENT-ON* */
+
+  pool_free (tm->test_elts);
+  tw_timer_wheel_free_4t_3w_512sl (&tm->triple_wheel);
+  return 0;
+}
+
 static clib_error_t *
 timer_test_command_fn (tw_timer_test_main_t * tm, unformat_input_t * input)
 {
@@ -539,22 +780,26 @@ timer_test_command_fn (tw_timer_test_main_t * tm, unformat_input_t * input)
   if (is_test1 + is_test2 == 0)
     return clib_error_return (0, "No test specified [test1..n]");
 
-  if (num_wheels < 1 || num_wheels > 2)
-    return clib_error_return (0, "unsupported... 1 or 2 wheels only");
+  if (num_wheels < 1 || num_wheels > 3)
+    return clib_error_return (0, "unsupported... 1, 2 or 3 wheels only");
 
   if (is_test1)
     {
       if (num_wheels == 1)
 	return test1_single (tm);
-      else
+      else if (num_wheels == 2)
 	return test1_double (tm);
+      else
+	return test1_triple (tm);
     }
   if (is_test2)
     {
       if (num_wheels == 1)
 	return test2_single (tm);
-      else
+      else if (num_wheels == 2)
 	return test2_double (tm);
+      else
+	return test2_triple (tm);
     }
   /* NOTREACHED */
   return 0;
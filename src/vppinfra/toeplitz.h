@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2017 Cisco and/or its affiliates.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at:
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef included_clib_toeplitz_h
+#define included_clib_toeplitz_h
+
+#include <vppinfra/clib.h>
+#include <vppinfra/error_bootstrap.h>
+
+/*
+ * Toeplitz hash, as computed by NICs for receive side scaling. For
+ * ip4/ip6 tcp/udp the input is source address, destination address,
+ * source port and destination port, all in network byte order. Used to
+ * predict the rx queue a flow lands on.
+ */
+
+/* Default RSS key of most NICs, including the ones DPDK drives */
+#define CLIB_TOEPLITZ_DEFAULT_KEY					\
+{									\
+  0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,			\
+  0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,			\
+  0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,			\
+  0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,			\
+  0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,			\
+}
+
+/* Hash n_bytes of data, key must be at least n_bytes + 4 bytes long */
+always_inline u32
+clib_toeplitz_hash (u8 * key, uword key_len, u8 * data, uword n_bytes)
+{
+  u32 hash = 0, v;
+  uword i;
+  int b;
+
+  ASSERT (key_len >= n_bytes + 4);
+
+  /* Leftmost 32 bits of the key, slid one bit per input bit */
+  v = ((u32) key[0] << 24) | ((u32) key[1] << 16) | ((u32) key[2] << 8)
+    | key[3];
+
+  for (i = 0; i < n_bytes; i++)
+    {
+      for (b = 7; b >= 0; b--)
+	{
+	  if (data[i] & (1 << b))
+	    hash ^= v;
+	  v = (v << 1) | ((key[i + 4] >> b) & 1);
+	}
+    }
+
+  return hash;
+}
+
+#endif /* included_clib_toeplitz_h */
+
+/*
+ * fd.io coding-style-patch-verification: ON
+ *
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
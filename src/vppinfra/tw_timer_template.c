@@ -89,6 +89,9 @@ TW (tw_timer_start) (TWT (tw_timer_wheel) * tw, u32 pool_index, u32 timer_id,
 #if TW_TIMER_WHEELS > 1
   u16 slow_ring_offset;
   u32 carry;
+#endif
+#if TW_TIMER_WHEELS > 2
+  u16 glacier_ring_offset;
 #endif
   u16 fast_ring_offset;
   tw_timer_wheel_slot_t *ts;
@@ -100,12 +103,61 @@ TW (tw_timer_start) (TWT (tw_timer_wheel) * tw, u32 pool_index, u32 timer_id,
   t->next = t->prev = ~0;
 #if TW_TIMER_WHEELS > 1
   t->fast_ring_offset = ~0;
+#endif
+#if TW_TIMER_WHEELS > 2
+  t->slow_ring_offset = ~0;
 #endif
   t->user_handle = TW (make_internal_timer_handle) (pool_index, timer_id);
 
   fast_ring_offset = interval & TW_RING_MASK;
   fast_ring_offset += tw->current_index[TW_TIMER_RING_FAST];
-#if TW_TIMER_WHEELS > 1
+#if TW_TIMER_WHEELS > 2
+  carry = fast_ring_offset >= TW_SLOTS_PER_RING ? 1 : 0;
+  fast_ring_offset %= TW_SLOTS_PER_RING;
+  slow_ring_offset = ((interval >> TW_RING_SHIFT) & TW_RING_MASK) + carry;
+
+  /* Carry out of the slow ring adds a glacier ring tick */
+  carry = (slow_ring_offset + tw->current_index[TW_TIMER_RING_SLOW]
+	   >= TW_SLOTS_PER_RING) ? 1 : 0;
+  glacier_ring_offset = (interval >> (2 * TW_RING_SHIFT)) + carry;
+
+  /* Timer duration exceeds one glacier ring revolution? Oops */
+  ASSERT (glacier_ring_offset < TW_SLOTS_PER_RING);
+
+  if (glacier_ring_offset)
+    {
+      glacier_ring_offset += tw->current_index[TW_TIMER_RING_GLACIER];
+      glacier_ring_offset %= TW_SLOTS_PER_RING;
+
+      /* Remember both lower digits, for dealing into the lower rings */
+      t->fast_ring_offset = fast_ring_offset;
+      t->slow_ring_offset = (slow_ring_offset +
+			     tw->current_index[TW_TIMER_RING_SLOW])
+	% TW_SLOTS_PER_RING;
+
+      ts = &tw->w[TW_TIMER_RING_GLACIER][glacier_ring_offset];
+
+      timer_addhead (tw->timers, ts->head_index, t - tw->timers);
+
+      return t - tw->timers;
+    }
+
+  /* Timer expires more than one fast ring revolution from now? */
+  if (slow_ring_offset)
+    {
+      slow_ring_offset += tw->current_index[TW_TIMER_RING_SLOW];
+      slow_ring_offset %= TW_SLOTS_PER_RING;
+
+      t->fast_ring_offset = fast_ring_offset;
+      ASSERT (t->fast_ring_offset < TW_SLOTS_PER_RING);
+
+      ts = &tw->w[TW_TIMER_RING_SLOW][slow_ring_offset];
+
+      timer_addhead (tw->timers, ts->head_index, t - tw->timers);
+
+      return t - tw->timers;
+    }
+#elif TW_TIMER_WHEELS > 1
   carry = fast_ring_offset >= TW_SLOTS_PER_RING ? 1 : 0;
   fast_ring_offset %= TW_SLOTS_PER_RING;
   slow_ring_offset = (interval >> TW_RING_SHIFT) + carry;
@@ -247,6 +299,9 @@ u32 TW (tw_timer_expire_timers) (TWT (tw_timer_wheel) * tw, f64 now)
 #if TW_TIMER_WHEELS > 1
   u32 slow_wheel_index;
 #endif
+#if TW_TIMER_WHEELS > 2
+  u32 glacier_wheel_index;
+#endif
 
   /* Shouldn't happen */
   if (PREDICT_FALSE (now < tw->next_run_time))
@@ -279,6 +334,39 @@ u32 TW (tw_timer_expire_timers) (TWT (tw_timer_wheel) * tw, f64 now)
 	  tw->current_index[TW_TIMER_RING_SLOW] %= TW_SLOTS_PER_RING;
 	  slow_wheel_index = tw->current_index[TW_TIMER_RING_SLOW];
 
+#if TW_TIMER_WHEELS > 2
+	  /*
+	   * If we've been around the slow ring once, deal one glacier
+	   * ring slot into the slow ring before handling the slow ring.
+	   */
+	  if (PREDICT_FALSE (slow_wheel_index == 0))
+	    {
+	      tw->current_index[TW_TIMER_RING_GLACIER]++;
+	      tw->current_index[TW_TIMER_RING_GLACIER] %= TW_SLOTS_PER_RING;
+	      glacier_wheel_index = tw->current_index[TW_TIMER_RING_GLACIER];
+
+	      ts = &tw->w[TW_TIMER_RING_GLACIER][glacier_wheel_index];
+
+	      head = pool_elt_at_index (tw->timers, ts->head_index);
+	      next_index = head->next;
+
+	      /* Make slot empty */
+	      head->next = head->prev = ts->head_index;
+
+	      /* traverse slot, deal timers into slow ring */
+	      while (next_index != head - tw->timers)
+		{
+		  t = pool_elt_at_index (tw->timers, next_index);
+		  next_index = t->next;
+
+		  t->next = t->prev = ~0;
+		  ASSERT (t->slow_ring_offset < TW_SLOTS_PER_RING);
+		  ts = &tw->w[TW_TIMER_RING_SLOW][t->slow_ring_offset];
+		  timer_addhead (tw->timers, ts->head_index, t - tw->timers);
+		}
+	    }
+#endif
+
 	  ts = &tw->w[TW_TIMER_RING_SLOW][slow_wheel_index];
 
 	  head = pool_elt_at_index (tw->timers, ts->head_index);
@@ -35,7 +35,7 @@
 
 Instantiation of tw_timer_template.h generates named structures to
 implement specific timer wheel geometries. Choices include: number of
-timer wheels (currently, 1 or 2), number of slots per ring (a power of
+timer wheels (currently, 1, 2 or 3), number of slots per ring (a power of
 two), and the number of timers per "object handle".
 
 Internally, user object/timer handles are 32-bit integers, so if one
@@ -118,7 +118,12 @@ typedef struct
 #if TW_TIMER_WHEELS > 0
   /** fast ring offset, only valid in the slow ring */
   u16 fast_ring_offset;
+#if TW_TIMER_WHEELS > 2
+  /** slow ring offset, only valid in the glacier ring */
+  u16 slow_ring_offset;
+#else
   u16 pad;
+#endif
 #endif
   /** user timer handle */
   u32 user_handle;
@@ -141,6 +146,8 @@ typedef enum
   TW_TIMER_RING_FAST,
   /** Slow timer ring ID */
   TW_TIMER_RING_SLOW,
+  /** Glacier timer ring ID */
+  TW_TIMER_RING_GLACIER,
 } tw_ring_index_t;
 #endif /* __defined_tw_timer_wheel_slot__ */
 
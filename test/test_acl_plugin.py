@@ -4,6 +4,7 @@
 
 import unittest
 import random
+import re
 
 from scapy.packet import Raw
 from scapy.layers.l2 import Ether
@@ -28,6 +29,7 @@ class TestACLplugin(VppTestCase):
     # rule types
     DENY = 0
     PERMIT = 1
+    PERMIT_REFLECT = 2
 
     # supported protocols
     proto = [[6, 17], [1, 58]]
@@ -684,6 +686,10 @@ class TestACLplugin(VppTestCase):
         # Traffic should still pass
         self.run_verify_test(self.IP, self.IPV4, self.proto[self.IP][self.TCP])
 
+        # Without permit+reflect rules no interface runs the session arcs
+        sessions = self.vapi.cli("show acl-plugin sessions")
+        self.assertIn("session arcs on sw_if_index: in, out", sessions)
+
         self.logger.info("ACLP_TEST_FINISH_0008")
 
     def test_0009_tcp_permit_v6(self):
@@ -1011,5 +1017,94 @@ class TestACLplugin(VppTestCase):
 
         self.logger.info("ACLP_TEST_FINISH_0020")
 
+    def test_0021_udp_deny_port_range_hash_linear(self):
+        """ deny UDPv4/v6 port range, hash and linear lookup
+        """
+        self.logger.info("ACLP_TEST_START_0021")
+
+        # Add an ACL
+        rules = []
+        rules.append(self.create_rule(self.IPV4, self.DENY, self.PORTS_RANGE,
+                                      self.proto[self.IP][self.UDP]))
+        rules.append(self.create_rule(self.IPV6, self.DENY, self.PORTS_RANGE,
+                                      self.proto[self.IP][self.UDP]))
+        # Permit ip any any in the end
+        rules.append(self.create_rule(self.IPV4, self.PERMIT,
+                                      self.PORTS_ALL, 0))
+        rules.append(self.create_rule(self.IPV6, self.PERMIT,
+                                      self.PORTS_ALL, 0))
+
+        # Apply rules
+        self.apply_rules(rules, "deny ip4/ip6 udp port range")
+
+        # Both lookup engines must give the same first match
+        for lookup in ["linear", "hash"]:
+            self.vapi.cli("set acl-plugin lookup %s" % lookup)
+            # Traffic should not pass
+            self.run_verify_negat_test(self.IP, self.IPRANDOM,
+                                       self.proto[self.IP][self.UDP])
+
+        tables = self.vapi.cli("show acl-plugin tables")
+        self.logger.info(tables)
+        self.assertIn("ACL lookup: hash", tables)
+        self.assertIn("with range check", tables)
+
+        self.logger.info("ACLP_TEST_FINISH_0021")
+
+    def test_0022_udp_permit_reflect_sessions(self):
+        """ permit+reflect UDPv4/v6 creates sessions which expire
+        """
+        self.logger.info("ACLP_TEST_START_0022")
+
+        port = 1234
+        timeout = 2
+
+        # Add an ACL
+        rules = []
+        rules.append(self.create_rule(self.IPV4, self.PERMIT_REFLECT,
+                                      port, self.proto[self.IP][self.UDP]))
+        rules.append(self.create_rule(self.IPV6, self.PERMIT_REFLECT,
+                                      port, self.proto[self.IP][self.UDP]))
+
+        # Apply rules
+        self.apply_rules(rules, "permit+reflect ip4/ip6 udp")
+        self.vapi.cli("set acl-plugin session timeout udp idle %d" % timeout)
+
+        # Traffic should still pass, one packet per host pair
+        self.run_verify_test(self.IP, self.IPRANDOM,
+                             self.proto[self.IP][self.UDP], port)
+        n_flows = len(self.hosts_by_pg_idx[self.pg0.sw_if_index]) * \
+            len(self.hosts_by_pg_idx[self.pg1.sw_if_index])
+
+        # Each flow has a session on the input interface it entered by
+        sessions = self.vapi.cli("show acl-plugin sessions verbose")
+        self.logger.info(sessions)
+        arcs = re.search(r"session arcs on sw_if_index: in([\d ]*), out",
+                         sessions)
+        self.assertIsNotNone(arcs)
+        for i in self.pg_interfaces:
+            self.assertIn(str(i.sw_if_index), arcs.group(1).split())
+        self.assertIn("thread 0: %d sessions, added %d deleted 0 "
+                      "add failed 0" % (n_flows, n_flows), sessions)
+        states = re.findall(r"sw_if_index (\d+) (in|out) proto (\d+) "
+                            r"ports (\d+) (\d+) tcp flags (\w+)/(\w+) "
+                            r"idle [\d.]+ sec timeout ([a-z ]+)\n",
+                            sessions)
+        self.assertEqual(len(states), n_flows)
+        for state in states:
+            self.assertEqual(state, (str(self.pg0.sw_if_index), "in", "17",
+                                     str(port), str(port), "00", "00",
+                                     "udp idle"))
+
+        # Idle sessions are gone once the timeout has passed
+        self.sleep(timeout + 1)
+        sessions = self.vapi.cli("show acl-plugin sessions")
+        self.logger.info(sessions)
+        self.vapi.cli("set acl-plugin session timeout udp idle 600")
+        self.assertIn("thread 0: 0 sessions, added %d deleted %d "
+                      "add failed 0" % (n_flows, n_flows), sessions)
+
+        self.logger.info("ACLP_TEST_FINISH_0022")
+
 if __name__ == '__main__':
     unittest.main(testRunner=VppTestRunner)
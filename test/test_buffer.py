@@ -0,0 +1,38 @@
+#!/usr/bin/env python
+
+import unittest
+
+from framework import VppTestCase, VppTestRunner
+
+
+class TestBuffer(VppTestCase):
+    """ Buffer Cache Test Case """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestBuffer, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["cpu", "{", "workers", "1", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestBuffer, cls).setUpClass()
+
+    def setUp(self):
+        super(TestBuffer, self).setUp()
+
+    def tearDown(self):
+        super(TestBuffer, self).tearDown()
+
+    def test_buffer_cache(self):
+        """ Buffer global pool and per-thread cache Unit Tests """
+        error = self.vapi.cli("test buffer")
+
+        if error:
+            self.logger.critical(error)
+        self.assertEqual(error.find("failed"), -1)
+
+        reply = self.vapi.cli("show buffers")
+        self.assertIn("Global pool:", reply)
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
@@ -1,6 +1,7 @@
 #!/usr/bin/env python
 
 import unittest
+import re
 
 from framework import VppTestCase, VppTestRunner
 
@@ -26,5 +27,36 @@ class TestFIB(VppTestCase):
             self.logger.critical(error)
         self.assertEqual(error.find("Failed"), -1)
 
+    def test_ip6_lookup(self):
+        """ IPv6 FIB lookup agrees with the hash lookup """
+        reply = self.vapi.cli("test ip6 lookup nroutes 5000 nlookups 100000")
+
+        self.logger.info(reply)
+        mismatches = re.findall(r"lookups (.*), (\d+) mismatches", reply)
+        self.assertEqual([m[0] for m in mismatches],
+                         ["after adding", "after deleting",
+                          "after adding covers", "after re-adding",
+                          "after deleting covers", "after churn"])
+        for when, n in mismatches:
+            self.assertEqual(int(n), 0, "mismatches %s" % when)
+
+    def test_ip4_lookup(self):
+        """ IPv4 16-8-8 mtrie lookup, cover deletes and ply frees """
+        reply = self.vapi.cli("test ip4 lookup nroutes 5000 nlookups 100000")
+
+        self.logger.info(reply)
+        mismatches = re.findall(r"lookups (.*), (\d+) mismatches", reply)
+        self.assertEqual([m[0] for m in mismatches],
+                         ["fixed overlapping", "fixed covers deleted",
+                          "fixed /12 deleted", "fixed cover re-added",
+                          "after adding", "after deleting", "after churn"])
+        for when, n in mismatches:
+            self.assertEqual(int(n), 0, "mismatches %s" % when)
+
+        plies = re.findall(r"plies: (\d+) before, (\d+) after", reply)
+        self.assertEqual(len(plies), 2)
+        for before, after in plies:
+            self.assertEqual(before, after)
+
 if __name__ == '__main__':
     unittest.main(testRunner=VppTestRunner)
@@ -0,0 +1,54 @@
+#!/usr/bin/env python
+
+import unittest
+
+from framework import VppTestCase, VppTestRunner
+
+
+class TestGSO(VppTestCase):
+    """ GSO Test Case """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestGSO, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["tcp", "{", "large-send", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestGSO, cls).setUpClass()
+
+        try:
+            cls.create_pg_interfaces(range(1))
+            cls.pg0.admin_up()
+            cls.pg0.config_ip4()
+            cls.pg0.config_ip6()
+        except Exception:
+            super(TestGSO, cls).tearDownClass()
+            raise
+
+    def setUp(self):
+        super(TestGSO, self).setUp()
+
+    def tearDown(self):
+        super(TestGSO, self).tearDown()
+
+    def test_gso_segment(self):
+        """ GSO segmentation Unit Tests """
+        error = self.vapi.cli("test gso")
+
+        if error:
+            self.logger.critical(error)
+        self.assertEqual(error.find("failed"), -1)
+
+    def test_gso_local_peer(self):
+        """ No super-segments to local destinations """
+        for lcl, rmt in ((self.pg0.local_ip4, self.pg0.remote_ip4),
+                         (self.pg0.local_ip6, self.pg0.remote_ip6)):
+            error = self.vapi.cli("test gso local-peer %s %s" % (lcl, rmt))
+
+            if error:
+                self.logger.critical(error)
+            self.assertEqual(error.find("failed"), -1)
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
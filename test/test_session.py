@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+
+import unittest
+
+from scapy.packet import Raw
+from scapy.layers.l2 import Ether
+from scapy.layers.inet import IP, UDP
+
+from framework import VppTestCase, VppTestRunner
+
+
+class TestSessionUDP(VppTestCase):
+    """ Session layer UDP Test Case """
+
+    port = 1234
+    peer_port = 4321
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSessionUDP, cls).setUpClass()
+
+        try:
+            cls.create_pg_interfaces(range(1))
+            cls.pg0.admin_up()
+            cls.pg0.config_ip4()
+            cls.pg0.resolve_arp()
+            cls.vapi.cli("session enable")
+        except Exception:
+            super(TestSessionUDP, cls).tearDownClass()
+            raise
+
+    def setUp(self):
+        super(TestSessionUDP, self).setUp()
+
+    def tearDown(self):
+        super(TestSessionUDP, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.ppcli("show session verbose"))
+
+    def test_udp_single_datagram_before_accept(self):
+        """ Datagram received before the app accepts is delivered """
+        uri = "udp://0.0.0.0/%d" % self.port
+        error = self.vapi.cli("builtin uri bind uri %s defer-accept" % uri)
+        self.assertEqual(error.find("returned"), -1)
+
+        # The peer sends exactly one datagram, which creates the session
+        payload = "single datagram"
+        p = (Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+             IP(src=self.pg0.remote_ip4, dst=self.pg0.local_ip4) /
+             UDP(sport=self.peer_port, dport=self.port) /
+             Raw(payload))
+        self.pg0.add_stream([p])
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+
+        # Nothing is read until the session is accepted
+        self.pg0.assert_nothing_captured()
+
+        # Accepting must notify the app of the queued datagram
+        reply = self.vapi.cli("builtin uri accept")
+        self.assertIn("1 sessions accepted", reply)
+
+        rx = self.pg0.get_capture(1)
+        self.assertEqual(rx[0][IP].src, self.pg0.local_ip4)
+        self.assertEqual(rx[0][IP].dst, self.pg0.remote_ip4)
+        self.assertEqual(rx[0][UDP].sport, self.port)
+        self.assertEqual(rx[0][UDP].dport, self.peer_port)
+        self.assertEqual(str(rx[0][Raw]), payload)
+
+        self.vapi.cli("builtin uri unbind uri %s" % uri)
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
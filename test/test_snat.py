@@ -2,6 +2,7 @@
 
 import socket
 import unittest
+import re
 import struct
 
 from framework import VppTestCase, VppTestRunner
@@ -1109,6 +1110,61 @@ class TestSNAT(VppTestCase):
                 data = ipfix.decode_data_set(p.getlayer(Set))
                 self.verify_ipfix_nat44_ses(data)
 
+    def test_ipfix_nat44_sess_batched(self):
+        """ S-NAT IPFIX logging NAT44 session events in MTU sized batches """
+        sessions = 60
+        self.snat_add_address(self.snat_addr)
+        self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index)
+        self.vapi.snat_interface_add_del_feature(self.pg1.sw_if_index,
+                                                 is_inside=0)
+        self.vapi.set_ipfix_exporter(collector_address=self.pg3.remote_ip4n,
+                                     src_address=self.pg3.local_ip4n,
+                                     path_mtu=512,
+                                     template_interval=10)
+        self.vapi.snat_ipfix()
+
+        pkts = []
+        for i in range(sessions):
+            p = (Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+                 IP(src=self.pg0.remote_ip4, dst=self.pg1.remote_ip4) /
+                 UDP(sport=6000 + i, dport=53))
+            pkts.append(p)
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(len(pkts))
+        self.snat_add_address(self.snat_addr, is_add=0)
+        self.vapi.cli("ipfix flush")  # FIXME this should be an API call
+        # 17 records fit into a 512B message, 120 events take 7 full data
+        # sets and one with the last record, plus one template per event
+        capture = self.pg3.get_capture(10)
+        ipfix = IPFIXDecoder()
+        for p in capture:
+            self.assertTrue(p.haslayer(IPFIX))
+            if p.haslayer(Template):
+                ipfix.add_template(p.getlayer(Template))
+        nat44_ses_create_num = 0
+        nat44_ses_delete_num = 0
+        sequence_numbers = []
+        records_per_set = []
+        for p in capture:
+            if p.haslayer(Data):
+                self.assertLessEqual(len(p[IP]), 512)
+                sequence_numbers.append(p[IPFIX].sequenceNumber)
+                data = ipfix.decode_data_set(p.getlayer(Set))
+                records_per_set.append(len(data))
+                for record in data:
+                    self.assertEqual(IP_PROTOS.udp, ord(record[4]))
+                    if ord(record[230]) == 4:
+                        nat44_ses_create_num += 1
+                    else:
+                        self.assertEqual(5, ord(record[230]))
+                        nat44_ses_delete_num += 1
+        self.assertEqual(sessions, nat44_ses_create_num)
+        self.assertEqual(sessions, nat44_ses_delete_num)
+        self.assertEqual(len(set(sequence_numbers)), len(sequence_numbers))
+        self.assertEqual(sorted(records_per_set), [1] + [17] * 7)
+
     def test_ipfix_addr_exhausted(self):
         """ S-NAT IPFIX logging NAT addresses exhausted """
         self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index)
@@ -1348,5 +1404,287 @@ class TestDeterministicNAT(VppTestCase):
             self.logger.info(self.vapi.cli("show snat detail"))
             self.clear_snat()
 
+
+class TestSNATSessionTimeouts(VppTestCase):
+    """ SNAT Session Timeouts Test Cases """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestSNATSessionTimeouts, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["snat", "{", "udp", "timeout", "2",
+                                "tcp", "transitory", "timeout", "2",
+                                "icmp", "timeout", "2", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSNATSessionTimeouts, cls).setUpClass()
+
+        try:
+            cls.snat_addr = '10.0.0.3'
+            cls.snat_addr_n = socket.inet_pton(socket.AF_INET, cls.snat_addr)
+
+            cls.create_pg_interfaces(range(2))
+            cls.interfaces = list(cls.pg_interfaces)
+
+            for i in cls.interfaces:
+                i.admin_up()
+                i.config_ip4()
+                i.resolve_arp()
+
+        except Exception:
+            super(TestSNATSessionTimeouts, cls).tearDownClass()
+            raise
+
+    def send_in2out(self, layer4):
+        """
+        Send one packet from the inside and wait for its translation
+
+        :param layer4: Scapy layer 4 header of the packet
+        """
+        p = (Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+             IP(src=self.pg0.remote_ip4, dst=self.pg1.remote_ip4) /
+             layer4)
+        self.pg0.add_stream([p])
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(1)
+
+    def user_sessions(self):
+        """ Number of dynamic sessions of the pg0 host """
+        for user in self.vapi.snat_user_dump():
+            if user.ip_address[:4] == self.pg0.remote_ip4n:
+                return user.nsessions
+        return 0
+
+    def test_session_timeouts(self):
+        """ SNAT idle sessions expire, by protocol and TCP state """
+
+        self.vapi.snat_add_address_range(self.snat_addr_n, self.snat_addr_n)
+        self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index)
+        self.vapi.snat_interface_add_del_feature(self.pg1.sw_if_index,
+                                                 is_inside=0)
+
+        self.send_in2out(UDP(sport=6304))
+        self.send_in2out(ICMP(id=6305, type='echo-request'))
+        self.send_in2out(TCP(sport=6303, flags='S'))
+        self.send_in2out(TCP(sport=6306, flags='A'))
+        self.assertEqual(self.user_sessions(), 4)
+
+        # UDP, ICMP and the half open connection time out, the established
+        # connection stays
+        self.sleep(4)
+        self.assertEqual(self.user_sessions(), 1)
+
+        # A reset makes the established connection transitory
+        self.send_in2out(TCP(sport=6306, flags='R'))
+        self.sleep(4)
+        self.assertEqual(self.user_sessions(), 0)
+        self.assertEqual(len(self.vapi.snat_user_dump()), 0)
+
+    def tearDown(self):
+        super(TestSNATSessionTimeouts, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.cli("show snat verbose"))
+            self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index,
+                                                     is_add=0)
+            self.vapi.snat_interface_add_del_feature(self.pg1.sw_if_index,
+                                                     is_inside=0, is_add=0)
+            self.vapi.snat_add_address_range(self.snat_addr_n,
+                                             self.snat_addr_n, is_add=0)
+
+
+class TestSNATPortPartitioning(VppTestCase):
+    """ SNAT Port Partitioning Test Cases """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestSNATPortPartitioning, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["cpu", "{", "workers", "2", "}",
+                                "snat", "{", "port", "partitioning", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSNATPortPartitioning, cls).setUpClass()
+
+        try:
+            cls.snat_addr = '10.0.0.3'
+            cls.snat_addr_n = socket.inet_pton(socket.AF_INET, cls.snat_addr)
+
+            cls.create_pg_interfaces(range(2))
+            cls.interfaces = list(cls.pg_interfaces)
+
+            for i in cls.interfaces:
+                i.admin_up()
+                i.config_ip4()
+                i.resolve_arp()
+
+        except Exception:
+            super(TestSNATPortPartitioning, cls).tearDownClass()
+            raise
+
+    def port_per_worker(self):
+        """ Size of a worker's outside port slice """
+        m = re.search(r"(\d+) outside ports per worker",
+                      self.vapi.cli("show snat"))
+        self.assertIsNotNone(m)
+        return int(m.group(1))
+
+    def test_port_partitioning(self):
+        """ SNAT outside ports stay in the worker's slice """
+        sports = range(7000, 7010)
+        self.vapi.snat_add_address_range(self.snat_addr_n, self.snat_addr_n)
+        self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index)
+        self.vapi.snat_interface_add_del_feature(self.pg1.sw_if_index,
+                                                 is_inside=0)
+        port_per_worker = self.port_per_worker()
+
+        pkts = [(Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+                 IP(src=self.pg0.remote_ip4, dst=self.pg1.remote_ip4) /
+                 UDP(sport=sport, dport=53))
+                for sport in sports]
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg1.get_capture(len(pkts))
+
+        # All sessions of a host live on one worker, so do their ports
+        for p in capture:
+            self.assertEqual(p[IP].src, self.snat_addr)
+            self.assertGreaterEqual(p[UDP].sport, 1024)
+        slices = set((p[UDP].sport - 1024) // port_per_worker
+                     for p in capture)
+        self.assertEqual(len(slices), 1)
+        self.assertLess(slices.pop(), 2)
+
+        # Return traffic is steered to the owner of the port's slice
+        pkts = [(Ether(dst=self.pg1.local_mac, src=self.pg1.remote_mac) /
+                 IP(src=self.pg1.remote_ip4, dst=self.snat_addr) /
+                 UDP(sport=53, dport=p[UDP].sport))
+                for p in capture]
+        self.pg1.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        capture = self.pg0.get_capture(len(pkts))
+        self.assertEqual(sorted(p[UDP].dport for p in capture),
+                         list(sports))
+        for p in capture:
+            self.assertEqual(p[IP].dst, self.pg0.remote_ip4)
+
+        # The port space can't be repartitioned under live sessions
+        reply = self.vapi.cli("set snat workers 0")
+        self.assertIn("in use", reply)
+        self.assertEqual(self.port_per_worker(), port_per_worker)
+
+    def tearDown(self):
+        super(TestSNATPortPartitioning, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.cli("show snat verbose"))
+            self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index,
+                                                     is_add=0)
+            self.vapi.snat_interface_add_del_feature(self.pg1.sw_if_index,
+                                                     is_inside=0, is_add=0)
+            self.vapi.snat_add_address_range(self.snat_addr_n,
+                                             self.snat_addr_n, is_add=0)
+
+
+class TestSNATWorkersIPFIX(VppTestCase):
+    """ SNAT IPFIX Logging From Workers Test Cases """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestSNATWorkersIPFIX, cls).setUpConstants()
+        cls.vpp_cmdline.extend(["cpu", "{", "workers", "2", "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestSNATWorkersIPFIX, cls).setUpClass()
+
+        try:
+            cls.snat_addr = '10.0.0.3'
+            cls.snat_addr_n = socket.inet_pton(socket.AF_INET, cls.snat_addr)
+
+            cls.create_pg_interfaces(range(3))
+            cls.interfaces = list(cls.pg_interfaces)
+
+            for i in cls.interfaces:
+                i.admin_up()
+                i.config_ip4()
+                i.resolve_arp()
+
+        except Exception:
+            super(TestSNATWorkersIPFIX, cls).tearDownClass()
+            raise
+
+    def create_sessions(self, sessions, first_sport=6000):
+        """
+        Create UDP sessions of the pg0 host, translated by a worker
+
+        :param sessions: Number of sessions
+        :param first_sport: Inside source port of the first session
+        """
+        pkts = [(Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+                 IP(src=self.pg0.remote_ip4, dst=self.pg1.remote_ip4) /
+                 UDP(sport=first_sport + i, dport=53))
+                for i in range(sessions)]
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+        self.pg1.get_capture(len(pkts))
+
+    def test_ipfix_nat44_sess_workers(self):
+        """ S-NAT IPFIX logging NAT44 sessions created on a worker """
+        sessions = 60
+        self.vapi.snat_add_address_range(self.snat_addr_n, self.snat_addr_n)
+        self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index)
+        self.vapi.snat_interface_add_del_feature(self.pg1.sw_if_index,
+                                                 is_inside=0)
+        self.vapi.set_ipfix_exporter(collector_address=self.pg2.remote_ip4n,
+                                     src_address=self.pg2.local_ip4n,
+                                     path_mtu=512,
+                                     template_interval=10)
+        self.vapi.snat_ipfix()
+
+        self.create_sessions(sessions)
+        # Deleting the address deletes the sessions from the main thread
+        self.vapi.snat_add_address_range(self.snat_addr_n, self.snat_addr_n,
+                                         is_add=0)
+        self.vapi.cli("ipfix flush")  # FIXME this should be an API call
+        # The worker logged the creates and the main thread the deletes,
+        # each sent 3 full data sets and flushes the 9 records left
+        capture = self.pg2.get_capture(10, timeout=3)
+        ipfix = IPFIXDecoder()
+        for p in capture:
+            self.assertTrue(p.haslayer(IPFIX))
+            if p.haslayer(Template):
+                ipfix.add_template(p.getlayer(Template))
+        events = {4: 0, 5: 0}
+        records_per_set = []
+        for p in capture:
+            if p.haslayer(Data):
+                self.assertLessEqual(len(p[IP]), 512)
+                data = ipfix.decode_data_set(p.getlayer(Set))
+                records_per_set.append(len(data))
+                for record in data:
+                    self.assertIn(ord(record[230]), events)
+                    events[ord(record[230])] += 1
+        self.assertEqual(events, {4: sessions, 5: sessions})
+        self.assertEqual(sorted(records_per_set), [9, 9] + [17] * 6)
+
+        # Per-thread counters, as reported by the events/s CLI
+        stats = self.vapi.cli("show snat ipfix logging")
+        self.assertIn("total: %d events in 8 data sets" % (2 * sessions),
+                      stats)
+        self.assertIn("vpp_wk_", stats)
+
+    def tearDown(self):
+        super(TestSNATWorkersIPFIX, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.cli("show snat ipfix logging"))
+            self.vapi.snat_ipfix(enable=0)
+            self.vapi.snat_interface_add_del_feature(self.pg0.sw_if_index,
+                                                     is_add=0)
+            self.vapi.snat_interface_add_del_feature(self.pg1.sw_if_index,
+                                                     is_inside=0, is_add=0)
+
 if __name__ == '__main__':
     unittest.main(testRunner=VppTestRunner)
@@ -0,0 +1,91 @@
+#!/usr/bin/env python
+
+import os
+import re
+import subprocess
+import unittest
+
+from scapy.packet import Raw
+from scapy.layers.l2 import Ether
+from scapy.layers.inet import IP, UDP
+
+from framework import VppTestCase, VppTestRunner
+
+
+class TestStatsClient(VppTestCase):
+    """ Stats segment client Test Case """
+
+    @classmethod
+    def setUpConstants(cls):
+        super(TestStatsClient, cls).setUpConstants()
+        cls.stat_segment_name = "%s-stats" % cls.shm_prefix
+        cls.vpp_cmdline.extend(["statseg", "{", "name",
+                                cls.stat_segment_name, "}"])
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestStatsClient, cls).setUpClass()
+
+        try:
+            cls.create_pg_interfaces(range(1))
+            cls.pg0.admin_up()
+            cls.pg0.config_ip4()
+            cls.pg0.resolve_arp()
+        except Exception:
+            super(TestStatsClient, cls).tearDownClass()
+            raise
+
+    def setUp(self):
+        super(TestStatsClient, self).setUp()
+
+    def tearDown(self):
+        super(TestStatsClient, self).tearDown()
+        if not self.vpp_dead:
+            self.logger.info(self.vapi.cli("show statistics segment"))
+
+    def vpp_get_stats(self, *args):
+        """ Run the stats client against this vpp's segment """
+        client = os.path.join(os.path.dirname(self.vpp_bin), "vpp_get_stats")
+        cmd = [client, "segment-name", self.stat_segment_name] + list(args)
+        self.logger.info("stats client: %s" % " ".join(cmd))
+        return subprocess.check_output(cmd)
+
+    def rx_packets(self, sw_if_index):
+        """ pg0's rx packets, summed over threads, as the client reads them """
+        n_packets = 0
+        for line in self.vpp_get_stats("dump", "/if/rx").splitlines():
+            m = re.match(r"\[(\d+) @ \d+\]: (\d+) packets, \d+ bytes /if/rx$",
+                         line)
+            if m and int(m.group(1)) == sw_if_index:
+                n_packets += int(m.group(2))
+        return n_packets
+
+    def test_client_reads_interface_counter(self):
+        """ Client maps the segment and reads an interface counter """
+        reply = self.vapi.cli("show statistics segment")
+        self.assertIn("at 0x18000", reply)
+
+        names = self.vpp_get_stats("ls", "/if/").splitlines()
+        self.assertIn("/if/rx", names)
+
+        before = self.rx_packets(self.pg0.sw_if_index)
+
+        n_packets = 17
+        pkts = [(Ether(dst=self.pg0.local_mac, src=self.pg0.remote_mac) /
+                 IP(src=self.pg0.remote_ip4, dst=self.pg0.local_ip4) /
+                 UDP(sport=1234, dport=4321) /
+                 Raw("x" * 32)) for i in range(n_packets)]
+        self.pg0.add_stream(pkts)
+        self.pg_enable_capture(self.pg_interfaces)
+        self.pg_start()
+
+        # The stream runs asynchronously to the cli
+        for i in range(20):
+            after = self.rx_packets(self.pg0.sw_if_index)
+            if after >= before + n_packets:
+                break
+            self.sleep(0.1, "waiting for the stream")
+        self.assertEqual(after, before + n_packets)
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)
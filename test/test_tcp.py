@@ -0,0 +1,38 @@
+#!/usr/bin/env python
+
+import unittest
+
+from framework import VppTestCase, VppTestRunner
+
+
+class TestTCP(VppTestCase):
+    """ TCP Test Case """
+
+    @classmethod
+    def setUpClass(cls):
+        super(TestTCP, cls).setUpClass()
+
+    def setUp(self):
+        super(TestTCP, self).setUp()
+
+    def tearDown(self):
+        super(TestTCP, self).tearDown()
+
+    def test_tcp_sack(self):
+        """ TCP SACK scoreboard Unit Tests """
+        error = self.vapi.cli("test tcp sack")
+
+        if error:
+            self.logger.critical(error)
+        self.assertEqual(error.find("failed"), -1)
+
+    def test_tcp_rack(self):
+        """ TCP RACK loss detection Unit Tests """
+        error = self.vapi.cli("test tcp rack")
+
+        if error:
+            self.logger.critical(error)
+        self.assertEqual(error.find("failed"), -1)
+
+if __name__ == '__main__':
+    unittest.main(testRunner=VppTestRunner)